@@ -1371,6 +1371,14 @@ void __init alternative_instructions(void)
 	 */
 	paravirt_set_cap();
 
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+	/*
+	 * Pick the NUMA-aware spinlock slowpath, if wanted, before the
+	 * paravirt call sites are patched below.
+	 */
+	cna_configure_spin_lock_slowpath();
+#endif
+
 	/*
 	 * First patch paravirt functions, such that we overwrite the indirect
 	 * call with the direct call.
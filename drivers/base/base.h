@@ -221,6 +221,7 @@ int device_links_read_lock(void);
 void device_links_read_unlock(int idx);
 int device_links_read_lock_held(void);
 int device_links_check_suppliers(struct device *dev);
+bool device_links_supplier_pending(struct device *dev);
 void device_links_force_bind(struct device *dev);
 void device_links_driver_bound(struct device *dev);
 void device_links_driver_cleanup(struct device *dev);
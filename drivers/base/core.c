@@ -1087,6 +1087,41 @@ int device_links_check_suppliers(struct device *dev)
 	return ret ? ret : fwnode_ret;
 }
 
+/**
+ * device_links_supplier_pending - Check if a device waits for a supplier
+ * @dev: Consumer device.
+ *
+ * Return true if @dev has a managed link to a supplier that has no driver
+ * bound yet, so that device_links_check_suppliers() would defer its probe
+ * again. Best effort devices may probe without some of their suppliers
+ * and are never reported.
+ */
+bool device_links_supplier_pending(struct device *dev)
+{
+	struct device_link *link;
+	bool ret = false;
+	int idx;
+
+	if (dev_is_best_effort(dev))
+		return false;
+
+	idx = device_links_read_lock();
+	list_for_each_entry_rcu(link, &dev->links.suppliers, c_node,
+				device_links_read_lock_held()) {
+		if (!(link->flags & DL_FLAG_MANAGED) ||
+		    link->flags & DL_FLAG_SYNC_STATE_ONLY)
+			continue;
+
+		if (READ_ONCE(link->status) == DL_STATE_DORMANT) {
+			ret = true;
+			break;
+		}
+	}
+	device_links_read_unlock(idx);
+
+	return ret;
+}
+
 /**
  * __device_links_queue_sync_state - Queue a device for sync_state() callback
  * @dev: Device to call sync_state() on
@@ -69,6 +69,12 @@ static bool async_probe_default;
  */
 static bool defer_all_probes;
 
+/*
+ * Async probes get their own domain, so that waiting for the probes of one
+ * driver does not also wait for unrelated async work.
+ */
+static ASYNC_DOMAIN(probe_async_domain);
+
 static void __device_set_deferred_probe_reason(const struct device *dev, char *reason)
 {
 	kfree(dev->p->deferred_probe_reason);
@@ -171,21 +177,32 @@ static bool driver_deferred_probe_enable;
  * trigger has occurred in the midst of probing a driver. If the trigger count
  * changes in the midst of a probe, then deferred processing should be triggered
  * again.
+ *
+ * Devices with a device link to a supplier that is still not bound are left on
+ * the pending list, their probe would only be deferred again. Binding that
+ * supplier makes the link available and triggers another pass, so they are
+ * retried when what they wait for shows up rather than after every bind.
  */
 void driver_deferred_probe_trigger(void)
 {
+	struct device_private *p, *n;
+
 	if (!driver_deferred_probe_enable)
 		return;
 
 	/*
-	 * A successful probe means that all the devices in the pending list
-	 * should be triggered to be reprobed.  Move all the deferred devices
+	 * A successful probe means that the devices in the pending list
+	 * may now succeed.  Move those not waiting for a known supplier
 	 * into the active list so they can be retried by the workqueue
 	 */
 	mutex_lock(&deferred_probe_mutex);
 	atomic_inc(&deferred_trigger_count);
-	list_splice_tail_init(&deferred_probe_pending_list,
-			      &deferred_probe_active_list);
+	list_for_each_entry_safe(p, n, &deferred_probe_pending_list,
+				 deferred_probe) {
+		if (device_links_supplier_pending(p->device))
+			continue;
+		list_move_tail(&p->deferred_probe, &deferred_probe_active_list);
+	}
 	mutex_unlock(&deferred_probe_mutex);
 
 	/*
@@ -1050,7 +1067,8 @@ static int __device_attach(struct device *dev, bool allow_async)
 out_unlock:
 	device_unlock(dev);
 	if (async)
-		async_schedule_dev(__device_attach_async_helper, dev);
+		async_schedule_dev_domain(__device_attach_async_helper, dev,
+					  &probe_async_domain);
 	return ret;
 }
 
@@ -1208,7 +1226,8 @@ static int __driver_attach(struct device *dev, void *data)
 		}
 		device_unlock(dev);
 		if (async)
-			async_schedule_dev(__driver_attach_async_helper, dev);
+			async_schedule_dev_domain(__driver_attach_async_helper,
+						  dev, &probe_async_domain);
 		return 0;
 	}
 
@@ -1341,7 +1360,7 @@ void driver_detach(struct device_driver *drv)
 	struct device *dev;
 
 	if (driver_allows_async_probing(drv))
-		async_synchronize_full();
+		async_synchronize_full_domain(&probe_async_domain);
 
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
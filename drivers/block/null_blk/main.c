@@ -61,6 +61,7 @@ enum nullb_device_flags {
 struct nullb_page {
 	struct page *page;
 	DECLARE_BITMAP(bitmap, MAP_SZ);
+	struct rcu_head rcu;
 };
 #define NULLB_PAGE_LOCK (MAP_SZ - 1)
 #define NULLB_PAGE_FREE (MAP_SZ - 2)
@@ -877,13 +878,21 @@ static struct nullb_page *null_alloc_page(void)
 	return t_page;
 }
 
+static void null_free_page_rcu(struct rcu_head *head)
+{
+	struct nullb_page *t_page = container_of(head, struct nullb_page, rcu);
+
+	__free_page(t_page->page);
+	kfree(t_page);
+}
+
+/* Freed after a grace period for the lockless readers, see null_lock_rw() */
 static void null_free_page(struct nullb_page *t_page)
 {
 	__set_bit(NULLB_PAGE_FREE, t_page->bitmap);
 	if (test_bit(NULLB_PAGE_LOCK, t_page->bitmap))
 		return;
-	__free_page(t_page->page);
-	kfree(t_page);
+	call_rcu(&t_page->rcu, null_free_page_rcu);
 }
 
 static bool null_page_empty(struct nullb_page *page)
@@ -1271,29 +1280,55 @@ static int null_transfer(struct nullb *nullb, struct page *page,
 	return err;
 }
 
+/*
+ * Without a cache, reads only look up pages in the data tree, which is
+ * safe under RCU as pages are only freed after a grace period. Such reads
+ * don't take nullb->lock, so they neither wait for nor hold up each other
+ * or writes. Returns whether the lock was taken.
+ */
+static bool null_lock_rw(struct nullb *nullb, bool is_write)
+{
+	if (!is_write && !null_cache_active(nullb) && !nullb->dev->zoned) {
+		rcu_read_lock();
+		return false;
+	}
+	spin_lock_irq(&nullb->lock);
+	return true;
+}
+
+static void null_unlock_rw(struct nullb *nullb, bool locked)
+{
+	if (locked)
+		spin_unlock_irq(&nullb->lock);
+	else
+		rcu_read_unlock();
+}
+
 static int null_handle_rq(struct nullb_cmd *cmd)
 {
 	struct request *rq = cmd->rq;
 	struct nullb *nullb = cmd->nq->dev->nullb;
+	bool is_write = op_is_write(req_op(rq));
 	int err;
 	unsigned int len;
 	sector_t sector = blk_rq_pos(rq);
 	struct req_iterator iter;
 	struct bio_vec bvec;
+	bool locked;
 
-	spin_lock_irq(&nullb->lock);
+	locked = null_lock_rw(nullb, is_write);
 	rq_for_each_segment(bvec, rq, iter) {
 		len = bvec.bv_len;
 		err = null_transfer(nullb, bvec.bv_page, len, bvec.bv_offset,
-				     op_is_write(req_op(rq)), sector,
+				     is_write, sector,
 				     rq->cmd_flags & REQ_FUA);
 		if (err) {
-			spin_unlock_irq(&nullb->lock);
+			null_unlock_rw(nullb, locked);
 			return err;
 		}
 		sector += len >> SECTOR_SHIFT;
 	}
-	spin_unlock_irq(&nullb->lock);
+	null_unlock_rw(nullb, locked);
 
 	return 0;
 }
@@ -1302,25 +1337,27 @@ static int null_handle_bio(struct nullb_cmd *cmd)
 {
 	struct bio *bio = cmd->bio;
 	struct nullb *nullb = cmd->nq->dev->nullb;
+	bool is_write = op_is_write(bio_op(bio));
 	int err;
 	unsigned int len;
 	sector_t sector = bio->bi_iter.bi_sector;
 	struct bio_vec bvec;
 	struct bvec_iter iter;
+	bool locked;
 
-	spin_lock_irq(&nullb->lock);
+	locked = null_lock_rw(nullb, is_write);
 	bio_for_each_segment(bvec, bio, iter) {
 		len = bvec.bv_len;
 		err = null_transfer(nullb, bvec.bv_page, len, bvec.bv_offset,
-				     op_is_write(bio_op(bio)), sector,
+				     is_write, sector,
 				     bio->bi_opf & REQ_FUA);
 		if (err) {
-			spin_unlock_irq(&nullb->lock);
+			null_unlock_rw(nullb, locked);
 			return err;
 		}
 		sector += len >> SECTOR_SHIFT;
 	}
-	spin_unlock_irq(&nullb->lock);
+	null_unlock_rw(nullb, locked);
 	return 0;
 }
 
@@ -2351,6 +2388,9 @@ static void __exit null_exit(void)
 
 	if (g_queue_mode == NULL_Q_MQ && shared_tags)
 		blk_mq_free_tag_set(&tag_set);
+
+	/* Wait for the pages still being freed by null_free_page_rcu() */
+	rcu_barrier();
 }
 
 module_init(null_init);
@@ -33,6 +33,7 @@
 #include <linux/debugfs.h>
 #include <linux/cpuhotplug.h>
 #include <linux/part_stat.h>
+#include <linux/xxhash.h>
 
 #include "zram_drv.h"
 
@@ -174,6 +175,61 @@ static inline u32 zram_get_priority(struct zram *zram, u32 index)
 	return prio & ZRAM_COMP_PRIORITY_MASK;
 }
 
+/*
+ * Compressed objects are allocated from a zsmalloc pool on the node of the
+ * CPU that writes them, so that a zspage never mixes objects from different
+ * nodes and decompression reads node-local memory. The pool an object lives
+ * in is kept in the flags bits above the zram pageflags; if a node id does
+ * not fit there, all objects share a single pool.
+ */
+static inline bool zram_node_pools(void)
+{
+	return IS_ENABLED(CONFIG_NUMA) &&
+	       __NR_ZRAM_PAGEFLAGS + NODES_SHIFT <= BITS_PER_LONG;
+}
+
+#define ZRAM_NODE_MASK	(BIT(NODES_SHIFT) - 1)
+
+static inline unsigned int zram_get_node(struct zram *zram, u32 index)
+{
+	if (!zram_node_pools())
+		return 0;
+	return (zram->table[index].flags >> __NR_ZRAM_PAGEFLAGS) &
+	       ZRAM_NODE_MASK;
+}
+
+static inline void zram_set_node(struct zram *zram, u32 index,
+				 unsigned int nid)
+{
+	if (!zram_node_pools())
+		return;
+	zram->table[index].flags &= ~(ZRAM_NODE_MASK << __NR_ZRAM_PAGEFLAGS);
+	zram->table[index].flags |= (unsigned long)nid << __NR_ZRAM_PAGEFLAGS;
+}
+
+/* The pool holding the object of slot @index; requires the slot lock */
+static inline struct zs_pool *zram_slot_pool(struct zram *zram, u32 index)
+{
+	return zram->mem_pools[zram_get_node(zram, index)];
+}
+
+/* The pool new objects written from this CPU go to */
+static inline unsigned int zram_local_pool(struct zram *zram)
+{
+	return zram->nr_pools > 1 ? numa_node_id() : 0;
+}
+
+static unsigned long zram_get_total_pages(struct zram *zram)
+{
+	unsigned long pages = 0;
+	unsigned int i;
+
+	for (i = 0; i < zram->nr_pools; i++)
+		if (zram->mem_pools[i])
+			pages += zs_get_total_pages(zram->mem_pools[i]);
+	return pages;
+}
+
 static inline void update_used_max(struct zram *zram,
 					const unsigned long pages)
 {
@@ -268,7 +324,7 @@ static ssize_t mem_used_max_store(struct device *dev,
 	down_read(&zram->init_lock);
 	if (init_done(zram)) {
 		atomic_long_set(&zram->stats.max_used_pages,
-				zs_get_total_pages(zram->mem_pool));
+				zram_get_total_pages(zram));
 	}
 	up_read(&zram->init_lock);
 
@@ -588,6 +644,35 @@ static void read_from_bdev_async(struct zram *zram, struct page *page,
 	submit_bio(bio);
 }
 
+/*
+ * Allocate @nr contiguous blocks, so that a whole writeback batch goes
+ * out in a single bio. Returns the first block, or 0 if no run is free.
+ */
+static unsigned long alloc_block_bdev_range(struct zram *zram,
+					    unsigned int nr)
+{
+	unsigned long blk_idx = 1;
+	unsigned int i;
+retry:
+	/* skip 0 bit to confuse zram.handle = 0 */
+	blk_idx = bitmap_find_next_zero_area(zram->bitmap, zram->nr_pages,
+					     blk_idx, nr, 0);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	for (i = 0; i < nr; i++) {
+		if (test_and_set_bit(blk_idx + i, zram->bitmap)) {
+			while (i--)
+				clear_bit(blk_idx + i, zram->bitmap);
+			blk_idx++;
+			goto retry;
+		}
+	}
+
+	atomic64_add(nr, &zram->stats.bd_count);
+	return blk_idx;
+}
+
 #define PAGE_WB_SIG "page_index="
 
 #define PAGE_WRITEBACK			0
@@ -595,18 +680,189 @@ static void read_from_bdev_async(struct zram *zram, struct page *page,
 #define IDLE_WRITEBACK			(1<<1)
 #define INCOMPRESSIBLE_WRITEBACK	(1<<2)
 
+#define ZRAM_WB_BATCH			32
+
+/* Pages read out of zram, written to the backing device together */
+struct zram_wb_batch {
+	unsigned int nr;
+	unsigned int nr_pages;
+	atomic_t pending;
+	struct completion done;
+	u32 index[ZRAM_WB_BATCH];
+	unsigned long blk_idx[ZRAM_WB_BATCH];
+	struct page *pages[ZRAM_WB_BATCH];
+	struct bio *bio[ZRAM_WB_BATCH];
+};
+
+static struct zram_wb_batch *zram_wb_batch_alloc(unsigned long nr_pages)
+{
+	struct zram_wb_batch *wb;
+
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return NULL;
+
+	nr_pages = min_t(unsigned long, nr_pages, ZRAM_WB_BATCH);
+	for (; wb->nr_pages < nr_pages; wb->nr_pages++) {
+		wb->pages[wb->nr_pages] = alloc_page(GFP_KERNEL);
+		if (!wb->pages[wb->nr_pages])
+			break;
+	}
+	if (!wb->nr_pages) {
+		kfree(wb);
+		return NULL;
+	}
+
+	atomic_set(&wb->pending, 1);
+	init_completion(&wb->done);
+	return wb;
+}
+
+static void zram_wb_batch_free(struct zram_wb_batch *wb)
+{
+	while (wb->nr_pages--)
+		__free_page(wb->pages[wb->nr_pages]);
+	kfree(wb);
+}
+
+static void zram_wb_end_io(struct bio *bio)
+{
+	struct zram_wb_batch *wb = bio->bi_private;
+
+	if (atomic_dec_and_test(&wb->pending))
+		complete(&wb->done);
+}
+
+/*
+ * Write the pages of @wb to the backing device and, for those whose slot
+ * did not change meanwhile, replace the zsmalloc object by the block.
+ * Contiguous blocks are written with one bio and all bios of the batch
+ * are in flight at the same time. Returns the most recent error, if any.
+ */
+static int zram_wb_batch_submit(struct zram *zram, struct zram_wb_batch *wb)
+{
+	unsigned long blk_idx;
+	struct blk_plug plug;
+	struct bio *bio = NULL;
+	unsigned int i;
+	u32 index;
+	int ret = 0;
+	int err;
+
+	blk_idx = alloc_block_bdev_range(zram, wb->nr);
+	for (i = 0; i < wb->nr; i++) {
+		if (blk_idx)
+			wb->blk_idx[i] = blk_idx + i;
+		else
+			wb->blk_idx[i] = (i && !wb->blk_idx[i - 1]) ? 0 :
+					 alloc_block_bdev(zram);
+	}
+
+	blk_start_plug(&plug);
+	for (i = 0; i < wb->nr; i++) {
+		wb->bio[i] = NULL;
+		if (!wb->blk_idx[i])
+			continue;
+
+		if (!bio || wb->blk_idx[i] != wb->blk_idx[i - 1] + 1) {
+			if (bio)
+				submit_bio(bio);
+			bio = bio_alloc(zram->bdev, wb->nr - i,
+					REQ_OP_WRITE | REQ_SYNC, GFP_NOIO);
+			bio->bi_iter.bi_sector =
+				wb->blk_idx[i] * (PAGE_SIZE >> 9);
+			bio->bi_end_io = zram_wb_end_io;
+			bio->bi_private = wb;
+			atomic_inc(&wb->pending);
+		}
+		__bio_add_page(bio, wb->pages[i], PAGE_SIZE, 0);
+		wb->bio[i] = bio;
+	}
+	if (bio)
+		submit_bio(bio);
+	blk_finish_plug(&plug);
+
+	if (!atomic_dec_and_test(&wb->pending))
+		wait_for_completion_io(&wb->done);
+
+	for (i = 0; i < wb->nr; i++) {
+		index = wb->index[i];
+		blk_idx = wb->blk_idx[i];
+
+		if (!blk_idx)
+			err = -ENOSPC;
+		else
+			err = blk_status_to_errno(wb->bio[i]->bi_status);
+		if (err) {
+			zram_slot_lock(zram, index);
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			if (blk_idx)
+				free_block_bdev(zram, blk_idx);
+			/*
+			 * BIO errors are not fatal, we continue and simply
+			 * attempt to writeback the remaining objects (pages).
+			 * At the same time we need to signal user-space that
+			 * some writes (at least one, but also could be all of
+			 * them) were not successful and we do so by returning
+			 * the most recent BIO error.
+			 */
+			ret = err;
+			continue;
+		}
+
+		atomic64_inc(&zram->stats.bd_writes);
+		/*
+		 * We released zram_slot_lock so need to check if the slot was
+		 * changed. If there is freeing for the slot, we can catch it
+		 * easily by zram_allocated.
+		 * A subtle case is the slot is freed/reallocated/marked as
+		 * ZRAM_IDLE again. To close the race, idle_store doesn't
+		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+		 * Thus, we could close the race by checking ZRAM_IDLE bit.
+		 */
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index) ||
+			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, blk_idx);
+		atomic64_inc(&zram->stats.pages_stored);
+		spin_lock(&zram->wb_limit_lock);
+		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
+		spin_unlock(&zram->wb_limit_lock);
+		zram_slot_unlock(zram, index);
+	}
+
+	for (i = 0; i < wb->nr; i++)
+		if (wb->bio[i] && (!i || wb->bio[i] != wb->bio[i - 1]))
+			bio_put(wb->bio[i]);
+
+	wb->nr = 0;
+	atomic_set(&wb->pending, 1);
+	reinit_completion(&wb->done);
+	return ret;
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
 	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
 	unsigned long index = 0;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
+	struct zram_wb_batch *wb;
 	ssize_t ret = len;
 	int mode, err;
-	unsigned long blk_idx = 0;
 
 	if (sysfs_streq(buf, "idle"))
 		mode = IDLE_WRITEBACK;
@@ -639,29 +895,31 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
+	wb = zram_wb_batch_alloc(nr_pages);
+	if (!wb) {
 		ret = -ENOMEM;
 		goto release_init_lock;
 	}
 
 	for (; nr_pages != 0; index++, nr_pages--) {
+		if (wb->nr == wb->nr_pages) {
+			err = zram_wb_batch_submit(zram, wb);
+			if (err)
+				ret = err;
+			if (err == -ENOSPC)
+				break;
+		}
+
+		/* Pages already in the batch will use up the limit, too */
 		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
+		if (zram->wb_limit_enable && zram->bd_wb_limit <=
+		    (u64)wb->nr << (PAGE_SHIFT - 12)) {
 			spin_unlock(&zram->wb_limit_lock);
 			ret = -EIO;
 			break;
 		}
 		spin_unlock(&zram->wb_limit_lock);
 
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
-				ret = -ENOSPC;
-				break;
-			}
-		}
-
 		zram_slot_lock(zram, index);
 		if (!zram_allocated(zram, index))
 			goto next;
@@ -689,76 +947,26 @@ static ssize_t writeback_store(struct device *dev,
 		/* Need for hugepage writeback racing */
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
-		if (zram_read_page(zram, page, index, NULL)) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
-		}
-
-		bio_init(&bio, zram->bdev, &bio_vec, 1,
-			 REQ_OP_WRITE | REQ_SYNC);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		bio_add_page(&bio, page, PAGE_SIZE, 0);
-
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		err = submit_bio_wait(&bio);
-		if (err) {
+		if (zram_read_page(zram, wb->pages[wb->nr], index, NULL)) {
 			zram_slot_lock(zram, index);
 			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
 			zram_clear_flag(zram, index, ZRAM_IDLE);
 			zram_slot_unlock(zram, index);
-			/*
-			 * BIO errors are not fatal, we continue and simply
-			 * attempt to writeback the remaining objects (pages).
-			 * At the same time we need to signal user-space that
-			 * some writes (at least one, but also could be all of
-			 * them) were not successful and we do so by returning
-			 * the most recent BIO error.
-			 */
-			ret = err;
 			continue;
 		}
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
-		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
-		}
-
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
+		wb->index[wb->nr++] = index;
+		continue;
 next:
 		zram_slot_unlock(zram, index);
 	}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
-	__free_page(page);
+	if (wb->nr) {
+		err = zram_wb_batch_submit(zram, wb);
+		if (err)
+			ret = err;
+	}
+	zram_wb_batch_free(wb);
 release_init_lock:
 	up_read(&zram->init_lock);
 
@@ -941,6 +1149,236 @@ static void zram_debugfs_register(struct zram *zram) {};
 static void zram_debugfs_unregister(struct zram *zram) {};
 #endif
 
+#ifdef CONFIG_ZRAM_DEDUP
+#define ZRAM_DEDUP_HASH_BITS	10
+
+static struct zram_dedup_bucket *zram_dedup_bucket(struct zram *zram,
+						   unsigned long checksum)
+{
+	return &zram->dedup_buckets[checksum &
+				    (BIT(ZRAM_DEDUP_HASH_BITS) - 1)];
+}
+
+/*
+ * Look for a stored object with the same compressed data as @src and take
+ * a reference on it. The same page always compresses to the same data, so
+ * comparing compressed data finds the duplicates at a fraction of the cost
+ * of hashing and comparing whole pages. Only objects written with the
+ * primary algorithm are ever shared, so there is nothing to mix up.
+ * Called with the compression stream held, hence no sleeping.
+ */
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		const void *src, unsigned int len, unsigned long *checksum)
+{
+	struct zram_dedup_entry *entry = NULL;
+	struct zram_dedup_bucket *bucket;
+	struct rb_node *node;
+	bool match = false;
+	void *obj;
+
+	if (!zram->use_dedup)
+		return NULL;
+
+	*checksum = xxhash(src, len, 0);
+	bucket = zram_dedup_bucket(zram, *checksum);
+
+	spin_lock(&bucket->lock);
+	node = bucket->root.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (*checksum < entry->checksum) {
+			node = node->rb_left;
+		} else if (*checksum > entry->checksum) {
+			node = node->rb_right;
+		} else {
+			if (entry->len == len) {
+				obj = zs_map_object(entry->pool, entry->handle,
+						    ZS_MM_RO);
+				match = !memcmp(obj, src, len);
+				zs_unmap_object(entry->pool, entry->handle);
+			}
+			if (match)
+				entry->refcount++;
+			break;
+		}
+	}
+	spin_unlock(&bucket->lock);
+
+	if (!match)
+		return NULL;
+
+	atomic64_add(len, &zram->stats.dup_data_size);
+	atomic64_inc(&zram->stats.dedup_hits);
+	return entry;
+}
+
+/*
+ * Make the object just stored at @handle available for sharing. Returns
+ * NULL, leaving the object private to its slot, if that is not possible.
+ */
+static struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+		unsigned long checksum, struct zs_pool *pool,
+		unsigned long handle, unsigned int len)
+{
+	struct zram_dedup_entry *entry, *cur;
+	struct zram_dedup_bucket *bucket;
+	struct rb_node **link, *parent = NULL;
+
+	if (!zram->use_dedup)
+		return NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->pool = pool;
+	entry->handle = handle;
+	entry->len = len;
+	entry->refcount = 1;
+
+	bucket = zram_dedup_bucket(zram, checksum);
+	spin_lock(&bucket->lock);
+	link = &bucket->root.rb_node;
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		if (checksum < cur->checksum) {
+			link = &parent->rb_left;
+		} else if (checksum > cur->checksum) {
+			link = &parent->rb_right;
+		} else {
+			/*
+			 * Another writer stored the same data meanwhile (or
+			 * this is a collision); only one of them is shared.
+			 */
+			spin_unlock(&bucket->lock);
+			kfree(entry);
+			return NULL;
+		}
+	}
+	rb_link_node(&entry->rb_node, parent, link);
+	rb_insert_color(&entry->rb_node, &bucket->root);
+	spin_unlock(&bucket->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+	return entry;
+}
+
+static void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_dedup_bucket *bucket;
+
+	bucket = zram_dedup_bucket(zram, entry->checksum);
+	spin_lock(&bucket->lock);
+	if (--entry->refcount) {
+		spin_unlock(&bucket->lock);
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return;
+	}
+	rb_erase(&entry->rb_node, &bucket->root);
+	spin_unlock(&bucket->lock);
+
+	zs_free(entry->pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+	kfree(entry);
+}
+
+static bool zram_dedup_init(struct zram *zram)
+{
+	unsigned int i;
+
+	if (!zram->use_dedup)
+		return true;
+
+	zram->dedup_buckets = kvcalloc(BIT(ZRAM_DEDUP_HASH_BITS),
+				       sizeof(*zram->dedup_buckets),
+				       GFP_KERNEL);
+	if (!zram->dedup_buckets)
+		return false;
+
+	for (i = 0; i < BIT(ZRAM_DEDUP_HASH_BITS); i++) {
+		spin_lock_init(&zram->dedup_buckets[i].lock);
+		zram->dedup_buckets[i].root = RB_ROOT;
+	}
+	return true;
+}
+
+static void zram_dedup_fini(struct zram *zram)
+{
+	kvfree(zram->dedup_buckets);
+	zram->dedup_buckets = NULL;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t dedup_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size),
+			(u64)atomic64_read(&zram->stats.dedup_hits));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#else
+static inline struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		const void *src, unsigned int len, unsigned long *checksum)
+{
+	return NULL;
+}
+static inline struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+		unsigned long checksum, struct zs_pool *pool,
+		unsigned long handle, unsigned int len)
+{
+	return NULL;
+}
+static inline void zram_dedup_put(struct zram *zram,
+				  struct zram_dedup_entry *entry) {};
+static inline bool zram_dedup_init(struct zram *zram) { return true; }
+static inline void zram_dedup_fini(struct zram *zram) {};
+#endif
+
 /*
  * We switched to per-cpu streams and this attr is not needed anymore.
  * However, we will keep it around for some time, because:
@@ -1104,6 +1542,7 @@ static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
+	unsigned int i;
 
 	down_read(&zram->init_lock);
 	if (!init_done(zram)) {
@@ -1111,7 +1550,9 @@ static ssize_t compact_store(struct device *dev,
 		return -EINVAL;
 	}
 
-	zs_compact(zram->mem_pool);
+	for (i = 0; i < zram->nr_pools; i++)
+		if (zram->mem_pools[i])
+			zs_compact(zram->mem_pools[i]);
 	up_read(&zram->init_lock);
 
 	return len;
@@ -1138,17 +1579,24 @@ static ssize_t mm_stat_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
 	struct zram *zram = dev_to_zram(dev);
-	struct zs_pool_stats pool_stats;
+	struct zs_pool_stats pool_stats, node_stats;
 	u64 orig_size, mem_used = 0;
 	long max_used;
 	ssize_t ret;
+	unsigned int i;
 
 	memset(&pool_stats, 0x00, sizeof(struct zs_pool_stats));
 
 	down_read(&zram->init_lock);
 	if (init_done(zram)) {
-		mem_used = zs_get_total_pages(zram->mem_pool);
-		zs_pool_stats(zram->mem_pool, &pool_stats);
+		mem_used = zram_get_total_pages(zram);
+		for (i = 0; i < zram->nr_pools; i++) {
+			if (!zram->mem_pools[i])
+				continue;
+			zs_pool_stats(zram->mem_pools[i], &node_stats);
+			atomic_long_add(atomic_long_read(&node_stats.pages_compacted),
+					&pool_stats.pages_compacted);
+		}
 	}
 
 	orig_size = atomic64_read(&zram->stats.pages_stored);
@@ -1214,38 +1662,78 @@ static DEVICE_ATTR_RO(mm_stat);
 static DEVICE_ATTR_RO(bd_stat);
 #endif
 static DEVICE_ATTR_RO(debug_stat);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RO(dedup_stat);
+#endif
 
 static void zram_meta_free(struct zram *zram, u64 disksize)
 {
 	size_t num_pages = disksize >> PAGE_SHIFT;
 	size_t index;
+	unsigned int i;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
-	zs_destroy_pool(zram->mem_pool);
+	zram_dedup_fini(zram);
+	for (i = 0; i < zram->nr_pools; i++)
+		if (zram->mem_pools[i])
+			zs_destroy_pool(zram->mem_pools[i]);
+	kfree(zram->mem_pools);
+	zram->mem_pools = NULL;
+	zram->nr_pools = 0;
 	vfree(zram->table);
 }
 
 static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 {
+	unsigned int nr_pools = zram_node_pools() ? nr_node_ids : 1;
+	char name[DISK_NAME_LEN + 8];
 	size_t num_pages;
+	unsigned int i;
 
 	num_pages = disksize >> PAGE_SHIFT;
 	zram->table = vzalloc(array_size(num_pages, sizeof(*zram->table)));
 	if (!zram->table)
 		return false;
 
-	zram->mem_pool = zs_create_pool(zram->disk->disk_name);
-	if (!zram->mem_pool) {
-		vfree(zram->table);
-		return false;
+	zram->mem_pools = kcalloc(nr_pools, sizeof(*zram->mem_pools),
+				  GFP_KERNEL);
+	if (!zram->mem_pools)
+		goto out_free_table;
+	zram->nr_pools = nr_pools;
+
+	for (i = 0; i < nr_pools; i++) {
+		if (nr_pools > 1 && !node_possible(i))
+			continue;
+		if (nr_pools > 1)
+			snprintf(name, sizeof(name), "%s-%u",
+				 zram->disk->disk_name, i);
+		else
+			strscpy(name, zram->disk->disk_name, sizeof(name));
+
+		zram->mem_pools[i] = zs_create_pool(name);
+		if (!zram->mem_pools[i])
+			goto out_free_pools;
+		if (!huge_class_size)
+			huge_class_size = zs_huge_class_size(zram->mem_pools[i]);
 	}
 
-	if (!huge_class_size)
-		huge_class_size = zs_huge_class_size(zram->mem_pool);
+	if (!zram_dedup_init(zram))
+		goto out_free_pools;
 	return true;
+
+out_free_pools:
+	while (i--)
+		if (zram->mem_pools[i])
+			zs_destroy_pool(zram->mem_pools[i]);
+	kfree(zram->mem_pools);
+	zram->mem_pools = NULL;
+	zram->nr_pools = 0;
+out_free_table:
+	vfree(zram->table);
+	return false;
 }
 
 /*
@@ -1289,11 +1777,19 @@ static void zram_free_page(struct zram *zram, size_t index)
 		goto out;
 	}
 
+	/* The object goes away with the last slot sharing it */
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, (struct zram_dedup_entry *)
+			       zram_get_handle(zram, index));
+		goto out;
+	}
+
 	handle = zram_get_handle(zram, index);
 	if (!handle)
 		return;
 
-	zs_free(zram->mem_pool, handle);
+	zs_free(zram_slot_pool(zram, index), handle);
 
 	atomic64_sub(zram_get_obj_size(zram, index),
 			&zram->stats.compr_data_size);
@@ -1301,6 +1797,7 @@ static void zram_free_page(struct zram *zram, size_t index)
 	atomic64_dec(&zram->stats.pages_stored);
 	zram_set_handle(zram, index, 0);
 	zram_set_obj_size(zram, index, 0);
+	zram_set_node(zram, index, 0);
 	WARN_ON_ONCE(zram->table[index].flags &
 		~(1UL << ZRAM_LOCK | 1UL << ZRAM_UNDER_WB));
 }
@@ -1313,6 +1810,7 @@ static int zram_read_from_zspool(struct zram *zram, struct page *page,
 				 u32 index)
 {
 	struct zcomp_strm *zstrm;
+	struct zs_pool *pool;
 	unsigned long handle;
 	unsigned int size;
 	void *src, *dst;
@@ -1338,7 +1836,14 @@ static int zram_read_from_zspool(struct zram *zram, struct page *page,
 		zstrm = zcomp_stream_get(zram->comps[prio]);
 	}
 
-	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	pool = zram_slot_pool(zram, index);
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		struct zram_dedup_entry *entry = (void *)handle;
+
+		pool = entry->pool;
+		handle = entry->handle;
+	}
+	src = zs_map_object(pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE) {
 		dst = kmap_atomic(page);
 		memcpy(dst, src, PAGE_SIZE);
@@ -1350,7 +1855,7 @@ static int zram_read_from_zspool(struct zram *zram, struct page *page,
 		kunmap_atomic(dst);
 		zcomp_stream_put(zram->comps[prio]);
 	}
-	zs_unmap_object(zram->mem_pool, handle);
+	zs_unmap_object(pool, handle);
 	return ret;
 }
 
@@ -1419,6 +1924,10 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	struct zcomp_strm *zstrm;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
+	unsigned int nid = zram_local_pool(zram);
+	struct zs_pool *pool = zram->mem_pools[nid];
+	struct zram_dedup_entry *entry = NULL;
+	unsigned long checksum = 0;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1439,12 +1948,22 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	if (unlikely(ret)) {
 		zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 		pr_err("Compression failed! err=%d\n", ret);
-		zs_free(zram->mem_pool, handle);
+		zs_free(pool, handle);
 		return ret;
 	}
 
 	if (comp_len >= huge_class_size)
 		comp_len = PAGE_SIZE;
+
+	if (comp_len != PAGE_SIZE) {
+		entry = zram_dedup_find(zram, zstrm->buffer, comp_len,
+					&checksum);
+		if (entry) {
+			zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
+			zs_free(pool, handle);
+			goto out;
+		}
+	}
 	/*
 	 * handle allocation has 2 paths:
 	 * a) fast path is executed with preemption disabled (for
@@ -1459,7 +1978,7 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	 * from the slow path and handle has already been allocated.
 	 */
 	if (IS_ERR_VALUE(handle))
-		handle = zs_malloc(zram->mem_pool, comp_len,
+		handle = zs_malloc(pool, comp_len,
 				__GFP_KSWAPD_RECLAIM |
 				__GFP_NOWARN |
 				__GFP_HIGHMEM |
@@ -1467,7 +1986,7 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	if (IS_ERR_VALUE(handle)) {
 		zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 		atomic64_inc(&zram->stats.writestall);
-		handle = zs_malloc(zram->mem_pool, comp_len,
+		handle = zs_malloc(pool, comp_len,
 				GFP_NOIO | __GFP_HIGHMEM |
 				__GFP_MOVABLE);
 		if (IS_ERR_VALUE(handle))
@@ -1485,16 +2004,16 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 		zstrm = zcomp_stream_get(zram->comps[ZRAM_PRIMARY_COMP]);
 	}
 
-	alloced_pages = zs_get_total_pages(zram->mem_pool);
+	alloced_pages = zram_get_total_pages(zram);
 	update_used_max(zram, alloced_pages);
 
 	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
 		zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
-		zs_free(zram->mem_pool, handle);
+		zs_free(pool, handle);
 		return -ENOMEM;
 	}
 
-	dst = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+	dst = zs_map_object(pool, handle, ZS_MM_WO);
 
 	src = zstrm->buffer;
 	if (comp_len == PAGE_SIZE)
@@ -1504,8 +2023,12 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 		kunmap_atomic(src);
 
 	zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
-	zs_unmap_object(zram->mem_pool, handle);
+	zs_unmap_object(pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	if (comp_len != PAGE_SIZE)
+		entry = zram_dedup_insert(zram, checksum, pool, handle,
+					  comp_len);
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1523,9 +2046,14 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	if (flags) {
 		zram_set_flag(zram, index, flags);
 		zram_set_element(zram, index, element);
-	}  else {
+	} else if (entry) {
+		zram_set_flag(zram, index, ZRAM_DEDUP);
+		zram_set_handle(zram, index, (unsigned long)entry);
+		zram_set_obj_size(zram, index, comp_len);
+	} else {
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
+		zram_set_node(zram, index, nid);
 	}
 	zram_slot_unlock(zram, index);
 
@@ -1575,12 +2103,14 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 			   u32 threshold, u32 prio, u32 prio_max)
 {
 	struct zcomp_strm *zstrm = NULL;
+	struct zs_pool *pool;
 	unsigned long handle_old;
 	unsigned long handle_new;
 	unsigned int comp_len_old;
 	unsigned int comp_len_new;
 	unsigned int class_index_old;
 	unsigned int class_index_new;
+	unsigned int nid;
 	u32 num_recomps = 0;
 	void *src, *dst;
 	int ret;
@@ -1600,7 +2130,10 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 	if (ret)
 		return ret;
 
-	class_index_old = zs_lookup_class_index(zram->mem_pool, comp_len_old);
+	/* Keep the recompressed object on the node the old one was on */
+	nid = zram_get_node(zram, index);
+	pool = zram->mem_pools[nid];
+	class_index_old = zs_lookup_class_index(pool, comp_len_old);
 	/*
 	 * Iterate the secondary comp algorithms list (in order of priority)
 	 * and try to recompress the page.
@@ -1627,7 +2160,7 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 			return ret;
 		}
 
-		class_index_new = zs_lookup_class_index(zram->mem_pool,
+		class_index_new = zs_lookup_class_index(pool,
 							comp_len_new);
 
 		/* Continue until we make progress */
@@ -1676,7 +2209,7 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 	 * alloc memory for recompressed object then we bail out and
 	 * simply keep the old (existing) object in zsmalloc.
 	 */
-	handle_new = zs_malloc(zram->mem_pool, comp_len_new,
+	handle_new = zs_malloc(pool, comp_len_new,
 			       __GFP_KSWAPD_RECLAIM |
 			       __GFP_NOWARN |
 			       __GFP_HIGHMEM |
@@ -1686,16 +2219,17 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 		return PTR_ERR((void *)handle_new);
 	}
 
-	dst = zs_map_object(zram->mem_pool, handle_new, ZS_MM_WO);
+	dst = zs_map_object(pool, handle_new, ZS_MM_WO);
 	memcpy(dst, zstrm->buffer, comp_len_new);
 	zcomp_stream_put(zram->comps[prio]);
 
-	zs_unmap_object(zram->mem_pool, handle_new);
+	zs_unmap_object(pool, handle_new);
 
 	zram_free_page(zram, index);
 	zram_set_handle(zram, index, handle_new);
 	zram_set_obj_size(zram, index, comp_len_new);
 	zram_set_priority(zram, index, prio);
+	zram_set_node(zram, index, nid);
 
 	atomic64_add(comp_len_new, &zram->stats.compr_data_size);
 	atomic64_inc(&zram->stats.pages_stored);
@@ -1808,6 +2342,7 @@ static ssize_t recompress_store(struct device *dev,
 		if (zram_test_flag(zram, index, ZRAM_WB) ||
 		    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
 		    zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_DEDUP) ||
 		    zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
 			goto next;
 
@@ -1999,6 +2534,9 @@ static void zram_reset_device(struct zram *zram)
 	reset_bdev(zram);
 
 	comp_algorithm_set(zram, ZRAM_PRIMARY_COMP, default_compressor);
+#ifdef CONFIG_ZRAM_DEDUP
+	zram->use_dedup = false;
+#endif
 	up_write(&zram->init_lock);
 }
 
@@ -2138,6 +2676,9 @@ static DEVICE_ATTR_RW(writeback_limit_enable);
 static DEVICE_ATTR_RW(recomp_algorithm);
 static DEVICE_ATTR_WO(recompress);
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -2164,6 +2705,10 @@ static struct attribute *zram_disk_attrs[] = {
 #ifdef CONFIG_ZRAM_MULTI_COMP
 	&dev_attr_recomp_algorithm.attr,
 	&dev_attr_recompress.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+	&dev_attr_dedup_stat.attr,
 #endif
 	NULL,
 };
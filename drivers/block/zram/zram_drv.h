@@ -15,7 +15,9 @@
 #ifndef _ZRAM_DRV_H_
 #define _ZRAM_DRV_H_
 
+#include <linux/rbtree.h>
 #include <linux/rwsem.h>
+#include <linux/spinlock.h>
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 
@@ -53,6 +55,7 @@ enum zram_pageflags {
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
 	ZRAM_INCOMPRESSIBLE, /* none of the algorithms could compress it */
+	ZRAM_DEDUP,	/* handle points to a shared zram_dedup_entry */
 
 	ZRAM_COMP_PRIORITY_BIT1, /* First bit of comp priority index */
 	ZRAM_COMP_PRIORITY_BIT2, /* Second bit of comp priority index */
@@ -74,6 +77,25 @@ struct zram_table_entry {
 #endif
 };
 
+/*
+ * A compressed object shared by all slots that store the same data.
+ * Entries are kept in a hash table of rbtrees keyed by the checksum of
+ * the compressed data, see zram_dedup_find().
+ */
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	unsigned long checksum;
+	struct zs_pool *pool;
+	unsigned long handle;
+	unsigned int len;
+	unsigned int refcount;	/* protected by the bucket lock */
+};
+
+struct zram_dedup_bucket {
+	spinlock_t lock;
+	struct rb_root root;
+};
+
 struct zram_stats {
 	atomic64_t compr_data_size;	/* compressed size of pages stored */
 	atomic64_t failed_reads;	/* can happen when memory is too low */
@@ -91,6 +113,11 @@ struct zram_stats {
 	atomic64_t bd_reads;		/* no. of reads from backing device */
 	atomic64_t bd_writes;		/* no. of writes from backing device */
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+	atomic64_t dup_data_size;	/* compressed size of shared pages */
+	atomic64_t meta_data_size;	/* size of zram_dedup_entries */
+	atomic64_t dedup_hits;		/* no. of writes that found a match */
+#endif
 };
 
 #ifdef CONFIG_ZRAM_MULTI_COMP
@@ -105,7 +132,9 @@ struct zram_stats {
 
 struct zram {
 	struct zram_table_entry *table;
-	struct zs_pool *mem_pool;
+	/* One zsmalloc pool per node, or a single one (see zram_node_pools()) */
+	struct zs_pool **mem_pools;
+	unsigned int nr_pools;
 	struct zcomp *comps[ZRAM_MAX_COMPS];
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
@@ -139,5 +168,9 @@ struct zram {
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_dedup_bucket *dedup_buckets;
+#endif
 };
 #endif
@@ -220,6 +220,9 @@ struct global_params {
  * @last_io_update:	Last time when IO wake flag was set
  * @sched_flags:	Store scheduler flags for possible cross CPU update
  * @hwp_boost_min:	Last HWP boosted min performance
+ * @hwp_uclamp_min:	HWP min performance floor from the utilization clamp
+ *			of the running task
+ * @hwp_uclamp_time:	Last time when @hwp_uclamp_min was raised
  * @suspended:		Whether or not the driver has been suspended.
  * @hwp_notify_work:	workqueue for HWP notifications.
  *
@@ -259,6 +262,8 @@ struct cpudata {
 	u64 last_io_update;
 	unsigned int sched_flags;
 	u32 hwp_boost_min;
+	u32 hwp_uclamp_min;
+	u64 hwp_uclamp_time;
 	bool suspended;
 	struct delayed_work hwp_notify_work;
 };
@@ -298,6 +303,7 @@ static int hwp_active __read_mostly;
 static int hwp_mode_bdw __read_mostly;
 static bool per_cpu_limits __read_mostly;
 static bool hwp_boost __read_mostly;
+static bool hwp_uclamp __read_mostly;
 static bool hwp_forced __read_mostly;
 
 static struct cpufreq_driver *intel_pstate_driver __read_mostly;
@@ -967,6 +973,13 @@ static void intel_pstate_hwp_set(unsigned int cpu)
 	}
 skip_epp:
 	WRITE_ONCE(cpu_data->hwp_req_cached, value);
+	/*
+	 * The value written here has no utilization clamp floor, and the
+	 * floor was computed against the old max anyway: drop it, so that
+	 * intel_pstate_hwp_uclamp_update() raises it again against the new
+	 * limits on the next update instead of assuming it is in place.
+	 */
+	WRITE_ONCE(cpu_data->hwp_uclamp_min, 0);
 	wrmsrl_on_cpu(cpu, MSR_HWP_REQUEST, value);
 }
 
@@ -2022,6 +2035,17 @@ static void intel_pstate_get_cpu_pstates(struct cpudata *cpu)
  */
 static int hwp_boost_hold_time_ns = 3 * NSEC_PER_MSEC;
 
+/* Raise the min performance of an HWP request to @min_perf and the floor */
+static inline u64 intel_pstate_hwp_req_floor(struct cpudata *cpu, u64 hwp_req,
+					     u32 min_perf)
+{
+	min_perf = max(min_perf, cpu->hwp_uclamp_min);
+	if (min_perf <= (hwp_req & 0xff))
+		return hwp_req;
+
+	return (hwp_req & ~GENMASK_ULL(7, 0)) | min_perf;
+}
+
 static inline void intel_pstate_hwp_boost_up(struct cpudata *cpu)
 {
 	u64 hwp_req = READ_ONCE(cpu->hwp_req_cached);
@@ -2064,7 +2088,7 @@ static inline void intel_pstate_hwp_boost_up(struct cpudata *cpu)
 	else
 		return;
 
-	hwp_req = (hwp_req & ~GENMASK_ULL(7, 0)) | cpu->hwp_boost_min;
+	hwp_req = intel_pstate_hwp_req_floor(cpu, hwp_req, cpu->hwp_boost_min);
 	wrmsrl(MSR_HWP_REQUEST, hwp_req);
 	cpu->last_update = cpu->sample.time;
 }
@@ -2078,18 +2102,83 @@ static inline void intel_pstate_hwp_boost_down(struct cpudata *cpu)
 		expired = time_after64(cpu->sample.time, cpu->last_update +
 				       hwp_boost_hold_time_ns);
 		if (expired) {
-			wrmsrl(MSR_HWP_REQUEST, cpu->hwp_req_cached);
 			cpu->hwp_boost_min = 0;
+			wrmsrl(MSR_HWP_REQUEST,
+			       intel_pstate_hwp_req_floor(cpu, cpu->hwp_req_cached, 0));
 		}
 	}
 	cpu->last_update = cpu->sample.time;
 }
 
+/*
+ * This is the clamp of the current task only, not the aggregated rq clamp
+ * that schedutil gets from uclamp_rq_get(): the rq clamp buckets are private
+ * to the scheduler and not reachable from a cpufreq driver.  So a task that
+ * is runnable but not running does not raise the floor, and when the hook
+ * runs for the enqueue of a wakee, current is still the waker.  The floor
+ * catches up with the wakee on the next utilization update, at the latest
+ * on the next tick.
+ */
+static inline unsigned int intel_pstate_current_uclamp_min(void)
+{
+#ifdef CONFIG_UCLAMP_TASK
+	const struct uclamp_se *uc_se = &current->uclamp[UCLAMP_MIN];
+
+	/* The effective value, including the cgroup's, is set on enqueue */
+	return uc_se->active ? uc_se->value : 0;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Translate the minimum utilization clamp of the task running on this CPU
+ * (see intel_pstate_current_uclamp_min() for why not the rq-wide clamp),
+ * which comes from its cgroup's cpu.uclamp.min unless set per task, into a
+ * floor for the HWP min performance, so that latency sensitive tasks get
+ * the performance they ask for on CPUs that otherwise run at low
+ * performance for batch work.  The MSR is only written when the floor
+ * changes, and the floor is only lowered again after the boost hold time to
+ * limit the MSR writes when tasks alternate quickly.
+ */
+static inline void intel_pstate_hwp_uclamp_update(struct cpudata *cpu)
+{
+	u64 hwp_req = READ_ONCE(cpu->hwp_req_cached);
+	u32 max_limit = (hwp_req & 0xff00) >> 8;
+	unsigned int uclamp_min;
+	u32 floor = 0;
+
+	uclamp_min = intel_pstate_current_uclamp_min();
+	if (uclamp_min)
+		floor = min_t(u32, max_limit,
+			      DIV_ROUND_UP(uclamp_min * max_limit,
+					   SCHED_CAPACITY_SCALE));
+
+	if (floor == cpu->hwp_uclamp_min)
+		return;
+
+	if (floor > cpu->hwp_uclamp_min)
+		cpu->hwp_uclamp_time = cpu->sample.time;
+	else if (time_before64(cpu->sample.time, cpu->hwp_uclamp_time +
+			       hwp_boost_hold_time_ns))
+		return;
+
+	cpu->hwp_uclamp_min = floor;
+	wrmsrl(MSR_HWP_REQUEST,
+	       intel_pstate_hwp_req_floor(cpu, hwp_req, cpu->hwp_boost_min));
+}
+
 static inline void intel_pstate_update_util_hwp_local(struct cpudata *cpu,
 						      u64 time)
 {
 	cpu->sample.time = time;
 
+	if (hwp_uclamp)
+		intel_pstate_hwp_uclamp_update(cpu);
+
+	if (!hwp_boost)
+		return;
+
 	if (cpu->sched_flags & SCHED_CPUFREQ_IOWAIT) {
 		bool do_io = false;
 
@@ -2433,7 +2522,7 @@ static void intel_pstate_set_update_util_hook(unsigned int cpu_num)
 {
 	struct cpudata *cpu = all_cpu_data[cpu_num];
 
-	if (hwp_active && !hwp_boost)
+	if (hwp_active && !hwp_boost && !hwp_uclamp)
 		return;
 
 	if (cpu->update_util_set)
@@ -2564,7 +2653,7 @@ static int intel_pstate_set_policy(struct cpufreq_policy *policy)
 		 * was turned off, in that case we need to clear the
 		 * update util hook.
 		 */
-		if (!hwp_boost)
+		if (!hwp_boost && !hwp_uclamp)
 			intel_pstate_clear_update_util_hook(policy->cpu);
 		intel_pstate_hwp_set(policy->cpu);
 	}
@@ -3499,6 +3588,8 @@ static int __init intel_pstate_setup(char *str)
 		hwp_only = 1;
 	if (!strcmp(str, "per_cpu_perf_limits"))
 		per_cpu_limits = true;
+	if (!strcmp(str, "hwp_uclamp"))
+		hwp_uclamp = true;
 
 #ifdef CONFIG_ACPI
 	if (!strcmp(str, "support_acpi_ppc"))
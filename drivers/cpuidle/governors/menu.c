@@ -10,6 +10,8 @@
 
 #include <linux/kernel.h>
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
+#include <linux/module.h>
 #include <linux/time.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
@@ -18,6 +20,7 @@
 #include <linux/sched/loadavg.h>
 #include <linux/sched/stat.h>
 #include <linux/math64.h>
+#include <linux/sched/clock.h>
 
 #define BUCKETS 12
 #define INTERVAL_SHIFT 3
@@ -158,6 +161,39 @@ static inline int performance_multiplier(unsigned int nr_iowaiters)
 
 static DEFINE_PER_CPU(struct menu_device, menu_devices);
 
+/*
+ * Percentage applied to the predicted idle duration: above 100 trades wakeup
+ * latency for energy by favouring deeper states, below 100 does the opposite.
+ */
+static unsigned int energy_bias __read_mostly = 100;
+module_param(energy_bias, uint, 0644);
+MODULE_PARM_DESC(energy_bias, "Percentage applied to the predicted idle duration (default: 100)");
+
+#ifdef CONFIG_CPU_IDLE_GOV_MENU_IRQ_TIMINGS
+static bool irq_timings __read_mostly;
+module_param(irq_timings, bool, 0444);
+MODULE_PARM_DESC(irq_timings, "Also predict idle duration from interrupt timings (default: off)");
+
+/* Time until the next interrupt predicted from the past interrupt timings */
+static u64 menu_irq_timings_next_ns(void)
+{
+	u64 now, next;
+
+	if (!irq_timings)
+		return U64_MAX;
+
+	now = local_clock();
+	next = irq_timings_next_event(now);
+
+	return next > now ? next - now : U64_MAX;
+}
+#else
+static inline u64 menu_irq_timings_next_ns(void)
+{
+	return U64_MAX;
+}
+#endif
+
 static void menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev);
 
 /*
@@ -270,7 +306,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	unsigned int predicted_us;
 	u64 predicted_ns;
 	u64 interactivity_req;
-	unsigned int nr_iowaiters;
+	unsigned int nr_iowaiters, bias;
 	ktime_t delta, delta_tick;
 	int i, idx;
 
@@ -312,6 +348,12 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	predicted_ns = (u64)min(predicted_us,
 				get_typical_interval(data, predicted_us)) *
 				NSEC_PER_USEC;
+	predicted_ns = min(predicted_ns, menu_irq_timings_next_ns());
+
+	bias = READ_ONCE(energy_bias);
+	if (unlikely(bias != 100))
+		predicted_ns = min(mul_u64_u32_div(predicted_ns, bias, 100),
+				   data->next_timer_ns);
 
 	if (tick_nohz_tick_stopped()) {
 		/*
@@ -573,6 +615,10 @@ static struct cpuidle_governor menu_governor = {
  */
 static int __init init_menu(void)
 {
+#ifdef CONFIG_CPU_IDLE_GOV_MENU_IRQ_TIMINGS
+	if (irq_timings)
+		irq_timings_enable();
+#endif
 	return cpuidle_register_governor(&menu_governor);
 }
 
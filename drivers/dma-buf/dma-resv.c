@@ -266,33 +266,16 @@ void dma_resv_reset_max_fences(struct dma_resv *obj)
 EXPORT_SYMBOL(dma_resv_reset_max_fences);
 #endif
 
-/**
- * dma_resv_add_fence - Add a fence to the dma_resv obj
- * @obj: the reservation object
- * @fence: the fence to add
- * @usage: how the fence is used, see enum dma_resv_usage
- *
- * Add a fence to a slot, @obj must be locked with dma_resv_lock(), and
- * dma_resv_reserve_fences() has been called.
- *
- * See also &dma_resv.fence for a discussion of the semantics.
- */
-void dma_resv_add_fence(struct dma_resv *obj, struct dma_fence *fence,
-			enum dma_resv_usage usage)
+/* Add a fence to a reserved slot, consuming a reference held by the caller */
+static void __dma_resv_add_fence(struct dma_resv *obj, struct dma_fence *fence,
+				 enum dma_resv_usage usage)
 {
 	struct dma_resv_list *fobj;
 	struct dma_fence *old;
 	unsigned int i, count;
 
-	dma_fence_get(fence);
-
 	dma_resv_assert_held(obj);
 
-	/* Drivers should not add containers here, instead add each fence
-	 * individually.
-	 */
-	WARN_ON(dma_fence_is_container(fence));
-
 	fobj = dma_resv_fences_list(obj);
 	count = fobj->num_fences;
 
@@ -316,8 +299,78 @@ void dma_resv_add_fence(struct dma_resv *obj, struct dma_fence *fence,
 	/* pointer update must be visible before we extend the num_fences */
 	smp_store_mb(fobj->num_fences, count);
 }
+
+/**
+ * dma_resv_add_fence - Add a fence to the dma_resv obj
+ * @obj: the reservation object
+ * @fence: the fence to add
+ * @usage: how the fence is used, see enum dma_resv_usage
+ *
+ * Add a fence to a slot, @obj must be locked with dma_resv_lock(), and
+ * dma_resv_reserve_fences() has been called.
+ *
+ * See also &dma_resv.fence for a discussion of the semantics.
+ */
+void dma_resv_add_fence(struct dma_resv *obj, struct dma_fence *fence,
+			enum dma_resv_usage usage)
+{
+	dma_fence_get(fence);
+
+	/* Drivers should not add containers here, instead add each fence
+	 * individually.
+	 */
+	WARN_ON(dma_fence_is_container(fence));
+
+	__dma_resv_add_fence(obj, fence, usage);
+}
 EXPORT_SYMBOL(dma_resv_add_fence);
 
+/**
+ * dma_resv_add_fence_bulk - Add a fence to many dma_resv objects
+ * @objs: the reservation objects
+ * @num_objs: number of entries in @objs
+ * @fence: the fence to add
+ * @usage: how the fence is used, see enum dma_resv_usage
+ *
+ * Reserve a slot in each of @objs and add @fence to all of them, as command
+ * submission does for every buffer object of a job.  All of @objs must be
+ * distinct and locked with dma_resv_lock(), usually under one
+ * ww_acquire_ctx.  The references to @fence are taken with a single atomic.
+ *
+ * Either the fence is added to all objects or, if reserving a slot fails,
+ * to none of them.
+ *
+ * RETURNS
+ * Zero for success, or -errno
+ */
+int dma_resv_add_fence_bulk(struct dma_resv **objs, unsigned int num_objs,
+			    struct dma_fence *fence, enum dma_resv_usage usage)
+{
+	unsigned int i;
+	int ret;
+
+	if (!num_objs)
+		return 0;
+
+	for (i = 0; i < num_objs; ++i) {
+		ret = dma_resv_reserve_fences(objs[i], 1);
+		if (ret)
+			return ret;
+	}
+
+	WARN_ON(dma_fence_is_container(fence));
+
+	dma_fence_get(fence);
+	if (num_objs > 1)
+		refcount_add(num_objs - 1, &fence->refcount.refcount);
+
+	for (i = 0; i < num_objs; ++i)
+		__dma_resv_add_fence(objs[i], fence, usage);
+
+	return 0;
+}
+EXPORT_SYMBOL(dma_resv_add_fence_bulk);
+
 /**
  * dma_resv_replace_fences - replace fences in the dma_resv obj
  * @obj: the reservation object
@@ -385,6 +438,19 @@ static void dma_resv_iter_walk_unlocked(struct dma_resv_iter *cursor)
 		dma_resv_list_entry(cursor->fences, cursor->index++,
 				    cursor->obj, &cursor->fence,
 				    &cursor->fence_usage);
+
+		/*
+		 * Fences are RCU protected, so they can be skipped without
+		 * taking and dropping a reference when they are already
+		 * known to be signaled or aren't of interest.
+		 */
+		if (cursor->usage < cursor->fence_usage ||
+		    test_bit(DMA_FENCE_FLAG_SIGNALED_BIT,
+			     &cursor->fence->flags)) {
+			cursor->fence = NULL;
+			continue;
+		}
+
 		cursor->fence = dma_fence_get_rcu(cursor->fence);
 		if (!cursor->fence) {
 			dma_resv_iter_restart_unlocked(cursor);
@@ -293,6 +293,73 @@ static int test_get_fences(void *arg)
 	return r;
 }
 
+static int test_add_fence_bulk(void *arg)
+{
+	enum dma_resv_usage usage = (unsigned long)arg;
+	struct dma_resv resv[4], *objs[ARRAY_SIZE(resv)];
+	struct ww_acquire_ctx ctx;
+	struct dma_fence *f;
+	int r = 0, i;
+
+	f = alloc_fence();
+	if (!f)
+		return -ENOMEM;
+
+	dma_fence_enable_sw_signaling(f);
+
+	ww_acquire_init(&ctx, &reservation_ww_class);
+	for (i = 0; i < ARRAY_SIZE(resv); i++) {
+		dma_resv_init(&resv[i]);
+		objs[i] = &resv[i];
+		r = dma_resv_lock(&resv[i], &ctx);
+		if (r) {
+			pr_err("Resv locking failed\n");
+			dma_resv_fini(&resv[i]);
+			goto err_unlock;
+		}
+	}
+	ww_acquire_done(&ctx);
+
+	r = dma_resv_add_fence_bulk(objs, ARRAY_SIZE(objs), f, usage);
+	if (r) {
+		pr_err("Resv bulk add failed\n");
+		goto err_unlock;
+	}
+
+	if (kref_read(&f->refcount) != ARRAY_SIZE(resv) + 1) {
+		pr_err("Unexpected fence refcount %u\n", kref_read(&f->refcount));
+		r = -EINVAL;
+		goto err_unlock;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(resv); i++) {
+		if (dma_resv_test_signaled(&resv[i], usage)) {
+			pr_err("Resv unexpectedly signaled\n");
+			r = -EINVAL;
+			goto err_unlock;
+		}
+	}
+
+	dma_fence_signal(f);
+	for (i = 0; i < ARRAY_SIZE(resv); i++) {
+		if (!dma_resv_test_signaled(&resv[i], usage)) {
+			pr_err("Resv not reporting signaled\n");
+			r = -EINVAL;
+			goto err_unlock;
+		}
+	}
+
+	i = ARRAY_SIZE(resv);
+err_unlock:
+	while (i--) {
+		dma_resv_unlock(&resv[i]);
+		dma_resv_fini(&resv[i]);
+	}
+	ww_acquire_fini(&ctx);
+	dma_fence_put(f);
+	return r;
+}
+
 int dma_resv(void)
 {
 	static const struct subtest tests[] = {
@@ -301,6 +368,7 @@ int dma_resv(void)
 		SUBTEST(test_for_each),
 		SUBTEST(test_for_each_unlocked),
 		SUBTEST(test_get_fences),
+		SUBTEST(test_add_fence_bulk),
 	};
 	enum dma_resv_usage usage;
 	int r;
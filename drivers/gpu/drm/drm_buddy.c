@@ -4,6 +4,7 @@
  */
 
 #include <linux/kmemleak.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/sizes.h>
 
@@ -41,7 +42,8 @@ static void drm_block_free(struct drm_buddy *mm,
 static void list_insert_sorted(struct drm_buddy *mm,
 			       struct drm_buddy_block *block)
 {
-	struct drm_buddy_block *node;
+	u64 offset = drm_buddy_block_offset(block);
+	struct drm_buddy_block *first, *last, *node;
 	struct list_head *head;
 
 	head = &mm->free_list[drm_buddy_block_order(block)];
@@ -50,11 +52,38 @@ static void list_insert_sorted(struct drm_buddy *mm,
 		return;
 	}
 
-	list_for_each_entry(node, head, link)
-		if (drm_buddy_block_offset(block) < drm_buddy_block_offset(node))
-			break;
+	/*
+	 * The free lists get long when the address space is fragmented, so
+	 * handle the ends in O(1) and otherwise walk from the end that is
+	 * closer to the new block.
+	 */
+	first = list_first_entry(head, struct drm_buddy_block, link);
+	last = list_last_entry(head, struct drm_buddy_block, link);
+
+	if (offset > drm_buddy_block_offset(last)) {
+		list_add_tail(&block->link, head);
+		return;
+	}
+
+	if (offset < drm_buddy_block_offset(first)) {
+		list_add(&block->link, head);
+		return;
+	}
+
+	if (offset - drm_buddy_block_offset(first) <
+	    drm_buddy_block_offset(last) - offset) {
+		list_for_each_entry(node, head, link)
+			if (offset < drm_buddy_block_offset(node))
+				break;
+
+		__list_add(&block->link, node->link.prev, &node->link);
+	} else {
+		list_for_each_entry_reverse(node, head, link)
+			if (offset > drm_buddy_block_offset(node))
+				break;
 
-	__list_add(&block->link, node->link.prev, &node->link);
+		list_add(&block->link, &node->link);
+	}
 }
 
 static void mark_allocated(struct drm_buddy_block *block)
@@ -221,7 +250,14 @@ static int split_block(struct drm_buddy *mm,
 	}
 
 	mark_free(mm, block->left);
-	mark_free(mm, block->right);
+
+	/*
+	 * No other block of this order can sit between the two halves, so
+	 * the right one goes straight after the left one in the sorted list.
+	 */
+	block->right->header &= ~DRM_BUDDY_HEADER_STATE;
+	block->right->header |= DRM_BUDDY_FREE;
+	list_add(&block->right->link, &block->left->link);
 
 	mark_split(block);
 
@@ -767,6 +803,7 @@ EXPORT_SYMBOL(drm_buddy_block_print);
  */
 void drm_buddy_print(struct drm_buddy *mm, struct drm_printer *p)
 {
+	u64 largest = 0;
 	int order;
 
 	drm_printf(p, "chunk_size: %lluKiB, total: %lluMiB, free: %lluMiB\n",
@@ -781,6 +818,9 @@ void drm_buddy_print(struct drm_buddy *mm, struct drm_printer *p)
 			count++;
 		}
 
+		if (count && !largest)
+			largest = mm->chunk_size << order;
+
 		drm_printf(p, "order-%d ", order);
 
 		free = count * (mm->chunk_size << order);
@@ -791,6 +831,15 @@ void drm_buddy_print(struct drm_buddy *mm, struct drm_printer *p)
 
 		drm_printf(p, ", pages: %llu\n", count);
 	}
+
+	/*
+	 * How much of the free space can't be handed out as a single block,
+	 * i.e. how likely large contiguous allocations are to fail or to
+	 * need eviction even though enough memory is free.
+	 */
+	drm_printf(p, "largest free block: %lluKiB, fragmentation: %llu%%\n",
+		   largest >> 10,
+		   mm->avail ? div64_u64((mm->avail - largest) * 100, mm->avail) : 0);
 }
 EXPORT_SYMBOL(drm_buddy_print);
 
@@ -69,6 +69,28 @@ DEFINE_EVENT(drm_sched_job, drm_run_job,
 	    TP_ARGS(sched_job, entity)
 );
 
+TRACE_EVENT(drm_sched_job_queue_wait,
+	    TP_PROTO(struct drm_sched_job *sched_job, struct drm_sched_entity *entity),
+	    TP_ARGS(sched_job, entity),
+	    TP_STRUCT__entry(
+			     __field(struct drm_sched_entity *, entity)
+			     __string(name, sched_job->sched->name)
+			     __field(uint64_t, id)
+			     __field(s64, wait_ns)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->entity = entity;
+			   __assign_str(name, sched_job->sched->name);
+			   __entry->id = sched_job->id;
+			   __entry->wait_ns = ktime_to_ns(ktime_sub(ktime_get(),
+						sched_job->submit_ts));
+			   ),
+	    TP_printk("entity=%p, id=%llu, ring=%s, queue wait:%lldns",
+		      __entry->entity, __entry->id, __get_str(name),
+		      __entry->wait_ns)
+);
+
 TRACE_EVENT(drm_sched_process_job,
 	    TP_PROTO(struct drm_sched_fence *fence),
 	    TP_ARGS(fence),
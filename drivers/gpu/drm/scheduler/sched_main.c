@@ -72,6 +72,17 @@ int drm_sched_policy = DRM_SCHED_POLICY_FIFO;
 MODULE_PARM_DESC(sched_policy, "Specify the scheduling policy for entities on a run-queue, " __stringify(DRM_SCHED_POLICY_RR) " = Round Robin, " __stringify(DRM_SCHED_POLICY_FIFO) " = FIFO (default).");
 module_param_named(sched_policy, drm_sched_policy, int, 0444);
 
+static unsigned int drm_sched_starvation_ms;
+
+/**
+ * DOC: sched_starvation_ms (uint)
+ * With the FIFO policy, let a job that has been waiting for longer than this
+ * many milliseconds run ahead of jobs from higher priority run queues, other
+ * than the kernel one. 0 (default) disables this.
+ */
+MODULE_PARM_DESC(sched_starvation_ms, "Time in ms after which a waiting job runs ahead of higher priority ones, FIFO policy only (0 = disabled (default)).");
+module_param_named(sched_starvation_ms, drm_sched_starvation_ms, uint, 0644);
+
 static __always_inline bool drm_sched_entity_compare_before(struct rb_node *a,
 							    const struct rb_node *b)
 {
@@ -228,28 +239,65 @@ drm_sched_rq_select_entity_rr(struct drm_sched_rq *rq)
  * drm_sched_rq_select_entity_fifo - Select an entity which provides a job to run
  *
  * @rq: scheduler run queue to check.
+ * @before: only consider entities whose oldest job was submitted before this
  *
  * Find oldest waiting ready entity, returns NULL if none found.
  */
 static struct drm_sched_entity *
-drm_sched_rq_select_entity_fifo(struct drm_sched_rq *rq)
+drm_sched_rq_select_entity_fifo(struct drm_sched_rq *rq, ktime_t before)
 {
+	struct drm_sched_entity *entity = NULL;
 	struct rb_node *rb;
 
 	spin_lock(&rq->lock);
 	for (rb = rb_first_cached(&rq->rb_tree_root); rb; rb = rb_next(rb)) {
-		struct drm_sched_entity *entity;
-
 		entity = rb_entry(rb, struct drm_sched_entity, rb_tree_node);
+		if (!ktime_before(entity->oldest_job_waiting, before)) {
+			entity = NULL;
+			break;
+		}
+
 		if (drm_sched_entity_is_ready(entity)) {
 			rq->current_entity = entity;
 			reinit_completion(&entity->entity_idle);
 			break;
 		}
+		entity = NULL;
 	}
 	spin_unlock(&rq->lock);
 
-	return rb ? rb_entry(rb, struct drm_sched_entity, rb_tree_node) : NULL;
+	return entity;
+}
+
+/**
+ * drm_sched_select_starved_entity - Select an entity which waited too long
+ *
+ * @sched: scheduler instance
+ *
+ * Returns the ready entity from the lowest priority non-kernel run queue whose
+ * oldest job has been waiting for longer than sched_starvation_ms, or NULL if
+ * there is none or starvation protection is disabled.
+ */
+static struct drm_sched_entity *
+drm_sched_select_starved_entity(struct drm_gpu_scheduler *sched)
+{
+	unsigned int starvation_ms = READ_ONCE(drm_sched_starvation_ms);
+	struct drm_sched_entity *entity;
+	ktime_t before;
+	int i;
+
+	if (drm_sched_policy != DRM_SCHED_POLICY_FIFO || !starvation_ms)
+		return NULL;
+
+	before = ktime_sub_ms(ktime_get(), starvation_ms);
+	for (i = DRM_SCHED_PRIORITY_MIN; i < DRM_SCHED_PRIORITY_KERNEL; i++) {
+		entity = drm_sched_rq_select_entity_fifo(&sched->sched_rq[i],
+							 before);
+		if (entity)
+			return entity;
+	}
+
+	return NULL;
 }
 
 /**
@@ -886,8 +934,19 @@ drm_sched_select_entity(struct drm_gpu_scheduler *sched)
 
 	/* Kernel run queue has higher priority than normal run queue*/
 	for (i = DRM_SCHED_PRIORITY_COUNT - 1; i >= DRM_SCHED_PRIORITY_MIN; i--) {
+		/*
+		 * Below the kernel run queue, jobs that waited too long go
+		 * first so that higher priorities can't starve them forever.
+		 */
+		if (i == DRM_SCHED_PRIORITY_KERNEL - 1) {
+			entity = drm_sched_select_starved_entity(sched);
+			if (entity)
+				break;
+		}
+
 		entity = drm_sched_policy == DRM_SCHED_POLICY_FIFO ?
-			drm_sched_rq_select_entity_fifo(&sched->sched_rq[i]) :
+			drm_sched_rq_select_entity_fifo(&sched->sched_rq[i],
+							KTIME_MAX) :
 			drm_sched_rq_select_entity_rr(&sched->sched_rq[i]);
 		if (entity)
 			break;
@@ -1038,6 +1097,7 @@ static int drm_sched_main(void *param)
 		drm_sched_job_begin(sched_job);
 
 		trace_drm_run_job(sched_job, entity);
+		trace_drm_sched_job_queue_wait(sched_job, entity);
 		fence = sched->ops->run_job(sched_job);
 		complete_all(&entity->entity_idle);
 		drm_sched_fence_scheduled(s_fence);
@@ -364,12 +364,20 @@ void ib_cq_pool_cleanup(struct ib_device *dev)
 	}
 }
 
+/*
+ * Add CQs to the device pool: one for each completion vector the first time
+ * the pool is used, and later only one on @vector, the vector that ran out
+ * of CQEs, so that the pool grows where the load is.  A CQ on @vector is
+ * always allocated, even if CPUs went offline since the caller projected
+ * its hint onto the vector range.
+ */
 static int ib_alloc_cqs(struct ib_device *dev, unsigned int nr_cqes,
-			enum ib_poll_context poll_ctx)
+			unsigned int vector, enum ib_poll_context poll_ctx)
 {
 	LIST_HEAD(tmp_list);
-	unsigned int nr_cqs, i;
+	unsigned int first, last, i;
 	struct ib_cq *cq, *n;
+	bool empty;
 	int ret;
 
 	if (poll_ctx > IB_POLL_LAST_POOL_TYPE) {
@@ -384,8 +392,22 @@ static int ib_alloc_cqs(struct ib_device *dev, unsigned int nr_cqes,
 	 */
 	nr_cqes = min_t(unsigned int, dev->attrs.max_cqe,
 			max(nr_cqes, IB_MAX_SHARED_CQ_SZ));
-	nr_cqs = min_t(unsigned int, dev->num_comp_vectors, num_online_cpus());
-	for (i = 0; i < nr_cqs; i++) {
+
+	spin_lock_irq(&dev->cq_pools_lock);
+	empty = list_empty(&dev->cq_pools[poll_ctx]);
+	spin_unlock_irq(&dev->cq_pools_lock);
+
+	if (empty) {
+		first = 0;
+		last = min_t(unsigned int, dev->num_comp_vectors,
+			     num_online_cpus());
+		last = max(last, vector + 1);
+	} else {
+		first = vector;
+		last = vector + 1;
+	}
+
+	for (i = first; i < last; i++) {
 		cq = ib_alloc_cq(dev, NULL, nr_cqes, i, poll_ctx);
 		if (IS_ERR(cq)) {
 			ret = PTR_ERR(cq);
@@ -465,8 +487,10 @@ struct ib_cq *ib_cq_pool_get(struct ib_device *dev, unsigned int nr_cqe,
 				continue;
 			if (cq->cqe_used + nr_cqe > cq->cqe)
 				continue;
-			found = cq;
-			break;
+			if (!found || cq->cqe_used < found->cqe_used)
+				found = cq;
+			if (!found->cqe_used)
+				break;
 		}
 
 		if (found) {
@@ -481,7 +505,7 @@ struct ib_cq *ib_cq_pool_get(struct ib_device *dev, unsigned int nr_cqe,
 		 * Didn't find a match or ran out of CQs in the device
 		 * pool, allocate a new array of CQs.
 		 */
-		ret = ib_alloc_cqs(dev, nr_cqe, poll_ctx);
+		ret = ib_alloc_cqs(dev, nr_cqe, vector, poll_ctx);
 		if (ret)
 			return ERR_PTR(ret);
 	}
@@ -494,14 +518,43 @@ EXPORT_SYMBOL(ib_cq_pool_get);
  * ib_cq_pool_put - Return a CQ taken from a shared pool.
  * @cq: The CQ to return.
  * @nr_cqe: The max number of cqes that the user had requested.
+ *
+ * If this was the last user of @cq and another CQ on the same completion
+ * vector is at most half used, @cq is freed so that the pool shrinks again
+ * once the load that made it grow goes away.  Requiring that much room
+ * rather than just another CQ keeps a user that comes and goes next to a
+ * full CQ from freeing and reallocating @cq every time.
  */
 void ib_cq_pool_put(struct ib_cq *cq, unsigned int nr_cqe)
 {
+	struct ib_device *dev = cq->device;
+	bool release = false;
+	struct ib_cq *other;
+
 	if (WARN_ON_ONCE(nr_cqe > cq->cqe_used))
 		return;
 
-	spin_lock_irq(&cq->device->cq_pools_lock);
+	might_sleep();
+
+	spin_lock_irq(&dev->cq_pools_lock);
 	cq->cqe_used -= nr_cqe;
-	spin_unlock_irq(&cq->device->cq_pools_lock);
+	if (!cq->cqe_used && !atomic_read(&cq->usecnt)) {
+		list_for_each_entry(other, &dev->cq_pools[cq->poll_ctx],
+				    pool_entry) {
+			if (other != cq &&
+			    other->comp_vector == cq->comp_vector &&
+			    other->cqe_used <= other->cqe / 2) {
+				list_del(&cq->pool_entry);
+				release = true;
+				break;
+			}
+		}
+	}
+	spin_unlock_irq(&dev->cq_pools_lock);
+
+	if (release) {
+		cq->shared = false;
+		ib_free_cq(cq);
+	}
 }
 EXPORT_SYMBOL(ib_cq_pool_put);
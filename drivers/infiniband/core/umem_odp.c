@@ -323,6 +323,42 @@ static int ib_umem_odp_map_dma_single_page(
 	return 0;
 }
 
+static unsigned int odp_fault_ahead;
+module_param(odp_fault_ahead, uint, 0644);
+MODULE_PARM_DESC(odp_fault_ahead,
+		 "Number of pages to fault in and map beyond a faulting range of an ODP MR (default 0)");
+
+/*
+ * Extend a faulting range that ends at @end by odp_fault_ahead pages, so that
+ * touching a fresh buffer sequentially doesn't cost one device page fault
+ * per page.  The extension stays within the umem and within the VMA of the
+ * faulting range, so that it can't make hmm_range_fault() fail on a hole or
+ * on different permissions.
+ */
+static unsigned long ib_umem_odp_fault_end(struct ib_umem_odp *umem_odp,
+					   struct mm_struct *mm,
+					   unsigned long end)
+{
+	unsigned long ahead = READ_ONCE(odp_fault_ahead);
+	struct vm_area_struct *vma;
+	unsigned long limit;
+
+	mmap_assert_locked(mm);
+
+	if (!ahead)
+		return end;
+
+	vma = vma_lookup(mm, end - 1);
+	if (!vma)
+		return end;
+
+	limit = min_t(unsigned long, vma->vm_end, ib_umem_end(umem_odp));
+	limit = ALIGN_DOWN(limit, 1UL << umem_odp->page_shift);
+
+	return max(end, min(ALIGN(end + (ahead << PAGE_SHIFT),
+				  1UL << umem_odp->page_shift), limit));
+}
+
 /**
  * ib_umem_odp_map_dma_and_lock - DMA map userspace memory in an ODP MR and lock it.
  *
@@ -336,7 +372,8 @@ static int ib_umem_odp_map_dma_single_page(
  * @umem_odp: the umem to map and pin
  * @user_virt: the address from which we need to map.
  * @bcnt: the minimal number of bytes to pin and map. The mapping might be
- *        bigger due to alignment, and may also be smaller in case of an error
+ *        bigger due to alignment or fault-ahead, and may also be smaller in
+ *        case of an error
  *        pinning or mapping a page. The actual pages mapped is returned in
  *        the return value.
  * @access_mask: bit mask of the requested access permissions for the given
@@ -353,7 +390,7 @@ int ib_umem_odp_map_dma_and_lock(struct ib_umem_odp *umem_odp, u64 user_virt,
 	unsigned int page_shift, hmm_order, pfn_start_idx;
 	unsigned long num_pfns, current_seq;
 	struct hmm_range range = {};
-	unsigned long timeout;
+	unsigned long timeout, end;
 
 	if (access_mask == 0)
 		return -EINVAL;
@@ -377,9 +414,8 @@ int ib_umem_odp_map_dma_and_lock(struct ib_umem_odp *umem_odp, u64 user_virt,
 
 	range.notifier = &umem_odp->notifier;
 	range.start = ALIGN_DOWN(user_virt, 1UL << page_shift);
-	range.end = ALIGN(user_virt + bcnt, 1UL << page_shift);
+	range.end = end = ALIGN(user_virt + bcnt, 1UL << page_shift);
 	pfn_start_idx = (range.start - ib_umem_start(umem_odp)) >> PAGE_SHIFT;
-	num_pfns = (range.end - range.start) >> PAGE_SHIFT;
 	if (fault) {
 		range.default_flags = HMM_PFN_REQ_FAULT;
 
@@ -395,6 +431,8 @@ int ib_umem_odp_map_dma_and_lock(struct ib_umem_odp *umem_odp, u64 user_virt,
 		mmu_interval_read_begin(&umem_odp->notifier);
 
 	mmap_read_lock(owning_mm);
+	if (fault)
+		range.end = ib_umem_odp_fault_end(umem_odp, owning_mm, end);
 	ret = hmm_range_fault(&range);
 	mmap_read_unlock(owning_mm);
 	if (unlikely(ret)) {
@@ -403,6 +441,8 @@ int ib_umem_odp_map_dma_and_lock(struct ib_umem_odp *umem_odp, u64 user_virt,
 		goto out_put_mm;
 	}
 
+	num_pfns = (range.end - range.start) >> PAGE_SHIFT;
+
 	start_idx = (range.start - ib_umem_start(umem_odp)) >> page_shift;
 	dma_index = start_idx;
 
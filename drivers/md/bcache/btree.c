@@ -240,27 +240,28 @@ static void btree_node_read_endio(struct bio *bio)
 	closure_put(cl);
 }
 
-static void bch_btree_node_read(struct btree *b)
+static struct bio *btree_node_read_submit(struct btree *b,
+					   struct closure *cl)
 {
-	uint64_t start_time = local_clock();
-	struct closure cl;
 	struct bio *bio;
 
 	trace_bcache_btree_read(b);
 
-	closure_init_stack(&cl);
-
 	bio = bch_bbio_alloc(b->c);
 	bio->bi_iter.bi_size = KEY_SIZE(&b->key) << 9;
 	bio->bi_end_io	= btree_node_read_endio;
-	bio->bi_private	= &cl;
+	bio->bi_private	= cl;
 	bio->bi_opf = REQ_OP_READ | REQ_META;
 
 	bch_bio_map(bio, b->keys.set[0].data);
 
 	bch_submit_bbio(bio, b->c, &b->key, 0);
-	closure_sync(&cl);
+	return bio;
+}
 
+static void btree_node_read_finish(struct btree *b, struct bio *bio,
+				   uint64_t start_time)
+{
 	if (bio->bi_status)
 		set_btree_node_io_error(b);
 
@@ -278,6 +279,20 @@ static void bch_btree_node_read(struct btree *b)
 			    PTR_BUCKET_NR(b->c, &b->key, 0));
 }
 
+static void bch_btree_node_read(struct btree *b)
+{
+	uint64_t start_time = local_clock();
+	struct closure cl;
+	struct bio *bio;
+
+	closure_init_stack(&cl);
+
+	bio = btree_node_read_submit(b, &cl);
+	closure_sync(&cl);
+
+	btree_node_read_finish(b, bio, start_time);
+}
+
 static void btree_complete_write(struct btree *b, struct btree_write *w)
 {
 	if (w->prio_blocked &&
@@ -1032,18 +1047,41 @@ struct btree *bch_btree_node_get(struct cache_set *c, struct btree_op *op,
 	return b;
 }
 
-static void btree_node_prefetch(struct btree *parent, struct bkey *k)
+#define BTREE_PREFETCH_BATCH	8
+
+/*
+ * Read the nodes for @keys, up to BTREE_PREFETCH_BATCH children of @parent,
+ * into the btree node cache with all of the reads in flight at once.
+ */
+static void btree_node_prefetch(struct btree *parent, struct bkey **keys,
+				unsigned int nr)
 {
-	struct btree *b;
+	uint64_t start_time = local_clock();
+	struct btree *b[BTREE_PREFETCH_BATCH];
+	struct bio *bio[BTREE_PREFETCH_BATCH];
+	struct closure cl;
+	unsigned int i, n = 0;
 
-	mutex_lock(&parent->c->bucket_lock);
-	b = mca_alloc(parent->c, NULL, k, parent->level - 1);
-	mutex_unlock(&parent->c->bucket_lock);
+	closure_init_stack(&cl);
 
-	if (!IS_ERR_OR_NULL(b)) {
-		b->parent = parent;
-		bch_btree_node_read(b);
-		rw_unlock(true, b);
+	for (i = 0; i < nr; i++) {
+		mutex_lock(&parent->c->bucket_lock);
+		b[n] = mca_alloc(parent->c, NULL, keys[i], parent->level - 1);
+		mutex_unlock(&parent->c->bucket_lock);
+
+		if (IS_ERR_OR_NULL(b[n]))
+			continue;
+
+		b[n]->parent = parent;
+		bio[n] = btree_node_read_submit(b[n], &cl);
+		n++;
+	}
+
+	closure_sync(&cl);
+
+	for (i = 0; i < n; i++) {
+		btree_node_read_finish(b[i], bio[i], start_time);
+		rw_unlock(true, b[i]);
 	}
 }
 
@@ -1873,8 +1911,9 @@ int bch_gc_thread_start(struct cache_set *c)
 static int bch_btree_check_recurse(struct btree *b, struct btree_op *op)
 {
 	int ret = 0;
-	struct bkey *k, *p = NULL;
+	struct bkey *k, *keys[BTREE_PREFETCH_BATCH];
 	struct btree_iter iter;
+	unsigned int i, nr;
 
 	for_each_key_filter(&b->keys, k, &iter, bch_ptr_invalid)
 		bch_initial_mark_key(b->c, b->level, k);
@@ -1885,22 +1924,25 @@ static int bch_btree_check_recurse(struct btree *b, struct btree_op *op)
 		bch_btree_iter_init(&b->keys, &iter, NULL);
 
 		do {
-			k = bch_btree_iter_next_filter(&iter, &b->keys,
-						       bch_ptr_bad);
-			if (k) {
-				btree_node_prefetch(b, k);
-				/*
-				 * initiallize c->gc_stats.nodes
-				 * for incremental GC
-				 */
-				b->c->gc_stats.nodes++;
+			/*
+			 * Read the next batch of children in parallel, this
+			 * is what warms up the node cache at attach time.
+			 */
+			for (nr = 0; nr < BTREE_PREFETCH_BATCH; nr++) {
+				k = bch_btree_iter_next_filter(&iter, &b->keys,
+							       bch_ptr_bad);
+				if (!k)
+					break;
+				keys[nr] = k;
 			}
-
-			if (p)
-				ret = bcache_btree(check_recurse, p, b, op);
-
-			p = k;
-		} while (p && !ret);
+			btree_node_prefetch(b, keys, nr);
+			/* initiallize c->gc_stats.nodes for incremental GC */
+			b->c->gc_stats.nodes += nr;
+
+			for (i = 0; i < nr && !ret; i++)
+				ret = bcache_btree(check_recurse, keys[i], b,
+						   op);
+		} while (k && !ret);
 	}
 
 	return ret;
@@ -1964,7 +2006,7 @@ static int bch_btree_check_thread(void *arg)
 		if (p) {
 			struct btree_op op;
 
-			btree_node_prefetch(c->root, p);
+			btree_node_prefetch(c->root, &p, 1);
 			c->gc_stats.nodes++;
 			bch_btree_op_init(&op, 0);
 			ret = bcache_btree(check_recurse, p, c->root, &op);
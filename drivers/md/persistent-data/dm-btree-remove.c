@@ -635,9 +635,21 @@ EXPORT_SYMBOL_GPL(dm_btree_remove);
 
 /*----------------------------------------------------------------*/
 
+/*
+ * A range removal goes through the leaves in order, so while it works on
+ * one child have the next one, if it holds keys in the range, read in.
+ */
+static void prefetch_next_child(struct dm_btree_info *info,
+				struct btree_node *n, int i, uint64_t end_key)
+{
+	if (i + 1 < le32_to_cpu(n->header.nr_entries) &&
+	    le64_to_cpu(n->keys[i + 1]) < end_key)
+		dm_bm_prefetch(dm_tm_get_bm(info->tm), value64(n, i + 1));
+}
+
 static int remove_nearest(struct shadow_spine *s, struct dm_btree_info *info,
 			  struct dm_btree_value_type *vt, dm_block_t root,
-			  uint64_t key, int *index)
+			  uint64_t key, uint64_t end_key, int *index)
 {
 	int i = *index, r;
 	struct btree_node *n;
@@ -684,6 +696,7 @@ static int remove_nearest(struct shadow_spine *s, struct dm_btree_info *info,
 		 * -ENODATA
 		 */
 		root = value64(n, i);
+		prefetch_next_child(info, n, i, end_key);
 	}
 
 	return r;
@@ -713,7 +726,7 @@ static int remove_one(struct dm_btree_info *info, dm_block_t root,
 	}
 
 	r = remove_nearest(&spine, info, &info->value_type,
-			   root, keys[last_level], &index);
+			   root, keys[last_level], end_key, &index);
 	if (r < 0)
 		goto out;
 
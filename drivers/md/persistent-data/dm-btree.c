@@ -1435,6 +1435,15 @@ static int walk_node(struct dm_btree_info *info, dm_block_t block,
 	n = dm_block_data(node);
 
 	nr = le32_to_cpu(n->header.nr_entries);
+
+	/*
+	 * All of the children are going to be visited, so get their reads
+	 * going together rather than reading them one at a time.
+	 */
+	if (le32_to_cpu(n->header.flags) & INTERNAL_NODE)
+		for (i = 0; i < nr; i++)
+			dm_bm_prefetch(dm_tm_get_bm(info->tm), value64(n, i));
+
 	for (i = 0; i < nr; i++) {
 		if (le32_to_cpu(n->header.flags) & INTERNAL_NODE) {
 			r = walk_node(info, value64(n, i), fn, context);
@@ -12,6 +12,7 @@
 
 #include <linux/bitops.h>
 #include <linux/device-mapper.h>
+#include <linux/slab.h>
 
 #define DM_MSG_PREFIX "space map common"
 
@@ -234,6 +235,57 @@ static int sm_ll_init(struct ll_disk *ll, struct dm_transaction_manager *tm)
 	return 0;
 }
 
+/*
+ * Bitmaps known to have no free entries are skipped by
+ * sm_ll_find_free_block() without looking up their index entry, which for
+ * a disk space map is a btree lookup. This is only a cache: it is kept up
+ * to date by ll_save_ie(), starts out (and is reallocated) empty, and the
+ * bits past nr_full_tracked are simply unknown.
+ */
+static void ll_track_full_bitmaps(struct ll_disk *ll, dm_block_t nr_indexes)
+{
+	if (nr_indexes <= ll->nr_full_tracked)
+		return;
+
+	kvfree(ll->full_bitmaps);
+	ll->full_bitmaps = kvcalloc(BITS_TO_LONGS(nr_indexes),
+				    sizeof(unsigned long),
+				    GFP_NOIO | __GFP_NOWARN);
+	ll->nr_full_tracked = ll->full_bitmaps ? nr_indexes : 0;
+}
+
+static bool ll_bitmap_full(struct ll_disk *ll, dm_block_t index)
+{
+	return index < ll->nr_full_tracked &&
+	       test_bit(index, ll->full_bitmaps);
+}
+
+static void ll_note_ie(struct ll_disk *ll, dm_block_t index,
+		       struct disk_index_entry *ie)
+{
+	if (index >= ll->nr_full_tracked)
+		return;
+
+	if (ie->nr_free)
+		__clear_bit(index, ll->full_bitmaps);
+	else
+		__set_bit(index, ll->full_bitmaps);
+}
+
+static int ll_save_ie(struct ll_disk *ll, dm_block_t index,
+		      struct disk_index_entry *ie)
+{
+	ll_note_ie(ll, index, ie);
+	return ll->save_ie(ll, index, ie);
+}
+
+void sm_ll_destroy(struct ll_disk *ll)
+{
+	kvfree(ll->full_bitmaps);
+	ll->full_bitmaps = NULL;
+	ll->nr_full_tracked = 0;
+}
+
 int sm_ll_extend(struct ll_disk *ll, dm_block_t extra_blocks)
 {
 	int r;
@@ -269,7 +321,7 @@ int sm_ll_extend(struct ll_disk *ll, dm_block_t extra_blocks)
 		idx.nr_free = cpu_to_le32(ll->entries_per_block);
 		idx.none_free_before = 0;
 
-		r = ll->save_ie(ll, i, &idx);
+		r = ll_save_ie(ll, i, &idx);
 		if (r < 0)
 			return r;
 	}
@@ -350,17 +402,25 @@ int sm_ll_find_free_block(struct ll_disk *ll, dm_block_t begin,
 	if (end == 0)
 		end = ll->entries_per_block;
 
+	ll_track_full_bitmaps(ll, dm_sector_div_up(ll->nr_blocks,
+						   ll->entries_per_block));
+
 	for (i = index_begin; i < index_end; i++, begin = 0) {
 		struct dm_block *blk;
 		unsigned int position;
 		uint32_t bit_end;
 
+		if (ll_bitmap_full(ll, i))
+			continue;
+
 		r = ll->load_ie(ll, i, &ie_disk);
 		if (r < 0)
 			return r;
 
-		if (le32_to_cpu(ie_disk.nr_free) == 0)
+		if (le32_to_cpu(ie_disk.nr_free) == 0) {
+			ll_note_ie(ll, i, &ie_disk);
 			continue;
+		}
 
 		r = dm_tm_read_lock(ll->tm, le64_to_cpu(ie_disk.blocknr),
 				    &dm_sm_bitmap_validator, &blk);
@@ -500,7 +560,7 @@ int sm_ll_insert(struct ll_disk *ll, dm_block_t b,
 	} else
 		*nr_allocations = 0;
 
-	return ll->save_ie(ll, index, &ie_disk);
+	return ll_save_ie(ll, index, &ie_disk);
 }
 
 /*----------------------------------------------------------------*/
@@ -740,7 +800,7 @@ static int __sm_ll_inc(struct ll_disk *ll, dm_block_t b, dm_block_t e,
 	if (r)
 		return r;
 
-	return ll->save_ie(ll, index, &ic.ie_disk);
+	return ll_save_ie(ll, index, &ic.ie_disk);
 }
 
 int sm_ll_inc(struct ll_disk *ll, dm_block_t b, dm_block_t e,
@@ -922,7 +982,7 @@ static int __sm_ll_dec(struct ll_disk *ll, dm_block_t b, dm_block_t e,
 	if (r)
 		return r;
 
-	return ll->save_ie(ll, index, &ic.ie_disk);
+	return ll_save_ie(ll, index, &ic.ie_disk);
 }
 
 int sm_ll_dec(struct ll_disk *ll, dm_block_t b, dm_block_t e,
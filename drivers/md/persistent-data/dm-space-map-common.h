@@ -96,6 +96,13 @@ struct ll_disk {
 	bool bitmap_index_changed:1;
 
 	struct ie_cache ie_cache[IE_CACHE_SIZE];
+
+	/*
+	 * In-core summary of the bitmaps with no free entries left, one
+	 * bit per index entry, see sm_ll_find_free_block().
+	 */
+	unsigned long *full_bitmaps;
+	dm_block_t nr_full_tracked;
 };
 
 struct disk_sm_root {
@@ -115,6 +122,7 @@ struct disk_bitmap_header {
 
 /*----------------------------------------------------------------*/
 
+void sm_ll_destroy(struct ll_disk *ll);
 int sm_ll_extend(struct ll_disk *ll, dm_block_t extra_blocks);
 int sm_ll_lookup_bitmap(struct ll_disk *ll, dm_block_t b, uint32_t *result);
 int sm_ll_lookup(struct ll_disk *ll, dm_block_t b, uint32_t *result);
@@ -36,6 +36,7 @@ static void sm_disk_destroy(struct dm_space_map *sm)
 {
 	struct sm_disk *smd = container_of(sm, struct sm_disk, sm);
 
+	sm_ll_destroy(&smd->ll);
 	kfree(smd);
 }
 
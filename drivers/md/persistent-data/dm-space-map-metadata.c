@@ -277,6 +277,7 @@ static void sm_metadata_destroy(struct dm_space_map *sm)
 {
 	struct sm_metadata *smm = container_of(sm, struct sm_metadata, sm);
 
+	sm_ll_destroy(&smm->ll);
 	kfree(smm);
 }
 
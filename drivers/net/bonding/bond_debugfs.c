@@ -47,6 +47,37 @@ static int bond_debug_rlb_hash_show(struct seq_file *m, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(bond_debug_rlb_hash);
 
+/* Show how transmit hashing spreads traffic over the usable slaves, in
+ * the order the hash indexes them.
+ */
+static int bond_debug_xmit_hash_show(struct seq_file *m, void *v)
+{
+	struct bonding *bond = m->private;
+	struct rtnl_link_stats64 stats;
+	struct bond_up_slave *slaves;
+	unsigned int i;
+
+	if (!bond_mode_uses_xmit_hash(bond))
+		return 0;
+
+	seq_puts(m, "Index DEV              TX packets           TX bytes\n");
+
+	rcu_read_lock();
+	slaves = rcu_dereference(bond->usable_slaves);
+	for (i = 0; slaves && i < slaves->count; i++) {
+		struct slave *slave = slaves->arr[i];
+
+		dev_get_stats(slave->dev, &stats);
+		seq_printf(m, "%-5u %-16s %-20llu %llu\n", i,
+			   slave->dev->name, stats.tx_packets,
+			   stats.tx_bytes);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bond_debug_xmit_hash);
+
 void bond_debug_register(struct bonding *bond)
 {
 	if (!bonding_debug_root)
@@ -57,6 +88,8 @@ void bond_debug_register(struct bonding *bond)
 
 	debugfs_create_file("rlb_hash_table", 0400, bond->debug_dir,
 				bond, &bond_debug_rlb_hash_fops);
+	debugfs_create_file("xmit_hash_slaves", 0400, bond->debug_dir,
+				bond, &bond_debug_xmit_hash_fops);
 }
 
 void bond_debug_unregister(struct bonding *bond)
@@ -343,6 +343,7 @@ void wg_packet_send_staged_packets(struct wg_peer *peer)
 	struct noise_keypair *keypair;
 	struct sk_buff_head packets;
 	struct sk_buff *skb;
+	u64 nonce;
 
 	/* Steal the current queue into our local one. */
 	__skb_queue_head_init(&packets);
@@ -368,17 +369,20 @@ void wg_packet_send_staged_packets(struct wg_peer *peer)
 	/* After we know we have a somewhat valid key, we now try to assign
 	 * nonces to all of the packets in the queue. If we can't assign nonces
 	 * for all of them, we just consider it a failure and wait for the next
-	 * handshake.
+	 * handshake. The whole range is reserved with a single atomic, rather
+	 * than bouncing the counter's cache line once per GSO segment.
 	 */
+	nonce = atomic64_add_return(skb_queue_len(&packets),
+				    &keypair->sending_counter) -
+		skb_queue_len(&packets);
+	if (unlikely(nonce + skb_queue_len(&packets) > REJECT_AFTER_MESSAGES))
+		goto out_invalid;
 	skb_queue_walk(&packets, skb) {
 		/* 0 for no outer TOS: no leak. TODO: at some later point, we
 		 * might consider using flowi->tos as outer instead.
 		 */
 		PACKET_CB(skb)->ds = ip_tunnel_ecn_encap(0, ip_hdr(skb), skb);
-		PACKET_CB(skb)->nonce =
-				atomic64_inc_return(&keypair->sending_counter) - 1;
-		if (unlikely(PACKET_CB(skb)->nonce >= REJECT_AFTER_MESSAGES))
-			goto out_invalid;
+		PACKET_CB(skb)->nonce = nonce++;
 	}
 
 	packets.prev->next = NULL;
@@ -372,9 +372,11 @@ static inline enum nvme_disposition nvme_decide_disposition(struct request *req)
 static inline void nvme_end_req_zoned(struct request *req)
 {
 	if (IS_ENABLED(CONFIG_BLK_DEV_ZONED) &&
-	    req_op(req) == REQ_OP_ZONE_APPEND)
+	    req_op(req) == REQ_OP_ZONE_APPEND) {
+		nvme_zone_append_end(req);
 		req->__sector = nvme_lba_to_sect(req->q->queuedata,
 			le64_to_cpu(nvme_req(req)->result.u64));
+	}
 }
 
 static inline void nvme_end_req(struct request *req)
@@ -638,6 +640,7 @@ static void nvme_free_ns(struct kref *kref)
 {
 	struct nvme_ns *ns = container_of(kref, struct nvme_ns, kref);
 
+	nvme_free_zone_info(ns);
 	put_disk(ns->disk);
 	nvme_put_ns_head(ns->head);
 	nvme_put_ctrl(ns->ctrl);
@@ -3506,6 +3509,11 @@ static struct attribute *nvme_ns_id_attrs[] = {
 #ifdef CONFIG_NVME_MULTIPATH
 	&dev_attr_ana_grpid.attr,
 	&dev_attr_ana_state.attr,
+	&dev_attr_queue_depth.attr,
+	&dev_attr_latency_ewma.attr,
+#endif
+#ifdef CONFIG_BLK_DEV_ZONED
+	&dev_attr_zone_append_stats.attr,
 #endif
 	NULL,
 };
@@ -3536,6 +3544,19 @@ static umode_t nvme_ns_id_attrs_are_visible(struct kobject *kobj,
 		if (!nvme_ctrl_use_ana(nvme_get_ns_from_dev(dev)->ctrl))
 			return 0;
 	}
+	if (a == &dev_attr_queue_depth.attr ||
+	    a == &dev_attr_latency_ewma.attr) {
+		if (dev_to_disk(dev)->fops != &nvme_bdev_ops) /* per-path attr */
+			return 0;
+	}
+#endif
+#ifdef CONFIG_BLK_DEV_ZONED
+	if (a == &dev_attr_zone_append_stats.attr) {
+		if (dev_to_disk(dev)->fops != &nvme_bdev_ops) /* per-path attr */
+			return 0;
+		if (!rcu_access_pointer(nvme_get_ns_from_dev(dev)->zone_inflight))
+			return 0;
+	}
 #endif
 	return a->mode;
 }
@@ -17,6 +17,8 @@ MODULE_PARM_DESC(multipath,
 static const char *nvme_iopolicy_names[] = {
 	[NVME_IOPOLICY_NUMA]	= "numa",
 	[NVME_IOPOLICY_RR]	= "round-robin",
+	[NVME_IOPOLICY_QD]	= "queue-depth",
+	[NVME_IOPOLICY_LAT]	= "latency",
 };
 
 static int iopolicy = NVME_IOPOLICY_NUMA;
@@ -29,6 +31,10 @@ static int nvme_set_iopolicy(const char *val, const struct kernel_param *kp)
 		iopolicy = NVME_IOPOLICY_NUMA;
 	else if (!strncmp(val, "round-robin", 11))
 		iopolicy = NVME_IOPOLICY_RR;
+	else if (!strncmp(val, "queue-depth", 11))
+		iopolicy = NVME_IOPOLICY_QD;
+	else if (!strncmp(val, "latency", 7))
+		iopolicy = NVME_IOPOLICY_LAT;
 	else
 		return -EINVAL;
 
@@ -43,7 +49,18 @@ static int nvme_get_iopolicy(char *buf, const struct kernel_param *kp)
 module_param_call(iopolicy, nvme_set_iopolicy, nvme_get_iopolicy,
 	&iopolicy, 0644);
 MODULE_PARM_DESC(iopolicy,
-	"Default multipath I/O policy; 'numa' (default) or 'round-robin'");
+	"Default multipath I/O policy; 'numa' (default), 'round-robin', 'queue-depth' or 'latency'");
+
+/*
+ * Weight of a new completion latency sample in the per-path average used by
+ * the latency iopolicy, as a power of two: 1/8.
+ */
+#define NVME_MPATH_LAT_EWMA_SHIFT	3
+
+static inline bool nvme_iopolicy_counts_active(int iopolicy)
+{
+	return iopolicy == NVME_IOPOLICY_QD || iopolicy == NVME_IOPOLICY_LAT;
+}
 
 void nvme_mpath_default_iopolicy(struct nvme_subsystem *subsys)
 {
@@ -110,6 +127,10 @@ void nvme_failover_req(struct request *req)
 	blk_steal_bios(&ns->head->requeue_list, req);
 	spin_unlock_irqrestore(&ns->head->requeue_lock, flags);
 
+	if (nvme_req(req)->flags & NVME_MPATH_CNT_ACTIVE)
+		atomic_dec_if_positive(&ns->ctrl->nr_active);
+	if (req_op(req) == REQ_OP_ZONE_APPEND)
+		nvme_zone_append_end(req);
 	blk_mq_end_request(req, 0);
 	kblockd_schedule_work(&ns->head->requeue_work);
 }
@@ -118,6 +139,17 @@ void nvme_mpath_start_request(struct request *rq)
 {
 	struct nvme_ns *ns = rq->q->queuedata;
 	struct gendisk *disk = ns->head->disk;
+	int policy = READ_ONCE(ns->head->subsys->iopolicy);
+
+	if (nvme_iopolicy_counts_active(policy) &&
+	    !(nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE)) {
+		atomic_inc(&ns->ctrl->nr_active);
+		nvme_req(rq)->flags |= NVME_MPATH_CNT_ACTIVE;
+	}
+	if (policy == NVME_IOPOLICY_LAT && !blk_rq_is_passthrough(rq)) {
+		nvme_req(rq)->mpath_start_ns = ktime_get_ns();
+		nvme_req(rq)->flags |= NVME_MPATH_CNT_LAT;
+	}
 
 	if (!blk_queue_io_stat(disk->queue) || blk_rq_is_passthrough(rq))
 		return;
@@ -128,10 +160,33 @@ void nvme_mpath_start_request(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(nvme_mpath_start_request);
 
+/*
+ * Fold the latency of a completed request into the average of its path.
+ * Concurrent completions may lose an update, which only costs a sample.
+ */
+static void nvme_mpath_update_latency(struct nvme_ctrl *ctrl, u64 start_ns)
+{
+	s64 avg = atomic64_read(&ctrl->lat_ewma_ns);
+	s64 lat = ktime_get_ns() - start_ns;
+
+	if (!avg)
+		avg = lat;
+	else
+		avg += (lat - avg) >> NVME_MPATH_LAT_EWMA_SHIFT;
+	atomic64_set(&ctrl->lat_ewma_ns, avg);
+}
+
 void nvme_mpath_end_request(struct request *rq)
 {
 	struct nvme_ns *ns = rq->q->queuedata;
 
+	/* The counter is reset when the policy is switched to queue-depth */
+	if (nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE)
+		atomic_dec_if_positive(&ns->ctrl->nr_active);
+	if (nvme_req(rq)->flags & NVME_MPATH_CNT_LAT)
+		nvme_mpath_update_latency(ns->ctrl,
+					  nvme_req(rq)->mpath_start_ns);
+
 	if (!(nvme_req(rq)->flags & NVME_MPATH_IO_STATS))
 		return;
 	bdev_end_io_acct(ns->head->disk->part0, req_op(rq),
@@ -321,6 +376,89 @@ static struct nvme_ns *nvme_round_robin_path(struct nvme_ns_head *head,
 	return found;
 }
 
+/*
+ * Pick the usable path whose controller has the fewest requests in flight,
+ * preferring optimized paths. A congested path builds up a queue and so
+ * gets less of the I/O, unlike with round-robin.
+ */
+static struct nvme_ns *nvme_queue_depth_path(struct nvme_ns_head *head)
+{
+	struct nvme_ns *best_opt = NULL, *best_nonopt = NULL, *ns;
+	unsigned int min_depth_opt = UINT_MAX, min_depth_nonopt = UINT_MAX;
+	unsigned int depth;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		depth = atomic_read(&ns->ctrl->nr_active);
+
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			if (depth < min_depth_opt) {
+				min_depth_opt = depth;
+				best_opt = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			if (depth < min_depth_nonopt) {
+				min_depth_nonopt = depth;
+				best_nonopt = ns;
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (min_depth_opt == 0)
+			return best_opt;
+	}
+
+	return best_opt ? best_opt : best_nonopt;
+}
+
+/*
+ * Pick the usable path with the lowest expected wait for a new request: its
+ * average completion latency times the requests already in flight on it,
+ * preferring optimized paths. A path without samples yet is tried first.
+ */
+static struct nvme_ns *nvme_latency_path(struct nvme_ns_head *head)
+{
+	struct nvme_ns *best_opt = NULL, *best_nonopt = NULL, *ns;
+	u64 min_cost_opt = U64_MAX, min_cost_nonopt = U64_MAX;
+	u64 cost;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		cost = atomic64_read(&ns->ctrl->lat_ewma_ns) *
+			(atomic_read(&ns->ctrl->nr_active) + 1);
+
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			if (cost < min_cost_opt) {
+				min_cost_opt = cost;
+				best_opt = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			if (cost < min_cost_nonopt) {
+				min_cost_nonopt = cost;
+				best_nonopt = ns;
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (min_cost_opt == 0)
+			return best_opt;
+	}
+
+	return best_opt ? best_opt : best_nonopt;
+}
+
 static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 {
 	return ns->ctrl->state == NVME_CTRL_LIVE &&
@@ -332,6 +470,13 @@ inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 	int node = numa_node_id();
 	struct nvme_ns *ns;
 
+	switch (READ_ONCE(head->subsys->iopolicy)) {
+	case NVME_IOPOLICY_QD:
+		return nvme_queue_depth_path(head);
+	case NVME_IOPOLICY_LAT:
+		return nvme_latency_path(head);
+	}
+
 	ns = srcu_dereference(head->current_path[node], &head->srcu);
 	if (unlikely(!ns))
 		return __nvme_find_path(head, node);
@@ -793,11 +938,28 @@ static ssize_t nvme_subsys_iopolicy_store(struct device *dev,
 {
 	struct nvme_subsystem *subsys =
 		container_of(dev, struct nvme_subsystem, dev);
+	struct nvme_ctrl *ctrl;
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(nvme_iopolicy_names); i++) {
 		if (sysfs_streq(buf, nvme_iopolicy_names[i])) {
+			mutex_lock(&subsys->lock);
+			/*
+			 * Requests started under another policy were not
+			 * counted, start the per-path statistics over.
+			 */
+			if (nvme_iopolicy_counts_active(i) &&
+			    !nvme_iopolicy_counts_active(subsys->iopolicy))
+				list_for_each_entry(ctrl, &subsys->ctrls,
+						    subsys_entry)
+					atomic_set(&ctrl->nr_active, 0);
+			if (i == NVME_IOPOLICY_LAT &&
+			    subsys->iopolicy != NVME_IOPOLICY_LAT)
+				list_for_each_entry(ctrl, &subsys->ctrls,
+						    subsys_entry)
+					atomic64_set(&ctrl->lat_ewma_ns, 0);
 			WRITE_ONCE(subsys->iopolicy, i);
+			mutex_unlock(&subsys->lock);
 			return count;
 		}
 	}
@@ -823,6 +985,31 @@ static ssize_t ana_state_show(struct device *dev, struct device_attribute *attr,
 }
 DEVICE_ATTR_RO(ana_state);
 
+static ssize_t queue_depth_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+
+	if (!nvme_iopolicy_counts_active(READ_ONCE(ns->head->subsys->iopolicy)))
+		return 0;
+
+	return sysfs_emit(buf, "%d\n", atomic_read(&ns->ctrl->nr_active));
+}
+DEVICE_ATTR_RO(queue_depth);
+
+static ssize_t latency_ewma_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+
+	if (READ_ONCE(ns->head->subsys->iopolicy) != NVME_IOPOLICY_LAT)
+		return 0;
+
+	return sysfs_emit(buf, "%lld\n",
+			  atomic64_read(&ns->ctrl->lat_ewma_ns));
+}
+DEVICE_ATTR_RO(latency_ewma);
+
 static int nvme_lookup_ana_group_desc(struct nvme_ctrl *ctrl,
 		struct nvme_ana_group_desc *desc, void *data)
 {
@@ -895,6 +1082,8 @@ void nvme_mpath_init_ctrl(struct nvme_ctrl *ctrl)
 	mutex_init(&ctrl->ana_lock);
 	timer_setup(&ctrl->anatt_timer, nvme_anatt_timeout, 0);
 	INIT_WORK(&ctrl->ana_work, nvme_ana_work);
+	atomic_set(&ctrl->nr_active, 0);
+	atomic64_set(&ctrl->lat_ewma_ns, 0);
 }
 
 int nvme_mpath_init_identify(struct nvme_ctrl *ctrl, struct nvme_id_ctrl *id)
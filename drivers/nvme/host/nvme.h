@@ -169,6 +169,7 @@ struct nvme_request {
 	u16			status;
 #ifdef CONFIG_NVME_MULTIPATH
 	unsigned long		start_time;
+	u64			mpath_start_ns;
 #endif
 	struct nvme_ctrl	*ctrl;
 };
@@ -182,6 +183,9 @@ enum {
 	NVME_REQ_CANCELLED		= (1 << 0),
 	NVME_REQ_USERCMD		= (1 << 1),
 	NVME_MPATH_IO_STATS		= (1 << 2),
+	NVME_MPATH_CNT_ACTIVE		= (1 << 3),
+	NVME_REQ_ZONE_APPEND		= (1 << 4),
+	NVME_MPATH_CNT_LAT		= (1 << 5),
 };
 
 static inline struct nvme_request *nvme_req(struct request *req)
@@ -342,6 +346,8 @@ struct nvme_ctrl {
 	size_t ana_log_size;
 	struct timer_list anatt_timer;
 	struct work_struct ana_work;
+	atomic_t nr_active;	/* requests in flight, for queue-depth iopolicy */
+	atomic64_t lat_ewma_ns;	/* completion latency, for latency iopolicy */
 #endif
 
 #ifdef CONFIG_NVME_AUTH
@@ -384,6 +390,8 @@ struct nvme_ctrl {
 enum nvme_iopolicy {
 	NVME_IOPOLICY_NUMA,
 	NVME_IOPOLICY_RR,
+	NVME_IOPOLICY_QD,
+	NVME_IOPOLICY_LAT,
 };
 
 struct nvme_subsystem {
@@ -490,6 +498,9 @@ struct nvme_ns {
 	u8 guard_type;
 #ifdef CONFIG_BLK_DEV_ZONED
 	u64 zsze;
+	/* zone appends in flight per zone */
+	struct nvme_zone_inflight __rcu *zone_inflight;
+	struct nvme_zone_stats __percpu *zone_stats;
 #endif
 	unsigned long features;
 	unsigned long flags;
@@ -905,6 +916,8 @@ static inline void nvme_trace_bio_complete(struct request *req)
 extern bool multipath;
 extern struct device_attribute dev_attr_ana_grpid;
 extern struct device_attribute dev_attr_ana_state;
+extern struct device_attribute dev_attr_queue_depth;
+extern struct device_attribute dev_attr_latency_ewma;
 extern struct device_attribute subsys_attr_iopolicy;
 
 #else
@@ -990,10 +1003,30 @@ int nvme_revalidate_zones(struct nvme_ns *ns);
 int nvme_ns_report_zones(struct nvme_ns *ns, sector_t sector,
 		unsigned int nr_zones, report_zones_cb cb, void *data);
 #ifdef CONFIG_BLK_DEV_ZONED
+/*
+ * Zone Append commands issued, by the number of appends in flight to the
+ * same zone at issue time: 1, 2, 3-4, 5-8, 9-16 and more.
+ */
+#define NVME_ZONE_DEPTH_BUCKETS	6
+
+struct nvme_zone_stats {
+	unsigned long depth[NVME_ZONE_DEPTH_BUCKETS];
+};
+
+struct nvme_zone_inflight {
+	struct rcu_head rcu;
+	unsigned int nr_zones;
+	atomic_t depth[];
+};
+
 int nvme_update_zone_info(struct nvme_ns *ns, unsigned lbaf);
+void nvme_free_zone_info(struct nvme_ns *ns);
 blk_status_t nvme_setup_zone_mgmt_send(struct nvme_ns *ns, struct request *req,
 				       struct nvme_command *cmnd,
 				       enum nvme_zone_mgmt_action action);
+void nvme_zone_append_start(struct request *req);
+void nvme_zone_append_end(struct request *req);
+extern struct device_attribute dev_attr_zone_append_stats;
 #else
 static inline blk_status_t nvme_setup_zone_mgmt_send(struct nvme_ns *ns,
 		struct request *req, struct nvme_command *cmnd,
@@ -1008,6 +1041,18 @@ static inline int nvme_update_zone_info(struct nvme_ns *ns, unsigned lbaf)
 		 "Please enable CONFIG_BLK_DEV_ZONED to support ZNS devices\n");
 	return -EPROTONOSUPPORT;
 }
+
+static inline void nvme_free_zone_info(struct nvme_ns *ns)
+{
+}
+
+static inline void nvme_zone_append_start(struct request *req)
+{
+}
+
+static inline void nvme_zone_append_end(struct request *req)
+{
+}
 #endif
 
 static inline struct nvme_ns *nvme_get_ns_from_dev(struct device *dev)
@@ -1033,6 +1078,8 @@ static inline void nvme_start_request(struct request *rq)
 {
 	if (rq->cmd_flags & REQ_NVME_MPATH)
 		nvme_mpath_start_request(rq);
+	if (req_op(rq) == REQ_OP_ZONE_APPEND)
+		nvme_zone_append_start(rq);
 	blk_mq_start_request(rq);
 }
 
@@ -10,6 +10,7 @@
 #include <linux/blk-mq.h>
 #include <linux/blk-mq-pci.h>
 #include <linux/blk-integrity.h>
+#include <linux/debugfs.h>
 #include <linux/dmi.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
@@ -21,6 +22,7 @@
 #include <linux/mutex.h>
 #include <linux/once.h>
 #include <linux/pci.h>
+#include <linux/seq_file.h>
 #include <linux/suspend.h>
 #include <linux/t10-pi.h>
 #include <linux/types.h>
@@ -101,6 +103,11 @@ static unsigned int poll_queues;
 module_param_cb(poll_queues, &io_queue_count_ops, &poll_queues, 0644);
 MODULE_PARM_DESC(poll_queues, "Number of queues to use for polled IO.");
 
+static bool poll_stats;
+module_param(poll_stats, bool, 0644);
+MODULE_PARM_DESC(poll_stats,
+	"Track the poll hit rate and completion latency of poll queues.");
+
 static bool noacpi;
 module_param(noacpi, bool, 0444);
 MODULE_PARM_DESC(noacpi, "disable acpi bios quirks");
@@ -159,6 +166,7 @@ struct nvme_dev {
 	unsigned int nr_allocated_queues;
 	unsigned int nr_write_queues;
 	unsigned int nr_poll_queues;
+	struct dentry *debugfs;
 };
 
 static int io_queue_depth_set(const char *val, const struct kernel_param *kp)
@@ -182,6 +190,23 @@ static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
 	return container_of(ctrl, struct nvme_dev, ctrl);
 }
 
+/*
+ * Completion latency is tracked separately for reads and writes, by
+ * power-of-two transfer size from 512 bytes to 64k and above.
+ */
+#define NVME_POLL_SIZE_BUCKETS	8
+#define NVME_POLL_BUCKETS	(2 * NVME_POLL_SIZE_BUCKETS)
+
+/*
+ * Polling statistics of a poll queue.  They are only informational and
+ * the poll counters are updated without serialisation between pollers.
+ */
+struct nvme_poll_stats {
+	u64 mean_ns[NVME_POLL_BUCKETS];	/* EWMA of completion latency */
+	u64 polls;
+	u64 hits;
+};
+
 /*
  * An NVM Express queue.  Each device has at least two (one for admin
  * commands and one for I/O commands).
@@ -214,6 +239,7 @@ struct nvme_queue {
 	__le32 *dbbuf_sq_ei;
 	__le32 *dbbuf_cq_ei;
 	struct completion delete_done;
+	struct nvme_poll_stats poll_stats;
 };
 
 union nvme_descriptor {
@@ -234,6 +260,7 @@ struct nvme_iod {
 	s8 nr_allocations;	/* PRP list pool allocations. 0 means small
 				   pool in use */
 	unsigned int dma_len;	/* length of single DMA segment mapping */
+	u64 start_ns;		/* submission time, for poll_stats */
 	dma_addr_t first_dma;
 	dma_addr_t meta_dma;
 	struct sg_table sgt;
@@ -822,6 +849,18 @@ static blk_status_t nvme_map_data(struct nvme_dev *dev, struct request *req,
 	return ret;
 }
 
+static inline unsigned int nvme_poll_bucket(struct request *req)
+{
+	unsigned int size = max_t(unsigned int, blk_rq_bytes(req), SZ_512);
+	unsigned int bucket;
+
+	bucket = min_t(unsigned int, ilog2(size) - SECTOR_SHIFT,
+		       NVME_POLL_SIZE_BUCKETS - 1);
+	if (op_is_write(req_op(req)))
+		bucket += NVME_POLL_SIZE_BUCKETS;
+	return bucket;
+}
+
 static blk_status_t nvme_map_metadata(struct nvme_dev *dev, struct request *req,
 		struct nvme_command *cmnd)
 {
@@ -843,6 +882,7 @@ static blk_status_t nvme_prep_rq(struct nvme_dev *dev, struct request *req)
 	iod->aborted = false;
 	iod->nr_allocations = -1;
 	iod->sgt.nents = 0;
+	iod->start_ns = 0;
 
 	ret = nvme_setup_cmd(req->q->queuedata, req);
 	if (ret)
@@ -860,6 +900,9 @@ static blk_status_t nvme_prep_rq(struct nvme_dev *dev, struct request *req)
 			goto out_unmap_data;
 	}
 
+	if (poll_stats && req->mq_hctx->type == HCTX_TYPE_POLL)
+		iod->start_ns = ktime_get_ns();
+
 	nvme_start_request(req);
 	return BLK_STS_OK;
 out_unmap_data:
@@ -1010,6 +1053,25 @@ static inline struct blk_mq_tags *nvme_queue_tagset(struct nvme_queue *nvmeq)
 	return nvmeq->dev->tagset.tags[nvmeq->qid - 1];
 }
 
+/* Called with cq_poll_lock held */
+static void nvme_poll_account(struct nvme_queue *nvmeq, struct request *req)
+{
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+	u64 *mean;
+	u64 lat;
+
+	if (!iod->start_ns)
+		return;
+	lat = ktime_get_ns() - iod->start_ns;
+	iod->start_ns = 0;
+
+	mean = &nvmeq->poll_stats.mean_ns[nvme_poll_bucket(req)];
+	if (*mean)
+		WRITE_ONCE(*mean, *mean - (*mean >> 3) + (lat >> 3));
+	else
+		WRITE_ONCE(*mean, lat);
+}
+
 static inline void nvme_handle_cqe(struct nvme_queue *nvmeq,
 				   struct io_comp_batch *iob, u16 idx)
 {
@@ -1038,6 +1100,8 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq,
 	}
 
 	trace_nvme_sq(req, cqe->sq_head, nvmeq->sq_tail);
+	if (test_bit(NVMEQ_POLLED, &nvmeq->flags))
+		nvme_poll_account(nvmeq, req);
 	if (!nvme_try_complete_req(req, cqe->status, cqe->result) &&
 	    !blk_mq_add_to_batch(req, iob, nvme_req(req)->status,
 					nvme_pci_complete_batch))
@@ -1129,6 +1193,29 @@ static int nvme_poll(struct blk_mq_hw_ctx *hctx, struct io_comp_batch *iob)
 	return found;
 }
 
+static void nvme_poll_update_stats(struct nvme_queue *nvmeq, int found)
+{
+	struct nvme_poll_stats *ps = &nvmeq->poll_stats;
+
+	ps->polls++;
+	if (found)
+		ps->hits++;
+}
+
+static int nvme_poll_account_hits(struct blk_mq_hw_ctx *hctx,
+				  struct io_comp_batch *iob)
+{
+	struct nvme_queue *nvmeq = hctx->driver_data;
+	int found;
+
+	if (!poll_stats)
+		return nvme_poll(hctx, iob);
+
+	found = nvme_poll(hctx, iob);
+	nvme_poll_update_stats(nvmeq, found);
+	return found;
+}
+
 static void nvme_pci_submit_async_event(struct nvme_ctrl *ctrl)
 {
 	struct nvme_dev *dev = to_nvme_dev(ctrl);
@@ -1566,6 +1653,7 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 {
 	struct nvme_dev *dev = nvmeq->dev;
 
+	memset(&nvmeq->poll_stats, 0, sizeof(nvmeq->poll_stats));
 	nvmeq->sq_tail = 0;
 	nvmeq->last_sq_tail = 0;
 	nvmeq->cq_head = 0;
@@ -1668,7 +1756,7 @@ static const struct blk_mq_ops nvme_mq_ops = {
 	.init_request	= nvme_pci_init_request,
 	.map_queues	= nvme_pci_map_queues,
 	.timeout	= nvme_timeout,
-	.poll		= nvme_poll,
+	.poll		= nvme_poll_account_hits,
 };
 
 static void nvme_dev_remove_admin(struct nvme_dev *dev)
@@ -2974,6 +3062,36 @@ static struct nvme_dev *nvme_pci_alloc_dev(struct pci_dev *pdev,
 	return ERR_PTR(ret);
 }
 
+static struct dentry *nvme_pci_debugfs_root;
+
+static int nvme_poll_stats_show(struct seq_file *m, void *v)
+{
+	struct nvme_dev *dev = m->private;
+	unsigned int i, b;
+
+	for (i = 1; i < dev->online_queues; i++) {
+		struct nvme_queue *nvmeq = &dev->queues[i];
+		struct nvme_poll_stats *ps = &nvmeq->poll_stats;
+
+		if (!test_bit(NVMEQ_POLLED, &nvmeq->flags))
+			continue;
+
+		seq_printf(m, "queue %u: polls %llu hits %llu\n",
+			   i, ps->polls, ps->hits);
+		for (b = 0; b < NVME_POLL_BUCKETS; b++) {
+			u64 mean = READ_ONCE(ps->mean_ns[b]);
+
+			if (!mean)
+				continue;
+			seq_printf(m, "  %s %u: mean_ns %llu\n",
+				   b < NVME_POLL_SIZE_BUCKETS ? "read" : "write",
+				   SZ_512 << (b % NVME_POLL_SIZE_BUCKETS), mean);
+		}
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(nvme_poll_stats);
+
 static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 {
 	struct nvme_dev *dev;
@@ -3052,6 +3170,9 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	nvme_start_ctrl(&dev->ctrl);
 	nvme_put_ctrl(&dev->ctrl);
 	flush_work(&dev->ctrl.scan_work);
+
+	dev->debugfs = debugfs_create_file(dev_name(&pdev->dev), 0400,
+			nvme_pci_debugfs_root, dev, &nvme_poll_stats_fops);
 	return 0;
 
 out_disable:
@@ -3112,6 +3233,7 @@ static void nvme_remove(struct pci_dev *pdev)
 
 	nvme_change_ctrl_state(&dev->ctrl, NVME_CTRL_DELETING);
 	pci_set_drvdata(pdev, NULL);
+	debugfs_remove(dev->debugfs);
 
 	if (!pci_device_is_present(pdev)) {
 		nvme_change_ctrl_state(&dev->ctrl, NVME_CTRL_DEAD);
@@ -3491,6 +3613,8 @@ static struct pci_driver nvme_driver = {
 
 static int __init nvme_init(void)
 {
+	int ret;
+
 	BUILD_BUG_ON(sizeof(struct nvme_create_cq) != 64);
 	BUILD_BUG_ON(sizeof(struct nvme_create_sq) != 64);
 	BUILD_BUG_ON(sizeof(struct nvme_delete_queue) != 64);
@@ -3499,12 +3623,17 @@ static int __init nvme_init(void)
 	BUILD_BUG_ON(sizeof(struct scatterlist) * NVME_MAX_SEGS > PAGE_SIZE);
 	BUILD_BUG_ON(nvme_pci_npages_prp() > NVME_MAX_NR_ALLOCATIONS);
 
-	return pci_register_driver(&nvme_driver);
+	nvme_pci_debugfs_root = debugfs_create_dir("nvme-pci", NULL);
+	ret = pci_register_driver(&nvme_driver);
+	if (ret)
+		debugfs_remove_recursive(nvme_pci_debugfs_root);
+	return ret;
 }
 
 static void __exit nvme_exit(void)
 {
 	pci_unregister_driver(&nvme_driver);
+	debugfs_remove_recursive(nvme_pci_debugfs_root);
 	flush_workqueue(nvme_wq);
 }
 
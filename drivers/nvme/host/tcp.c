@@ -31,6 +31,20 @@ static int so_priority;
 module_param(so_priority, int, 0644);
 MODULE_PARM_DESC(so_priority, "nvme tcp socket optimize priority");
 
+/*
+ * By default a request is only sent from the submitting context if it runs
+ * on the queue's io_cpu, to avoid contending with io_work for the socket.
+ * When the queue is idle there is nothing to contend with, and sending
+ * inline saves the io_work context switch.
+ */
+static bool send_inline;
+module_param(send_inline, bool, 0644);
+MODULE_PARM_DESC(send_inline,
+	"send from the submitting context on any cpu when the queue is idle");
+
+/* Maximum number of command PDUs sent in one sendmsg */
+#define NVME_TCP_SEND_BATCH	16
+
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 /* lockdep can detect a circular dependency of the form
  *   sk_lock -> mmap_lock (page fault) -> fs locks -> sk_lock
@@ -348,7 +362,7 @@ static inline void nvme_tcp_queue_request(struct nvme_tcp_request *req,
 	 * directly, otherwise queue io_work. Also, only do that if we
 	 * are on the same cpu, so we don't introduce contention.
 	 */
-	if (queue->io_cpu == raw_smp_processor_id() &&
+	if ((send_inline || queue->io_cpu == raw_smp_processor_id()) &&
 	    sync && empty && mutex_trylock(&queue->send_mutex)) {
 		nvme_tcp_send_all(queue);
 		mutex_unlock(&queue->send_mutex);
@@ -1089,6 +1103,75 @@ static int nvme_tcp_try_send_cmd_pdu(struct nvme_tcp_request *req)
 	return -EAGAIN;
 }
 
+static inline bool nvme_tcp_can_batch(struct nvme_tcp_request *req)
+{
+	return req->state == NVME_TCP_SEND_CMD_PDU && !req->offset &&
+		!nvme_tcp_has_inline_data(req);
+}
+
+/*
+ * Send the command PDU of the current request together with those of the
+ * requests queued behind it in a single sendmsg, as long as none of them
+ * carries in-capsule data.  Requests are taken off the send_list before
+ * sending, as they may complete as soon as their PDU is on the wire; the
+ * ones that did not fit into the socket are put back.
+ */
+static int nvme_tcp_try_send_cmd_batch(struct nvme_tcp_queue *queue)
+{
+	struct nvme_tcp_request *reqs[NVME_TCP_SEND_BATCH];
+	struct kvec iov[NVME_TCP_SEND_BATCH];
+	struct msghdr msg = { .msg_flags = MSG_DONTWAIT };
+	struct nvme_tcp_request *req, *tmp;
+	size_t len = sizeof(struct nvme_tcp_cmd_pdu) +
+			nvme_tcp_hdgst_len(queue);
+	int nr = 0, i, ret;
+
+	reqs[nr++] = queue->request;
+	list_for_each_entry_safe(req, tmp, &queue->send_list, entry) {
+		if (nr == NVME_TCP_SEND_BATCH || !nvme_tcp_can_batch(req))
+			break;
+		list_del(&req->entry);
+		reqs[nr++] = req;
+	}
+
+	for (i = 0; i < nr; i++) {
+		void *pdu = nvme_tcp_req_cmd_pdu(reqs[i]);
+
+		if (queue->hdr_digest)
+			nvme_tcp_hdgst(queue->snd_hash, pdu,
+				       sizeof(struct nvme_tcp_cmd_pdu));
+		iov[i].iov_base = pdu;
+		iov[i].iov_len = len;
+	}
+
+	if (nvme_tcp_queue_more(queue))
+		msg.msg_flags |= MSG_MORE;
+	else
+		msg.msg_flags |= MSG_EOR;
+
+	ret = kernel_sendmsg(queue->sock, &msg, iov, nr, nr * len);
+	if (unlikely(ret <= 0)) {
+		i = 1;
+		goto requeue;
+	}
+
+	i = ret / len;
+	if (i == nr) {
+		nvme_tcp_done_send_req(queue);
+		return 1;
+	}
+
+	/* reqs[i] was sent in part, it becomes the current request */
+	queue->request = reqs[i];
+	reqs[i]->offset = ret % len;
+	ret = i ? 1 : -EAGAIN;
+	i++;
+requeue:
+	while (--nr >= i)
+		list_add(&reqs[nr]->entry, &queue->send_list);
+	return ret;
+}
+
 static int nvme_tcp_try_send_data_pdu(struct nvme_tcp_request *req)
 {
 	struct nvme_tcp_queue *queue = req->queue;
@@ -1170,6 +1253,15 @@ static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 	req = queue->request;
 
 	noreclaim_flag = memalloc_noreclaim_save();
+	if (nvme_tcp_can_batch(req)) {
+		if (list_empty(&queue->send_list))
+			nvme_tcp_process_req_list(queue);
+		if (!list_empty(&queue->send_list)) {
+			ret = nvme_tcp_try_send_cmd_batch(queue);
+			goto done;
+		}
+	}
+
 	if (req->state == NVME_TCP_SEND_CMD_PDU) {
 		ret = nvme_tcp_try_send_cmd_pdu(req);
 		if (ret <= 0)
@@ -1229,19 +1321,28 @@ static void nvme_tcp_io_work(struct work_struct *w)
 	unsigned long deadline = jiffies + msecs_to_jiffies(1);
 
 	do {
-		bool pending = false;
+		bool pending = false, sent = false;
 		int result;
 
 		if (mutex_trylock(&queue->send_mutex)) {
 			result = nvme_tcp_try_send(queue);
 			mutex_unlock(&queue->send_mutex);
 			if (result > 0)
-				pending = true;
+				pending = sent = true;
 			else if (unlikely(result < 0))
 				break;
 		}
 
 		result = nvme_tcp_try_recv(queue);
+		if (!result && sent && sk_can_busy_loop(queue->sock->sk)) {
+			/*
+			 * A response is on its way for what was just sent,
+			 * poll the device queue for it once rather than
+			 * waiting for the interrupt and data_ready.
+			 */
+			sk_busy_loop(queue->sock->sk, true);
+			result = nvme_tcp_try_recv(queue);
+		}
 		if (result > 0)
 			pending = true;
 		else if (unlikely(result < 0))
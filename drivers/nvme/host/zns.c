@@ -46,6 +46,140 @@ static int nvme_set_max_append(struct nvme_ctrl *ctrl)
 	return 0;
 }
 
+/*
+ * Called with the queue frozen, so no zone append can be in flight while the
+ * per-zone counters are replaced.  The sysfs attribute may still be reading
+ * the old counters, so they are freed after an RCU grace period.
+ *
+ * The counters are only statistics: if they can't be allocated, zone
+ * appends are simply not accounted and the namespace works as before.
+ */
+static void nvme_alloc_zone_stats(struct nvme_ns *ns)
+{
+	unsigned int nr_zones = (get_capacity(ns->disk) + ns->zsze - 1) >>
+					ilog2(ns->zsze);
+	struct nvme_zone_inflight *zi, *old;
+
+	if (!ns->zone_stats)
+		ns->zone_stats = alloc_percpu_gfp(struct nvme_zone_stats,
+						  GFP_KERNEL | __GFP_NOWARN);
+
+	old = rcu_dereference_protected(ns->zone_inflight, 1);
+	if (old && old->nr_zones == nr_zones)
+		return;
+
+	zi = kvzalloc(struct_size(zi, depth, nr_zones),
+		      GFP_KERNEL | __GFP_NOWARN);
+	if (zi)
+		zi->nr_zones = nr_zones;
+	else
+		dev_warn(ns->ctrl->device,
+			 "no zone append statistics for namespace:%u\n",
+			 ns->head->ns_id);
+	rcu_assign_pointer(ns->zone_inflight, zi);
+	if (old)
+		kvfree_rcu(old, rcu);
+}
+
+void nvme_free_zone_info(struct nvme_ns *ns)
+{
+	kvfree(rcu_dereference_protected(ns->zone_inflight, 1));
+	free_percpu(ns->zone_stats);
+}
+
+/*
+ * The counters are only replaced with the queue frozen, so they are stable
+ * while the request is in flight.
+ */
+static inline atomic_t *nvme_zone_inflight(struct nvme_ns *ns,
+		struct request *req)
+{
+	struct nvme_zone_inflight *zi =
+		rcu_dereference_protected(ns->zone_inflight, 1);
+	unsigned int zno = blk_rq_pos(req) >> ilog2(ns->zsze);
+
+	if (unlikely(!zi || zno >= zi->nr_zones))
+		return NULL;
+	return &zi->depth[zno];
+}
+
+void nvme_zone_append_start(struct request *req)
+{
+	struct nvme_ns *ns = req->q->queuedata;
+	atomic_t *inflight;
+	unsigned int depth;
+
+	/* a retried request is still accounted for */
+	if (nvme_req(req)->flags & NVME_REQ_ZONE_APPEND)
+		return;
+
+	inflight = nvme_zone_inflight(ns, req);
+	if (!inflight)
+		return;
+
+	depth = atomic_inc_return(inflight);
+	if (ns->zone_stats)
+		this_cpu_inc(ns->zone_stats->depth[min_t(unsigned int,
+			order_base_2(depth), NVME_ZONE_DEPTH_BUCKETS - 1)]);
+	nvme_req(req)->flags |= NVME_REQ_ZONE_APPEND;
+}
+
+/* Must be called before the request's sector is set to the append result */
+void nvme_zone_append_end(struct request *req)
+{
+	struct nvme_ns *ns = req->q->queuedata;
+
+	if (!(nvme_req(req)->flags & NVME_REQ_ZONE_APPEND))
+		return;
+
+	nvme_req(req)->flags &= ~NVME_REQ_ZONE_APPEND;
+	atomic_dec(nvme_zone_inflight(ns, req));
+}
+
+static ssize_t zone_append_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	static const char * const depth_names[NVME_ZONE_DEPTH_BUCKETS] = {
+		"1", "2", "3-4", "5-8", "9-16", "17+",
+	};
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+	struct nvme_zone_inflight *zi;
+	unsigned long depth[NVME_ZONE_DEPTH_BUCKETS] = { };
+	unsigned int i, busy = 0, max = 0;
+	ssize_t len = 0;
+	int cpu;
+
+	if (ns->zone_stats) {
+		for_each_possible_cpu(cpu) {
+			struct nvme_zone_stats *stats =
+				per_cpu_ptr(ns->zone_stats, cpu);
+
+			for (i = 0; i < NVME_ZONE_DEPTH_BUCKETS; i++)
+				depth[i] += READ_ONCE(stats->depth[i]);
+		}
+	}
+
+	rcu_read_lock();
+	zi = rcu_dereference(ns->zone_inflight);
+	for (i = 0; zi && i < zi->nr_zones; i++) {
+		unsigned int d = atomic_read(&zi->depth[i]);
+
+		if (d) {
+			busy++;
+			max = max(max, d);
+		}
+	}
+	rcu_read_unlock();
+
+	for (i = 0; i < NVME_ZONE_DEPTH_BUCKETS; i++)
+		len += sysfs_emit_at(buf, len, "depth %s: %lu\n",
+				     depth_names[i], depth[i]);
+	len += sysfs_emit_at(buf, len, "busy zones: %u\n", busy);
+	len += sysfs_emit_at(buf, len, "max zone depth: %u\n", max);
+	return len;
+}
+DEVICE_ATTR_RO(zone_append_stats);
+
 int nvme_update_zone_info(struct nvme_ns *ns, unsigned lbaf)
 {
 	struct nvme_effects_log *log = ns->head->effects;
@@ -109,6 +243,8 @@ int nvme_update_zone_info(struct nvme_ns *ns, unsigned lbaf)
 		goto free_data;
 	}
 
+	nvme_alloc_zone_stats(ns);
+
 	disk_set_zoned(ns->disk, BLK_ZONED_HM);
 	blk_queue_flag_set(QUEUE_FLAG_ZONE_RESETALL, q);
 	disk_set_max_open_zones(ns->disk, le32_to_cpu(id->mor) + 1);
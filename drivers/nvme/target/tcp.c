@@ -11,6 +11,7 @@
 #include <linux/nvme-tcp.h>
 #include <net/sock.h>
 #include <net/tcp.h>
+#include <net/busy_poll.h>
 #include <linux/inet.h>
 #include <linux/llist.h>
 #include <crypto/hash.h>
@@ -66,6 +67,16 @@ device_param_cb(idle_poll_period_usecs, &set_param_ops,
 MODULE_PARM_DESC(idle_poll_period_usecs,
 		"nvmet tcp io_work poll till idle time period in usecs: Default 0");
 
+/* Define the time (in usecs) that io_work() may busy poll the NIC receive
+ * queue of a connection when it finds nothing to do, instead of going
+ * back to waiting for the next interrupt.  This requires a NIC driver
+ * with NAPI busy poll support, and costs CPU time for lower latency.
+ */
+static int busy_poll_usecs;
+device_param_cb(busy_poll_usecs, &set_param_ops, &busy_poll_usecs, 0644);
+MODULE_PARM_DESC(busy_poll_usecs,
+		"nvmet tcp socket busy poll time in usecs: Default 0");
+
 #define NVMET_TCP_RECV_BUDGET		8
 #define NVMET_TCP_SEND_BUDGET		8
 #define NVMET_TCP_IO_WORK_BUDGET	64
@@ -1302,13 +1313,28 @@ static void nvmet_tcp_io_work(struct work_struct *w)
 {
 	struct nvmet_tcp_queue *queue =
 		container_of(w, struct nvmet_tcp_queue, io_work);
+	struct sock *sk = queue->sock->sk;
+	struct blk_plug plug;
 	bool pending;
 	int ret, ops = 0;
 
 	do {
 		pending = false;
 
+		/*
+		 * Plug across the commands received in one pass, so that the
+		 * I/O the backends issue for them, file backed kiocbs as well
+		 * as bios, is merged and dispatched together.
+		 */
+		blk_start_plug(&plug);
 		ret = nvmet_tcp_try_recv(queue, NVMET_TCP_RECV_BUDGET, &ops);
+		if (!ret && sk_can_busy_loop(sk) &&
+		    skb_queue_empty_lockless(&sk->sk_receive_queue)) {
+			sk_busy_loop(sk, true);
+			ret = nvmet_tcp_try_recv(queue, NVMET_TCP_RECV_BUDGET,
+						 &ops);
+		}
+		blk_finish_plug(&plug);
 		if (ret > 0)
 			pending = true;
 		else if (ret < 0)
@@ -1580,6 +1606,9 @@ static int nvmet_tcp_set_queue_sock(struct nvmet_tcp_queue *queue)
 	if (so_priority > 0)
 		sock_set_priority(sock->sk, so_priority);
 
+	if (busy_poll_usecs > 0)
+		WRITE_ONCE(sock->sk->sk_ll_usec, busy_poll_usecs);
+
 	/* Set socket type of service */
 	if (inet->rcv_tos > 0)
 		ip_sock_set_tos(sock->sk, inet->rcv_tos);
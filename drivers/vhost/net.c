@@ -99,6 +99,22 @@ struct vhost_net_ubuf_ref {
 };
 
 #define VHOST_NET_BATCH 64
+
+static int vhost_net_batch_set(const char *val, const struct kernel_param *kp)
+{
+	return param_set_uint_minmax(val, kp, 1, VHOST_NET_BATCH);
+}
+
+static const struct kernel_param_ops vhost_net_batch_ops = {
+	.set = vhost_net_batch_set,
+	.get = param_get_uint,
+};
+
+/* Number of packets handled between used ring updates, at most 64 */
+static unsigned int batch = VHOST_NET_BATCH;
+module_param_cb(batch, &vhost_net_batch_ops, &batch, 0644);
+MODULE_PARM_DESC(batch, "Number of packets batched per used ring update (1-64)");
+
 struct vhost_net_buf {
 	void **queue;
 	int tail;
@@ -127,6 +143,9 @@ struct vhost_net_virtqueue {
 	struct vhost_net_buf rxq;
 	/* Batched XDP buffs */
 	struct xdp_buff *xdp;
+	/* Busy poll time currently used, adapted within
+	 * [busyloop_timeout / 8, busyloop_timeout]. */
+	unsigned long busyloop_cur;
 };
 
 struct vhost_net {
@@ -180,7 +199,7 @@ static int vhost_net_buf_produce(struct vhost_net_virtqueue *nvq)
 
 	rxq->head = 0;
 	rxq->tail = ptr_ring_consume_batched(nvq->rx_ring, rxq->queue,
-					      VHOST_NET_BATCH);
+					      READ_ONCE(batch));
 	return rxq->tail;
 }
 
@@ -524,10 +543,13 @@ static void vhost_net_busy_poll(struct vhost_net *net,
 				bool *busyloop_intr,
 				bool poll_rx)
 {
+	struct vhost_net_virtqueue *nvq =
+		container_of(poll_rx ? rvq : tvq, struct vhost_net_virtqueue, vq);
 	unsigned long busyloop_timeout;
 	unsigned long endtime;
 	struct socket *sock;
 	struct vhost_virtqueue *vq = poll_rx ? tvq : rvq;
+	bool found = false;
 
 	/* Try to hold the vq mutex of the paired virtqueue. We can't
 	 * use mutex_lock() here since we could not guarantee a
@@ -541,26 +563,41 @@ static void vhost_net_busy_poll(struct vhost_net *net,
 
 	busyloop_timeout = poll_rx ? rvq->busyloop_timeout:
 				     tvq->busyloop_timeout;
+	/*
+	 * Spinning for the whole timeout only pays off if work tends to
+	 * show up within it.  Halve the time spun after each poll that
+	 * came up empty, and double it again after each that found work.
+	 */
+	nvq->busyloop_cur = clamp(nvq->busyloop_cur, busyloop_timeout >> 3,
+				  busyloop_timeout);
 
 	preempt_disable();
-	endtime = busy_clock() + busyloop_timeout;
+	endtime = busy_clock() + nvq->busyloop_cur;
 
 	while (vhost_can_busy_poll(endtime)) {
-		if (vhost_has_work(&net->dev)) {
+		if (vhost_vq_has_work(poll_rx ? rvq : tvq)) {
 			*busyloop_intr = true;
 			break;
 		}
 
 		if ((sock_has_rx_data(sock) &&
 		     !vhost_vq_avail_empty(&net->dev, rvq)) ||
-		    !vhost_vq_avail_empty(&net->dev, tvq))
+		    !vhost_vq_avail_empty(&net->dev, tvq)) {
+			found = true;
 			break;
+		}
 
 		cpu_relax();
 	}
 
 	preempt_enable();
 
+	if (found)
+		nvq->busyloop_cur = min(nvq->busyloop_cur << 1,
+					busyloop_timeout);
+	else if (!*busyloop_intr)
+		nvq->busyloop_cur >>= 1;
+
 	if (poll_rx || sock_has_rx_data(sock))
 		vhost_net_busy_poll_try_queue(net, vq);
 	else if (!poll_rx) /* On tx here, sock has no rx data. */
@@ -787,7 +824,7 @@ static void handle_tx_copy(struct vhost_net *net, struct socket *sock)
 	do {
 		bool busyloop_intr = false;
 
-		if (nvq->done_idx == VHOST_NET_BATCH)
+		if (nvq->done_idx >= READ_ONCE(batch))
 			vhost_tx_batch(net, nvq, sock, &msg);
 
 		head = get_tx_bufs(net, nvq, &msg, &out, &in, &len,
@@ -1236,7 +1273,7 @@ static void handle_rx(struct vhost_net *net)
 			goto out;
 		}
 		nvq->done_idx += headcount;
-		if (nvq->done_idx > VHOST_NET_BATCH)
+		if (nvq->done_idx > READ_ONCE(batch))
 			vhost_net_signal_used(nvq);
 		if (unlikely(vq_log))
 			vhost_log_write(vq, vq_log, log, vhost_len,
@@ -1332,6 +1369,7 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 		n->vqs[i].upend_idx = 0;
 		n->vqs[i].done_idx = 0;
 		n->vqs[i].batched_xdp = 0;
+		n->vqs[i].busyloop_cur = 0;
 		n->vqs[i].vhost_hlen = 0;
 		n->vqs[i].sock_hlen = 0;
 		n->vqs[i].rx_ring = NULL;
@@ -1342,8 +1380,10 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 		       VHOST_NET_PKT_WEIGHT, VHOST_NET_WEIGHT, true,
 		       NULL);
 
-	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, EPOLLOUT, dev);
-	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, EPOLLIN, dev);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, EPOLLOUT, dev,
+			vqs[VHOST_NET_VQ_TX]);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, EPOLLIN, dev,
+			vqs[VHOST_NET_VQ_RX]);
 
 	f->private_data = n;
 	n->page_frag.page = NULL;
@@ -49,6 +49,9 @@ enum {
 #define vhost_used_event(vq) ((__virtio16 __user *)&vq->avail->ring[vq->num])
 #define vhost_avail_event(vq) ((__virtio16 __user *)&vq->used->ring[vq->num])
 
+/* IOTLB messages of one write applied per acquisition of the vq locks */
+#define VHOST_IOTLB_MSG_BATCH 8
+
 #ifdef CONFIG_VHOST_CROSS_ENDIAN_LEGACY
 static void vhost_disable_cross_endian(struct vhost_virtqueue *vq)
 {
@@ -185,14 +188,16 @@ void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn)
 }
 EXPORT_SYMBOL_GPL(vhost_work_init);
 
-/* Init poll structure */
+/* Init poll structure. Its work runs on the worker of @vq if set. */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev)
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -231,36 +236,62 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_dev_flush(struct vhost_dev *dev)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->vtsk->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
-		init_completion(&flush.wait_event);
-		vhost_work_init(&flush.work, vhost_flush_work);
+	init_completion(&flush.wait_event);
+	vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
-		wait_for_completion(&flush.wait_event);
-	}
+	vhost_worker_queue(worker, &flush.work);
+	wait_for_completion(&flush.wait_event);
+}
+
+void vhost_dev_flush(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker;
+	unsigned long i;
+
+	xa_for_each(&dev->worker_xa, i, worker)
+		vhost_worker_flush(worker);
 }
 EXPORT_SYMBOL_GPL(vhost_dev_flush);
 
+/* Queue work that is not tied to a virtqueue on the default worker */
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 {
 	if (!dev->worker)
 		return;
 
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->worker->work_list);
-		wake_up_process(dev->worker->vtsk->task);
-	}
+	vhost_worker_queue(dev->worker, work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	struct vhost_worker *worker;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	if (worker)
+		vhost_worker_queue(worker, work);
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
 bool vhost_has_work(struct vhost_dev *dev)
 {
@@ -268,9 +299,28 @@ bool vhost_has_work(struct vhost_dev *dev)
 }
 EXPORT_SYMBOL_GPL(vhost_has_work);
 
+/* Like vhost_has_work(), for the worker the virtqueue is bound to */
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
+{
+	struct vhost_worker *worker;
+	bool has_work = false;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	if (worker && !llist_empty(&worker->work_list))
+		has_work = true;
+	rcu_read_unlock();
+
+	return has_work;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -280,6 +330,9 @@ static void __vhost_vq_meta_reset(struct vhost_virtqueue *vq)
 
 	for (j = 0; j < VHOST_NUM_ADDRS; j++)
 		vq->meta_iotlb[j] = NULL;
+	for (j = 0; j < VHOST_IOTLB_CACHE_SIZE; j++)
+		vq->iotlb_cache[j] = NULL;
+	vq->iotlb_cache_next = 0;
 }
 
 static void vhost_vq_meta_reset(struct vhost_dev *d)
@@ -469,6 +522,7 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->iotlb = NULL;
 	dev->mm = NULL;
 	dev->worker = NULL;
+	xa_init_flags(&dev->worker_xa, XA_FLAGS_ALLOC);
 	dev->iov_limit = iov_limit;
 	dev->weight = weight;
 	dev->byte_weight = byte_weight;
@@ -486,11 +540,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		RCU_INIT_POINTER(vq->worker, NULL);
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					EPOLLIN, dev);
+					EPOLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -540,49 +595,145 @@ static void vhost_detach_mm(struct vhost_dev *dev)
 	dev->mm = NULL;
 }
 
-static void vhost_worker_free(struct vhost_dev *dev)
+static void vhost_worker_destroy(struct vhost_dev *dev,
+				 struct vhost_worker *worker)
+{
+	WARN_ON(worker->attachment_cnt);
+	WARN_ON(!llist_empty(&worker->work_list));
+	xa_erase(&dev->worker_xa, worker->id);
+	vhost_task_stop(worker->vtsk);
+	kfree(worker);
+}
+
+static void vhost_workers_free(struct vhost_dev *dev)
 {
-	struct vhost_worker *worker = dev->worker;
+	struct vhost_worker *worker;
+	unsigned long i;
 
-	if (!worker)
+	if (!dev->use_worker)
 		return;
 
+	for (i = 0; i < dev->nvqs; i++) {
+		struct vhost_virtqueue *vq = dev->vqs[i];
+
+		worker = rcu_dereference_protected(vq->worker, true);
+		if (worker)
+			worker->attachment_cnt--;
+		RCU_INIT_POINTER(vq->worker, NULL);
+	}
+	/* vq->worker is not used by anyone once the device is stopped */
+	xa_for_each(&dev->worker_xa, i, worker)
+		vhost_worker_destroy(dev, worker);
 	dev->worker = NULL;
-	WARN_ON(!llist_empty(&worker->work_list));
-	vhost_task_stop(worker->vtsk);
-	kfree(worker);
+	xa_destroy(&dev->worker_xa);
 }
 
-static int vhost_worker_create(struct vhost_dev *dev)
+/*
+ * Workers are threads of the owner created with vhost_task_create(), so they
+ * are in the owner's cgroups and inherit its CPU affinity, and their busy
+ * time is accounted as the CPU time of the "vhost-<pid>" threads.
+ */
+static struct vhost_worker *vhost_worker_create(struct vhost_dev *dev)
 {
 	struct vhost_worker *worker;
 	struct vhost_task *vtsk;
 	char name[TASK_COMM_LEN];
+	u32 id;
 	int ret;
 
 	worker = kzalloc(sizeof(*worker), GFP_KERNEL_ACCOUNT);
 	if (!worker)
-		return -ENOMEM;
+		return NULL;
 
-	dev->worker = worker;
 	worker->kcov_handle = kcov_common_handle();
 	init_llist_head(&worker->work_list);
 	snprintf(name, sizeof(name), "vhost-%d", current->pid);
 
 	vtsk = vhost_task_create(vhost_worker, worker, name);
-	if (!vtsk) {
-		ret = -ENOMEM;
+	if (!vtsk)
 		goto free_worker;
-	}
 
+	ret = xa_alloc(&dev->worker_xa, &id, worker, xa_limit_32b,
+		       GFP_KERNEL);
+	if (ret < 0)
+		goto stop_worker;
+
+	worker->id = id;
 	worker->vtsk = vtsk;
 	vhost_task_start(vtsk);
-	return 0;
+	return worker;
 
+stop_worker:
+	vhost_task_stop(vtsk);
 free_worker:
 	kfree(worker);
-	dev->worker = NULL;
-	return ret;
+	return NULL;
+}
+
+/* Caller must have device mutex */
+static void vhost_vq_attach_worker(struct vhost_virtqueue *vq,
+				   struct vhost_worker *worker)
+{
+	struct vhost_worker *old_worker;
+
+	old_worker = rcu_dereference_check(vq->worker,
+					   lockdep_is_held(&vq->dev->mutex));
+	worker->attachment_cnt++;
+	rcu_assign_pointer(vq->worker, worker);
+	if (!old_worker || old_worker == worker) {
+		if (old_worker)
+			old_worker->attachment_cnt--;
+		return;
+	}
+
+	old_worker->attachment_cnt--;
+	/*
+	 * Once nobody can still be queueing through the old pointer, wait
+	 * for the work already queued on the old worker, so that the vq's
+	 * handlers do not keep running there after this returns.
+	 */
+	synchronize_rcu();
+	vhost_worker_flush(old_worker);
+}
+
+/* Caller must have device mutex */
+static long vhost_new_worker(struct vhost_dev *dev,
+			     struct vhost_worker_state __user *argp)
+{
+	struct vhost_worker_state state;
+	struct vhost_worker *worker;
+
+	worker = vhost_worker_create(dev);
+	if (!worker)
+		return -ENOMEM;
+
+	state.worker_id = worker->id;
+	if (copy_to_user(argp, &state, sizeof(state))) {
+		vhost_worker_destroy(dev, worker);
+		return -EFAULT;
+	}
+	return 0;
+}
+
+/* Caller must have device mutex */
+static long vhost_free_worker(struct vhost_dev *dev,
+			      struct vhost_worker_state __user *argp)
+{
+	struct vhost_worker_state state;
+	struct vhost_worker *worker;
+
+	if (copy_from_user(&state, argp, sizeof(state)))
+		return -EFAULT;
+
+	worker = xa_load(&dev->worker_xa, state.worker_id);
+	if (!worker)
+		return -ENODEV;
+	/* The default worker also runs work not tied to a virtqueue */
+	if (worker->attachment_cnt || worker == dev->worker)
+		return -EBUSY;
+
+	vhost_worker_destroy(dev, worker);
+	return 0;
 }
 
 /* Caller should have device mutex */
@@ -599,9 +750,16 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 	vhost_attach_mm(dev);
 
 	if (dev->use_worker) {
-		err = vhost_worker_create(dev);
-		if (err)
+		int i;
+
+		dev->worker = vhost_worker_create(dev);
+		if (!dev->worker) {
+			err = -ENOMEM;
 			goto err_worker;
+		}
+
+		for (i = 0; i < dev->nvqs; i++)
+			vhost_vq_attach_worker(dev->vqs[i], dev->worker);
 	}
 
 	err = vhost_dev_alloc_iovecs(dev);
@@ -610,7 +768,7 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	return 0;
 err_iovecs:
-	vhost_worker_free(dev);
+	vhost_workers_free(dev);
 err_worker:
 	vhost_detach_mm(dev);
 err_mm:
@@ -703,7 +861,7 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, EPOLLIN | EPOLLRDNORM);
-	vhost_worker_free(dev);
+	vhost_workers_free(dev);
 	vhost_detach_mm(dev);
 }
 EXPORT_SYMBOL_GPL(vhost_dev_cleanup);
@@ -1076,67 +1234,72 @@ static bool umem_access_ok(u64 uaddr, u64 size, int access)
 	return true;
 }
 
-static int vhost_process_iotlb_msg(struct vhost_dev *dev, u32 asid,
-				   struct vhost_iotlb_msg *msg)
+static int __vhost_process_iotlb_msg(struct vhost_dev *dev,
+				     struct vhost_iotlb_msg *msg)
 {
-	int ret = 0;
-
-	if (asid != 0)
-		return -EINVAL;
-
-	mutex_lock(&dev->mutex);
-	vhost_dev_lock_vqs(dev);
 	switch (msg->type) {
 	case VHOST_IOTLB_UPDATE:
-		if (!dev->iotlb) {
-			ret = -EFAULT;
-			break;
-		}
-		if (!umem_access_ok(msg->uaddr, msg->size, msg->perm)) {
-			ret = -EFAULT;
-			break;
-		}
+		if (!dev->iotlb)
+			return -EFAULT;
+		if (!umem_access_ok(msg->uaddr, msg->size, msg->perm))
+			return -EFAULT;
 		vhost_vq_meta_reset(dev);
 		if (vhost_iotlb_add_range(dev->iotlb, msg->iova,
 					  msg->iova + msg->size - 1,
-					  msg->uaddr, msg->perm)) {
-			ret = -ENOMEM;
-			break;
-		}
+					  msg->uaddr, msg->perm))
+			return -ENOMEM;
 		vhost_iotlb_notify_vq(dev, msg);
-		break;
+		return 0;
 	case VHOST_IOTLB_INVALIDATE:
-		if (!dev->iotlb) {
-			ret = -EFAULT;
-			break;
-		}
+		if (!dev->iotlb)
+			return -EFAULT;
 		vhost_vq_meta_reset(dev);
 		vhost_iotlb_del_range(dev->iotlb, msg->iova,
 				      msg->iova + msg->size - 1);
-		break;
+		return 0;
 	default:
-		ret = -EINVAL;
-		break;
+		return -EINVAL;
 	}
+}
 
+/*
+ * Apply a batch of IOTLB messages under a single acquisition of the device
+ * and virtqueue locks. Returns the number of messages applied, or the error
+ * of the first one if none could be.
+ */
+static int vhost_process_iotlb_msgs(struct vhost_dev *dev,
+				    struct vhost_iotlb_msg *msgs, int n)
+{
+	int i, ret = 0;
+
+	mutex_lock(&dev->mutex);
+	vhost_dev_lock_vqs(dev);
+	for (i = 0; i < n; i++) {
+		ret = __vhost_process_iotlb_msg(dev, &msgs[i]);
+		if (ret)
+			break;
+	}
 	vhost_dev_unlock_vqs(dev);
 	mutex_unlock(&dev->mutex);
 
-	return ret;
+	return i ? i : ret;
 }
-ssize_t vhost_chr_write_iter(struct vhost_dev *dev,
-			     struct iov_iter *from)
+
+/*
+ * Copy one IOTLB message out of @from. Returns the number of bytes it took
+ * up in the stream, or -EINVAL if it is malformed.
+ */
+static int vhost_parse_iotlb_msg(struct vhost_dev *dev, struct iov_iter *from,
+				 u32 *asid, struct vhost_iotlb_msg *msg)
 {
-	struct vhost_iotlb_msg msg;
 	size_t offset;
 	int type, ret;
-	u32 asid = 0;
+
+	*asid = 0;
 
 	ret = copy_from_iter(&type, sizeof(type), from);
-	if (ret != sizeof(type)) {
-		ret = -EINVAL;
-		goto done;
-	}
+	if (ret != sizeof(type))
+		return -EINVAL;
 
 	switch (type) {
 	case VHOST_IOTLB_MSG:
@@ -1148,47 +1311,81 @@ ssize_t vhost_chr_write_iter(struct vhost_dev *dev,
 	case VHOST_IOTLB_MSG_V2:
 		if (vhost_backend_has_feature(dev->vqs[0],
 					      VHOST_BACKEND_F_IOTLB_ASID)) {
-			ret = copy_from_iter(&asid, sizeof(asid), from);
-			if (ret != sizeof(asid)) {
-				ret = -EINVAL;
-				goto done;
-			}
+			ret = copy_from_iter(asid, sizeof(*asid), from);
+			if (ret != sizeof(*asid))
+				return -EINVAL;
 			offset = 0;
 		} else
 			offset = sizeof(__u32);
 		break;
 	default:
-		ret = -EINVAL;
-		goto done;
+		return -EINVAL;
 	}
 
 	iov_iter_advance(from, offset);
-	ret = copy_from_iter(&msg, sizeof(msg), from);
-	if (ret != sizeof(msg)) {
-		ret = -EINVAL;
-		goto done;
-	}
+	ret = copy_from_iter(msg, sizeof(*msg), from);
+	if (ret != sizeof(*msg))
+		return -EINVAL;
 
-	if ((msg.type == VHOST_IOTLB_UPDATE ||
-	     msg.type == VHOST_IOTLB_INVALIDATE) &&
-	     msg.size == 0) {
-		ret = -EINVAL;
-		goto done;
-	}
+	if ((msg->type == VHOST_IOTLB_UPDATE ||
+	     msg->type == VHOST_IOTLB_INVALIDATE) &&
+	     msg->size == 0)
+		return -EINVAL;
 
-	if (dev->msg_handler)
-		ret = dev->msg_handler(dev, asid, &msg);
-	else
-		ret = vhost_process_iotlb_msg(dev, asid, &msg);
-	if (ret) {
-		ret = -EFAULT;
-		goto done;
+	return (type == VHOST_IOTLB_MSG) ? sizeof(struct vhost_msg) :
+	       sizeof(struct vhost_msg_v2);
+}
+
+/*
+ * A single write may carry several messages back to back. Without a
+ * backend message handler they are applied in batches, so that e.g. a
+ * guest unmapping a large buffer does not take the device and every
+ * virtqueue lock once per invalidated range. Processing stops at the first
+ * message that is malformed or fails, and the number of bytes of the
+ * messages applied before it is returned.
+ */
+ssize_t vhost_chr_write_iter(struct vhost_dev *dev,
+			     struct iov_iter *from)
+{
+	struct vhost_iotlb_msg msgs[VHOST_IOTLB_MSG_BATCH];
+	int lens[VHOST_IOTLB_MSG_BATCH];
+	ssize_t done = 0;
+	int i, n, ret;
+	u32 asid;
+
+	ret = vhost_parse_iotlb_msg(dev, from, &asid, &msgs[0]);
+	if (ret < 0)
+		return ret;
+	lens[0] = ret;
+
+	if (dev->msg_handler) {
+		if (dev->msg_handler(dev, asid, &msgs[0]))
+			return -EFAULT;
+		return lens[0];
 	}
 
-	ret = (type == VHOST_IOTLB_MSG) ? sizeof(struct vhost_msg) :
-	      sizeof(struct vhost_msg_v2);
-done:
-	return ret;
+	if (asid != 0)
+		return -EFAULT;
+
+	n = 1;
+	for (;;) {
+		while (n < VHOST_IOTLB_MSG_BATCH &&
+		       iov_iter_count(from) >= sizeof(struct vhost_msg)) {
+			ret = vhost_parse_iotlb_msg(dev, from, &asid, &msgs[n]);
+			if (ret < 0 || asid != 0)
+				break;
+			lens[n++] = ret;
+		}
+
+		ret = vhost_process_iotlb_msgs(dev, msgs, n);
+		if (ret < 0)
+			return done ? done : -EFAULT;
+		for (i = 0; i < ret; i++)
+			done += lens[i];
+		if (ret < n || n < VHOST_IOTLB_MSG_BATCH)
+			return done;
+		n = 0;
+	}
 }
 EXPORT_SYMBOL(vhost_chr_write_iter);
 
@@ -1476,6 +1673,7 @@ static long vhost_set_memory(struct vhost_dev *d, struct vhost_memory __user *m)
 	for (i = 0; i < d->nvqs; ++i) {
 		mutex_lock(&d->vqs[i]->mutex);
 		d->vqs[i]->umem = newumem;
+		__vhost_vq_meta_reset(d->vqs[i]);
 		mutex_unlock(&d->vqs[i]->mutex);
 	}
 
@@ -1586,6 +1784,42 @@ static long vhost_vring_set_num_addr(struct vhost_dev *d,
 
 	return r;
 }
+/* Caller must have device mutex */
+static long vhost_vring_worker_ioctl(struct vhost_dev *d,
+				     struct vhost_virtqueue *vq,
+				     unsigned int ioctl, void __user *argp)
+{
+	struct vhost_vring_worker ring_worker;
+	struct vhost_worker *worker;
+
+	if (!d->use_worker || !d->worker)
+		return -EINVAL;
+
+	switch (ioctl) {
+	case VHOST_ATTACH_VRING_WORKER:
+		if (copy_from_user(&ring_worker, argp, sizeof(ring_worker)))
+			return -EFAULT;
+		worker = xa_load(&d->worker_xa, ring_worker.worker_id);
+		if (!worker)
+			return -ENODEV;
+		vhost_vq_attach_worker(vq, worker);
+		return 0;
+	case VHOST_GET_VRING_WORKER:
+		if (copy_from_user(&ring_worker, argp, sizeof(ring_worker)))
+			return -EFAULT;
+		worker = rcu_dereference_check(vq->worker,
+					       lockdep_is_held(&d->mutex));
+		if (!worker)
+			return -EINVAL;
+		ring_worker.worker_id = worker->id;
+		if (copy_to_user(argp, &ring_worker, sizeof(ring_worker)))
+			return -EFAULT;
+		return 0;
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
 long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *argp)
 {
 	struct file *eventfp, *filep = NULL;
@@ -1612,6 +1846,10 @@ long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *arg
 		return vhost_vring_set_num_addr(d, vq, ioctl, argp);
 	}
 
+	if (ioctl == VHOST_ATTACH_VRING_WORKER ||
+	    ioctl == VHOST_GET_VRING_WORKER)
+		return vhost_vring_worker_ioctl(d, vq, ioctl, argp);
+
 	mutex_lock(&vq->mutex);
 
 	switch (ioctl) {
@@ -1813,6 +2051,20 @@ long vhost_dev_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *argp)
 		if (ctx)
 			eventfd_ctx_put(ctx);
 		break;
+	case VHOST_NEW_WORKER:
+		if (!d->use_worker || !d->worker) {
+			r = -EINVAL;
+			break;
+		}
+		r = vhost_new_worker(d, argp);
+		break;
+	case VHOST_FREE_WORKER:
+		if (!d->use_worker || !d->worker) {
+			r = -EINVAL;
+			break;
+		}
+		r = vhost_free_worker(d, argp);
+		break;
 	default:
 		r = -ENOIOCTLCMD;
 		break;
@@ -2040,6 +2292,35 @@ int vhost_vq_init_access(struct vhost_virtqueue *vq)
 }
 EXPORT_SYMBOL_GPL(vhost_vq_init_access);
 
+/*
+ * Descriptors tend to land in the same few mappings over and over, so look
+ * in the maps that recently translated an address for this virtqueue
+ * before walking the interval tree. The cache is emptied together with
+ * meta_iotlb whenever the maps may go away.
+ */
+static const struct vhost_iotlb_map *
+vhost_iotlb_lookup(struct vhost_virtqueue *vq, struct vhost_iotlb *umem,
+		   u64 addr, u64 last)
+{
+	const struct vhost_iotlb_map *map;
+	int i;
+
+	for (i = 0; i < VHOST_IOTLB_CACHE_SIZE; i++) {
+		map = vq->iotlb_cache[i];
+		if (map && map->start <= addr && addr <= map->last)
+			return map;
+	}
+
+	map = vhost_iotlb_itree_first(umem, addr, last);
+	if (map && map->start <= addr) {
+		vq->iotlb_cache[vq->iotlb_cache_next] = map;
+		vq->iotlb_cache_next = (vq->iotlb_cache_next + 1) %
+				       VHOST_IOTLB_CACHE_SIZE;
+	}
+
+	return map;
+}
+
 static int translate_desc(struct vhost_virtqueue *vq, u64 addr, u32 len,
 			  struct iovec iov[], int iov_size, int access)
 {
@@ -2057,7 +2338,7 @@ static int translate_desc(struct vhost_virtqueue *vq, u64 addr, u32 len,
 			break;
 		}
 
-		map = vhost_iotlb_itree_first(umem, addr, last);
+		map = vhost_iotlb_lookup(vq, umem, addr, last);
 		if (map == NULL || map->start > addr) {
 			if (umem != dev->iotlb) {
 				ret = -EFAULT;
@@ -18,6 +18,8 @@
 #include <linux/wait.h>
 #include <linux/mm.h>
 #include <linux/page_reporting.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 
 /*
  * Balloon device works in 4K page units.  So each page is pointed to by
@@ -39,6 +41,32 @@
 	(1 << (VIRTIO_BALLOON_HINT_BLOCK_ORDER + PAGE_SHIFT))
 #define VIRTIO_BALLOON_HINT_BLOCK_PAGES (1 << VIRTIO_BALLOON_HINT_BLOCK_ORDER)
 
+static unsigned int report_order;
+module_param(report_order, uint, 0444);
+MODULE_PARM_DESC(report_order,
+		 "Minimum order of free page blocks to report to the host (0: default)");
+
+static int report_batch_set(const char *val, const struct kernel_param *kp)
+{
+	return param_set_uint_minmax(val, kp, 1, PAGE_REPORTING_CAPACITY);
+}
+
+static const struct kernel_param_ops report_batch_ops = {
+	.set = report_batch_set,
+	.get = param_get_uint,
+};
+
+/*
+ * Free page reports are split into buffers of this many blocks, which are
+ * all handed to the host at once so that it can work on them in parallel.
+ */
+static unsigned int report_batch = PAGE_REPORTING_CAPACITY;
+module_param_cb(report_batch, &report_batch_ops, &report_batch, 0644);
+MODULE_PARM_DESC(report_batch,
+		 "Free page blocks per reporting buffer (1-" __stringify(PAGE_REPORTING_CAPACITY) ")");
+
+static struct dentry *virtio_balloon_debugfs_root;
+
 enum virtio_balloon_vq {
 	VIRTIO_BALLOON_VQ_INFLATE,
 	VIRTIO_BALLOON_VQ_DEFLATE,
@@ -119,6 +147,13 @@ struct virtio_balloon {
 	/* Free page reporting device */
 	struct virtqueue *reporting_vq;
 	struct page_reporting_dev_info pr_dev_info;
+
+	/* Free page reporting statistics, only updated by the reporting work */
+	u64 reported_pages;
+	u64 reports;
+	u64 report_ns;
+	u64 report_max_ns;
+	struct dentry *debugfs;
 };
 
 static const struct virtio_device_id id_table[] = {
@@ -158,32 +193,90 @@ static void tell_host(struct virtio_balloon *vb, struct virtqueue *vq)
 
 }
 
+static bool virtballoon_free_page_reported(struct virtqueue *vq,
+					   unsigned int *inflight)
+{
+	unsigned int unused;
+
+	while (*inflight && virtqueue_get_buf(vq, &unused))
+		(*inflight)--;
+
+	return !*inflight;
+}
+
 static int virtballoon_free_page_report(struct page_reporting_dev_info *pr_dev_info,
 				   struct scatterlist *sg, unsigned int nents)
 {
 	struct virtio_balloon *vb =
 		container_of(pr_dev_info, struct virtio_balloon, pr_dev_info);
 	struct virtqueue *vq = vb->reporting_vq;
-	unsigned int unused, err;
+	unsigned int batch = READ_ONCE(report_batch);
+	unsigned int i, j, n, inflight = 0;
+	u64 pages = 0, start, ns;
+	int err = 0;
 
-	/* We should always be able to add these buffers to an empty queue. */
-	err = virtqueue_add_inbuf(vq, sg, nents, vb, GFP_NOWAIT | __GFP_NOWARN);
+	start = ktime_get_ns();
 
 	/*
-	 * In the extremely unlikely case that something has occurred and we
-	 * are able to trigger an error we will simply display a warning
-	 * and exit without actually processing the pages.
+	 * The pages go back to the allocator once we return, so all of the
+	 * buffers have to be used by the host before that. They are still
+	 * queued up together to let the host pipeline them.
 	 */
-	if (WARN_ON_ONCE(err))
-		return err;
+	for (i = 0; i < nents; i += n) {
+		n = min(batch, nents - i);
 
-	virtqueue_kick(vq);
+		/* virtqueue_add_inbuf() stops at the end mark */
+		if (i + n < nents)
+			sg_mark_end(&sg[i + n - 1]);
 
-	/* When host has read buffer, this completes via balloon_ack */
-	wait_event(vb->acked, virtqueue_get_buf(vq, &unused));
+		/* We should always be able to add these buffers to an empty queue. */
+		err = virtqueue_add_inbuf(vq, &sg[i], n, vb,
+					  GFP_NOWAIT | __GFP_NOWARN);
+
+		if (i + n < nents)
+			sg_unmark_end(&sg[i + n - 1]);
+
+		/*
+		 * In the extremely unlikely case that something has occurred
+		 * and we are able to trigger an error we will simply display
+		 * a warning and not report the remaining pages.
+		 */
+		if (WARN_ON_ONCE(err))
+			break;
+
+		inflight++;
+		for (j = i; j < i + n; j++)
+			pages += sg[j].length >> PAGE_SHIFT;
+	}
 
+	if (inflight) {
+		virtqueue_kick(vq);
+
+		/* When host has read the buffers, this completes via balloon_ack */
+		wait_event(vb->acked,
+			   virtballoon_free_page_reported(vq, &inflight));
+	}
+
+	ns = ktime_get_ns() - start;
+	vb->reports++;
+	vb->reported_pages += pages;
+	vb->report_ns += ns;
+	vb->report_max_ns = max(vb->report_max_ns, ns);
+
+	return err;
+}
+
+static int virtballoon_reporting_show(struct seq_file *m, void *v)
+{
+	struct virtio_balloon *vb = m->private;
+
+	seq_printf(m, "reports %llu\n", vb->reports);
+	seq_printf(m, "reported_pages %llu\n", vb->reported_pages);
+	seq_printf(m, "report_ns %llu\n", vb->report_ns);
+	seq_printf(m, "report_max_ns %llu\n", vb->report_max_ns);
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(virtballoon_reporting);
 
 static void set_page_pfns(struct virtio_balloon *vb,
 			  __virtio32 pfns[], struct page *page)
@@ -978,10 +1071,18 @@ static int virtballoon_probe(struct virtio_device *vdev)
 #if defined(CONFIG_ARM64) && defined(CONFIG_ARM64_64K_PAGES)
 		vb->pr_dev_info.order = 5;
 #endif
+		if (report_order)
+			vb->pr_dev_info.order = min_t(unsigned int,
+						      report_order, MAX_ORDER);
 
 		err = page_reporting_register(&vb->pr_dev_info);
 		if (err)
 			goto out_unregister_oom;
+
+		vb->debugfs = debugfs_create_dir(dev_name(&vdev->dev),
+						 virtio_balloon_debugfs_root);
+		debugfs_create_file("free_page_reporting", 0400, vb->debugfs,
+				    vb, &virtballoon_reporting_fops);
 	}
 
 	virtio_device_ready(vdev);
@@ -1028,8 +1129,10 @@ static void virtballoon_remove(struct virtio_device *vdev)
 {
 	struct virtio_balloon *vb = vdev->priv;
 
-	if (virtio_has_feature(vb->vdev, VIRTIO_BALLOON_F_REPORTING))
+	if (virtio_has_feature(vb->vdev, VIRTIO_BALLOON_F_REPORTING)) {
+		debugfs_remove_recursive(vb->debugfs);
 		page_reporting_unregister(&vb->pr_dev_info);
+	}
 	if (virtio_has_feature(vb->vdev, VIRTIO_BALLOON_F_DEFLATE_ON_OOM))
 		unregister_oom_notifier(&vb->oom_nb);
 	if (virtio_has_feature(vb->vdev, VIRTIO_BALLOON_F_FREE_PAGE_HINT))
@@ -1122,7 +1225,26 @@ static struct virtio_driver virtio_balloon_driver = {
 #endif
 };
 
-module_virtio_driver(virtio_balloon_driver);
+static int __init virtio_balloon_init(void)
+{
+	int err;
+
+	virtio_balloon_debugfs_root = debugfs_create_dir("virtio_balloon", NULL);
+
+	err = register_virtio_driver(&virtio_balloon_driver);
+	if (err)
+		debugfs_remove_recursive(virtio_balloon_debugfs_root);
+	return err;
+}
+
+static void __exit virtio_balloon_exit(void)
+{
+	unregister_virtio_driver(&virtio_balloon_driver);
+	debugfs_remove_recursive(virtio_balloon_debugfs_root);
+}
+
+module_init(virtio_balloon_init);
+module_exit(virtio_balloon_exit);
 MODULE_DEVICE_TABLE(virtio, id_table);
 MODULE_DESCRIPTION("Virtio balloon driver");
 MODULE_LICENSE("GPL");
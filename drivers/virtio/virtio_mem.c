@@ -127,6 +127,9 @@ struct virtio_mem {
 	uint64_t plugged_size;
 	/* The requested size of the device. */
 	uint64_t requested_size;
+	/* When we last reported the progress towards the requested size. */
+	unsigned long progress_jiffies;
+#define VIRTIO_MEM_PROGRESS_INTERVAL		(10 * HZ)
 
 	/* The device block size (for communicating with the device). */
 	uint64_t device_block_size;
@@ -1318,6 +1321,46 @@ static void virtio_mem_online_page_cb(struct page *page, unsigned int order)
 	generic_online_page(page, order);
 }
 
+/*
+ * Resizing a big device can take a while: tell the admin how far we got
+ * every now and then.
+ */
+static void virtio_mem_report_progress(struct virtio_mem *vm)
+{
+	if (time_before(jiffies, vm->progress_jiffies +
+				 VIRTIO_MEM_PROGRESS_INTERVAL))
+		return;
+	vm->progress_jiffies = jiffies;
+
+	dev_info(&vm->vdev->dev, "plugged size: 0x%llx, requested size: 0x%llx",
+		 vm->plugged_size, vm->requested_size);
+}
+
+/*
+ * The maximum number of blocks of @block_size a single plug or unplug
+ * request can cover.
+ */
+static uint64_t virtio_mem_max_request_blocks(struct virtio_mem *vm,
+					      uint64_t block_size)
+{
+	return max_t(uint64_t, 1, div64_u64(U16_MAX * vm->device_block_size,
+					    block_size));
+}
+
+/*
+ * The maximum number of blocks of @block_size we can add at once without
+ * exceeding the offline threshold; see virtio_mem_could_add_memory().
+ */
+static uint64_t virtio_mem_max_add_blocks(struct virtio_mem *vm,
+					  uint64_t block_size)
+{
+	const uint64_t offline_size = atomic64_read(&vm->offline_size);
+
+	if (offline_size >= vm->offline_threshold)
+		return 0;
+	return div64_u64(vm->offline_threshold - offline_size, block_size);
+}
+
 static uint64_t virtio_mem_send_request(struct virtio_mem *vm,
 					const struct virtio_mem_req *req)
 {
@@ -1368,6 +1411,7 @@ static int virtio_mem_send_plug_request(struct virtio_mem *vm, uint64_t addr,
 	switch (virtio_mem_send_request(vm, &req)) {
 	case VIRTIO_MEM_RESP_ACK:
 		vm->plugged_size += size;
+		virtio_mem_report_progress(vm);
 		return 0;
 	case VIRTIO_MEM_RESP_NACK:
 		rc = -EAGAIN;
@@ -1406,6 +1450,7 @@ static int virtio_mem_send_unplug_request(struct virtio_mem *vm, uint64_t addr,
 	switch (virtio_mem_send_request(vm, &req)) {
 	case VIRTIO_MEM_RESP_ACK:
 		vm->plugged_size -= size;
+		virtio_mem_report_progress(vm);
 		return 0;
 	case VIRTIO_MEM_RESP_BUSY:
 		rc = -ETXTBSY;
@@ -1640,6 +1685,81 @@ static int virtio_mem_sbm_plug_and_add_mb(struct virtio_mem *vm,
 	return 0;
 }
 
+/*
+ * Prepare a run of new memory blocks, plug all of them with a single
+ * request and add them to Linux one by one. Used when at least two memory
+ * blocks are to be plugged completely, to avoid a round trip to the device
+ * per memory block when growing big devices.
+ *
+ * Will modify the state of the memory blocks.
+ */
+static int virtio_mem_sbm_plug_and_add_new_mbs(struct virtio_mem *vm,
+					       uint64_t *nb_sb)
+{
+	const uint64_t mb_size = memory_block_size_bytes();
+	unsigned long first_mb_id = 0, mb_id;
+	uint64_t nr_mbs, nr, i;
+	int rc = 0;
+
+	nr_mbs = div_u64(*nb_sb, vm->sbm.sbs_per_mb);
+	nr_mbs = min(nr_mbs, virtio_mem_max_request_blocks(vm, mb_size));
+	nr_mbs = min(nr_mbs, virtio_mem_max_add_blocks(vm, mb_size));
+	if (!nr_mbs)
+		return -ENOSPC;
+
+	for (nr = 0; nr < nr_mbs; nr++) {
+		rc = virtio_mem_sbm_prepare_next_mb(vm, &mb_id);
+		if (rc)
+			break;
+		if (!nr)
+			first_mb_id = mb_id;
+	}
+	if (!nr)
+		return rc;
+
+	rc = virtio_mem_send_plug_request(vm,
+					  virtio_mem_mb_id_to_phys(first_mb_id),
+					  nr * mb_size);
+	if (rc)
+		return rc;
+
+	/*
+	 * Mark the blocks properly offline before adding them to Linux,
+	 * so the memory notifiers will find them in the right state.
+	 */
+	for (i = 0; i < nr; i++) {
+		virtio_mem_sbm_set_sb_plugged(vm, first_mb_id + i, 0,
+					      vm->sbm.sbs_per_mb);
+		virtio_mem_sbm_set_mb_state(vm, first_mb_id + i,
+					    VIRTIO_MEM_SBM_MB_OFFLINE);
+	}
+
+	for (i = 0; i < nr; i++) {
+		rc = virtio_mem_sbm_add_mb(vm, first_mb_id + i);
+		if (rc)
+			break;
+		*nb_sb -= vm->sbm.sbs_per_mb;
+		cond_resched();
+	}
+
+	if (rc) {
+		/* Unplug all blocks we failed to add in one go. */
+		const uint64_t addr = virtio_mem_mb_id_to_phys(first_mb_id + i);
+		int new_state = VIRTIO_MEM_SBM_MB_UNUSED;
+
+		if (virtio_mem_send_unplug_request(vm, addr, (nr - i) * mb_size))
+			new_state = VIRTIO_MEM_SBM_MB_PLUGGED;
+		for (; i < nr; i++) {
+			if (new_state == VIRTIO_MEM_SBM_MB_UNUSED)
+				virtio_mem_sbm_set_sb_unplugged(vm, first_mb_id + i,
+								0, vm->sbm.sbs_per_mb);
+			virtio_mem_sbm_set_mb_state(vm, first_mb_id + i,
+						    new_state);
+		}
+	}
+	return rc;
+}
+
 /*
  * Try to plug the desired number of subblocks of a memory block that
  * is already added to Linux.
@@ -1737,6 +1857,14 @@ static int virtio_mem_sbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 		if (!virtio_mem_could_add_memory(vm, memory_block_size_bytes()))
 			return -ENOSPC;
 
+		if (nb_sb >= 2 * vm->sbm.sbs_per_mb) {
+			rc = virtio_mem_sbm_plug_and_add_new_mbs(vm, &nb_sb);
+			if (rc)
+				return rc;
+			cond_resched();
+			continue;
+		}
+
 		rc = virtio_mem_sbm_prepare_next_mb(vm, &mb_id);
 		if (rc)
 			return rc;
@@ -1807,6 +1935,69 @@ static int virtio_mem_bbm_prepare_next_bb(struct virtio_mem *vm,
 	return 0;
 }
 
+/*
+ * Prepare a run of new big blocks, plug all of them with a single request
+ * and add them to Linux one by one. See
+ * virtio_mem_sbm_plug_and_add_new_mbs().
+ *
+ * Will modify the state of the big blocks.
+ */
+static int virtio_mem_bbm_plug_and_add_new_bbs(struct virtio_mem *vm,
+					       uint64_t *nb_bb)
+{
+	const uint64_t bb_size = vm->bbm.bb_size;
+	unsigned long first_bb_id = 0, bb_id;
+	uint64_t nr_bbs, nr, i;
+	int rc = 0;
+
+	nr_bbs = min(*nb_bb, virtio_mem_max_request_blocks(vm, bb_size));
+	nr_bbs = min(nr_bbs, virtio_mem_max_add_blocks(vm, bb_size));
+	if (!nr_bbs)
+		return -ENOSPC;
+
+	for (nr = 0; nr < nr_bbs; nr++) {
+		rc = virtio_mem_bbm_prepare_next_bb(vm, &bb_id);
+		if (rc)
+			break;
+		if (!nr)
+			first_bb_id = bb_id;
+	}
+	if (!nr)
+		return rc;
+
+	rc = virtio_mem_send_plug_request(vm,
+					  virtio_mem_bb_id_to_phys(vm, first_bb_id),
+					  nr * bb_size);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < nr; i++)
+		virtio_mem_bbm_set_bb_state(vm, first_bb_id + i,
+					    VIRTIO_MEM_BBM_BB_ADDED);
+
+	for (i = 0; i < nr; i++) {
+		rc = virtio_mem_bbm_add_bb(vm, first_bb_id + i);
+		if (rc)
+			break;
+		(*nb_bb)--;
+		cond_resched();
+	}
+
+	if (rc) {
+		/* Unplug all big blocks we failed to add in one go. */
+		const uint64_t addr = virtio_mem_bb_id_to_phys(vm, first_bb_id + i);
+		int new_state = VIRTIO_MEM_BBM_BB_UNUSED;
+
+		if (virtio_mem_send_unplug_request(vm, addr, (nr - i) * bb_size))
+			/* Retry from the main loop. */
+			new_state = VIRTIO_MEM_BBM_BB_PLUGGED;
+		for (; i < nr; i++)
+			virtio_mem_bbm_set_bb_state(vm, first_bb_id + i,
+						    new_state);
+	}
+	return rc;
+}
+
 static int virtio_mem_bbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 {
 	uint64_t nb_bb = diff / vm->bbm.bb_size;
@@ -1834,6 +2025,14 @@ static int virtio_mem_bbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 		if (!virtio_mem_could_add_memory(vm, vm->bbm.bb_size))
 			return -ENOSPC;
 
+		if (nb_bb >= 2) {
+			rc = virtio_mem_bbm_plug_and_add_new_bbs(vm, &nb_bb);
+			if (rc)
+				return rc;
+			cond_resched();
+			continue;
+		}
+
 		rc = virtio_mem_bbm_prepare_next_bb(vm, &bb_id);
 		if (rc)
 			return rc;
@@ -381,7 +381,8 @@ xen_swiotlb_sync_sg_for_device(struct device *dev, struct scatterlist *sgl,
 static int
 xen_swiotlb_dma_supported(struct device *hwdev, u64 mask)
 {
-	return xen_phys_to_dma(hwdev, io_tlb_default_mem.end - 1) <= mask;
+	return xen_phys_to_dma(hwdev,
+			       io_tlb_default_mem.defpool.end - 1) <= mask;
 }
 
 const struct dma_map_ops xen_swiotlb_dma_ops = {
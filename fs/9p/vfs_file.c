@@ -20,6 +20,7 @@
 #include <linux/uaccess.h>
 #include <linux/uio.h>
 #include <linux/slab.h>
+#include <linux/seq_file.h>
 #include <net/9p/9p.h>
 #include <net/9p/client.h>
 
@@ -561,6 +562,18 @@ static const struct vm_operations_struct v9fs_mmap_file_vm_ops = {
 	.page_mkwrite = v9fs_vm_page_mkwrite,
 };
 
+#ifdef CONFIG_NETFS_STATS
+/*
+ * Report the netfs read counters of the inode in /proc/<pid>/fdinfo.
+ */
+static void v9fs_file_show_fdinfo(struct seq_file *m, struct file *filp)
+{
+	netfs_inode_stats_show(m, netfs_inode(file_inode(filp)));
+}
+#else
+#define v9fs_file_show_fdinfo NULL
+#endif
+
 const struct file_operations v9fs_file_operations = {
 	.llseek = generic_file_llseek,
 	.read_iter = v9fs_file_read_iter,
@@ -572,6 +585,7 @@ const struct file_operations v9fs_file_operations = {
 	.splice_read = generic_file_splice_read,
 	.splice_write = iter_file_splice_write,
 	.fsync = v9fs_file_fsync,
+	.show_fdinfo = v9fs_file_show_fdinfo,
 };
 
 const struct file_operations v9fs_file_operations_dotl = {
@@ -586,4 +600,5 @@ const struct file_operations v9fs_file_operations_dotl = {
 	.splice_read = generic_file_splice_read,
 	.splice_write = iter_file_splice_write,
 	.fsync = v9fs_file_fsync_dotl,
+	.show_fdinfo = v9fs_file_show_fdinfo,
 };
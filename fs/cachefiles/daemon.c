@@ -77,6 +77,7 @@ static const struct cachefiles_daemon_cmd cachefiles_daemon_cmds[] = {
 	{ "tag",	cachefiles_daemon_tag		},
 #ifdef CONFIG_CACHEFILES_ONDEMAND
 	{ "copen",	cachefiles_ondemand_copen	},
+	{ "cread",	cachefiles_ondemand_cread	},
 #endif
 	{ "",		NULL				}
 };
@@ -157,7 +158,7 @@ static void cachefiles_flush_reqs(struct cachefiles_cache *cache)
 	xa_lock(xa);
 	xa_for_each(xa, index, req) {
 		req->error = -EIO;
-		complete(&req->done);
+		complete_all(&req->done);
 	}
 	xa_unlock(xa);
 
@@ -769,6 +770,9 @@ static int cachefiles_daemon_bind(struct cachefiles_cache *cache, char *args)
 	if (IS_ENABLED(CONFIG_CACHEFILES_ONDEMAND)) {
 		if (!strcmp(args, "ondemand")) {
 			set_bit(CACHEFILES_ONDEMAND_MODE, &cache->flags);
+		} else if (!strcmp(args, "ondemand,batch")) {
+			set_bit(CACHEFILES_ONDEMAND_MODE, &cache->flags);
+			set_bit(CACHEFILES_ONDEMAND_BATCH, &cache->flags);
 		} else if (*args) {
 			pr_err("Invalid argument to the 'bind' command\n");
 			return -EINVAL;
@@ -4,6 +4,18 @@
 #include <linux/uio.h>
 #include "internal.h"
 
+/*
+ * READ requests for adjacent or overlapping ranges of an object that the
+ * daemon hasn't picked up yet are merged into one, up to this size.
+ */
+#define CACHEFILES_ONDEMAND_READ_MERGE_MAX	SZ_1M
+
+static void cachefiles_req_put(struct cachefiles_req *req)
+{
+	if (refcount_dec_and_test(&req->ref))
+		kfree(req);
+}
+
 static int cachefiles_ondemand_fd_release(struct inode *inode,
 					  struct file *file)
 {
@@ -24,7 +36,7 @@ static int cachefiles_ondemand_fd_release(struct inode *inode,
 		if (req->msg.object_id == object_id &&
 		    req->msg.opcode == CACHEFILES_OP_READ) {
 			req->error = -EIO;
-			complete(&req->done);
+			complete_all(&req->done);
 			xas_store(&xas, NULL);
 		}
 	}
@@ -97,7 +109,7 @@ static long cachefiles_ondemand_fd_ioctl(struct file *filp, unsigned int ioctl,
 		return -EINVAL;
 
 	trace_cachefiles_ondemand_cread(object, id);
-	complete(&req->done);
+	complete_all(&req->done);
 	return 0;
 }
 
@@ -181,6 +193,49 @@ int cachefiles_ondemand_copen(struct cachefiles_cache *cache, char *args)
 	return ret;
 }
 
+/*
+ * READ request Completion (cread)
+ * - command: "cread <id>[,<id>...]"
+ *   completes a batch of READ requests in one write, like
+ *   CACHEFILES_IOC_READ_COMPLETE does for one
+ */
+int cachefiles_ondemand_cread(struct cachefiles_cache *cache, char *args)
+{
+	struct cachefiles_req *req;
+	unsigned long id;
+	char *pid;
+	int ret;
+
+	if (!test_bit(CACHEFILES_ONDEMAND_MODE, &cache->flags))
+		return -EOPNOTSUPP;
+
+	if (!*args) {
+		pr_err("Empty id specified\n");
+		return -EINVAL;
+	}
+
+	while ((pid = strsep(&args, ","))) {
+		ret = kstrtoul(pid, 0, &id);
+		if (ret)
+			return ret;
+
+		xa_lock(&cache->reqs);
+		req = xa_load(&cache->reqs, id);
+		if (req && (req->msg.opcode != CACHEFILES_OP_READ ||
+			    xa_get_mark(&cache->reqs, id, CACHEFILES_REQ_NEW)))
+			req = NULL;
+		if (req)
+			__xa_erase(&cache->reqs, id);
+		xa_unlock(&cache->reqs);
+		if (!req)
+			return -EINVAL;
+
+		trace_cachefiles_ondemand_cread(req->object, id);
+		complete_all(&req->done);
+	}
+	return 0;
+}
+
 static int cachefiles_ondemand_get_fd(struct cachefiles_req *req)
 {
 	struct cachefiles_object *object;
@@ -234,8 +289,9 @@ static int cachefiles_ondemand_get_fd(struct cachefiles_req *req)
 	return ret;
 }
 
-ssize_t cachefiles_ondemand_daemon_read(struct cachefiles_cache *cache,
-					char __user *_buffer, size_t buflen)
+static ssize_t cachefiles_ondemand_daemon_read_one(struct cachefiles_cache *cache,
+						  char __user *_buffer,
+						  size_t buflen)
 {
 	struct cachefiles_req *req;
 	struct cachefiles_msg *msg;
@@ -300,10 +356,72 @@ ssize_t cachefiles_ondemand_daemon_read(struct cachefiles_cache *cache,
 error:
 	xa_erase(&cache->reqs, id);
 	req->error = ret;
-	complete(&req->done);
+	complete_all(&req->done);
 	return ret;
 }
 
+/*
+ * Hand requests to the daemon.  Normally that is one per read().  When the
+ * cache was bound with "ondemand,batch", as many whole messages as fit are
+ * copied back to back into the buffer, each one msg->len bytes long.
+ */
+ssize_t cachefiles_ondemand_daemon_read(struct cachefiles_cache *cache,
+					char __user *_buffer, size_t buflen)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	if (!test_bit(CACHEFILES_ONDEMAND_BATCH, &cache->flags))
+		return cachefiles_ondemand_daemon_read_one(cache, _buffer, buflen);
+
+	do {
+		n = cachefiles_ondemand_daemon_read_one(cache, _buffer + done,
+							buflen - done);
+		if (n <= 0)
+			break;
+		done += n;
+	} while (done < buflen);
+
+	return done ? done : n;
+}
+
+/*
+ * Look for a READ request of the same object that the daemon hasn't seen
+ * yet and whose range touches the one of @req.  If there is one, grow it
+ * to cover both ranges and return it with a reference for the caller to
+ * wait on instead of enqueuing @req.  The caller holds the xa_lock, which
+ * the daemon also takes to pick up a request.
+ */
+static struct cachefiles_req *
+cachefiles_ondemand_merge_read(struct cachefiles_cache *cache,
+			       struct cachefiles_req *req)
+{
+	struct cachefiles_read *load = (void *)req->msg.data;
+	struct cachefiles_read *old_load;
+	struct cachefiles_req *old;
+	XA_STATE(xas, &cache->reqs, 0);
+	u64 start, end;
+
+	xas_for_each_marked(&xas, old, ULONG_MAX, CACHEFILES_REQ_NEW) {
+		if (old->msg.opcode != CACHEFILES_OP_READ ||
+		    old->msg.object_id != req->msg.object_id)
+			continue;
+
+		old_load = (void *)old->msg.data;
+		start = min(old_load->off, load->off);
+		end = max(old_load->off + old_load->len, load->off + load->len);
+		if (end - start > old_load->len + load->len ||
+		    end - start > CACHEFILES_ONDEMAND_READ_MERGE_MAX)
+			continue;
+
+		old_load->off = start;
+		old_load->len = end - start;
+		refcount_inc(&old->ref);
+		return old;
+	}
+	return NULL;
+}
+
 typedef int (*init_req_fn)(struct cachefiles_req *req, void *private);
 
 static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
@@ -313,7 +431,7 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 					void *private)
 {
 	struct cachefiles_cache *cache = object->volume->cache;
-	struct cachefiles_req *req;
+	struct cachefiles_req *req, *merged;
 	XA_STATE(xas, &cache->reqs, 0);
 	int ret;
 
@@ -329,6 +447,7 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 
 	req->object = object;
 	init_completion(&req->done);
+	refcount_set(&req->ref, 1);
 	req->msg.opcode = opcode;
 	req->msg.len = sizeof(struct cachefiles_msg) + data_len;
 
@@ -336,6 +455,22 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 	if (ret)
 		goto out;
 
+	/*
+	 * A pending READ that hasn't been handed to the daemon yet is still
+	 * in the xarray, so cachefiles_flush_reqs() or the anon_fd release
+	 * will complete it if the daemon goes away.
+	 */
+	if (opcode == CACHEFILES_OP_READ) {
+		xa_lock(&cache->reqs);
+		merged = cachefiles_ondemand_merge_read(cache, req);
+		xa_unlock(&cache->reqs);
+		if (merged) {
+			cachefiles_req_put(req);
+			req = merged;
+			goto wait;
+		}
+	}
+
 	do {
 		/*
 		 * Stop enqueuing the request when daemon is dying. The
@@ -385,10 +520,11 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 		goto out;
 
 	wake_up_all(&cache->daemon_pollwq);
+wait:
 	wait_for_completion(&req->done);
 	ret = req->error;
 out:
-	kfree(req);
+	cachefiles_req_put(req);
 	return ret;
 }
 
@@ -6,6 +6,7 @@
  */
 
 #include <linux/namei.h>
+#include <linux/mm.h>
 #include "cifsglob.h"
 #include "cifsproto.h"
 #include "cifs_debug.h"
@@ -16,6 +17,42 @@ static struct cached_fid *init_cached_dir(const char *path);
 static void free_cached_dir(struct cached_fid *cfid);
 static void smb2_close_cached_fid(struct kref *ref);
 
+static int cached_dir_max_entries(void)
+{
+	unsigned int max = READ_ONCE(max_cached_dirs);
+	unsigned long gib;
+
+	if (max)
+		return min_t(unsigned int, max, INT_MAX);
+	gib = totalram_pages() >> (30 - PAGE_SHIFT);
+	return clamp_t(unsigned long, gib * MIN_CACHED_FIDS,
+		       MIN_CACHED_FIDS, MAX_CACHED_FIDS);
+}
+
+/*
+ * Make room for a new entry by dropping the least recently used cached
+ * directory that nobody but its lease holds.  Its handle is closed (and
+ * the lease given back) from the lease break worker, as we cannot send
+ * the close under the list lock.
+ */
+static bool evict_cached_dir(struct cached_fids *cfids)
+{
+	struct cached_fid *cfid;
+
+	lockdep_assert_held(&cfids->cfid_list_lock);
+	list_for_each_entry_reverse(cfid, &cfids->entries, entry) {
+		if (!cfid->has_lease || kref_read(&cfid->refcount) != 1)
+			continue;
+		cfid->time = 0;
+		list_del(&cfid->entry);
+		cfid->on_list = false;
+		cfids->num_entries--;
+		queue_work(cifsiod_wq, &cfid->lease_break);
+		return true;
+	}
+	return false;
+}
+
 static struct cached_fid *find_or_create_cached_dir(struct cached_fids *cfids,
 						    const char *path,
 						    bool lookup_only)
@@ -34,6 +71,7 @@ static struct cached_fid *find_or_create_cached_dir(struct cached_fids *cfids,
 				spin_unlock(&cfids->cfid_list_lock);
 				return NULL;
 			}
+			list_move(&cfid->entry, &cfids->entries);
 			kref_get(&cfid->refcount);
 			spin_unlock(&cfids->cfid_list_lock);
 			return cfid;
@@ -43,7 +81,8 @@ static struct cached_fid *find_or_create_cached_dir(struct cached_fids *cfids,
 		spin_unlock(&cfids->cfid_list_lock);
 		return NULL;
 	}
-	if (cfids->num_entries >= MAX_CACHED_FIDS) {
+	if (cfids->num_entries >= cached_dir_max_entries() &&
+	    !evict_cached_dir(cfids)) {
 		spin_unlock(&cfids->cfid_list_lock);
 		return NULL;
 	}
@@ -352,6 +391,7 @@ int open_cached_dir_by_dentry(struct cifs_tcon *tcon,
 	list_for_each_entry(cfid, &cfids->entries, entry) {
 		if (dentry && cfid->dentry == dentry) {
 			cifs_dbg(FYI, "found a cached root file handle by dentry\n");
+			list_move(&cfid->entry, &cfids->entries);
 			kref_get(&cfid->refcount);
 			*ret_cfid = cfid;
 			spin_unlock(&cfids->cfid_list_lock);
@@ -49,14 +49,20 @@ struct cached_fid {
 	struct cached_dirents dirents;
 };
 
-#define MAX_CACHED_FIDS 16
+/*
+ * Default number of cached directories per tcon: MIN_CACHED_FIDS per GiB
+ * of memory, up to MAX_CACHED_FIDS.  Overridden by the max_cached_dirs
+ * module parameter.
+ */
+#define MIN_CACHED_FIDS 16
+#define MAX_CACHED_FIDS 1024
 struct cached_fids {
 	/* Must be held when:
 	 * - accessing the cfids->entries list
 	 */
 	spinlock_t cfid_list_lock;
 	int num_entries;
-	struct list_head entries;
+	struct list_head entries;	/* most recently used first */
 };
 
 extern struct cached_fids *init_cached_dirs(void);
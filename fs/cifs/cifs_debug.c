@@ -133,7 +133,8 @@ cifs_dump_channel(struct seq_file *m, int i, struct cifs_chan *chan)
 		   "\n\t\tNumber of credits: %d Dialect 0x%x"
 		   "\n\t\tTCP status: %d Instance: %d"
 		   "\n\t\tLocal Users To Server: %d SecMode: 0x%x Req On Wire: %d"
-		   "\n\t\tIn Send: %d In MaxReq Wait: %d",
+		   "\n\t\tIn Send: %d In MaxReq Wait: %d"
+		   "\n\t\tRound trip: %u us",
 		   i+1, server->conn_id,
 		   server->credits,
 		   server->dialect,
@@ -143,7 +144,8 @@ cifs_dump_channel(struct seq_file *m, int i, struct cifs_chan *chan)
 		   server->sec_mode,
 		   in_flight(server),
 		   atomic_read(&server->in_send),
-		   atomic_read(&server->num_waiters));
+		   atomic_read(&server->num_waiters),
+		   READ_ONCE(server->rtt_us));
 }
 
 static void
@@ -117,6 +117,12 @@ module_param(cifs_max_pending, uint, 0444);
 MODULE_PARM_DESC(cifs_max_pending, "Simultaneous requests to server for "
 				   "CIFS/SMB1 dialect (N/A for SMB3) "
 				   "Default: 32767 Range: 2 to 32767.");
+unsigned int max_cached_dirs;
+module_param(max_cached_dirs, uint, 0644);
+MODULE_PARM_DESC(max_cached_dirs, "Max number of directories per share whose "
+				  "handle and contents are cached under a "
+				  "lease. Default: 0 (scale with memory, "
+				  "16 per GiB up to 1024)");
 #ifdef CONFIG_CIFS_STATS2
 unsigned int slow_rsp_threshold = 1;
 module_param(slow_rsp_threshold, uint, 0644);
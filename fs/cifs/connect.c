@@ -805,12 +805,35 @@ is_smb_response(struct TCP_Server_Info *server, unsigned char type)
 	return false;
 }
 
+/*
+ * Feed a response into the channel's round trip average, unless an interim
+ * STATUS_PENDING response cleared when_sent_ns.
+ */
+static void cifs_update_rtt(struct TCP_Server_Info *server,
+			    struct mid_q_entry *mid)
+{
+	unsigned int rtt = READ_ONCE(server->rtt_us);
+	s64 us;
+
+	if (!mid->when_sent_ns)
+		return;
+	us = ktime_us_delta(ktime_get(), mid->when_sent_ns);
+	if (us < 0)
+		return;
+	us = min_t(s64, us, UINT_MAX >> 3);
+	if (rtt)
+		us = (7 * (s64)rtt + us) >> 3;
+	WRITE_ONCE(server->rtt_us, us);
+}
+
 void
 dequeue_mid(struct mid_q_entry *mid, bool malformed)
 {
 #ifdef CONFIG_CIFS_STATS2
 	mid->when_received = jiffies;
 #endif
+	if (!malformed)
+		cifs_update_rtt(mid->server, mid);
 	spin_lock(&mid->server->mid_lock);
 	if (!malformed)
 		mid->mid_state = MID_RESPONSE_RECEIVED;
@@ -1066,8 +1089,15 @@ cifs_handle_standard(struct TCP_Server_Info *server, struct mid_q_entry *mid)
 	}
 
 	if (server->ops->is_status_pending &&
-	    server->ops->is_status_pending(buf, server))
+	    server->ops->is_status_pending(buf, server)) {
+		/*
+		 * The final response will come once the server is done with
+		 * the request, and its delay is no round trip sample.
+		 */
+		if (mid)
+			mid->when_sent_ns = 0;
 		return -1;
+	}
 
 	if (!mid)
 		return rc;
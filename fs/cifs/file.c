@@ -3376,21 +3376,15 @@ cifs_write_from_iter(loff_t fpos, size_t len, struct iov_iter *from,
 	struct cifs_writedata *wdata;
 	pid_t pid;
 	struct TCP_Server_Info *server;
-	unsigned int xid, max_segs = INT_MAX;
+	unsigned int xid, max_segs;
 
 	if (cifs_sb->mnt_cifs_flags & CIFS_MOUNT_RWPIDFORWARD)
 		pid = open_file->pid;
 	else
 		pid = current->tgid;
 
-	server = cifs_pick_channel(tlink_tcon(open_file->tlink)->ses);
 	xid = get_xid();
 
-#ifdef CONFIG_CIFS_SMB_DIRECT
-	if (server->smbd_conn)
-		max_segs = server->smbd_conn->max_frmr_depth;
-#endif
-
 	do {
 		struct cifs_credits credits_on_stack;
 		struct cifs_credits *credits = &credits_on_stack;
@@ -3409,6 +3403,14 @@ cifs_write_from_iter(loff_t fpos, size_t len, struct iov_iter *from,
 				break;
 		}
 
+		/* Stripe the request over the channels, one wsize at a time */
+		server = cifs_pick_channel(tlink_tcon(open_file->tlink)->ses);
+		max_segs = INT_MAX;
+#ifdef CONFIG_CIFS_SMB_DIRECT
+		if (server->smbd_conn)
+			max_segs = server->smbd_conn->max_frmr_depth;
+#endif
+
 		rc = server->ops->wait_mtu_credits(server, cifs_sb->ctx->wsize,
 						   &wsize, credits);
 		if (rc)
@@ -3910,7 +3912,7 @@ cifs_send_async_read(loff_t fpos, size_t len, struct cifsFileInfo *open_file,
 		     struct cifs_aio_ctx *ctx)
 {
 	struct cifs_readdata *rdata;
-	unsigned int rsize, nsegs, max_segs = INT_MAX;
+	unsigned int rsize, nsegs, max_segs;
 	struct cifs_credits credits_on_stack;
 	struct cifs_credits *credits = &credits_on_stack;
 	size_t cur_len, max_len;
@@ -3918,13 +3920,6 @@ cifs_send_async_read(loff_t fpos, size_t len, struct cifsFileInfo *open_file,
 	pid_t pid;
 	struct TCP_Server_Info *server;
 
-	server = cifs_pick_channel(tlink_tcon(open_file->tlink)->ses);
-
-#ifdef CONFIG_CIFS_SMB_DIRECT
-	if (server->smbd_conn)
-		max_segs = server->smbd_conn->max_frmr_depth;
-#endif
-
 	if (cifs_sb->mnt_cifs_flags & CIFS_MOUNT_RWPIDFORWARD)
 		pid = open_file->pid;
 	else
@@ -3939,6 +3934,14 @@ cifs_send_async_read(loff_t fpos, size_t len, struct cifsFileInfo *open_file,
 				break;
 		}
 
+		/* Stripe the request over the channels, one rsize at a time */
+		server = cifs_pick_channel(tlink_tcon(open_file->tlink)->ses);
+		max_segs = INT_MAX;
+#ifdef CONFIG_CIFS_SMB_DIRECT
+		if (server->smbd_conn)
+			max_segs = server->smbd_conn->max_frmr_depth;
+#endif
+
 		if (cifs_sb->ctx->rsize == 0)
 			cifs_sb->ctx->rsize =
 				server->ops->negotiate_rsize(tlink_tcon(open_file->tlink),
@@ -4670,8 +4670,11 @@ handle_read_data(struct TCP_Server_Info *server, struct mid_q_entry *mid,
 	}
 
 	if (server->ops->is_status_pending &&
-			server->ops->is_status_pending(buf, server))
+			server->ops->is_status_pending(buf, server)) {
+		/* The final response includes the server's processing time */
+		mid->when_sent_ns = 0;
 		return -1;
+	}
 
 	/* set up first two iov to get credits */
 	rdata->iov[0].iov_base = buf;
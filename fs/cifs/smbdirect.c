@@ -2047,6 +2047,23 @@ static void register_mr_done(struct ib_cq *cq, struct ib_wc *wc)
  * I/O requests calling smbd_register_mr will never update the links in the
  * mr_list.
  */
+/*
+ * Put a MR on the ready list and wake up a waiter in get_mr(). The list is
+ * LIFO so that the MR which was used last, and whose descriptors are most
+ * likely still cached, is handed out first.
+ */
+static void smbd_mr_ready(struct smbd_connection *info,
+			  struct smbd_mr *smbdirect_mr)
+{
+	spin_lock(&info->mr_list_lock);
+	smbdirect_mr->state = MR_READY;
+	list_add(&smbdirect_mr->ready_list, &info->mr_ready_list);
+	spin_unlock(&info->mr_list_lock);
+
+	if (atomic_inc_return(&info->mr_ready_count) == 1)
+		wake_up_interruptible(&info->wait_mr);
+}
+
 static void smbd_mr_recovery_work(struct work_struct *work)
 {
 	struct smbd_connection *info =
@@ -2081,17 +2098,7 @@ static void smbd_mr_recovery_work(struct work_struct *work)
 			/* This MR is being used, don't recover it */
 			continue;
 
-		smbdirect_mr->state = MR_READY;
-
-		/* smbdirect_mr->state is updated by this function
-		 * and is read and updated by I/O issuing CPUs trying
-		 * to get a MR, the call to atomic_inc_return
-		 * implicates a memory barrier and guarantees this
-		 * value is updated before waking up any calls to
-		 * get_mr() from the I/O issuing CPUs
-		 */
-		if (atomic_inc_return(&info->mr_ready_count) == 1)
-			wake_up_interruptible(&info->wait_mr);
+		smbd_mr_ready(info, smbdirect_mr);
 	}
 }
 
@@ -2123,6 +2130,7 @@ static int allocate_mr_list(struct smbd_connection *info)
 	struct smbd_mr *smbdirect_mr, *tmp;
 
 	INIT_LIST_HEAD(&info->mr_list);
+	INIT_LIST_HEAD(&info->mr_ready_list);
 	init_waitqueue_head(&info->wait_mr);
 	spin_lock_init(&info->mr_list_lock);
 	atomic_set(&info->mr_ready_count, 0);
@@ -2153,6 +2161,7 @@ static int allocate_mr_list(struct smbd_connection *info)
 		smbdirect_mr->conn = info;
 
 		list_add_tail(&smbdirect_mr->list, &info->mr_list);
+		list_add_tail(&smbdirect_mr->ready_list, &info->mr_ready_list);
 		atomic_inc(&info->mr_ready_count);
 	}
 	return 0;
@@ -2170,12 +2179,11 @@ static int allocate_mr_list(struct smbd_connection *info)
 }
 
 /*
- * Get a MR from mr_list. This function waits until there is at least one
- * MR available in the list. It may access the list while the
- * smbd_mr_recovery_work is recovering the MR list. This doesn't need a lock
- * as they never modify the same places. However, there may be several CPUs
- * issueing I/O trying to get MR at the same time, mr_list_lock is used to
- * protect this situation.
+ * Get a MR from mr_ready_list. This function waits until there is at least
+ * one MR available in the list. Several CPUs may be issuing I/O and trying
+ * to get a MR at the same time, and MRs are returned to the list from
+ * deregistration and from smbd_mr_recovery_work, so the list is protected
+ * by mr_list_lock.
  */
 static struct smbd_mr *get_mr(struct smbd_connection *info)
 {
@@ -2197,17 +2205,19 @@ static struct smbd_mr *get_mr(struct smbd_connection *info)
 	}
 
 	spin_lock(&info->mr_list_lock);
-	list_for_each_entry(ret, &info->mr_list, list) {
-		if (ret->state == MR_READY) {
-			ret->state = MR_REGISTERED;
-			spin_unlock(&info->mr_list_lock);
-			atomic_dec(&info->mr_ready_count);
-			atomic_inc(&info->mr_used_count);
-			return ret;
-		}
+	ret = list_first_entry_or_null(&info->mr_ready_list, struct smbd_mr,
+				       ready_list);
+	if (ret) {
+		list_del(&ret->ready_list);
+		ret->state = MR_REGISTERED;
 	}
-
 	spin_unlock(&info->mr_list_lock);
+	if (ret) {
+		atomic_dec(&info->mr_ready_count);
+		atomic_inc(&info->mr_used_count);
+		return ret;
+	}
+
 	/*
 	 * It is possible that we could fail to get MR because other processes may
 	 * try to acquire a MR at the same time. If this is the case, retry it.
@@ -2390,9 +2400,7 @@ int smbd_deregister_mr(struct smbd_mr *smbdirect_mr)
 			info->id->device, smbdirect_mr->sgt.sgl,
 			smbdirect_mr->sgt.nents,
 			smbdirect_mr->dir);
-		smbdirect_mr->state = MR_READY;
-		if (atomic_inc_return(&info->mr_ready_count) == 1)
-			wake_up_interruptible(&info->wait_mr);
+		smbd_mr_ready(info, smbdirect_mr);
 	} else
 		/*
 		 * Schedule the work to do MR recovery for future I/Os MR
@@ -102,6 +102,8 @@ struct smbd_connection {
 	int rdma_readwrite_threshold;
 	enum ib_mr_type mr_type;
 	struct list_head mr_list;
+	/* MRs in MR_READY state, most recently returned first */
+	struct list_head mr_ready_list;
 	spinlock_t mr_list_lock;
 	/* The number of available MRs ready for memory registration */
 	atomic_t mr_ready_count;
@@ -286,6 +288,7 @@ enum mr_state {
 struct smbd_mr {
 	struct smbd_connection	*conn;
 	struct list_head	list;
+	struct list_head	ready_list;
 	enum mr_state		state;
 	struct ib_mr		*mr;
 	struct sg_table		sgt;
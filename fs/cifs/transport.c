@@ -1006,43 +1006,51 @@ cifs_cancelled_callback(struct mid_q_entry *mid)
  *
  * If we are currently binding a new channel (negprot/sess.setup),
  * return the new incomplete channel.
+ *
+ * Pick the channel a new request is expected to complete on soonest:
+ * the one with the lowest (requests on the wire + 1) * round trip time.
+ * Channels that are out of credits would make the request wait for
+ * credits first, so they are only used if all of them are.  The scan
+ * starts at a rotating offset, so equally good channels are used in
+ * turn.
  */
 struct TCP_Server_Info *cifs_pick_channel(struct cifs_ses *ses)
 {
-	uint index = 0;
-	unsigned int min_in_flight = UINT_MAX, max_in_flight = 0;
+	uint index = 0, start, i;
+	u64 cost, min_cost = U64_MAX;
+	bool min_has_credits = false;
 	struct TCP_Server_Info *server = NULL;
-	int i;
 
 	if (!ses)
 		return NULL;
 
 	spin_lock(&ses->chan_lock);
+	start = (uint)atomic_inc_return(&ses->chan_seq);
 	for (i = 0; i < ses->chan_count; i++) {
-		server = ses->chans[i].server;
+		uint j = (start + i) % ses->chan_count;
+		bool has_credits;
+
+		server = ses->chans[j].server;
 		if (!server)
 			continue;
 
 		/*
 		 * strictly speaking, we should pick up req_lock to read
-		 * server->in_flight. But it shouldn't matter much here if we
-		 * race while reading this data. The worst that can happen is
-		 * that we could use a channel that's not least loaded. Avoiding
-		 * taking the lock could help reduce wait time, which is
-		 * important for this function
+		 * server->in_flight and credits. But it shouldn't matter much
+		 * here if we race while reading this data. The worst that can
+		 * happen is that we could use a channel that's not least
+		 * loaded. Avoiding taking the lock could help reduce wait time,
+		 * which is important for this function
 		 */
-		if (server->in_flight < min_in_flight) {
-			min_in_flight = server->in_flight;
-			index = i;
+		has_credits = READ_ONCE(server->credits) > 0;
+		cost = (u64)(READ_ONCE(server->in_flight) + 1) *
+		       (READ_ONCE(server->rtt_us) + 1);
+		if ((has_credits && !min_has_credits) ||
+		    (has_credits == min_has_credits && cost < min_cost)) {
+			min_cost = cost;
+			min_has_credits = has_credits;
+			index = j;
 		}
-		if (server->in_flight > max_in_flight)
-			max_in_flight = server->in_flight;
-	}
-
-	/* if all channels are equally loaded, fall back to round-robin */
-	if (min_in_flight == max_in_flight) {
-		index = (uint)atomic_inc_return(&ses->chan_seq);
-		index %= ses->chan_count;
 	}
 	spin_unlock(&ses->chan_lock);
 
@@ -1709,6 +1717,8 @@ cifs_readv_receive(struct TCP_Server_Info *server, struct mid_q_entry *mid)
 
 	if (server->ops->is_status_pending &&
 	    server->ops->is_status_pending(buf, server)) {
+		/* The final response includes the server's processing time */
+		mid->when_sent_ns = 0;
 		cifs_discard_remaining_data(server);
 		return -1;
 	}
@@ -52,6 +52,7 @@
 #include <linux/slab.h>
 #include <net/sctp/sctp.h>
 #include <net/ipv6.h>
+#include <linux/hash.h>
 
 #include <trace/events/dlm.h>
 #include <trace/events/sock.h>
@@ -199,10 +200,26 @@ static void process_recv_sockets(struct work_struct *work);
 static void process_send_sockets(struct work_struct *work);
 static void process_dlm_messages(struct work_struct *work);
 
-static DECLARE_WORK(process_work, process_dlm_messages);
-static DEFINE_SPINLOCK(processqueue_lock);
-static bool process_dlm_messages_pending;
-static LIST_HEAD(processqueue);
+/* Received messages are parsed on several process queues in parallel.
+ * A node always hashes to the same queue, so messages from one node
+ * are still processed in the order they were received.
+ */
+#define DLM_PROCESSQUEUE_BITS 3
+#define DLM_PROCESSQUEUE_COUNT (1 << DLM_PROCESSQUEUE_BITS)
+
+struct dlm_processqueue {
+	spinlock_t lock;
+	bool pending;
+	struct list_head list;
+	struct work_struct work;
+};
+
+static struct dlm_processqueue processqueues[DLM_PROCESSQUEUE_COUNT];
+
+static struct dlm_processqueue *nodeid2processqueue(int nodeid)
+{
+	return &processqueues[hash_32(nodeid, DLM_PROCESSQUEUE_BITS)];
+}
 
 bool dlm_lowcomms_is_running(void)
 {
@@ -890,20 +907,23 @@ static void add_processed_node(int nodeid, struct list_head *processed_nodes)
 
 static void process_dlm_messages(struct work_struct *work)
 {
+	struct dlm_processqueue *pq = container_of(work,
+						   struct dlm_processqueue,
+						   work);
 	struct dlm_processed_nodes *n, *n_tmp;
 	struct processqueue_entry *pentry;
 	LIST_HEAD(processed_nodes);
 
-	spin_lock(&processqueue_lock);
-	pentry = list_first_entry_or_null(&processqueue,
+	spin_lock(&pq->lock);
+	pentry = list_first_entry_or_null(&pq->list,
 					  struct processqueue_entry, list);
 	if (WARN_ON_ONCE(!pentry)) {
-		spin_unlock(&processqueue_lock);
+		spin_unlock(&pq->lock);
 		return;
 	}
 
 	list_del(&pentry->list);
-	spin_unlock(&processqueue_lock);
+	spin_unlock(&pq->lock);
 
 	for (;;) {
 		dlm_process_incoming_buffer(pentry->nodeid, pentry->buf,
@@ -911,17 +931,18 @@ static void process_dlm_messages(struct work_struct *work)
 		add_processed_node(pentry->nodeid, &processed_nodes);
 		free_processqueue_entry(pentry);
 
-		spin_lock(&processqueue_lock);
-		pentry = list_first_entry_or_null(&processqueue,
-						  struct processqueue_entry, list);
+		spin_lock(&pq->lock);
+		pentry = list_first_entry_or_null(&pq->list,
+						  struct processqueue_entry,
+						  list);
 		if (!pentry) {
-			process_dlm_messages_pending = false;
-			spin_unlock(&processqueue_lock);
+			pq->pending = false;
+			spin_unlock(&pq->lock);
 			break;
 		}
 
 		list_del(&pentry->list);
-		spin_unlock(&processqueue_lock);
+		spin_unlock(&pq->lock);
 	}
 
 	/* send ack back after we processed couple of messages */
@@ -935,6 +956,7 @@ static void process_dlm_messages(struct work_struct *work)
 /* Data received from remote end */
 static int receive_from_sock(struct connection *con, int buflen)
 {
+	struct dlm_processqueue *pq = nodeid2processqueue(con->nodeid);
 	struct processqueue_entry *pentry;
 	int ret, buflen_real;
 	struct msghdr msg;
@@ -998,13 +1020,13 @@ static int receive_from_sock(struct connection *con, int buflen)
 	memmove(con->rx_leftover_buf, pentry->buf + ret,
 		con->rx_leftover);
 
-	spin_lock(&processqueue_lock);
-	list_add_tail(&pentry->list, &processqueue);
-	if (!process_dlm_messages_pending) {
-		process_dlm_messages_pending = true;
-		queue_work(process_workqueue, &process_work);
+	spin_lock(&pq->lock);
+	list_add_tail(&pentry->list, &pq->list);
+	if (!pq->pending) {
+		pq->pending = true;
+		queue_work(process_workqueue, &pq->work);
 	}
-	spin_unlock(&processqueue_lock);
+	spin_unlock(&pq->lock);
 
 	return DLM_IO_SUCCESS;
 }
@@ -1395,8 +1417,8 @@ int dlm_lowcomms_resend_msg(struct dlm_msg *msg)
 /* Send a message */
 static int send_to_sock(struct connection *con)
 {
-	const int msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
-	struct writequeue_entry *e;
+	int msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+	struct writequeue_entry *e, *next;
 	int len, offset, ret;
 
 	spin_lock_bh(&con->writequeue_lock);
@@ -1407,6 +1429,16 @@ static int send_to_sock(struct connection *con)
 		return DLM_IO_END;
 	}
 
+	/* If the next entry is ready as well it is sent right after this
+	 * one, let the transport put both into the same segment/packet
+	 * instead of pushing out each small message on its own.
+	 */
+	if (!list_is_last(&e->list, &con->writequeue)) {
+		next = list_next_entry(e, list);
+		if (!next->users && next->len)
+			msg_flags |= MSG_MORE;
+	}
+
 	len = e->len;
 	offset = e->offset;
 	WARN_ON_ONCE(len == 0 && e->users == 0);
@@ -1725,11 +1757,13 @@ static int work_start(void)
 		return -ENOMEM;
 	}
 
-	/* ordered dlm message process queue,
-	 * should be converted to a tasklet
+	/* dlm message process queue, ordering of the messages of one
+	 * node is kept by the per processqueue work, see
+	 * nodeid2processqueue()
 	 */
-	process_workqueue = alloc_ordered_workqueue("dlm_process",
-						    WQ_HIGHPRI | WQ_MEM_RECLAIM);
+	process_workqueue = alloc_workqueue("dlm_process",
+					    WQ_HIGHPRI | WQ_MEM_RECLAIM |
+					    WQ_UNBOUND, DLM_PROCESSQUEUE_COUNT);
 	if (!process_workqueue) {
 		log_print("can't start dlm_process");
 		destroy_workqueue(io_workqueue);
@@ -2006,6 +2040,12 @@ void dlm_lowcomms_init(void)
 	for (i = 0; i < CONN_HASH_SIZE; i++)
 		INIT_HLIST_HEAD(&connection_hash[i]);
 
+	for (i = 0; i < DLM_PROCESSQUEUE_COUNT; i++) {
+		spin_lock_init(&processqueues[i].lock);
+		INIT_LIST_HEAD(&processqueues[i].list);
+		INIT_WORK(&processqueues[i].work, process_dlm_messages);
+	}
+
 	INIT_WORK(&listen_con.rwork, process_listen_recv_socket);
 }
 
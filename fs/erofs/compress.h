@@ -8,6 +8,15 @@
 
 #include "internal.h"
 
+/*
+ * Decompressor state which is kept across all pclusters decompressed in one
+ * go (e.g. a whole decompression queue) rather than set up for each of them.
+ */
+struct z_erofs_decompress_batch {
+	/* LZMA stream grabbed by the first LZMA pcluster of the batch */
+	void *lzma_strm;
+};
+
 struct z_erofs_decompress_req {
 	struct super_block *sb;
 	struct page **in, **out;
@@ -18,6 +27,9 @@ struct z_erofs_decompress_req {
 	/* indicate the algorithm will be used for decompression */
 	unsigned int alg;
 	bool inplace_io, partial_decoding, fillgaps;
+
+	/* optional, NULL if the request is decompressed on its own */
+	struct z_erofs_decompress_batch *batch;
 };
 
 struct z_erofs_decompressor {
@@ -91,8 +103,10 @@ int z_erofs_fixup_insize(struct z_erofs_decompress_req *rq, const char *padbuf,
 			 unsigned int padbufsize);
 int z_erofs_decompress(struct z_erofs_decompress_req *rq,
 		       struct page **pagepool);
+void z_erofs_decompress_batch_end(struct z_erofs_decompress_batch *batch);
 
 /* prototypes for specific algorithms */
 int z_erofs_lzma_decompress(struct z_erofs_decompress_req *rq,
 			    struct page **pagepool);
+void z_erofs_lzma_batch_end(struct z_erofs_decompress_batch *batch);
 #endif
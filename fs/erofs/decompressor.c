@@ -389,3 +389,11 @@ int z_erofs_decompress(struct z_erofs_decompress_req *rq,
 {
 	return decompressors[rq->alg].decompress(rq, pagepool);
 }
+
+/* release the decompressor state held for a batch of requests */
+void z_erofs_decompress_batch_end(struct z_erofs_decompress_batch *batch)
+{
+#ifdef CONFIG_EROFS_FS_ZIP_LZMA
+	z_erofs_lzma_batch_end(batch);
+#endif
+}
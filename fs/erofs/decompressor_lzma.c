@@ -150,6 +150,42 @@ int z_erofs_load_lzma_config(struct super_block *sb,
 	return err;
 }
 
+/*
+ * Streams are handed out to one pcluster at a time, or to a whole batch of
+ * pclusters which saves the lock round trip and wakeups for each of them.
+ */
+static struct z_erofs_lzma *
+z_erofs_lzma_get_strm(struct z_erofs_decompress_batch *batch)
+{
+	struct z_erofs_lzma *strm;
+
+	if (batch && batch->lzma_strm)
+		return batch->lzma_strm;
+again:
+	spin_lock(&z_erofs_lzma_lock);
+	strm = z_erofs_lzma_head;
+	if (!strm) {
+		spin_unlock(&z_erofs_lzma_lock);
+		wait_event(z_erofs_lzma_wq, READ_ONCE(z_erofs_lzma_head));
+		goto again;
+	}
+	z_erofs_lzma_head = strm->next;
+	spin_unlock(&z_erofs_lzma_lock);
+
+	if (batch)
+		batch->lzma_strm = strm;
+	return strm;
+}
+
+static void z_erofs_lzma_put_strm(struct z_erofs_lzma *strm)
+{
+	spin_lock(&z_erofs_lzma_lock);
+	strm->next = z_erofs_lzma_head;
+	z_erofs_lzma_head = strm;
+	spin_unlock(&z_erofs_lzma_lock);
+	wake_up(&z_erofs_lzma_wq);
+}
+
 int z_erofs_lzma_decompress(struct z_erofs_decompress_req *rq,
 			    struct page **pagepool)
 {
@@ -174,16 +210,7 @@ int z_erofs_lzma_decompress(struct z_erofs_decompress_req *rq,
 	}
 
 	/* 2. get an available lzma context */
-again:
-	spin_lock(&z_erofs_lzma_lock);
-	strm = z_erofs_lzma_head;
-	if (!strm) {
-		spin_unlock(&z_erofs_lzma_lock);
-		wait_event(z_erofs_lzma_wq, READ_ONCE(z_erofs_lzma_head));
-		goto again;
-	}
-	z_erofs_lzma_head = strm->next;
-	spin_unlock(&z_erofs_lzma_lock);
+	strm = z_erofs_lzma_get_strm(rq->batch);
 
 	/* 3. multi-call decompress */
 	inlen = rq->inputsize;
@@ -281,11 +308,16 @@ int z_erofs_lzma_decompress(struct z_erofs_decompress_req *rq,
 		kunmap(rq->out[no]);
 	if (ni < nrpages_in)
 		kunmap(rq->in[ni]);
-	/* 4. push back LZMA stream context to the global list */
-	spin_lock(&z_erofs_lzma_lock);
-	strm->next = z_erofs_lzma_head;
-	z_erofs_lzma_head = strm;
-	spin_unlock(&z_erofs_lzma_lock);
-	wake_up(&z_erofs_lzma_wq);
+	/* 4. push back LZMA stream context unless the batch keeps it */
+	if (!rq->batch)
+		z_erofs_lzma_put_strm(strm);
 	return err;
 }
+
+void z_erofs_lzma_batch_end(struct z_erofs_decompress_batch *batch)
+{
+	if (batch->lzma_strm) {
+		z_erofs_lzma_put_strm(batch->lzma_strm);
+		batch->lzma_strm = NULL;
+	}
+}
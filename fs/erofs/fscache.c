@@ -4,6 +4,9 @@
  * Copyright (C) 2022, Bytedance Inc. All rights reserved.
  */
 #include <linux/fscache.h>
+#include <linux/file.h>
+#include <linux/jhash.h>
+#include "xattr.h"
 #include "internal.h"
 
 static DEFINE_MUTEX(erofs_domain_list_lock);
@@ -184,10 +187,10 @@ static int erofs_fscache_meta_read_folio(struct file *data, struct folio *folio)
 	return ret;
 }
 
-static int erofs_fscache_data_read_slice(struct erofs_fscache_request *primary)
+static int erofs_fscache_data_read_slice(struct inode *inode,
+		struct erofs_fscache_request *primary)
 {
 	struct address_space *mapping = primary->mapping;
-	struct inode *inode = mapping->host;
 	struct super_block *sb = inode->i_sb;
 	struct erofs_fscache_request *req;
 	struct erofs_map_blocks map;
@@ -258,12 +261,17 @@ static int erofs_fscache_data_read_slice(struct erofs_fscache_request *primary)
 	return ret;
 }
 
-static int erofs_fscache_data_read(struct erofs_fscache_request *req)
+/*
+ * Fill req->mapping with the data of @inode, which is usually its host, but can
+ * also be any inode with the same content for mappings shared among files.
+ */
+static int erofs_fscache_data_read(struct inode *inode,
+				   struct erofs_fscache_request *req)
 {
 	int ret;
 
 	do {
-		ret = erofs_fscache_data_read_slice(req);
+		ret = erofs_fscache_data_read_slice(inode, req);
 		if (ret)
 			req->error = ret;
 	} while (!ret && req->submitted < req->len);
@@ -271,7 +279,7 @@ static int erofs_fscache_data_read(struct erofs_fscache_request *req)
 	return ret;
 }
 
-static int erofs_fscache_read_folio(struct file *file, struct folio *folio)
+static int __erofs_fscache_read_folio(struct inode *inode, struct folio *folio)
 {
 	struct erofs_fscache_request *req;
 	int ret;
@@ -283,12 +291,13 @@ static int erofs_fscache_read_folio(struct file *file, struct folio *folio)
 		return PTR_ERR(req);
 	}
 
-	ret = erofs_fscache_data_read(req);
+	ret = erofs_fscache_data_read(inode, req);
 	erofs_fscache_req_put(req);
 	return ret;
 }
 
-static void erofs_fscache_readahead(struct readahead_control *rac)
+static void __erofs_fscache_readahead(struct inode *inode,
+				      struct readahead_control *rac)
 {
 	struct erofs_fscache_request *req;
 
@@ -304,10 +313,20 @@ static void erofs_fscache_readahead(struct readahead_control *rac)
 	while (readahead_folio(rac))
 		;
 
-	erofs_fscache_data_read(req);
+	erofs_fscache_data_read(inode, req);
 	erofs_fscache_req_put(req);
 }
 
+static int erofs_fscache_read_folio(struct file *file, struct folio *folio)
+{
+	return __erofs_fscache_read_folio(folio_mapping(folio)->host, folio);
+}
+
+static void erofs_fscache_readahead(struct readahead_control *rac)
+{
+	__erofs_fscache_readahead(rac->mapping->host, rac);
+}
+
 static const struct address_space_operations erofs_fscache_meta_aops = {
 	.read_folio = erofs_fscache_meta_read_folio,
 };
@@ -317,6 +336,220 @@ const struct address_space_operations erofs_fscache_access_aops = {
 	.readahead = erofs_fscache_readahead,
 };
 
+/*
+ * Page cache sharing ("inode_share"): regular files of all images in a domain
+ * which carry the same content fingerprint are backed by a single anonymous
+ * inode in the pseudo mount.  Opening such a file opens that inode instead,
+ * and its page cache is filled from whichever file the I/O comes through.
+ */
+struct erofs_ishare_key {
+	struct erofs_domain *domain;
+	unsigned int len;
+	u8 fingerprint[EROFS_FINGERPRINT_MAXLEN];
+};
+
+static const struct file_operations erofs_ishare_real_fops;
+
+/* The erofs inode that I/O on the shared inode is done on behalf of */
+static struct inode *erofs_ishare_realinode(struct file *file)
+{
+	struct path *realpath;
+
+	if (!file || file->f_op != &erofs_ishare_real_fops)
+		return NULL;
+	realpath = file->private_data;
+	return d_inode(realpath->dentry);
+}
+
+static int erofs_ishare_read_folio(struct file *file, struct folio *folio)
+{
+	struct inode *realinode = erofs_ishare_realinode(file);
+
+	if (!realinode) {
+		folio_unlock(folio);
+		return -EIO;
+	}
+	return __erofs_fscache_read_folio(realinode, folio);
+}
+
+static void erofs_ishare_readahead(struct readahead_control *rac)
+{
+	struct inode *realinode = erofs_ishare_realinode(rac->file);
+
+	if (realinode)
+		__erofs_fscache_readahead(realinode, rac);
+}
+
+static const struct address_space_operations erofs_ishare_aops = {
+	.read_folio = erofs_ishare_read_folio,
+	.readahead = erofs_ishare_readahead,
+};
+
+static int erofs_ishare_real_release(struct inode *inode, struct file *file)
+{
+	struct path *realpath = file->private_data;
+
+	path_put(realpath);
+	kfree(realpath);
+	return 0;
+}
+
+/* Files opened on the shared inode, they pin the file they were opened for */
+static const struct file_operations erofs_ishare_real_fops = {
+	.release	= erofs_ishare_real_release,
+};
+
+static int erofs_ishare_file_open(struct inode *inode, struct file *file)
+{
+	struct inode *sharedinode = EROFS_I(inode)->ishare;
+	struct path *realpath;
+	struct file *realfile;
+
+	realpath = kmalloc(sizeof(*realpath), GFP_KERNEL);
+	if (!realpath)
+		return -ENOMEM;
+
+	ihold(sharedinode);
+	realfile = alloc_file_pseudo(sharedinode, erofs_pseudo_mnt,
+				     "[erofs_ishare]", O_RDONLY,
+				     &erofs_ishare_real_fops);
+	if (IS_ERR(realfile)) {
+		iput(sharedinode);
+		kfree(realpath);
+		return PTR_ERR(realfile);
+	}
+
+	*realpath = file->f_path;
+	path_get(realpath);
+	realfile->private_data = realpath;
+	file->private_data = realfile;
+	return 0;
+}
+
+static int erofs_ishare_file_release(struct inode *inode, struct file *file)
+{
+	fput(file->private_data);
+	return 0;
+}
+
+static ssize_t erofs_ishare_file_read_iter(struct kiocb *iocb,
+					   struct iov_iter *to)
+{
+	struct file *realfile = iocb->ki_filp->private_data;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	/* all I/O goes through the shared page cache */
+	kiocb_clone(&kiocb, iocb, realfile);
+	kiocb.ki_flags &= ~IOCB_DIRECT;
+	ret = filemap_read(&kiocb, to, 0);
+	iocb->ki_pos = kiocb.ki_pos;
+	return ret;
+}
+
+static int erofs_ishare_file_mmap(struct file *file,
+				  struct vm_area_struct *vma)
+{
+	struct file *realfile = file->private_data;
+
+	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE))
+		return -EINVAL;
+
+	vma_set_file(vma, realfile);
+	return generic_file_readonly_mmap(realfile, vma);
+}
+
+static ssize_t erofs_ishare_file_splice_read(struct file *in, loff_t *ppos,
+					     struct pipe_inode_info *pipe,
+					     size_t len, unsigned int flags)
+{
+	return filemap_splice_read(in->private_data, ppos, pipe, len, flags);
+}
+
+const struct file_operations erofs_ishare_fops = {
+	.open		= erofs_ishare_file_open,
+	.release	= erofs_ishare_file_release,
+	.llseek		= generic_file_llseek,
+	.read_iter	= erofs_ishare_file_read_iter,
+	.mmap		= erofs_ishare_file_mmap,
+	.splice_read	= erofs_ishare_file_splice_read,
+};
+
+static int erofs_ishare_test(struct inode *inode, void *data)
+{
+	struct erofs_ishare_key *key = inode->i_private, *want = data;
+
+	return key->domain == want->domain && key->len == want->len &&
+		!memcmp(key->fingerprint, want->fingerprint, key->len);
+}
+
+static int erofs_ishare_set(struct inode *inode, void *data)
+{
+	inode->i_private = kmemdup(data, sizeof(struct erofs_ishare_key),
+				   GFP_KERNEL);
+	return inode->i_private ? 0 : -ENOMEM;
+}
+
+/*
+ * Look up (or create) the shared inode of a regular file with a fingerprint,
+ * and switch the file over to it.  Files without one, or which can't be
+ * shared for whatever reason, are simply left alone.
+ */
+void erofs_ishare_init_inode(struct inode *inode)
+{
+	struct erofs_sb_info *sbi = EROFS_I_SB(inode);
+	struct erofs_ishare_key key = { .domain = sbi->domain };
+	struct inode *sharedinode;
+	int len;
+
+	if (!test_opt(&sbi->opt, INODE_SHARE) || !sbi->domain ||
+	    !S_ISREG(inode->i_mode) || inode->i_fop != &erofs_file_fops)
+		return;
+
+	len = erofs_getxattr(inode, EROFS_XATTR_INDEX_TRUSTED,
+			     EROFS_XATTR_NAME_FINGERPRINT, key.fingerprint,
+			     sizeof(key.fingerprint));
+	if (len <= 0)
+		return;
+	key.len = len;
+
+	sharedinode = iget5_locked(erofs_pseudo_mnt->mnt_sb,
+			jhash(key.fingerprint, key.len,
+			      hash_ptr(key.domain, 32)),
+			erofs_ishare_test, erofs_ishare_set, &key);
+	if (!sharedinode)
+		return;
+
+	if (sharedinode->i_state & I_NEW) {
+		sharedinode->i_mode = S_IFREG | 0444;
+		sharedinode->i_size = inode->i_size;
+		sharedinode->i_blkbits = inode->i_blkbits;
+		sharedinode->i_mapping->a_ops = &erofs_ishare_aops;
+		mapping_set_large_folios(sharedinode->i_mapping);
+		unlock_new_inode(sharedinode);
+	} else if (sharedinode->i_size != inode->i_size) {
+		erofs_err(inode->i_sb, "fingerprint of nid %llu matches a file of different size",
+			  EROFS_I(inode)->nid);
+		iput(sharedinode);
+		return;
+	}
+
+	EROFS_I(inode)->ishare = sharedinode;
+	inode->i_fop = &erofs_ishare_fops;
+}
+
+/* ->evict_inode() of the pseudo mount */
+void erofs_ishare_evict_inode(struct inode *inode)
+{
+	truncate_inode_pages_final(&inode->i_data);
+	clear_inode(inode);
+	if (inode->i_mapping->a_ops == &erofs_ishare_aops)
+		kfree(inode->i_private);
+}
+
 static void erofs_fscache_domain_put(struct erofs_domain *domain)
 {
 	mutex_lock(&erofs_domain_list_lock);
@@ -354,6 +354,7 @@ struct inode *erofs_iget(struct super_block *sb, erofs_nid_t nid)
 			iget_failed(inode);
 			return ERR_PTR(err);
 		}
+		erofs_ishare_init_inode(inode);
 		unlock_new_inode(inode);
 	}
 	return inode;
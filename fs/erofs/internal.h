@@ -192,6 +192,7 @@ struct erofs_sb_info {
 #define EROFS_MOUNT_POSIX_ACL		0x00000020
 #define EROFS_MOUNT_DAX_ALWAYS		0x00000040
 #define EROFS_MOUNT_DAX_NEVER		0x00000080
+#define EROFS_MOUNT_INODE_SHARE		0x00000100
 
 #define clear_opt(opt, option)	((opt)->mount_opt &= ~EROFS_MOUNT_##option)
 #define set_opt(opt, option)	((opt)->mount_opt |= EROFS_MOUNT_##option)
@@ -329,6 +330,10 @@ struct erofs_inode {
 		};
 #endif	/* CONFIG_EROFS_FS_ZIP */
 	};
+#ifdef CONFIG_EROFS_FS_ONDEMAND
+	/* inode in the pseudo mount sharing page cache, see "inode_share" */
+	struct inode *ishare;
+#endif
 	/* the corresponding vfs inode */
 	struct inode vfs_inode;
 };
@@ -437,6 +442,13 @@ extern const struct iomap_ops z_erofs_iomap_report_ops;
 #define EROFS_REG_COOKIE_SHARE		0x0001
 #define EROFS_REG_COOKIE_NEED_NOEXIST	0x0002
 
+/*
+ * "trusted." xattr with a digest of the file content, regular files with the
+ * same fingerprint in a domain share page cache with "inode_share".
+ */
+#define EROFS_XATTR_NAME_FINGERPRINT	"erofs.fingerprint"
+#define EROFS_FINGERPRINT_MAXLEN	64
+
 void *erofs_read_metadata(struct super_block *sb, struct erofs_buf *buf,
 			  erofs_off_t *offset, int *lengthp);
 void erofs_unmap_metabuf(struct erofs_buf *buf);
@@ -559,6 +571,9 @@ void erofs_fscache_unregister_fs(struct super_block *sb);
 struct erofs_fscache *erofs_fscache_register_cookie(struct super_block *sb,
 					char *name, unsigned int flags);
 void erofs_fscache_unregister_cookie(struct erofs_fscache *fscache);
+
+void erofs_ishare_init_inode(struct inode *inode);
+void erofs_ishare_evict_inode(struct inode *inode);
 #else
 static inline int erofs_fscache_register_fs(struct super_block *sb)
 {
@@ -576,6 +591,9 @@ struct erofs_fscache *erofs_fscache_register_cookie(struct super_block *sb,
 static inline void erofs_fscache_unregister_cookie(struct erofs_fscache *fscache)
 {
 }
+
+static inline void erofs_ishare_init_inode(struct inode *inode) {}
+#define erofs_ishare_evict_inode	NULL
 #endif
 
 #define EFSCORRUPTED    EUCLEAN         /* Filesystem is corrupted */
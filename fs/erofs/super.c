@@ -109,6 +109,17 @@ static void erofs_free_inode(struct inode *inode)
 	kmem_cache_free(erofs_inode_cachep, vi);
 }
 
+#ifdef CONFIG_EROFS_FS_ONDEMAND
+static void erofs_evict_inode(struct inode *inode)
+{
+	truncate_inode_pages_final(&inode->i_data);
+	clear_inode(inode);
+	iput(EROFS_I(inode)->ishare);
+}
+#else
+#define erofs_evict_inode	NULL
+#endif
+
 static bool check_layout_compatibility(struct super_block *sb,
 				       struct erofs_super_block *dsb)
 {
@@ -453,6 +464,7 @@ enum {
 	Opt_device,
 	Opt_fsid,
 	Opt_domain_id,
+	Opt_inode_share,
 	Opt_err
 };
 
@@ -479,6 +491,7 @@ static const struct fs_parameter_spec erofs_fs_parameters[] = {
 	fsparam_string("device",	Opt_device),
 	fsparam_string("fsid",		Opt_fsid),
 	fsparam_string("domain_id",	Opt_domain_id),
+	fsparam_flag("inode_share",	Opt_inode_share),
 	{}
 };
 
@@ -587,9 +600,13 @@ static int erofs_fc_parse_param(struct fs_context *fc,
 		if (!ctx->domain_id)
 			return -ENOMEM;
 		break;
+	case Opt_inode_share:
+		set_opt(&ctx->opt, INODE_SHARE);
+		break;
 #else
 	case Opt_fsid:
 	case Opt_domain_id:
+	case Opt_inode_share:
 		errorfc(fc, "%s option not supported", erofs_fs_parameters[opt].name);
 		break;
 #endif
@@ -699,11 +716,21 @@ static const struct export_operations erofs_export_ops = {
 	.get_parent = erofs_get_parent,
 };
 
+static const struct super_operations erofs_pseudo_sops = {
+	.statfs		= simple_statfs,
+	.drop_inode	= generic_delete_inode,
+	.evict_inode	= erofs_ishare_evict_inode,
+};
+
 static int erofs_fc_fill_pseudo_super(struct super_block *sb, struct fs_context *fc)
 {
 	static const struct tree_descr empty_descr = {""};
+	int err;
 
-	return simple_fill_super(sb, EROFS_SUPER_MAGIC, &empty_descr);
+	err = simple_fill_super(sb, EROFS_SUPER_MAGIC, &empty_descr);
+	if (!err)
+		sb->s_op = &erofs_pseudo_sops;
+	return err;
 }
 
 static int erofs_fc_fill_super(struct super_block *sb, struct fs_context *fc)
@@ -731,6 +758,11 @@ static int erofs_fc_fill_super(struct super_block *sb, struct fs_context *fc)
 	sbi->domain_id = ctx->domain_id;
 	ctx->domain_id = NULL;
 
+	if (test_opt(&sbi->opt, INODE_SHARE) && !sbi->domain_id) {
+		errorfc(fc, "inode_share requires domain_id");
+		return -EINVAL;
+	}
+
 	sbi->blkszbits = PAGE_SHIFT;
 	if (erofs_is_fscache_mode(sb)) {
 		sb->s_blocksize = PAGE_SIZE;
@@ -860,6 +892,13 @@ static int erofs_fc_reconfigure(struct fs_context *fc)
 	if (ctx->fsid || ctx->domain_id)
 		erofs_info(sb, "ignoring reconfiguration for fsid|domain_id.");
 
+	/* inodes in memory can't switch to or from sharing page cache */
+	if (!test_opt(&ctx->opt, INODE_SHARE) !=
+	    !test_opt(&sbi->opt, INODE_SHARE)) {
+		erofs_info(sb, "ignoring reconfiguration for inode_share.");
+		ctx->opt.mount_opt ^= EROFS_MOUNT_INODE_SHARE;
+	}
+
 	if (test_opt(&ctx->opt, POSIX_ACL))
 		fc->sb_flags |= SB_POSIXACL;
 	else
@@ -1131,6 +1170,8 @@ static int erofs_show_options(struct seq_file *seq, struct dentry *root)
 		seq_printf(seq, ",fsid=%s", sbi->fsid);
 	if (sbi->domain_id)
 		seq_printf(seq, ",domain_id=%s", sbi->domain_id);
+	if (test_opt(opt, INODE_SHARE))
+		seq_puts(seq, ",inode_share");
 #endif
 	return 0;
 }
@@ -1139,6 +1180,7 @@ const struct super_operations erofs_sops = {
 	.put_super = erofs_put_super,
 	.alloc_inode = erofs_alloc_inode,
 	.free_inode = erofs_free_inode,
+	.evict_inode = erofs_evict_inode,
 	.statfs = erofs_statfs,
 	.show_options = erofs_show_options,
 };
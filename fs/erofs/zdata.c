@@ -1136,7 +1136,12 @@ struct z_erofs_decompress_backend {
 
 	struct list_head decompressed_secondary_bvecs;
 	struct page **pagepool;
-	unsigned int onstack_used, nr_pages;
+	unsigned int nr_pages;
+
+	/* page array reused by all pclusters of the batch if not on stack */
+	struct page **batch_pages;
+	unsigned int nr_batch_pages;
+	struct z_erofs_decompress_batch batch;
 };
 
 struct z_erofs_bvec_item {
@@ -1283,36 +1288,33 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 	struct erofs_sb_info *const sbi = EROFS_SB(be->sb);
 	struct z_erofs_pcluster *pcl = be->pcl;
 	unsigned int pclusterpages = z_erofs_pclusterpages(pcl);
-	unsigned int i, inputsize;
+	unsigned int i, inputsize, nr_total;
 	int err2;
 	struct page *page;
 	bool overlapped;
 
 	mutex_lock(&pcl->lock);
 	be->nr_pages = PAGE_ALIGN(pcl->length + pcl->pageofs_out) >> PAGE_SHIFT;
+	nr_total = be->nr_pages + pclusterpages;
 
-	/* allocate (de)compressed page arrays if cannot be kept on stack */
-	be->decompressed_pages = NULL;
-	be->compressed_pages = NULL;
-	be->onstack_used = 0;
-	if (be->nr_pages <= Z_EROFS_ONSTACK_PAGES) {
+	/*
+	 * (de)compressed page arrays are kept on stack if possible, otherwise
+	 * in an array which grows as needed and is reused for the whole batch.
+	 */
+	if (nr_total <= Z_EROFS_ONSTACK_PAGES) {
 		be->decompressed_pages = be->onstack_pages;
-		be->onstack_used = be->nr_pages;
-		memset(be->decompressed_pages, 0,
-		       sizeof(struct page *) * be->nr_pages);
+	} else {
+		if (nr_total > be->nr_batch_pages) {
+			kvfree(be->batch_pages);
+			be->batch_pages = kvmalloc_array(nr_total,
+					sizeof(struct page *),
+					GFP_KERNEL | __GFP_NOFAIL);
+			be->nr_batch_pages = nr_total;
+		}
+		be->decompressed_pages = be->batch_pages;
 	}
-
-	if (pclusterpages + be->onstack_used <= Z_EROFS_ONSTACK_PAGES)
-		be->compressed_pages = be->onstack_pages + be->onstack_used;
-
-	if (!be->decompressed_pages)
-		be->decompressed_pages =
-			kvcalloc(be->nr_pages, sizeof(struct page *),
-				 GFP_KERNEL | __GFP_NOFAIL);
-	if (!be->compressed_pages)
-		be->compressed_pages =
-			kvcalloc(pclusterpages, sizeof(struct page *),
-				 GFP_KERNEL | __GFP_NOFAIL);
+	memset(be->decompressed_pages, 0, sizeof(struct page *) * nr_total);
+	be->compressed_pages = be->decompressed_pages + be->nr_pages;
 
 	z_erofs_parse_out_bvecs(be);
 	err2 = z_erofs_parse_in_bvecs(be, &overlapped);
@@ -1338,6 +1340,7 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 					.inplace_io = overlapped,
 					.partial_decoding = pcl->partial,
 					.fillgaps = pcl->multibases,
+					.batch = &be->batch,
 				 }, be->pagepool);
 
 out:
@@ -1358,9 +1361,6 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 			WRITE_ONCE(pcl->compressed_bvecs[i].page, NULL);
 		}
 	}
-	if (be->compressed_pages < be->onstack_pages ||
-	    be->compressed_pages >= be->onstack_pages + Z_EROFS_ONSTACK_PAGES)
-		kvfree(be->compressed_pages);
 	z_erofs_fill_other_copies(be, err);
 
 	for (i = 0; i < be->nr_pages; ++i) {
@@ -1378,9 +1378,6 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 		z_erofs_onlinepage_endio(page);
 	}
 
-	if (be->decompressed_pages != be->onstack_pages)
-		kvfree(be->decompressed_pages);
-
 	pcl->length = 0;
 	pcl->partial = true;
 	pcl->multibases = false;
@@ -1416,6 +1413,8 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 		z_erofs_decompress_pcluster(&be, io->eio ? -EIO : 0);
 		erofs_workgroup_put(&be.pcl->obj);
 	}
+	z_erofs_decompress_batch_end(&be.batch);
+	kvfree(be.batch_pages);
 }
 
 static void z_erofs_decompressqueue_work(struct work_struct *work)
@@ -25,8 +25,19 @@ static void fscache_perform_invalidation(struct fscache_cookie *cookie);
 static struct hlist_bl_head fscache_cookie_hash[1 << fscache_cookie_hash_shift];
 static LIST_HEAD(fscache_cookies);
 static DEFINE_RWLOCK(fscache_cookies_lock);
-static LIST_HEAD(fscache_cookie_lru);
-static DEFINE_SPINLOCK(fscache_cookie_lru_lock);
+
+/*
+ * Unused cookies wait on an LRU for fscache_lru_cookie_timeout before they
+ * are withdrawn.  The LRU is split into shards by key hash so that cookies
+ * being used and unused on different CPUs don't all contend on one lock.
+ * Each shard is in unused_at order; one timer and worker serve them all.
+ */
+#define FSCACHE_COOKIE_LRU_SHIFT	5
+struct fscache_cookie_lru {
+	spinlock_t		lock;
+	struct list_head	list;
+} ____cacheline_aligned_in_smp;
+static struct fscache_cookie_lru fscache_cookie_lru[1 << FSCACHE_COOKIE_LRU_SHIFT];
 DEFINE_TIMER(fscache_cookie_lru_timer, fscache_cookie_lru_timed_out);
 static DECLARE_WORK(fscache_cookie_lru_work, fscache_cookie_lru_worker);
 static const char fscache_cookie_states[FSCACHE_COOKIE_STATE__NR] = "-LCAIFUWRD";
@@ -53,12 +64,31 @@ void fscache_print_cookie(struct fscache_cookie *cookie, char prefix)
 	pr_err("%c-key=[%u] '%*phN'\n", prefix, cookie->key_len, cookie->key_len, k);
 }
 
+static struct fscache_cookie_lru *fscache_cookie_lru_of(struct fscache_cookie *cookie)
+{
+	/* The hash table uses the low bits of the key hash */
+	return &fscache_cookie_lru[cookie->key_hash >>
+				   (32 - FSCACHE_COOKIE_LRU_SHIFT)];
+}
+
+void __init fscache_init_cookie_lru(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fscache_cookie_lru); i++) {
+		spin_lock_init(&fscache_cookie_lru[i].lock);
+		INIT_LIST_HEAD(&fscache_cookie_lru[i].list);
+	}
+}
+
 static void fscache_free_cookie(struct fscache_cookie *cookie)
 {
 	if (WARN_ON_ONCE(!list_empty(&cookie->commit_link))) {
-		spin_lock(&fscache_cookie_lru_lock);
+		struct fscache_cookie_lru *lru = fscache_cookie_lru_of(cookie);
+
+		spin_lock(&lru->lock);
 		list_del_init(&cookie->commit_link);
-		spin_unlock(&fscache_cookie_lru_lock);
+		spin_unlock(&lru->lock);
 		fscache_stat_d(&fscache_n_cookies_lru);
 		fscache_stat(&fscache_n_cookies_lru_removed);
 	}
@@ -642,19 +672,21 @@ EXPORT_SYMBOL(__fscache_use_cookie);
 
 static void fscache_unuse_cookie_locked(struct fscache_cookie *cookie)
 {
+	struct fscache_cookie_lru *lru = fscache_cookie_lru_of(cookie);
+
 	clear_bit(FSCACHE_COOKIE_DISABLED, &cookie->flags);
 	if (!test_bit(FSCACHE_COOKIE_IS_CACHING, &cookie->flags))
 		return;
 
 	cookie->unused_at = jiffies;
-	spin_lock(&fscache_cookie_lru_lock);
+	spin_lock(&lru->lock);
 	if (list_empty(&cookie->commit_link)) {
 		fscache_get_cookie(cookie, fscache_cookie_get_lru);
 		fscache_stat(&fscache_n_cookies_lru);
 	}
-	list_move_tail(&cookie->commit_link, &fscache_cookie_lru);
+	list_move_tail(&cookie->commit_link, &lru->list);
 
-	spin_unlock(&fscache_cookie_lru_lock);
+	spin_unlock(&lru->lock);
 	timer_reduce(&fscache_cookie_lru_timer,
 		     jiffies + fscache_lru_cookie_timeout);
 }
@@ -874,30 +906,48 @@ static void fscache_cookie_lru_do_one(struct fscache_cookie *cookie)
 	fscache_put_cookie(cookie, fscache_cookie_put_lru);
 }
 
-static void fscache_cookie_lru_worker(struct work_struct *work)
+/*
+ * Expire the cookies of one LRU shard.  All the expired cookies are cut off
+ * the front of the shard in one go; they stay under the shard lock on the
+ * private list, so that a racing use or drop can still take them off it.
+ */
+static void fscache_cookie_lru_expire(struct fscache_cookie_lru *lru)
 {
 	struct fscache_cookie *cookie;
 	unsigned long unused_at;
+	LIST_HEAD(expired);
 
-	spin_lock(&fscache_cookie_lru_lock);
+	spin_lock(&lru->lock);
 
-	while (!list_empty(&fscache_cookie_lru)) {
-		cookie = list_first_entry(&fscache_cookie_lru,
-					  struct fscache_cookie, commit_link);
+	list_for_each_entry(cookie, &lru->list, commit_link) {
 		unused_at = cookie->unused_at + fscache_lru_cookie_timeout;
 		if (time_before(jiffies, unused_at)) {
 			timer_reduce(&fscache_cookie_lru_timer, unused_at);
 			break;
 		}
+	}
+	list_cut_before(&expired, &lru->list, &cookie->commit_link);
 
+	while (!list_empty(&expired)) {
+		cookie = list_first_entry(&expired,
+					  struct fscache_cookie, commit_link);
 		list_del_init(&cookie->commit_link);
 		fscache_stat_d(&fscache_n_cookies_lru);
-		spin_unlock(&fscache_cookie_lru_lock);
+		spin_unlock(&lru->lock);
 		fscache_cookie_lru_do_one(cookie);
-		spin_lock(&fscache_cookie_lru_lock);
+		cond_resched();
+		spin_lock(&lru->lock);
 	}
 
-	spin_unlock(&fscache_cookie_lru_lock);
+	spin_unlock(&lru->lock);
+}
+
+static void fscache_cookie_lru_worker(struct work_struct *work)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fscache_cookie_lru); i++)
+		fscache_cookie_lru_expire(&fscache_cookie_lru[i]);
 }
 
 static void fscache_cookie_lru_timed_out(struct timer_list *timer)
@@ -907,17 +957,18 @@ static void fscache_cookie_lru_timed_out(struct timer_list *timer)
 
 static void fscache_cookie_drop_from_lru(struct fscache_cookie *cookie)
 {
+	struct fscache_cookie_lru *lru = fscache_cookie_lru_of(cookie);
 	bool need_put = false;
 
 	if (!list_empty(&cookie->commit_link)) {
-		spin_lock(&fscache_cookie_lru_lock);
+		spin_lock(&lru->lock);
 		if (!list_empty(&cookie->commit_link)) {
 			list_del_init(&cookie->commit_link);
 			fscache_stat_d(&fscache_n_cookies_lru);
 			fscache_stat(&fscache_n_cookies_lru_dropped);
 			need_put = true;
 		}
-		spin_unlock(&fscache_cookie_lru_lock);
+		spin_unlock(&lru->lock);
 		if (need_put)
 			fscache_put_cookie(cookie, fscache_cookie_put_lru);
 	}
@@ -79,6 +79,8 @@ static int __init fscache_init(void)
 	if (!fscache_wq)
 		goto error_wq;
 
+	fscache_init_cookie_lru();
+
 	ret = fscache_proc_init();
 	if (ret < 0)
 		goto error_proc;
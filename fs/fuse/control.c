@@ -184,6 +184,23 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static ssize_t fuse_conn_dax_stats_read(struct file *file, char __user *buf,
+					size_t len, loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	char tmp[256];
+	size_t size;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	size = fuse_dax_stats_show(fc, tmp, sizeof(tmp));
+	fuse_conn_put(fc);
+
+	return simple_read_from_buffer(buf, len, ppos, tmp, size);
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -210,6 +227,12 @@ static const struct file_operations fuse_conn_congestion_threshold_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_ctl_dax_stats_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_dax_stats_read,
+	.llseek = no_llseek,
+};
+
 static struct dentry *fuse_ctl_add_dentry(struct dentry *parent,
 					  struct fuse_conn *fc,
 					  const char *name,
@@ -281,6 +304,11 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 &fuse_conn_congestion_threshold_ops))
 		goto err;
 
+	if (fuse_conn_has_dax(fc) &&
+	    !fuse_ctl_add_dentry(parent, fc, "dax_stats", S_IFREG | 0400, 1,
+				 NULL, &fuse_ctl_dax_stats_ops))
+		goto err;
+
 	return 0;
 
  err:
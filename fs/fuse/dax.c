@@ -32,6 +32,13 @@
  */
 #define FUSE_DAX_RECLAIM_THRESHOLD	(20)
 
+/*
+ * Once started, background reclaim keeps going until this percentage of
+ * total ranges is free, so that it doesn't get kicked again by the very
+ * next allocation.
+ */
+#define FUSE_DAX_RECLAIM_HIGH		(30)
+
 /** Translation information for file offsets to DAX window offsets */
 struct fuse_dax_mapping {
 	/* Pointer to inode where this memory range is mapped */
@@ -57,6 +64,9 @@ struct fuse_dax_mapping {
 
 	/* reference count when the mapping is used by dax iomap. */
 	refcount_t refcnt;
+
+	/* Used by dax iomap since the reclaim worker last looked at it */
+	bool referenced;
 };
 
 /* Per-inode dax map */
@@ -91,6 +101,14 @@ struct fuse_conn_dax {
 	struct list_head free_ranges;
 
 	unsigned long nr_ranges;
+
+	/* Statistics, see fuse_dax_stats_show() */
+	atomic_long_t nr_setup;		/* FUSE_SETUPMAPPING requests */
+	atomic_long_t nr_removemapping;	/* FUSE_REMOVEMAPPING requests */
+	atomic_long_t nr_reclaimed;	/* ranges freed by the worker */
+	atomic_long_t nr_inline_reclaimed; /* ranges freed by allocators */
+	atomic_long_t nr_second_chance;	/* recently used ranges skipped */
+	atomic_long_t nr_waits;		/* waits for a free range */
 };
 
 static inline struct fuse_dax_mapping *
@@ -106,23 +124,23 @@ static struct fuse_dax_mapping *
 alloc_dax_mapping_reclaim(struct fuse_conn_dax *fcd, struct inode *inode);
 
 static void
-__kick_dmap_free_worker(struct fuse_conn_dax *fcd, unsigned long delay_ms)
+__kick_dmap_free_worker(struct fuse_conn_dax *fcd, unsigned long delay_ms,
+			unsigned int pct)
 {
 	unsigned long free_threshold;
 
 	/* If number of free ranges are below threshold, start reclaim */
-	free_threshold = max_t(unsigned long, fcd->nr_ranges * FUSE_DAX_RECLAIM_THRESHOLD / 100,
-			     1);
+	free_threshold = max_t(unsigned long, fcd->nr_ranges * pct / 100, 1);
 	if (fcd->nr_free_ranges < free_threshold)
 		queue_delayed_work(system_long_wq, &fcd->free_work,
 				   msecs_to_jiffies(delay_ms));
 }
 
 static void kick_dmap_free_worker(struct fuse_conn_dax *fcd,
-				  unsigned long delay_ms)
+				  unsigned long delay_ms, unsigned int pct)
 {
 	spin_lock(&fcd->lock);
-	__kick_dmap_free_worker(fcd, delay_ms);
+	__kick_dmap_free_worker(fcd, delay_ms, pct);
 	spin_unlock(&fcd->lock);
 }
 
@@ -138,7 +156,7 @@ static struct fuse_dax_mapping *alloc_dax_mapping(struct fuse_conn_dax *fcd)
 		WARN_ON(fcd->nr_free_ranges <= 0);
 		fcd->nr_free_ranges--;
 	}
-	__kick_dmap_free_worker(fcd, 0);
+	__kick_dmap_free_worker(fcd, 0, FUSE_DAX_RECLAIM_THRESHOLD);
 	spin_unlock(&fcd->lock);
 
 	return dmap;
@@ -208,6 +226,7 @@ static int fuse_setup_one_mapping(struct inode *inode, unsigned long start_idx,
 	args.in_args[0].size = sizeof(inarg);
 	args.in_args[0].value = &inarg;
 	err = fuse_simple_request(fm, &args);
+	atomic_long_inc(&fcd->nr_setup);
 	if (err < 0)
 		return err;
 	dmap->writable = writable;
@@ -219,6 +238,7 @@ static int fuse_setup_one_mapping(struct inode *inode, unsigned long start_idx,
 		 */
 		dmap->inode = inode;
 		dmap->itn.start = dmap->itn.last = start_idx;
+		dmap->referenced = false;
 		/* Protected by fi->dax->sem */
 		interval_tree_insert(&dmap->itn, &fi->dax->tree);
 		fi->dax->nr++;
@@ -245,6 +265,7 @@ static int fuse_send_removemapping(struct inode *inode,
 	args.in_args[0].value = inargp;
 	args.in_args[1].size = inargp->count * sizeof(*remove_one);
 	args.in_args[1].value = remove_one;
+	atomic_long_inc(&fm->fc->dax->nr_removemapping);
 	return fuse_simple_request(fm, &args);
 }
 
@@ -418,6 +439,9 @@ static void fuse_fill_iomap(struct inode *inode, loff_t pos, loff_t length,
 		 * shared/exclusive.
 		 */
 		refcount_inc(&dmap->refcnt);
+		/* Give it a second chance in try_to_free_dmap_chunks() */
+		if (!READ_ONCE(dmap->referenced))
+			WRITE_ONCE(dmap->referenced, true);
 
 		/* iomap->private should be NULL */
 		WARN_ON_ONCE(iomap->private);
@@ -799,8 +823,10 @@ static vm_fault_t __fuse_dax_fault(struct vm_fault *vmf,
 	if (write)
 		sb_start_pagefault(sb);
 retry:
-	if (retry && !(fcd->nr_free_ranges > 0))
+	if (retry && !(fcd->nr_free_ranges > 0)) {
+		atomic_long_inc(&fcd->nr_waits);
 		wait_event(fcd->range_waitq, (fcd->nr_free_ranges > 0));
+	}
 
 	/*
 	 * We need to serialize against not only truncate but also against
@@ -1010,6 +1036,7 @@ inode_inline_reclaim_one_dmap(struct fuse_conn_dax *fcd, struct inode *inode,
 	dmap->inode = NULL;
 	dmap->itn.start = dmap->itn.last = 0;
 
+	atomic_long_inc(&fcd->nr_inline_reclaimed);
 	pr_debug("fuse: %s: inline reclaimed memory range. inode=%p, window_offset=0x%llx, length=0x%llx\n",
 		 __func__, inode, dmap->window_offset, dmap->length);
 
@@ -1060,6 +1087,7 @@ alloc_dax_mapping_reclaim(struct fuse_conn_dax *fcd, struct inode *inode)
 		 * free up a range and wake us up.
 		 */
 		if (!fi->dax->nr && !(fcd->nr_free_ranges > 0)) {
+			atomic_long_inc(&fcd->nr_waits);
 			if (wait_event_killable_exclusive(fcd->range_waitq,
 					(fcd->nr_free_ranges > 0))) {
 				return ERR_PTR(-EINTR);
@@ -1068,57 +1096,57 @@ alloc_dax_mapping_reclaim(struct fuse_conn_dax *fcd, struct inode *inode)
 	}
 }
 
-static int lookup_and_reclaim_dmap_locked(struct fuse_conn_dax *fcd,
-					  struct inode *inode,
-					  unsigned long start_idx)
-{
-	int ret;
-	struct fuse_inode *fi = get_fuse_inode(inode);
-	struct fuse_dax_mapping *dmap;
-	struct interval_tree_node *node;
-
-	/* Find fuse dax mapping at file offset inode. */
-	node = interval_tree_iter_first(&fi->dax->tree, start_idx, start_idx);
-
-	/* Range already got cleaned up by somebody else */
-	if (!node)
-		return 0;
-	dmap = node_to_dmap(node);
-
-	/* still in use. */
-	if (refcount_read(&dmap->refcnt) > 1)
-		return 0;
-
-	ret = reclaim_one_dmap_locked(inode, dmap);
-	if (ret < 0)
-		return ret;
-
-	/* Cleanup dmap entry and add back to free list */
-	spin_lock(&fcd->lock);
-	dmap_reinit_add_to_free_pool(fcd, dmap);
-	spin_unlock(&fcd->lock);
-	return ret;
-}
-
 /*
- * Free a range of memory.
+ * Free @start_idx and up to @nr - 1 more idle ranges of @inode, and tell the
+ * server about all of them with a single FUSE_REMOVEMAPPING request.
  * Locking:
  * 1. Take mapping->invalidate_lock to block dax faults.
  * 2. Take fi->dax->sem to protect interval tree and also to make sure
  *    read/write can not reuse a dmap which we might be freeing.
+ *
+ * Returns the number of ranges freed or a negative error.
  */
-static int lookup_and_reclaim_dmap(struct fuse_conn_dax *fcd,
-				   struct inode *inode,
-				   unsigned long start_idx,
-				   unsigned long end_idx)
+static int lookup_and_reclaim_dmaps(struct fuse_conn_dax *fcd,
+				    struct inode *inode,
+				    unsigned long start_idx,
+				    unsigned long nr)
 {
-	int ret;
 	struct fuse_inode *fi = get_fuse_inode(inode);
-	loff_t dmap_start = start_idx << FUSE_DAX_SHIFT;
-	loff_t dmap_end = (dmap_start + FUSE_DAX_SZ) - 1;
+	unsigned long idx[FUSE_DAX_RECLAIM_CHUNK];
+	unsigned long first_idx = start_idx, last_idx = start_idx;
+	struct fuse_dax_mapping *dmap, *temp;
+	struct interval_tree_node *node;
+	unsigned int i, count = 0;
+	LIST_HEAD(to_remove);
+	int ret = 0, num = 0;
+
+	nr = clamp_t(unsigned long, nr, 1, FUSE_DAX_RECLAIM_CHUNK);
+	idx[count++] = start_idx;
 
 	filemap_invalidate_lock(inode->i_mapping);
-	ret = fuse_dax_break_layouts(inode, dmap_start, dmap_end);
+
+	/* Pick more idle ranges of this inode to free in the same go */
+	down_read(&fi->dax->sem);
+	for (node = interval_tree_iter_first(&fi->dax->tree, 0, -1);
+	     node && count < nr; node = interval_tree_iter_next(node, 0, -1)) {
+		dmap = node_to_dmap(node);
+		if (dmap->itn.start == start_idx ||
+		    refcount_read(&dmap->refcnt) > 1 ||
+		    READ_ONCE(dmap->referenced))
+			continue;
+		idx[count++] = dmap->itn.start;
+		first_idx = min(first_idx, dmap->itn.start);
+		last_idx = max(last_idx, dmap->itn.start);
+	}
+	up_read(&fi->dax->sem);
+
+	/*
+	 * Break layouts over the whole span in one go, so that faults can't
+	 * map one of the ranges again while we wait for pages of another.
+	 */
+	ret = fuse_dax_break_layouts(inode, first_idx << FUSE_DAX_SHIFT,
+				     (last_idx << FUSE_DAX_SHIFT) +
+				     FUSE_DAX_SZ - 1);
 	if (ret) {
 		pr_debug("virtio_fs: fuse_dax_break_layouts() failed. err=%d\n",
 			 ret);
@@ -1126,22 +1154,70 @@ static int lookup_and_reclaim_dmap(struct fuse_conn_dax *fcd,
 	}
 
 	down_write(&fi->dax->sem);
-	ret = lookup_and_reclaim_dmap_locked(fcd, inode, start_idx);
+	for (i = 0; i < count; i++) {
+		/* Range already got cleaned up by somebody else */
+		node = interval_tree_iter_first(&fi->dax->tree, idx[i], idx[i]);
+		if (!node)
+			continue;
+		dmap = node_to_dmap(node);
+
+		/* still in use. */
+		if (refcount_read(&dmap->refcnt) > 1)
+			continue;
+
+		ret = dmap_writeback_invalidate(inode, dmap);
+		if (ret)
+			break;
+
+		interval_tree_remove(&dmap->itn, &fi->dax->tree);
+		fi->dax->nr--;
+		list_add_tail(&dmap->list, &to_remove);
+		num++;
+	}
+
+	if (num) {
+		/*
+		 * It is possible that umount/shutdown has killed the fuse
+		 * connection and worker thread is trying to reclaim memory in
+		 * parallel.  Don't warn in that case.
+		 */
+		int err = dmap_removemapping_list(inode, num, &to_remove);
+
+		if (err && err != -ENOTCONN)
+			pr_warn("Failed to remove %d mappings. ret=%d\n",
+				num, err);
+	}
 	up_write(&fi->dax->sem);
+
+	/* Cleanup dmap entries and add back to free list */
+	spin_lock(&fcd->lock);
+	list_for_each_entry_safe(dmap, temp, &to_remove, list) {
+		list_del_init(&dmap->list);
+		dmap_reinit_add_to_free_pool(fcd, dmap);
+	}
+	spin_unlock(&fcd->lock);
+	atomic_long_add(num, &fcd->nr_reclaimed);
 out_mmap_sem:
 	filemap_invalidate_unlock(inode->i_mapping);
-	return ret;
+	return num ?: ret;
 }
 
+/*
+ * Ranges are freed in least recently used order: busy_ranges is scanned from
+ * the head, and a range which has been used since the last scan is moved to
+ * the tail instead of being freed.  Ranges found this way are freed together
+ * with other idle ranges of the same inode.
+ *
+ * Returns the number of ranges freed or a negative error.
+ */
 static int try_to_free_dmap_chunks(struct fuse_conn_dax *fcd,
 				   unsigned long nr_to_free)
 {
 	struct fuse_dax_mapping *dmap, *pos, *temp;
 	int ret, nr_freed = 0;
-	unsigned long start_idx = 0, end_idx = 0;
+	unsigned long start_idx = 0;
 	struct inode *inode = NULL;
 
-	/* Pick first busy range and free it for now*/
 	while (1) {
 		if (nr_freed >= nr_to_free)
 			break;
@@ -1151,7 +1227,7 @@ static int try_to_free_dmap_chunks(struct fuse_conn_dax *fcd,
 
 		if (!fcd->nr_busy_ranges) {
 			spin_unlock(&fcd->lock);
-			return 0;
+			return nr_freed;
 		}
 
 		list_for_each_entry_safe(pos, temp, &fcd->busy_ranges,
@@ -1160,6 +1236,19 @@ static int try_to_free_dmap_chunks(struct fuse_conn_dax *fcd,
 			if (refcount_read(&pos->refcnt) > 1)
 				continue;
 
+			/*
+			 * Used since we last looked at it, move it to the tail.
+			 * Each range is moved at most once per scan, as the
+			 * flag is cleared here.
+			 */
+			if (READ_ONCE(pos->referenced)) {
+				WRITE_ONCE(pos->referenced, false);
+				list_move_tail(&pos->busy_list,
+					       &fcd->busy_ranges);
+				atomic_long_inc(&fcd->nr_second_chance);
+				continue;
+			}
+
 			inode = igrab(pos->inode);
 			/*
 			 * This inode is going away. That will free
@@ -1175,20 +1264,21 @@ static int try_to_free_dmap_chunks(struct fuse_conn_dax *fcd,
 			 */
 			dmap = pos;
 			list_move_tail(&dmap->busy_list, &fcd->busy_ranges);
-			start_idx = end_idx = dmap->itn.start;
+			start_idx = dmap->itn.start;
 			break;
 		}
 		spin_unlock(&fcd->lock);
 		if (!dmap)
-			return 0;
+			return nr_freed;
 
-		ret = lookup_and_reclaim_dmap(fcd, inode, start_idx, end_idx);
+		ret = lookup_and_reclaim_dmaps(fcd, inode, start_idx,
+					       nr_to_free - nr_freed);
 		iput(inode);
-		if (ret)
+		if (ret < 0)
 			return ret;
-		nr_freed++;
+		nr_freed += max(ret, 1);
 	}
-	return 0;
+	return nr_freed;
 }
 
 static void fuse_dax_free_mem_worker(struct work_struct *work)
@@ -1197,13 +1287,17 @@ static void fuse_dax_free_mem_worker(struct work_struct *work)
 	struct fuse_conn_dax *fcd = container_of(work, struct fuse_conn_dax,
 						 free_work.work);
 	ret = try_to_free_dmap_chunks(fcd, FUSE_DAX_RECLAIM_CHUNK);
-	if (ret) {
+	if (ret < 0) {
 		pr_debug("fuse: try_to_free_dmap_chunks() failed with err=%d\n",
 			 ret);
 	}
 
-	/* If number of free ranges are still below threshold, requeue */
-	kick_dmap_free_worker(fcd, 1);
+	/*
+	 * If number of free ranges are still below threshold, requeue.  Keep
+	 * going up to the high watermark as long as we make progress.
+	 */
+	kick_dmap_free_worker(fcd, 1, ret > 0 ? FUSE_DAX_RECLAIM_HIGH :
+			      FUSE_DAX_RECLAIM_THRESHOLD);
 }
 
 static void fuse_free_dax_mem_ranges(struct list_head *mem_list)
@@ -1379,6 +1473,37 @@ bool fuse_dax_check_alignment(struct fuse_conn *fc, unsigned int map_alignment)
 	return true;
 }
 
+/* Format the state of the DAX window for the "dax_stats" control file */
+int fuse_dax_stats_show(struct fuse_conn *fc, char *buf, size_t size)
+{
+	struct fuse_conn_dax *fcd = fc->dax;
+	unsigned long nr_busy;
+	long nr_free;
+
+	spin_lock(&fcd->lock);
+	nr_free = fcd->nr_free_ranges;
+	nr_busy = fcd->nr_busy_ranges;
+	spin_unlock(&fcd->lock);
+
+	return scnprintf(buf, size,
+			 "ranges %lu\n"
+			 "free %ld\n"
+			 "busy %lu\n"
+			 "setupmapping %lu\n"
+			 "removemapping %lu\n"
+			 "reclaimed %lu\n"
+			 "inline_reclaimed %lu\n"
+			 "second_chance %lu\n"
+			 "waits %lu\n",
+			 fcd->nr_ranges, nr_free, nr_busy,
+			 atomic_long_read(&fcd->nr_setup),
+			 atomic_long_read(&fcd->nr_removemapping),
+			 atomic_long_read(&fcd->nr_reclaimed),
+			 atomic_long_read(&fcd->nr_inline_reclaimed),
+			 atomic_long_read(&fcd->nr_second_chance),
+			 atomic_long_read(&fcd->nr_waits));
+}
+
 void fuse_dax_cancel_work(struct fuse_conn *fc)
 {
 	struct fuse_conn_dax *fcd = fc->dax;
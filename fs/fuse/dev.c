@@ -28,6 +28,7 @@ MODULE_ALIAS("devname:fuse");
 /* Ordinary requests have even IDs, while interrupts IDs are odd */
 #define FUSE_INT_REQ_BIT (1ULL << 0)
 #define FUSE_REQ_ID_STEP (1ULL << 1)
+#define FUSE_CPU_IQ_ID_SHIFT 48
 
 static struct kmem_cache *fuse_req_cachep;
 
@@ -48,6 +49,7 @@ static void fuse_request_init(struct fuse_mount *fm, struct fuse_req *req)
 	refcount_set(&req->count, 1);
 	__set_bit(FR_PENDING, &req->flags);
 	req->fm = fm;
+	req->fiq = &fm->fc->iq;
 }
 
 static struct fuse_req *fuse_request_alloc(struct fuse_mount *fm, gfp_t flags)
@@ -229,10 +231,65 @@ __releases(fiq->lock)
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		fuse_len_args(req->args->in_numargs,
 			      (struct fuse_arg *) req->args->in_args);
+	req->fiq = fiq;
 	list_add_tail(&req->list, &fiq->pending);
 	fiq->ops->wake_pending_and_unlock(fiq);
 }
 
+/*
+ * The input queue for a request submitted on this CPU: the CPU's own queue if
+ * a device is bound to it, the connection-wide queue otherwise.
+ */
+static struct fuse_iqueue *fuse_cpu_iqueue(struct fuse_conn *fc)
+{
+	struct fuse_iqueue **iqs = smp_load_acquire(&fc->cpu_iqs);
+	struct fuse_iqueue *fiq;
+
+	if (iqs) {
+		fiq = READ_ONCE(iqs[raw_smp_processor_id()]);
+		if (fiq && READ_ONCE(fiq->connected))
+			return fiq;
+	}
+	return &fc->iq;
+}
+
+/*
+ * Lock @fiq for queuing a new request.  A per-CPU queue may have lost its last
+ * device since it was picked, in which case fall back to the connection-wide
+ * queue.
+ */
+static struct fuse_iqueue *fuse_lock_iqueue(struct fuse_conn *fc,
+					    struct fuse_iqueue *fiq)
+__acquires(fiq->lock)
+{
+	spin_lock(&fiq->lock);
+	if (fiq != &fc->iq && !fiq->connected) {
+		spin_unlock(&fiq->lock);
+		fiq = &fc->iq;
+		spin_lock(&fiq->lock);
+	}
+	return fiq;
+}
+
+/*
+ * Lock the input queue a request is on.  req->fiq only changes under the lock
+ * of the old queue, when a per-CPU queue hands its requests back to the
+ * connection-wide one.
+ */
+static struct fuse_iqueue *fuse_req_lock_iqueue(struct fuse_req *req)
+__acquires(fiq->lock)
+{
+	struct fuse_iqueue *fiq;
+
+	for (;;) {
+		fiq = READ_ONCE(req->fiq);
+		spin_lock(&fiq->lock);
+		if (likely(fiq == req->fiq))
+			return fiq;
+		spin_unlock(&fiq->lock);
+	}
+}
+
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 		       u64 nodeid, u64 nlookup)
 {
@@ -254,7 +311,7 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 
 static void flush_bg_queue(struct fuse_conn *fc)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
@@ -263,7 +320,8 @@ static void flush_bg_queue(struct fuse_conn *fc)
 		req = list_first_entry(&fc->bg_queue, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
-		spin_lock(&fiq->lock);
+		/* Queue it where it was submitted, not where it got flushed */
+		fiq = fuse_lock_iqueue(fc, req->fiq);
 		req->in.h.unique = fuse_get_unique(fiq);
 		queue_request_and_unlock(fiq, req);
 	}
@@ -281,7 +339,7 @@ void fuse_request_end(struct fuse_req *req)
 {
 	struct fuse_mount *fm = req->fm;
 	struct fuse_conn *fc = fm->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	if (test_and_set_bit(FR_FINISHED, &req->flags))
 		goto put_request;
@@ -292,7 +350,7 @@ void fuse_request_end(struct fuse_req *req)
 	 * smp_mb() from queue_interrupt().
 	 */
 	if (test_bit(FR_INTERRUPTED, &req->flags)) {
-		spin_lock(&fiq->lock);
+		fiq = fuse_req_lock_iqueue(req);
 		list_del_init(&req->intr_entry);
 		spin_unlock(&fiq->lock);
 	}
@@ -333,9 +391,8 @@ EXPORT_SYMBOL_GPL(fuse_request_end);
 
 static int queue_interrupt(struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &req->fm->fc->iq;
+	struct fuse_iqueue *fiq = fuse_req_lock_iqueue(req);
 
-	spin_lock(&fiq->lock);
 	/* Check for we've sent request to interrupt this req */
 	if (unlikely(!test_bit(FR_INTERRUPTED, &req->flags))) {
 		spin_unlock(&fiq->lock);
@@ -364,7 +421,7 @@ static int queue_interrupt(struct fuse_req *req)
 static void request_wait_answer(struct fuse_req *req)
 {
 	struct fuse_conn *fc = req->fm->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 	int err;
 
 	if (!fc->no_interrupt) {
@@ -388,7 +445,7 @@ static void request_wait_answer(struct fuse_req *req)
 		if (!err)
 			return;
 
-		spin_lock(&fiq->lock);
+		fiq = fuse_req_lock_iqueue(req);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
@@ -409,10 +466,11 @@ static void request_wait_answer(struct fuse_req *req)
 
 static void __fuse_request_send(struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &req->fm->fc->iq;
+	struct fuse_conn *fc = req->fm->fc;
+	struct fuse_iqueue *fiq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->lock);
+	fiq = fuse_lock_iqueue(fc, fuse_cpu_iqueue(fc));
 	if (!fiq->connected) {
 		spin_unlock(&fiq->lock);
 		req->out.h.error = -ENOTCONN;
@@ -533,6 +591,7 @@ static bool fuse_request_queue_background(struct fuse_req *req)
 		atomic_inc(&fc->num_waiting);
 	}
 	__set_bit(FR_ISREPLY, &req->flags);
+	req->fiq = fuse_cpu_iqueue(fc);
 	spin_lock(&fc->bg_lock);
 	if (likely(fc->connected)) {
 		fc->num_background++;
@@ -1206,7 +1265,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq = READ_ONCE(fud->fiq);
 	struct fuse_pqueue *fpq = &fud->pq;
 	struct fuse_req *req;
 	struct fuse_args *args;
@@ -2063,7 +2122,7 @@ static __poll_t fuse_dev_poll(struct file *file, poll_table *wait)
 	if (!fud)
 		return EPOLLERR;
 
-	fiq = &fud->fc->iq;
+	fiq = READ_ONCE(fud->fiq);
 	poll_wait(file, &fiq->waitq, wait);
 
 	spin_lock(&fiq->lock);
@@ -2104,6 +2163,23 @@ static void end_polls(struct fuse_conn *fc)
 	}
 }
 
+static void fuse_abort_iqueue(struct fuse_iqueue *fiq,
+			      struct list_head *to_end)
+{
+	struct fuse_req *req;
+
+	spin_lock(&fiq->lock);
+	fiq->connected = 0;
+	list_for_each_entry(req, &fiq->pending, list)
+		clear_bit(FR_PENDING, &req->flags);
+	list_splice_tail_init(&fiq->pending, to_end);
+	while (forget_pending(fiq))
+		kfree(fuse_dequeue_forget(fiq, 1, NULL));
+	wake_up_all(&fiq->waitq);
+	spin_unlock(&fiq->lock);
+	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+}
+
 /*
  * Abort all requests.
  *
@@ -2124,8 +2200,6 @@ static void end_polls(struct fuse_conn *fc)
  */
 void fuse_abort_conn(struct fuse_conn *fc)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
-
 	spin_lock(&fc->lock);
 	if (fc->connected) {
 		struct fuse_dev *fud;
@@ -2166,16 +2240,16 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		flush_bg_queue(fc);
 		spin_unlock(&fc->bg_lock);
 
-		spin_lock(&fiq->lock);
-		fiq->connected = 0;
-		list_for_each_entry(req, &fiq->pending, list)
-			clear_bit(FR_PENDING, &req->flags);
-		list_splice_tail_init(&fiq->pending, &to_end);
-		while (forget_pending(fiq))
-			kfree(fuse_dequeue_forget(fiq, 1, NULL));
-		wake_up_all(&fiq->waitq);
-		spin_unlock(&fiq->lock);
-		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+		fuse_abort_iqueue(&fc->iq, &to_end);
+		if (fc->cpu_iqs) {
+			int cpu;
+
+			for_each_possible_cpu(cpu) {
+				if (fc->cpu_iqs[cpu])
+					fuse_abort_iqueue(fc->cpu_iqs[cpu],
+							  &to_end);
+			}
+		}
 		end_polls(fc);
 		wake_up_all(&fc->blocked_waitq);
 		spin_unlock(&fc->lock);
@@ -2194,6 +2268,110 @@ void fuse_wait_aborted(struct fuse_conn *fc)
 	wait_event(fc->blocked_waitq, atomic_read(&fc->num_waiting) == 0);
 }
 
+/*
+ * Bind a device to the input queue of @cpu.  Requests submitted on that CPU
+ * are then only read through devices bound to its queue.  Forgets, notify
+ * replies and requests from CPUs without a bound queue keep going to the
+ * connection-wide queue, so at least one device must stay unbound.
+ */
+static int fuse_bind_iqueue(struct fuse_dev *fud, struct file *file,
+			    unsigned int cpu)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue **iqs = NULL, *fiq = NULL, *target;
+	int err = 0;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	/* The fasync entry lives on the queue the device reads from */
+	if (file->f_flags & FASYNC)
+		return -EBUSY;
+
+	if (!READ_ONCE(fc->cpu_iqs)) {
+		iqs = kcalloc(nr_cpu_ids, sizeof(*iqs), GFP_KERNEL);
+		if (!iqs)
+			return -ENOMEM;
+	}
+	if (iqs || !READ_ONCE(fc->cpu_iqs[cpu])) {
+		fiq = kzalloc(sizeof(*fiq), GFP_KERNEL);
+		if (!fiq) {
+			kfree(iqs);
+			return -ENOMEM;
+		}
+		fuse_iqueue_init(fiq, &fuse_dev_fiq_ops, NULL);
+		fiq->connected = 0;
+		/* Keep request ids unique across the queues of the connection */
+		fiq->reqctr = (u64)(cpu + 1) << FUSE_CPU_IQ_ID_SHIFT;
+	}
+
+	spin_lock(&fc->lock);
+	if (!fc->connected) {
+		err = -ENOTCONN;
+		goto out_unlock;
+	}
+	if (fud->fiq != &fc->iq) {
+		err = -EBUSY;
+		goto out_unlock;
+	}
+	if (!fc->cpu_iqs) {
+		smp_store_release(&fc->cpu_iqs, iqs);
+		iqs = NULL;
+	}
+	if (!fc->cpu_iqs[cpu]) {
+		WRITE_ONCE(fc->cpu_iqs[cpu], fiq);
+		fiq = NULL;
+	}
+	target = fc->cpu_iqs[cpu];
+
+	spin_lock(&target->lock);
+	target->nr_devs++;
+	target->connected = 1;
+	spin_unlock(&target->lock);
+	WRITE_ONCE(fud->fiq, target);
+out_unlock:
+	spin_unlock(&fc->lock);
+	kfree(fiq);
+	kfree(iqs);
+	return err;
+}
+
+/*
+ * A device bound to a per-CPU queue is going away.  If it was the last one,
+ * hand the requests still waiting on the queue over to the connection-wide
+ * queue so that the remaining devices pick them up.
+ *
+ * Lock ordering: a per-CPU queue's lock nests outside the connection-wide
+ * queue's lock.  Nothing takes them the other way around, and no path holds
+ * two per-CPU queue locks at once.
+ */
+static void fuse_unbind_iqueue(struct fuse_conn *fc, struct fuse_iqueue *fiq)
+{
+	struct fuse_iqueue *main_fiq = &fc->iq;
+	struct fuse_req *req;
+
+	spin_lock(&fiq->lock);
+	if (--fiq->nr_devs || !fiq->connected) {
+		spin_unlock(&fiq->lock);
+		return;
+	}
+
+	fiq->connected = 0;
+	/* Both locks are of the same class, tell lockdep about the nesting */
+	spin_lock_nested(&main_fiq->lock, SINGLE_DEPTH_NESTING);
+	list_for_each_entry(req, &fiq->pending, list)
+		req->fiq = main_fiq;
+	list_for_each_entry(req, &fiq->interrupts, intr_entry)
+		req->fiq = main_fiq;
+	list_splice_tail_init(&fiq->pending, &main_fiq->pending);
+	list_splice_tail_init(&fiq->interrupts, &main_fiq->interrupts);
+	if (request_pending(main_fiq))
+		main_fiq->ops->wake_pending_and_unlock(main_fiq);
+	else
+		spin_unlock(&main_fiq->lock);
+	spin_unlock(&fiq->lock);
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2212,6 +2390,9 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 
 		end_requests(&to_end);
 
+		if (fud->fiq != &fc->iq)
+			fuse_unbind_iqueue(fc, fud->fiq);
+
 		/* Are we the last open device? */
 		if (atomic_dec_and_test(&fc->dev_count)) {
 			WARN_ON(fc->iq.fasync != NULL);
@@ -2231,7 +2412,7 @@ static int fuse_dev_fasync(int fd, struct file *file, int on)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fud->fc->iq.fasync);
+	return fasync_helper(fd, file, on, &fud->fiq->fasync);
 }
 
 static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
@@ -2256,6 +2437,9 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 {
 	int res;
 	int oldfd;
+	u32 cpu;
+	int backing_id;
+	struct fuse_backing_map map;
 	struct fuse_dev *fud = NULL;
 	struct fd f;
 
@@ -2283,6 +2467,43 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 		}
 		fdput(f);
 		break;
+	case FUSE_DEV_IOC_BIND_QUEUE:
+		if (get_user(cpu, (__u32 __user *)arg))
+			return -EFAULT;
+
+		/* Not for CUSE, which uses the same ioctl handler */
+		fud = fuse_get_dev(file);
+		if (!fud || file->f_op != &fuse_dev_operations)
+			return -EINVAL;
+
+		res = fuse_bind_iqueue(fud, file, cpu);
+		break;
+	case FUSE_DEV_IOC_BACKING_OPEN:
+		fud = fuse_get_dev(file);
+		if (!fud)
+			return -EPERM;
+
+		if (!IS_ENABLED(CONFIG_FUSE_PASSTHROUGH))
+			return -EOPNOTSUPP;
+
+		if (copy_from_user(&map, (void __user *)arg, sizeof(map)))
+			return -EFAULT;
+
+		res = fuse_backing_open(fud->fc, &map);
+		break;
+	case FUSE_DEV_IOC_BACKING_CLOSE:
+		fud = fuse_get_dev(file);
+		if (!fud)
+			return -EPERM;
+
+		if (!IS_ENABLED(CONFIG_FUSE_PASSTHROUGH))
+			return -EOPNOTSUPP;
+
+		if (get_user(backing_id, (__u32 __user *)arg))
+			return -EFAULT;
+
+		res = fuse_backing_close(fud->fc, backing_id);
+		break;
 	default:
 		res = -ENOTTY;
 		break;
@@ -38,6 +38,11 @@
 /** Maximum of max_pages received in init_out */
 #define FUSE_MAX_MAX_PAGES 256
 
+/** Bind a /dev/fuse clone to the input queue of the CPU given as a __u32 */
+#ifndef FUSE_DEV_IOC_BIND_QUEUE
+#define FUSE_DEV_IOC_BIND_QUEUE	_IOW(FUSE_DEV_IOC_MAGIC, 3, uint32_t)
+#endif
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -45,7 +50,7 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
 
 /** List of active connections */
 extern struct list_head fuse_conn_list;
@@ -226,6 +231,26 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** Backing file registered by the server for passthrough I/O */
+	struct fuse_backing *backing;
+
+	/** ... and the file opened on it on behalf of this file */
+	struct file *passthrough;
+#endif
+};
+
+/** A file registered with FUSE_DEV_IOC_BACKING_OPEN */
+struct fuse_backing {
+	struct file *file;
+
+	/** Credentials of the server, used for passthrough I/O */
+	const struct cred *cred;
+
+	/** refcount */
+	refcount_t count;
+	struct rcu_head rcu;
 };
 
 /** One input argument of a request */
@@ -376,6 +401,9 @@ struct fuse_req {
 
 	/** fuse_mount this request belongs to */
 	struct fuse_mount *fm;
+
+	/** Input queue the request is queued on, protected by its lock */
+	struct fuse_iqueue *fiq;
 };
 
 struct fuse_iqueue;
@@ -450,6 +478,9 @@ struct fuse_iqueue {
 
 	/** Device-specific state */
 	void *priv;
+
+	/** Number of devices bound to a per-CPU queue */
+	unsigned int nr_devs;
 };
 
 #define FUSE_PQ_HASH_BITS 8
@@ -479,6 +510,9 @@ struct fuse_dev {
 	/** Processing queue */
 	struct fuse_pqueue pq;
 
+	/** Input queue this device reads from */
+	struct fuse_iqueue *fiq;
+
 	/** list entry on fc->devices */
 	struct list_head entry;
 };
@@ -577,6 +611,18 @@ struct fuse_conn {
 	/** Input queue */
 	struct fuse_iqueue iq;
 
+	/**
+	 * Per-CPU input queues, indexed by CPU and created when a device is
+	 * first bound to one.  Set once under fc->lock, freed with the
+	 * connection.
+	 */
+	struct fuse_iqueue **cpu_iqs;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** Backing files registered for passthrough, indexed by id */
+	struct idr backing_files_map;
+#endif
+
 	/** The next unique kernel file handle */
 	atomic64_t khctr;
 
@@ -792,6 +838,9 @@ struct fuse_conn {
 	/* Is tmpfile not implemented by fs? */
 	unsigned int no_tmpfile:1;
 
+	/* Can the server register backing files for passthrough? */
+	unsigned int passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -1012,7 +1061,7 @@ int fuse_open_common(struct inode *inode, struct file *file, bool isdir);
 
 struct fuse_file *fuse_file_alloc(struct fuse_mount *fm);
 void fuse_file_free(struct fuse_file *ff);
-void fuse_finish_open(struct inode *inode, struct file *file);
+int fuse_finish_open(struct inode *inode, struct file *file);
 
 void fuse_sync_release(struct fuse_inode *fi, struct fuse_file *ff,
 		       unsigned int flags);
@@ -1289,12 +1338,23 @@ unsigned int fuse_len_args(unsigned int numargs, struct fuse_arg *args);
  * Get the next unique ID for a request
  */
 u64 fuse_get_unique(struct fuse_iqueue *fiq);
+void fuse_iqueue_init(struct fuse_iqueue *fiq,
+		      const struct fuse_iqueue_ops *ops, void *priv);
 void fuse_free_conn(struct fuse_conn *fc);
 
 /* dax.c */
 
 #define FUSE_IS_DAX(inode) (IS_ENABLED(CONFIG_FUSE_DAX) && IS_DAX(inode))
 
+static inline bool fuse_conn_has_dax(struct fuse_conn *fc)
+{
+#ifdef CONFIG_FUSE_DAX
+	return fc->dax;
+#else
+	return false;
+#endif
+}
+
 ssize_t fuse_dax_read_iter(struct kiocb *iocb, struct iov_iter *to);
 ssize_t fuse_dax_write_iter(struct kiocb *iocb, struct iov_iter *from);
 int fuse_dax_mmap(struct file *file, struct vm_area_struct *vma);
@@ -1308,6 +1368,37 @@ void fuse_dax_inode_cleanup(struct inode *inode);
 void fuse_dax_dontcache(struct inode *inode, unsigned int flags);
 bool fuse_dax_check_alignment(struct fuse_conn *fc, unsigned int map_alignment);
 void fuse_dax_cancel_work(struct fuse_conn *fc);
+int fuse_dax_stats_show(struct fuse_conn *fc, char *buf, size_t size);
+
+/* passthrough.c */
+
+static inline struct file *fuse_file_passthrough(struct fuse_file *ff)
+{
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	return READ_ONCE(ff->passthrough);
+#else
+	return NULL;
+#endif
+}
+
+void fuse_backing_files_init(struct fuse_conn *fc);
+void fuse_backing_files_free(struct fuse_conn *fc);
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+int fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			   struct fuse_open_out *openarg);
+int fuse_passthrough_open(struct inode *inode, struct file *file);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+#ifdef CONFIG_FUSE_PASSTHROUGH
+int fuse_passthrough_init(void);
+void fuse_passthrough_cleanup(void);
+#else
+static inline int fuse_passthrough_init(void) { return 0; }
+static inline void fuse_passthrough_cleanup(void) { }
+#endif
 
 /* ioctl.c */
 long fuse_file_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
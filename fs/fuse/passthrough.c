@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE passthrough to backing files
+ *
+ * The server registers an open file with FUSE_DEV_IOC_BACKING_OPEN and gets
+ * an id for it.  When it replies to FUSE_OPEN or FUSE_CREATE with
+ * FOPEN_PASSTHROUGH and that id in backing_id, reads, writes and mmap of the
+ * new file go straight to the backing file, with the credentials of the
+ * server that registered it.  Opens, releases and all metadata operations
+ * still go through the server.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/idr.h>
+#include <linux/uio.h>
+
+struct fuse_aio_req {
+	struct kiocb iocb;
+	refcount_t ref;
+	struct kiocb *orig_iocb;
+	/* for punting write completions to fuse_aio_wq */
+	struct work_struct work;
+	long res;
+};
+
+/* Completes AIO writes to backing files in process context */
+static struct workqueue_struct *fuse_aio_wq;
+
+static struct fuse_backing *fuse_backing_get(struct fuse_backing *fb)
+{
+	if (fb && refcount_inc_not_zero(&fb->count))
+		return fb;
+	return NULL;
+}
+
+static void fuse_backing_free(struct fuse_backing *fb)
+{
+	fput(fb->file);
+	put_cred(fb->cred);
+	kfree_rcu(fb, rcu);
+}
+
+static void fuse_backing_put(struct fuse_backing *fb)
+{
+	if (fb && refcount_dec_and_test(&fb->count))
+		fuse_backing_free(fb);
+}
+
+void fuse_backing_files_init(struct fuse_conn *fc)
+{
+	idr_init(&fc->backing_files_map);
+}
+
+static int fuse_backing_id_free(int id, void *p, void *data)
+{
+	struct fuse_backing *fb = p;
+
+	WARN_ON_ONCE(refcount_read(&fb->count) != 1);
+	fuse_backing_free(fb);
+	return 0;
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->backing_files_map, fuse_backing_id_free, NULL);
+	idr_destroy(&fc->backing_files_map);
+}
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct fuse_backing *fb;
+	struct file *file;
+	int res;
+
+	/* The backing file will be accessed with the caller's credentials */
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (map->flags || map->padding)
+		return -EINVAL;
+
+	file = fget(map->fd);
+	if (!file)
+		return -EBADF;
+
+	res = -EINVAL;
+	if (!S_ISREG(file_inode(file)->i_mode) ||
+	    !file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	/* Don't stack passthrough on top of another stacking filesystem */
+	res = -ELOOP;
+	if (file_inode(file)->i_sb->s_stack_depth)
+		goto out_fput;
+
+	res = -ENOMEM;
+	fb = kmalloc(sizeof(*fb), GFP_KERNEL);
+	if (!fb)
+		goto out_fput;
+
+	fb->file = file;
+	fb->cred = get_current_cred();
+	refcount_set(&fb->count, 1);
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	res = idr_alloc_cyclic(&fc->backing_files_map, fb, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+
+	if (res < 0)
+		fuse_backing_free(fb);
+	return res;
+
+out_fput:
+	fput(file);
+	return res;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct fuse_backing *fb;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	fb = idr_remove(&fc->backing_files_map, backing_id);
+	spin_unlock(&fc->lock);
+	if (!fb)
+		return -ENOENT;
+
+	/* Files already opened in passthrough mode keep their reference */
+	fuse_backing_put(fb);
+	return 0;
+}
+
+static struct fuse_backing *fuse_backing_lookup(struct fuse_conn *fc,
+						int backing_id)
+{
+	struct fuse_backing *fb;
+
+	rcu_read_lock();
+	fb = fuse_backing_get(idr_find(&fc->backing_files_map, backing_id));
+	rcu_read_unlock();
+
+	return fb;
+}
+
+/*
+ * Called with the reply to FUSE_OPEN or FUSE_CREATE, before there is a struct
+ * file to open the backing file for.
+ */
+int fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			   struct fuse_open_out *openarg)
+{
+	if (!(openarg->open_flags & FOPEN_PASSTHROUGH))
+		return 0;
+
+	if (!fc->passthrough || openarg->backing_id <= 0)
+		return -EIO;
+
+	ff->backing = fuse_backing_lookup(fc, openarg->backing_id);
+	if (!ff->backing)
+		return -EIO;
+
+	return 0;
+}
+
+int fuse_passthrough_open(struct inode *inode, struct file *file)
+{
+	struct fuse_file *ff = file->private_data;
+	struct fuse_backing *fb = ff->backing;
+	struct file *backing_file;
+	int flags = file->f_flags & ~(O_CREAT | O_EXCL | O_NOCTTY | O_TRUNC);
+
+	if (!fb)
+		return 0;
+
+	backing_file = open_with_fake_path(&file->f_path, flags,
+					   file_inode(fb->file), fb->cred);
+	if (IS_ERR(backing_file))
+		return PTR_ERR(backing_file);
+
+	WRITE_ONCE(ff->passthrough, backing_file);
+	return 0;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough)
+		fput(ff->passthrough);
+	ff->passthrough = NULL;
+
+	fuse_backing_put(ff->backing);
+	ff->backing = NULL;
+}
+
+static rwf_t fuse_iocb_to_rwf(int ifl)
+{
+	rwf_t flags = 0;
+
+	if (ifl & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+	if (ifl & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ifl & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ifl & IOCB_SYNC)
+		flags |= RWF_SYNC;
+
+	return flags;
+}
+
+static void fuse_aio_put(struct fuse_aio_req *aio_req)
+{
+	if (refcount_dec_and_test(&aio_req->ref)) {
+		fput(aio_req->iocb.ki_filp);
+		kfree(aio_req);
+	}
+}
+
+static void fuse_aio_cleanup_handler(struct fuse_aio_req *aio_req, long res)
+{
+	struct kiocb *iocb = &aio_req->iocb;
+	struct kiocb *orig_iocb = aio_req->orig_iocb;
+
+	if (iocb->ki_flags & IOCB_WRITE) {
+		struct inode *inode = file_inode(orig_iocb->ki_filp);
+
+		/* Actually acquired in fuse_passthrough_write_iter() */
+		__sb_writers_acquired(file_inode(iocb->ki_filp)->i_sb,
+				      SB_FREEZE_WRITE);
+		file_end_write(iocb->ki_filp);
+		if (res > 0)
+			fuse_write_update_attr(inode, iocb->ki_pos, res);
+	}
+
+	orig_iocb->ki_pos = iocb->ki_pos;
+	fuse_aio_put(aio_req);
+}
+
+static void fuse_aio_complete_work(struct work_struct *work)
+{
+	struct fuse_aio_req *aio_req =
+		container_of(work, struct fuse_aio_req, work);
+	struct kiocb *orig_iocb = aio_req->orig_iocb;
+	long res = aio_req->res;
+
+	fuse_aio_cleanup_handler(aio_req, res);
+	orig_iocb->ki_complete(orig_iocb, res);
+}
+
+static void fuse_aio_rw_complete(struct kiocb *iocb, long res)
+{
+	struct fuse_aio_req *aio_req =
+		container_of(iocb, struct fuse_aio_req, iocb);
+	struct kiocb *orig_iocb = aio_req->orig_iocb;
+
+	/*
+	 * ->ki_complete() may be called from interrupt context.  Ending a
+	 * write drops freeze protection and updates the attributes under
+	 * fi->lock, so punt it to process context.
+	 */
+	if (iocb->ki_flags & IOCB_WRITE) {
+		aio_req->res = res;
+		INIT_WORK(&aio_req->work, fuse_aio_complete_work);
+		queue_work(fuse_aio_wq, &aio_req->work);
+		return;
+	}
+
+	fuse_aio_cleanup_handler(aio_req, res);
+	orig_iocb->ki_complete(orig_iocb, res);
+}
+
+static struct fuse_aio_req *fuse_aio_alloc(struct kiocb *iocb,
+					   struct file *backing_file, int ifl)
+{
+	struct fuse_aio_req *aio_req;
+
+	aio_req = kzalloc(sizeof(*aio_req), GFP_KERNEL);
+	if (!aio_req)
+		return NULL;
+
+	aio_req->orig_iocb = iocb;
+	kiocb_clone(&aio_req->iocb, iocb, get_file(backing_file));
+	aio_req->iocb.ki_flags = ifl;
+	aio_req->iocb.ki_complete = fuse_aio_rw_complete;
+	refcount_set(&aio_req->ref, 2);
+
+	return aio_req;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(iter))
+		return 0;
+
+	if (iocb->ki_flags & IOCB_DIRECT &&
+	    !(backing_file->f_mode & FMODE_CAN_ODIRECT))
+		return -EINVAL;
+
+	old_cred = override_creds(ff->backing->cred);
+	if (is_sync_kiocb(iocb)) {
+		ret = vfs_iter_read(backing_file, iter, &iocb->ki_pos,
+				    fuse_iocb_to_rwf(iocb->ki_flags));
+	} else {
+		struct fuse_aio_req *aio_req;
+
+		ret = -ENOMEM;
+		aio_req = fuse_aio_alloc(iocb, backing_file, iocb->ki_flags);
+		if (!aio_req)
+			goto out;
+
+		ret = vfs_iocb_iter_read(backing_file, &aio_req->iocb, iter);
+		fuse_aio_put(aio_req);
+		if (ret != -EIOCBQUEUED)
+			fuse_aio_cleanup_handler(aio_req, ret);
+	}
+out:
+	revert_creds(old_cred);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(iter))
+		return 0;
+
+	if (iocb->ki_flags & IOCB_DIRECT &&
+	    !(backing_file->f_mode & FMODE_CAN_ODIRECT))
+		return -EINVAL;
+
+	inode_lock(inode);
+	old_cred = override_creds(ff->backing->cred);
+	if (is_sync_kiocb(iocb)) {
+		file_start_write(backing_file);
+		ret = vfs_iter_write(backing_file, iter, &iocb->ki_pos,
+				     fuse_iocb_to_rwf(iocb->ki_flags));
+		file_end_write(backing_file);
+		if (ret > 0)
+			fuse_write_update_attr(inode, iocb->ki_pos, ret);
+	} else {
+		struct fuse_aio_req *aio_req;
+
+		ret = -ENOMEM;
+		aio_req = fuse_aio_alloc(iocb, backing_file, iocb->ki_flags);
+		if (!aio_req)
+			goto out;
+
+		file_start_write(backing_file);
+		/* Pacify lockdep, same trick as done in aio_write() */
+		__sb_writers_release(file_inode(backing_file)->i_sb,
+				     SB_FREEZE_WRITE);
+		ret = vfs_iocb_iter_write(backing_file, &aio_req->iocb, iter);
+		fuse_aio_put(aio_req);
+		if (ret != -EIOCBQUEUED)
+			fuse_aio_cleanup_handler(aio_req, ret);
+	}
+out:
+	revert_creds(old_cred);
+	inode_unlock(inode);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!backing_file->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma_set_file(vma, backing_file);
+
+	old_cred = override_creds(ff->backing->cred);
+	ret = call_mmap(vma->vm_file, vma);
+	revert_creds(old_cred);
+
+	return ret;
+}
+
+int __init fuse_passthrough_init(void)
+{
+	fuse_aio_wq = alloc_workqueue("fuse_aio", WQ_MEM_RECLAIM, 0);
+	if (!fuse_aio_wq)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void fuse_passthrough_cleanup(void)
+{
+	destroy_workqueue(fuse_aio_wq);
+}
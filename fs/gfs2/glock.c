@@ -30,7 +30,7 @@
 #include <linux/rculist_bl.h>
 #include <linux/bit_spinlock.h>
 #include <linux/percpu.h>
-#include <linux/list_sort.h>
+#include <linux/list_lru.h>
 #include <linux/lockref.h>
 #include <linux/rhashtable.h>
 #include <linux/pid_namespace.h>
@@ -67,9 +67,8 @@ static void handle_callback(struct gfs2_glock *gl, unsigned int state,
 
 static struct dentry *gfs2_root;
 static struct workqueue_struct *glock_workqueue;
-static LIST_HEAD(lru_list);
-static atomic_t lru_count = ATOMIC_INIT(0);
-static DEFINE_SPINLOCK(lru_lock);
+/* Unused glocks, kept per NUMA node so the shrinker only takes node locks */
+static struct list_lru gfs2_glock_lru;
 
 #define GFS2_GL_HASH_SHIFT      15
 #define GFS2_GL_HASH_SIZE       BIT(GFS2_GL_HASH_SHIFT)
@@ -79,6 +78,7 @@ static const struct rhashtable_params ht_parms = {
 	.key_len = offsetofend(struct lm_lockname, ln_type),
 	.key_offset = offsetof(struct gfs2_glock, gl_name),
 	.head_offset = offsetof(struct gfs2_glock, gl_node),
+	.automatic_shrinking = true,
 };
 
 static struct rhashtable gl_hash_table;
@@ -218,16 +218,10 @@ void gfs2_glock_add_to_lru(struct gfs2_glock *gl)
 	if (!(gl->gl_ops->go_flags & GLOF_LRU))
 		return;
 
-	spin_lock(&lru_lock);
-
-	list_move_tail(&gl->gl_lru, &lru_list);
-
-	if (!test_bit(GLF_LRU, &gl->gl_flags)) {
-		set_bit(GLF_LRU, &gl->gl_flags);
-		atomic_inc(&lru_count);
-	}
-
-	spin_unlock(&lru_lock);
+	/* Move to the tail so that recently used glocks are scanned last */
+	set_bit(GLF_LRU, &gl->gl_flags);
+	list_lru_del(&gfs2_glock_lru, &gl->gl_lru);
+	list_lru_add(&gfs2_glock_lru, &gl->gl_lru);
 }
 
 static void gfs2_glock_remove_from_lru(struct gfs2_glock *gl)
@@ -235,13 +229,8 @@ static void gfs2_glock_remove_from_lru(struct gfs2_glock *gl)
 	if (!(gl->gl_ops->go_flags & GLOF_LRU))
 		return;
 
-	spin_lock(&lru_lock);
-	if (test_bit(GLF_LRU, &gl->gl_flags)) {
-		list_del_init(&gl->gl_lru);
-		atomic_dec(&lru_count);
+	if (list_lru_del(&gfs2_glock_lru, &gl->gl_lru))
 		clear_bit(GLF_LRU, &gl->gl_flags);
-	}
-	spin_unlock(&lru_lock);
 }
 
 /*
@@ -1200,6 +1189,7 @@ int gfs2_glock_get(struct gfs2_sbd *sdp, u64 number,
 	preempt_enable();
 	gl->gl_stats.stats[GFS2_LKS_DCOUNT] = 0;
 	gl->gl_stats.stats[GFS2_LKS_QCOUNT] = 0;
+	gl->gl_stats.stats[GFS2_LKS_LRU] = 0;
 	gl->gl_tchange = jiffies;
 	gl->gl_object = NULL;
 	gl->gl_hold_time = GL_GLOCK_DFT_HOLD;
@@ -1931,105 +1921,49 @@ void gfs2_glock_complete(struct gfs2_glock *gl, int ret)
 	spin_unlock(&gl->gl_lockref.lock);
 }
 
-static int glock_cmp(void *priv, const struct list_head *a,
-		     const struct list_head *b)
-{
-	struct gfs2_glock *gla, *glb;
-
-	gla = list_entry(a, struct gfs2_glock, gl_lru);
-	glb = list_entry(b, struct gfs2_glock, gl_lru);
-
-	if (gla->gl_name.ln_number > glb->gl_name.ln_number)
-		return 1;
-	if (gla->gl_name.ln_number < glb->gl_name.ln_number)
-		return -1;
-
-	return 0;
-}
-
 /**
- * gfs2_dispose_glock_lru - Demote a list of glocks
- * @list: The list to dispose of
- *
- * Disposing of glocks may involve disk accesses, so that here we sort
- * the glocks by number (i.e. disk location of the inodes) so that if
- * there are any such accesses, they'll be sent in order (mostly).
+ * gfs2_glock_isolate - Demote a glock found on the LRU
+ * @item: The glock's LRU list entry
+ * @lru: The per-node LRU list the glock is on
+ * @lru_lock: The lock protecting @lru
+ * @arg: Unused
  *
- * Must be called under the lru_lock, but may drop and retake this
- * lock. While the lru_lock is dropped, entries may vanish from the
- * list, but no new entries will appear on the list (since it is
- * private)
+ * Called by the shrinker under the node's LRU lock only. Unused glocks are
+ * taken off the LRU and demoted right here, which only queues glock work,
+ * so no private dispose list is needed and the node lock is the only lock
+ * held across the walk. Glocks which are in use are rotated to the tail so
+ * that the next walk does not trip over them again.
  */
 
-static void gfs2_dispose_glock_lru(struct list_head *list)
-__releases(&lru_lock)
-__acquires(&lru_lock)
+static enum lru_status gfs2_glock_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
-	struct gfs2_glock *gl;
+	struct gfs2_glock *gl = list_entry(item, struct gfs2_glock, gl_lru);
 
-	list_sort(NULL, list, glock_cmp);
-
-	while(!list_empty(list)) {
-		gl = list_first_entry(list, struct gfs2_glock, gl_lru);
-		list_del_init(&gl->gl_lru);
-		clear_bit(GLF_LRU, &gl->gl_flags);
-		if (!spin_trylock(&gl->gl_lockref.lock)) {
-add_back_to_lru:
-			list_add(&gl->gl_lru, &lru_list);
-			set_bit(GLF_LRU, &gl->gl_flags);
-			atomic_inc(&lru_count);
-			continue;
-		}
-		if (test_and_set_bit(GLF_LOCK, &gl->gl_flags)) {
-			spin_unlock(&gl->gl_lockref.lock);
-			goto add_back_to_lru;
-		}
-		gl->gl_lockref.count++;
-		if (demote_ok(gl))
-			handle_callback(gl, LM_ST_UNLOCKED, 0, false);
-		WARN_ON(!test_and_clear_bit(GLF_LOCK, &gl->gl_flags));
-		__gfs2_glock_queue_work(gl, 0);
+	if (test_bit(GLF_LOCK, &gl->gl_flags))
+		return LRU_SKIP;
+	if (!spin_trylock(&gl->gl_lockref.lock))
+		return LRU_SKIP;
+	if (gl->gl_lockref.count) {
 		spin_unlock(&gl->gl_lockref.lock);
-		cond_resched_lock(&lru_lock);
+		return LRU_ROTATE;
 	}
-}
-
-/**
- * gfs2_scan_glock_lru - Scan the LRU looking for locks to demote
- * @nr: The number of entries to scan
- *
- * This function selects the entries on the LRU which are able to
- * be demoted, and then kicks off the process by calling
- * gfs2_dispose_glock_lru() above.
- */
-
-static long gfs2_scan_glock_lru(int nr)
-{
-	struct gfs2_glock *gl, *next;
-	LIST_HEAD(dispose);
-	long freed = 0;
-
-	spin_lock(&lru_lock);
-	list_for_each_entry_safe(gl, next, &lru_list, gl_lru) {
-		if (nr-- <= 0)
-			break;
-		/* Test for being demotable */
-		if (!test_bit(GLF_LOCK, &gl->gl_flags)) {
-			if (!spin_trylock(&gl->gl_lockref.lock))
-				continue;
-			if (!gl->gl_lockref.count) {
-				list_move(&gl->gl_lru, &dispose);
-				atomic_dec(&lru_count);
-				freed++;
-			}
-			spin_unlock(&gl->gl_lockref.lock);
-		}
+	if (test_and_set_bit(GLF_LOCK, &gl->gl_flags)) {
+		spin_unlock(&gl->gl_lockref.lock);
+		return LRU_SKIP;
 	}
-	if (!list_empty(&dispose))
-		gfs2_dispose_glock_lru(&dispose);
-	spin_unlock(&lru_lock);
 
-	return freed;
+	list_lru_isolate(lru, &gl->gl_lru);
+	clear_bit(GLF_LRU, &gl->gl_flags);
+	gl->gl_lockref.count++;
+	if (demote_ok(gl)) {
+		handle_callback(gl, LM_ST_UNLOCKED, 0, false);
+		gfs2_sbstats_inc(gl, GFS2_LKS_LRU);
+	}
+	WARN_ON(!test_and_clear_bit(GLF_LOCK, &gl->gl_flags));
+	__gfs2_glock_queue_work(gl, 0);
+	spin_unlock(&gl->gl_lockref.lock);
+	return LRU_REMOVED;
 }
 
 static unsigned long gfs2_glock_shrink_scan(struct shrinker *shrink,
@@ -2037,19 +1971,21 @@ static unsigned long gfs2_glock_shrink_scan(struct shrinker *shrink,
 {
 	if (!(sc->gfp_mask & __GFP_FS))
 		return SHRINK_STOP;
-	return gfs2_scan_glock_lru(sc->nr_to_scan);
+	return list_lru_shrink_walk(&gfs2_glock_lru, sc,
+				    gfs2_glock_isolate, NULL);
 }
 
 static unsigned long gfs2_glock_shrink_count(struct shrinker *shrink,
 					     struct shrink_control *sc)
 {
-	return vfs_pressure_ratio(atomic_read(&lru_count));
+	return vfs_pressure_ratio(list_lru_shrink_count(&gfs2_glock_lru, sc));
 }
 
 static struct shrinker glock_shrinker = {
 	.seeks = DEFAULT_SEEKS,
 	.count_objects = gfs2_glock_shrink_count,
 	.scan_objects = gfs2_glock_shrink_scan,
+	.flags = SHRINKER_NUMA_AWARE,
 };
 
 /**
@@ -2426,6 +2362,7 @@ static const char *gfs2_stype[] = {
 	[GFS2_LKS_SIRTVAR]	= "sirtvar",
 	[GFS2_LKS_DCOUNT]	= "dlm",
 	[GFS2_LKS_QCOUNT]	= "queue",
+	[GFS2_LKS_LRU]		= "lru",
 };
 
 #define GFS2_NR_SBSTATS (ARRAY_SIZE(gfs2_gltype) * ARRAY_SIZE(gfs2_stype))
@@ -2434,8 +2371,8 @@ static int gfs2_sbstats_seq_show(struct seq_file *seq, void *iter_ptr)
 {
 	struct gfs2_sbd *sdp = seq->private;
 	loff_t pos = *(loff_t *)iter_ptr;
-	unsigned index = pos >> 3;
-	unsigned subindex = pos & 0x07;
+	unsigned index = pos / GFS2_NR_LKSTATS;
+	unsigned subindex = pos % GFS2_NR_LKSTATS;
 	int i;
 
 	if (index == 0 && subindex != 0)
@@ -2465,9 +2402,16 @@ int __init gfs2_glock_init(void)
 	if (ret < 0)
 		return ret;
 
+	ret = list_lru_init(&gfs2_glock_lru);
+	if (ret) {
+		rhashtable_destroy(&gl_hash_table);
+		return ret;
+	}
+
 	glock_workqueue = alloc_workqueue("glock_workqueue", WQ_MEM_RECLAIM |
 					  WQ_HIGHPRI | WQ_FREEZABLE, 0);
 	if (!glock_workqueue) {
+		list_lru_destroy(&gfs2_glock_lru);
 		rhashtable_destroy(&gl_hash_table);
 		return -ENOMEM;
 	}
@@ -2475,6 +2419,7 @@ int __init gfs2_glock_init(void)
 	ret = register_shrinker(&glock_shrinker, "gfs2-glock");
 	if (ret) {
 		destroy_workqueue(glock_workqueue);
+		list_lru_destroy(&gfs2_glock_lru);
 		rhashtable_destroy(&gl_hash_table);
 		return ret;
 	}
@@ -2490,6 +2435,7 @@ void gfs2_glock_exit(void)
 	unregister_shrinker(&glock_shrinker);
 	rhashtable_destroy(&gl_hash_table);
 	destroy_workqueue(glock_workqueue);
+	list_lru_destroy(&gfs2_glock_lru);
 }
 
 static void gfs2_glock_iter_next(struct gfs2_glock_iter *gi, loff_t n)
@@ -243,6 +243,7 @@ enum {
 	GFS2_LKS_SIRTVAR = 5,	/* Smoothed Inter-request variance */
 	GFS2_LKS_DCOUNT = 6,	/* Count of dlm requests */
 	GFS2_LKS_QCOUNT = 7,	/* Count of gfs2_holder queues */
+	GFS2_LKS_LRU = 8,	/* Count of demotes by the LRU shrinker */
 	GFS2_NR_LKSTATS
 };
 
@@ -457,23 +457,73 @@ bool iomap_is_partially_uptodate(struct folio *folio, size_t from, size_t count)
 }
 EXPORT_SYMBOL_GPL(iomap_is_partially_uptodate);
 
+/*
+ * Add a new large folio to the page cache for a write of @len bytes at @pos.
+ * The folio is naturally aligned, no larger than @len and must not cover any
+ * page already in the cache, so try smaller orders until one fits.  Returns
+ * the locked folio, or NULL to fall back to a single page.
+ */
+static struct folio *iomap_alloc_large_folio(struct iomap_iter *iter,
+		loff_t pos, size_t len)
+{
+	struct address_space *mapping = iter->inode->i_mapping;
+	gfp_t gfp = mapping_gfp_mask(mapping) & ~__GFP_FS;
+	pgoff_t index = pos >> PAGE_SHIFT;
+	struct folio *folio;
+	unsigned int order;
+
+	if (mapping_can_writeback(mapping))
+		gfp |= __GFP_WRITE;
+
+	order = min_t(unsigned int, ilog2(len) - PAGE_SHIFT,
+			MAX_PAGECACHE_ORDER);
+	if (index)
+		order = min_t(unsigned int, order, __ffs(index));
+
+	for (; order > 1; order--) {
+		folio = filemap_alloc_folio(gfp | __GFP_NORETRY | __GFP_NOWARN,
+				order);
+		if (!folio)
+			continue;
+		if (!filemap_add_folio(mapping, folio, index, gfp))
+			return folio;
+		folio_put(folio);
+	}
+	return NULL;
+}
+
 /**
  * iomap_get_folio - get a folio reference for writing
  * @iter: iteration structure
  * @pos: start offset of write
+ * @len: Suggested size of folio to create.
  *
  * Returns a locked reference to the folio at @pos, or an error pointer if the
- * folio could not be obtained.
+ * folio could not be obtained.  If there is no folio at @pos yet and the
+ * mapping supports large folios, a folio of up to @len bytes is created.
  */
-struct folio *iomap_get_folio(struct iomap_iter *iter, loff_t pos)
+struct folio *iomap_get_folio(struct iomap_iter *iter, loff_t pos, size_t len)
 {
+	struct address_space *mapping = iter->inode->i_mapping;
 	unsigned fgp = FGP_WRITEBEGIN | FGP_NOFS;
+	struct folio *folio;
 
 	if (iter->flags & IOMAP_NOWAIT)
 		fgp |= FGP_NOWAIT;
 
-	return __filemap_get_folio(iter->inode->i_mapping, pos >> PAGE_SHIFT,
-			fgp, mapping_gfp_mask(iter->inode->i_mapping));
+	if (mapping_large_folio_support(mapping) && len >= 4 * PAGE_SIZE &&
+	    !(iter->flags & IOMAP_NOWAIT)) {
+		folio = __filemap_get_folio(mapping, pos >> PAGE_SHIFT,
+				fgp & ~FGP_CREAT, mapping_gfp_mask(mapping));
+		if (!IS_ERR(folio) || PTR_ERR(folio) != -ENOENT)
+			return folio;
+		folio = iomap_alloc_large_folio(iter, pos, len);
+		if (folio)
+			return folio;
+	}
+
+	return __filemap_get_folio(mapping, pos >> PAGE_SHIFT, fgp,
+			mapping_gfp_mask(mapping));
 }
 EXPORT_SYMBOL_GPL(iomap_get_folio);
 
@@ -603,7 +653,7 @@ static struct folio *__iomap_get_folio(struct iomap_iter *iter, loff_t pos,
 	if (folio_ops && folio_ops->get_folio)
 		return folio_ops->get_folio(iter, pos, len);
 	else
-		return iomap_get_folio(iter, pos);
+		return iomap_get_folio(iter, pos, len);
 }
 
 static void __iomap_put_folio(struct iomap_iter *iter, loff_t pos, size_t ret,
@@ -770,6 +820,28 @@ static size_t iomap_write_end(struct iomap_iter *iter, loff_t pos, size_t len,
 	return ret;
 }
 
+/*
+ * Copy @bytes from @i into @folio at @offset, one page at a time so that
+ * highmem folios only need a single page mapped at once.
+ */
+static size_t iomap_copy_from_iter(struct folio *folio, size_t offset,
+		size_t bytes, struct iov_iter *i)
+{
+	size_t copied = 0;
+
+	while (copied < bytes) {
+		struct page *page = folio_page(folio, (offset + copied) >> PAGE_SHIFT);
+		size_t poff = offset_in_page(offset + copied);
+		size_t n = min_t(size_t, bytes - copied, PAGE_SIZE - poff);
+		size_t ret = copy_page_from_iter_atomic(page, poff, n, i);
+
+		copied += ret;
+		if (ret < n)
+			break;
+	}
+	return copied;
+}
+
 static loff_t iomap_write_iter(struct iomap_iter *iter, struct iov_iter *i)
 {
 	loff_t length = iomap_length(iter);
@@ -777,18 +849,17 @@ static loff_t iomap_write_iter(struct iomap_iter *iter, struct iov_iter *i)
 	ssize_t written = 0;
 	long status = 0;
 	struct address_space *mapping = iter->inode->i_mapping;
+	size_t chunk = mapping_max_folio_size(mapping);
 	unsigned int bdp_flags = (iter->flags & IOMAP_NOWAIT) ? BDP_ASYNC : 0;
 
 	do {
 		struct folio *folio;
-		struct page *page;
-		unsigned long offset;	/* Offset into pagecache page */
-		unsigned long bytes;	/* Bytes to write to page */
+		size_t offset;		/* Offset into folio */
+		size_t bytes;		/* Bytes to write to folio */
 		size_t copied;		/* Bytes copied from user */
 
-		offset = offset_in_page(pos);
-		bytes = min_t(unsigned long, PAGE_SIZE - offset,
-						iov_iter_count(i));
+		offset = pos & (chunk - 1);
+		bytes = min(chunk - offset, iov_iter_count(i));
 again:
 		status = balance_dirty_pages_ratelimited_flags(mapping,
 							       bdp_flags);
@@ -819,11 +890,14 @@ static loff_t iomap_write_iter(struct iomap_iter *iter, struct iov_iter *i)
 		if (iter->iomap.flags & IOMAP_F_STALE)
 			break;
 
-		page = folio_file_page(folio, pos >> PAGE_SHIFT);
+		offset = offset_in_folio(folio, pos);
+		if (bytes > folio_size(folio) - offset)
+			bytes = folio_size(folio) - offset;
+
 		if (mapping_writably_mapped(mapping))
-			flush_dcache_page(page);
+			flush_dcache_folio(folio);
 
-		copied = copy_page_from_iter_atomic(page, offset, bytes, i);
+		copied = iomap_copy_from_iter(folio, offset, bytes, i);
 
 		status = iomap_write_end(iter, pos, bytes, copied, folio);
 
@@ -836,10 +910,19 @@ static loff_t iomap_write_iter(struct iomap_iter *iter, struct iov_iter *i)
 			 * A short copy made iomap_write_end() reject the
 			 * thing entirely.  Might be memory poisoning
 			 * halfway through, might be a race with munmap,
-			 * might be severe memory pressure.
+			 * might be severe memory pressure.  Retry with a
+			 * smaller chunk in case a large folio caused it,
+			 * and with a single page if nothing was copied.
 			 */
-			if (copied)
+			if (copied) {
+				if (chunk > PAGE_SIZE)
+					chunk /= 2;
 				bytes = copied;
+			} else {
+				chunk = PAGE_SIZE;
+				bytes = min_t(size_t, bytes,
+					      PAGE_SIZE - offset_in_page(pos));
+			}
 			goto again;
 		}
 		pos += status;
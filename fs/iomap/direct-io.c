@@ -20,6 +20,7 @@
  * Private flags for iomap_dio, must not overlap with the public ones in
  * iomap.h:
  */
+#define IOMAP_DIO_INLINE_COMP	(1 << 27)
 #define IOMAP_DIO_WRITE_FUA	(1 << 28)
 #define IOMAP_DIO_NEED_SYNC	(1 << 29)
 #define IOMAP_DIO_WRITE		(1 << 30)
@@ -155,6 +156,23 @@ static inline void iomap_dio_set_error(struct iomap_dio *dio, int ret)
 	cmpxchg(&dio->error, 0, ret);
 }
 
+/*
+ * Writes flagged with IOMAP_DIO_INLINE_COMP are pure overwrites that need no
+ * extent conversion, size update or cache flush on completion.  When such a
+ * bio was polled, iomap_dio_bio_end_io() runs in the task context of the
+ * poller, so complete the dio right there instead of punting it to the
+ * workqueue.  Cached pages have to be invalidated, which is left to the
+ * workqueue.
+ */
+static bool iomap_dio_can_complete_inline(struct iomap_dio *dio,
+		struct bio *bio)
+{
+	struct inode *inode = file_inode(dio->iocb->ki_filp);
+
+	return (dio->flags & IOMAP_DIO_INLINE_COMP) &&
+		(bio->bi_opf & REQ_POLLED) && !inode->i_mapping->nrpages;
+}
+
 void iomap_dio_bio_end_io(struct bio *bio)
 {
 	struct iomap_dio *dio = bio->bi_private;
@@ -168,6 +186,9 @@ void iomap_dio_bio_end_io(struct bio *bio)
 			struct task_struct *waiter = dio->submit.waiter;
 			WRITE_ONCE(dio->submit.waiter, NULL);
 			blk_wake_io_task(waiter);
+		} else if (iomap_dio_can_complete_inline(dio, bio)) {
+			WRITE_ONCE(dio->iocb->private, NULL);
+			iomap_dio_complete_work(&dio->aio.work);
 		} else if (dio->flags & IOMAP_DIO_WRITE) {
 			struct inode *inode = file_inode(dio->iocb->ki_filp);
 
@@ -291,6 +312,16 @@ static loff_t iomap_dio_bio_iter(const struct iomap_iter *iter,
 	    ((dio->flags & IOMAP_DIO_WRITE) && pos >= i_size_read(inode)))
 		dio->iocb->ki_flags &= ~IOCB_HIPRI;
 
+	/*
+	 * Only pure overwrites can complete inline.  This rules out writes
+	 * that need zeroing, extent conversion or COW remapping, that extend
+	 * the file size, or that need a cache flush on completion.
+	 */
+	if (need_zeroout || (iomap->flags & IOMAP_F_SHARED) ||
+	    ((dio->flags & IOMAP_DIO_NEED_SYNC) && !use_fua) ||
+	    pos + length > i_size_read(inode))
+		dio->flags &= ~IOMAP_DIO_INLINE_COMP;
+
 	if (need_zeroout) {
 		/* zero out from the start of the block to the write offset */
 		pad = pos & (fs_block_size - 1);
@@ -535,6 +566,14 @@ __iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 		iomi.flags |= IOMAP_WRITE;
 		dio->flags |= IOMAP_DIO_WRITE;
 
+		/*
+		 * Polled writes may complete inline from the poller, see
+		 * iomap_dio_can_complete_inline().  The flag is cleared again
+		 * for any part of the write that needs more than an overwrite.
+		 */
+		if (iocb->ki_flags & IOCB_HIPRI)
+			dio->flags |= IOMAP_DIO_INLINE_COMP;
+
 		if (iocb->ki_flags & IOCB_NOWAIT) {
 			if (filemap_range_has_page(mapping, iomi.pos, end)) {
 				ret = -EAGAIN;
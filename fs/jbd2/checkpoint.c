@@ -361,6 +361,153 @@ int jbd2_log_do_checkpoint(journal_t *journal)
 	return (result < 0) ? result : 0;
 }
 
+/*
+ * Background checkpointing
+ *
+ * Once the log is filled above j_checkpoint_watermark percent, a work item
+ * writes checkpoint buffers back ahead of time, so that tasks starting a
+ * handle only checkpoint themselves in __jbd2_log_wait_for_space() when
+ * the log is really full.
+ *
+ * Writeback is batched across transactions: the dirty buffers of as many
+ * transactions as needed are submitted first, then the oldest transactions
+ * are retired with jbd2_log_do_checkpoint(), which by then mostly finds
+ * their buffers written or under I/O.
+ */
+static unsigned long jbd2_log_used(journal_t *journal)
+{
+	return journal->j_last - journal->j_first - READ_ONCE(journal->j_free);
+}
+
+static bool jbd2_log_used_above(journal_t *journal, unsigned int pct)
+{
+	return jbd2_log_used(journal) * 100 >
+		(unsigned long)pct * (journal->j_last - journal->j_first);
+}
+
+/*
+ * Queue the dirty, idle checkpoint buffers of @transaction for writeback
+ * until the batch is full.  Busy and clean buffers are left alone.
+ *
+ * Called with j_list_lock held.
+ */
+static void __queue_checkpoint_buffers(journal_t *journal,
+				       transaction_t *transaction,
+				       int *batch_count)
+{
+	struct journal_head *jh, *last, *next;
+
+	jh = transaction->t_checkpoint_list;
+	if (!jh)
+		return;
+	if (transaction->t_chp_stats.cs_chp_time == 0)
+		transaction->t_chp_stats.cs_chp_time = jiffies;
+
+	last = jh->b_cpprev;
+	for (;;) {
+		struct buffer_head *bh = jh2bh(jh);
+		bool done = (jh == last);
+
+		next = jh->b_cpnext;
+		if (!jh->b_transaction && !buffer_locked(bh) &&
+		    buffer_dirty(bh)) {
+			BUFFER_TRACE(bh, "queue");
+			get_bh(bh);
+			J_ASSERT_BH(bh, !buffer_jwrite(bh));
+			journal->j_chkpt_bhs[(*batch_count)++] = bh;
+			__buffer_relink_io(jh);
+			transaction->t_chp_stats.cs_written++;
+			if (*batch_count == JBD2_NR_BATCH)
+				return;
+		}
+		if (done)
+			return;
+		jh = next;
+	}
+}
+
+/*
+ * Submit writeback of about @nr_blocks checkpoint buffers, taken from the
+ * oldest transactions first.
+ *
+ * Called with j_checkpoint_mutex held.
+ */
+static void jbd2_log_submit_checkpoint(journal_t *journal,
+				       unsigned long nr_blocks)
+{
+	transaction_t *transaction;
+	unsigned long submitted = 0;
+	int batch_count;
+
+	while (submitted < nr_blocks) {
+		batch_count = 0;
+		spin_lock(&journal->j_list_lock);
+		transaction = journal->j_checkpoint_transactions;
+		while (transaction) {
+			__queue_checkpoint_buffers(journal, transaction,
+						   &batch_count);
+			if (batch_count == JBD2_NR_BATCH)
+				break;
+			transaction = transaction->t_cpnext;
+			if (transaction == journal->j_checkpoint_transactions)
+				break;
+		}
+		spin_unlock(&journal->j_list_lock);
+
+		if (!batch_count)
+			break;
+		submitted += batch_count;
+		__flush_batch(journal, &batch_count);
+		cond_resched();
+	}
+}
+
+void jbd2_checkpoint_work(struct work_struct *work)
+{
+	journal_t *journal = container_of(work, journal_t, j_checkpoint_work);
+	unsigned int pct;
+
+	mutex_lock_io(&journal->j_checkpoint_mutex);
+	for (;;) {
+		unsigned long used = jbd2_log_used(journal);
+
+		/* keep going until the log is down to half the watermark */
+		pct = READ_ONCE(journal->j_checkpoint_watermark);
+		if (!pct || !jbd2_log_used_above(journal, pct / 2) ||
+		    is_journal_aborted(journal) ||
+		    (journal->j_flags & JBD2_UNMOUNT) ||
+		    !READ_ONCE(journal->j_checkpoint_transactions))
+			break;
+
+		jbd2_log_submit_checkpoint(journal, used -
+			(unsigned long)pct * (journal->j_last - journal->j_first) / 200);
+		if (jbd2_log_do_checkpoint(journal) < 0)
+			break;
+		/* move the tail past what was just checkpointed */
+		if (jbd2_cleanup_journal_tail(journal) < 0)
+			break;
+		/* no progress, e.g. everything left is still being logged */
+		if (jbd2_log_used(journal) >= used)
+			break;
+	}
+	mutex_unlock(&journal->j_checkpoint_mutex);
+}
+
+/*
+ * Start background checkpointing if the log is filled above the watermark.
+ * Called after a transaction was added to the checkpoint list.
+ */
+void jbd2_log_kick_checkpoint(journal_t *journal)
+{
+	unsigned int pct = READ_ONCE(journal->j_checkpoint_watermark);
+
+	if (!pct || is_journal_aborted(journal) ||
+	    (journal->j_flags & JBD2_UNMOUNT))
+		return;
+	if (jbd2_log_used_above(journal, pct))
+		queue_work(jbd2_checkpoint_wq, &journal->j_checkpoint_work);
+}
+
 /*
  * Check the list of checkpoint transactions for the journal to see if
  * we have already got rid of any since the last update of the log tail
@@ -24,6 +24,7 @@
 #include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/bitops.h>
+#include <linux/workqueue.h>
 #include <trace/events/jbd2.h>
 
 /*
@@ -342,6 +343,87 @@ static void jbd2_block_tag_csum_set(journal_t *j, journal_block_tag_t *tag,
 	else
 		tag->t_checksum = cpu_to_be16(csum32);
 }
+
+/*
+ * With metadata_csum, checksumming the data of every logged buffer is the
+ * bulk of the CPU time spent committing a large transaction.  Batches of
+ * tags big enough to be worth it are split into chunks of at least
+ * JBD2_CSUM_MIN_CHUNK buffers which are checksummed on several CPUs.
+ * The commit thread waits for them, so they run on jbd2_csum_wq, which has
+ * a rescuer, and never on a shared workqueue that could be stuck behind
+ * work waiting for this commit.
+ */
+#define JBD2_CSUM_MIN_CHUNK	32
+#define JBD2_CSUM_MAX_WORKERS	8
+
+struct jbd2_csum_work {
+	struct work_struct work;
+	journal_t *journal;
+	journal_block_tag_t **tags;
+	struct buffer_head **bufs;
+	int nr;
+	__u32 sequence;
+};
+
+static void jbd2_block_tags_csum_chunk(journal_t *j, journal_block_tag_t **tags,
+				       struct buffer_head **bufs, int nr,
+				       __u32 sequence)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (tags[i])
+			jbd2_block_tag_csum_set(j, tags[i], bufs[i], sequence);
+}
+
+static void jbd2_csum_work_fn(struct work_struct *work)
+{
+	struct jbd2_csum_work *cw = container_of(work, struct jbd2_csum_work,
+						 work);
+
+	jbd2_block_tags_csum_chunk(cw->journal, cw->tags, cw->bufs, cw->nr,
+				   cw->sequence);
+}
+
+static void jbd2_block_tags_csum_set(journal_t *j, journal_block_tag_t **tags,
+				     struct buffer_head **bufs, int nr,
+				     __u32 sequence)
+{
+	struct jbd2_csum_work works[JBD2_CSUM_MAX_WORKERS];
+	int nr_works, per, i;
+
+	if (!jbd2_journal_has_csum_v2or3(j))
+		return;
+
+	nr_works = min_t(int, num_online_cpus(), JBD2_CSUM_MAX_WORKERS);
+	nr_works = min(nr_works, nr / JBD2_CSUM_MIN_CHUNK);
+	if (nr_works <= 1) {
+		jbd2_block_tags_csum_chunk(j, tags, bufs, nr, sequence);
+		return;
+	}
+
+	per = DIV_ROUND_UP(nr, nr_works);
+	for (i = 1; i < nr_works; i++) {
+		struct jbd2_csum_work *cw = &works[i];
+
+		cw->journal = j;
+		cw->tags = tags + i * per;
+		cw->bufs = bufs + i * per;
+		cw->nr = min(per, nr - i * per);
+		cw->sequence = sequence;
+		INIT_WORK_ONSTACK(&cw->work, jbd2_csum_work_fn);
+		queue_work(jbd2_csum_wq, &cw->work);
+	}
+
+	/* the commit thread takes the first chunk itself */
+	jbd2_block_tags_csum_chunk(j, tags, bufs, per, sequence);
+
+	for (i = 1; i < nr_works; i++) {
+		flush_work(&works[i].work);
+		destroy_work_on_stack(&works[i].work);
+	}
+}
+
 /*
  * jbd2_journal_commit_transaction
  *
@@ -355,6 +437,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	struct journal_head *jh;
 	struct buffer_head *descriptor;
 	struct buffer_head **wbuf = journal->j_wbuf;
+	journal_block_tag_t **wtags = journal->j_wbuf_tags;
 	int bufs;
 	int flags;
 	int err;
@@ -571,6 +654,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 					       stats.run.rs_logging);
 	stats.run.rs_blocks = commit_transaction->t_nr_buffers;
 	stats.run.rs_blocks_logged = 0;
+	stats.run.rs_csum_ns = 0;
 
 	J_ASSERT(commit_transaction->t_nr_buffers <=
 		 atomic_read(&commit_transaction->t_outstanding_credits));
@@ -629,6 +713,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 			first_tag = 1;
 			set_buffer_jwrite(descriptor);
 			set_buffer_dirty(descriptor);
+			wtags[bufs] = NULL;
 			wbuf[bufs++] = descriptor;
 
 			/* Record it so that we can wait for IO
@@ -685,8 +770,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		tag = (journal_block_tag_t *) tagp;
 		write_tag_block(journal, tag, jh2bh(jh)->b_blocknr);
 		tag->t_flags = cpu_to_be16(tag_flag);
-		jbd2_block_tag_csum_set(journal, tag, wbuf[bufs],
-					commit_transaction->t_tid);
+		/* checksummed for the whole batch before submission */
+		wtags[bufs] = tag;
 		tagp += tag_bytes;
 		space_left -= tag_bytes;
 		bufs++;
@@ -713,6 +798,14 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 			tag->t_flags |= cpu_to_be16(JBD2_FLAG_LAST_TAG);
 start_journal_io:
+			if (bufs) {
+				ktime_t csum_start = ktime_get();
+
+				jbd2_block_tags_csum_set(journal, wtags, wbuf,
+						bufs, commit_transaction->t_tid);
+				stats.run.rs_csum_ns += ktime_to_ns(ktime_sub(
+						ktime_get(), csum_start));
+			}
 			if (descriptor)
 				jbd2_descriptor_block_csum_set(journal,
 							descriptor);
@@ -795,6 +888,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	}
 
 	blk_finish_plug(&plug);
+	stats.run.rs_log_wait = jiffies;
+	stats.run.rs_log_submit = jbd2_time_diff(stats.run.rs_logging,
+						 stats.run.rs_log_wait);
 
 	/* Lo and behold: we have just managed to send a transaction to
            the log.  Before we can commit it, wait for the IO so far to
@@ -875,6 +971,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		jbd2_journal_abort(journal, err);
 
 	jbd2_debug(3, "JBD2: commit phase 5\n");
+	stats.run.rs_commit_record = jiffies;
+	stats.run.rs_log_wait = jbd2_time_diff(stats.run.rs_log_wait,
+					       stats.run.rs_commit_record);
 	write_lock(&journal->j_state_lock);
 	J_ASSERT(commit_transaction->t_state == T_COMMIT_DFLUSH);
 	commit_transaction->t_state = T_COMMIT_JFLUSH;
@@ -893,6 +992,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	    journal->j_flags & JBD2_BARRIER) {
 		blkdev_issue_flush(journal->j_dev);
 	}
+	stats.run.rs_commit_record = jbd2_time_diff(stats.run.rs_commit_record,
+						    jiffies);
 
 	if (err)
 		jbd2_journal_abort(journal, err);
@@ -1163,8 +1264,14 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	journal->j_stats.run.rs_locked += stats.run.rs_locked;
 	journal->j_stats.run.rs_flushing += stats.run.rs_flushing;
 	journal->j_stats.run.rs_logging += stats.run.rs_logging;
+	journal->j_stats.run.rs_log_submit += stats.run.rs_log_submit;
+	journal->j_stats.run.rs_log_wait += stats.run.rs_log_wait;
+	journal->j_stats.run.rs_commit_record += stats.run.rs_commit_record;
+	journal->j_stats.run.rs_csum_ns += stats.run.rs_csum_ns;
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
 	spin_unlock(&journal->j_history_lock);
+
+	jbd2_log_kick_checkpoint(journal);
 }
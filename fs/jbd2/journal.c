@@ -97,6 +97,11 @@ EXPORT_SYMBOL(jbd2_inode_cache);
 
 static int jbd2_journal_create_slab(size_t slab_size);
 
+/* Runs background checkpointing, see jbd2_log_kick_checkpoint() */
+struct workqueue_struct *jbd2_checkpoint_wq;
+/* Computes block tag checksums for the commit thread */
+struct workqueue_struct *jbd2_csum_wq;
+
 #ifdef CONFIG_JBD2_DEBUG
 void __jbd2_debug(int level, const char *file, const char *func,
 		  unsigned int line, const char *fmt, ...)
@@ -1193,6 +1198,16 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    jiffies_to_msecs(s->stats->run.rs_flushing / s->stats->ts_tid));
 	seq_printf(seq, "  %ums logging transaction\n",
 	    jiffies_to_msecs(s->stats->run.rs_logging / s->stats->ts_tid));
+	seq_printf(seq, "    %ums writing log blocks\n",
+	    jiffies_to_msecs(s->stats->run.rs_log_submit / s->stats->ts_tid));
+	seq_printf(seq, "    %ums waiting for log blocks\n",
+	    jiffies_to_msecs(s->stats->run.rs_log_wait / s->stats->ts_tid));
+	seq_printf(seq, "    %ums writing commit block\n",
+	    jiffies_to_msecs(s->stats->run.rs_commit_record /
+			     s->stats->ts_tid));
+	seq_printf(seq, "    %lluus checksumming log blocks\n",
+	    div64_u64(s->stats->run.rs_csum_ns,
+		      (u64)s->stats->ts_tid * NSEC_PER_USEC));
 	seq_printf(seq, "  %lluus average transaction commit time\n",
 		   div_u64(s->journal->j_average_commit_time, 1000));
 	seq_printf(seq, "  %lu handles per transaction\n",
@@ -1263,6 +1278,46 @@ static const struct proc_ops jbd2_info_proc_ops = {
 	.proc_release	= jbd2_seq_info_release,
 };
 
+static int jbd2_seq_checkpoint_watermark_show(struct seq_file *seq, void *v)
+{
+	journal_t *journal = seq->private;
+
+	seq_printf(seq, "%u\n", READ_ONCE(journal->j_checkpoint_watermark));
+	return 0;
+}
+
+static int jbd2_seq_checkpoint_watermark_open(struct inode *inode,
+					      struct file *file)
+{
+	return single_open(file, jbd2_seq_checkpoint_watermark_show,
+			   pde_data(inode));
+}
+
+static ssize_t jbd2_seq_checkpoint_watermark_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	journal_t *journal = pde_data(file_inode(file));
+	unsigned int val;
+	int err;
+
+	err = kstrtouint_from_user(buf, count, 0, &val);
+	if (err)
+		return err;
+	if (val > 100)
+		return -EINVAL;
+	WRITE_ONCE(journal->j_checkpoint_watermark, val);
+	jbd2_log_kick_checkpoint(journal);
+	return count;
+}
+
+static const struct proc_ops jbd2_checkpoint_watermark_proc_ops = {
+	.proc_open	= jbd2_seq_checkpoint_watermark_open,
+	.proc_read	= seq_read,
+	.proc_write	= jbd2_seq_checkpoint_watermark_write,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+
 static struct proc_dir_entry *proc_jbd2_stats;
 
 static void jbd2_stats_proc_init(journal_t *journal)
@@ -1271,11 +1326,15 @@ static void jbd2_stats_proc_init(journal_t *journal)
 	if (journal->j_proc_entry) {
 		proc_create_data("info", S_IRUGO, journal->j_proc_entry,
 				 &jbd2_info_proc_ops, journal);
+		proc_create_data("checkpoint_watermark", S_IRUGO | S_IWUSR,
+				 journal->j_proc_entry,
+				 &jbd2_checkpoint_watermark_proc_ops, journal);
 	}
 }
 
 static void jbd2_stats_proc_exit(journal_t *journal)
 {
+	remove_proc_entry("checkpoint_watermark", journal->j_proc_entry);
 	remove_proc_entry("info", journal->j_proc_entry);
 	remove_proc_entry(journal->j_devname, proc_jbd2_stats);
 }
@@ -1368,6 +1427,8 @@ static journal_t *journal_init_common(struct block_device *bdev,
 	mutex_init(&journal->j_abort_mutex);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	INIT_WORK(&journal->j_checkpoint_work, jbd2_checkpoint_work);
+	journal->j_checkpoint_watermark = JBD2_DEFAULT_CHECKPOINT_WATERMARK;
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1404,6 +1465,10 @@ static journal_t *journal_init_common(struct block_device *bdev,
 					GFP_KERNEL);
 	if (!journal->j_wbuf)
 		goto err_cleanup;
+	journal->j_wbuf_tags = kmalloc_array(n, sizeof(journal_block_tag_t *),
+					     GFP_KERNEL);
+	if (!journal->j_wbuf_tags)
+		goto err_cleanup;
 
 	bh = getblk_unmovable(journal->j_dev, start, journal->j_blocksize);
 	if (!bh) {
@@ -1433,6 +1498,7 @@ static journal_t *journal_init_common(struct block_device *bdev,
 err_cleanup:
 	brelse(journal->j_sb_buffer);
 	kfree(journal->j_wbuf);
+	kfree(journal->j_wbuf_tags);
 	jbd2_journal_destroy_revoke(journal);
 	kfree(journal);
 	return NULL;
@@ -2133,6 +2199,12 @@ int jbd2_journal_destroy(journal_t *journal)
 	if (journal->j_running_transaction)
 		jbd2_journal_commit_transaction(journal);
 
+	/*
+	 * JBD2_UNMOUNT stops background checkpointing at its next check,
+	 * and the final commit above completes anything it may wait on.
+	 */
+	cancel_work_sync(&journal->j_checkpoint_work);
+
 	/* Force any old transactions to disk */
 
 	/* Totally anal locking here... */
@@ -2199,6 +2271,7 @@ int jbd2_journal_destroy(journal_t *journal)
 		crypto_free_shash(journal->j_chksum_driver);
 	kfree(journal->j_fc_wbuf);
 	kfree(journal->j_wbuf);
+	kfree(journal->j_wbuf_tags);
 	kfree(journal);
 
 	return err;
@@ -3177,6 +3250,20 @@ static int __init journal_init(void)
 	BUILD_BUG_ON(sizeof(struct journal_superblock_s) != 1024);
 
 	ret = journal_init_caches();
+	if (ret == 0) {
+		jbd2_checkpoint_wq = alloc_workqueue("jbd2-checkpoint",
+					WQ_MEM_RECLAIM | WQ_UNBOUND, 0);
+		if (!jbd2_checkpoint_wq)
+			ret = -ENOMEM;
+	}
+	if (ret == 0) {
+		jbd2_csum_wq = alloc_workqueue("jbd2-csum",
+					WQ_MEM_RECLAIM | WQ_UNBOUND, 0);
+		if (!jbd2_csum_wq) {
+			destroy_workqueue(jbd2_checkpoint_wq);
+			ret = -ENOMEM;
+		}
+	}
 	if (ret == 0) {
 		jbd2_create_jbd_stats_proc_entry();
 	} else {
@@ -3193,6 +3280,8 @@ static void __exit journal_exit(void)
 		printk(KERN_ERR "JBD2: leaked %d journal_heads!\n", n);
 #endif
 	jbd2_remove_jbd_stats_proc_entry();
+	destroy_workqueue(jbd2_csum_wq);
+	destroy_workqueue(jbd2_checkpoint_wq);
 	jbd2_journal_destroy_caches();
 }
 
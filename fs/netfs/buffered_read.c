@@ -9,6 +9,8 @@
 #include <linux/task_io_accounting_ops.h>
 #include "internal.h"
 
+#define NETFS_RA_MAX_WINDOW	(16 * 1024 * 1024) /* Largest readahead window */
+
 /*
  * Unlock the folios in a read operation.  We need to set PG_fscache on any
  * folios we're going to write back before we unlock them.
@@ -109,9 +111,36 @@ static void netfs_cache_expand_readahead(struct netfs_io_request *rreq,
 		cres->ops->expand_readahead(cres, _start, _len, i_size);
 }
 
+/*
+ * Grow a readahead request to twice the bandwidth-delay product of the link
+ * to the server, as estimated from earlier downloads, so that the netfs can
+ * keep enough subrequests in flight to cover the round trip time.  Each
+ * window that completes faster feeds a higher rate back in, so the window
+ * ramps up until the link is saturated.
+ */
+static void netfs_rreq_expand_to_bdp(struct netfs_io_request *rreq)
+{
+	struct netfs_inode *ctx = netfs_inode(rreq->inode);
+	unsigned int rate = READ_ONCE(ctx->stats.download_rate);
+	unsigned int lat = READ_ONCE(ctx->stats.download_lat);
+	u64 want;
+
+	if (rreq->origin != NETFS_READAHEAD || !rate || !lat ||
+	    rreq->start >= rreq->i_size)
+		return;
+
+	want = div_u64(2ULL * rate * 1024 * lat, USEC_PER_SEC);
+	want = min_t(u64, want, NETFS_RA_MAX_WINDOW);
+	want = min_t(u64, want, rreq->i_size - rreq->start);
+	if (want > rreq->len)
+		rreq->len = round_up(want, PAGE_SIZE);
+}
+
 static void netfs_rreq_expand(struct netfs_io_request *rreq,
 			      struct readahead_control *ractl)
 {
+	netfs_rreq_expand_to_bdp(rreq);
+
 	/* Give the cache a chance to change the request parameters.  The
 	 * resultant request must contain the original region.
 	 */
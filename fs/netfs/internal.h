@@ -61,6 +61,7 @@ extern atomic_t netfs_n_rh_download;
 extern atomic_t netfs_n_rh_download_done;
 extern atomic_t netfs_n_rh_download_failed;
 extern atomic_t netfs_n_rh_download_instead;
+extern atomic_t netfs_n_rh_coalesced;
 extern atomic_t netfs_n_rh_read;
 extern atomic_t netfs_n_rh_read_done;
 extern atomic_t netfs_n_rh_read_failed;
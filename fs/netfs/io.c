@@ -16,6 +16,8 @@
 #include <linux/task_io_accounting_ops.h>
 #include "internal.h"
 
+#define NETFS_COALESCE_MAX_HIT	(64 * 1024)	/* Largest cache hit to download */
+
 /*
  * Clear the unread part of an I/O request.
  */
@@ -49,6 +51,7 @@ static void netfs_read_from_cache(struct netfs_io_request *rreq,
 	struct iov_iter iter;
 
 	netfs_stat(&netfs_n_rh_read);
+	atomic_inc(&netfs_inode(rreq->inode)->stats.cache_reads);
 	iov_iter_xarray(&iter, ITER_DEST, &rreq->mapping->i_pages,
 			subreq->start + subreq->transferred,
 			subreq->len   - subreq->transferred);
@@ -88,6 +91,8 @@ static void netfs_read_from_server(struct netfs_io_request *rreq,
 				   struct netfs_io_subrequest *subreq)
 {
 	netfs_stat(&netfs_n_rh_download);
+	atomic_inc(&netfs_inode(rreq->inode)->stats.downloads);
+	subreq->issue_time = ktime_get();
 	rreq->netfs_ops->issue_read(subreq);
 }
 
@@ -239,6 +244,46 @@ static void netfs_rreq_write_to_cache(struct netfs_io_request *rreq)
 		BUG();
 }
 
+/*
+ * Note the latency of a download.  The minimum is kept as an estimate of the
+ * round trip time to the server, but it is allowed to creep up slowly so that
+ * it follows the server if the path to it gets slower.
+ */
+static void netfs_note_download_latency(struct netfs_inode *ctx,
+					struct netfs_io_subrequest *subreq)
+{
+	s64 us = ktime_us_delta(ktime_get(), subreq->issue_time);
+	unsigned int lat = READ_ONCE(ctx->stats.download_lat);
+
+	us = clamp_t(s64, us, 1, UINT_MAX);
+	if (!lat || us < lat + lat / 8)
+		WRITE_ONCE(ctx->stats.download_lat, us);
+	else
+		WRITE_ONCE(ctx->stats.download_lat, lat + lat / 8);
+}
+
+/*
+ * Fold the download rate achieved by a completed readahead request into the
+ * inode's estimate.
+ */
+static void netfs_note_download_rate(struct netfs_io_request *rreq)
+{
+	struct netfs_inode *ctx = netfs_inode(rreq->inode);
+	u64 bytes = atomic64_read(&rreq->downloaded);
+	s64 us = ktime_us_delta(ktime_get(), rreq->issue_time);
+	unsigned int rate = READ_ONCE(ctx->stats.download_rate);
+	u64 sample;
+
+	if (rreq->origin != NETFS_READAHEAD || !bytes || us <= 0)
+		return;
+
+	sample = div64_u64(bytes * USEC_PER_SEC / 1024, us);
+	sample = clamp_t(u64, sample, 1, UINT_MAX);
+	if (rate)
+		sample = (sample + 3 * (u64)rate) / 4;
+	WRITE_ONCE(ctx->stats.download_rate, sample);
+}
+
 /*
  * Handle a short read.
  */
@@ -341,6 +386,7 @@ static void netfs_rreq_assess(struct netfs_io_request *rreq, bool was_async)
 	}
 
 	netfs_rreq_unlock_folios(rreq);
+	netfs_note_download_rate(rreq);
 
 	clear_bit_unlock(NETFS_RREQ_IN_PROGRESS, &rreq->flags);
 	wake_up_bit(&rreq->flags, NETFS_RREQ_IN_PROGRESS);
@@ -429,6 +475,19 @@ void netfs_subreq_terminated(struct netfs_io_subrequest *subreq,
 
 	subreq->error = 0;
 	subreq->transferred += transferred_or_error;
+
+	if (subreq->source == NETFS_DOWNLOAD_FROM_SERVER) {
+		struct netfs_inode *ctx = netfs_inode(rreq->inode);
+
+		atomic64_add(transferred_or_error, &ctx->stats.download_bytes);
+		atomic64_add(transferred_or_error, &rreq->downloaded);
+		if (transferred_or_error)
+			netfs_note_download_latency(ctx, subreq);
+	} else if (subreq->source == NETFS_READ_FROM_CACHE) {
+		atomic64_add(transferred_or_error,
+			     &netfs_inode(rreq->inode)->stats.cache_bytes);
+	}
+
 	if (subreq->transferred < subreq->len)
 		goto incomplete;
 
@@ -496,6 +555,56 @@ static enum netfs_io_source netfs_cache_prepare_read(struct netfs_io_subrequest
 	return NETFS_DOWNLOAD_FROM_SERVER;
 }
 
+/*
+ * A download that the cache cut short may be followed by just a small run of
+ * cached data and then more data that has to be downloaded.  Rather than
+ * issuing a small cache read between two downloads, fold short runs of cached
+ * data and the misses that follow them into the download.  The netfs still
+ * gets to clamp the result to its own I/O sizes.
+ */
+static void netfs_coalesce_download(struct netfs_io_request *rreq,
+				    struct netfs_io_subrequest *subreq)
+{
+	struct netfs_cache_resources *cres = &rreq->cache_resources;
+	struct netfs_io_subrequest probe = { .rreq = rreq };
+	enum netfs_io_source source;
+	size_t hit = 0;
+	loff_t end;
+
+	if (!cres->ops)
+		return;
+
+	end = min_t(loff_t, rreq->start + rreq->len, rreq->i_size);
+	while (subreq->start + subreq->len < end) {
+		probe.start = subreq->start + subreq->len;
+		probe.len = end - probe.start;
+		probe.flags = 0;
+
+		source = cres->ops->prepare_read(&probe, rreq->i_size);
+		if (source == NETFS_READ_FROM_CACHE) {
+			/* Don't absorb a trailing hit; only a hit with a miss
+			 * after it saves an operation.
+			 */
+			if (hit || probe.len > NETFS_COALESCE_MAX_HIT ||
+			    probe.start + probe.len >= end)
+				break;
+			hit = probe.len;
+		} else if (source == NETFS_DOWNLOAD_FROM_SERVER) {
+			if (hit) {
+				netfs_stat(&netfs_n_rh_coalesced);
+				atomic_inc(&netfs_inode(rreq->inode)->stats.coalesced);
+			}
+			hit = 0;
+		} else {
+			break;
+		}
+		subreq->len += probe.len;
+	}
+
+	/* Give back a hit that wasn't followed by a miss. */
+	subreq->len -= hit;
+}
+
 /*
  * Work out what sort of subrequest the next one will be.
  */
@@ -512,6 +621,8 @@ netfs_rreq_prepare_read(struct netfs_io_request *rreq,
 		goto out;
 
 	if (source == NETFS_DOWNLOAD_FROM_SERVER) {
+		netfs_coalesce_download(rreq, subreq);
+
 		/* Call out to the netfs to let it shrink the request to fit
 		 * its own I/O sizes and boundaries.  If it shinks it here, it
 		 * will be called again to make simultaneous calls; if it wants
@@ -616,6 +727,7 @@ int netfs_begin_read(struct netfs_io_request *rreq, bool sync)
 	}
 
 	INIT_WORK(&rreq->work, netfs_rreq_work);
+	rreq->issue_time = ktime_get();
 
 	if (sync)
 		netfs_get_request(rreq, netfs_rreq_trace_get_hold);
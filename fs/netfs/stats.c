@@ -17,6 +17,7 @@ atomic_t netfs_n_rh_download;
 atomic_t netfs_n_rh_download_done;
 atomic_t netfs_n_rh_download_failed;
 atomic_t netfs_n_rh_download_instead;
+atomic_t netfs_n_rh_coalesced;
 atomic_t netfs_n_rh_read;
 atomic_t netfs_n_rh_read_done;
 atomic_t netfs_n_rh_read_failed;
@@ -41,11 +42,12 @@ void netfs_stats_show(struct seq_file *m)
 		   atomic_read(&netfs_n_rh_zero),
 		   atomic_read(&netfs_n_rh_short_read),
 		   atomic_read(&netfs_n_rh_write_zskip));
-	seq_printf(m, "RdHelp : DL=%u ds=%u df=%u di=%u\n",
+	seq_printf(m, "RdHelp : DL=%u ds=%u df=%u di=%u dc=%u\n",
 		   atomic_read(&netfs_n_rh_download),
 		   atomic_read(&netfs_n_rh_download_done),
 		   atomic_read(&netfs_n_rh_download_failed),
-		   atomic_read(&netfs_n_rh_download_instead));
+		   atomic_read(&netfs_n_rh_download_instead),
+		   atomic_read(&netfs_n_rh_coalesced));
 	seq_printf(m, "RdHelp : RD=%u rs=%u rf=%u\n",
 		   atomic_read(&netfs_n_rh_read),
 		   atomic_read(&netfs_n_rh_read_done),
@@ -56,3 +58,27 @@ void netfs_stats_show(struct seq_file *m)
 		   atomic_read(&netfs_n_rh_write_failed));
 }
 EXPORT_SYMBOL(netfs_stats_show);
+
+/**
+ * netfs_inode_stats_show - Display the read statistics of an inode
+ * @m: The seq_file to write to
+ * @ctx: The netfs inode to report on
+ *
+ * Display the per-inode read counters together with the download rate and
+ * latency estimates that are used to size readahead for the inode.
+ */
+void netfs_inode_stats_show(struct seq_file *m, struct netfs_inode *ctx)
+{
+	struct netfs_inode_stats *st = &ctx->stats;
+
+	seq_printf(m, "RdHelp : DL=%u db=%llu RD=%u rb=%llu dc=%u\n",
+		   atomic_read(&st->downloads),
+		   atomic64_read(&st->download_bytes),
+		   atomic_read(&st->cache_reads),
+		   atomic64_read(&st->cache_bytes),
+		   atomic_read(&st->coalesced));
+	seq_printf(m, "RdHelp : rate=%uKiB/s lat=%uus\n",
+		   READ_ONCE(st->download_rate),
+		   READ_ONCE(st->download_lat));
+}
+EXPORT_SYMBOL(netfs_inode_stats_show);
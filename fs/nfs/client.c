@@ -716,6 +716,7 @@ static int nfs_init_server(struct nfs_server *server,
 	server->acregmax = ctx->acregmax * HZ;
 	server->acdirmin = ctx->acdirmin * HZ;
 	server->acdirmax = ctx->acdirmax * HZ;
+	server->wcoalesce = msecs_to_jiffies(ctx->wcoalesce);
 
 	/* Start lockd here, before we might error out */
 	error = nfs_start_lockd(server);
@@ -904,6 +905,7 @@ void nfs_server_copy_userdata(struct nfs_server *target, struct nfs_server *sour
 	target->acregmax = source->acregmax;
 	target->acdirmin = source->acdirmin;
 	target->acdirmax = source->acdirmax;
+	target->wcoalesce = source->wcoalesce;
 	target->caps = source->caps;
 	target->options = source->options;
 	target->auth_info = source->auth_info;
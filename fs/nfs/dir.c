@@ -56,6 +56,7 @@ static int nfs_readdir(struct file *, struct dir_context *);
 static int nfs_fsync_dir(struct file *, loff_t, loff_t, int);
 static loff_t nfs_llseek_dir(struct file *, loff_t, int);
 static void nfs_readdir_clear_array(struct folio *);
+static void nfs_readdir_prefetch_work(struct work_struct *);
 
 const struct file_operations nfs_dir_operations = {
 	.llseek		= nfs_llseek_dir,
@@ -82,6 +83,7 @@ alloc_nfs_open_dir_context(struct inode *dir)
 	if (ctx != NULL) {
 		ctx->attr_gencount = nfsi->attr_gencount;
 		ctx->dtsize = NFS_INIT_DTSIZE;
+		INIT_WORK(&ctx->prefetch_work, nfs_readdir_prefetch_work);
 		spin_lock(&dir->i_lock);
 		if (list_empty(&nfsi->open_files) &&
 		    (nfsi->cache_validity & NFS_INO_DATA_INVAL_DEFER))
@@ -419,6 +421,17 @@ static u64 nfs_readdir_folio_last_cookie(struct folio *folio)
 	return ret;
 }
 
+static bool nfs_readdir_folio_is_eof(struct folio *folio)
+{
+	struct nfs_cache_array *array;
+	bool ret;
+
+	array = kmap_local_folio(folio, 0);
+	ret = array->folio_is_eof;
+	kunmap_local(array);
+	return ret;
+}
+
 static bool nfs_readdir_folio_needs_filling(struct folio *folio)
 {
 	struct nfs_cache_array *array;
@@ -576,6 +589,22 @@ static int nfs_readdir_search_array(struct nfs_readdir_descriptor *desc)
 	return status;
 }
 
+/*
+ * Keep a moving average of how long a READDIR round trip takes on this
+ * open directory.  It decides how far ahead nfs_readdir_prefetch() reads.
+ */
+static void nfs_readdir_record_rtt(struct file *file, s64 us)
+{
+	struct nfs_open_dir_context *dir_ctx = file->private_data;
+	unsigned int rtt = READ_ONCE(dir_ctx->rtt_us);
+
+	if (us < 0)
+		return;
+	if (rtt)
+		us = (7 * (s64)rtt + us) >> 3;
+	WRITE_ONCE(dir_ctx->rtt_us, min_t(s64, us, UINT_MAX));
+}
+
 /* Fill a page with xdr information before transferring to the cache page */
 static int nfs_readdir_xdr_filler(struct nfs_readdir_descriptor *desc,
 				  __be32 *verf, u64 cookie,
@@ -596,13 +625,16 @@ static int nfs_readdir_xdr_filler(struct nfs_readdir_descriptor *desc,
 		.verf = verf_res,
 	};
 	unsigned long	timestamp, gencount;
+	ktime_t		start;
 	int		error;
 
  again:
 	timestamp = jiffies;
 	gencount = nfs_inc_attr_generation_counter();
 	desc->dir_verifier = nfs_save_change_attribute(inode);
+	start = ktime_get();
 	error = NFS_PROTO(inode)->readdir(&arg, &res);
+	nfs_readdir_record_rtt(desc->file, ktime_us_delta(ktime_get(), start));
 	if (error < 0) {
 		/* We requested READDIRPLUS, but the server doesn't grok it */
 		if (error == -ENOTSUPP && desc->plus) {
@@ -1072,6 +1104,105 @@ static int readdir_search_pagecache(struct nfs_readdir_descriptor *desc)
 	return res;
 }
 
+/*
+ * Readdir prefetch: once getdents() has filled the user's buffer, read the
+ * directory ahead of it into the page cache from a workqueue, so that the
+ * next getdents() finds its entries already cached.  Every round trip of
+ * NFS_READDIR_PREFETCH_RTT_US allows one more buffer to be read ahead, up
+ * to nfs_readdir_max_prefetch.  The cache pages live in the directory's
+ * mapping, so all readers of the directory share what was read ahead.
+ */
+#define NFS_DIR_CTX_PREFETCH		(0)
+#define NFS_READDIR_PREFETCH_RTT_US	(1000U)
+#define NFS_READDIR_PREFETCH_MAX_FOLIOS	(256U)
+
+static unsigned int nfs_readdir_max_prefetch = 8;
+module_param(nfs_readdir_max_prefetch, uint, 0644);
+MODULE_PARM_DESC(nfs_readdir_max_prefetch,
+		 "Max number of READDIR replies to read ahead of getdents (0 disables)");
+
+static unsigned int nfs_readdir_prefetch_depth(struct nfs_open_dir_context *dir_ctx)
+{
+	unsigned int depth;
+
+	depth = 1 + READ_ONCE(dir_ctx->rtt_us) / NFS_READDIR_PREFETCH_RTT_US;
+	return min(depth, READ_ONCE(nfs_readdir_max_prefetch));
+}
+
+static void nfs_readdir_prefetch_work(struct work_struct *work)
+{
+	struct nfs_open_dir_context *dir_ctx =
+		container_of(work, struct nfs_open_dir_context, prefetch_work);
+	struct file *file = dir_ctx->prefetch_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = file_inode(file);
+	struct nfs_readdir_descriptor *desc;
+	__be32 verf[NFS_DIR_VERIFIER_SIZE];
+	u64 next, cookie = dir_ctx->prefetch_cookie;
+	unsigned int i, fills = 0, depth;
+	struct folio *folio;
+
+	desc = kzalloc(sizeof(*desc), GFP_KERNEL);
+	if (!desc)
+		goto out;
+	desc->file = file;
+	desc->plus = dir_ctx->prefetch_plus;
+	desc->folio_index_max = -1;
+	nfs_set_dtsize(desc, dir_ctx->prefetch_dtsize);
+	depth = nfs_readdir_prefetch_depth(dir_ctx);
+
+	for (i = 0; i < NFS_READDIR_PREFETCH_MAX_FOLIOS && fills < depth; i++) {
+		/* Never wait for a folio that a reader is filling */
+		folio = __filemap_get_folio(mapping,
+				nfs_readdir_folio_cookie_hash(cookie),
+				FGP_LOCK | FGP_CREAT | FGP_NOWAIT,
+				mapping_gfp_mask(mapping));
+		if (IS_ERR(folio))
+			break;
+		nfs_readdir_folio_init_and_validate(folio, cookie,
+				inode_peek_iversion_raw(inode));
+		if (nfs_readdir_folio_needs_filling(folio)) {
+			/* Filling cookie 0 resets the verifier: leave it to readers */
+			if (!cookie ||
+			    nfs_readdir_xdr_to_array(desc,
+						     NFS_I(inode)->cookieverf,
+						     verf, &folio, 1) < 0 ||
+			    nfs_readdir_folio_needs_filling(folio)) {
+				nfs_readdir_folio_unlock_and_put(folio);
+				break;
+			}
+			fills++;
+		}
+		next = nfs_readdir_folio_last_cookie(folio);
+		if (nfs_readdir_folio_is_eof(folio) || next == cookie) {
+			nfs_readdir_folio_unlock_and_put(folio);
+			break;
+		}
+		nfs_readdir_folio_unlock_and_put(folio);
+		cookie = next;
+	}
+	kfree(desc);
+out:
+	/* The open directory context goes away with the last file reference */
+	clear_bit_unlock(NFS_DIR_CTX_PREFETCH, &dir_ctx->flags);
+	fput(file);
+}
+
+static void nfs_readdir_prefetch(struct nfs_readdir_descriptor *desc)
+{
+	struct nfs_open_dir_context *dir_ctx = desc->file->private_data;
+
+	if (desc->eof || !nfs_readdir_max_prefetch)
+		return;
+	if (test_and_set_bit_lock(NFS_DIR_CTX_PREFETCH, &dir_ctx->flags))
+		return;
+	dir_ctx->prefetch_file = get_file(desc->file);
+	dir_ctx->prefetch_cookie = desc->last_cookie;
+	dir_ctx->prefetch_dtsize = desc->dtsize;
+	dir_ctx->prefetch_plus = desc->plus;
+	queue_work(nfsiod_workqueue, &dir_ctx->prefetch_work);
+}
+
 #define NFS_READDIR_CACHE_MISS_THRESHOLD (16UL)
 
 /*
@@ -1294,6 +1425,9 @@ static int nfs_readdir(struct file *file, struct dir_context *ctx)
 			desc->clear_cache = force_clear;
 	} while (!desc->eob && !desc->eof);
 
+	if (desc->eob && res == 0)
+		nfs_readdir_prefetch(desc);
+
 	spin_lock(&file->f_lock);
 	dir_ctx->dir_cookie = desc->dir_cookie;
 	dir_ctx->last_cookie = desc->last_cookie;
@@ -678,11 +678,21 @@ nfs4_ff_layout_stat_io_end_read(struct rpc_task *task,
 		__u64 requested,
 		__u64 completed)
 {
+	ktime_t now = ktime_get();
+
 	spin_lock(&mirror->lock);
 	nfs4_ff_layout_stat_io_update_completed(&mirror->read_stat,
 			requested, completed,
-			ktime_get(), task->tk_start);
+			now, task->tk_start);
 	set_bit(NFS4_FF_MIRROR_STAT_AVAIL, &mirror->flags);
+	if (task->tk_status >= 0) {
+		u32 lat = min_t(s64, ktime_us_delta(now, task->tk_start),
+				U32_MAX >> 3);
+
+		if (mirror->read_latency_us)
+			lat = (7 * mirror->read_latency_us + lat) >> 3;
+		WRITE_ONCE(mirror->read_latency_us, lat);
+	}
 	spin_unlock(&mirror->lock);
 }
 
@@ -792,6 +802,46 @@ ff_layout_choose_best_ds_for_read(struct pnfs_layout_segment *lseg,
 	return ff_layout_choose_any_ds_for_read(lseg, start_idx, best_idx);
 }
 
+/*
+ * Pick the usable mirror with the lowest expected wait: its average read
+ * latency scaled by the number of reads already queued to it.  A mirror
+ * we have no latency sample for yet counts as fast, so it gets probed.
+ * As each read adds to its mirror's queue before the next one is steered,
+ * consecutive reads of a large request spread over the mirrors.
+ */
+static struct nfs4_pnfs_ds *
+ff_layout_choose_fastest_ds_for_read(struct pnfs_layout_segment *lseg,
+				     u32 *best_idx)
+{
+	struct nfs4_ff_layout_segment *fls = FF_LAYOUT_LSEG(lseg);
+	struct nfs4_ff_layout_mirror *mirror;
+	struct nfs4_pnfs_ds *ds, *best = NULL;
+	u64 cost, best_cost = U64_MAX;
+	u32 idx;
+
+	if (fls->mirror_array_cnt < 2)
+		return NULL;
+
+	for (idx = 0; idx < fls->mirror_array_cnt; idx++) {
+		mirror = FF_LAYOUT_COMP(lseg, idx);
+		ds = nfs4_ff_layout_prepare_ds(lseg, mirror, false);
+		if (!ds)
+			continue;
+		if (nfs4_test_deviceid_unavailable(&mirror->mirror_ds->id_node))
+			continue;
+
+		cost = (u64)(READ_ONCE(mirror->read_latency_us) + 1) *
+		       (atomic_read(&mirror->read_inflight) + 1);
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = ds;
+			*best_idx = idx;
+		}
+	}
+
+	return best;
+}
+
 static struct nfs4_pnfs_ds *
 ff_layout_get_ds_for_read(struct nfs_pageio_descriptor *pgio,
 			  u32 *best_idx)
@@ -799,6 +849,13 @@ ff_layout_get_ds_for_read(struct nfs_pageio_descriptor *pgio,
 	struct pnfs_layout_segment *lseg = pgio->pg_lseg;
 	struct nfs4_pnfs_ds *ds;
 
+	/* A resend must move on from the mirror that failed it */
+	if (!pgio->pg_mirror_pinned) {
+		ds = ff_layout_choose_fastest_ds_for_read(lseg, best_idx);
+		if (ds)
+			return ds;
+	}
+
 	ds = ff_layout_choose_best_ds_for_read(lseg, pgio->pg_mirror_idx,
 					       best_idx);
 	if (ds || !pgio->pg_mirror_idx)
@@ -1443,6 +1500,7 @@ static void ff_layout_read_release(void *data)
 {
 	struct nfs_pgio_header *hdr = data;
 
+	atomic_dec(&FF_LAYOUT_COMP(hdr->lseg, hdr->pgio_mirror_idx)->read_inflight);
 	ff_layout_read_record_layoutstats_done(&hdr->task, hdr);
 	if (test_bit(NFS_IOHDR_RESEND_PNFS, &hdr->flags))
 		ff_layout_resend_pnfs_read(hdr);
@@ -1809,6 +1867,9 @@ ff_layout_read_pagelist(struct nfs_pgio_header *hdr)
 	hdr->args.offset = offset;
 	hdr->mds_offset = offset;
 
+	/* Dropped in ff_layout_read_release() */
+	atomic_inc(&mirror->read_inflight);
+
 	/* Perform an asynchronous read to ds */
 	nfs_initiate_pgio(ds_clnt, hdr, ds_cred, ds->ds_clp->rpc_ops,
 			  vers == 3 ? &ff_layout_read_call_ops_v3 :
@@ -90,6 +90,8 @@ struct nfs4_ff_layout_mirror {
 	struct nfs4_ff_layoutstat	write_stat;
 	ktime_t				start_time;
 	u32				report_interval;
+	atomic_t			read_inflight;
+	u32				read_latency_us; /* moving average */
 };
 
 #define NFS4_FF_MIRROR_STAT_AVAIL	(0)
@@ -86,6 +86,7 @@ enum nfs_param {
 	Opt_udp,
 	Opt_v,
 	Opt_vers,
+	Opt_wcoalesce,
 	Opt_wsize,
 	Opt_write,
 };
@@ -192,6 +193,7 @@ static const struct fs_parameter_spec nfs_fs_parameters[] = {
 	fsparam_flag  ("v4.1",		Opt_v),
 	fsparam_flag  ("v4.2",		Opt_v),
 	fsparam_string("vers",		Opt_vers),
+	fsparam_u32   ("wcoalesce",	Opt_wcoalesce),
 	fsparam_enum  ("write",		Opt_write, nfs_param_enums_write),
 	fsparam_u32   ("wsize",		Opt_wsize),
 	{}
@@ -624,6 +626,9 @@ static int nfs_fs_context_parse_param(struct fs_context *fc,
 	case Opt_wsize:
 		ctx->wsize = result.uint_32;
 		break;
+	case Opt_wcoalesce:
+		ctx->wcoalesce = result.uint_32;
+		break;
 	case Opt_bsize:
 		ctx->bsize = result.uint_32;
 		break;
@@ -1540,6 +1545,7 @@ static int nfs_init_fs_context(struct fs_context *fc)
 		ctx->acregmax		= nfss->acregmax / HZ;
 		ctx->acdirmin		= nfss->acdirmin / HZ;
 		ctx->acdirmax		= nfss->acdirmax / HZ;
+		ctx->wcoalesce		= jiffies_to_msecs(nfss->wcoalesce);
 		ctx->timeo		= 10U * nfss->client->cl_timeout->to_initval / HZ;
 		ctx->nfs_server.port	= nfss->port;
 		ctx->nfs_server.addrlen	= nfss->nfs_client->cl_addrlen;
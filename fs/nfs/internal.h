@@ -96,6 +96,7 @@ struct nfs_fs_context {
 	unsigned int		timeo, retrans;
 	unsigned int		acregmin, acregmax;
 	unsigned int		acdirmin, acdirmax;
+	unsigned int		wcoalesce;	/* msecs */
 	unsigned int		namlen;
 	unsigned int		options;
 	unsigned int		bsize;
@@ -1170,6 +1170,7 @@ static int nfs4_init_server(struct nfs_server *server, struct fs_context *fc)
 	server->acregmax = ctx->acregmax * HZ;
 	server->acdirmin = ctx->acdirmin * HZ;
 	server->acdirmax = ctx->acdirmax * HZ;
+	server->wcoalesce = msecs_to_jiffies(ctx->wcoalesce);
 	server->port     = ctx->nfs_server.port;
 
 	return nfs_init_server_rpcclient(server, &timeparms,
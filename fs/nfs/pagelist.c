@@ -948,6 +948,7 @@ void nfs_pageio_init(struct nfs_pageio_descriptor *desc,
 
 	desc->pg_mirror_count = 1;
 	desc->pg_mirror_idx = 0;
+	desc->pg_mirror_pinned = 0;
 
 	desc->pg_mirrors_dynamic = NULL;
 	desc->pg_mirrors = desc->pg_mirrors_static;
@@ -3031,6 +3031,7 @@ void pnfs_read_resend_pnfs(struct nfs_pgio_header *hdr,
 		nfs_pageio_init_read(&pgio, hdr->inode, false,
 					hdr->completion_ops);
 		pgio.pg_mirror_idx = mirror_idx;
+		pgio.pg_mirror_pinned = 1;
 		hdr->task.tk_status = nfs_pageio_resend(&pgio, hdr);
 	}
 }
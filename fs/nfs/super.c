@@ -465,6 +465,8 @@ static void nfs_show_mount_options(struct seq_file *m, struct nfs_server *nfss,
 		seq_printf(m, ",acdirmin=%u", nfss->acdirmin/HZ);
 	if (nfss->acdirmax != NFS_DEF_ACDIRMAX*HZ || showdefaults)
 		seq_printf(m, ",acdirmax=%u", nfss->acdirmax/HZ);
+	if (nfss->wcoalesce)
+		seq_printf(m, ",wcoalesce=%u", jiffies_to_msecs(nfss->wcoalesce));
 	if (!(nfss->flags & (NFS_MOUNT_SOFT|NFS_MOUNT_SOFTERR)))
 			seq_puts(m, ",hard");
 	for (nfs_infop = nfs_info; nfs_infop->flag; nfs_infop++) {
@@ -1021,6 +1023,9 @@ int nfs_reconfigure(struct fs_context *fc)
 	if (ret)
 		return ret;
 
+	/* The write coalescing window may be retuned on a live mount */
+	WRITE_ONCE(nfss->wcoalesce, msecs_to_jiffies(ctx->wcoalesce));
+
 	return nfs_probe_server(nfss, NFS_FH(d_inode(fc->root)));
 }
 EXPORT_SYMBOL_GPL(nfs_reconfigure);
@@ -1105,6 +1110,8 @@ static int nfs_compare_mount_options(const struct super_block *s, const struct n
 		goto Ebusy;
 	if (a->acdirmax != b->acdirmax)
 		goto Ebusy;
+	if (a->wcoalesce != b->wcoalesce)
+		goto Ebusy;
 	if (clnt_a->cl_auth->au_flavor != clnt_b->cl_auth->au_flavor)
 		goto Ebusy;
 	return 1;
@@ -704,6 +704,40 @@ static void nfs_io_completion_commit(void *inode)
 	nfs_commit_inode(inode, 0);
 }
 
+/* How many coalescing windows data may stay dirty for at most */
+#define NFS_WCOALESCE_MAX_WINDOWS	4
+
+/*
+ * With the wcoalesce mount option, periodic and background writeback
+ * leave a file alone while it is still being written to, so that small
+ * appends build up into full-sized WRITEs and a single COMMIT instead of
+ * going out one by one.  Once a wsize worth of data is dirty there is
+ * nothing more to gain by waiting.  A file that is written to all the
+ * time is still flushed NFS_WCOALESCE_MAX_WINDOWS windows after it was
+ * first dirtied, so that its data doesn't stay unstable indefinitely.
+ */
+static bool nfs_write_coalescing(struct inode *inode,
+				 struct writeback_control *wbc)
+{
+	struct nfs_server *server = NFS_SERVER(inode);
+	unsigned long window = READ_ONCE(server->wcoalesce);
+	struct nfs_inode *nfsi = NFS_I(inode);
+	unsigned long first_dirty;
+
+	if (!window || wbc->sync_mode != WB_SYNC_NONE ||
+	    !(wbc->for_kupdate || wbc->for_background))
+		return false;
+	if (atomic_long_read(&nfsi->nrequests) >=
+	    server->wsize >> PAGE_SHIFT)
+		return false;
+	first_dirty = READ_ONCE(nfsi->first_dirty_stamp);
+	if (!first_dirty ||
+	    time_after_eq(jiffies,
+			  first_dirty + NFS_WCOALESCE_MAX_WINDOWS * window))
+		return false;
+	return time_before(jiffies, READ_ONCE(nfsi->write_stamp) + window);
+}
+
 int nfs_writepages(struct address_space *mapping, struct writeback_control *wbc)
 {
 	struct inode *inode = mapping->host;
@@ -716,6 +750,10 @@ int nfs_writepages(struct address_space *mapping, struct writeback_control *wbc)
 	if (wbc->sync_mode == WB_SYNC_NONE &&
 	    NFS_SERVER(inode)->write_congested)
 		return 0;
+	if (nfs_write_coalescing(inode, wbc))
+		return 0;
+	/* Writes from now on start a new coalescing period */
+	WRITE_ONCE(NFS_I(inode)->first_dirty_stamp, 0);
 
 	nfs_inc_stats(inode, NFSIOS_VFSWRITEPAGES);
 
@@ -1165,6 +1203,16 @@ static struct nfs_page *nfs_setup_write_request(struct nfs_open_context *ctx,
 	return req;
 }
 
+/* Record a buffered write for nfs_write_coalescing() */
+static void nfs_update_write_stamps(struct nfs_inode *nfsi)
+{
+	unsigned long now = jiffies;
+
+	WRITE_ONCE(nfsi->write_stamp, now);
+	if (!READ_ONCE(nfsi->first_dirty_stamp))
+		WRITE_ONCE(nfsi->first_dirty_stamp, now ?: 1);
+}
+
 static int nfs_writepage_setup(struct nfs_open_context *ctx,
 			       struct folio *folio, unsigned int offset,
 			       unsigned int count)
@@ -1385,6 +1433,8 @@ int nfs_update_folio(struct file *file, struct folio *folio,
 	status = nfs_writepage_setup(ctx, folio, offset, count);
 	if (status < 0)
 		nfs_set_pageerror(mapping);
+	else
+		nfs_update_write_stamps(NFS_I(inode));
 out:
 	dprintk("NFS:       nfs_update_folio returns %d (isize %lld)\n",
 			status, (long long)i_size_read(inode));
@@ -1986,6 +2036,10 @@ int nfs_write_inode(struct inode *inode, struct writeback_control *wbc)
 		if (mapping_tagged(inode->i_mapping, PAGECACHE_TAG_WRITEBACK))
 			goto out_mark_dirty;
 
+		/* Nor while the file is still being written to */
+		if (nfs_write_coalescing(inode, wbc))
+			goto out_mark_dirty;
+
 		/* don't wait for the COMMIT response */
 		flags = 0;
 	}
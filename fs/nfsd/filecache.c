@@ -39,6 +39,8 @@
 #include <linux/fsnotify.h>
 #include <linux/seq_file.h>
 #include <linux/rhashtable.h>
+#include <linux/moduleparam.h>
+#include <linux/topology.h>
 
 #include "vfs.h"
 #include "nfsd.h"
@@ -49,6 +51,9 @@
 
 #define NFSD_LAUNDRETTE_DELAY		     (2 * HZ)
 
+/* Number of LRU entries the laundrette examines between budget checks */
+#define NFSD_FILE_GC_BATCH		     (1024)
+
 #define NFSD_FILE_CACHE_UP		     (0)
 
 /* We only care about NFSD_MAY_READ/WRITE for this cache */
@@ -66,6 +71,15 @@ struct nfsd_fcache_disposal {
 	struct list_head freeme;
 };
 
+/*
+ * Each NUMA node has its own laundrette, which only ages the part of
+ * nfsd_file_lru that lives on that node, from a CPU on that node.
+ */
+struct nfsd_file_laundrette {
+	struct delayed_work	work;
+	int			nid;
+} ____cacheline_aligned_in_smp;
+
 static struct workqueue_struct *nfsd_filecache_wq __read_mostly;
 
 static struct kmem_cache		*nfsd_file_slab;
@@ -73,10 +87,19 @@ static struct kmem_cache		*nfsd_file_mark_slab;
 static struct list_lru			nfsd_file_lru;
 static unsigned long			nfsd_file_flags;
 static struct fsnotify_group		*nfsd_file_fsnotify_group;
-static struct delayed_work		nfsd_filecache_laundrette;
+static struct nfsd_file_laundrette	*nfsd_filecache_laundrettes;
 static struct rhltable			nfsd_file_rhltable
 						____cacheline_aligned_in_smp;
 
+/*
+ * CPU time, in microseconds, that one laundrette run may spend on its
+ * node's LRU.  Whatever is left over is examined on the next run.
+ */
+static unsigned int nfsd_file_gc_budget_us = 2000;
+module_param(nfsd_file_gc_budget_us, uint, 0644);
+MODULE_PARM_DESC(nfsd_file_gc_budget_us,
+		 "Max CPU time (usecs) per file cache garbage collection run");
+
 static bool
 nfsd_match_cred(const struct cred *c1, const struct cred *c2)
 {
@@ -111,11 +134,19 @@ static const struct rhashtable_params nfsd_file_rhash_params = {
 };
 
 static void
-nfsd_file_schedule_laundrette(void)
+nfsd_file_schedule_laundrette(int nid)
 {
-	if (test_bit(NFSD_FILE_CACHE_UP, &nfsd_file_flags))
-		queue_delayed_work(system_wq, &nfsd_filecache_laundrette,
-				   NFSD_LAUNDRETTE_DELAY);
+	struct nfsd_file_laundrette *l;
+	int cpu;
+
+	if (!test_bit(NFSD_FILE_CACHE_UP, &nfsd_file_flags))
+		return;
+
+	l = &nfsd_filecache_laundrettes[nid];
+	cpu = cpumask_any_and(cpumask_of_node(nid), cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = WORK_CPU_UNBOUND;
+	queue_delayed_work_on(cpu, system_wq, &l->work, NFSD_LAUNDRETTE_DELAY);
 }
 
 static void
@@ -214,7 +245,7 @@ nfsd_file_alloc(struct net *net, struct inode *inode, unsigned char need,
 {
 	struct nfsd_file *nf;
 
-	nf = kmem_cache_alloc(nfsd_file_slab, GFP_KERNEL);
+	nf = kmem_cache_alloc_node(nfsd_file_slab, GFP_KERNEL, numa_node_id());
 	if (unlikely(!nf))
 		return NULL;
 
@@ -373,7 +404,8 @@ nfsd_file_put(struct nfsd_file *nf)
 		if (nfsd_file_lru_add(nf)) {
 			/* If it's still hashed, we're done */
 			if (test_bit(NFSD_FILE_HASHED, &nf->nf_flags)) {
-				nfsd_file_schedule_laundrette();
+				nfsd_file_schedule_laundrette(
+					page_to_nid(virt_to_page(nf)));
 				return;
 			}
 
@@ -482,24 +514,46 @@ nfsd_file_lru_cb(struct list_head *item, struct list_lru_one *lru,
 	return LRU_REMOVED;
 }
 
+/*
+ * Walk the node's LRU in batches, at most once over the entries that
+ * were on it when we started, and stop early once the CPU budget for
+ * this run is used up.
+ */
 static void
-nfsd_file_gc(void)
+nfsd_file_gc(int nid)
 {
-	LIST_HEAD(dispose);
-	unsigned long ret;
-
-	ret = list_lru_walk(&nfsd_file_lru, nfsd_file_lru_cb,
-			    &dispose, list_lru_count(&nfsd_file_lru));
-	trace_nfsd_file_gc_removed(ret, list_lru_count(&nfsd_file_lru));
-	nfsd_file_dispose_list_delayed(&dispose);
+	u64 deadline = ktime_get_ns() +
+		(u64)READ_ONCE(nfsd_file_gc_budget_us) * NSEC_PER_USEC;
+	unsigned long remaining = list_lru_count_node(&nfsd_file_lru, nid);
+
+	while (remaining) {
+		unsigned long nr = min_t(unsigned long, remaining,
+					 NFSD_FILE_GC_BATCH);
+		LIST_HEAD(dispose);
+		unsigned long ret;
+
+		remaining -= nr;
+		ret = list_lru_walk_node(&nfsd_file_lru, nid, nfsd_file_lru_cb,
+					 &dispose, &nr);
+		trace_nfsd_file_gc_removed(ret,
+				list_lru_count_node(&nfsd_file_lru, nid));
+		nfsd_file_dispose_list_delayed(&dispose);
+
+		if (ktime_get_ns() >= deadline)
+			break;
+		cond_resched();
+	}
 }
 
 static void
 nfsd_file_gc_worker(struct work_struct *work)
 {
-	nfsd_file_gc();
-	if (list_lru_count(&nfsd_file_lru))
-		nfsd_file_schedule_laundrette();
+	struct nfsd_file_laundrette *l = container_of(to_delayed_work(work),
+					struct nfsd_file_laundrette, work);
+
+	nfsd_file_gc(l->nid);
+	if (list_lru_count_node(&nfsd_file_lru, l->nid))
+		nfsd_file_schedule_laundrette(l->nid);
 }
 
 static unsigned long
@@ -710,7 +764,7 @@ static const struct fsnotify_ops nfsd_file_fsnotify_ops = {
 int
 nfsd_file_cache_init(void)
 {
-	int ret;
+	int ret, nid;
 
 	lockdep_assert_held(&nfsd_mutex);
 	if (test_and_set_bit(NFSD_FILE_CACHE_UP, &nfsd_file_flags) == 1)
@@ -725,6 +779,12 @@ nfsd_file_cache_init(void)
 	if (!nfsd_filecache_wq)
 		goto out;
 
+	nfsd_filecache_laundrettes = kcalloc(nr_node_ids,
+					     sizeof(*nfsd_filecache_laundrettes),
+					     GFP_KERNEL);
+	if (!nfsd_filecache_laundrettes)
+		goto out_err;
+
 	nfsd_file_slab = kmem_cache_create("nfsd_file",
 				sizeof(struct nfsd_file), 0, 0, NULL);
 	if (!nfsd_file_slab) {
@@ -768,7 +828,11 @@ nfsd_file_cache_init(void)
 		goto out_notifier;
 	}
 
-	INIT_DELAYED_WORK(&nfsd_filecache_laundrette, nfsd_file_gc_worker);
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		nfsd_filecache_laundrettes[nid].nid = nid;
+		INIT_DELAYED_WORK(&nfsd_filecache_laundrettes[nid].work,
+				  nfsd_file_gc_worker);
+	}
 out:
 	return ret;
 out_notifier:
@@ -782,6 +846,8 @@ nfsd_file_cache_init(void)
 	nfsd_file_slab = NULL;
 	kmem_cache_destroy(nfsd_file_mark_slab);
 	nfsd_file_mark_slab = NULL;
+	kfree(nfsd_filecache_laundrettes);
+	nfsd_filecache_laundrettes = NULL;
 	destroy_workqueue(nfsd_filecache_wq);
 	nfsd_filecache_wq = NULL;
 	rhltable_destroy(&nfsd_file_rhltable);
@@ -884,7 +950,7 @@ nfsd_file_cache_shutdown_net(struct net *net)
 void
 nfsd_file_cache_shutdown(void)
 {
-	int i;
+	int i, nid;
 
 	lockdep_assert_held(&nfsd_mutex);
 	if (test_and_clear_bit(NFSD_FILE_CACHE_UP, &nfsd_file_flags) == 0)
@@ -896,7 +962,8 @@ nfsd_file_cache_shutdown(void)
 	 * make sure all callers of nfsd_file_lru_cb are done before
 	 * calling nfsd_file_cache_purge
 	 */
-	cancel_delayed_work_sync(&nfsd_filecache_laundrette);
+	for (nid = 0; nid < nr_node_ids; nid++)
+		cancel_delayed_work_sync(&nfsd_filecache_laundrettes[nid].work);
 	__nfsd_file_cache_purge(NULL);
 	list_lru_destroy(&nfsd_file_lru);
 	rcu_barrier();
@@ -907,6 +974,8 @@ nfsd_file_cache_shutdown(void)
 	fsnotify_wait_marks_destroyed();
 	kmem_cache_destroy(nfsd_file_mark_slab);
 	nfsd_file_mark_slab = NULL;
+	kfree(nfsd_filecache_laundrettes);
+	nfsd_filecache_laundrettes = NULL;
 	destroy_workqueue(nfsd_filecache_wq);
 	nfsd_filecache_wq = NULL;
 	rhltable_destroy(&nfsd_file_rhltable);
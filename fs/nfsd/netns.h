@@ -29,9 +29,18 @@ enum {
 	NFSD_NET_PAYLOAD_MISSES,
 	/* amount of memory (in bytes) currently consumed by the DRC */
 	NFSD_NET_DRC_MEM_USAGE,
+	/* number of entries currently in the DRC */
+	NFSD_NET_DRC_ENTRIES,
 	NFSD_NET_COUNTERS_NUM
 };
 
+/* Load of a thread pool, for autoscaling its number of threads */
+struct nfsd_pool_load {
+	struct percpu_counter busy;	/* threads processing a request */
+	bool		kicked;		/* congestion kicked the work early */
+	unsigned long	last_full;	/* jiffies when all threads were busy */
+};
+
 /*
  * Represents a nfsd "container". With respect to nfsv4 state tracking, the
  * fields of interest are the *_id_hashtbls and the *_name_tree. These track
@@ -119,6 +128,17 @@ struct nfsd_net {
 	 */
 	unsigned int max_connections;
 
+	/*
+	 * Bounds for the number of threads in each pool when autoscaling
+	 * it to the load.  A max_threads of '0' disables autoscaling, and
+	 * the thread count set through 'threads' is used as is.
+	 */
+	unsigned int min_threads;
+	unsigned int max_threads;
+	/* Load of each pool of nfsd_serv, sampled by the autoscale work */
+	struct nfsd_pool_load *nfsd_pool_load;
+	struct delayed_work nfsd_autoscale_work;
+
 	u32 clientid_base;
 	u32 clientid_counter;
 	u32 clverifier_counter;
@@ -165,9 +185,6 @@ struct nfsd_net {
 	 * these statistics to be completely accurate.
 	 */
 
-	/* total number of entries */
-	atomic_t                 num_drc_entries;
-
 	/* Per-netns stats counters */
 	struct percpu_counter    counter[NFSD_NET_COUNTERS_NUM];
 
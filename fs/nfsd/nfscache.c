@@ -121,7 +121,7 @@ nfsd_reply_cache_free_locked(struct nfsd_drc_bucket *b, struct svc_cacherep *rp,
 	if (rp->c_state != RC_UNUSED) {
 		rb_erase(&rp->c_node, &b->rb_head);
 		list_del(&rp->c_lru);
-		atomic_dec(&nn->num_drc_entries);
+		nfsd_stats_drc_entries_dec(nn);
 		nfsd_stats_drc_mem_usage_sub(nn, sizeof(*rp));
 	}
 	kmem_cache_free(drc_slab, rp);
@@ -165,7 +165,6 @@ int nfsd_reply_cache_init(struct nfsd_net *nn)
 	int status = 0;
 
 	nn->max_drc_entries = nfsd_cache_size_limit();
-	atomic_set(&nn->num_drc_entries, 0);
 	hashsize = nfsd_hashsize(nn->max_drc_entries);
 	nn->maskbits = ilog2(hashsize);
 
@@ -257,7 +256,7 @@ static long prune_bucket(struct nfsd_drc_bucket *b, struct nfsd_net *nn,
 		 */
 		if (rp->c_state == RC_INPROG)
 			continue;
-		if (atomic_read(&nn->num_drc_entries) <= nn->max_drc_entries &&
+		if (nfsd_stats_drc_entries(nn) <= nn->max_drc_entries &&
 		    time_before(jiffies, rp->c_timestamp + RC_EXPIRE))
 			break;
 		nfsd_reply_cache_free_locked(b, rp, nn);
@@ -300,7 +299,7 @@ nfsd_reply_cache_count(struct shrinker *shrink, struct shrink_control *sc)
 	struct nfsd_net *nn = container_of(shrink,
 				struct nfsd_net, nfsd_reply_cache_shrinker);
 
-	return atomic_read(&nn->num_drc_entries);
+	return nfsd_stats_drc_entries(nn);
 }
 
 static unsigned long
@@ -344,17 +343,31 @@ nfsd_cache_csum(struct svc_rqst *rqstp)
 	return csum;
 }
 
+/*
+ * Entries are ordered by xid and checksum first, so that most entries are
+ * told apart by the two fields in the first cache line of the entry, and the
+ * rest of the key is only compared for an xid and checksum match.
+ */
 static int
 nfsd_cache_key_cmp(const struct svc_cacherep *key,
 			const struct svc_cacherep *rp, struct nfsd_net *nn)
 {
-	if (key->c_key.k_xid == rp->c_key.k_xid &&
-	    key->c_key.k_csum != rp->c_key.k_csum) {
+	u32 xid = (__force u32)key->c_key.k_xid;
+	u32 rp_xid = (__force u32)rp->c_key.k_xid;
+	u32 csum = (__force u32)key->c_key.k_csum;
+	u32 rp_csum = (__force u32)rp->c_key.k_csum;
+
+	if (xid != rp_xid)
+		return xid < rp_xid ? -1 : 1;
+	if (csum != rp_csum) {
 		nfsd_stats_payload_misses_inc(nn);
 		trace_nfsd_drc_mismatch(nn, key, rp);
+		return csum < rp_csum ? -1 : 1;
 	}
 
-	return memcmp(&key->c_key, &rp->c_key, sizeof(key->c_key));
+	return memcmp(&key->c_key.k_proc, &rp->c_key.k_proc,
+		      sizeof(key->c_key) -
+		      offsetof(typeof(key->c_key), k_proc));
 }
 
 /*
@@ -390,15 +403,20 @@ nfsd_cache_insert(struct nfsd_drc_bucket *b, struct svc_cacherep *key,
 	rb_link_node(&key->c_node, parent, p);
 	rb_insert_color(&key->c_node, &b->rb_head);
 out:
-	/* tally hash chain length stats */
-	if (entries > nn->longest_chain) {
-		nn->longest_chain = entries;
-		nn->longest_chain_cachesize = atomic_read(&nn->num_drc_entries);
-	} else if (entries == nn->longest_chain) {
-		/* prefer to keep the smallest cachesize possible here */
-		nn->longest_chain_cachesize = min_t(unsigned int,
-				nn->longest_chain_cachesize,
-				atomic_read(&nn->num_drc_entries));
+	/*
+	 * Tally hash chain length stats.  These are shared by all buckets, so
+	 * only write them when they change.
+	 */
+	if (unlikely(entries >= READ_ONCE(nn->longest_chain))) {
+		unsigned int cachesize = nfsd_stats_drc_entries(nn);
+
+		if (entries > nn->longest_chain) {
+			nn->longest_chain = entries;
+			nn->longest_chain_cachesize = cachesize;
+		} else if (cachesize < nn->longest_chain_cachesize) {
+			/* prefer to keep the smallest cachesize possible here */
+			nn->longest_chain_cachesize = cachesize;
+		}
 	}
 
 	lru_put_end(b, ret);
@@ -456,7 +474,7 @@ int nfsd_cache_lookup(struct svc_rqst *rqstp)
 	rqstp->rq_cacherep = rp;
 	rp->c_state = RC_INPROG;
 
-	atomic_inc(&nn->num_drc_entries);
+	nfsd_stats_drc_entries_inc(nn);
 	nfsd_stats_drc_mem_usage_add(nn, sizeof(*rp));
 
 	nfsd_prune_bucket(b, nn);
@@ -610,8 +628,8 @@ int nfsd_reply_cache_stats_show(struct seq_file *m, void *v)
 					  nfsd_net_id);
 
 	seq_printf(m, "max entries:           %u\n", nn->max_drc_entries);
-	seq_printf(m, "num entries:           %u\n",
-		   atomic_read(&nn->num_drc_entries));
+	seq_printf(m, "num entries:           %lld\n",
+		   percpu_counter_sum_positive(&nn->counter[NFSD_NET_DRC_ENTRIES]));
 	seq_printf(m, "hash buckets:          %u\n", 1 << nn->maskbits);
 	seq_printf(m, "mem usage:             %lld\n",
 		   percpu_counter_sum_positive(&nn->counter[NFSD_NET_DRC_MEM_USAGE]));
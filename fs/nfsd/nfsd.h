@@ -95,6 +95,9 @@ int		nfsd_set_nrthreads(int n, int *, struct net *);
 int		nfsd_pool_stats_open(struct inode *, struct file *);
 int		nfsd_pool_stats_release(struct inode *, struct file *);
 void		nfsd_shutdown_threads(struct net *net);
+void		nfsd_autoscale_kick(struct net *net);
+void		nfsd_autoscale_init(struct nfsd_net *nn);
+void		nfsd_autoscale_shutdown(struct nfsd_net *nn);
 
 void		nfsd_put(struct net *net);
 
@@ -643,6 +643,163 @@ void nfsd_shutdown_threads(struct net *net)
 	mutex_unlock(&nfsd_mutex);
 }
 
+/*
+ * Thread pool autoscaling
+ *
+ * With max_threads set, the number of threads in each pool is adjusted
+ * between min_threads and max_threads by a periodic work item:
+ *
+ *  - A pool grows by a quarter when all of its threads are busy at the
+ *    sample, or a transport had to be queued because no thread was idle
+ *    (SP_CONGESTED).  A thread picking up a request while its pool is
+ *    congested kicks the work right away, so bursts are not queued for a
+ *    whole sampling interval.
+ *  - A pool that did not need all of its threads for NFSD_THREAD_IDLE_TIMEOUT
+ *    shrinks by a quarter, but not below its busy threads plus one.
+ *  - Pools without threads are left alone.
+ *
+ * Busy threads are counted per CPU, so that the RPC path does not bounce
+ * a shared cacheline; the work sums the counters once per sample.
+ */
+#define NFSD_AUTOSCALE_INTERVAL		(HZ)
+#define NFSD_THREAD_IDLE_TIMEOUT	(60 * HZ)
+
+static void nfsd_pool_busy(struct nfsd_net *nn, struct svc_rqst *rqstp)
+{
+	struct svc_pool *pool = rqstp->rq_pool;
+	struct nfsd_pool_load *pl = &nn->nfsd_pool_load[pool->sp_id];
+
+	percpu_counter_inc(&pl->busy);
+	nfsd_stats_th_busy_add(1);
+	if (test_bit(SP_CONGESTED, &pool->sp_flags) &&
+	    READ_ONCE(nn->max_threads) && !READ_ONCE(pl->kicked) &&
+	    !xchg(&pl->kicked, true))
+		mod_delayed_work(system_wq, &nn->nfsd_autoscale_work, 0);
+}
+
+static void nfsd_pool_idle(struct nfsd_net *nn, struct svc_rqst *rqstp)
+{
+	percpu_counter_dec(&nn->nfsd_pool_load[rqstp->rq_pool->sp_id].busy);
+	nfsd_stats_th_busy_add(-1);
+}
+
+static unsigned int nfsd_pool_target(struct nfsd_net *nn,
+				     struct svc_pool *pool,
+				     struct nfsd_pool_load *pl)
+{
+	unsigned int min = max(nn->min_threads, 1U);
+	unsigned int max = max(nn->max_threads, min);
+	unsigned int nr = pool->sp_nrthreads;
+	unsigned int step = max(nr / 4, 1U);
+	unsigned int busy = percpu_counter_sum_positive(&pl->busy);
+	bool congested = test_and_clear_bit(SP_CONGESTED, &pool->sp_flags);
+
+	WRITE_ONCE(pl->kicked, false);
+	if (congested || busy >= nr) {
+		pl->last_full = jiffies;
+		return clamp(nr + step, min, max);
+	}
+	if (time_before(jiffies, pl->last_full + NFSD_THREAD_IDLE_TIMEOUT))
+		return clamp(nr, min, max);
+	/* Idle for long enough: reap some threads and start over */
+	pl->last_full = jiffies;
+	return clamp(max(nr - step, busy + 1), min, max);
+}
+
+static void nfsd_autoscale_work(struct work_struct *work)
+{
+	struct nfsd_net *nn = container_of(to_delayed_work(work),
+					   struct nfsd_net,
+					   nfsd_autoscale_work);
+	struct svc_serv *serv;
+	unsigned int i, nr, target;
+
+	mutex_lock(&nfsd_mutex);
+	serv = nn->nfsd_serv;
+	if (!serv || !serv->sv_nrthreads || !nn->max_threads)
+		goto out_unlock;
+
+	/*
+	 * Each pool keeps at least one thread, so the threads that remain
+	 * keep serv alive while others exit.  A pool that was given no
+	 * threads is not used and is not scaled.
+	 */
+	for (i = 0; i < serv->sv_nrpools; i++) {
+		struct svc_pool *pool = &serv->sv_pools[i];
+
+		nr = pool->sp_nrthreads;
+		if (!nr)
+			continue;
+		target = nfsd_pool_target(nn, pool, &nn->nfsd_pool_load[i]);
+		if (target == nr)
+			continue;
+		if (svc_set_num_threads(serv, pool, target))
+			break;
+		if (target > nr)
+			atomic_add(target - nr, &nfsdstats.th_grown);
+		else
+			atomic_add(nr - target, &nfsdstats.th_reaped);
+	}
+	queue_delayed_work(system_wq, &nn->nfsd_autoscale_work,
+			   NFSD_AUTOSCALE_INTERVAL);
+out_unlock:
+	mutex_unlock(&nfsd_mutex);
+}
+
+/**
+ * nfsd_autoscale_kick - start or stop autoscaling of the thread pools
+ * @net: network namespace of the server
+ *
+ * Called after the thread count or the autoscaling bounds changed.
+ */
+void nfsd_autoscale_kick(struct net *net)
+{
+	struct nfsd_net *nn = net_generic(net, nfsd_net_id);
+
+	if (READ_ONCE(nn->max_threads))
+		mod_delayed_work(system_wq, &nn->nfsd_autoscale_work, 0);
+}
+
+void nfsd_autoscale_init(struct nfsd_net *nn)
+{
+	INIT_DELAYED_WORK(&nn->nfsd_autoscale_work, nfsd_autoscale_work);
+}
+
+void nfsd_autoscale_shutdown(struct nfsd_net *nn)
+{
+	cancel_delayed_work_sync(&nn->nfsd_autoscale_work);
+}
+
+static void nfsd_pool_load_free(struct nfsd_net *nn, unsigned int nrpools)
+{
+	unsigned int i;
+
+	for (i = 0; i < nrpools; i++)
+		percpu_counter_destroy(&nn->nfsd_pool_load[i].busy);
+	kfree(nn->nfsd_pool_load);
+	nn->nfsd_pool_load = NULL;
+}
+
+static int nfsd_pool_load_alloc(struct nfsd_net *nn, unsigned int nrpools)
+{
+	struct nfsd_pool_load *pl;
+	unsigned int i;
+
+	pl = kcalloc(nrpools, sizeof(*pl), GFP_KERNEL);
+	if (!pl)
+		return -ENOMEM;
+	nn->nfsd_pool_load = pl;
+
+	for (i = 0; i < nrpools; i++) {
+		if (percpu_counter_init(&pl[i].busy, 0, GFP_KERNEL)) {
+			nfsd_pool_load_free(nn, i);
+			return -ENOMEM;
+		}
+		pl[i].last_full = jiffies;
+	}
+	return 0;
+}
+
 bool i_am_nfsd(void)
 {
 	return kthread_func(current) == nfsd;
@@ -666,12 +823,19 @@ int nfsd_create_serv(struct net *net)
 	if (serv == NULL)
 		return -ENOMEM;
 
+	error = nfsd_pool_load_alloc(nn, serv->sv_nrpools);
+	if (error) {
+		svc_put(serv);
+		return error;
+	}
+
 	serv->sv_maxconn = nn->max_connections;
 	error = svc_bind(serv, net);
 	if (error < 0) {
 		/* NOT nfsd_put() as notifiers (see below) haven't
 		 * been set up yet.
 		 */
+		nfsd_pool_load_free(nn, serv->sv_nrpools);
 		svc_put(serv);
 		return error;
 	}
@@ -728,12 +892,15 @@ void nfsd_put(struct net *net)
 	struct nfsd_net *nn = net_generic(net, nfsd_net_id);
 
 	if (kref_put(&nn->nfsd_serv->sv_refcnt, nfsd_noop)) {
+		unsigned int nrpools = nn->nfsd_serv->sv_nrpools;
+
 		svc_xprt_destroy_all(nn->nfsd_serv, net);
 		nfsd_last_thread(nn->nfsd_serv, net);
 		svc_destroy(&nn->nfsd_serv->sv_refcnt);
 		spin_lock(&nfsd_notifier_lock);
 		nn->nfsd_serv = NULL;
 		spin_unlock(&nfsd_notifier_lock);
+		nfsd_pool_load_free(nn, nrpools);
 	}
 }
 
@@ -829,6 +996,7 @@ nfsd_svc(int nrservs, struct net *net, const struct cred *cred)
 	if (error)
 		goto out_shutdown;
 	error = nn->nfsd_serv->sv_nrthreads;
+	nfsd_autoscale_kick(net);
 out_shutdown:
 	if (error < 0 && !nfsd_up_before)
 		nfsd_shutdown_net(net);
@@ -988,9 +1156,11 @@ nfsd(void *vrqstp)
 			;
 		if (err == -EINTR)
 			break;
+		nfsd_pool_busy(nn, rqstp);
 		validate_process_creds();
 		svc_process(rqstp);
 		validate_process_creds();
+		nfsd_pool_idle(nn, rqstp);
 	}
 
 	/* Clear signals before calling svc_exit_thread() */
@@ -13,6 +13,9 @@
  *			statistics for IO throughput
  *	th <threads> <deprecated thread usage histogram stats>
  *			number of threads
+ *	tp <busy> <grown> <reaped>
+ *			thread pool utilisation: threads processing requests,
+ *			threads started and idle threads stopped by autoscaling
  *	ra <deprecated ra-cache stats>
  *
  *	plus generic RPC stats (see net/sunrpc/stats.c)
@@ -54,6 +57,12 @@ static int nfsd_show(struct seq_file *seq, void *v)
 	/* deprecated ra-cache stats */
 	seq_puts(seq, "\nra 0 0 0 0 0 0 0 0 0 0 0 0\n");
 
+	/* thread pool utilisation */
+	seq_printf(seq, "tp %lld %u %u\n",
+		   percpu_counter_sum_positive(&nfsdstats.counter[NFSD_STATS_TH_BUSY]),
+		   atomic_read(&nfsdstats.th_grown),
+		   atomic_read(&nfsdstats.th_reaped));
+
 	/* show my rpc info */
 	svc_seq_show(seq, &nfsd_svcstats);
 
@@ -18,6 +18,7 @@ enum {
 	NFSD_STATS_FH_STALE,		/* FH stale error */
 	NFSD_STATS_IO_READ,		/* bytes returned to read requests */
 	NFSD_STATS_IO_WRITE,		/* bytes passed in write requests */
+	NFSD_STATS_TH_BUSY,		/* threads processing requests */
 #ifdef CONFIG_NFSD_V4
 	NFSD_STATS_FIRST_NFS4_OP,	/* count of individual nfsv4 operations */
 	NFSD_STATS_LAST_NFS4_OP = NFSD_STATS_FIRST_NFS4_OP + LAST_NFS4_OP,
@@ -30,6 +31,8 @@ struct nfsd_stats {
 	struct percpu_counter	counter[NFSD_STATS_COUNTERS_NUM];
 
 	atomic_t	th_cnt;		/* number of available threads */
+	atomic_t	th_grown;	/* threads started by autoscaling */
+	atomic_t	th_reaped;	/* idle threads stopped by autoscaling */
 };
 
 extern struct nfsd_stats	nfsdstats;
@@ -78,6 +81,11 @@ static inline void nfsd_stats_io_write_add(struct svc_export *exp, s64 amount)
 		percpu_counter_add(&exp->ex_stats.counter[EXP_STATS_IO_WRITE], amount);
 }
 
+static inline void nfsd_stats_th_busy_add(s64 amount)
+{
+	percpu_counter_add(&nfsdstats.counter[NFSD_STATS_TH_BUSY], amount);
+}
+
 static inline void nfsd_stats_payload_misses_inc(struct nfsd_net *nn)
 {
 	percpu_counter_inc(&nn->counter[NFSD_NET_PAYLOAD_MISSES]);
@@ -93,4 +101,23 @@ static inline void nfsd_stats_drc_mem_usage_sub(struct nfsd_net *nn, s64 amount)
 	percpu_counter_sub(&nn->counter[NFSD_NET_DRC_MEM_USAGE], amount);
 }
 
+static inline void nfsd_stats_drc_entries_inc(struct nfsd_net *nn)
+{
+	percpu_counter_inc(&nn->counter[NFSD_NET_DRC_ENTRIES]);
+}
+
+static inline void nfsd_stats_drc_entries_dec(struct nfsd_net *nn)
+{
+	percpu_counter_dec(&nn->counter[NFSD_NET_DRC_ENTRIES]);
+}
+
+/*
+ * Approximate number of DRC entries, cheap enough for the request path
+ * and the shrinker.
+ */
+static inline unsigned int nfsd_stats_drc_entries(struct nfsd_net *nn)
+{
+	return percpu_counter_read_positive(&nn->counter[NFSD_NET_DRC_ENTRIES]);
+}
+
 #endif /* _NFSD_STATS_H */
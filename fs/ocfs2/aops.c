@@ -406,6 +406,23 @@ static int ocfs2_writepage(struct page *page, struct writeback_control *wbc)
 	return block_write_full_page(page, ocfs2_get_block, wbc);
 }
 
+/*
+ * Same rules as ocfs2_writepage(), no cluster locks are taken.  Writing
+ * back a whole range at a time lets ocfs2_get_block() map a full extent
+ * per call and the dirty pages of an extent go out in large bios.  Pages
+ * whose buffers can't be written that way fall back to
+ * block_write_full_page().
+ */
+static int ocfs2_writepages(struct address_space *mapping,
+			    struct writeback_control *wbc)
+{
+	trace_ocfs2_writepages(
+		(unsigned long long)OCFS2_I(mapping->host)->ip_blkno,
+		wbc->nr_to_write);
+
+	return mpage_writepages(mapping, wbc, ocfs2_get_block);
+}
+
 /* Taken from ext3. We don't necessarily need the full blown
  * functionality yet, but IMHO it's better to cut and paste the whole
  * thing so we can avoid introducing our own bugs (and easily pick up
@@ -2471,6 +2488,7 @@ const struct address_space_operations ocfs2_aops = {
 	.read_folio		= ocfs2_read_folio,
 	.readahead		= ocfs2_readahead,
 	.writepage		= ocfs2_writepage,
+	.writepages		= ocfs2_writepages,
 	.write_begin		= ocfs2_write_begin,
 	.write_end		= ocfs2_write_end,
 	.bmap			= ocfs2_bmap,
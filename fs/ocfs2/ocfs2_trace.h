@@ -1159,6 +1159,8 @@ DEFINE_OCFS2_ULL_ULL_EVENT(ocfs2_readpage);
 
 DEFINE_OCFS2_ULL_ULL_EVENT(ocfs2_writepage);
 
+DEFINE_OCFS2_ULL_ULL_EVENT(ocfs2_writepages);
+
 DEFINE_OCFS2_ULL_ULL_EVENT(ocfs2_bmap);
 
 TRACE_EVENT(ocfs2_try_to_write_inline_data,
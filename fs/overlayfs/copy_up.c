@@ -230,17 +230,51 @@ static int ovl_copy_fileattr(struct inode *inode, const struct path *old,
 	return ovl_real_fileattr_set(new, &newfa);
 }
 
+/* Report copy-up progress of large files every that many bytes */
+#define OVL_COPY_UP_PROGRESS_SIZE (256ULL << 20)
+
+struct ovl_copy_up_stats {
+	loff_t cloned;
+	loff_t copied;
+	loff_t spliced;
+	loff_t skipped;
+};
+
+/*
+ * Copy a chunk with the copy_file_range method shared by lower and upper fs,
+ * which may reflink or offload the copy to a server.  The caller already
+ * holds write access to the upper fs, so unlike vfs_copy_file_range() this
+ * does not take freeze protection again.
+ */
+static ssize_t ovl_copy_up_range(struct file *old_file, loff_t old_pos,
+				 struct file *new_file, loff_t new_pos,
+				 size_t len)
+{
+	if (!new_file->f_op->copy_file_range ||
+	    file_inode(old_file)->i_sb->s_type !=
+	    file_inode(new_file)->i_sb->s_type ||
+	    old_file->f_op->copy_file_range != new_file->f_op->copy_file_range)
+		return -EOPNOTSUPP;
+
+	return new_file->f_op->copy_file_range(old_file, old_pos,
+					       new_file, new_pos, len, 0);
+}
+
 static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 			    struct file *new_file, loff_t len)
 {
 	struct path datapath;
 	struct file *old_file;
+	struct ovl_copy_up_stats stats = {};
+	loff_t size = len;
 	loff_t old_pos = 0;
 	loff_t new_pos = 0;
 	loff_t cloned;
 	loff_t data_pos = -1;
 	loff_t hole_len;
+	loff_t next_progress = OVL_COPY_UP_PROGRESS_SIZE;
 	bool skip_hole = false;
+	bool try_copy_range = true;
 	int error = 0;
 
 	ovl_path_lowerdata(dentry, &datapath);
@@ -253,8 +287,10 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 
 	/* Try to use clone_file_range to clone up within the same fs */
 	cloned = do_clone_file_range(old_file, 0, new_file, 0, len, 0);
-	if (cloned == len)
+	if (cloned == len) {
+		stats.cloned = len;
 		goto out_fput;
+	}
 	/* Couldn't clone, so now we try to copy the data */
 
 	/* Check if lower fs supports seek operation */
@@ -294,29 +330,61 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 			if (data_pos > old_pos) {
 				hole_len = data_pos - old_pos;
 				len -= hole_len;
+				stats.skipped += hole_len;
 				old_pos = new_pos = data_pos;
 				continue;
 			} else if (data_pos == -ENXIO) {
+				stats.skipped += len;
 				break;
 			} else if (data_pos < 0) {
 				skip_hole = false;
 			}
 		}
 
-		bytes = do_splice_direct(old_file, &old_pos,
-					 new_file, &new_pos,
-					 this_len, SPLICE_F_MOVE);
-		if (bytes <= 0) {
-			error = bytes;
-			break;
+		/*
+		 * Prefer copy_file_range of the data chunk when lower and
+		 * upper are on the same type of fs, and fall back to splice
+		 * for good on the first failure.
+		 */
+		bytes = 0;
+		if (try_copy_range) {
+			bytes = ovl_copy_up_range(old_file, old_pos,
+						  new_file, new_pos, this_len);
+			if (bytes > 0) {
+				old_pos += bytes;
+				new_pos += bytes;
+				stats.copied += bytes;
+			} else {
+				try_copy_range = false;
+				bytes = 0;
+			}
+		}
+
+		if (!bytes) {
+			bytes = do_splice_direct(old_file, &old_pos,
+						 new_file, &new_pos,
+						 this_len, SPLICE_F_MOVE);
+			if (bytes <= 0) {
+				error = bytes;
+				break;
+			}
+			WARN_ON(old_pos != new_pos);
+			stats.spliced += bytes;
 		}
-		WARN_ON(old_pos != new_pos);
 
 		len -= bytes;
+		if (old_pos >= next_progress) {
+			pr_debug("copy-up data of %pd2: %lld/%lld bytes\n",
+				 dentry, old_pos, size);
+			next_progress = old_pos + OVL_COPY_UP_PROGRESS_SIZE;
+		}
 	}
 	if (!error && ovl_should_sync(ofs))
 		error = vfs_fsync(new_file, 0);
 out_fput:
+	pr_debug("copy-up data of %pd2: size=%lld cloned=%lld copied=%lld spliced=%lld holes=%lld err=%i\n",
+		 dentry, size, stats.cloned, stats.copied, stats.spliced,
+		 stats.skipped, error);
 	fput(old_file);
 	return error;
 }
@@ -1116,6 +1184,25 @@ static bool ovl_open_need_copy_up(struct dentry *dentry, int flags)
 	return true;
 }
 
+/*
+ * With "metacopy=lazy", opening a regular file for write only copies up
+ * metadata and data copy-up is deferred to ovl_copy_up_on_write(), so that
+ * opening a large lower file for write does not stall until it was copied.
+ */
+static bool ovl_open_lazy_data_copy_up(struct dentry *dentry, int flags)
+{
+	struct ovl_fs *ofs = OVL_FS(dentry->d_sb);
+
+	if (!ofs->config.metacopy || !ofs->config.lazy_datacopy)
+		return false;
+
+	/* Nothing to copy if truncated anyway */
+	if (flags & O_TRUNC)
+		return false;
+
+	return S_ISREG(d_inode(dentry)->i_mode);
+}
+
 int ovl_maybe_copy_up(struct dentry *dentry, int flags)
 {
 	int err = 0;
@@ -1123,7 +1210,10 @@ int ovl_maybe_copy_up(struct dentry *dentry, int flags)
 	if (ovl_open_need_copy_up(dentry, flags)) {
 		err = ovl_want_write(dentry);
 		if (!err) {
-			err = ovl_copy_up_flags(dentry, flags);
+			if (ovl_open_lazy_data_copy_up(dentry, flags))
+				err = ovl_copy_up_flags(dentry, 0);
+			else
+				err = ovl_copy_up_flags(dentry, flags);
 			ovl_drop_write(dentry);
 		}
 	}
@@ -1131,6 +1221,28 @@ int ovl_maybe_copy_up(struct dentry *dentry, int flags)
 	return err;
 }
 
+/*
+ * Copy up data of a file opened for write with lazy data copy-up, before it
+ * is modified for the first time.
+ */
+int ovl_copy_up_on_write(struct file *file)
+{
+	struct dentry *dentry = file_dentry(file);
+	int err;
+
+	if (!(file->f_mode & FMODE_WRITE) ||
+	    ovl_already_copied_up(dentry, O_WRONLY))
+		return 0;
+
+	err = ovl_want_write(dentry);
+	if (!err) {
+		err = ovl_copy_up_flags(dentry, O_WRONLY);
+		ovl_drop_write(dentry);
+	}
+
+	return err;
+}
+
 int ovl_copy_up_with_data(struct dentry *dentry)
 {
 	return ovl_copy_up_flags(dentry, O_WRONLY);
@@ -24,6 +24,12 @@ struct ovl_aio_req {
 
 static struct kmem_cache *ovl_aio_request_cachep;
 
+struct ovl_file {
+	struct file *realfile;
+	/* Upper file opened after lazy data copy-up of realfile */
+	struct file *upperfile;
+};
+
 static char ovl_whatisit(struct inode *inode, struct inode *realinode)
 {
 	if (realinode != ovl_inode_upper(inode))
@@ -37,6 +43,21 @@ static char ovl_whatisit(struct inode *inode, struct inode *realinode)
 /* No atime modification nor notify on underlying */
 #define OVL_OPEN_FLAGS (O_NOATIME | FMODE_NONOTIFY)
 
+/*
+ * A file opened for write with lazy data copy-up reads from lower data until
+ * it is first written, so never open lower for write.
+ */
+static int ovl_real_open_flags(const struct file *file,
+			       const struct inode *realinode)
+{
+	int flags = file->f_flags;
+
+	if (realinode != ovl_inode_upper(file_inode(file)))
+		flags &= ~(O_ACCMODE | O_APPEND);
+
+	return flags;
+}
+
 static struct file *ovl_open_realfile(const struct file *file,
 				      const struct path *realpath)
 {
@@ -45,7 +66,7 @@ static struct file *ovl_open_realfile(const struct file *file,
 	struct mnt_idmap *real_idmap;
 	struct file *realfile;
 	const struct cred *old_cred;
-	int flags = file->f_flags | OVL_OPEN_FLAGS;
+	int flags = ovl_real_open_flags(file, realinode) | OVL_OPEN_FLAGS;
 	int acc_mode = ACC_MODE(flags);
 	int err;
 
@@ -102,31 +123,67 @@ static int ovl_change_flags(struct file *file, unsigned int flags)
 	return 0;
 }
 
+/*
+ * Keep the upper file opened once the data of a file was copied up after
+ * open, so that not every operation has to reopen it.
+ */
+static struct file *ovl_upperfile(const struct file *file,
+				  const struct path *upperpath)
+{
+	struct ovl_file *of = file->private_data;
+	struct file *upperfile = smp_load_acquire(&of->upperfile);
+	struct file *old;
+
+	if (upperfile)
+		return upperfile;
+
+	upperfile = ovl_open_realfile(file, upperpath);
+	if (IS_ERR(upperfile))
+		return upperfile;
+
+	old = cmpxchg_release(&of->upperfile, NULL, upperfile);
+	if (old) {
+		fput(upperfile);
+		upperfile = old;
+	}
+
+	return upperfile;
+}
+
 static int ovl_real_fdget_meta(const struct file *file, struct fd *real,
 			       bool allow_meta)
 {
 	struct dentry *dentry = file_dentry(file);
+	struct ovl_file *of = file->private_data;
+	struct inode *realinode;
 	struct path realpath;
+	int flags;
 
 	real->flags = 0;
-	real->file = file->private_data;
+	real->file = of->realfile;
 
 	if (allow_meta)
 		ovl_path_real(dentry, &realpath);
 	else
 		ovl_path_realdata(dentry, &realpath);
+	realinode = d_inode(realpath.dentry);
 
 	/* Has it been copied up since we'd opened it? */
-	if (unlikely(file_inode(real->file) != d_inode(realpath.dentry))) {
-		real->flags = FDPUT_FPUT;
-		real->file = ovl_open_realfile(file, &realpath);
-
-		return PTR_ERR_OR_ZERO(real->file);
+	if (unlikely(file_inode(real->file) != realinode)) {
+		if (realinode == ovl_inode_upper(file_inode(file))) {
+			real->file = ovl_upperfile(file, &realpath);
+		} else {
+			real->flags = FDPUT_FPUT;
+			real->file = ovl_open_realfile(file, &realpath);
+		}
+		if (IS_ERR(real->file))
+			return PTR_ERR(real->file);
 	}
 
 	/* Did the flags change since open? */
-	if (unlikely((file->f_flags ^ real->file->f_flags) & ~OVL_OPEN_FLAGS))
-		return ovl_change_flags(real->file, file->f_flags);
+	flags = ovl_real_open_flags(file, realinode);
+	if (unlikely((flags ^ real->file->f_flags) & ~OVL_OPEN_FLAGS))
+		return ovl_change_flags(real->file, flags);
 
 	return 0;
 }
@@ -146,6 +203,7 @@ static int ovl_real_fdget(const struct file *file, struct fd *real)
 static int ovl_open(struct inode *inode, struct file *file)
 {
 	struct dentry *dentry = file_dentry(file);
+	struct ovl_file *of;
 	struct file *realfile;
 	struct path realpath;
 	int err;
@@ -157,19 +215,31 @@ static int ovl_open(struct inode *inode, struct file *file)
 	/* No longer need these flags, so don't pass them on to underlying fs */
 	file->f_flags &= ~(O_CREAT | O_EXCL | O_NOCTTY | O_TRUNC);
 
+	of = kzalloc(sizeof(*of), GFP_KERNEL);
+	if (!of)
+		return -ENOMEM;
+
 	ovl_path_realdata(dentry, &realpath);
 	realfile = ovl_open_realfile(file, &realpath);
-	if (IS_ERR(realfile))
+	if (IS_ERR(realfile)) {
+		kfree(of);
 		return PTR_ERR(realfile);
+	}
 
-	file->private_data = realfile;
+	of->realfile = realfile;
+	file->private_data = of;
 
 	return 0;
 }
 
 static int ovl_release(struct inode *inode, struct file *file)
 {
-	fput(file->private_data);
+	struct ovl_file *of = file->private_data;
+
+	fput(of->realfile);
+	if (of->upperfile)
+		fput(of->upperfile);
+	kfree(of);
 
 	return 0;
 }
@@ -357,6 +427,10 @@ static ssize_t ovl_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 	if (!iov_iter_count(iter))
 		return 0;
 
+	ret = ovl_copy_up_on_write(file);
+	if (ret)
+		return ret;
+
 	inode_lock(inode);
 	/* Update mode */
 	ovl_copyattr(inode);
@@ -435,6 +509,10 @@ static ssize_t ovl_splice_write(struct pipe_inode_info *pipe, struct file *out,
 	struct inode *inode = file_inode(out);
 	ssize_t ret;
 
+	ret = ovl_copy_up_on_write(out);
+	if (ret)
+		return ret;
+
 	inode_lock(inode);
 	/* Update mode */
 	ovl_copyattr(inode);
@@ -491,22 +569,36 @@ static int ovl_fsync(struct file *file, loff_t start, loff_t end, int datasync)
 
 static int ovl_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	struct file *realfile = file->private_data;
+	struct fd real;
 	const struct cred *old_cred;
 	int ret;
 
-	if (!realfile->f_op->mmap)
-		return -ENODEV;
-
 	if (WARN_ON(file != vma->vm_file))
 		return -EIO;
 
-	vma_set_file(vma, realfile);
+	/* Shared writable mappings write to the real file directly */
+	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE)) {
+		ret = ovl_copy_up_on_write(file);
+		if (ret)
+			return ret;
+	}
+
+	ret = ovl_real_fdget(file, &real);
+	if (ret)
+		return ret;
+
+	ret = -ENODEV;
+	if (!real.file->f_op->mmap)
+		goto out_fdput;
+
+	vma_set_file(vma, real.file);
 
 	old_cred = ovl_override_creds(file_inode(file)->i_sb);
 	ret = call_mmap(vma->vm_file, vma);
 	revert_creds(old_cred);
 	ovl_file_accessed(file);
+out_fdput:
+	fdput(real);
 
 	return ret;
 }
@@ -518,6 +610,10 @@ static long ovl_fallocate(struct file *file, int mode, loff_t offset, loff_t len
 	const struct cred *old_cred;
 	int ret;
 
+	ret = ovl_copy_up_on_write(file);
+	if (ret)
+		return ret;
+
 	inode_lock(inode);
 	/* Update mode */
 	ovl_copyattr(inode);
@@ -578,6 +674,12 @@ static loff_t ovl_copyfile(struct file *file_in, loff_t pos_in,
 	const struct cred *old_cred;
 	loff_t ret;
 
+	if (op != OVL_DEDUPE) {
+		ret = ovl_copy_up_on_write(file_out);
+		if (ret)
+			return ret;
+	}
+
 	inode_lock(inode_out);
 	if (op != OVL_DEDUPE) {
 		/* Update mode */
@@ -657,7 +759,7 @@ static loff_t ovl_remap_file_range(struct file *file_in, loff_t pos_in,
 	 */
 	if (op == OVL_DEDUPE &&
 	    (!ovl_inode_upper(file_inode(file_in)) ||
-	     !ovl_inode_upper(file_inode(file_out))))
+	     !ovl_has_upperdata(file_inode(file_out))))
 		return -EPERM;
 
 	return ovl_copyfile(file_in, pos_in, file_out, pos_out, len,
@@ -18,8 +18,11 @@ struct ovl_config {
 	bool nfs_export;
 	int xino;
 	bool metacopy;
+	/* With metacopy, defer data copy-up from open to first write */
+	bool lazy_datacopy;
 	bool userxattr;
 	bool ovl_volatile;
+	bool readdir_cache;
 };
 
 struct ovl_sb {
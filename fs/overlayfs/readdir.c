@@ -235,6 +235,20 @@ void ovl_dir_cache_free(struct inode *inode)
 	}
 }
 
+/*
+ * With "readdir_cache=on", the merged cache of a dir is kept on the inode
+ * after the last close, until the dir is modified or the inode is evicted,
+ * so that the next open does not need to read and merge all layers again.
+ * Lower layers do not change, so only changes to the upper dir, which bump
+ * the dir version, invalidate the cache.
+ */
+static bool ovl_keep_dir_cache(struct inode *inode,
+			       struct ovl_dir_cache *cache)
+{
+	return OVL_FS(inode->i_sb)->config.readdir_cache &&
+		ovl_inode_version_get(inode) == cache->version;
+}
+
 static void ovl_cache_put(struct ovl_dir_file *od, struct inode *inode)
 {
 	struct ovl_dir_cache *cache = od->cache;
@@ -242,8 +256,11 @@ static void ovl_cache_put(struct ovl_dir_file *od, struct inode *inode)
 	WARN_ON(cache->refcount <= 0);
 	cache->refcount--;
 	if (!cache->refcount) {
-		if (ovl_dir_cache(inode) == cache)
+		if (ovl_dir_cache(inode) == cache) {
+			if (ovl_keep_dir_cache(inode, cache))
+				return;
 			ovl_set_dir_cache(inode, NULL);
+		}
 
 		ovl_cache_free(&cache->entries);
 		kfree(cache);
@@ -398,10 +415,14 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 
 	cache = ovl_dir_cache(inode);
 	if (cache && ovl_inode_version_get(inode) == cache->version) {
-		WARN_ON(!cache->refcount);
+		/* A cache kept after close has no references */
+		WARN_ON(!cache->refcount && !ovl_keep_dir_cache(inode, cache));
 		cache->refcount++;
 		return cache;
 	}
+	/* Stale cache kept after close is not used by any open dir */
+	if (cache && !cache->refcount)
+		ovl_dir_cache_free(inode);
 	ovl_set_dir_cache(d_inode(dentry), NULL);
 
 	cache = kzalloc(sizeof(struct ovl_dir_cache), GFP_KERNEL);
@@ -67,6 +67,11 @@ module_param_named(metacopy, ovl_metacopy_def, bool, 0644);
 MODULE_PARM_DESC(metacopy,
 		 "Default to on or off for the metadata only copy up feature");
 
+static bool ovl_readdir_cache_def;
+module_param_named(readdir_cache, ovl_readdir_cache_def, bool, 0644);
+MODULE_PARM_DESC(readdir_cache,
+		 "Default to on or off for keeping merged dir caches after close");
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -384,13 +389,18 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 						"on" : "off");
 	if (ofs->config.xino != ovl_xino_def() && !ovl_same_fs(sb))
 		seq_printf(m, ",xino=%s", ovl_xino_str[ofs->config.xino]);
-	if (ofs->config.metacopy != ovl_metacopy_def)
+	if (ofs->config.metacopy && ofs->config.lazy_datacopy)
+		seq_puts(m, ",metacopy=lazy");
+	else if (ofs->config.metacopy != ovl_metacopy_def)
 		seq_printf(m, ",metacopy=%s",
 			   ofs->config.metacopy ? "on" : "off");
 	if (ofs->config.ovl_volatile)
 		seq_puts(m, ",volatile");
 	if (ofs->config.userxattr)
 		seq_puts(m, ",userxattr");
+	if (ofs->config.readdir_cache != ovl_readdir_cache_def)
+		seq_printf(m, ",readdir_cache=%s",
+			   ofs->config.readdir_cache ? "on" : "off");
 	return 0;
 }
 
@@ -445,7 +455,10 @@ enum {
 	OPT_XINO_AUTO,
 	OPT_METACOPY_ON,
 	OPT_METACOPY_OFF,
+	OPT_METACOPY_LAZY,
 	OPT_VOLATILE,
+	OPT_READDIR_CACHE_ON,
+	OPT_READDIR_CACHE_OFF,
 	OPT_ERR,
 };
 
@@ -467,7 +480,10 @@ static const match_table_t ovl_tokens = {
 	{OPT_XINO_AUTO,			"xino=auto"},
 	{OPT_METACOPY_ON,		"metacopy=on"},
 	{OPT_METACOPY_OFF,		"metacopy=off"},
+	{OPT_METACOPY_LAZY,		"metacopy=lazy"},
 	{OPT_VOLATILE,			"volatile"},
+	{OPT_READDIR_CACHE_ON,		"readdir_cache=on"},
+	{OPT_READDIR_CACHE_OFF,		"readdir_cache=off"},
 	{OPT_ERR,			NULL}
 };
 
@@ -612,11 +628,19 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 
 		case OPT_METACOPY_ON:
 			config->metacopy = true;
+			config->lazy_datacopy = false;
 			metacopy_opt = true;
 			break;
 
 		case OPT_METACOPY_OFF:
 			config->metacopy = false;
+			config->lazy_datacopy = false;
+			metacopy_opt = true;
+			break;
+
+		case OPT_METACOPY_LAZY:
+			config->metacopy = true;
+			config->lazy_datacopy = true;
 			metacopy_opt = true;
 			break;
 
@@ -624,6 +648,14 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 			config->ovl_volatile = true;
 			break;
 
+		case OPT_READDIR_CACHE_ON:
+			config->readdir_cache = true;
+			break;
+
+		case OPT_READDIR_CACHE_OFF:
+			config->readdir_cache = false;
+			break;
+
 		case OPT_USERXATTR:
 			config->userxattr = true;
 			break;
@@ -1918,6 +1950,7 @@ static int ovl_fill_super(struct super_block *sb, void *data, int silent)
 	ofs->config.nfs_export = ovl_nfs_export_def;
 	ofs->config.xino = ovl_xino_def();
 	ofs->config.metacopy = ovl_metacopy_def;
+	ofs->config.readdir_cache = ovl_readdir_cache_def;
 	err = ovl_parse_opt((char *) data, &ofs->config);
 	if (err)
 		goto out_err;
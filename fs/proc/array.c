@@ -92,6 +92,12 @@
 #include <linux/fs_struct.h>
 #include <linux/kthread.h>
 #include <linux/mmu_context.h>
+#include <linux/cgroup.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/task_io_accounting_ops.h>
+#include <linux/uaccess.h>
+#include <uapi/linux/proc_taskinfo.h>
 
 #include <asm/processor.h>
 #include "internal.h"
@@ -805,3 +811,267 @@ const struct file_operations proc_tid_children_operations = {
 	.release = seq_release,
 };
 #endif /* CONFIG_PROC_CHILDREN */
+
+/*
+ * /proc/taskinfo: the main /proc/<pid>/stat, status and io numbers of
+ * many thread groups per read, as fixed size binary records, see
+ * <uapi/linux/proc_taskinfo.h>. This saves monitors a path lookup, the
+ * text formatting and the parsing for every task they sample.
+ */
+struct taskinfo_file {
+	struct mutex	lock;
+	struct cgroup	*cgrp;		/* filter, or NULL */
+};
+
+/* Like next_tgid(), returns the next thread group from *tgid on */
+static struct task_struct *taskinfo_next(struct pid_namespace *ns, pid_t *tgid)
+{
+	struct task_struct *task = NULL;
+	struct pid *pid;
+
+	rcu_read_lock();
+	while ((pid = find_ge_pid(*tgid, ns))) {
+		*tgid = pid_nr_ns(pid, ns);
+		task = pid_task(pid, PIDTYPE_TGID);
+		if (task) {
+			get_task_struct(task);
+			break;
+		}
+		*tgid += 1;
+	}
+	rcu_read_unlock();
+	return task;
+}
+
+static bool taskinfo_visible(struct taskinfo_file *f,
+			     struct proc_fs_info *fs_info,
+			     struct task_struct *task)
+{
+	bool ret = true;
+
+	/* The same check as for opening /proc/<pid>/stat */
+	if (!has_pid_permissions(fs_info, task, HIDEPID_NO_ACCESS))
+		return false;
+
+	if (f->cgrp) {
+		rcu_read_lock();
+		ret = task_under_cgroup_hierarchy(task, f->cgrp);
+		rcu_read_unlock();
+	}
+	return ret;
+}
+
+static int taskinfo_fill(struct proc_taskinfo *rec, struct task_struct *task,
+			 struct pid_namespace *ns)
+{
+	struct task_io_accounting acct;
+	struct signal_struct *sig = task->signal;
+	struct task_struct *t = task;
+	struct mm_struct *mm;
+	unsigned long flags;
+	bool permitted;
+	u64 utime, stime;
+	int ret;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->size = sizeof(*rec);
+	rec->pid = task_tgid_nr_ns(task, ns);
+
+	/* Like do_io_accounting(), don't race with a setuid exec */
+	ret = down_read_killable(&sig->exec_update_lock);
+	if (ret)
+		return ret;
+	permitted = ptrace_may_access(task, PTRACE_MODE_READ_FSCREDS |
+					    PTRACE_MODE_NOAUDIT);
+
+	if (!lock_task_sighand(task, &flags)) {
+		up_read(&sig->exec_update_lock);
+		return -ESRCH;
+	}
+
+	rec->num_threads = get_nr_threads(task);
+	rec->ppid = task_tgid_nr_ns(task->real_parent, ns);
+	rec->pgid = task_pgrp_nr_ns(task, ns);
+	rec->sid = task_session_nr_ns(task, ns);
+
+	rec->min_flt = sig->min_flt;
+	rec->maj_flt = sig->maj_flt;
+	rec->nvcsw = sig->nvcsw;
+	rec->nivcsw = sig->nivcsw;
+	acct = sig->ioac;
+	do {
+		rec->min_flt += t->min_flt;
+		rec->maj_flt += t->maj_flt;
+		rec->nvcsw += t->nvcsw;
+		rec->nivcsw += t->nivcsw;
+		task_io_accounting_add(&acct, &t->ioac);
+	} while_each_thread(task, t);
+	thread_group_cputime_adjusted(task, &utime, &stime);
+
+	unlock_task_sighand(task, &flags);
+	up_read(&sig->exec_update_lock);
+
+	rec->utime = utime;
+	rec->stime = stime;
+	if (permitted) {
+		rec->valid |= PROC_TASKINFO_IO;
+		rec->rchar = acct.rchar;
+		rec->wchar = acct.wchar;
+		rec->syscr = acct.syscr;
+		rec->syscw = acct.syscw;
+		rec->read_bytes = acct.read_bytes;
+		rec->write_bytes = acct.write_bytes;
+		rec->cancelled_write_bytes = acct.cancelled_write_bytes;
+	}
+
+	rec->state = *get_task_state(task);
+	rec->flags = task->flags;
+	rec->policy = task->policy;
+	rec->nice = task_nice(task);
+	rec->prio = task_prio(task);
+	rec->processor = task_cpu(task);
+	rec->start_time = timens_add_boottime_ns(task->start_boottime);
+#ifdef CONFIG_CGROUPS
+	rcu_read_lock();
+	rec->cgroup_id = cgroup_id(task_dfl_cgroup(task));
+	rcu_read_unlock();
+#endif
+
+	mm = get_task_mm(task);
+	if (mm) {
+		rec->vsize = task_vsize(mm);
+		rec->rss = get_mm_rss(mm);
+		mmput(mm);
+	}
+	return 0;
+}
+
+static ssize_t taskinfo_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct super_block *sb = file_inode(file)->i_sb;
+	struct pid_namespace *ns = proc_pid_ns(sb);
+	struct proc_fs_info *fs_info = proc_sb_info(sb);
+	struct taskinfo_file *f = file->private_data;
+	struct task_struct *task;
+	struct proc_taskinfo rec;
+	size_t done = 0;
+	ssize_t ret = 0;
+	pid_t tgid;
+
+	if (count < sizeof(rec))
+		return -EINVAL;
+	if (*ppos < 0)
+		return -EINVAL;
+	if (*ppos >= PID_MAX_LIMIT)
+		return 0;
+
+	mutex_lock(&f->lock);
+	for (tgid = *ppos; count - done >= sizeof(rec); tgid++) {
+		task = taskinfo_next(ns, &tgid);
+		if (!task) {
+			tgid = PID_MAX_LIMIT;
+			break;
+		}
+
+		if (taskinfo_visible(f, fs_info, task)) {
+			ret = taskinfo_fill(&rec, task, ns);
+			if (!ret) {
+				if (copy_to_user(buf + done, &rec, sizeof(rec)))
+					ret = -EFAULT;
+				else
+					done += sizeof(rec);
+			} else if (ret == -ESRCH) {
+				/* Exited under us, just skip it */
+				ret = 0;
+			}
+		}
+		put_task_struct(task);
+		if (ret)
+			break;
+		cond_resched();
+	}
+	*ppos = tgid;
+	mutex_unlock(&f->lock);
+
+	return done ? done : ret;
+}
+
+static long taskinfo_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct taskinfo_file *f = file->private_data;
+	struct cgroup *cgrp = NULL;
+	u64 id;
+
+	if (cmd != PROC_TASKINFO_SET_CGROUP)
+		return -ENOTTY;
+	if (copy_from_user(&id, (u64 __user *)arg, sizeof(id)))
+		return -EFAULT;
+
+	if (id) {
+#ifdef CONFIG_CGROUPS
+		cgrp = cgroup_get_from_id(id);
+		if (IS_ERR(cgrp))
+			return PTR_ERR(cgrp);
+#else
+		return -ENOENT;
+#endif
+	}
+
+	mutex_lock(&f->lock);
+	swap(f->cgrp, cgrp);
+	mutex_unlock(&f->lock);
+
+#ifdef CONFIG_CGROUPS
+	if (cgrp)
+		cgroup_put(cgrp);
+#endif
+	return 0;
+}
+
+static int taskinfo_open(struct inode *inode, struct file *file)
+{
+	struct taskinfo_file *f;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return -ENOMEM;
+
+	mutex_init(&f->lock);
+	file->private_data = f;
+	return 0;
+}
+
+static int taskinfo_release(struct inode *inode, struct file *file)
+{
+	struct taskinfo_file *f = file->private_data;
+
+#ifdef CONFIG_CGROUPS
+	if (f->cgrp)
+		cgroup_put(f->cgrp);
+#endif
+	kfree(f);
+	return 0;
+}
+
+static const struct proc_ops taskinfo_proc_ops = {
+	.proc_open		= taskinfo_open,
+	.proc_read		= taskinfo_read,
+	.proc_lseek		= default_llseek,
+	.proc_ioctl		= taskinfo_ioctl,
+#ifdef CONFIG_COMPAT
+	.proc_compat_ioctl	= compat_ptr_ioctl,
+#endif
+	.proc_release		= taskinfo_release,
+};
+
+static int __init proc_taskinfo_init(void)
+{
+	struct proc_dir_entry *pde;
+
+	pde = proc_create("taskinfo", 0444, NULL, &taskinfo_proc_ops);
+	pde_make_permanent(pde);
+	return 0;
+}
+fs_initcall(proc_taskinfo_init);
@@ -19,6 +19,7 @@
 #include <linux/shmem_fs.h>
 #include <linux/uaccess.h>
 #include <linux/pkeys.h>
+#include <linux/compat.h>
 
 #include <asm/elf.h>
 #include <asm/tlb.h>
@@ -768,20 +769,30 @@ static const struct mm_walk_ops smaps_shmem_walk_ops = {
 };
 
 /*
- * Gather mem stats from @vma with the indicated beginning
- * address @start, and keep them in @mss.
+ * Gather mem stats from @vma between the indicated addresses @start and
+ * @end, and keep them in @mss.
  *
- * Use vm_start of @vma as the beginning address if @start is 0.
+ * Use vm_start of @vma as the beginning address if @start is 0, and
+ * vm_end of @vma as the end address if @end is 0.
  */
 static void smap_gather_stats(struct vm_area_struct *vma,
-		struct mem_size_stats *mss, unsigned long start)
+		struct mem_size_stats *mss, unsigned long start,
+		unsigned long end)
 {
 	const struct mm_walk_ops *ops = &smaps_walk_ops;
+	bool whole;
+
+	if (!start)
+		start = vma->vm_start;
+	if (!end || end > vma->vm_end)
+		end = vma->vm_end;
 
 	/* Invalid start */
-	if (start >= vma->vm_end)
+	if (start >= end)
 		return;
 
+	whole = start == vma->vm_start && end == vma->vm_end;
+
 	if (vma->vm_file && shmem_mapping(vma->vm_file->f_mapping)) {
 		/*
 		 * For shared or readonly shmem mappings we know that all
@@ -795,7 +806,7 @@ static void smap_gather_stats(struct vm_area_struct *vma,
 		 */
 		unsigned long shmem_swapped = shmem_swap_usage(vma);
 
-		if (!start && (!shmem_swapped || (vma->vm_flags & VM_SHARED) ||
+		if (whole && (!shmem_swapped || (vma->vm_flags & VM_SHARED) ||
 					!(vma->vm_flags & VM_WRITE))) {
 			mss->swap += shmem_swapped;
 		} else {
@@ -804,10 +815,10 @@ static void smap_gather_stats(struct vm_area_struct *vma,
 	}
 
 	/* mmap_lock is held in m_start */
-	if (!start)
+	if (whole)
 		walk_page_vma(vma, ops, mss);
 	else
-		walk_page_range(vma->vm_mm, start, vma->vm_end, ops, mss);
+		walk_page_range(vma->vm_mm, start, end, ops, mss);
 }
 
 #define SEQ_PUT_DEC(str, val) \
@@ -860,7 +871,7 @@ static int show_smap(struct seq_file *m, void *v)
 
 	memset(&mss, 0, sizeof(mss));
 
-	smap_gather_stats(vma, &mss, 0);
+	smap_gather_stats(vma, &mss, 0, 0);
 
 	show_map_vma(m, vma);
 
@@ -881,6 +892,9 @@ static int show_smap(struct seq_file *m, void *v)
 	return 0;
 }
 
+/* Largest range of a VMA walked before checking for mmap_lock contention */
+#define SMAPS_ROLLUP_CHUNK	(1UL << 30)
+
 static int show_smaps_rollup(struct seq_file *m, void *v)
 {
 	struct proc_maps_private *priv = m->private;
@@ -888,6 +902,7 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 	struct mm_struct *mm = priv->mm;
 	struct vm_area_struct *vma;
 	unsigned long vma_start = 0, last_vma_end = 0;
+	unsigned long addr, end;
 	int ret = 0;
 	VMA_ITERATOR(vmi, mm, 0);
 
@@ -913,16 +928,24 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 		goto empty_set;
 
 	vma_start = vma->vm_start;
-	do {
-		smap_gather_stats(vma, &mss, 0);
-		last_vma_end = vma->vm_end;
+	addr = vma->vm_start;
+	for (;;) {
+		/*
+		 * Walk large VMAs in chunks, so that a writer waiting for
+		 * mmap_lock is not held off for the whole walk of a huge
+		 * mapping.  Chunks are aligned, so that a walk resumed from
+		 * an unaligned address does not split huge pages or page
+		 * tables differently in every round.
+		 */
+		end = min(vma->vm_end, ALIGN(addr + 1, SMAPS_ROLLUP_CHUNK));
+		smap_gather_stats(vma, &mss, addr, end);
+		last_vma_end = end;
 
 		/*
 		 * Release mmap_lock temporarily if someone wants to
 		 * access it for write request.
 		 */
 		if (mmap_lock_is_contended(mm)) {
-			vma_iter_invalidate(&vmi);
 			mmap_read_unlock(mm);
 			ret = mmap_read_lock_killable(mm);
 			if (ret) {
@@ -931,8 +954,8 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 			}
 
 			/*
-			 * After dropping the lock, there are four cases to
-			 * consider. See the following example for explanation.
+			 * After dropping the lock, the VMAs may have changed.
+			 * See the following example for explanation.
 			 *
 			 *   +------+------+-----------+
 			 *   | VMA1 | VMA2 | VMA3      |
@@ -940,46 +963,41 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 			 *   |      |      |           |
 			 *  4k     8k     16k         400k
 			 *
-			 * Suppose we drop the lock after reading VMA2 due to
-			 * contention, then we get:
+			 * Suppose we drop the lock after reading VMA2, or
+			 * after reading VMA3 up to 100k, then we get:
 			 *
-			 *	last_vma_end = 16k
+			 *	last_vma_end = 16k or 100k
 			 *
-			 * 1) VMA2 is freed, but VMA3 exists:
+			 * Look up the VMA containing last_vma_end, or the
+			 * first one after it, and continue from there:
 			 *
-			 *    vma_next(vmi) will return VMA3.
-			 *    In this case, just continue from VMA3.
+			 * 1) No more VMAs can be found: just break.
 			 *
-			 * 2) VMA2 still exists:
+			 * 2) The VMA starts at or after last_vma_end:
+			 *    walk it from its start.
 			 *
-			 *    vma_next(vmi) will return VMA3.
-			 *    In this case, just continue from VMA3.
-			 *
-			 * 3) No more VMAs can be found:
-			 *
-			 *    vma_next(vmi) will return NULL.
-			 *    No more things to do, just break.
-			 *
-			 * 4) (last_vma_end - 1) is the middle of a vma (VMA'):
-			 *
-			 *    vma_next(vmi) will return VMA' whose range
-			 *    contains last_vma_end.
-			 *    Iterate VMA' from last_vma_end.
+			 * 3) last_vma_end is in the middle of the VMA:
+			 *    walk it from last_vma_end.
 			 */
+			vma_iter_set(&vmi, last_vma_end);
 			vma = vma_next(&vmi);
-			/* Case 3 above */
 			if (!vma)
 				break;
 
-			/* Case 1 and 2 above */
-			if (vma->vm_start >= last_vma_end)
-				continue;
+			addr = max(vma->vm_start, last_vma_end);
+			continue;
+		}
 
-			/* Case 4 above */
-			if (vma->vm_end > last_vma_end)
-				smap_gather_stats(vma, &mss, last_vma_end);
+		if (end < vma->vm_end) {
+			addr = end;
+			continue;
 		}
-	} for_each_vma(vmi, vma);
+
+		vma = vma_next(&vmi);
+		if (!vma)
+			break;
+		addr = vma->vm_start;
+	}
 
 empty_set:
 	show_vma_header_prefix(m, vma_start, last_vma_end, 0, 0, 0, 0);
@@ -1744,6 +1762,225 @@ static ssize_t pagemap_read(struct file *file, char __user *buf,
 	return ret;
 }
 
+/* The categories that can be told from a pagemap entry */
+#define PM_SCAN_CATEGORIES	(PAGE_IS_WRITTEN | PAGE_IS_FILE | \
+				 PAGE_IS_PRESENT | PAGE_IS_SWAPPED | \
+				 PAGE_IS_SOFT_DIRTY)
+
+struct pagemap_scan_private {
+	struct pm_scan_arg arg;
+	struct page_region cur;		/* open region, none if cur.end is 0 */
+	struct page_region __user *vec;
+	unsigned long nr;		/* regions copied out to vec */
+	unsigned long nr_pages;		/* pages reported so far */
+};
+
+static u64 pagemap_scan_categories(u64 pme)
+{
+	u64 categories = 0;
+
+	if (pme & PM_PRESENT)
+		categories |= PAGE_IS_PRESENT;
+	if (pme & PM_SWAP)
+		categories |= PAGE_IS_SWAPPED;
+	/* As for userfaultfd, a page is written once it isn't protected */
+	if ((pme & (PM_PRESENT | PM_SWAP)) && !(pme & PM_UFFD_WP))
+		categories |= PAGE_IS_WRITTEN;
+	if (pme & PM_FILE)
+		categories |= PAGE_IS_FILE;
+	if (pme & PM_SOFT_DIRTY)
+		categories |= PAGE_IS_SOFT_DIRTY;
+	return categories;
+}
+
+static bool pagemap_scan_match(struct pagemap_scan_private *ps,
+			       u64 categories)
+{
+	categories ^= ps->arg.category_inverted;
+	if ((categories & ps->arg.category_mask) != ps->arg.category_mask)
+		return false;
+	if (ps->arg.category_anyof_mask &&
+	    !(categories & ps->arg.category_anyof_mask))
+		return false;
+	return true;
+}
+
+static int pagemap_scan_flush(struct pagemap_scan_private *ps)
+{
+	if (!ps->cur.end)
+		return 0;
+
+	if (copy_to_user(&ps->vec[ps->nr], &ps->cur, sizeof(ps->cur)))
+		return -EFAULT;
+	ps->nr++;
+	ps->cur.end = 0;
+	return 0;
+}
+
+/*
+ * Fold the pagemap entries of one walk chunk starting at @addr into
+ * regions. Returns 1 when the output vector is full or max_pages pages
+ * were reported, in which case walk_end is set to the first page that
+ * was not.
+ */
+static int pagemap_scan_chunk(struct pagemap_scan_private *ps,
+			      struct pagemapread *pm, unsigned long addr)
+{
+	u64 categories;
+	int i, ret;
+
+	for (i = 0; i < pm->pos; i++, addr += PAGE_SIZE) {
+		categories = pagemap_scan_categories(pm->buffer[i].pme);
+		if (!pagemap_scan_match(ps, categories)) {
+			ret = pagemap_scan_flush(ps);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		if (ps->arg.max_pages && ps->nr_pages == ps->arg.max_pages) {
+			ps->arg.walk_end = addr;
+			return 1;
+		}
+
+		categories &= ps->arg.return_mask;
+		if (ps->cur.end == addr && ps->cur.categories == categories) {
+			ps->cur.end += PAGE_SIZE;
+			ps->nr_pages++;
+			continue;
+		}
+
+		ret = pagemap_scan_flush(ps);
+		if (ret)
+			return ret;
+		if (ps->nr == ps->arg.vec_len) {
+			ps->arg.walk_end = addr;
+			return 1;
+		}
+		ps->cur.start = addr;
+		ps->cur.end = addr + PAGE_SIZE;
+		ps->cur.categories = categories;
+		ps->nr_pages++;
+	}
+	return 0;
+}
+
+/*
+ * PAGEMAP_SCAN: report the pages of a range which match a set of page
+ * categories as compact regions, instead of one pagemap entry per page.
+ * The range is walked with the pagemap walker, one PMD at a time, and
+ * mmap_lock is only held while a chunk is walked.
+ */
+static long pagemap_scan(struct mm_struct *mm, struct pm_scan_arg __user *uarg)
+{
+	struct pagemap_scan_private ps = { };
+	struct pagemapread pm;
+	unsigned long start, end, next;
+	long ret;
+
+	if (copy_from_user(&ps.arg, uarg, sizeof(ps.arg)))
+		return -EFAULT;
+	if (ps.arg.size != sizeof(ps.arg))
+		return -EINVAL;
+	/* No userfaultfd write-protection from here */
+	if (ps.arg.flags & (PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC))
+		return -EOPNOTSUPP;
+	if (ps.arg.flags ||
+	    (ps.arg.category_inverted | ps.arg.category_mask |
+	     ps.arg.category_anyof_mask | ps.arg.return_mask) &
+	    ~PM_SCAN_CATEGORIES)
+		return -EINVAL;
+	if (!ps.arg.vec_len || !ps.arg.return_mask)
+		return -EINVAL;
+	if (!IS_ALIGNED(ps.arg.start, PAGE_SIZE) ||
+	    !IS_ALIGNED(ps.arg.end, PAGE_SIZE) || ps.arg.start >= ps.arg.end)
+		return -EINVAL;
+	if (ps.arg.vec_len > ULONG_MAX / sizeof(struct page_region))
+		return -EINVAL;
+
+	ps.vec = u64_to_user_ptr(ps.arg.vec);
+	if (!access_ok(ps.vec, ps.arg.vec_len * sizeof(struct page_region)))
+		return -EFAULT;
+
+	if (!mm || !mmget_not_zero(mm))
+		return -ESRCH;
+
+	pm.show_pfn = false;
+	pm.len = (PAGEMAP_WALK_SIZE >> PAGE_SHIFT);
+	pm.buffer = kmalloc_array(pm.len, PM_ENTRY_BYTES, GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!pm.buffer)
+		goto out_mm;
+
+	ret = mmap_read_lock_killable(mm);
+	if (ret)
+		goto out_free;
+	start = untagged_addr_remote(mm, ps.arg.start);
+	end = untagged_addr_remote(mm, ps.arg.end);
+	mmap_read_unlock(mm);
+	if (end > mm->task_size)
+		end = mm->task_size;
+	ps.arg.walk_end = end;
+
+	while (start < end) {
+		next = (start + PAGEMAP_WALK_SIZE) & PAGEMAP_WALK_MASK;
+		/* overflow ? */
+		if (next < start || next > end)
+			next = end;
+
+		pm.pos = 0;
+		ret = mmap_read_lock_killable(mm);
+		if (ret)
+			goto out_free;
+		ret = walk_page_range(mm, start, next, &pagemap_ops, &pm);
+		mmap_read_unlock(mm);
+		if (ret < 0)
+			goto out_free;
+
+		ret = pagemap_scan_chunk(&ps, &pm, start);
+		if (ret < 0)
+			goto out_free;
+		if (ret)
+			break;
+
+		start = next;
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			goto out_free;
+		}
+		cond_resched();
+	}
+
+	/* the vector is never full while a region is still open */
+	ret = pagemap_scan_flush(&ps);
+	if (ret)
+		goto out_free;
+
+	if (put_user(ps.arg.walk_end, &uarg->walk_end))
+		ret = -EFAULT;
+	else
+		ret = ps.nr;
+
+out_free:
+	kfree(pm.buffer);
+out_mm:
+	mmput(mm);
+	return ret;
+}
+
+static long pagemap_ioctl(struct file *file, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct mm_struct *mm = file->private_data;
+
+	switch (cmd) {
+	case PAGEMAP_SCAN:
+		return pagemap_scan(mm, (struct pm_scan_arg __user *)arg);
+	default:
+		return -EINVAL;
+	}
+}
+
 static int pagemap_open(struct inode *inode, struct file *file)
 {
 	struct mm_struct *mm;
@@ -1769,6 +2006,8 @@ const struct file_operations proc_pagemap_operations = {
 	.read		= pagemap_read,
 	.open		= pagemap_open,
 	.release	= pagemap_release,
+	.unlocked_ioctl	= pagemap_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
 };
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
@@ -20,6 +20,7 @@
 #include <linux/string.h>
 #include <linux/buffer_head.h>
 #include <linux/bio.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -234,3 +235,183 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 
 	return res;
 }
+
+/*
+ * Batched datablock reads for readahead: a run of datablocks which are
+ * consecutive on disk is read with one bio, and each block is then
+ * decompressed from its slice of that bio.  All but the first block are
+ * handed to workqueue workers, so that several blocks are decompressed
+ * at the same time on different CPUs (and with the percpu decompressor,
+ * different streams).
+ *
+ * The workers run in the page cache read path, possibly on behalf of
+ * reclaim, so they get their own WQ_MEM_RECLAIM workqueue.
+ */
+static struct workqueue_struct *squashfs_batch_wq;
+
+int __init squashfs_init_batch_wq(void)
+{
+	squashfs_batch_wq = alloc_workqueue("squashfs_batch",
+					    WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	return squashfs_batch_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_destroy_batch_wq(void)
+{
+	destroy_workqueue(squashfs_batch_wq);
+}
+
+struct squashfs_batch_block {
+	struct work_struct work;
+	struct squashfs_sb_info *msblk;
+	struct bio *bio;
+	int offset;
+	int length;
+	int compressed;
+	struct squashfs_page_actor *output;
+	int res;
+};
+
+/*
+ * Build a bio referencing the pages of @bio which hold @length bytes
+ * starting at @start (relative to the start of the data in @bio).  The
+ * pages stay owned by @bio.
+ */
+static struct bio *squashfs_bio_slice(struct bio *bio, int start, int length,
+				      int *offset)
+{
+	struct bvec_iter_all iter_all = {};
+	struct bio_vec *bvec = bvec_init_iter_all(&iter_all);
+	const int nr_segs = DIV_ROUND_UP(length, PAGE_SIZE) + 1;
+	struct bio *slice;
+	int pos = 0;
+
+	slice = bio_kmalloc(nr_segs, GFP_NOIO);
+	if (!slice)
+		return NULL;
+	bio_init(slice, NULL, slice->bi_inline_vecs, nr_segs, REQ_OP_READ);
+
+	while (pos < start + length && bio_next_segment(bio, &iter_all)) {
+		if (pos + bvec->bv_len > start) {
+			if (!slice->bi_vcnt)
+				*offset = start - pos;
+			if (WARN_ON_ONCE(slice->bi_vcnt >= nr_segs))
+				break;
+			__bio_add_page(slice, bvec->bv_page, bvec->bv_len,
+				       bvec->bv_offset);
+		}
+		pos += bvec->bv_len;
+	}
+
+	if (pos < start + length) {
+		bio_uninit(slice);
+		kfree(slice);
+		return NULL;
+	}
+	return slice;
+}
+
+static void squashfs_decompress_batch_block(struct squashfs_batch_block *blk)
+{
+	struct squashfs_sb_info *msblk = blk->msblk;
+
+	if (!blk->compressed)
+		blk->res = copy_bio_to_actor(blk->bio, blk->output,
+					     blk->offset, blk->length);
+	else if (!msblk->stream)
+		blk->res = -EIO;
+	else
+		blk->res = msblk->thread_ops->decompress(msblk, blk->bio,
+				blk->offset, blk->length, blk->output);
+}
+
+static void squashfs_decompress_batch_work(struct work_struct *work)
+{
+	squashfs_decompress_batch_block(container_of(work,
+				struct squashfs_batch_block, work));
+}
+
+/*
+ * Read and decompress @nr datablocks, stored back to back starting at
+ * @index with the (on-disk encoded) lengths in @lengths.  The result for
+ * each block is returned in @res, as squashfs_read_data() would return it.
+ */
+void squashfs_read_data_batch(struct super_block *sb, u64 index, int nr,
+			      const int *lengths,
+			      struct squashfs_page_actor **outputs, int *res)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_batch_block *blks;
+	struct bio *bio = NULL;
+	int i, err, offset, total = 0;
+
+	blks = kcalloc(nr, sizeof(*blks), GFP_NOIO);
+	if (!blks) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		blks[i].compressed = SQUASHFS_COMPRESSED_BLOCK(lengths[i]);
+		blks[i].length = SQUASHFS_COMPRESSED_SIZE_BLOCK(lengths[i]);
+		if (blks[i].length > outputs[i]->length) {
+			err = -EIO;
+			goto out;
+		}
+		total += blks[i].length;
+	}
+	if (index + total > msblk->bytes_used) {
+		err = -EIO;
+		goto out;
+	}
+
+	err = squashfs_bio_read(sb, index, total, &bio, &offset);
+	if (err)
+		goto out;
+
+	for (i = 0; i < nr; i++) {
+		struct squashfs_batch_block *blk = &blks[i];
+
+		blk->msblk = msblk;
+		blk->output = outputs[i];
+		blk->bio = squashfs_bio_slice(bio, offset, blk->length,
+					      &blk->offset);
+		offset += blk->length;
+		if (!blk->bio) {
+			blk->res = -ENOMEM;
+			continue;
+		}
+		INIT_WORK(&blk->work, squashfs_decompress_batch_work);
+		if (i)
+			queue_work(squashfs_batch_wq, &blk->work);
+	}
+
+	/* the first block is done by the reader itself */
+	if (blks[0].bio)
+		squashfs_decompress_batch_block(&blks[0]);
+
+	for (i = 0; i < nr; i++) {
+		if (!blks[i].bio)
+			continue;
+		if (i)
+			flush_work(&blks[i].work);
+		bio_uninit(blks[i].bio);
+		kfree(blks[i].bio);
+	}
+
+	bio_free_pages(bio);
+	bio_uninit(bio);
+	kfree(bio);
+out:
+	for (i = 0; i < nr; i++) {
+		res[i] = err ?: blks[i].res;
+		if (res[i] < 0) {
+			ERROR("Failed to read block 0x%llx: %d\n", index, res[i]);
+			if (msblk->panic_on_errors)
+				panic("squashfs read failed");
+		}
+		if (!err)
+			index += blks[i].length;
+	}
+	kfree(blks);
+}
@@ -34,6 +34,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/bio.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -533,6 +534,75 @@ static int squashfs_readahead_fragment(struct page **page,
 	return error;
 }
 
+static void squashfs_readahead_done(struct page **pages, unsigned int nr_pages,
+	int res, unsigned int expected, struct page *last_page, bool file_end)
+{
+	int i;
+
+	if (res == expected) {
+		int bytes;
+
+		/* Last page (if present) may have trailing bytes not filled */
+		bytes = res % PAGE_SIZE;
+		if (file_end && bytes && last_page)
+			memzero_page(last_page, bytes, PAGE_SIZE - bytes);
+
+		for (i = 0; i < nr_pages; i++) {
+			flush_dcache_page(pages[i]);
+			SetPageUptodate(pages[i]);
+		}
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		unlock_page(pages[i]);
+		put_page(pages[i]);
+	}
+}
+
+/*
+ * Datablocks collected by readahead to be read with one bio and decompressed
+ * in parallel, see the "readahead_blocks" mount option.
+ */
+struct squashfs_ra_batch {
+	int nr;
+	u64 start, next;
+	int total;
+	struct {
+		struct page **pages;
+		unsigned int nr_pages;
+		unsigned int expected;
+		bool file_end;
+	} blk[SQUASHFS_MAX_RA_BLOCKS];
+	int bsize[SQUASHFS_MAX_RA_BLOCKS];
+	struct squashfs_page_actor *actor[SQUASHFS_MAX_RA_BLOCKS];
+	int res[SQUASHFS_MAX_RA_BLOCKS];
+};
+
+/* keep the whole batch within what squashfs_bio_read() can put in one bio */
+#define SQUASHFS_RA_MAX_BYTES	((BIO_MAX_VECS - 2) << PAGE_SHIFT)
+
+static void squashfs_readahead_flush(struct super_block *sb,
+				     struct squashfs_ra_batch *batch)
+{
+	int i;
+
+	if (!batch->nr)
+		return;
+
+	squashfs_read_data_batch(sb, batch->start, batch->nr, batch->bsize,
+				 batch->actor, batch->res);
+
+	for (i = 0; i < batch->nr; i++) {
+		struct page *last_page = squashfs_page_actor_free(batch->actor[i]);
+
+		squashfs_readahead_done(batch->blk[i].pages,
+					batch->blk[i].nr_pages, batch->res[i],
+					batch->blk[i].expected, last_page,
+					batch->blk[i].file_end);
+	}
+	batch->nr = 0;
+}
+
 static void squashfs_readahead(struct readahead_control *ractl)
 {
 	struct inode *inode = ractl->mapping->host;
@@ -542,16 +612,32 @@ static void squashfs_readahead(struct readahead_control *ractl)
 	loff_t start = readahead_pos(ractl) & ~mask;
 	size_t len = readahead_length(ractl) + readahead_pos(ractl) - start;
 	struct squashfs_page_actor *actor;
+	struct squashfs_ra_batch *batch = NULL;
 	unsigned int nr_pages = 0;
-	struct page **pages;
+	struct page **pages, **allpages;
 	int i, file_end = i_size_read(inode) >> msblk->block_log;
 	unsigned int max_pages = 1UL << shift;
+	unsigned int block_pages = max_pages;
+	int nr_blocks = 1;
 
 	readahead_expand(ractl, start, (len | mask) + 1);
 
-	pages = kmalloc_array(max_pages, sizeof(void *), GFP_KERNEL);
-	if (!pages)
+	if (msblk->readahead_blocks > 1 &&
+	    readahead_length(ractl) > msblk->block_size) {
+		batch = kmalloc(sizeof(*batch), GFP_KERNEL);
+		if (batch) {
+			batch->nr = 0;
+			nr_blocks = msblk->readahead_blocks;
+		}
+	}
+
+	allpages = kmalloc_array(block_pages * nr_blocks, sizeof(void *),
+				 GFP_KERNEL);
+	if (!allpages) {
+		kfree(batch);
 		return;
+	}
+	pages = allpages;
 
 	for (;;) {
 		pgoff_t index;
@@ -566,6 +652,8 @@ static void squashfs_readahead(struct readahead_control *ractl)
 
 		max_pages = (expected + PAGE_SIZE - 1) >> PAGE_SHIFT;
 
+		if (batch)
+			pages = allpages + batch->nr * block_pages;
 		nr_pages = __readahead_batch(ractl, pages, max_pages);
 		if (!nr_pages)
 			break;
@@ -591,37 +679,53 @@ static void squashfs_readahead(struct readahead_control *ractl)
 		if (bsize == 0)
 			goto skip_pages;
 
+		/* only blocks which follow each other on disk are batched */
+		if (batch && batch->nr && (block != batch->next ||
+		    batch->total + SQUASHFS_COMPRESSED_SIZE_BLOCK(bsize) >
+				SQUASHFS_RA_MAX_BYTES)) {
+			struct page **cur = pages;
+
+			squashfs_readahead_flush(inode->i_sb, batch);
+			pages = allpages;
+			memmove(pages, cur, nr_pages * sizeof(struct page *));
+		}
+
 		actor = squashfs_page_actor_init_special(msblk, pages, nr_pages,
 							 expected);
 		if (!actor)
 			goto skip_pages;
 
+		if (batch) {
+			if (!batch->nr) {
+				batch->start = block;
+				batch->total = 0;
+			}
+			batch->blk[batch->nr].pages = pages;
+			batch->blk[batch->nr].nr_pages = nr_pages;
+			batch->blk[batch->nr].expected = expected;
+			batch->blk[batch->nr].file_end = index == file_end;
+			batch->bsize[batch->nr] = bsize;
+			batch->actor[batch->nr] = actor;
+			batch->next = block + SQUASHFS_COMPRESSED_SIZE_BLOCK(bsize);
+			batch->total += SQUASHFS_COMPRESSED_SIZE_BLOCK(bsize);
+			if (++batch->nr == nr_blocks)
+				squashfs_readahead_flush(inode->i_sb, batch);
+			continue;
+		}
+
 		res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
 
 		last_page = squashfs_page_actor_free(actor);
 
-		if (res == expected) {
-			int bytes;
-
-			/* Last page (if present) may have trailing bytes not filled */
-			bytes = res % PAGE_SIZE;
-			if (index == file_end && bytes && last_page)
-				memzero_page(last_page, bytes,
-					     PAGE_SIZE - bytes);
-
-			for (i = 0; i < nr_pages; i++) {
-				flush_dcache_page(pages[i]);
-				SetPageUptodate(pages[i]);
-			}
-		}
-
-		for (i = 0; i < nr_pages; i++) {
-			unlock_page(pages[i]);
-			put_page(pages[i]);
-		}
+		squashfs_readahead_done(pages, nr_pages, res, expected,
+					last_page, index == file_end);
 	}
 
-	kfree(pages);
+	if (batch) {
+		squashfs_readahead_flush(inode->i_sb, batch);
+		kfree(batch);
+	}
+	kfree(allpages);
 	return;
 
 skip_pages:
@@ -629,7 +733,11 @@ static void squashfs_readahead(struct readahead_control *ractl)
 		unlock_page(pages[i]);
 		put_page(pages[i]);
 	}
-	kfree(pages);
+	if (batch) {
+		squashfs_readahead_flush(inode->i_sb, batch);
+		kfree(batch);
+	}
+	kfree(allpages);
 }
 
 const struct address_space_operations squashfs_aops = {
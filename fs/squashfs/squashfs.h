@@ -17,6 +17,11 @@
 /* block.c */
 extern int squashfs_read_data(struct super_block *, u64, int, u64 *,
 				struct squashfs_page_actor *);
+extern void squashfs_read_data_batch(struct super_block *, u64, int,
+				const int *, struct squashfs_page_actor **,
+				int *);
+extern int squashfs_init_batch_wq(void);
+extern void squashfs_destroy_batch_wq(void);
 
 /* cache.c */
 extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
@@ -40,6 +40,9 @@ struct squashfs_cache_entry {
 	struct squashfs_page_actor	*actor;
 };
 
+/* upper limit of the "readahead_blocks" mount option */
+#define SQUASHFS_MAX_RA_BLOCKS	16
+
 struct squashfs_sb_info {
 	const struct squashfs_decompressor	*decompressor;
 	int					devblksize;
@@ -68,5 +71,6 @@ struct squashfs_sb_info {
 	bool					panic_on_errors;
 	const struct squashfs_decompressor_thread_ops *thread_ops;
 	int					max_thread_num;
+	unsigned int				readahead_blocks;
 };
 #endif
@@ -48,12 +48,14 @@ enum Opt_errors {
 enum squashfs_param {
 	Opt_errors,
 	Opt_threads,
+	Opt_readahead_blocks,
 };
 
 struct squashfs_mount_opts {
 	enum Opt_errors errors;
 	const struct squashfs_decompressor_thread_ops *thread_ops;
 	int thread_num;
+	unsigned int readahead_blocks;
 };
 
 static const struct constant_table squashfs_param_errors[] = {
@@ -65,6 +67,7 @@ static const struct constant_table squashfs_param_errors[] = {
 static const struct fs_parameter_spec squashfs_fs_parameters[] = {
 	fsparam_enum("errors", Opt_errors, squashfs_param_errors),
 	fsparam_string("threads", Opt_threads),
+	fsparam_u32("readahead_blocks", Opt_readahead_blocks),
 	{}
 };
 
@@ -142,6 +145,12 @@ static int squashfs_parse_param(struct fs_context *fc, struct fs_parameter *para
 		if (squashfs_parse_param_threads(param->string, opts) != 0)
 			return -EINVAL;
 		break;
+	case Opt_readahead_blocks:
+		if (result.uint_32 > SQUASHFS_MAX_RA_BLOCKS)
+			return invalfc(fc, "readahead_blocks must be at most %d",
+				       SQUASHFS_MAX_RA_BLOCKS);
+		opts->readahead_blocks = result.uint_32;
+		break;
 	default:
 		return -EINVAL;
 	}
@@ -200,6 +209,7 @@ static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 	msblk->thread_ops = opts->thread_ops;
 
 	msblk->panic_on_errors = (opts->errors == Opt_errors_panic);
+	msblk->readahead_blocks = opts->readahead_blocks;
 
 	msblk->devblksize = sb_min_blocksize(sb, SQUASHFS_DEVBLK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
@@ -480,6 +490,7 @@ static int squashfs_reconfigure(struct fs_context *fc)
 	fc->sb_flags |= SB_RDONLY;
 
 	msblk->panic_on_errors = (opts->errors == Opt_errors_panic);
+	msblk->readahead_blocks = opts->readahead_blocks;
 
 	return 0;
 }
@@ -505,6 +516,8 @@ static int squashfs_show_options(struct seq_file *s, struct dentry *root)
 		seq_puts(s, ",errors=panic");
 	else
 		seq_puts(s, ",errors=continue");
+	if (msblk->readahead_blocks > 1)
+		seq_printf(s, ",readahead_blocks=%u", msblk->readahead_blocks);
 
 #ifdef CONFIG_SQUASHFS_CHOICE_DECOMP_BY_MOUNT
 	if (msblk->thread_ops == &squashfs_decompressor_single) {
@@ -623,8 +636,15 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_init_batch_wq();
+	if (err) {
+		destroy_inodecache();
+		return err;
+	}
+
 	err = register_filesystem(&squashfs_fs_type);
 	if (err) {
+		squashfs_destroy_batch_wq();
 		destroy_inodecache();
 		return err;
 	}
@@ -638,6 +658,7 @@ static int __init init_squashfs_fs(void)
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_destroy_batch_wq();
 	destroy_inodecache();
 }
 
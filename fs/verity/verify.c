@@ -110,20 +110,43 @@ static bool is_hash_block_verified(struct fsverity_info *vi, struct page *hpage,
 	return verified;
 }
 
+/*
+ * The last verified leaf hash block, kept referenced while verifying the data
+ * blocks of a folio.  Consecutive data blocks mostly share their leaf hash
+ * block, so this avoids looking it up and checking it again for each block.
+ */
+struct fsverity_leaf {
+	/* Page containing the hash block, or NULL */
+	struct page *page;
+	/* Index of the hash block in the tree overall */
+	unsigned long index;
+};
+
+static void keep_leaf(struct fsverity_leaf *leaf, struct page *hpage,
+		      unsigned long hblock_idx)
+{
+	if (leaf->page)
+		put_page(leaf->page);
+	leaf->page = hpage;
+	leaf->index = hblock_idx;
+}
+
 /*
  * Verify a single data block against the file's Merkle tree.
  *
  * In principle, we need to verify the entire path to the root node.  However,
  * for efficiency the filesystem may cache the hash blocks.  Therefore we need
  * only ascend the tree until an already-verified hash block is seen, and then
- * verify the path to that block.
+ * verify the path to that block.  If the leaf hash block is the one in @leaf,
+ * it has already been verified and the tree doesn't need to be walked at all.
  *
  * Return: %true if the data block is valid, else %false.
  */
 static bool
 verify_data_block(struct inode *inode, struct fsverity_info *vi,
-		  struct ahash_request *req, struct page *data_page,
-		  u64 data_pos, unsigned int dblock_offset_in_page,
+		  struct ahash_request *req, struct fsverity_leaf *leaf,
+		  struct page *data_page, u64 data_pos,
+		  unsigned int dblock_offset_in_page,
 		  unsigned long max_ra_pages)
 {
 	const struct merkle_tree_params *params = &vi->tree_params;
@@ -163,12 +186,25 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 				      dblock_offset_in_page);
 	}
 
+	level = 0;
+	if (leaf->page && leaf->index ==
+	    params->level_start[0] + (hidx >> params->log_arity)) {
+		unsigned int hoffset =
+			((leaf->index << params->log_blocksize) & ~PAGE_MASK) +
+			((hidx << params->log_digestsize) &
+			 (params->block_size - 1));
+
+		memcpy_from_page(_want_hash, leaf->page, hoffset, hsize);
+		want_hash = _want_hash;
+		goto descend;
+	}
+
 	/*
 	 * Starting at the leaf level, ascend the tree saving hash blocks along
 	 * the way until we find a hash block that has already been verified, or
 	 * until we reach the root.
 	 */
-	for (level = 0; level < params->num_levels; level++) {
+	for (; level < params->num_levels; level++) {
 		unsigned long next_hidx;
 		unsigned long hblock_idx;
 		pgoff_t hpage_idx;
@@ -210,7 +246,10 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 		if (is_hash_block_verified(vi, hpage, hblock_idx)) {
 			memcpy_from_page(_want_hash, hpage, hoffset, hsize);
 			want_hash = _want_hash;
-			put_page(hpage);
+			if (level == 0)
+				keep_leaf(leaf, hpage, hblock_idx);
+			else
+				put_page(hpage);
 			goto descend;
 		}
 		hblocks[level].page = hpage;
@@ -248,7 +287,10 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 			SetPageChecked(hpage);
 		memcpy_from_page(_want_hash, hpage, hoffset, hsize);
 		want_hash = _want_hash;
-		put_page(hpage);
+		if (level == 1)
+			keep_leaf(leaf, hpage, hblock_idx);
+		else
+			put_page(hpage);
 	}
 
 	/* Finally, verify the data block. */
@@ -271,6 +313,8 @@ verify_data_blocks(struct inode *inode, struct fsverity_info *vi,
 {
 	const unsigned int block_size = vi->tree_params.block_size;
 	u64 pos = (u64)data_folio->index << PAGE_SHIFT;
+	struct fsverity_leaf leaf = {};
+	bool valid = true;
 
 	if (WARN_ON_ONCE(len <= 0 || !IS_ALIGNED(len | offset, block_size)))
 		return false;
@@ -281,13 +325,19 @@ verify_data_blocks(struct inode *inode, struct fsverity_info *vi,
 		struct page *data_page =
 			folio_page(data_folio, offset >> PAGE_SHIFT);
 
-		if (!verify_data_block(inode, vi, req, data_page, pos + offset,
-				       offset & ~PAGE_MASK, max_ra_pages))
-			return false;
+		if (!verify_data_block(inode, vi, req, &leaf, data_page,
+				       pos + offset, offset & ~PAGE_MASK,
+				       max_ra_pages)) {
+			valid = false;
+			break;
+		}
 		offset += block_size;
 		len -= block_size;
 	} while (len);
-	return true;
+
+	if (leaf.page)
+		put_page(leaf.page);
+	return valid;
 }
 
 /**
@@ -16,6 +16,7 @@
 #include "xfs_qm.h"
 #include "xfs_errortag.h"
 #include "xfs_error.h"
+#include "xfs_pwork.h"
 #include "xfs_scrub.h"
 #include "scrub/scrub.h"
 #include "scrub/common.h"
@@ -114,6 +115,14 @@
  * second check evaluates the completeness of the repair; that is what
  * is reported to userspace.
  *
+ * Scrubbing a whole filesystem one ioctl call at a time serializes all
+ * the per-AG checks in the caller.  Because each per-AG scrubber only
+ * locks the headers of its own AG (and cross-references in increasing
+ * AG order), the same object can be checked in different AGs at the
+ * same time.  A per-AG scrub request with sm_agno set to NULLAGNUMBER
+ * therefore checks that object in every AG, with the AGs handed out to
+ * a pool of worker threads.
+ *
  * A quick note on symbol prefixes:
  * - "xfs_" are general XFS symbols.
  * - "xchk_" are symbols related to metadata checking.
@@ -455,6 +464,111 @@ static inline void xchk_postmortem(struct xfs_scrub *sc)
 }
 #endif /* CONFIG_XFS_ONLINE_REPAIR */
 
+struct xchk_all_ags {
+	struct xfs_pwork_ctl		pctl;
+	struct file			*file;
+	struct task_struct		*caller;
+	struct xfs_scrub_metadata	*sm;
+	atomic_t			nr_done;
+	atomic_t			oflags;
+};
+
+struct xchk_ag_work {
+	struct xfs_pwork		pwork;
+	struct xchk_all_ags		*aa;
+	xfs_agnumber_t			agno;
+};
+
+/* Scrub one AG on behalf of xchk_scrub_all_ags(). */
+static int
+xchk_ag_worker(
+	struct xfs_mount		*mp,
+	struct xfs_pwork		*pwork)
+{
+	struct xchk_ag_work		*aw;
+	struct xchk_all_ags		*aa;
+	struct xfs_scrub_metadata	sm;
+	__u32				oflags;
+	int				error;
+
+	aw = container_of(pwork, struct xchk_ag_work, pwork);
+	aa = aw->aa;
+
+	/* Stop if another AG failed or the caller is being killed. */
+	if (xfs_pwork_want_abort(pwork))
+		return 0;
+	if (fatal_signal_pending(aa->caller))
+		return -EINTR;
+
+	sm = *aa->sm;
+	sm.sm_agno = aw->agno;
+	error = xfs_scrub_metadata(aa->file, &sm);
+	if (error)
+		return error;
+
+	oflags = sm.sm_flags & XFS_SCRUB_FLAGS_OUT;
+	atomic_or(oflags, &aa->oflags);
+	trace_xchk_ags_progress(mp, sm.sm_type, aw->agno,
+			atomic_inc_return(&aa->nr_done), oflags);
+	return 0;
+}
+
+/*
+ * Check one type of per-AG metadata in every AG.  The AGs are spread over
+ * an xfs_pwork pool sized for the data device, whose max_active can be
+ * lowered through the workqueue's sysfs directory to throttle the scan.
+ * The output flags are the OR of those of all AGs, and each AG is reported
+ * by the xchk_ags_progress tracepoint as it finishes.  The first error
+ * stops the scan.  Repairs are still done one AG at a time.
+ */
+static int
+xchk_scrub_all_ags(
+	struct file			*file,
+	struct xfs_scrub_metadata	*sm)
+{
+	struct xfs_mount		*mp = XFS_I(file_inode(file))->i_mount;
+	struct xfs_scrub_metadata	probe = *sm;
+	struct xchk_ag_work		*aws;
+	struct xchk_all_ags		aa = {
+		.file			= file,
+		.caller			= current,
+		.sm			= sm,
+	};
+	xfs_agnumber_t			agno;
+	int				error;
+
+	/* Validate everything but the AG number up front. */
+	probe.sm_agno = 0;
+	error = xchk_validate_inputs(mp, &probe);
+	if (error)
+		return error;
+	if (probe.sm_flags & XFS_SCRUB_IFLAG_REPAIR)
+		return -EINVAL;
+	sm->sm_flags = probe.sm_flags;
+
+	aws = kvcalloc(mp->m_sb.sb_agcount, sizeof(*aws), XCHK_GFP_FLAGS);
+	if (!aws)
+		return -ENOMEM;
+
+	error = xfs_pwork_init(mp, &aa.pctl, xchk_ag_worker, "xfs_scrub");
+	if (error)
+		goto out_free;
+
+	for (agno = 0; agno < mp->m_sb.sb_agcount; agno++) {
+		if (xfs_pwork_ctl_want_abort(&aa.pctl))
+			break;
+		aws[agno].aa = &aa;
+		aws[agno].agno = agno;
+		xfs_pwork_queue(&aa.pctl, &aws[agno].pwork);
+	}
+	xfs_pwork_poll(&aa.pctl);
+	error = xfs_pwork_destroy(&aa.pctl);
+	sm->sm_flags |= atomic_read(&aa.oflags);
+out_free:
+	kvfree(aws);
+	return error;
+}
+
 /* Dispatch metadata scrubbing. */
 int
 xfs_scrub_metadata(
@@ -478,6 +592,12 @@ xfs_scrub_metadata(
 	if (xfs_has_norecovery(mp))
 		goto out;
 
+	if (sm->sm_agno == NULLAGNUMBER && sm->sm_type < XFS_SCRUB_TYPE_NR &&
+	    meta_scrub_ops[sm->sm_type].type == ST_PERAG) {
+		error = xchk_scrub_all_ags(file, sm);
+		goto out;
+	}
+
 	error = xchk_validate_inputs(mp, sm);
 	if (error)
 		goto out;
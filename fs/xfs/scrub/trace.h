@@ -175,6 +175,33 @@ DEFINE_EVENT(xchk_fsgate_class, name, \
 DEFINE_SCRUB_FSHOOK_EVENT(xchk_fsgates_enable);
 DEFINE_SCRUB_FSHOOK_EVENT(xchk_fsgates_disable);
 
+TRACE_EVENT(xchk_ags_progress,
+	TP_PROTO(struct xfs_mount *mp, unsigned int type, xfs_agnumber_t agno,
+		 unsigned int nr_done, unsigned int flags),
+	TP_ARGS(mp, type, agno, nr_done, flags),
+	TP_STRUCT__entry(
+		__field(dev_t, dev)
+		__field(unsigned int, type)
+		__field(xfs_agnumber_t, agno)
+		__field(unsigned int, nr_done)
+		__field(xfs_agnumber_t, agcount)
+		__field(unsigned int, flags)
+	),
+	TP_fast_assign(
+		__entry->dev = mp->m_super->s_dev;
+		__entry->type = type;
+		__entry->agno = agno;
+		__entry->nr_done = nr_done;
+		__entry->agcount = mp->m_sb.sb_agcount;
+		__entry->flags = flags;
+	),
+	TP_printk("dev %d:%d type %s agno 0x%x done %u/%u flags (%s)",
+		  MAJOR(__entry->dev), MINOR(__entry->dev),
+		  __print_symbolic(__entry->type, XFS_SCRUB_TYPE_STRINGS),
+		  __entry->agno, __entry->nr_done, __entry->agcount,
+		  __print_flags(__entry->flags, "|", XFS_SCRUB_FLAG_STRINGS))
+);
+
 TRACE_EVENT(xchk_op_error,
 	TP_PROTO(struct xfs_scrub *sc, xfs_agnumber_t agno,
 		 xfs_agblock_t bno, int error, void *ret_ip),
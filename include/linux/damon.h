@@ -76,6 +76,8 @@ struct damon_target {
 	unsigned int nr_regions;
 	struct list_head regions_list;
 	struct list_head list;
+/* private: Access check worker the target is assigned to. */
+	unsigned int worker;
 };
 
 /**
@@ -110,12 +112,52 @@ enum damos_action {
 	NR_DAMOS_ACTIONS,
 };
 
+/**
+ * enum damos_quota_goal_metric - Represents the metric of a quota goal.
+ *
+ * @DAMOS_QUOTA_GOAL_NONE:	No goal, the quota is static.
+ * @DAMOS_QUOTA_USER_INPUT:	User-input value.
+ * @DAMOS_QUOTA_SOME_MEM_PSI_US: System level some memory PSI in us.
+ * @DAMOS_QUOTA_FREE_MEM_BP:	Free memory ratio in basis points.
+ * @NR_DAMOS_QUOTA_GOAL_METRICS: Number of quota goal metrics.
+ */
+enum damos_quota_goal_metric {
+	DAMOS_QUOTA_GOAL_NONE,
+	DAMOS_QUOTA_USER_INPUT,
+	DAMOS_QUOTA_SOME_MEM_PSI_US,
+	DAMOS_QUOTA_FREE_MEM_BP,
+	NR_DAMOS_QUOTA_GOAL_METRICS,
+};
+
+/**
+ * struct damos_quota_goal - Represents the goal of a quota auto-tuning.
+ * @metric:		Metric to be used for representing the goal.
+ * @target_value:	Target value of @metric to achieve with the tuning.
+ * @current_value:	Current value of @metric.
+ *
+ * The value of the metric is read every &damos_quota->reset_interval, except
+ * for &DAMOS_QUOTA_USER_INPUT, whose @current_value should be set by the user.
+ * For &DAMOS_QUOTA_SOME_MEM_PSI_US, it is the time some tasks were stalled
+ * for memory during the last interval.
+ */
+struct damos_quota_goal {
+	enum damos_quota_goal_metric metric;
+	unsigned long target_value;
+	unsigned long current_value;
+/* private: */
+	/* PSI total at the previous reset interval */
+	u64 last_psi_total;
+};
+
 /**
  * struct damos_quota - Controls the aggressiveness of the given scheme.
  * @ms:			Maximum milliseconds that the scheme can use.
  * @sz:			Maximum bytes of memory that the action can be applied.
  * @reset_interval:	Charge reset interval in milliseconds.
  *
+ * @goal:		Goal to tune the size quota for.
+ * @min_sz:		Minimum bytes of the size quota tuned for @goal.
+ *
  * @weight_sz:		Weight of the region's size for prioritization.
  * @weight_nr_accesses:	Weight of the region's nr_accesses for prioritization.
  * @weight_age:		Weight of the region's age for prioritization.
@@ -132,6 +174,13 @@ enum damos_action {
  * throughput of the scheme's action.  DAMON then compares it against &sz and
  * uses smaller one as the effective quota.
  *
+ * If @goal has a metric, DAMON also tunes the size quota every
+ * &reset_interval with a feedback loop.  While &damos_quota_goal.current_value
+ * is below &damos_quota_goal.target_value, the quota is increased in
+ * proportion to the distance to the target, and it is decreased in the same
+ * way while the current value is above the target.  The tuned quota is kept
+ * within @min_sz and, if they are set, the &ms and &sz quotas.
+ *
  * For selecting regions within the quota, DAMON prioritizes current scheme's
  * target memory regions using the &struct damon_operations->get_scheme_score.
  * You could customize the prioritization logic by setting &weight_sz,
@@ -143,6 +192,9 @@ struct damos_quota {
 	unsigned long sz;
 	unsigned long reset_interval;
 
+	struct damos_quota_goal goal;
+	unsigned long min_sz;
+
 	unsigned int weight_sz;
 	unsigned int weight_nr_accesses;
 	unsigned int weight_age;
@@ -153,6 +205,7 @@ struct damos_quota {
 	unsigned long total_charged_ns;
 
 	unsigned long esz;	/* Effective size quota in bytes */
+	unsigned long esz_bp;	/* Goal tuned size quota in 1/10000 bytes */
 
 	/* For charging the quota */
 	unsigned long charged_sz;
@@ -344,6 +397,8 @@ struct damon_ctx;
  * @update:			Update operations-related data structures.
  * @prepare_access_checks:	Prepare next access check of target regions.
  * @check_accesses:		Check the accesses to target regions.
+ * @prepare_access_checks_target: Prepare next access check of a target.
+ * @check_accesses_target:	Check the accesses to a target's regions.
  * @reset_aggregated:		Reset aggregated accesses monitoring results.
  * @get_scheme_score:		Get the score of a region for a scheme.
  * @apply_scheme:		Apply a DAMON-based operation scheme.
@@ -372,6 +427,11 @@ struct damon_ctx;
  * last preparation and update the number of observed accesses of each region.
  * It should also return max number of observed accesses that made as a result
  * of its update.  The value will be used for regions adjustment threshold.
+ * @prepare_access_checks_target and @check_accesses_target are optional and do
+ * the same for a single target.  If both are set and &damon_attrs.nr_workers
+ * is larger than one, @kdamond calls them for different targets in parallel
+ * from its access check workers instead of calling @prepare_access_checks and
+ * @check_accesses.
  * @reset_aggregated should reset the access monitoring results that aggregated
  * by @check_accesses.
  * @get_scheme_score should return the priority score of a region for a scheme
@@ -390,6 +450,10 @@ struct damon_operations {
 	void (*update)(struct damon_ctx *context);
 	void (*prepare_access_checks)(struct damon_ctx *context);
 	unsigned int (*check_accesses)(struct damon_ctx *context);
+	void (*prepare_access_checks_target)(struct damon_ctx *context,
+			struct damon_target *t);
+	unsigned int (*check_accesses_target)(struct damon_ctx *context,
+			struct damon_target *t);
 	void (*reset_aggregated)(struct damon_ctx *context);
 	int (*get_scheme_score)(struct damon_ctx *context,
 			struct damon_target *t, struct damon_region *r,
@@ -454,6 +518,7 @@ struct damon_callback {
  *				regions.
  * @max_nr_regions:		The maximum number of adaptive monitoring
  *				regions.
+ * @nr_workers:			The number of threads checking the accesses.
  *
  * For each @sample_interval, DAMON checks whether each region is accessed or
  * not.  It aggregates and keeps the access information (number of accesses to
@@ -463,6 +528,12 @@ struct damon_callback {
  * @ops_update_interval.  All time intervals are in micro-seconds.
  * Please refer to &struct damon_operations and &struct damon_callback for more
  * detail.
+ *
+ * If @nr_workers is larger than one and the operations set supports it, the
+ * access checks of the targets are spread over @nr_workers threads, grouped
+ * by the NUMA node the target processes run on.  Each sampling waits for all
+ * the threads to finish.  Zero or one means the checks are done by kdamond
+ * itself.
  */
 struct damon_attrs {
 	unsigned long sample_interval;
@@ -470,6 +541,43 @@ struct damon_attrs {
 	unsigned long ops_update_interval;
 	unsigned long min_nr_regions;
 	unsigned long max_nr_regions;
+	unsigned int nr_workers;
+};
+
+/**
+ * struct damon_phase_stats - Time kdamond spent in each monitoring phase.
+ *
+ * @prepare_ns:		Preparing the access checks.
+ * @check_ns:		Checking the accesses.
+ * @aggr_ns:		Merging, applying the schemes and splitting regions.
+ * @update_ns:		Updating the operations-related data structures.
+ * @nr_samples:		Number of sampling intervals.
+ *
+ * All times are cumulative nanoseconds since kdamond was started.
+ */
+struct damon_phase_stats {
+	u64 prepare_ns;
+	u64 check_ns;
+	u64 aggr_ns;
+	u64 update_ns;
+	u64 nr_samples;
+};
+
+/* Number of buckets of &struct damon_access_hist */
+#define DAMON_ACCESS_HIST_NR_BUCKETS	20
+
+/**
+ * struct damon_access_hist - Memory size per access frequency.
+ *
+ * @sz:		Total size of the regions in each bucket, in bytes.
+ *
+ * The access frequency range, from zero to the maximum &damon_region->
+ * nr_accesses for the &struct damon_attrs, is split into
+ * %DAMON_ACCESS_HIST_NR_BUCKETS equally sized buckets.  The last bucket also
+ * holds the regions of the maximum frequency.  Updated at each aggregation.
+ */
+struct damon_access_hist {
+	unsigned long sz[DAMON_ACCESS_HIST_NR_BUCKETS];
 };
 
 /**
@@ -501,6 +609,11 @@ struct damon_attrs {
  *
  * @adaptive_targets:	Head of monitoring targets (&damon_target) list.
  * @schemes:		Head of schemes (&damos) list.
+ *
+ * @phase_stats:	Time spent in the monitoring phases.  Written by
+ *			@kdamond only.
+ * @access_hist:	Access frequency histogram of the last aggregation.
+ *			Written by @kdamond only.
  */
 struct damon_ctx {
 	struct damon_attrs attrs;
@@ -518,6 +631,9 @@ struct damon_ctx {
 
 	struct list_head adaptive_targets;
 	struct list_head schemes;
+
+	struct damon_phase_stats phase_stats;
+	struct damon_access_hist access_hist;
 };
 
 static inline struct damon_region *damon_next_region(struct damon_region *r)
@@ -469,6 +469,8 @@ void dma_resv_fini(struct dma_resv *obj);
 int dma_resv_reserve_fences(struct dma_resv *obj, unsigned int num_fences);
 void dma_resv_add_fence(struct dma_resv *obj, struct dma_fence *fence,
 			enum dma_resv_usage usage);
+int dma_resv_add_fence_bulk(struct dma_resv **objs, unsigned int num_objs,
+			    struct dma_fence *fence, enum dma_resv_usage usage);
 void dma_resv_replace_fences(struct dma_resv *obj, uint64_t context,
 			     struct dma_fence *fence,
 			     enum dma_resv_usage usage);
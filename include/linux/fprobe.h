@@ -63,6 +63,8 @@ static inline bool fprobe_shared_with_kprobes(struct fprobe *fp)
 int register_fprobe(struct fprobe *fp, const char *filter, const char *notfilter);
 int register_fprobe_ips(struct fprobe *fp, unsigned long *addrs, int num);
 int register_fprobe_syms(struct fprobe *fp, const char **syms, int num);
+int register_fprobes_ips(struct fprobe **fps, unsigned long **addrs,
+			 int *nums, int cnt);
 int unregister_fprobe(struct fprobe *fp);
 #else
 static inline int register_fprobe(struct fprobe *fp, const char *filter, const char *notfilter)
@@ -77,6 +79,11 @@ static inline int register_fprobe_syms(struct fprobe *fp, const char **syms, int
 {
 	return -EOPNOTSUPP;
 }
+static inline int register_fprobes_ips(struct fprobe **fps, unsigned long **addrs,
+				       int *nums, int cnt)
+{
+	return -EOPNOTSUPP;
+}
 static inline int unregister_fprobe(struct fprobe *fp)
 {
 	return -EOPNOTSUPP;
@@ -375,6 +375,7 @@ extern enum ftrace_tracing_type_t ftrace_tracing_type;
  * it, the next pointer may still be used internally.
  */
 int register_ftrace_function(struct ftrace_ops *ops);
+int register_ftrace_functions(struct ftrace_ops **ops, int cnt);
 int unregister_ftrace_function(struct ftrace_ops *ops);
 
 extern void ftrace_stub(unsigned long a0, unsigned long a1,
@@ -388,6 +389,7 @@ int ftrace_lookup_symbols(const char **sorted_syms, size_t cnt, unsigned long *a
  * must not be evaluated.
  */
 #define register_ftrace_function(ops) ({ 0; })
+#define register_ftrace_functions(ops, cnt) ({ 0; })
 #define unregister_ftrace_function(ops) ({ 0; })
 static inline void ftrace_kill(void) { }
 static inline void ftrace_free_init_mem(void) { }
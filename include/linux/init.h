@@ -298,6 +298,32 @@ extern bool initcall_debug;
 
 #define __initcall(fn) device_initcall(fn)
 
+/*
+ * Async initcalls are queued to a workqueue instead of being called in
+ * line, and so run concurrently with the rest of their level. They are
+ * all waited for before the level's _sync initcalls are called. Only use
+ * them for initcalls that nothing else in the same level depends on.
+ *
+ * With "initcall_async=0", or if queueing fails, they run in line.
+ */
+int __init initcall_async_schedule(initcall_t fn);
+
+#define __define_initcall_async(fn, id)					\
+	static int __init __initcall_async_stub_##fn(void)		\
+	{								\
+		return initcall_async_schedule(fn);			\
+	}								\
+	__define_initcall(__initcall_async_stub_##fn, id)
+
+#define core_initcall_async(fn)		__define_initcall_async(fn, 1)
+#define postcore_initcall_async(fn)	__define_initcall_async(fn, 2)
+#define arch_initcall_async(fn)		__define_initcall_async(fn, 3)
+#define subsys_initcall_async(fn)	__define_initcall_async(fn, 4)
+#define fs_initcall_async(fn)		__define_initcall_async(fn, 5)
+#define device_initcall_async(fn)	__define_initcall_async(fn, 6)
+#define late_initcall_async(fn)		__define_initcall_async(fn, 7)
+
+
 #define __exitcall(fn)						\
 	static exitcall_t __exitcall_##fn __exit_call = fn
 
@@ -362,6 +362,19 @@ struct io_ring_ctx {
 	struct callback_head		poll_wq_task_work;
 	struct list_head		defer_list;
 	unsigned			sq_thread_idle;
+	/* SQPOLL share and idle state, only modified by the SQPOLL thread */
+	unsigned			sq_quantum;
+	unsigned			sq_deficit;
+	bool				sq_idle_adaptive;
+	unsigned long			sq_last_arrival;
+	unsigned long			sq_avg_gap;
+	u64				sq_work_time;
+	struct io_lat_stats		*lat_stats;
+
+	/* multishot poll wakeup coalescing, see io_poll_coalesce_usec */
+	struct llist_head		poll_batch;
+	struct hrtimer			poll_batch_timer;
+	u64				poll_coalesce_ns;
 	/* protected by ->completion_lock */
 	unsigned			evfd_last_cq_tail;
 };
@@ -568,6 +581,8 @@ struct io_kiocb {
 	atomic_t			poll_refs;
 	struct io_task_work		io_task_work;
 	unsigned			nr_tw;
+	/* only valid if latency stats are enabled, see io_uring/stats.h */
+	u32				issue_time;
 	/* for polled requests, i.e. IORING_OP_POLL_ADD and async armed poll */
 	union {
 		struct hlist_node	hash_node;
@@ -589,6 +604,7 @@ struct io_kiocb {
 
 struct io_overflow_cqe {
 	struct list_head list;
+	u32 time;
 	struct io_uring_cqe cqe;
 };
 
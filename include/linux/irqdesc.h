@@ -37,6 +37,10 @@ struct pt_regs;
  * @affinity_hint:	hint to user space for preferred irq affinity
  * @affinity_notify:	context for notification of affinity changes
  * @pending_mask:	pending rebalanced interrupts
+ * @balance_cpu:	CPU the in-kernel balancer last saw the interrupt on
+ * @balance_count:	interrupt count on @balance_cpu at the last scan
+ * @balance_delta:	interrupts on @balance_cpu during the last interval
+ * @balance_moved:	jiffies of the last move by the balancer
  * @threads_oneshot:	bitfield to handle shared oneshot threads
  * @threads_active:	number of irqaction threads currently running
  * @wait_for_threads:	wait queue for sync_irq to wait for threaded handlers
@@ -77,6 +81,12 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	cpumask_var_t		pending_mask;
 #endif
+#ifdef CONFIG_IRQ_AUTOBALANCE
+	int			balance_cpu;
+	unsigned int		balance_count;
+	unsigned int		balance_delta;
+	unsigned long		balance_moved;
+#endif
 #endif
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
@@ -736,6 +736,12 @@ struct transaction_run_stats_s {
 	unsigned long		rs_flushing;
 	unsigned long		rs_logging;
 
+	/* breakdown of rs_logging */
+	unsigned long		rs_log_submit;
+	unsigned long		rs_log_wait;
+	unsigned long		rs_commit_record;
+	u64			rs_csum_ns;
+
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
 	__u32			rs_blocks_logged;
@@ -758,6 +764,9 @@ jbd2_time_diff(unsigned long start, unsigned long end)
 
 #define JBD2_NR_BATCH	64
 
+/* Default log usage (in percent) at which to start background checkpoints */
+#define JBD2_DEFAULT_CHECKPOINT_WATERMARK	50
+
 enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
 
 #define JBD2_FC_REPLAY_STOP	0
@@ -905,6 +914,22 @@ struct journal_s
 	 */
 	struct buffer_head	*j_chkpt_bhs[JBD2_NR_BATCH];
 
+	/**
+	 * @j_checkpoint_work:
+	 *
+	 * Background checkpointing, queued once the log is filled above
+	 * @j_checkpoint_watermark.
+	 */
+	struct work_struct	j_checkpoint_work;
+
+	/**
+	 * @j_checkpoint_watermark:
+	 *
+	 * Percentage of the log in use at which background checkpointing
+	 * starts, 0 to only checkpoint when the log is full.
+	 */
+	unsigned int		j_checkpoint_watermark;
+
 	/**
 	 * @j_shrinker:
 	 *
@@ -1143,6 +1168,12 @@ struct journal_s
 	 */
 	struct buffer_head	**j_wbuf;
 
+	/**
+	 * @j_wbuf_tags: Descriptor tags of the buffers in @j_wbuf, NULL for
+	 * the descriptor blocks themselves.
+	 */
+	journal_block_tag_t	**j_wbuf_tags;
+
 	/**
 	 * @j_fc_wbuf: Array of fast commit bhs for fast commit. Accessed only
 	 * during a fast commit. Currently only process can do fast commit, so
@@ -1657,6 +1688,10 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_transaction_committed(journal_t *journal, tid_t tid);
 int jbd2_complete_transaction(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
+void jbd2_log_kick_checkpoint(journal_t *journal);
+void jbd2_checkpoint_work(struct work_struct *work);
+extern struct workqueue_struct *jbd2_checkpoint_wq;
+extern struct workqueue_struct *jbd2_csum_wq;
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
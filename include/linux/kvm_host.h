@@ -736,7 +736,7 @@ struct kvm {
 
 	/* For management / invalidation of gfn_to_pfn_caches */
 	spinlock_t gpc_lock;
-	struct list_head gpc_list;
+	struct rb_root_cached gpc_tree;
 
 	/*
 	 * created_vcpus is protected by kvm->lock, and is incremented
@@ -1867,6 +1867,20 @@ ssize_t kvm_stats_read(char *id, const struct kvm_stats_header *header,
 		       void *stats, size_t size_stats,
 		       char __user *user_buffer, size_t size, loff_t *offset);
 
+/* Per-fd state of KVM_STATS_READ_DELTA, see kvm_stats_read_delta(). */
+struct kvm_stats_delta_state {
+	struct mutex lock;
+	u64 generation;
+	u64 *last;
+	u64 *cur;
+};
+
+void kvm_stats_delta_init(struct kvm_stats_delta_state *state);
+void kvm_stats_delta_destroy(struct kvm_stats_delta_state *state);
+int kvm_stats_read_delta(struct kvm_stats_delta_state *state,
+			 const void *stats, size_t size_stats,
+			 void __user *argp);
+
 /**
  * kvm_stats_linear_hist_update() - Update bucket value for linear histogram
  * statistics data.
@@ -10,11 +10,18 @@
 #define DMA_MAP_MAX_THREADS     1024
 #define DMA_MAP_MAX_SECONDS     300
 #define DMA_MAP_MAX_TRANS_DELAY (10 * NSEC_PER_MSEC)
+#define DMA_MAP_MAX_GRANULE     1024
+#define DMA_MAP_MAX_SEGS        128
 
 #define DMA_MAP_BIDIRECTIONAL   0
 #define DMA_MAP_TO_DEVICE       1
 #define DMA_MAP_FROM_DEVICE     2
 
+#define DMA_MAP_BENCH_SINGLE    0 /* dma_map_single() and unmap */
+#define DMA_MAP_BENCH_SG        1 /* dma_map_sg() of nr_segs granules */
+#define DMA_MAP_BENCH_ALLOC     2 /* dma_alloc_attrs() and free */
+#define DMA_MAP_BENCH_CROSS_CPU 3 /* dma_map_single(), unmap on another CPU */
+
 struct map_benchmark {
 	__u64 avg_map_100ns; /* average map latency in 100ns */
 	__u64 map_stddev; /* standard deviation of map latency */
@@ -27,5 +34,13 @@ struct map_benchmark {
 	__u32 dma_dir; /* DMA data direction */
 	__u32 dma_trans_ns; /* time for DMA transmission in ns */
 	__u32 granule;  /* how many PAGE_SIZE will do map/unmap once a time */
+	__u32 mode; /* what to benchmark, DMA_MAP_BENCH_* */
+	__u64 map_p50_ns; /* median map latency in ns */
+	__u64 map_p99_ns; /* 99th percentile of map latency in ns */
+	__u64 map_p999_ns; /* 99.9th percentile of map latency in ns */
+	__u64 unmap_p50_ns; /* as above */
+	__u64 unmap_p99_ns;
+	__u64 unmap_p999_ns;
+	__u32 nr_segs; /* scatterlist entries of granule pages each, for SG */
 };
 #endif /* _KERNEL_DMA_BENCHMARK_H */
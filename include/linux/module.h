@@ -124,6 +124,14 @@ extern void cleanup_module(void);
 #define late_initcall(fn)		module_init(fn)
 #define late_initcall_sync(fn)		module_init(fn)
 
+#define core_initcall_async(fn)		module_init(fn)
+#define postcore_initcall_async(fn)	module_init(fn)
+#define arch_initcall_async(fn)		module_init(fn)
+#define subsys_initcall_async(fn)	module_init(fn)
+#define fs_initcall_async(fn)		module_init(fn)
+#define device_initcall_async(fn)	module_init(fn)
+#define late_initcall_async(fn)		module_init(fn)
+
 #define console_initcall(fn)		module_init(fn)
 
 /* Each module must use one module_init(). */
@@ -380,6 +388,9 @@ struct mod_kallsyms {
 	unsigned int num_symtab;
 	char *strtab;
 	char *typetab;
+	/* symbol numbers sorted by address, for address lookups */
+	unsigned int *addr_index;
+	unsigned int num_addr_index;
 };
 
 #ifdef CONFIG_LIVEPATCH
@@ -264,6 +264,9 @@ struct xt_table_info {
 	unsigned int stacksize;
 	void ***jumpstack;
 
+	/* Family specific index into the rules, or NULL */
+	void *index;
+
 	unsigned char entries[] __aligned(8);
 };
 
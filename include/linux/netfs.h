@@ -122,6 +122,16 @@ typedef void (*netfs_io_terminated_t)(void *priv, ssize_t transferred_or_error,
 /*
  * Per-inode context.  This wraps the VFS inode.
  */
+struct netfs_inode_stats {
+	atomic64_t		download_bytes;	/* Bytes downloaded from the server */
+	atomic64_t		cache_bytes;	/* Bytes read from the cache */
+	atomic_t		downloads;	/* Download subrequests issued */
+	atomic_t		cache_reads;	/* Cache read subrequests issued */
+	atomic_t		coalesced;	/* Cache hits folded into downloads */
+	unsigned int		download_rate;	/* Recent download rate (KiB/s) */
+	unsigned int		download_lat;	/* Minimum download latency (us) */
+};
+
 struct netfs_inode {
 	struct inode		inode;		/* The VFS inode */
 	const struct netfs_request_ops *ops;
@@ -129,6 +139,7 @@ struct netfs_inode {
 	struct fscache_cookie	*cache;
 #endif
 	loff_t			remote_i_size;	/* Size of the remote file */
+	struct netfs_inode_stats stats;		/* Read statistics and estimates */
 };
 
 /*
@@ -155,6 +166,7 @@ struct netfs_io_subrequest {
 	short			error;		/* 0 or error that occurred */
 	unsigned short		debug_index;	/* Index in list (for debugging output) */
 	enum netfs_io_source	source;		/* Where to read from/write to */
+	ktime_t			issue_time;	/* When the download was issued */
 	unsigned long		flags;
 #define NETFS_SREQ_COPY_TO_CACHE	0	/* Set if should copy the data to the cache */
 #define NETFS_SREQ_CLEAR_TAIL		1	/* Set if the rest of the read should be cleared */
@@ -186,6 +198,8 @@ struct netfs_io_request {
 	atomic_t		nr_copy_ops;	/* Number of copy-to-cache ops in progress */
 	size_t			submitted;	/* Amount submitted for I/O so far */
 	size_t			len;		/* Length of the request */
+	atomic64_t		downloaded;	/* Amount downloaded from the server */
+	ktime_t			issue_time;	/* When the request was submitted */
 	short			error;		/* 0 or error that occurred */
 	enum netfs_io_origin	origin;		/* Origin of the request */
 	loff_t			i_size;		/* Size of the file */
@@ -297,6 +311,7 @@ void netfs_get_subrequest(struct netfs_io_subrequest *subreq,
 void netfs_put_subrequest(struct netfs_io_subrequest *subreq,
 			  bool was_async, enum netfs_sreq_ref_trace what);
 void netfs_stats_show(struct seq_file *);
+void netfs_inode_stats_show(struct seq_file *, struct netfs_inode *);
 ssize_t netfs_extract_user_iter(struct iov_iter *orig, size_t orig_len,
 				struct iov_iter *new,
 				iov_iter_extraction_t extraction_flags);
@@ -333,6 +348,7 @@ static inline void netfs_inode_init(struct netfs_inode *ctx,
 #if IS_ENABLED(CONFIG_FSCACHE)
 	ctx->cache = NULL;
 #endif
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
 }
 
 /**
@@ -110,6 +110,14 @@ struct nfs_open_dir_context {
 	unsigned int dtsize;
 	bool force_clear;
 	bool eof;
+	/* readdir prefetch */
+	unsigned long flags;
+	unsigned int rtt_us;
+	struct work_struct prefetch_work;
+	struct file *prefetch_file;
+	__u64 prefetch_cookie;
+	unsigned int prefetch_dtsize;
+	bool prefetch_plus;
 	struct rcu_head rcu_head;
 };
 
@@ -187,6 +195,10 @@ struct nfs_inode {
 		struct {
 			atomic_long_t	nrequests;
 			atomic_long_t	redirtied_pages;
+			/* jiffies of the last buffered write */
+			unsigned long	write_stamp;
+			/* jiffies of the first one since the last flush, or 0 */
+			unsigned long	first_dirty_stamp;
 			struct nfs_mds_commit_info commit_info;
 			struct mutex	commit_mutex;
 		};
@@ -173,6 +173,7 @@ struct nfs_server {
 	unsigned int		acregmax;
 	unsigned int		acdirmin;
 	unsigned int		acdirmax;
+	unsigned int		wcoalesce;	/* write coalescing window */
 	unsigned int		namelen;
 	unsigned int		options;	/* extra options enabled by mount */
 	unsigned int		clone_blksize;	/* granularity of a CLONE operation */
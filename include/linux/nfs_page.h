@@ -116,7 +116,8 @@ struct nfs_pageio_descriptor {
 	struct nfs_pgio_mirror	*pg_mirrors_dynamic;
 	u32			pg_mirror_idx;	/* current mirror */
 	unsigned short		pg_maxretrans;
-	unsigned char		pg_moreio : 1;
+	unsigned char		pg_moreio : 1,
+				pg_mirror_pinned : 1; /* keep pg_mirror_idx */
 };
 
 /* arbitrarily selected limit to number of mirrors */
@@ -8,6 +8,7 @@
 #include <linux/wait.h>
 #include <linux/rcu_sync.h>
 #include <linux/lockdep.h>
+#include <linux/timer.h>
 
 struct percpu_rw_semaphore {
 	struct rcu_sync		rss;
@@ -15,6 +16,10 @@ struct percpu_rw_semaphore {
 	struct rcuwait		writer;
 	wait_queue_head_t	waiters;
 	atomic_t		block;
+	/* write batching, see percpu_rwsem_set_write_batch() */
+	atomic_t		batch_held;
+	unsigned long		batch_delay;
+	struct timer_list	batch_timer;
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
 #endif
@@ -26,6 +31,8 @@ struct percpu_rw_semaphore {
 #define __PERCPU_RWSEM_DEP_MAP_INIT(lockname)
 #endif
 
+extern void percpu_rwsem_batch_expire(struct timer_list *t);
+
 #define __DEFINE_PERCPU_RWSEM(name, is_static)				\
 static DEFINE_PER_CPU(unsigned int, __percpu_rwsem_rc_##name);		\
 is_static struct percpu_rw_semaphore name = {				\
@@ -34,6 +41,8 @@ is_static struct percpu_rw_semaphore name = {				\
 	.writer = __RCUWAIT_INITIALIZER(name.writer),			\
 	.waiters = __WAIT_QUEUE_HEAD_INITIALIZER(name.waiters),		\
 	.block = ATOMIC_INIT(0),					\
+	.batch_held = ATOMIC_INIT(0),					\
+	.batch_timer = __TIMER_INITIALIZER(percpu_rwsem_batch_expire, 0), \
 	__PERCPU_RWSEM_DEP_MAP_INIT(name)				\
 }
 
@@ -124,6 +133,8 @@ static inline void percpu_up_read(struct percpu_rw_semaphore *sem)
 extern bool percpu_is_read_locked(struct percpu_rw_semaphore *);
 extern void percpu_down_write(struct percpu_rw_semaphore *);
 extern void percpu_up_write(struct percpu_rw_semaphore *);
+extern void percpu_rwsem_set_write_batch(struct percpu_rw_semaphore *,
+					 unsigned long delay);
 
 static inline bool percpu_is_write_locked(struct percpu_rw_semaphore *sem)
 {
@@ -794,6 +794,9 @@ struct perf_event {
 	/* for aux_output events */
 	struct perf_event		*aux_event;
 
+	/* user callchains already emitted, for attr.callchain_dedup */
+	struct perf_callchain_cache	*callchain_cache;
+
 	void (*destroy)(struct perf_event *);
 	struct rcu_head			rcu_head;
 
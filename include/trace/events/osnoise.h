@@ -8,14 +8,15 @@
 #include <linux/tracepoint.h>
 TRACE_EVENT(thread_noise,
 
-	TP_PROTO(struct task_struct *t, u64 start, u64 duration),
+	TP_PROTO(struct task_struct *t, u64 start, u64 duration, u64 cgroup),
 
-	TP_ARGS(t, start, duration),
+	TP_ARGS(t, start, duration, cgroup),
 
 	TP_STRUCT__entry(
 		__array(	char,		comm,	TASK_COMM_LEN)
 		__field(	u64,		start	)
 		__field(	u64,		duration)
+		__field(	u64,		cgroup	)
 		__field(	pid_t,		pid	)
 	),
 
@@ -24,14 +25,16 @@ TRACE_EVENT(thread_noise,
 		__entry->pid = t->pid;
 		__entry->start = start;
 		__entry->duration = duration;
+		__entry->cgroup = cgroup;
 	),
 
-	TP_printk("%8s:%d start %llu.%09u duration %llu ns",
+	TP_printk("%8s:%d start %llu.%09u duration %llu ns cgroup %llu",
 		__entry->comm,
 		__entry->pid,
 		__print_ns_to_secs(__entry->start),
 		__print_ns_without_secs(__entry->start),
-		__entry->duration)
+		__entry->duration,
+		__entry->cgroup)
 );
 
 TRACE_EVENT(softirq_noise,
@@ -79,6 +79,36 @@ TRACE_EVENT(xdp_bulk_tx,
 		  __entry->sent, __entry->drops, __entry->err)
 );
 
+TRACE_EVENT(xsk_busy_poll,
+
+	TP_PROTO(const struct net_device *dev, u32 queue_id,
+		 unsigned int napi_id, u16 budget, u32 found, u64 duration),
+
+	TP_ARGS(dev, queue_id, napi_id, budget, found, duration),
+
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(u32, queue_id)
+		__field(unsigned int, napi_id)
+		__field(u16, budget)
+		__field(u32, found)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		__entry->ifindex	= dev->ifindex;
+		__entry->queue_id	= queue_id;
+		__entry->napi_id	= napi_id;
+		__entry->budget		= budget;
+		__entry->found		= found;
+		__entry->duration	= duration;
+	),
+
+	TP_printk("ifindex=%d queue_id=%u napi_id=%u budget=%u found=%u duration_ns=%llu",
+		  __entry->ifindex, __entry->queue_id, __entry->napi_id,
+		  __entry->budget, __entry->found, __entry->duration)
+);
+
 #ifndef __DEVMAP_OBJ_TYPE
 #define __DEVMAP_OBJ_TYPE
 struct _bpf_dtab_netdev {
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Generic netlink interface of the in-kernel interrupt balancer
+ * (CONFIG_IRQ_AUTOBALANCE).
+ *
+ * Each move of an interrupt is reported as an IRQ_BALANCE_CMD_MOVE
+ * message to the IRQ_BALANCE_MCGRP_MOVES multicast group.
+ */
+#ifndef _UAPI_LINUX_IRQ_BALANCE_H
+#define _UAPI_LINUX_IRQ_BALANCE_H
+
+#define IRQ_BALANCE_GENL_NAME		"irq_balance"
+#define IRQ_BALANCE_GENL_VERSION	1
+#define IRQ_BALANCE_MCGRP_MOVES		"moves"
+
+enum {
+	IRQ_BALANCE_CMD_UNSPEC,
+	IRQ_BALANCE_CMD_MOVE,		/* notification only */
+
+	__IRQ_BALANCE_CMD_MAX,
+};
+#define IRQ_BALANCE_CMD_MAX (__IRQ_BALANCE_CMD_MAX - 1)
+
+enum {
+	IRQ_BALANCE_A_UNSPEC,
+	IRQ_BALANCE_A_IRQ,		/* u32: Linux interrupt number */
+	IRQ_BALANCE_A_FROM_CPU,		/* u32 */
+	IRQ_BALANCE_A_TO_CPU,		/* u32 */
+	IRQ_BALANCE_A_RATE,		/* u32: interrupts per second */
+	IRQ_BALANCE_A_FROM_LOAD,	/* u32: irq + softirq load, permille */
+	IRQ_BALANCE_A_TO_LOAD,		/* u32: irq + softirq load, permille */
+
+	__IRQ_BALANCE_A_MAX,
+};
+#define IRQ_BALANCE_A_MAX (__IRQ_BALANCE_A_MAX - 1)
+
+#endif /* _UAPI_LINUX_IRQ_BALANCE_H */
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_IRQ_COUNTERS_H
+#define _UAPI_LINUX_IRQ_COUNTERS_H
+
+#include <linux/types.h>
+
+/*
+ * Record format of /proc/irq/counters.
+ *
+ * The file position is the interrupt number to start at. A read returns
+ * as many whole records as fit into the buffer, one for each interrupt
+ * from the file position on which /proc/interrupts would show, and moves
+ * the file position past the last interrupt returned. So pread() with a
+ * buffer of N records returns the first N interrupts from an offset on.
+ *
+ * @counts has @nr_cpus entries, one per CPU number. Each one holds the
+ * number of interrupts the CPU handled since the same open file last
+ * returned a record for @irq, modulo 2^32. The first read of an
+ * interrupt returns the full counts.
+ */
+struct irq_counters_record {
+	__u32	irq;
+	__u32	nr_cpus;
+	__u32	counts[];
+};
+
+#endif /* _UAPI_LINUX_IRQ_COUNTERS_H */
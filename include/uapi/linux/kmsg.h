@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_KMSG_H
+#define _UAPI_LINUX_KMSG_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Read formats of /dev/kmsg, selected per open file with
+ * KMSG_IOC_SET_FORMAT. The default is the text format documented in
+ * Documentation/ABI/testing/dev-kmsg.
+ *
+ * In the binary format a read returns as many whole records as fit into
+ * the buffer, each one a struct kmsg_record followed by @text_len bytes of
+ * message text and the @subsystem_len and @device_len bytes of the device
+ * properties, not NUL terminated. @size includes all of these and padding
+ * up to 8 bytes. A buffer too small for the next record gets -EINVAL.
+ *
+ * Records the reader fell behind on are skipped silently instead of
+ * failing the read with -EPIPE; they show as a gap in @seq.
+ */
+#define KMSG_FORMAT_TEXT	0
+#define KMSG_FORMAT_BINARY	1
+
+#define KMSG_IOC_SET_FORMAT	_IO(0xB8, 0x01)
+
+/* Flags of struct kmsg_record */
+#define KMSG_RECORD_CONT	0x01	/* fragment of a continuation line */
+
+struct kmsg_record {
+	__u32	size;
+	__u16	text_len;
+	__u8	subsystem_len;
+	__u8	device_len;
+	__u64	seq;
+	__u64	ts_nsec;
+	__u32	caller_id;
+	__u8	facility;
+	__u8	level;
+	__u8	flags;
+	__u8	__reserved;
+};
+
+#endif /* _UAPI_LINUX_KMSG_H */
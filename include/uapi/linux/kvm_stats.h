@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_KVM_STATS_H
+#define _UAPI_LINUX_KVM_STATS_H
+
+#include <linux/ioctl.h>
+#include <linux/kvm.h>
+#include <linux/types.h>
+
+/*
+ * A stats value that changed, @index is the index of the u64 in the
+ * stats data block of the stats fd.
+ */
+struct kvm_stats_delta_entry {
+	__u32	index;
+	__u32	pad;
+	__u64	value;
+};
+
+/*
+ * Argument of KVM_STATS_READ_DELTA on a VM or vCPU stats fd.
+ *
+ * Fills the array of @nr_entries entries at @entries with the stats
+ * values that changed since the read that returned @generation on the
+ * same fd, and returns the new generation in @generation. If @generation
+ * is 0 or not the one last returned, all values are returned. On return
+ * @nr_entries is the number of entries filled in; if the array is too
+ * small the ioctl fails with E2BIG and @nr_entries is the number needed.
+ *
+ * @flags must be 0.
+ */
+struct kvm_stats_delta {
+	__u64	generation;
+	__u32	nr_entries;
+	__u32	flags;
+	__u64	entries;
+};
+
+/*
+ * Argument of KVM_STATS_READ_VCPUS on a VM stats fd.
+ *
+ * Copies the stats data blocks of all vCPUs of the VM, in vCPU creation
+ * order, back to back into the buffer at @data, which must have room for
+ * @nr_vcpus of them. Each block has the layout described by the
+ * descriptors of a vCPU stats fd. On return @nr_vcpus is the number of
+ * vCPUs; if the buffer is too small the ioctl fails with E2BIG.
+ *
+ * @flags must be 0.
+ */
+struct kvm_stats_vcpus {
+	__u32	nr_vcpus;
+	__u32	flags;
+	__u64	data;
+};
+
+/* Numbers not used by any KVMIO ioctl of linux/kvm.h */
+#define KVM_STATS_READ_DELTA	_IOWR(KVMIO, 0xf0, struct kvm_stats_delta)
+#define KVM_STATS_READ_VCPUS	_IOWR(KVMIO, 0xf1, struct kvm_stats_vcpus)
+
+#endif /* _UAPI_LINUX_KVM_STATS_H */
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_PROC_TASKINFO_H
+#define _UAPI_LINUX_PROC_TASKINFO_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* proc_taskinfo.valid */
+#define PROC_TASKINFO_IO	(1 << 0)	/* the I/O counters are filled in */
+
+/*
+ * Record format of /proc/taskinfo.
+ *
+ * The file position is the thread group ID to start at, in the PID
+ * namespace of the proc mount. A read returns as many whole records as
+ * fit into the buffer, one for each thread group from the file position
+ * on that the reader may see in /proc, and moves the file position past
+ * the last one returned. A read returning 0 means there are no more.
+ *
+ * Each record describes a whole thread group, like /proc/<pid>/stat.
+ * Times are in nanoseconds, @start_time since boot. @vsize is in bytes
+ * and @rss in pages. The I/O counters are those of /proc/<pid>/io and
+ * are only filled in, with PROC_TASKINFO_IO set in @valid, if the
+ * reader may read that file. @size is sizeof(struct proc_taskinfo);
+ * new fields are only ever added at the end.
+ */
+struct proc_taskinfo {
+	__u32	size;
+	__u32	valid;
+	__u32	pid;
+	__u32	ppid;
+	__u32	pgid;
+	__u32	sid;
+	__u32	num_threads;
+	__u32	flags;
+	__u8	state;
+	__u8	policy;
+	__s8	nice;
+	__u8	__pad;
+	__s32	prio;
+	__u32	processor;
+	__u32	__pad2;
+	__u64	cgroup_id;
+	__u64	start_time;
+	__u64	utime;
+	__u64	stime;
+	__u64	min_flt;
+	__u64	maj_flt;
+	__u64	vsize;
+	__u64	rss;
+	__u64	nvcsw;
+	__u64	nivcsw;
+	__u64	rchar;
+	__u64	wchar;
+	__u64	syscr;
+	__u64	syscw;
+	__u64	read_bytes;
+	__u64	write_bytes;
+	__u64	cancelled_write_bytes;
+};
+
+/*
+ * Only return thread groups whose leader is in the cgroup v2 with the
+ * __u64 ID pointed to by the argument, or in one of its descendants.
+ * An ID of 0 removes the filter. The filter is per open file.
+ */
+#define PROC_TASKINFO_SET_CGROUP	_IOW('f', 17, __u64)
+
+#endif /* _UAPI_LINUX_PROC_TASKINFO_H */
@@ -554,6 +554,11 @@ enum rdma_nldev_attr {
 	RDMA_NLDEV_ATTR_STAT_HWCOUNTER_INDEX,	/* u32 */
 	RDMA_NLDEV_ATTR_STAT_HWCOUNTER_DYNAMIC, /* u8 */
 
+	/*
+	 * CQEs claimed by the users of a shared (pool) CQ
+	 */
+	RDMA_NLDEV_ATTR_RES_CQE_USED,		/* u32 */
+
 	/*
 	 * Always the end
 	 */
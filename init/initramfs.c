@@ -16,6 +16,8 @@
 #include <linux/mm.h>
 #include <linux/namei.h>
 #include <linux/init_syscalls.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
 #include <linux/task_work.h>
 #include <linux/umh.h>
 
@@ -476,6 +478,114 @@ static long __init flush_buffer(void *bufv, unsigned long len)
 	return origLen;
 }
 
+/*
+ * With "initramfs_pipeline", a compressed archive is decompressed in the
+ * unpacking thread while a second thread parses the cpio data and writes
+ * the files, so that decompression and filesystem work overlap instead of
+ * taking turns. The decompressor's output is copied into chunks, which are
+ * handed over in order; at most PIPELINE_MAX_BYTES are in flight.
+ */
+#define PIPELINE_MAX_BYTES	(8 << 20)
+
+static bool __initdata initramfs_pipeline;
+static int __init initramfs_pipeline_setup(char *str)
+{
+	return kstrtobool(str, &initramfs_pipeline) == 0;
+}
+__setup("initramfs_pipeline=", initramfs_pipeline_setup);
+
+struct pipeline_chunk {
+	struct list_head list;
+	unsigned long len;
+	char data[];
+};
+
+static __initdata LIST_HEAD(pipeline_chunks);
+static __initdata DEFINE_SPINLOCK(pipeline_lock);
+static __initdata DECLARE_WAIT_QUEUE_HEAD(pipeline_wait);
+static __initdata DECLARE_COMPLETION(pipeline_exited);
+static unsigned long pipeline_bytes __initdata;
+static bool pipeline_done __initdata;
+
+static int __init pipeline_writer(void *unused)
+{
+	struct pipeline_chunk *chunk;
+
+	for (;;) {
+		wait_event(pipeline_wait, !list_empty_careful(&pipeline_chunks) ||
+					  READ_ONCE(pipeline_done));
+
+		spin_lock(&pipeline_lock);
+		chunk = list_first_entry_or_null(&pipeline_chunks,
+						 struct pipeline_chunk, list);
+		if (chunk)
+			list_del(&chunk->list);
+		spin_unlock(&pipeline_lock);
+		if (!chunk)
+			break;
+
+		flush_buffer(chunk->data, chunk->len);
+
+		spin_lock(&pipeline_lock);
+		pipeline_bytes -= chunk->len;
+		spin_unlock(&pipeline_lock);
+		kfree(chunk);
+		wake_up(&pipeline_wait);
+	}
+
+	complete(&pipeline_exited);
+	return 0;
+}
+
+static long __init pipeline_flush(void *bufv, unsigned long len)
+{
+	struct pipeline_chunk *chunk;
+
+	if (message)
+		return -1;
+
+	chunk = kmalloc(struct_size(chunk, data, len), GFP_KERNEL);
+	if (!chunk) {
+		/* Catch up and write this one in line */
+		wait_event(pipeline_wait, !READ_ONCE(pipeline_bytes));
+		return flush_buffer(bufv, len);
+	}
+	chunk->len = len;
+	memcpy(chunk->data, bufv, len);
+
+	wait_event(pipeline_wait,
+		   READ_ONCE(pipeline_bytes) < PIPELINE_MAX_BYTES);
+
+	spin_lock(&pipeline_lock);
+	list_add_tail(&chunk->list, &pipeline_chunks);
+	pipeline_bytes += len;
+	spin_unlock(&pipeline_lock);
+	wake_up(&pipeline_wait);
+
+	return len;
+}
+
+static bool __init pipeline_start(void)
+{
+	struct task_struct *tsk;
+
+	if (!initramfs_pipeline)
+		return false;
+
+	pipeline_done = false;
+	reinit_completion(&pipeline_exited);
+	tsk = kthread_run(pipeline_writer, NULL, "initramfs_writer");
+	return !IS_ERR(tsk);
+}
+
+/* Wait until everything decompressed so far has been written */
+static void __init pipeline_finish(void)
+{
+	WRITE_ONCE(pipeline_done, true);
+	wake_up(&pipeline_wait);
+	wait_for_completion(&pipeline_exited);
+}
+
 static unsigned long my_inptr __initdata; /* index of next byte to be processed in inbuf */
 
 #include <linux/decompress/generic.h>
@@ -516,8 +626,13 @@ static char * __init unpack_to_rootfs(char *buf, unsigned long len)
 		decompress = decompress_method(buf, len, &compress_name);
 		pr_debug("Detected %s compressed data\n", compress_name);
 		if (decompress) {
-			int res = decompress(buf, len, NULL, flush_buffer, NULL,
-				   &my_inptr, error);
+			bool pipeline = pipeline_start();
+			int res = decompress(buf, len, NULL,
+					     pipeline ? pipeline_flush : flush_buffer,
+					     NULL, &my_inptr, error);
+			/* the cpio state below must not change under the writer */
+			if (pipeline)
+				pipeline_finish();
 			if (res)
 				error("decompressor failed");
 		} else if (compress_name) {
@@ -77,6 +77,8 @@
 #include <linux/kgdb.h>
 #include <linux/ftrace.h>
 #include <linux/async.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/perf_event.h>
@@ -1262,6 +1264,68 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	return ret;
 }
 
+/*
+ * Async initcalls, see include/linux/init.h. Each one that is queued
+ * gets an initcall_async_work, which is kept until the level barrier.
+ */
+struct initcall_async_work {
+	struct work_struct work;
+	struct completion done;
+	initcall_t fn;
+	struct list_head list;
+};
+
+static bool initcall_async_enabled __initdata = true;
+static __initdata LIST_HEAD(initcall_async_list);
+
+static int __init set_initcall_async(char *str)
+{
+	return !kstrtobool(str, &initcall_async_enabled);
+}
+__setup("initcall_async=", set_initcall_async);
+
+/*
+ * do_one_initcall() checks the blacklist, emits the initcall trace events
+ * and catches an initcall that returns with preemption or interrupts
+ * disabled, for async initcalls as for any other.
+ */
+static void __init initcall_async_fn(struct work_struct *work)
+{
+	struct initcall_async_work *iaw =
+		container_of(work, struct initcall_async_work, work);
+
+	do_one_initcall(iaw->fn);
+	complete(&iaw->done);
+}
+
+int __init initcall_async_schedule(initcall_t fn)
+{
+	struct initcall_async_work *iaw = NULL;
+
+	if (initcall_async_enabled)
+		iaw = kzalloc(sizeof(*iaw), GFP_KERNEL);
+	if (!iaw)
+		return do_one_initcall(fn);
+
+	INIT_WORK(&iaw->work, initcall_async_fn);
+	init_completion(&iaw->done);
+	iaw->fn = fn;
+	list_add_tail(&iaw->list, &initcall_async_list);
+	queue_work(system_unbound_wq, &iaw->work);
+	return 0;
+}
+
+static void __init initcall_async_barrier(void)
+{
+	struct initcall_async_work *iaw, *tmp;
+
+	list_for_each_entry_safe(iaw, tmp, &initcall_async_list, list) {
+		wait_for_completion(&iaw->done);
+		list_del(&iaw->list);
+		kfree(iaw);
+	}
+}
+
 
 extern initcall_entry_t __initcall_start[];
 extern initcall_entry_t __initcall0_start[];
@@ -1273,6 +1337,14 @@ extern initcall_entry_t __initcall5_start[];
 extern initcall_entry_t __initcall6_start[];
 extern initcall_entry_t __initcall7_start[];
 extern initcall_entry_t __initcall_end[];
+extern initcall_entry_t __initcall0s_start[];
+extern initcall_entry_t __initcall1s_start[];
+extern initcall_entry_t __initcall2s_start[];
+extern initcall_entry_t __initcall3s_start[];
+extern initcall_entry_t __initcall4s_start[];
+extern initcall_entry_t __initcall5s_start[];
+extern initcall_entry_t __initcall6s_start[];
+extern initcall_entry_t __initcall7s_start[];
 
 static initcall_entry_t *initcall_levels[] __initdata = {
 	__initcall0_start,
@@ -1286,6 +1358,18 @@ static initcall_entry_t *initcall_levels[] __initdata = {
 	__initcall_end,
 };
 
+/* Start of each level's _sync initcalls, async initcalls are done by then */
+static initcall_entry_t *initcall_sync_levels[] __initdata = {
+	__initcall0s_start,
+	__initcall1s_start,
+	__initcall2s_start,
+	__initcall3s_start,
+	__initcall4s_start,
+	__initcall5s_start,
+	__initcall6s_start,
+	__initcall7s_start,
+};
+
 /* Keep these in sync with initcalls in include/linux/init.h */
 static const char *initcall_level_names[] __initdata = {
 	"pure",
@@ -1315,8 +1399,12 @@ static void __init do_initcall_level(int level, char *command_line)
 		   NULL, ignore_unknown_bootoption);
 
 	trace_initcall_level(initcall_level_names[level]);
-	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
+	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++) {
+		if (fn == initcall_sync_levels[level])
+			initcall_async_barrier();
 		do_one_initcall(initcall_from_entry(fn));
+	}
+	initcall_async_barrier();
 }
 
 static void __init do_initcalls(void)
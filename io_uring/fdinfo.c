@@ -11,9 +11,11 @@
 
 #include "io_uring.h"
 #include "sqpoll.h"
+#include "tctx.h"
 #include "fdinfo.h"
 #include "cancel.h"
 #include "rsrc.h"
+#include "kbuf.h"
 
 #ifdef CONFIG_PROC_FS
 static __cold int io_uring_show_cred(struct seq_file *m, unsigned int id,
@@ -144,6 +146,27 @@ static __cold void __io_uring_show_fdinfo(struct io_ring_ctx *ctx,
 
 	seq_printf(m, "SqThread:\t%d\n", sq ? task_pid_nr(sq->thread) : -1);
 	seq_printf(m, "SqThreadCpu:\t%d\n", sq ? task_cpu(sq->thread) : -1);
+	if (sq) {
+		seq_printf(m, "SqQuantum:\t%u\n", ctx->sq_quantum);
+		seq_printf(m, "SqIdle:\t%u%s\n",
+			   jiffies_to_msecs(ctx->sq_thread_idle),
+			   ctx->sq_idle_adaptive ? " (adaptive)" : "");
+		seq_printf(m, "SqWorkTime:\t%llu\n",
+			   div_u64(READ_ONCE(ctx->sq_work_time), NSEC_PER_USEC));
+	}
+	if (has_lock) {
+		unsigned long local = 0, stolen = 0;
+		struct io_tctx_node *node;
+
+		list_for_each_entry(node, &ctx->tctx_list, ctx_node) {
+			struct io_uring_task *tctx = node->task->io_uring;
+
+			if (tctx->io_wq)
+				io_wq_node_stats(tctx->io_wq, &local, &stolen);
+		}
+		seq_printf(m, "IoWqNodeLocal:\t%lu\n", local);
+		seq_printf(m, "IoWqNodeStolen:\t%lu\n", stolen);
+	}
 	seq_printf(m, "UserFiles:\t%u\n", ctx->nr_user_files);
 	for (i = 0; has_lock && i < ctx->nr_user_files; i++) {
 		struct file *f = io_file_from_index(&ctx->file_table, i);
@@ -160,6 +183,10 @@ static __cold void __io_uring_show_fdinfo(struct io_ring_ctx *ctx,
 
 		seq_printf(m, "%5u: 0x%llx/%u\n", i, buf->ubuf, len);
 	}
+	if (has_lock) {
+		io_kbuf_show_fdinfo(ctx, m);
+		io_lat_stats_show_fdinfo(ctx, m);
+	}
 	if (has_lock && !xa_empty(&ctx->personalities)) {
 		unsigned long index;
 		const struct cred *cred;
@@ -23,6 +23,11 @@
 #include "io_uring.h"
 
 #define WORKER_IDLE_TIMEOUT	(5 * HZ)
+/*
+ * Idle workers only pull work queued on a remote node once that node has
+ * this many items pending, unless the node has no free worker of its own.
+ */
+#define IO_WQ_STEAL_THRESHOLD	4
 
 enum {
 	IO_WORKER_F_UP		= 1,	/* up and active */
@@ -49,6 +54,7 @@ struct io_worker {
 	struct list_head all_list;
 	struct task_struct *task;
 	struct io_wq *wq;
+	int node;
 
 	struct io_wq_work *cur_work;
 	struct io_wq_work *next_work;
@@ -79,9 +85,11 @@ struct io_wq_acct {
 	unsigned max_workers;
 	int index;
 	atomic_t nr_running;
+	/* protects the work lists of this acct on all nodes */
 	raw_spinlock_t lock;
-	struct io_wq_work_list work_list;
 	unsigned long flags;
+	unsigned long nr_local;
+	unsigned long nr_stolen;
 };
 
 enum {
@@ -90,6 +98,18 @@ enum {
 	IO_WQ_ACCT_NR,
 };
 
+/*
+ * Per NUMA node part of an io_wq. Work is queued on the node it was
+ * submitted from, and workers started on that node pull from it first.
+ */
+struct io_wq_node {
+	struct io_wq_work_list work_list[IO_WQ_ACCT_NR];
+	unsigned int nr_pending[IO_WQ_ACCT_NR];
+	/* protected by wq->lock */
+	unsigned int nr_free[IO_WQ_ACCT_NR];
+	struct io_wq_work *hash_tail[IO_WQ_NR_HASH_BUCKETS];
+};
+
 /*
  * Per io_wq state
   */
@@ -118,9 +138,9 @@ struct io_wq {
 
 	struct wait_queue_entry wait;
 
-	struct io_wq_work *hash_tail[IO_WQ_NR_HASH_BUCKETS];
-
 	cpumask_var_t cpu_mask;
+
+	struct io_wq_node nodes[];
 };
 
 static enum cpuhp_state io_wq_online;
@@ -215,8 +235,10 @@ static void io_worker_exit(struct io_worker *worker)
 	wait_for_completion(&worker->ref_done);
 
 	raw_spin_lock(&wq->lock);
-	if (worker->flags & IO_WORKER_F_FREE)
+	if (worker->flags & IO_WORKER_F_FREE) {
 		hlist_nulls_del_rcu(&worker->nulls_node);
+		wq->nodes[worker->node].nr_free[io_wq_get_acct(worker)->index]--;
+	}
 	list_del_rcu(&worker->all_list);
 	raw_spin_unlock(&wq->lock);
 	io_wq_dec_running(worker);
@@ -230,14 +252,43 @@ static void io_worker_exit(struct io_worker *worker)
 	do_exit(0);
 }
 
-static inline bool io_acct_run_queue(struct io_wq_acct *acct)
+/*
+ * Work queued on a remote node is only taken once its backlog has built up,
+ * or if that node has no free worker that could pick it up itself.
+ */
+static inline bool io_acct_can_steal(struct io_wq *wq, struct io_wq_acct *acct,
+				     int node)
+	__must_hold(acct->lock)
+{
+	struct io_wq_node *wqn = &wq->nodes[node];
+
+	return wqn->nr_pending[acct->index] >= IO_WQ_STEAL_THRESHOLD ||
+		!READ_ONCE(wqn->nr_free[acct->index]);
+}
+
+/*
+ * Check if there's work that a worker on @node may run. NUMA_NO_NODE checks
+ * for pending work on any node.
+ */
+static inline bool io_acct_run_queue(struct io_wq *wq, struct io_wq_acct *acct,
+				     int node)
 {
 	bool ret = false;
+	int i;
 
 	raw_spin_lock(&acct->lock);
-	if (!wq_list_empty(&acct->work_list) &&
-	    !test_bit(IO_ACCT_STALLED_BIT, &acct->flags))
-		ret = true;
+	if (test_bit(IO_ACCT_STALLED_BIT, &acct->flags))
+		goto out;
+	for_each_node(i) {
+		if (wq_list_empty(&wq->nodes[i].work_list[acct->index]))
+			continue;
+		if (node == NUMA_NO_NODE || node == i ||
+		    io_acct_can_steal(wq, acct, i)) {
+			ret = true;
+			break;
+		}
+	}
+out:
 	raw_spin_unlock(&acct->lock);
 
 	return ret;
@@ -245,10 +296,11 @@ static inline bool io_acct_run_queue(struct io_wq_acct *acct)
 
 /*
  * Check head of free list for an available worker. If one isn't available,
- * caller must create one.
+ * caller must create one. If @node isn't NUMA_NO_NODE, only workers started
+ * on that node are considered.
  */
 static bool io_wq_activate_free_worker(struct io_wq *wq,
-					struct io_wq_acct *acct)
+					struct io_wq_acct *acct, int node)
 	__must_hold(RCU)
 {
 	struct hlist_nulls_node *n;
@@ -262,7 +314,8 @@ static bool io_wq_activate_free_worker(struct io_wq *wq,
 	hlist_nulls_for_each_entry_rcu(worker, n, &wq->free_list, nulls_node) {
 		if (!io_worker_get(worker))
 			continue;
-		if (io_wq_get_acct(worker) != acct) {
+		if (io_wq_get_acct(worker) != acct ||
+		    (node != NUMA_NO_NODE && worker->node != node)) {
 			io_worker_release(worker);
 			continue;
 		}
@@ -392,7 +445,7 @@ static void io_wq_dec_running(struct io_worker *worker)
 
 	if (!atomic_dec_and_test(&acct->nr_running))
 		return;
-	if (!io_acct_run_queue(acct))
+	if (!io_acct_run_queue(wq, acct, NUMA_NO_NODE))
 		return;
 
 	atomic_inc(&acct->nr_running);
@@ -410,6 +463,7 @@ static void __io_worker_busy(struct io_wq *wq, struct io_worker *worker)
 		worker->flags &= ~IO_WORKER_F_FREE;
 		raw_spin_lock(&wq->lock);
 		hlist_nulls_del_init_rcu(&worker->nulls_node);
+		wq->nodes[worker->node].nr_free[io_wq_get_acct(worker)->index]--;
 		raw_spin_unlock(&wq->lock);
 	}
 }
@@ -423,6 +477,7 @@ static void __io_worker_idle(struct io_wq *wq, struct io_worker *worker)
 	if (!(worker->flags & IO_WORKER_F_FREE)) {
 		worker->flags |= IO_WORKER_F_FREE;
 		hlist_nulls_add_head_rcu(&worker->nulls_node, &wq->free_list);
+		wq->nodes[worker->node].nr_free[io_wq_get_acct(worker)->index]++;
 	}
 }
 
@@ -448,40 +503,76 @@ static bool io_wait_on_hash(struct io_wq *wq, unsigned int hash)
 	return ret;
 }
 
-static struct io_wq_work *io_get_next_work(struct io_wq_acct *acct,
-					   struct io_worker *worker)
+static struct io_wq_work *io_get_node_work(struct io_wq *wq,
+					   struct io_wq_acct *acct, int node,
+					   unsigned int *stall_hash)
 	__must_hold(acct->lock)
 {
-	struct io_wq_work_node *node, *prev;
+	struct io_wq_node *wqn = &wq->nodes[node];
+	struct io_wq_work_list *list = &wqn->work_list[acct->index];
+	struct io_wq_work_node *pos, *prev;
 	struct io_wq_work *work, *tail;
-	unsigned int stall_hash = -1U;
-	struct io_wq *wq = worker->wq;
 
-	wq_list_for_each(node, prev, &acct->work_list) {
+	wq_list_for_each(pos, prev, list) {
 		unsigned int hash;
 
-		work = container_of(node, struct io_wq_work, list);
+		work = container_of(pos, struct io_wq_work, list);
 
 		/* not hashed, can run anytime */
 		if (!io_wq_is_hashed(work)) {
-			wq_list_del(&acct->work_list, node, prev);
+			wq_list_del(list, pos, prev);
+			wqn->nr_pending[acct->index]--;
 			return work;
 		}
 
 		hash = io_get_work_hash(work);
 		/* all items with this hash lie in [work, tail] */
-		tail = wq->hash_tail[hash];
+		tail = wqn->hash_tail[hash];
 
 		/* hashed, can run if not already running */
 		if (!test_and_set_bit(hash, &wq->hash->map)) {
-			wq->hash_tail[hash] = NULL;
-			wq_list_cut(&acct->work_list, &tail->list, prev);
+			struct io_wq_work *w;
+
+			wqn->hash_tail[hash] = NULL;
+			wq_list_cut(list, &tail->list, prev);
+			for (w = work; w; w = wq_next_work(w))
+				wqn->nr_pending[acct->index]--;
 			return work;
 		}
-		if (stall_hash == -1U)
-			stall_hash = hash;
+		if (*stall_hash == -1U)
+			*stall_hash = hash;
 		/* fast forward to a next hash, for-each will fix up @prev */
-		node = &tail->list;
+		pos = &tail->list;
+	}
+
+	return NULL;
+}
+
+static struct io_wq_work *io_get_next_work(struct io_wq_acct *acct,
+					   struct io_worker *worker)
+	__must_hold(acct->lock)
+{
+	unsigned int stall_hash = -1U;
+	struct io_wq *wq = worker->wq;
+	struct io_wq_work *work;
+	int node;
+
+	work = io_get_node_work(wq, acct, worker->node, &stall_hash);
+	if (work) {
+		acct->nr_local++;
+		return work;
+	}
+
+	for_each_node(node) {
+		if (node == worker->node ||
+		    wq_list_empty(&wq->nodes[node].work_list[acct->index]) ||
+		    !io_acct_can_steal(wq, acct, node))
+			continue;
+		work = io_get_node_work(wq, acct, node, &stall_hash);
+		if (work) {
+			acct->nr_stolen++;
+			return work;
+		}
 	}
 
 	if (stall_hash != -1U) {
@@ -609,7 +700,7 @@ static int io_wq_worker(void *data)
 		long ret;
 
 		set_current_state(TASK_INTERRUPTIBLE);
-		while (io_acct_run_queue(acct))
+		while (io_acct_run_queue(wq, acct, worker->node))
 			io_worker_handle_work(worker);
 
 		raw_spin_lock(&wq->lock);
@@ -686,17 +777,39 @@ void io_wq_worker_sleeping(struct task_struct *tsk)
 	io_wq_dec_running(worker);
 }
 
+/*
+ * Keep the worker on the CPUs of its node, as long as that leaves it any
+ * CPU in the allowed mask of the io_wq.
+ */
+static void io_worker_set_affinity(struct io_wq *wq, struct io_worker *worker,
+				   struct task_struct *tsk)
+{
+	cpumask_var_t mask;
+
+	if (nr_node_ids > 1 && alloc_cpumask_var(&mask, GFP_KERNEL)) {
+		if (cpumask_and(mask, wq->cpu_mask,
+				cpumask_of_node(worker->node))) {
+			set_cpus_allowed_ptr(tsk, mask);
+			free_cpumask_var(mask);
+			return;
+		}
+		free_cpumask_var(mask);
+	}
+	set_cpus_allowed_ptr(tsk, wq->cpu_mask);
+}
+
 static void io_init_new_worker(struct io_wq *wq, struct io_worker *worker,
 			       struct task_struct *tsk)
 {
 	tsk->worker_private = worker;
 	worker->task = tsk;
-	set_cpus_allowed_ptr(tsk, wq->cpu_mask);
+	io_worker_set_affinity(wq, worker, tsk);
 
 	raw_spin_lock(&wq->lock);
 	hlist_nulls_add_head_rcu(&worker->nulls_node, &wq->free_list);
 	list_add_tail_rcu(&worker->all_list, &wq->all_list);
 	worker->flags |= IO_WORKER_F_FREE;
+	wq->nodes[worker->node].nr_free[io_wq_get_acct(worker)->index]++;
 	raw_spin_unlock(&wq->lock);
 	wake_up_new_task(tsk);
 }
@@ -735,7 +848,7 @@ static void create_worker_cont(struct callback_head *cb)
 	worker = container_of(cb, struct io_worker, create_work);
 	clear_bit_unlock(0, &worker->create_state);
 	wq = worker->wq;
-	tsk = create_io_thread(io_wq_worker, worker, NUMA_NO_NODE);
+	tsk = create_io_thread(io_wq_worker, worker, worker->node);
 	if (!IS_ERR(tsk)) {
 		io_init_new_worker(wq, worker, tsk);
 		io_worker_release(worker);
@@ -798,13 +911,14 @@ static bool create_io_worker(struct io_wq *wq, int index)
 
 	refcount_set(&worker->ref, 1);
 	worker->wq = wq;
+	worker->node = numa_node_id();
 	raw_spin_lock_init(&worker->lock);
 	init_completion(&worker->ref_done);
 
 	if (index == IO_WQ_ACCT_BOUND)
 		worker->flags |= IO_WORKER_F_BOUND;
 
-	tsk = create_io_thread(io_wq_worker, worker, NUMA_NO_NODE);
+	tsk = create_io_thread(io_wq_worker, worker, worker->node);
 	if (!IS_ERR(tsk)) {
 		io_init_new_worker(wq, worker, tsk);
 	} else if (!io_should_retry_thread(PTR_ERR(tsk))) {
@@ -859,25 +973,39 @@ static void io_run_cancel(struct io_wq_work *work, struct io_wq *wq)
 	} while (work);
 }
 
-static void io_wq_insert_work(struct io_wq *wq, struct io_wq_work *work)
+static void io_wq_insert_work(struct io_wq *wq, struct io_wq_work *work,
+			      int node)
 {
 	struct io_wq_acct *acct = io_work_get_acct(wq, work);
+	struct io_wq_node *wqn;
 	unsigned int hash;
-	struct io_wq_work *tail;
+	struct io_wq_work *tail = NULL;
+	int i;
 
 	if (!io_wq_is_hashed(work)) {
+		wqn = &wq->nodes[node];
 append:
-		wq_list_add_tail(&work->list, &acct->work_list);
+		wq_list_add_tail(&work->list, &wqn->work_list[acct->index]);
+		wqn->nr_pending[acct->index]++;
 		return;
 	}
 
+	/* hashed work has to go behind a pending run of the same hash */
 	hash = io_get_work_hash(work);
-	tail = wq->hash_tail[hash];
-	wq->hash_tail[hash] = work;
+	for_each_node(i) {
+		tail = wq->nodes[i].hash_tail[hash];
+		if (tail) {
+			node = i;
+			break;
+		}
+	}
+	wqn = &wq->nodes[node];
+	wqn->hash_tail[hash] = work;
 	if (!tail)
 		goto append;
 
-	wq_list_add_after(&work->list, &tail->list, &acct->work_list);
+	wq_list_add_after(&work->list, &tail->list, &wqn->work_list[acct->index]);
+	wqn->nr_pending[acct->index]++;
 }
 
 static bool io_wq_work_match_item(struct io_wq_work *work, void *data)
@@ -890,6 +1018,7 @@ void io_wq_enqueue(struct io_wq *wq, struct io_wq_work *work)
 	struct io_wq_acct *acct = io_work_get_acct(wq, work);
 	struct io_cb_cancel_data match;
 	unsigned work_flags = work->flags;
+	int node = numa_node_id();
 	bool do_create;
 
 	/*
@@ -903,13 +1032,15 @@ void io_wq_enqueue(struct io_wq *wq, struct io_wq_work *work)
 	}
 
 	raw_spin_lock(&acct->lock);
-	io_wq_insert_work(wq, work);
+	io_wq_insert_work(wq, work, node);
 	clear_bit(IO_ACCT_STALLED_BIT, &acct->flags);
 	raw_spin_unlock(&acct->lock);
 
 	raw_spin_lock(&wq->lock);
 	rcu_read_lock();
-	do_create = !io_wq_activate_free_worker(wq, acct);
+	/* prefer a free worker on the local node, then any free worker */
+	do_create = !io_wq_activate_free_worker(wq, acct, node) &&
+		    !io_wq_activate_free_worker(wq, acct, NUMA_NO_NODE);
 	rcu_read_unlock();
 
 	raw_spin_unlock(&wq->lock);
@@ -982,41 +1113,49 @@ static bool io_wq_worker_cancel(struct io_worker *worker, void *data)
 
 static inline void io_wq_remove_pending(struct io_wq *wq,
 					 struct io_wq_work *work,
-					 struct io_wq_work_node *prev)
+					 struct io_wq_work_node *prev, int node)
 {
 	struct io_wq_acct *acct = io_work_get_acct(wq, work);
+	struct io_wq_node *wqn = &wq->nodes[node];
 	unsigned int hash = io_get_work_hash(work);
 	struct io_wq_work *prev_work = NULL;
 
-	if (io_wq_is_hashed(work) && work == wq->hash_tail[hash]) {
+	if (io_wq_is_hashed(work) && work == wqn->hash_tail[hash]) {
 		if (prev)
 			prev_work = container_of(prev, struct io_wq_work, list);
 		if (prev_work && io_get_work_hash(prev_work) == hash)
-			wq->hash_tail[hash] = prev_work;
+			wqn->hash_tail[hash] = prev_work;
 		else
-			wq->hash_tail[hash] = NULL;
+			wqn->hash_tail[hash] = NULL;
 	}
-	wq_list_del(&acct->work_list, &work->list, prev);
+	wq_list_del(&wqn->work_list[acct->index], &work->list, prev);
+	wqn->nr_pending[acct->index]--;
 }
 
 static bool io_acct_cancel_pending_work(struct io_wq *wq,
 					struct io_wq_acct *acct,
 					struct io_cb_cancel_data *match)
 {
-	struct io_wq_work_node *node, *prev;
+	struct io_wq_work_node *pos, *prev;
 	struct io_wq_work *work;
+	int node;
 
 	raw_spin_lock(&acct->lock);
-	wq_list_for_each(node, prev, &acct->work_list) {
-		work = container_of(node, struct io_wq_work, list);
-		if (!match->fn(work, match->data))
-			continue;
-		io_wq_remove_pending(wq, work, prev);
-		raw_spin_unlock(&acct->lock);
-		io_run_cancel(work, wq);
-		match->nr_pending++;
-		/* not safe to continue after unlock */
-		return true;
+	for_each_node(node) {
+		struct io_wq_work_list *list;
+
+		list = &wq->nodes[node].work_list[acct->index];
+		wq_list_for_each(pos, prev, list) {
+			work = container_of(pos, struct io_wq_work, list);
+			if (!match->fn(work, match->data))
+				continue;
+			io_wq_remove_pending(wq, work, prev, node);
+			raw_spin_unlock(&acct->lock);
+			io_run_cancel(work, wq);
+			match->nr_pending++;
+			/* not safe to continue after unlock */
+			return true;
+		}
 	}
 	raw_spin_unlock(&acct->lock);
 
@@ -1097,9 +1236,17 @@ static int io_wq_hash_wake(struct wait_queue_entry *wait, unsigned mode,
 	rcu_read_lock();
 	for (i = 0; i < IO_WQ_ACCT_NR; i++) {
 		struct io_wq_acct *acct = &wq->acct[i];
+		int node;
 
-		if (test_and_clear_bit(IO_ACCT_STALLED_BIT, &acct->flags))
-			io_wq_activate_free_worker(wq, acct);
+		if (!test_and_clear_bit(IO_ACCT_STALLED_BIT, &acct->flags))
+			continue;
+		/* kick a worker for every node that has work waiting */
+		for_each_node(node) {
+			if (wq_list_empty(&wq->nodes[node].work_list[i]))
+				continue;
+			if (!io_wq_activate_free_worker(wq, acct, node))
+				io_wq_activate_free_worker(wq, acct, NUMA_NO_NODE);
+		}
 	}
 	rcu_read_unlock();
 	return 1;
@@ -1107,7 +1254,7 @@ static int io_wq_hash_wake(struct wait_queue_entry *wait, unsigned mode,
 
 struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 {
-	int ret, i;
+	int ret, i, node;
 	struct io_wq *wq;
 
 	if (WARN_ON_ONCE(!data->free_work || !data->do_work))
@@ -1115,7 +1262,7 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 	if (WARN_ON_ONCE(!bounded))
 		return ERR_PTR(-EINVAL);
 
-	wq = kzalloc(sizeof(struct io_wq), GFP_KERNEL);
+	wq = kzalloc(struct_size(wq, nodes, nr_node_ids), GFP_KERNEL);
 	if (!wq)
 		return ERR_PTR(-ENOMEM);
 	ret = cpuhp_state_add_instance_nocalls(io_wq_online, &wq->cpuhp_node);
@@ -1142,8 +1289,9 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 
 		acct->index = i;
 		atomic_set(&acct->nr_running, 0);
-		INIT_WQ_LIST(&acct->work_list);
 		raw_spin_lock_init(&acct->lock);
+		for_each_node(node)
+			INIT_WQ_LIST(&wq->nodes[node].work_list[i]);
 	}
 
 	raw_spin_lock_init(&wq->lock);
@@ -1335,6 +1483,25 @@ int io_wq_max_workers(struct io_wq *wq, int *new_count)
 	return 0;
 }
 
+/*
+ * Sum up how much work was run on the node it was queued on, and how much
+ * was pulled over by a worker on another node.
+ */
+void io_wq_node_stats(struct io_wq *wq, unsigned long *local,
+		      unsigned long *stolen)
+{
+	int i;
+
+	for (i = 0; i < IO_WQ_ACCT_NR; i++) {
+		struct io_wq_acct *acct = &wq->acct[i];
+
+		raw_spin_lock(&acct->lock);
+		*local += acct->nr_local;
+		*stolen += acct->nr_stolen;
+		raw_spin_unlock(&acct->lock);
+	}
+}
+
 static __init int io_wq_init(void)
 {
 	int ret;
@@ -52,6 +52,8 @@ void io_wq_hash_work(struct io_wq_work *work, void *val);
 
 int io_wq_cpu_affinity(struct io_wq *wq, cpumask_var_t mask);
 int io_wq_max_workers(struct io_wq *wq, int *new_count);
+void io_wq_node_stats(struct io_wq *wq, unsigned long *local,
+		      unsigned long *stolen);
 
 static inline bool io_wq_is_hashed(struct io_wq_work *work)
 {
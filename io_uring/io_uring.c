@@ -298,6 +298,8 @@ static __cold struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	ctx->dummy_ubuf = kzalloc(sizeof(*ctx->dummy_ubuf), GFP_KERNEL);
 	if (!ctx->dummy_ubuf)
 		goto err;
+	if (io_lat_stats_alloc(ctx))
+		goto err;
 	/* set invalid range, so io_import_fixed() fails meeting it */
 	ctx->dummy_ubuf->ubuf = -1UL;
 
@@ -337,8 +339,10 @@ static __cold struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	INIT_WQ_LIST(&ctx->locked_free_list);
 	INIT_DELAYED_WORK(&ctx->fallback_work, io_fallback_req_func);
 	INIT_WQ_LIST(&ctx->submit_state.compl_reqs);
+	io_poll_ctx_init(ctx);
 	return ctx;
 err:
+	io_lat_stats_free(ctx);
 	kfree(ctx->dummy_ubuf);
 	kfree(ctx->cancel_table.hbs);
 	kfree(ctx->cancel_table_locked.hbs);
@@ -480,6 +484,7 @@ void io_queue_iowq(struct io_kiocb *req, struct io_tw_state *ts_dont_use)
 		req->work.flags |= IO_WQ_WORK_CANCEL;
 
 	trace_io_uring_queue_async_work(req, io_wq_is_hashed(&req->work));
+	io_lat_stats_dispatch(req, IO_DISPATCH_IOWQ);
 	io_wq_enqueue(tctx->io_wq, &req->work);
 	if (link)
 		io_queue_linked_timeout(link);
@@ -694,6 +699,7 @@ static void __io_cqring_overflow_flush(struct io_ring_ctx *ctx)
 		ocqe = list_first_entry(&ctx->cq_overflow_list,
 					struct io_overflow_cqe, list);
 		memcpy(cqe, &ocqe->cqe, cqe_size);
+		io_lat_stats_overflow(ctx, ocqe);
 		list_del(&ocqe->list);
 		kfree(ocqe);
 	}
@@ -797,6 +803,8 @@ static bool io_cqring_event_overflow(struct io_ring_ctx *ctx, u64 user_data,
 		atomic_or(IORING_SQ_CQ_OVERFLOW, &ctx->rings->sq_flags);
 
 	}
+	if (io_lat_stats_enabled(ctx))
+		ocqe->time = io_lat_now();
 	ocqe->cqe.user_data = user_data;
 	ocqe->cqe.res = res;
 	ocqe->cqe.flags = cflags;
@@ -2113,6 +2121,7 @@ static void io_queue_async(struct io_kiocb *req, int ret)
 		io_queue_iowq(req, NULL);
 		break;
 	case IO_APOLL_OK:
+		io_lat_stats_dispatch(req, IO_DISPATCH_POLL);
 		break;
 	}
 
@@ -2131,10 +2140,12 @@ static inline void io_queue_sqe(struct io_kiocb *req)
 	 * We async punt it if the file wasn't marked NOWAIT, or if the file
 	 * doesn't support non-blocking read/write attempts
 	 */
-	if (likely(!ret))
+	if (likely(!ret)) {
+		io_lat_stats_dispatch(req, IO_DISPATCH_INLINE);
 		io_arm_ltimeout(req);
-	else
+	} else {
 		io_queue_async(req, ret);
+	}
 }
 
 static void io_queue_sqe_fallback(struct io_kiocb *req)
@@ -2222,6 +2233,7 @@ static int io_init_req(struct io_ring_ctx *ctx, struct io_kiocb *req,
 	req->file = NULL;
 	req->rsrc_node = NULL;
 	req->task = current;
+	io_lat_stats_issue(req);
 
 	if (unlikely(opcode >= IORING_OP_LAST)) {
 		req->opcode = 0;
@@ -2879,6 +2891,8 @@ static __cold void io_ring_ctx_free(struct io_ring_ctx *ctx)
 		io_wq_put_hash(ctx->hash_map);
 	kfree(ctx->cancel_table.hbs);
 	kfree(ctx->cancel_table_locked.hbs);
+	io_poll_ctx_exit(ctx);
+	io_lat_stats_free(ctx);
 	kfree(ctx->dummy_ubuf);
 	kfree(ctx->io_bl);
 	xa_destroy(&ctx->io_bl_xa);
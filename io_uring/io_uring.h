@@ -10,6 +10,7 @@
 #include "io-wq.h"
 #include "slist.h"
 #include "filetable.h"
+#include "stats.h"
 
 #ifndef CREATE_TRACE_POINTS
 #include <trace/events/io_uring.h>
@@ -154,6 +155,7 @@ static inline bool __io_fill_cqe_req(struct io_ring_ctx *ctx,
 	if (unlikely(!cqe))
 		return false;
 
+	io_lat_stats_complete(req);
 	trace_io_uring_complete(req->ctx, req, req->cqe.user_data,
 				req->cqe.res, req->cqe.flags,
 				(req->flags & REQ_F_CQE32_INIT) ? req->extra1 : 0,
@@ -7,6 +7,7 @@
 #include <linux/slab.h>
 #include <linux/namei.h>
 #include <linux/poll.h>
+#include <linux/seq_file.h>
 #include <linux/io_uring.h>
 
 #include <uapi/linux/io_uring.h>
@@ -19,6 +20,20 @@
 
 #define BGID_ARRAY	64
 
+/*
+ * Classic buffer groups that get buffers of more than one size provided
+ * sort them into log2 size classes, starting at 64 bytes. Selection then
+ * picks the smallest buffer that fits the expected transfer.
+ */
+#define IO_BUF_CLASS_SHIFT	6
+#define IO_BUF_NR_CLASSES	11
+
+struct io_buffer_classes {
+	struct list_head	lists[IO_BUF_NR_CLASSES];
+	/* no buffer of the fitting class was available */
+	unsigned long		nr_exhausted[IO_BUF_NR_CLASSES];
+};
+
 struct io_provide_buf {
 	struct file			*file;
 	__u64				addr;
@@ -47,6 +62,54 @@ static int io_buffer_add_list(struct io_ring_ctx *ctx,
 	return xa_err(xa_store(&ctx->io_bl_xa, bgid, bl, GFP_KERNEL));
 }
 
+static inline unsigned int io_buffer_class(__u32 len)
+{
+	int class = fls(len) - 1 - IO_BUF_CLASS_SHIFT;
+
+	return clamp(class, 0, IO_BUF_NR_CLASSES - 1);
+}
+
+static inline struct list_head *io_buffer_class_list(struct io_buffer_list *bl,
+						     __u32 len)
+{
+	if (!bl->classes)
+		return &bl->buf_list;
+	return &bl->classes->lists[io_buffer_class(len)];
+}
+
+static bool io_buffer_list_empty(struct io_buffer_list *bl)
+{
+	int i;
+
+	if (!bl->classes)
+		return list_empty(&bl->buf_list);
+	for (i = 0; i < IO_BUF_NR_CLASSES; i++)
+		if (!list_empty(&bl->classes->lists[i]))
+			return false;
+	return true;
+}
+
+/*
+ * Switch a classic buffer group over to size classes, done the first time
+ * a buffer length that differs from the existing ones is provided.
+ */
+static void io_buffer_init_classes(struct io_buffer_list *bl)
+{
+	struct io_buffer_classes *classes;
+	struct io_buffer *buf, *tmp;
+	int i;
+
+	classes = kzalloc(sizeof(*classes), GFP_KERNEL_ACCOUNT);
+	if (!classes)
+		return;
+	for (i = 0; i < IO_BUF_NR_CLASSES; i++)
+		INIT_LIST_HEAD(&classes->lists[i]);
+	bl->classes = classes;
+
+	list_for_each_entry_safe(buf, tmp, &bl->buf_list, list)
+		list_move_tail(&buf->list, io_buffer_class_list(bl, buf->len));
+}
+
 void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags)
 {
 	struct io_ring_ctx *ctx = req->ctx;
@@ -66,7 +129,7 @@ void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags)
 
 	buf = req->kbuf;
 	bl = io_buffer_get_list(ctx, buf->bgid);
-	list_add(&buf->list, &bl->buf_list);
+	list_add(&buf->list, io_buffer_class_list(bl, buf->len));
 	req->flags &= ~REQ_F_BUFFER_SELECTED;
 	req->buf_index = buf->bgid;
 
@@ -107,13 +170,63 @@ unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags)
 	return cflags;
 }
 
+/*
+ * Find the buffer list to take a buffer from for a transfer of @want bytes,
+ * 0 meaning unknown. That's the smallest class holding a buffer that fits,
+ * or the largest smaller one if nothing fits. Without a size the largest
+ * available buffer is used.
+ */
+static struct list_head *io_buffer_class_select(struct io_buffer_list *bl,
+						size_t want)
+{
+	struct io_buffer_classes *classes = bl->classes;
+	struct io_buffer *kbuf;
+	int i, class;
+
+	if (!want)
+		class = IO_BUF_NR_CLASSES;
+	else
+		class = io_buffer_class(min_t(size_t, want, MAX_RW_COUNT));
+
+	if (class < IO_BUF_NR_CLASSES) {
+		struct list_head *list = &classes->lists[class];
+
+		/* buffers in the class of @want may still be a bit short */
+		if (!list_empty(list)) {
+			kbuf = list_first_entry(list, struct io_buffer, list);
+			if (kbuf->len >= want)
+				return list;
+		}
+		for (i = class + 1; i < IO_BUF_NR_CLASSES; i++) {
+			if (!list_empty(&classes->lists[i])) {
+				classes->nr_exhausted[class]++;
+				return &classes->lists[i];
+			}
+		}
+		classes->nr_exhausted[class]++;
+		class++;
+	}
+
+	for (i = class - 1; i >= 0; i--) {
+		if (!list_empty(&classes->lists[i]))
+			return &classes->lists[i];
+	}
+	return NULL;
+}
+
 static void __user *io_provided_buffer_select(struct io_kiocb *req, size_t *len,
+					      size_t want,
 					      struct io_buffer_list *bl)
 {
-	if (!list_empty(&bl->buf_list)) {
+	struct list_head *list = &bl->buf_list;
+
+	if (bl->classes)
+		list = io_buffer_class_select(bl, want);
+
+	if (list && !list_empty(list)) {
 		struct io_buffer *kbuf;
 
-		kbuf = list_first_entry(&bl->buf_list, struct io_buffer, list);
+		kbuf = list_first_entry(list, struct io_buffer, list);
 		list_del(&kbuf->list);
 		if (*len == 0 || *len > kbuf->len)
 			*len = kbuf->len;
@@ -169,8 +282,8 @@ static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
 	return u64_to_user_ptr(buf->addr);
 }
 
-void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
-			      unsigned int issue_flags)
+void __user *io_buffer_select_fit(struct io_kiocb *req, size_t *len,
+				  size_t want, unsigned int issue_flags)
 {
 	struct io_ring_ctx *ctx = req->ctx;
 	struct io_buffer_list *bl;
@@ -183,7 +296,7 @@ void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
 		if (bl->is_mapped)
 			ret = io_ring_buffer_select(req, len, bl, issue_flags);
 		else
-			ret = io_provided_buffer_select(req, len, bl);
+			ret = io_provided_buffer_select(req, len, want, bl);
 	}
 	io_ring_submit_unlock(req->ctx, issue_flags);
 	return ret;
@@ -243,6 +356,25 @@ static int __io_remove_buffers(struct io_ring_ctx *ctx,
 	/* protects io_buffers_cache */
 	lockdep_assert_held(&ctx->uring_lock);
 
+	if (bl->classes) {
+		int class;
+
+		for (class = 0; class < IO_BUF_NR_CLASSES; class++) {
+			struct list_head *list = &bl->classes->lists[class];
+
+			while (!list_empty(list)) {
+				struct io_buffer *nxt;
+
+				nxt = list_first_entry(list, struct io_buffer, list);
+				list_move(&nxt->list, &ctx->io_buffers_cache);
+				if (++i == nbufs)
+					return i;
+				cond_resched();
+			}
+		}
+		return i;
+	}
+
 	while (!list_empty(&bl->buf_list)) {
 		struct io_buffer *nxt;
 
@@ -266,11 +398,13 @@ void io_destroy_buffers(struct io_ring_ctx *ctx)
 		if (!ctx->io_bl)
 			break;
 		__io_remove_buffers(ctx, &ctx->io_bl[i], -1U);
+		kfree(ctx->io_bl[i].classes);
 	}
 
 	xa_for_each(&ctx->io_bl_xa, index, bl) {
 		xa_erase(&ctx->io_bl_xa, bl->bgid);
 		__io_remove_buffers(ctx, bl, -1U);
+		kfree(bl->classes);
 		kfree(bl);
 	}
 
@@ -408,19 +542,26 @@ static int io_refill_buffer_cache(struct io_ring_ctx *ctx)
 static int io_add_buffers(struct io_ring_ctx *ctx, struct io_provide_buf *pbuf,
 			  struct io_buffer_list *bl)
 {
+	__u32 len = min_t(__u32, pbuf->len, MAX_RW_COUNT);
 	struct io_buffer *buf;
 	u64 addr = pbuf->addr;
 	int i, bid = pbuf->bid;
 
+	if (!bl->classes && !list_empty(&bl->buf_list)) {
+		buf = list_first_entry(&bl->buf_list, struct io_buffer, list);
+		if (buf->len != len)
+			io_buffer_init_classes(bl);
+	}
+
 	for (i = 0; i < pbuf->nbufs; i++) {
 		if (list_empty(&ctx->io_buffers_cache) &&
 		    io_refill_buffer_cache(ctx))
 			break;
 		buf = list_first_entry(&ctx->io_buffers_cache, struct io_buffer,
 					list);
-		list_move_tail(&buf->list, &bl->buf_list);
+		list_move_tail(&buf->list, io_buffer_class_list(bl, len));
 		buf->addr = addr;
-		buf->len = min_t(__u32, pbuf->len, MAX_RW_COUNT);
+		buf->len = len;
 		buf->bid = bid;
 		buf->bgid = pbuf->bgid;
 		addr += pbuf->len;
@@ -573,8 +714,11 @@ int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
 	bl = io_buffer_get_list(ctx, reg.bgid);
 	if (bl) {
 		/* if mapped buffer ring OR classic exists, don't allow */
-		if (bl->is_mapped || !list_empty(&bl->buf_list))
+		if (bl->is_mapped || !io_buffer_list_empty(bl))
 			return -EEXIST;
+		/* an emptied classic group may still have its size classes */
+		kfree(bl->classes);
+		bl->classes = NULL;
 	} else {
 		free_bl = bl = kzalloc(sizeof(*bl), GFP_KERNEL);
 		if (!bl)
@@ -617,6 +761,8 @@ int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
 		return -EINVAL;
 
 	__io_remove_buffers(ctx, bl, -1U);
+	kfree(bl->classes);
+	bl->classes = NULL;
 	if (bl->bgid >= BGID_ARRAY) {
 		xa_erase(&ctx->io_bl_xa, bl->bgid);
 		kfree(bl);
@@ -634,3 +780,34 @@ void *io_pbuf_get_address(struct io_ring_ctx *ctx, unsigned long bgid)
 
 	return bl->buf_ring;
 }
+
+#ifdef CONFIG_PROC_FS
+static void io_kbuf_show_classes(struct io_buffer_list *bl, struct seq_file *m)
+{
+	int i;
+
+	if (!bl->classes)
+		return;
+	seq_printf(m, "%5u:", bl->bgid);
+	for (i = 0; i < IO_BUF_NR_CLASSES; i++)
+		seq_printf(m, " %lu", bl->classes->nr_exhausted[i]);
+	seq_putc(m, '\n');
+}
+
+/*
+ * Show how often each size class of a buffer group was found empty, the
+ * first class holds buffers below 128 bytes. Must hold ->uring_lock.
+ */
+void io_kbuf_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m)
+{
+	struct io_buffer_list *bl;
+	unsigned long index;
+	int i;
+
+	seq_puts(m, "BufClassExhausted:\n");
+	for (i = 0; ctx->io_bl && i < BGID_ARRAY; i++)
+		io_kbuf_show_classes(&ctx->io_bl[i], m);
+	xa_for_each(&ctx->io_bl_xa, index, bl)
+		io_kbuf_show_classes(bl, m);
+}
+#endif
@@ -4,6 +4,8 @@
 
 #include <uapi/linux/io_uring.h>
 
+struct seq_file;
+
 struct io_buffer_list {
 	/*
 	 * If ->buf_nr_pages is set, then buf_pages/buf_ring are used. If not,
@@ -18,6 +20,9 @@ struct io_buffer_list {
 	};
 	__u16 bgid;
 
+	/* classic buffers of mixed sizes, sorted into size classes */
+	struct io_buffer_classes *classes;
+
 	/* below is for ring provided buffers */
 	__u16 buf_nr_pages;
 	__u16 nr_entries;
@@ -38,9 +43,10 @@ struct io_buffer {
 	__u16 bgid;
 };
 
-void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
-			      unsigned int issue_flags);
+void __user *io_buffer_select_fit(struct io_kiocb *req, size_t *len,
+				  size_t want, unsigned int issue_flags);
 void io_destroy_buffers(struct io_ring_ctx *ctx);
+void io_kbuf_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m);
 
 int io_remove_buffers_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe);
 int io_remove_buffers(struct io_kiocb *req, unsigned int issue_flags);
@@ -57,6 +63,12 @@ void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags);
 
 void *io_pbuf_get_address(struct io_ring_ctx *ctx, unsigned long bgid);
 
+static inline void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
+					    unsigned int issue_flags)
+{
+	return io_buffer_select_fit(req, len, *len, issue_flags);
+}
+
 static inline void io_kbuf_recycle_ring(struct io_kiocb *req)
 {
 	/*
@@ -6,6 +6,7 @@
 #include <linux/net.h>
 #include <linux/compat.h>
 #include <net/compat.h>
+#include <net/tcp.h>
 #include <linux/io_uring.h>
 
 #include <uapi/linux/io_uring.h>
@@ -727,6 +728,21 @@ static int io_recvmsg_multishot(struct socket *sock, struct io_sr_msg *io,
 			kmsg->controllen + err;
 }
 
+/*
+ * Guess how much the next receive returns, so a buffer group with mixed
+ * buffer sizes can hand out one that fits. Only TCP gives a cheap answer.
+ */
+static size_t io_recv_len_hint(struct socket *sock, size_t len)
+{
+	struct sock *sk = sock->sk;
+
+	if (len)
+		return len;
+	if (sk->sk_type == SOCK_STREAM && sk->sk_protocol == IPPROTO_TCP)
+		return max(tcp_inq(sk), 0);
+	return 0;
+}
+
 int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 {
 	struct io_sr_msg *sr = io_kiocb_to_cmd(req, struct io_sr_msg);
@@ -763,7 +779,9 @@ int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 		void __user *buf;
 		size_t len = sr->len;
 
-		buf = io_buffer_select(req, &len, issue_flags);
+		buf = io_buffer_select_fit(req, &len,
+					   io_recv_len_hint(sock, len),
+					   issue_flags);
 		if (!buf)
 			return -ENOBUFS;
 
@@ -864,7 +882,9 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	if (io_do_buffer_select(req)) {
 		void __user *buf;
 
-		buf = io_buffer_select(req, &len, issue_flags);
+		buf = io_buffer_select_fit(req, &len,
+					   io_recv_len_hint(sock, len),
+					   issue_flags);
 		if (!buf)
 			return -ENOBUFS;
 		sr->buf = buf;
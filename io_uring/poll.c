@@ -7,6 +7,8 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/hashtable.h>
+#include <linux/hrtimer.h>
+#include <linux/sysctl.h>
 #include <linux/io_uring.h>
 
 #include <trace/events/io_uring.h>
@@ -373,6 +375,72 @@ static void __io_poll_execute(struct io_kiocb *req, int mask)
 	io_req_task_work_add(req);
 }
 
+/*
+ * Multishot wakeups can be held back for up to this long, so that a busy
+ * ring handles all its readiness events in one task_work pass instead of
+ * paying a task_work round trip per event. Further wakeups of a request that
+ * is already batched are folded into its poll_refs and served by the same
+ * pass. 0 disables coalescing, takes effect for newly created rings.
+ */
+static unsigned int io_poll_coalesce_usec;
+
+static enum hrtimer_restart io_poll_batch_fn(struct hrtimer *timer)
+{
+	struct io_ring_ctx *ctx = container_of(timer, struct io_ring_ctx,
+					       poll_batch_timer);
+	struct llist_node *node = llist_del_all(&ctx->poll_batch);
+
+	/*
+	 * Don't touch ctx once the last request is queued, it may go away.
+	 * io_poll_ctx_exit() waits for us to finish.
+	 */
+	node = llist_reverse_order(node);
+	while (node) {
+		struct io_kiocb *req = container_of(node, struct io_kiocb,
+						    io_task_work.node);
+
+		node = node->next;
+		trace_io_uring_task_add(req, req->cqe.res);
+		io_req_task_work_add(req);
+	}
+	return HRTIMER_NORESTART;
+}
+
+/* called with poll ownership held */
+static void io_poll_execute_batched(struct io_kiocb *req, struct io_poll *poll,
+				    int mask)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (!ctx->poll_coalesce_ns || (poll->events & EPOLLONESHOT)) {
+		__io_poll_execute(req, mask);
+		return;
+	}
+
+	io_req_set_res(req, mask, 0);
+	req->io_task_work.func = io_poll_task_func;
+	if (llist_add(&req->io_task_work.node, &ctx->poll_batch))
+		hrtimer_start(&ctx->poll_batch_timer,
+			      ns_to_ktime(ctx->poll_coalesce_ns),
+			      HRTIMER_MODE_REL);
+}
+
+void io_poll_ctx_init(struct io_ring_ctx *ctx)
+{
+	init_llist_head(&ctx->poll_batch);
+	hrtimer_init(&ctx->poll_batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ctx->poll_batch_timer.function = io_poll_batch_fn;
+	ctx->poll_coalesce_ns = (u64)READ_ONCE(io_poll_coalesce_usec) *
+				NSEC_PER_USEC;
+}
+
+void io_poll_ctx_exit(struct io_ring_ctx *ctx)
+{
+	/* batched requests pin the ctx, the list must be empty by now */
+	WARN_ON_ONCE(!llist_empty(&ctx->poll_batch));
+	hrtimer_cancel(&ctx->poll_batch_timer);
+}
+
 static inline void io_poll_execute(struct io_kiocb *req, int res)
 {
 	if (io_poll_get_ownership(req))
@@ -445,7 +513,7 @@ static int io_poll_wake(struct wait_queue_entry *wait, unsigned mode, int sync,
 			else
 				req->flags &= ~REQ_F_SINGLE_POLL;
 		}
-		__io_poll_execute(req, mask);
+		io_poll_execute_batched(req, poll, mask);
 	}
 	return 1;
 }
@@ -1043,3 +1111,24 @@ void io_apoll_cache_free(struct io_cache_entry *entry)
 {
 	kfree(container_of(entry, struct async_poll, cache));
 }
+
+#ifdef CONFIG_SYSCTL
+static struct ctl_table io_poll_sysctl_table[] = {
+	{
+		.procname	= "io_uring_poll_coalesce_usec",
+		.data		= &io_poll_coalesce_usec,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra2		= SYSCTL_ONE_THOUSAND,
+	},
+	{}
+};
+
+static __init int io_poll_sysctl_init(void)
+{
+	register_sysctl_init("kernel", io_poll_sysctl_table);
+	return 0;
+}
+__initcall(io_poll_sysctl_init);
+#endif
@@ -38,3 +38,6 @@ bool io_poll_remove_all(struct io_ring_ctx *ctx, struct task_struct *tsk,
 			bool cancel_all);
 
 void io_apoll_cache_free(struct io_cache_entry *entry);
+
+void io_poll_ctx_init(struct io_ring_ctx *ctx);
+void io_poll_ctx_exit(struct io_ring_ctx *ctx);
@@ -26,13 +26,27 @@ struct io_rsrc_update {
 static void io_rsrc_buf_put(struct io_ring_ctx *ctx, struct io_rsrc_put *prsrc);
 static void io_rsrc_file_put(struct io_ring_ctx *ctx, struct io_rsrc_put *prsrc);
 static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
-				  struct io_mapped_ubuf **pimu,
-				  struct page **last_hpage);
+				  struct io_mapped_ubuf **pimu);
 
 /* only define max */
 #define IORING_MAX_FIXED_FILES	(1U << 20)
 #define IORING_MAX_REG_BUFFERS	(1U << 14)
 
+/*
+ * Compound pages pinned by registered buffers are charged once per owner,
+ * that is the user and mm being charged, however many buffers of however
+ * many rings map them. Indexed by the pfn of the head page.
+ */
+struct io_acct_hpage {
+	struct io_acct_hpage	*next;
+	struct user_struct	*user;
+	struct mm_struct	*mm;
+	unsigned long		refs;
+};
+
+static DEFINE_XARRAY(io_acct_hpages);
+static DEFINE_MUTEX(io_acct_hpages_lock);
+
 int __io_account_mem(struct user_struct *user, unsigned long nr_pages)
 {
 	unsigned long page_limit, cur_pages, new_pages;
@@ -127,16 +141,101 @@ static int io_buffer_validate(struct iovec *iov)
 	return 0;
 }
 
+/*
+ * Take a reference on the accounting entry of @hpage for the owner of @ctx.
+ * @charge is set if this is the first one, and the caller has to charge it.
+ */
+static int io_hpage_acct_get(struct io_ring_ctx *ctx, struct page *hpage,
+			     bool *charge)
+	__must_hold(&io_acct_hpages_lock)
+{
+	unsigned long pfn = page_to_pfn(hpage);
+	struct io_acct_hpage *head, *ah;
+
+	head = xa_load(&io_acct_hpages, pfn);
+	for (ah = head; ah; ah = ah->next) {
+		if (ah->user == ctx->user && ah->mm == ctx->mm_account) {
+			ah->refs++;
+			*charge = false;
+			return 0;
+		}
+	}
+
+	ah = kmalloc(sizeof(*ah), GFP_KERNEL_ACCOUNT);
+	if (!ah)
+		return -ENOMEM;
+	ah->user = ctx->user;
+	ah->mm = ctx->mm_account;
+	ah->refs = 1;
+	ah->next = head;
+	if (xa_err(xa_store(&io_acct_hpages, pfn, ah, GFP_KERNEL))) {
+		kfree(ah);
+		return -ENOMEM;
+	}
+	*charge = true;
+	return 0;
+}
+
+/*
+ * Drop the reference io_hpage_acct_get() took for @page, if it's part of a
+ * compound page and not the same one as the last page looked at. Returns the
+ * number of pages to uncharge if this was the last reference of the owner.
+ */
+static unsigned long io_hpage_acct_put(struct io_ring_ctx *ctx,
+				       struct page *page,
+				       struct page **last_hpage)
+	__must_hold(&io_acct_hpages_lock)
+{
+	struct io_acct_hpage *head, *ah, **pprev;
+	struct page *hpage;
+	unsigned long pfn;
+
+	if (!PageCompound(page))
+		return 0;
+	hpage = compound_head(page);
+	if (hpage == *last_hpage)
+		return 0;
+	*last_hpage = hpage;
+
+	pfn = page_to_pfn(hpage);
+	head = xa_load(&io_acct_hpages, pfn);
+	for (pprev = &head; (ah = *pprev) != NULL; pprev = &ah->next) {
+		if (ah->user != ctx->user || ah->mm != ctx->mm_account)
+			continue;
+		if (--ah->refs)
+			return 0;
+		*pprev = ah->next;
+		if (head)
+			xa_store(&io_acct_hpages, pfn, head, GFP_KERNEL);
+		else
+			xa_erase(&io_acct_hpages, pfn);
+		kfree(ah);
+		return page_size(hpage) >> PAGE_SHIFT;
+	}
+
+	WARN_ON_ONCE(1);
+	return 0;
+}
+
 static void io_buffer_unmap(struct io_ring_ctx *ctx, struct io_mapped_ubuf **slot)
 {
 	struct io_mapped_ubuf *imu = *slot;
 	unsigned int i;
 
 	if (imu != ctx->dummy_ubuf) {
-		for (i = 0; i < imu->nr_bvecs; i++)
-			unpin_user_page(imu->bvec[i].bv_page);
-		if (imu->acct_pages)
-			io_unaccount_mem(ctx, imu->acct_pages);
+		unsigned long acct_pages = imu->acct_pages;
+		struct page *last_hpage = NULL;
+
+		mutex_lock(&io_acct_hpages_lock);
+		for (i = 0; i < imu->nr_bvecs; i++) {
+			struct page *page = imu->bvec[i].bv_page;
+
+			acct_pages += io_hpage_acct_put(ctx, page, &last_hpage);
+			unpin_user_page(page);
+		}
+		mutex_unlock(&io_acct_hpages_lock);
+		if (acct_pages)
+			io_unaccount_mem(ctx, acct_pages);
 		kvfree(imu);
 	}
 	*slot = NULL;
@@ -427,7 +526,6 @@ static int __io_sqe_buffers_update(struct io_ring_ctx *ctx,
 {
 	u64 __user *tags = u64_to_user_ptr(up->tags);
 	struct iovec iov, __user *iovs = u64_to_user_ptr(up->data);
-	struct page *last_hpage = NULL;
 	__u32 done;
 	int i, err;
 
@@ -454,7 +552,7 @@ static int __io_sqe_buffers_update(struct io_ring_ctx *ctx,
 			err = -EINVAL;
 			break;
 		}
-		err = io_sqe_buffer_register(ctx, &iov, &imu, &last_hpage);
+		err = io_sqe_buffer_register(ctx, &iov, &imu);
 		if (err)
 			break;
 
@@ -959,72 +1057,152 @@ int io_sqe_buffers_unregister(struct io_ring_ctx *ctx)
 }
 
 /*
- * Not super efficient, but this is just a registration time. And we do cache
- * the last compound head, so generally we'll only do a full search if we don't
- * match that one.
- *
- * We check if the given compound head page has already been accounted, to
- * avoid double accounting it. This allows us to account the full size of the
- * page, not just the constituent pages of a huge page.
+ * Regular pages are charged per buffer. Compound pages are charged only for
+ * the first buffer of this owner that maps them, see struct io_acct_hpage.
+ * This allows us to account the full size of the page, not just the
+ * constituent pages of a huge page, and only once if it's registered again.
  */
-static bool headpage_already_acct(struct io_ring_ctx *ctx, struct page **pages,
-				  int nr_pages, struct page *hpage)
+static int io_buffer_account_pin(struct io_ring_ctx *ctx, struct page **pages,
+				 int nr_pages, struct io_mapped_ubuf *imu)
 {
-	int i, j;
+	struct page *last_hpage = NULL;
+	unsigned long hpages = 0;
+	int i, ret = 0;
 
-	/* check current page array */
+	imu->acct_pages = 0;
+	mutex_lock(&io_acct_hpages_lock);
 	for (i = 0; i < nr_pages; i++) {
-		if (!PageCompound(pages[i]))
+		struct page *hpage;
+		bool charge;
+
+		if (!PageCompound(pages[i])) {
+			imu->acct_pages++;
+			continue;
+		}
+		hpage = compound_head(pages[i]);
+		if (hpage == last_hpage)
 			continue;
-		if (compound_head(pages[i]) == hpage)
-			return true;
+		last_hpage = hpage;
+		ret = io_hpage_acct_get(ctx, hpage, &charge);
+		if (ret)
+			break;
+		if (charge)
+			hpages += page_size(hpage) >> PAGE_SHIFT;
 	}
 
-	/* check previously registered pages */
-	for (i = 0; i < ctx->nr_user_bufs; i++) {
-		struct io_mapped_ubuf *imu = ctx->user_bufs[i];
+	if (!ret && (imu->acct_pages || hpages))
+		ret = io_account_mem(ctx, imu->acct_pages + hpages);
+	if (ret) {
+		int nr = i;
 
-		for (j = 0; j < imu->nr_bvecs; j++) {
-			if (!PageCompound(imu->bvec[j].bv_page))
-				continue;
-			if (compound_head(imu->bvec[j].bv_page) == hpage)
-				return true;
-		}
+		last_hpage = NULL;
+		for (i = 0; i < nr; i++)
+			io_hpage_acct_put(ctx, pages[i], &last_hpage);
+		imu->acct_pages = 0;
 	}
-
-	return false;
+	mutex_unlock(&io_acct_hpages_lock);
+	return ret;
 }
 
-static int io_buffer_account_pin(struct io_ring_ctx *ctx, struct page **pages,
-				 int nr_pages, struct io_mapped_ubuf *imu,
-				 struct page **last_hpage)
+struct io_imu_folio_data {
+	/* pages of the first folio that are part of the buffer */
+	unsigned int	nr_pages_head;
+	/* pages of each of the following folios */
+	unsigned int	nr_pages_mid;
+	unsigned int	folio_shift;
+	unsigned int	nr_folios;
+};
+
+/*
+ * Check if the pinned pages can be turned into one bvec per folio. That needs
+ * all folios to be of the same size and to be mapped in full and in order,
+ * except for the start of the first and the end of the last one.
+ */
+static bool io_check_coalesce_buffer(struct page **pages, int nr_pages,
+				     struct io_imu_folio_data *data)
 {
-	int i, ret;
+	struct folio *folio = page_folio(pages[0]);
+	unsigned int count = 1, nr_folios = 1;
+	int i;
 
-	imu->acct_pages = 0;
-	for (i = 0; i < nr_pages; i++) {
-		if (!PageCompound(pages[i])) {
-			imu->acct_pages++;
-		} else {
-			struct page *hpage;
+	if (nr_pages <= 1)
+		return false;
 
-			hpage = compound_head(pages[i]);
-			if (hpage == *last_hpage)
-				continue;
-			*last_hpage = hpage;
-			if (headpage_already_acct(ctx, pages, i, hpage))
-				continue;
-			imu->acct_pages += page_size(hpage) >> PAGE_SHIFT;
+	data->nr_pages_mid = folio_nr_pages(folio);
+	if (data->nr_pages_mid == 1)
+		return false;
+	data->folio_shift = folio_shift(folio);
+
+	for (i = 1; i < nr_pages; i++) {
+		if (page_folio(pages[i]) == folio &&
+		    pages[i] == pages[i - 1] + 1) {
+			count++;
+			continue;
 		}
+
+		if (nr_folios == 1) {
+			/* the first folio has to be used up to its end */
+			if (folio_page_idx(folio, pages[i - 1]) !=
+			    data->nr_pages_mid - 1)
+				return false;
+			data->nr_pages_head = count;
+		} else if (count != data->nr_pages_mid) {
+			return false;
+		}
+
+		folio = page_folio(pages[i]);
+		if (folio_size(folio) != (1UL << data->folio_shift) ||
+		    folio_page_idx(folio, pages[i]) != 0)
+			return false;
+
+		count = 1;
+		nr_folios++;
 	}
+	if (nr_folios == 1)
+		data->nr_pages_head = count;
 
-	if (!imu->acct_pages)
-		return 0;
+	data->nr_folios = nr_folios;
+	return true;
+}
 
-	ret = io_account_mem(ctx, imu->acct_pages);
-	if (ret)
-		imu->acct_pages = 0;
-	return ret;
+/*
+ * Replace the page array with one holding the first page of each folio.
+ * The pages are bound to the folio, it doesn't actually unpin them but drops
+ * all but one reference per folio, which is put down by io_buffer_unmap().
+ */
+static bool io_coalesce_buffer(struct page ***pages, int *nr_pages,
+			       struct io_imu_folio_data *data)
+{
+	struct page **page_array = *pages, **new_array;
+	int nr_left = *nr_pages, i, j;
+
+	new_array = kvmalloc_array(data->nr_folios, sizeof(struct page *),
+				   GFP_KERNEL);
+	if (!new_array)
+		return false;
+
+	new_array[0] = compound_head(page_array[0]);
+	if (data->nr_pages_head > 1)
+		unpin_user_pages(&page_array[1], data->nr_pages_head - 1);
+
+	j = data->nr_pages_head;
+	nr_left -= data->nr_pages_head;
+	for (i = 1; i < data->nr_folios; i++) {
+		unsigned int nr_unpin;
+
+		new_array[i] = page_array[j];
+		nr_unpin = min_t(unsigned int, nr_left - 1,
+				 data->nr_pages_mid - 1);
+		if (nr_unpin)
+			unpin_user_pages(&page_array[j + 1], nr_unpin);
+		j += data->nr_pages_mid;
+		nr_left -= data->nr_pages_mid;
+	}
+
+	kvfree(page_array);
+	*pages = new_array;
+	*nr_pages = data->nr_folios;
+	return true;
 }
 
 struct page **io_pin_pages(unsigned long ubuf, unsigned long len, int *npages)
@@ -1089,15 +1267,15 @@ struct page **io_pin_pages(unsigned long ubuf, unsigned long len, int *npages)
 }
 
 static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
-				  struct io_mapped_ubuf **pimu,
-				  struct page **last_hpage)
+				  struct io_mapped_ubuf **pimu)
 {
 	struct io_mapped_ubuf *imu = NULL;
+	struct io_imu_folio_data data;
 	struct page **pages = NULL;
+	unsigned int folio_shift = PAGE_SHIFT;
 	unsigned long off;
 	size_t size;
 	int ret, nr_pages, i;
-	struct folio *folio = NULL;
 
 	*pimu = ctx->dummy_ubuf;
 	if (!iov->iov_base)
@@ -1112,29 +1290,17 @@ static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 		goto done;
 	}
 
-	/* If it's a huge page, try to coalesce them into a single bvec entry */
-	if (nr_pages > 1) {
-		folio = page_folio(pages[0]);
-		for (i = 1; i < nr_pages; i++) {
-			/*
-			 * Pages must be consecutive and on the same folio for
-			 * this to work
-			 */
-			if (page_folio(pages[i]) != folio ||
-			    pages[i] != pages[i - 1] + 1) {
-				folio = NULL;
-				break;
-			}
-		}
-		if (folio) {
-			/*
-			 * The pages are bound to the folio, it doesn't
-			 * actually unpin them but drops all but one reference,
-			 * which is usually put down by io_buffer_unmap().
-			 * Note, needs a better helper.
-			 */
-			unpin_user_pages(&pages[1], nr_pages - 1);
-			nr_pages = 1;
+	off = (unsigned long) iov->iov_base & ~PAGE_MASK;
+
+	/* If it's backed by large folios, try to coalesce them into one bvec each */
+	if (io_check_coalesce_buffer(pages, nr_pages, &data)) {
+		struct folio *folio = page_folio(pages[0]);
+		unsigned long head_off;
+
+		head_off = folio_page_idx(folio, pages[0]) << PAGE_SHIFT;
+		if (io_coalesce_buffer(&pages, &nr_pages, &data)) {
+			folio_shift = data.folio_shift;
+			off += head_off;
 		}
 	}
 
@@ -1142,29 +1308,25 @@ static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 	if (!imu)
 		goto done;
 
-	ret = io_buffer_account_pin(ctx, pages, nr_pages, imu, last_hpage);
+	ret = io_buffer_account_pin(ctx, pages, nr_pages, imu);
 	if (ret) {
 		unpin_user_pages(pages, nr_pages);
 		goto done;
 	}
 
-	off = (unsigned long) iov->iov_base & ~PAGE_MASK;
 	size = iov->iov_len;
 	/* store original address for later verification */
 	imu->ubuf = (unsigned long) iov->iov_base;
 	imu->ubuf_end = imu->ubuf + iov->iov_len;
 	imu->nr_bvecs = nr_pages;
+	imu->folio_shift = folio_shift;
 	*pimu = imu;
 	ret = 0;
 
-	if (folio) {
-		bvec_set_page(&imu->bvec[0], pages[0], size, off);
-		goto done;
-	}
 	for (i = 0; i < nr_pages; i++) {
 		size_t vec_len;
 
-		vec_len = min_t(size_t, size, PAGE_SIZE - off);
+		vec_len = min_t(size_t, size, (1UL << folio_shift) - off);
 		bvec_set_page(&imu->bvec[i], pages[i], vec_len, off);
 		off = 0;
 		size -= vec_len;
@@ -1185,7 +1347,6 @@ static int io_buffers_map_alloc(struct io_ring_ctx *ctx, unsigned int nr_args)
 int io_sqe_buffers_register(struct io_ring_ctx *ctx, void __user *arg,
 			    unsigned int nr_args, u64 __user *tags)
 {
-	struct page *last_hpage = NULL;
 	struct io_rsrc_data *data;
 	int i, ret;
 	struct iovec iov;
@@ -1222,8 +1383,7 @@ int io_sqe_buffers_register(struct io_ring_ctx *ctx, void __user *arg,
 			break;
 		}
 
-		ret = io_sqe_buffer_register(ctx, &iov, &ctx->user_bufs[i],
-					     &last_hpage);
+		ret = io_sqe_buffer_register(ctx, &iov, &ctx->user_bufs[i]);
 		if (ret)
 			break;
 	}
@@ -1266,23 +1426,18 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 		 * we know that:
 		 *
 		 * 1) it's a BVEC iter, we set it up
-		 * 2) all bvecs are PAGE_SIZE in size, except potentially the
-		 *    first and last bvec
+		 * 2) all bvecs are 1 << folio_shift in size, except potentially
+		 *    the first and last bvec
 		 *
 		 * So just find our index, and adjust the iterator afterwards.
 		 * If the offset is within the first bvec (or the whole first
 		 * bvec, just use iov_iter_advance(). This makes it easier
 		 * since we can just skip the first segment, which may not
-		 * be PAGE_SIZE aligned.
+		 * be aligned to the folio size.
 		 */
 		const struct bio_vec *bvec = imu->bvec;
 
 		if (offset <= bvec->bv_len) {
-			/*
-			 * Note, huge pages buffers consists of one large
-			 * bvec entry and should always go this way. The other
-			 * branch doesn't expect non PAGE_SIZE'd chunks.
-			 */
 			iter->bvec = bvec;
 			iter->nr_segs = bvec->bv_len;
 			iter->count -= offset;
@@ -1292,12 +1447,12 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 
 			/* skip first vec */
 			offset -= bvec->bv_len;
-			seg_skip = 1 + (offset >> PAGE_SHIFT);
+			seg_skip = 1 + (offset >> imu->folio_shift);
 
 			iter->bvec = bvec + seg_skip;
 			iter->nr_segs -= seg_skip;
 			iter->count -= bvec->bv_len + offset;
-			iter->iov_offset = offset & ~PAGE_MASK;
+			iter->iov_offset = offset & ((1UL << imu->folio_shift) - 1);
 		}
 	}
 
@@ -10,6 +10,7 @@
 #include <linux/slab.h>
 #include <linux/audit.h>
 #include <linux/security.h>
+#include <linux/sched/clock.h>
 #include <linux/io_uring.h>
 
 #include <uapi/linux/io_uring.h>
@@ -18,6 +19,8 @@
 #include "sqpoll.h"
 
 #define IORING_SQPOLL_CAP_ENTRIES_VALUE 8
+/* arrival gap average is kept in units of 1/8th jiffy */
+#define IORING_SQPOLL_GAP_SHIFT		3
 
 enum {
 	IO_SQ_THREAD_SHOULD_STOP = 0,
@@ -164,19 +167,69 @@ static inline bool io_sqd_events_pending(struct io_sq_data *sqd)
 	return READ_ONCE(sqd->state);
 }
 
+/*
+ * Submission quantum of a ring that shares its SQPOLL thread with others.
+ * Rings get a share proportional to the nice level of the task that set
+ * them up, with nice 0 getting IORING_SQPOLL_CAP_ENTRIES_VALUE per round.
+ */
+static unsigned int io_sq_quantum(void)
+{
+	unsigned int prio = MAX_NICE - task_nice(current) + 1;
+
+	return max(1U, IORING_SQPOLL_CAP_ENTRIES_VALUE * prio / (MAX_NICE + 1));
+}
+
+/*
+ * Track the average gap between SQ arrivals, an adaptive ring only keeps
+ * the thread spinning for as long as another arrival is expected within
+ * its idle period.
+ */
+static void io_sq_note_arrival(struct io_ring_ctx *ctx)
+{
+	unsigned long gap = jiffies - ctx->sq_last_arrival;
+
+	ctx->sq_last_arrival = jiffies;
+	gap = min_t(unsigned long, gap, ctx->sq_thread_idle + 1);
+	ctx->sq_avg_gap += gap - (ctx->sq_avg_gap >> IORING_SQPOLL_GAP_SHIFT);
+}
+
+static unsigned long io_sq_ctx_idle(struct io_ring_ctx *ctx)
+{
+	unsigned long spin;
+
+	if (!ctx->sq_idle_adaptive)
+		return ctx->sq_thread_idle;
+	spin = 2 * (ctx->sq_avg_gap >> IORING_SQPOLL_GAP_SHIFT);
+	if (spin > ctx->sq_thread_idle)
+		return 1;
+	return max(spin, 1UL);
+}
+
 static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 {
 	unsigned int to_submit;
 	int ret = 0;
 
 	to_submit = io_sqring_entries(ctx);
-	/* if we're handling multiple rings, cap submit size for fairness */
-	if (cap_entries && to_submit > IORING_SQPOLL_CAP_ENTRIES_VALUE)
-		to_submit = IORING_SQPOLL_CAP_ENTRIES_VALUE;
+	/*
+	 * If we're handling multiple rings, do deficit round robin between
+	 * them for fairness. An idle ring doesn't get to bank its share.
+	 */
+	if (cap_entries) {
+		if (!to_submit) {
+			ctx->sq_deficit = 0;
+		} else {
+			ctx->sq_deficit += ctx->sq_quantum;
+			to_submit = min(to_submit, ctx->sq_deficit);
+		}
+	}
 
 	if (!wq_list_empty(&ctx->iopoll_list) || to_submit) {
 		const struct cred *creds = NULL;
+		u64 start = local_clock();
 
+		if (to_submit)
+			io_sq_note_arrival(ctx);
 		if (ctx->sq_creds != current_cred())
 			creds = override_creds(ctx->sq_creds);
 
@@ -197,6 +250,9 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 			wake_up(&ctx->sqo_sq_wait);
 		if (creds)
 			revert_creds(creds);
+		if (cap_entries && ret > 0)
+			ctx->sq_deficit -= min_t(unsigned int, ret, ctx->sq_deficit);
+		ctx->sq_work_time += local_clock() - start;
 	}
 
 	return ret;
@@ -222,7 +278,7 @@ static int io_sq_thread(void *data)
 {
 	struct io_sq_data *sqd = data;
 	struct io_ring_ctx *ctx;
-	unsigned long timeout = 0;
+	unsigned long timeout = 0, idle;
 	char buf[TASK_COMM_LEN];
 	DEFINE_WAIT(wait);
 
@@ -245,11 +301,13 @@ static int io_sq_thread(void *data)
 		}
 
 		cap_entries = !list_is_singular(&sqd->ctx_list);
+		idle = 0;
 		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
 			int ret = __io_sq_thread(ctx, cap_entries);
 
 			if (!sqt_spin && (ret > 0 || !wq_list_empty(&ctx->iopoll_list)))
 				sqt_spin = true;
+			idle = max(idle, io_sq_ctx_idle(ctx));
 		}
 		if (io_run_task_work())
 			sqt_spin = true;
@@ -257,7 +315,7 @@ static int io_sq_thread(void *data)
 		if (sqt_spin || !time_after(jiffies, timeout)) {
 			cond_resched();
 			if (sqt_spin)
-				timeout = jiffies + sqd->sq_thread_idle;
+				timeout = jiffies + idle;
 			continue;
 		}
 
@@ -297,7 +355,7 @@ static int io_sq_thread(void *data)
 		}
 
 		finish_wait(&sqd->wait, &wait);
-		timeout = jiffies + sqd->sq_thread_idle;
+		timeout = jiffies + idle;
 	}
 
 	io_uring_cancel_generic(true, sqd);
@@ -365,8 +423,17 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 		ctx->sq_creds = get_current_cred();
 		ctx->sq_data = sqd;
 		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
-		if (!ctx->sq_thread_idle)
+		/*
+		 * Without an explicit idle period, use the default as an upper
+		 * bound and size it by the arrival rate seen on the ring.
+		 */
+		if (!ctx->sq_thread_idle) {
 			ctx->sq_thread_idle = HZ;
+			ctx->sq_idle_adaptive = true;
+		}
+		ctx->sq_quantum = io_sq_quantum();
+		ctx->sq_last_arrival = jiffies;
+		ctx->sq_avg_gap = 0;
 
 		io_sq_thread_park(sqd);
 		list_add(&ctx->sqd_list, &sqd->ctx_list);
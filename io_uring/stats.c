@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Optional per-opcode latency accounting, exposed through fdinfo.
+ *
+ * Disabled by default, and then it costs no more than a patched out jump in
+ * the hot paths. Once kernel.io_uring_latency_stats is set, newly created
+ * rings allocate a histogram table and record issue to completion latency
+ * of every request, how requests were dispatched (inline, armed poll or
+ * punted to io-wq), and how long CQEs spent on the overflow list.
+ */
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/seq_file.h>
+#include <linux/sysctl.h>
+#include <linux/io_uring.h>
+
+#include <uapi/linux/io_uring.h>
+
+#include "io_uring.h"
+#include "opdef.h"
+#include "stats.h"
+
+DEFINE_STATIC_KEY_FALSE(io_lat_stats_key);
+
+int io_lat_stats_alloc(struct io_ring_ctx *ctx)
+{
+	if (!static_branch_unlikely(&io_lat_stats_key))
+		return 0;
+	ctx->lat_stats = kvzalloc(sizeof(*ctx->lat_stats), GFP_KERNEL_ACCOUNT);
+	return ctx->lat_stats ? 0 : -ENOMEM;
+}
+
+void io_lat_stats_free(struct io_ring_ctx *ctx)
+{
+	kvfree(ctx->lat_stats);
+	ctx->lat_stats = NULL;
+}
+
+#ifdef CONFIG_PROC_FS
+static void io_lat_show_hist(struct seq_file *m, const unsigned long *hist)
+{
+	int i;
+
+	for (i = 0; i < IO_LAT_BUCKETS; i++) {
+		if (hist[i])
+			seq_printf(m, " %u:%lu", 1U << i, hist[i]);
+	}
+	seq_putc(m, '\n');
+}
+
+/* called with ->uring_lock held */
+void io_lat_stats_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m)
+{
+	struct io_lat_stats *stats = ctx->lat_stats;
+	int i;
+
+	if (!stats)
+		return;
+
+	seq_puts(m, "LatencyStats:\n");
+	for (i = 0; i < IORING_OP_LAST; i++) {
+		struct io_op_stats *st = &stats->ops[i];
+		long nr_inline = atomic_long_read(&st->nr_inline);
+		long nr_poll = atomic_long_read(&st->nr_poll);
+		long nr_iowq = atomic_long_read(&st->nr_iowq);
+
+		if (!nr_inline && !nr_poll && !nr_iowq)
+			continue;
+		seq_printf(m, "  op=%s inline=%ld poll=%ld iowq=%ld lat_us:",
+			   io_uring_get_opcode(i), nr_inline, nr_poll, nr_iowq);
+		io_lat_show_hist(m, st->lat);
+	}
+
+	spin_lock(&ctx->completion_lock);
+	seq_puts(m, "  CqOverflowWait_us:");
+	io_lat_show_hist(m, stats->overflow_wait);
+	spin_unlock(&ctx->completion_lock);
+}
+#endif
+
+#ifdef CONFIG_SYSCTL
+static struct ctl_table io_lat_stats_table[] = {
+	{
+		.procname	= "io_uring_latency_stats",
+		.data		= &io_lat_stats_key.key,
+		.mode		= 0644,
+		.proc_handler	= proc_do_static_key,
+	},
+	{}
+};
+
+static __init int io_lat_stats_init(void)
+{
+	register_sysctl_init("kernel", io_lat_stats_table);
+	return 0;
+}
+__initcall(io_lat_stats_init);
+#endif
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef IOU_STATS_H
+#define IOU_STATS_H
+
+#include <linux/jump_label.h>
+#include <linux/log2.h>
+#include <linux/sched/clock.h>
+
+struct seq_file;
+
+/*
+ * log2 buckets of roughly microseconds, the last one collects everything
+ * taking longer than ~8 seconds.
+ */
+#define IO_LAT_BUCKETS		24
+
+struct io_op_stats {
+	atomic_long_t		nr_inline;
+	atomic_long_t		nr_poll;
+	atomic_long_t		nr_iowq;
+	/* serialised by the CQ locking of the ring */
+	unsigned long		lat[IO_LAT_BUCKETS];
+};
+
+struct io_lat_stats {
+	/* protected by ->completion_lock */
+	unsigned long		overflow_wait[IO_LAT_BUCKETS];
+	struct io_op_stats	ops[IORING_OP_LAST];
+};
+
+enum {
+	IO_DISPATCH_INLINE,
+	IO_DISPATCH_POLL,
+	IO_DISPATCH_IOWQ,
+};
+
+DECLARE_STATIC_KEY_FALSE(io_lat_stats_key);
+
+int io_lat_stats_alloc(struct io_ring_ctx *ctx);
+void io_lat_stats_free(struct io_ring_ctx *ctx);
+void io_lat_stats_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m);
+
+/* ~usec resolution is all we need, and it fits into a hole in io_kiocb */
+static inline u32 io_lat_now(void)
+{
+	return local_clock() >> 10;
+}
+
+static inline void io_lat_hist_add(unsigned long *hist, u32 delta)
+{
+	unsigned int bucket = delta ? ilog2(delta) : 0;
+
+	hist[min_t(unsigned int, bucket, IO_LAT_BUCKETS - 1)]++;
+}
+
+static inline bool io_lat_stats_enabled(struct io_ring_ctx *ctx)
+{
+	return static_branch_unlikely(&io_lat_stats_key) && ctx->lat_stats;
+}
+
+static inline void io_lat_stats_issue(struct io_kiocb *req)
+{
+	if (io_lat_stats_enabled(req->ctx))
+		req->issue_time = io_lat_now();
+}
+
+static inline void io_lat_stats_dispatch(struct io_kiocb *req, int type)
+{
+	struct io_op_stats *st;
+
+	if (!io_lat_stats_enabled(req->ctx))
+		return;
+	st = &req->ctx->lat_stats->ops[req->opcode];
+	switch (type) {
+	case IO_DISPATCH_INLINE:
+		atomic_long_inc(&st->nr_inline);
+		break;
+	case IO_DISPATCH_POLL:
+		atomic_long_inc(&st->nr_poll);
+		break;
+	case IO_DISPATCH_IOWQ:
+		atomic_long_inc(&st->nr_iowq);
+		break;
+	}
+}
+
+static inline void io_lat_stats_complete(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (io_lat_stats_enabled(ctx))
+		io_lat_hist_add(ctx->lat_stats->ops[req->opcode].lat,
+				io_lat_now() - req->issue_time);
+}
+
+static inline void io_lat_stats_overflow(struct io_ring_ctx *ctx,
+					 struct io_overflow_cqe *ocqe)
+{
+	if (io_lat_stats_enabled(ctx))
+		io_lat_hist_add(ctx->lat_stats->overflow_wait,
+				io_lat_now() - ocqe->time);
+}
+
+#endif
@@ -469,6 +469,81 @@ static inline void sem_unlock(struct sem_array *sma, int locknum)
 	}
 }
 
+/*
+ * Complex operations that involve only a few semaphores first try to lock
+ * just those semaphores, in ascending order, instead of the whole array.
+ * This works under the same conditions as the single semaphore fast path
+ * in sem_lock(): no complex operation may be sleeping or be processed with
+ * the global lock. Sleeping still requires the global lock, as a sleeping
+ * complex operation is queued on the array-wide lists.
+ */
+#define SEM_MULTI_LOCK		(-2)
+#define SEM_MULTI_LOCK_MAX	4
+
+struct sem_lockset {
+	int nr;
+	int idx[SEM_MULTI_LOCK_MAX];
+};
+
+/* Collect the distinct semaphores of @sops in ascending order */
+static bool sem_lockset_init(struct sem_array *sma, struct sembuf *sops,
+			     int nsops, struct sem_lockset *set)
+{
+	int i, j, idx;
+
+	set->nr = 0;
+	for (i = 0; i < nsops; i++) {
+		idx = array_index_nospec(sops[i].sem_num, sma->sem_nsems);
+		for (j = 0; j < set->nr && set->idx[j] < idx; j++)
+			;
+		if (j < set->nr && set->idx[j] == idx)
+			continue;
+		if (set->nr == SEM_MULTI_LOCK_MAX)
+			return false;
+		memmove(&set->idx[j + 1], &set->idx[j],
+			(set->nr - j) * sizeof(set->idx[0]));
+		set->idx[j] = idx;
+		set->nr++;
+	}
+	return true;
+}
+
+static int sem_lock_multi(struct sem_array *sma, struct sembuf *sops,
+			  int nsops, struct sem_lockset *set)
+{
+	int i;
+
+	if (nsops == 1 || READ_ONCE(sma->use_global_lock) ||
+	    !sem_lockset_init(sma, sops, nsops, set))
+		return sem_lock(sma, sops, nsops);
+
+	for (i = 0; i < set->nr; i++)
+		spin_lock_nested(&sma->sems[set->idx[i]].lock, i);
+
+	/* see SEM_BARRIER_1 for purpose/pairing */
+	if (!smp_load_acquire(&sma->use_global_lock))
+		return SEM_MULTI_LOCK;
+
+	while (i--)
+		spin_unlock(&sma->sems[set->idx[i]].lock);
+
+	return sem_lock(sma, sops, nsops);
+}
+
+static void sem_unlock_multi(struct sem_array *sma, int locknum,
+			     struct sem_lockset *set)
+{
+	int i;
+
+	if (locknum != SEM_MULTI_LOCK) {
+		sem_unlock(sma, locknum);
+		return;
+	}
+
+	for (i = set->nr - 1; i >= 0; i--)
+		spin_unlock(&sma->sems[set->idx[i]].lock);
+}
+
 /*
  * sem_lock_(check_) routines are called in the paths where the rwsem
  * is not held.
@@ -1993,6 +2068,7 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	int max, locknum;
 	bool undos = false, alter = false, dupsop = false;
 	struct sem_queue queue;
+	struct sem_lockset lockset;
 	unsigned long dup = 0;
 	ktime_t expires, *exp = NULL;
 	bool timed_out = false;
@@ -2072,7 +2148,7 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	}
 
 	error = -EIDRM;
-	locknum = sem_lock(sma, sops, nsops);
+	locknum = sem_lock_multi(sma, sops, nsops, &lockset);
 	/*
 	 * We eventually might perform the following check in a lockless
 	 * fashion, considering ipc_valid_object() locking constraints.
@@ -2081,6 +2157,7 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	 * check below. More details on the fine grained locking scheme
 	 * entangled here and why it's RMID race safe on comments at sem_lock()
 	 */
+relock:
 	if (!ipc_valid_object(&sma->sem_perm))
 		goto out_unlock;
 	/*
@@ -2113,7 +2190,7 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 		else
 			set_semotime(sma, sops);
 
-		sem_unlock(sma, locknum);
+		sem_unlock_multi(sma, locknum, &lockset);
 		rcu_read_unlock();
 		wake_up_q(&wake_q);
 
@@ -2122,6 +2199,18 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	if (error < 0) /* non-blocking error path */
 		goto out_unlock;
 
+	/*
+	 * Only the semaphores of a complex operation are locked, but going
+	 * to sleep needs the global lock. Retry with the global lock held,
+	 * the semaphore values may have changed meanwhile.
+	 */
+	if (locknum == SEM_MULTI_LOCK) {
+		sem_unlock_multi(sma, locknum, &lockset);
+		locknum = sem_lock(sma, sops, nsops);
+		error = -EIDRM;
+		goto relock;
+	}
+
 	/*
 	 * We need to sleep on this operation, so we put the current
 	 * task into the pending queue and go to sleep.
@@ -2215,7 +2304,7 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	unlink_queue(sma, &queue);
 
 out_unlock:
-	sem_unlock(sma, locknum);
+	sem_unlock_multi(sma, locknum, &lockset);
 	rcu_read_unlock();
 out:
 	return error;
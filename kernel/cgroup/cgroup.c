@@ -112,6 +112,9 @@ static DEFINE_SPINLOCK(cgroup_file_kn_lock);
 
 DEFINE_PERCPU_RWSEM(cgroup_threadgroup_rwsem);
 
+/* how long readers stay on the slow path after the last task migration */
+#define CGROUP_THREADGROUP_BATCH_DELAY	(HZ / 10)
+
 #define cgroup_assert_mutex_or_rcu_locked()				\
 	RCU_LOCKDEP_WARN(!rcu_read_lock_held() &&			\
 			   !lockdep_is_held(&cgroup_mutex),		\
@@ -6079,6 +6082,13 @@ int __init cgroup_init(void)
 
 	cgroup_rstat_boot();
 
+	/*
+	 * Task migrations come in storms, e.g. when containers are started;
+	 * don't make each of them wait for a grace period.
+	 */
+	percpu_rwsem_set_write_batch(&cgroup_threadgroup_rwsem,
+				     CGROUP_THREADGROUP_BATCH_DELAY);
+
 	get_user_ns(init_cgroup_ns.user_ns);
 
 	cgroup_lock();
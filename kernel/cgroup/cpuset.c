@@ -1115,6 +1115,24 @@ static void rebuild_root_domains(void)
 	rcu_read_unlock();
 }
 
+/*
+ * Sched domain rebuilds requested while a change is applied to the
+ * hierarchy are only recorded and done once, when the whole change has
+ * been applied. See rebuild_sched_domains_pending().
+ *
+ * Written with cpuset_rwsem held. cpuset_hotplug_workfn() checks it after
+ * dropping the lock, hence the READ_ONCE()/WRITE_ONCE() accesses.
+ */
+static bool sd_rebuild_pending;
+
+/* Statistics of the sched domain rebuilds, protected by cpuset_rwsem */
+static struct {
+	u64	count;
+	u64	total_ns;
+	u64	last_ns;
+	u64	max_ns;
+} sd_rebuild_stat;
+
 static void
 partition_and_rebuild_sched_domains(int ndoms_new, cpumask_var_t doms_new[],
 				    struct sched_domain_attr *dattr_new)
@@ -1143,10 +1161,13 @@ static void rebuild_sched_domains_locked(void)
 	cpumask_var_t *doms;
 	struct cpuset *cs;
 	int ndoms;
+	u64 start, delta;
 
 	lockdep_assert_cpus_held();
 	percpu_rwsem_assert_held(&cpuset_rwsem);
 
+	WRITE_ONCE(sd_rebuild_pending, false);
+
 	/*
 	 * If we have raced with CPU hotplug, return early to avoid
 	 * passing doms with offlined cpu to partition_sched_domains().
@@ -1181,18 +1202,38 @@ static void rebuild_sched_domains_locked(void)
 		rcu_read_unlock();
 	}
 
+	start = ktime_get_ns();
+
 	/* Generate domain masks and attrs */
 	ndoms = generate_sched_domains(&doms, &attr);
 
 	/* Have scheduler rebuild the domains */
 	partition_and_rebuild_sched_domains(ndoms, doms, attr);
+
+	delta = ktime_get_ns() - start;
+	sd_rebuild_stat.count++;
+	sd_rebuild_stat.total_ns += delta;
+	sd_rebuild_stat.last_ns = delta;
+	sd_rebuild_stat.max_ns = max(sd_rebuild_stat.max_ns, delta);
 }
 #else /* !CONFIG_SMP */
 static void rebuild_sched_domains_locked(void)
 {
+	WRITE_ONCE(sd_rebuild_pending, false);
 }
 #endif /* CONFIG_SMP */
 
+/*
+ * Do the sched domain rebuild requested while applying a change, if any.
+ * Call at the end of each operation which might set sd_rebuild_pending,
+ * with cpuset_rwsem still held.
+ */
+static void rebuild_sched_domains_pending(void)
+{
+	if (sd_rebuild_pending)
+		rebuild_sched_domains_locked();
+}
+
 void rebuild_sched_domains(void)
 {
 	cpus_read_lock();
@@ -1522,7 +1563,7 @@ static int update_parent_subparts_cpumask(struct cpuset *cs, int cmd,
 
 	/*
 	 * Set or clear CS_SCHED_LOAD_BALANCE when partcmd_update, if necessary.
-	 * rebuild_sched_domains_locked() may be called.
+	 * A sched domain rebuild may be requested.
 	 */
 	if (old_prs != new_prs) {
 		if (old_prs == PRS_ISOLATED)
@@ -1552,13 +1593,13 @@ static void update_cpumasks_hier(struct cpuset *cs, struct tmpmasks *tmp,
 {
 	struct cpuset *cp;
 	struct cgroup_subsys_state *pos_css;
-	bool need_rebuild_sched_domains = false;
 	int old_prs, new_prs;
 
 	rcu_read_lock();
 	cpuset_for_each_descendant_pre(cp, pos_css, cs) {
 		struct cpuset *parent = parent_cs(cp);
 		bool update_parent = false;
+		bool changed;
 
 		compute_effective_cpumask(tmp->new_cpus, cp, parent);
 
@@ -1638,6 +1679,12 @@ static void update_cpumasks_hier(struct cpuset *cs, struct tmpmasks *tmp,
 			new_prs = cp->partition_root_state;
 		}
 
+		/*
+		 * update_parent_subparts_cpumask() is done with addmask, use
+		 * it to tell whether the effective CPUs of @cp change.
+		 */
+		cpumask_copy(tmp->addmask, cp->effective_cpus);
+
 		spin_lock_irq(&callback_lock);
 
 		if (cp->nr_subparts_cpus && !is_partition_valid(cp)) {
@@ -1670,7 +1717,15 @@ static void update_cpumasks_hier(struct cpuset *cs, struct tmpmasks *tmp,
 		WARN_ON(!is_in_v2_mode() &&
 			!cpumask_equal(cp->cpus_allowed, cp->effective_cpus));
 
-		update_tasks_cpumask(cp, tmp->new_cpus);
+		/*
+		 * Partition roots are visited even if nothing changes for
+		 * them. Leave their tasks and the sched domains alone then.
+		 */
+		changed = cp == cs || force || old_prs != new_prs ||
+			  !cpumask_equal(tmp->addmask, cp->effective_cpus);
+
+		if (changed)
+			update_tasks_cpumask(cp, tmp->new_cpus);
 
 		/*
 		 * On legacy hierarchy, if the effective cpumask of any non-
@@ -1678,19 +1733,16 @@ static void update_cpumasks_hier(struct cpuset *cs, struct tmpmasks *tmp,
 		 * On default hierarchy, the cpuset needs to be a partition
 		 * root as well.
 		 */
-		if (!cpumask_empty(cp->cpus_allowed) &&
+		if (changed && !cpumask_empty(cp->cpus_allowed) &&
 		    is_sched_load_balance(cp) &&
 		   (!cgroup_subsys_on_dfl(cpuset_cgrp_subsys) ||
 		    is_partition_valid(cp)))
-			need_rebuild_sched_domains = true;
+			WRITE_ONCE(sd_rebuild_pending, true);
 
 		rcu_read_lock();
 		css_put(&cp->css);
 	}
 	rcu_read_unlock();
-
-	if (need_rebuild_sched_domains)
-		rebuild_sched_domains_locked();
 }
 
 /**
@@ -2219,7 +2271,7 @@ static int update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 	spin_unlock_irq(&callback_lock);
 
 	if (!cpumask_empty(trialcs->cpus_allowed) && balance_flag_changed)
-		rebuild_sched_domains_locked();
+		WRITE_ONCE(sd_rebuild_pending, true);
 
 	if (spread_flag_changed)
 		update_tasks_flags(cs);
@@ -2239,7 +2291,6 @@ static int update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 static int update_prstate(struct cpuset *cs, int new_prs)
 {
 	int err = PERR_NONE, old_prs = cs->partition_root_state;
-	bool sched_domain_rebuilt = false;
 	struct cpuset *parent = parent_cs(cs);
 	struct tmpmasks tmpmask;
 
@@ -2288,15 +2339,13 @@ static int update_prstate(struct cpuset *cs, int new_prs)
 			 * error unless the system is running out of memory.
 			 */
 			update_flag(CS_SCHED_LOAD_BALANCE, cs, 0);
-			sched_domain_rebuilt = true;
 		}
 	} else if (old_prs && new_prs) {
 		/*
 		 * A change in load balance state only, no change in cpumasks.
 		 */
 		update_flag(CS_SCHED_LOAD_BALANCE, cs, (new_prs != PRS_ISOLATED));
-		sched_domain_rebuilt = true;
-		goto out;	/* Sched domain is rebuilt in update_flag() */
+		goto out;	/* Sched domain rebuild requested in update_flag() */
 	} else {
 		/*
 		 * Switching back to member is always allowed even if it
@@ -2322,7 +2371,6 @@ static int update_prstate(struct cpuset *cs, int new_prs)
 		if (!is_sched_load_balance(cs)) {
 			/* Make sure load balance is on */
 			update_flag(CS_SCHED_LOAD_BALANCE, cs, 1);
-			sched_domain_rebuilt = true;
 		}
 	}
 
@@ -2331,8 +2379,7 @@ static int update_prstate(struct cpuset *cs, int new_prs)
 	if (parent->child_ecpus_count)
 		update_sibling_cpumasks(parent, cs, &tmpmask);
 
-	if (!sched_domain_rebuilt)
-		rebuild_sched_domains_locked();
+	WRITE_ONCE(sd_rebuild_pending, true);
 out:
 	/*
 	 * Make partition invalid if an error happen
@@ -2693,6 +2740,7 @@ static int cpuset_write_u64(struct cgroup_subsys_state *css, struct cftype *cft,
 		retval = -EINVAL;
 		break;
 	}
+	rebuild_sched_domains_pending();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -2784,6 +2832,7 @@ static ssize_t cpuset_write_resmask(struct kernfs_open_file *of,
 	}
 
 	free_cpuset(trialcs);
+	rebuild_sched_domains_pending();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -2879,6 +2928,24 @@ static s64 cpuset_read_s64(struct cgroup_subsys_state *css, struct cftype *cft)
 	return 0;
 }
 
+static int sched_domains_stat_show(struct seq_file *seq, void *v)
+{
+	u64 count, total, last, max;
+
+	percpu_down_read(&cpuset_rwsem);
+	count = sd_rebuild_stat.count;
+	total = sd_rebuild_stat.total_ns;
+	last = sd_rebuild_stat.last_ns;
+	max = sd_rebuild_stat.max_ns;
+	percpu_up_read(&cpuset_rwsem);
+
+	seq_printf(seq, "rebuilds %llu\n", count);
+	seq_printf(seq, "rebuild_usec %llu\n", div_u64(total, NSEC_PER_USEC));
+	seq_printf(seq, "last_rebuild_usec %llu\n", div_u64(last, NSEC_PER_USEC));
+	seq_printf(seq, "max_rebuild_usec %llu\n", div_u64(max, NSEC_PER_USEC));
+	return 0;
+}
+
 static int sched_partition_show(struct seq_file *seq, void *v)
 {
 	struct cpuset *cs = css_cs(seq_css(seq));
@@ -2938,6 +3005,7 @@ static ssize_t sched_partition_write(struct kernfs_open_file *of, char *buf,
 		goto out_unlock;
 
 	retval = update_prstate(cs, val);
+	rebuild_sched_domains_pending();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -3102,6 +3170,12 @@ static struct cftype dfl_files[] = {
 		.flags = CFTYPE_DEBUG,
 	},
 
+	{
+		.name = "sched_domains.stat",
+		.seq_show = sched_domains_stat_show,
+		.flags = CFTYPE_ONLY_ON_ROOT,
+	},
+
 	{ }	/* terminate */
 };
 
@@ -3237,6 +3311,8 @@ static void cpuset_css_offline(struct cgroup_subsys_state *css)
 	    is_sched_load_balance(cs))
 		update_flag(CS_SCHED_LOAD_BALANCE, cs, 0);
 
+	rebuild_sched_domains_pending();
+
 	if (cs->use_parent_ecpus) {
 		struct cpuset *parent = parent_cs(cs);
 
@@ -3745,8 +3821,11 @@ static void cpuset_hotplug_workfn(struct work_struct *work)
 		rcu_read_unlock();
 	}
 
-	/* rebuild sched domains if cpus_allowed has changed */
-	if (cpus_updated || force_rebuild) {
+	/*
+	 * rebuild sched domains if cpus_allowed has changed or a partition
+	 * update above asked for it
+	 */
+	if (cpus_updated || force_rebuild || READ_ONCE(sd_rebuild_pending)) {
 		force_rebuild = false;
 		rebuild_sched_domains();
 	}
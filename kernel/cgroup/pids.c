@@ -25,6 +25,12 @@
  * pids.current tracks all child cgroup hierarchies, so parent/pids.current is
  * a superset of parent/child/pids.current.
  *
+ * fork() charges in batches of %PIDS_CHARGE_BATCH into a per-CPU stock, so
+ * that most forks don't touch the counters of the whole hierarchy. When a
+ * batch doesn't fit under a limit, single pids are charged and, if needed,
+ * the stocks of all CPUs are given back before failing the fork, so the
+ * limit is as exact as without the stock.
+ *
  * Copyright (C) 2015 Aleksa Sarai <cyphar@cyphar.com>
  */
 
@@ -33,11 +39,16 @@
 #include <linux/atomic.h>
 #include <linux/cgroup.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
 #include <linux/sched/task.h>
 
 #define PIDS_MAX (PID_MAX_LIMIT + 1ULL)
 #define PIDS_MAX_STR "max"
 
+/* Number of pids charged at once into the per-CPU stock */
+#define PIDS_CHARGE_BATCH 16
+
 struct pids_cgroup {
 	struct cgroup_subsys_state	css;
 
@@ -54,6 +65,24 @@ struct pids_cgroup {
 
 	/* Number of times fork failed because limit was hit. */
 	atomic64_t			events_limit;
+
+	/* Set when going offline, no more pids are put into the stocks */
+	bool				offline;
+};
+
+/*
+ * Pids which are charged to @cached and its ancestors, but not used by any
+ * task yet. Like memcg's stock, only one cgroup is cached per CPU. The lock
+ * is only taken remotely when the stocks are drained.
+ */
+struct pids_stock {
+	spinlock_t			lock;
+	struct pids_cgroup		*cached;
+	unsigned int			nr;
+};
+
+static DEFINE_PER_CPU(struct pids_stock, pids_stock) = {
+	.lock = __SPIN_LOCK_UNLOCKED(pids_stock.lock),
 };
 
 static struct pids_cgroup *css_pids(struct cgroup_subsys_state *css)
@@ -86,6 +115,18 @@ static void pids_css_free(struct cgroup_subsys_state *css)
 	kfree(css_pids(css));
 }
 
+static void pids_uncharge(struct pids_cgroup *pids, int num);
+static bool pids_drain_all_stocks(struct pids_cgroup *pids);
+
+static void pids_css_offline(struct cgroup_subsys_state *css)
+{
+	struct pids_cgroup *pids = css_pids(css);
+
+	/* Exiting tasks must not stock pids of a dead cgroup */
+	WRITE_ONCE(pids->offline, true);
+	pids_drain_all_stocks(pids);
+}
+
 static void pids_update_watermark(struct pids_cgroup *p, int64_t nr_pids)
 {
 	/*
@@ -146,6 +187,112 @@ static void pids_charge(struct pids_cgroup *pids, int num)
 	}
 }
 
+/* Give back the pids in @stock, called with @stock->lock held */
+static void pids_drain_stock(struct pids_stock *stock)
+{
+	if (stock->nr)
+		pids_uncharge(stock->cached, stock->nr);
+	stock->cached = NULL;
+	stock->nr = 0;
+}
+
+static bool pids_consume_stock(struct pids_cgroup *pids)
+{
+	struct pids_stock *stock = raw_cpu_ptr(&pids_stock);
+	unsigned long flags;
+	bool ret = false;
+
+	spin_lock_irqsave(&stock->lock, flags);
+	if (stock->cached == pids && stock->nr) {
+		stock->nr--;
+		ret = true;
+	}
+	spin_unlock_irqrestore(&stock->lock, flags);
+
+	return ret;
+}
+
+/*
+ * Put @num charged pids of @pids into the local stock. Pids which don't
+ * fit because the stock is full or @pids is going offline are uncharged.
+ */
+static void pids_refill_stock(struct pids_cgroup *pids, unsigned int num)
+{
+	struct pids_stock *stock = raw_cpu_ptr(&pids_stock);
+	unsigned long flags;
+	unsigned int excess = 0;
+
+	if (!parent_pids(pids))
+		return;
+
+	spin_lock_irqsave(&stock->lock, flags);
+	if (READ_ONCE(pids->offline)) {
+		excess = num;
+	} else {
+		if (stock->cached != pids) {
+			pids_drain_stock(stock);
+			stock->cached = pids;
+		}
+		stock->nr += num;
+		if (stock->nr > PIDS_CHARGE_BATCH) {
+			excess = stock->nr - PIDS_CHARGE_BATCH;
+			stock->nr = PIDS_CHARGE_BATCH;
+		}
+	}
+	spin_unlock_irqrestore(&stock->lock, flags);
+
+	if (excess)
+		pids_uncharge(pids, excess);
+}
+
+/*
+ * Give back the stocked pids of @pids and its descendants on all CPUs.
+ * Returns true if there were any.
+ */
+static bool pids_drain_all_stocks(struct pids_cgroup *pids)
+{
+	unsigned long flags;
+	bool drained = false;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct pids_stock *stock = per_cpu_ptr(&pids_stock, cpu);
+
+		spin_lock_irqsave(&stock->lock, flags);
+		if (stock->cached &&
+		    cgroup_is_descendant(stock->cached->css.cgroup,
+					 pids->css.cgroup)) {
+			if (stock->nr)
+				drained = true;
+			pids_drain_stock(stock);
+		}
+		spin_unlock_irqrestore(&stock->lock, flags);
+	}
+
+	return drained;
+}
+
+/* Number of pids of @pids and its descendants sitting in the stocks */
+static int64_t pids_stocked(struct pids_cgroup *pids)
+{
+	unsigned long flags;
+	int64_t nr = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct pids_stock *stock = per_cpu_ptr(&pids_stock, cpu);
+
+		spin_lock_irqsave(&stock->lock, flags);
+		if (stock->cached &&
+		    cgroup_is_descendant(stock->cached->css.cgroup,
+					 pids->css.cgroup))
+			nr += stock->nr;
+		spin_unlock_irqrestore(&stock->lock, flags);
+	}
+
+	return nr;
+}
+
 /**
  * pids_try_charge - hierarchically try to charge the pid count
  * @pids: the pid cgroup state
@@ -188,6 +335,55 @@ static int pids_try_charge(struct pids_cgroup *pids, int num)
 	return -EAGAIN;
 }
 
+/* The first cgroup from @pids up which has no room for another pid */
+static struct pids_cgroup *pids_at_limit(struct pids_cgroup *pids)
+{
+	struct pids_cgroup *p;
+
+	for (p = pids; parent_pids(p); p = parent_pids(p)) {
+		if (atomic64_read(&p->counter) >= atomic64_read(&p->limit))
+			return p;
+	}
+	return NULL;
+}
+
+/**
+ * pids_try_charge_fork - charge one pid for fork()
+ * @pids: the pid cgroup state
+ *
+ * Take the pid from the local stock if possible, otherwise charge a batch
+ * and stock the rest. Close to a limit, only single pids are charged, and
+ * the pids stocked on other CPUs are given back before failing.
+ */
+static int pids_try_charge_fork(struct pids_cgroup *pids)
+{
+	struct pids_cgroup *p;
+
+	if (!parent_pids(pids))
+		return 0;
+
+	if (pids_consume_stock(pids))
+		return 0;
+
+	if (!pids_try_charge(pids, PIDS_CHARGE_BATCH)) {
+		pids_refill_stock(pids, PIDS_CHARGE_BATCH - 1);
+		return 0;
+	}
+
+	if (!pids_try_charge(pids, 1))
+		return 0;
+
+	/*
+	 * Part of the limit might be sitting in the stocks of cgroups below
+	 * the one which is at its limit.
+	 */
+	p = pids_at_limit(pids);
+	if (p && !pids_drain_all_stocks(p))
+		return -EAGAIN;
+
+	return pids_try_charge(pids, 1);
+}
+
 static int pids_can_attach(struct cgroup_taskset *tset)
 {
 	struct task_struct *task;
@@ -246,7 +442,7 @@ static int pids_can_fork(struct task_struct *task, struct css_set *cset)
 	else
 		css = task_css_check(current, pids_cgrp_id, true);
 	pids = css_pids(css);
-	err = pids_try_charge(pids, 1);
+	err = pids_try_charge_fork(pids);
 	if (err) {
 		/* Only log the first time events_limit is incremented. */
 		if (atomic64_inc_return(&pids->events_limit) == 1) {
@@ -269,14 +465,14 @@ static void pids_cancel_fork(struct task_struct *task, struct css_set *cset)
 	else
 		css = task_css_check(current, pids_cgrp_id, true);
 	pids = css_pids(css);
-	pids_uncharge(pids, 1);
+	pids_refill_stock(pids, 1);
 }
 
 static void pids_release(struct task_struct *task)
 {
 	struct pids_cgroup *pids = css_pids(task_css(task, pids_cgrp_id));
 
-	pids_uncharge(pids, 1);
+	pids_refill_stock(pids, 1);
 }
 
 static ssize_t pids_max_write(struct kernfs_open_file *of, char *buf,
@@ -328,7 +524,7 @@ static s64 pids_current_read(struct cgroup_subsys_state *css,
 {
 	struct pids_cgroup *pids = css_pids(css);
 
-	return atomic64_read(&pids->counter);
+	return atomic64_read(&pids->counter) - pids_stocked(pids);
 }
 
 static s64 pids_peak_read(struct cgroup_subsys_state *css,
@@ -375,6 +571,7 @@ static struct cftype pids_files[] = {
 
 struct cgroup_subsys pids_cgrp_subsys = {
 	.css_alloc	= pids_css_alloc,
+	.css_offline	= pids_css_offline,
 	.css_free	= pids_css_free,
 	.can_attach 	= pids_can_attach,
 	.cancel_attach 	= pids_cancel_attach,
@@ -16,9 +16,28 @@
 #include <linux/module.h>
 #include <linux/pci.h>
 #include <linux/platform_device.h>
+#include <linux/scatterlist.h>
 #include <linux/slab.h>
+#include <linux/smp.h>
 #include <linux/timekeeping.h>
 
+/*
+ * Latencies are recorded in a log-linear histogram: values below
+ * MAP_BENCH_HIST_SUB ns get a bucket each, every further power of two is
+ * split into MAP_BENCH_HIST_SUB buckets, i.e. about 3% resolution.
+ */
+#define MAP_BENCH_HIST_SUB_BITS	5
+#define MAP_BENCH_HIST_SUB	(1 << MAP_BENCH_HIST_SUB_BITS)
+#define MAP_BENCH_HIST_MAX_BITS	40
+#define MAP_BENCH_HIST_BUCKETS	\
+	((MAP_BENCH_HIST_MAX_BITS - MAP_BENCH_HIST_SUB_BITS + 1) * \
+	 MAP_BENCH_HIST_SUB)
+
+struct map_benchmark_hist {
+	u64 map[MAP_BENCH_HIST_BUCKETS];
+	u64 unmap[MAP_BENCH_HIST_BUCKETS];
+};
+
 struct map_benchmark_data {
 	struct map_benchmark bparam;
 	struct device *dev;
@@ -29,53 +48,235 @@ struct map_benchmark_data {
 	atomic64_t sum_sq_map;
 	atomic64_t sum_sq_unmap;
 	atomic64_t loops;
+	spinlock_t hist_lock;
+	struct map_benchmark_hist *hist;
 };
 
-static int map_benchmark_thread(void *data)
-{
+/* Per thread state, so that the threads do not share cache lines. */
+struct map_benchmark_thread {
+	struct map_benchmark_data *map;
 	void *buf;
+	struct scatterlist *sgl;
 	dma_addr_t dma_addr;
+	ktime_t unmap_delta;
+	struct map_benchmark_hist hist;
+};
+
+static unsigned int map_benchmark_hist_index(u64 ns)
+{
+	unsigned int msb;
+
+	if (ns < MAP_BENCH_HIST_SUB)
+		return ns;
+
+	ns = min_t(u64, ns, BIT_ULL(MAP_BENCH_HIST_MAX_BITS) - 1);
+	msb = fls64(ns) - 1;
+	return (msb - MAP_BENCH_HIST_SUB_BITS + 1) * MAP_BENCH_HIST_SUB +
+	       ((ns >> (msb - MAP_BENCH_HIST_SUB_BITS)) &
+		(MAP_BENCH_HIST_SUB - 1));
+}
+
+/* The lowest latency which is accounted to bucket @idx. */
+static u64 map_benchmark_hist_value(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < MAP_BENCH_HIST_SUB)
+		return idx;
+
+	shift = idx / MAP_BENCH_HIST_SUB - 1;
+	return (u64)(MAP_BENCH_HIST_SUB + idx % MAP_BENCH_HIST_SUB) << shift;
+}
+
+/* The latency which @permille of the @total samples in @hist do not exceed. */
+static u64 map_benchmark_percentile(const u64 *hist, u64 total,
+				    unsigned int permille)
+{
+	u64 rank = DIV_ROUND_UP_ULL(total * permille, 1000), seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < MAP_BENCH_HIST_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= rank)
+			return map_benchmark_hist_value(i);
+	}
+	return map_benchmark_hist_value(MAP_BENCH_HIST_BUCKETS - 1);
+}
+
+static int map_benchmark_setup(struct map_benchmark_thread *t)
+{
+	struct map_benchmark_data *map = t->map;
+	u64 size = map->bparam.granule * PAGE_SIZE;
+	struct scatterlist *sg;
+	void *buf;
+	int i;
+
+	switch (map->bparam.mode) {
+	case DMA_MAP_BENCH_SG:
+		t->sgl = kcalloc(map->bparam.nr_segs, sizeof(*t->sgl),
+				 GFP_KERNEL);
+		if (!t->sgl)
+			return -ENOMEM;
+		sg_init_table(t->sgl, map->bparam.nr_segs);
+		/* separate allocations, so that the segments are not merged */
+		for_each_sg(t->sgl, sg, map->bparam.nr_segs, i) {
+			buf = alloc_pages_exact(size, GFP_KERNEL);
+			if (!buf)
+				return -ENOMEM;
+			sg_set_buf(sg, buf, size);
+		}
+		return 0;
+	case DMA_MAP_BENCH_ALLOC:
+		return 0;
+	default:
+		t->buf = alloc_pages_exact(size, GFP_KERNEL);
+		return t->buf ? 0 : -ENOMEM;
+	}
+}
+
+static void map_benchmark_teardown(struct map_benchmark_thread *t)
+{
+	struct map_benchmark_data *map = t->map;
+	u64 size = map->bparam.granule * PAGE_SIZE;
+	struct scatterlist *sg;
+	int i;
+
+	if (t->sgl) {
+		for_each_sg(t->sgl, sg, map->bparam.nr_segs, i) {
+			if (sg_page(sg))
+				free_pages_exact(sg_virt(sg), size);
+		}
+		kfree(t->sgl);
+	}
+	if (t->buf)
+		free_pages_exact(t->buf, size);
+}
+
+static void map_benchmark_remote_unmap(void *data)
+{
+	struct map_benchmark_thread *t = data;
+	struct map_benchmark_data *map = t->map;
+	ktime_t unmap_stime = ktime_get();
+
+	dma_unmap_single(map->dev, t->dma_addr,
+			 map->bparam.granule * PAGE_SIZE, map->dir);
+	t->unmap_delta = ktime_sub(ktime_get(), unmap_stime);
+}
+
+/*
+ * Run one map/unmap cycle in the configured mode and return the time it
+ * took to map and unmap in @map_delta and @unmap_delta.
+ */
+static int map_benchmark_once(struct map_benchmark_thread *t,
+			      ktime_t *map_delta, ktime_t *unmap_delta)
+{
+	struct map_benchmark_data *map = t->map;
+	u64 size = map->bparam.granule * PAGE_SIZE;
+	int nr_segs = map->bparam.nr_segs;
+	ktime_t map_stime, unmap_stime;
+	struct scatterlist *sg;
+	void *vaddr = NULL;
+	int cpu, i, nents;
+
+	/*
+	 * for a non-coherent device, if we don't stain them in the
+	 * cache, this will give an underestimate of the real-world
+	 * overhead of BIDIRECTIONAL or TO_DEVICE mappings;
+	 * 66 means evertything goes well! 66 is lucky.
+	 */
+	if (map->dir != DMA_FROM_DEVICE) {
+		if (t->buf)
+			memset(t->buf, 0x66, size);
+		else if (t->sgl)
+			for_each_sg(t->sgl, sg, nr_segs, i)
+				memset(sg_virt(sg), 0x66, size);
+	}
+
+	map_stime = ktime_get();
+	switch (map->bparam.mode) {
+	case DMA_MAP_BENCH_SG:
+		nents = dma_map_sg(map->dev, t->sgl, nr_segs, map->dir);
+		if (unlikely(!nents)) {
+			pr_err("dma_map_sg failed on %s\n", dev_name(map->dev));
+			return -ENOMEM;
+		}
+		break;
+	case DMA_MAP_BENCH_ALLOC:
+		vaddr = dma_alloc_attrs(map->dev, size, &t->dma_addr,
+					GFP_KERNEL, 0);
+		if (unlikely(!vaddr)) {
+			pr_err("dma_alloc_attrs failed on %s\n",
+				dev_name(map->dev));
+			return -ENOMEM;
+		}
+		break;
+	default:
+		t->dma_addr = dma_map_single(map->dev, t->buf, size, map->dir);
+		if (unlikely(dma_mapping_error(map->dev, t->dma_addr))) {
+			pr_err("dma_map_single failed on %s\n",
+				dev_name(map->dev));
+			return -ENOMEM;
+		}
+		break;
+	}
+	*map_delta = ktime_sub(ktime_get(), map_stime);
+
+	/* Pretend DMA is transmitting */
+	ndelay(map->bparam.dma_trans_ns);
+
+	if (map->bparam.mode == DMA_MAP_BENCH_CROSS_CPU) {
+		/* like a completion handled on another CPU than the submit */
+		cpu = get_cpu();
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		smp_call_function_single(cpu, map_benchmark_remote_unmap, t, 1);
+		put_cpu();
+		*unmap_delta = t->unmap_delta;
+		return 0;
+	}
+
+	unmap_stime = ktime_get();
+	switch (map->bparam.mode) {
+	case DMA_MAP_BENCH_SG:
+		dma_unmap_sg(map->dev, t->sgl, nr_segs, map->dir);
+		break;
+	case DMA_MAP_BENCH_ALLOC:
+		dma_free_attrs(map->dev, size, vaddr, t->dma_addr, 0);
+		break;
+	default:
+		dma_unmap_single(map->dev, t->dma_addr, size, map->dir);
+		break;
+	}
+	*unmap_delta = ktime_sub(ktime_get(), unmap_stime);
+	return 0;
+}
+
+static int map_benchmark_thread(void *data)
+{
 	struct map_benchmark_data *map = data;
-	int npages = map->bparam.granule;
-	u64 size = npages * PAGE_SIZE;
-	int ret = 0;
+	struct map_benchmark_thread *t;
+	int ret, i;
 
-	buf = alloc_pages_exact(size, GFP_KERNEL);
-	if (!buf)
+	t = kvzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
 		return -ENOMEM;
+	t->map = map;
+
+	ret = map_benchmark_setup(t);
+	if (ret)
+		goto out;
 
 	while (!kthread_should_stop())  {
 		u64 map_100ns, unmap_100ns, map_sq, unmap_sq;
-		ktime_t map_stime, map_etime, unmap_stime, unmap_etime;
 		ktime_t map_delta, unmap_delta;
 
-		/*
-		 * for a non-coherent device, if we don't stain them in the
-		 * cache, this will give an underestimate of the real-world
-		 * overhead of BIDIRECTIONAL or TO_DEVICE mappings;
-		 * 66 means evertything goes well! 66 is lucky.
-		 */
-		if (map->dir != DMA_FROM_DEVICE)
-			memset(buf, 0x66, size);
-
-		map_stime = ktime_get();
-		dma_addr = dma_map_single(map->dev, buf, size, map->dir);
-		if (unlikely(dma_mapping_error(map->dev, dma_addr))) {
-			pr_err("dma_map_single failed on %s\n",
-				dev_name(map->dev));
-			ret = -ENOMEM;
+		ret = map_benchmark_once(t, &map_delta, &unmap_delta);
+		if (ret)
 			goto out;
-		}
-		map_etime = ktime_get();
-		map_delta = ktime_sub(map_etime, map_stime);
-
-		/* Pretend DMA is transmitting */
-		ndelay(map->bparam.dma_trans_ns);
 
-		unmap_stime = ktime_get();
-		dma_unmap_single(map->dev, dma_addr, size, map->dir);
-		unmap_etime = ktime_get();
-		unmap_delta = ktime_sub(unmap_etime, unmap_stime);
+		t->hist.map[map_benchmark_hist_index(map_delta)]++;
+		t->hist.unmap[map_benchmark_hist_index(unmap_delta)]++;
 
 		/* calculate sum and sum of squares */
 
@@ -92,7 +293,15 @@ static int map_benchmark_thread(void *data)
 	}
 
 out:
-	free_pages_exact(buf, size);
+	spin_lock(&map->hist_lock);
+	for (i = 0; i < MAP_BENCH_HIST_BUCKETS; i++) {
+		map->hist->map[i] += t->hist.map[i];
+		map->hist->unmap[i] += t->hist.unmap[i];
+	}
+	spin_unlock(&map->hist_lock);
+
+	map_benchmark_teardown(t);
+	kvfree(t);
 	return ret;
 }
 
@@ -110,6 +319,13 @@ static int do_map_benchmark(struct map_benchmark_data *map)
 	if (!tsk)
 		return -ENOMEM;
 
+	map->hist = kvzalloc(sizeof(*map->hist), GFP_KERNEL);
+	if (!map->hist) {
+		kfree(tsk);
+		return -ENOMEM;
+	}
+	spin_lock_init(&map->hist_lock);
+
 	get_device(map->dev);
 
 	for (i = 0; i < threads; i++) {
@@ -167,12 +383,28 @@ static int do_map_benchmark(struct map_benchmark_data *map)
 				map->bparam.avg_unmap_100ns;
 		map->bparam.map_stddev = int_sqrt64(map_variance);
 		map->bparam.unmap_stddev = int_sqrt64(unmap_variance);
+
+		/* latency percentiles */
+		map->bparam.map_p50_ns =
+			map_benchmark_percentile(map->hist->map, loops, 500);
+		map->bparam.map_p99_ns =
+			map_benchmark_percentile(map->hist->map, loops, 990);
+		map->bparam.map_p999_ns =
+			map_benchmark_percentile(map->hist->map, loops, 999);
+		map->bparam.unmap_p50_ns =
+			map_benchmark_percentile(map->hist->unmap, loops, 500);
+		map->bparam.unmap_p99_ns =
+			map_benchmark_percentile(map->hist->unmap, loops, 990);
+		map->bparam.unmap_p999_ns =
+			map_benchmark_percentile(map->hist->unmap, loops, 999);
 	}
 
 out:
 	for (i = 0; i < threads; i++)
 		put_task_struct(tsk[i]);
 	put_device(map->dev);
+	kvfree(map->hist);
+	map->hist = NULL;
 	kfree(tsk);
 	return ret;
 }
@@ -213,11 +445,36 @@ static long map_benchmark_ioctl(struct file *file, unsigned int cmd,
 			return -EINVAL;
 		}
 
-		if (map->bparam.granule < 1 || map->bparam.granule > 1024) {
+		if (map->bparam.granule < 1 ||
+		    map->bparam.granule > DMA_MAP_MAX_GRANULE) {
 			pr_err("invalid granule size\n");
 			return -EINVAL;
 		}
 
+		switch (map->bparam.mode) {
+		case DMA_MAP_BENCH_SINGLE:
+		case DMA_MAP_BENCH_ALLOC:
+			break;
+		case DMA_MAP_BENCH_SG:
+			if (map->bparam.nr_segs < 1 ||
+			    map->bparam.nr_segs > DMA_MAP_MAX_SEGS ||
+			    map->bparam.nr_segs * map->bparam.granule >
+			    DMA_MAP_MAX_GRANULE) {
+				pr_err("invalid number of segments\n");
+				return -EINVAL;
+			}
+			break;
+		case DMA_MAP_BENCH_CROSS_CPU:
+			if (num_online_cpus() < 2) {
+				pr_err("cross CPU mode needs two CPUs\n");
+				return -EINVAL;
+			}
+			break;
+		default:
+			pr_err("invalid benchmark mode\n");
+			return -EINVAL;
+		}
+
 		switch (map->bparam.dma_dir) {
 		case DMA_MAP_BIDIRECTIONAL:
 			map->dir = DMA_BIDIRECTIONAL;
@@ -9,15 +9,35 @@
 #include <linux/dma-direct.h>
 #include <linux/init.h>
 #include <linux/genalloc.h>
+#include <linux/percpu.h>
 #include <linux/set_memory.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
 
+/*
+ * Small allocations are served from per CPU caches of free objects, one
+ * per size class of 1, 2 and 4 pages. An empty cache is refilled with
+ * DMA_POOL_CACHE_BATCH objects carved out of a single gen_pool allocation,
+ * a full one gives DMA_POOL_CACHE_BATCH objects back.
+ */
+#define DMA_POOL_CACHE_ORDERS	3
+#define DMA_POOL_CACHE_SIZE	8
+#define DMA_POOL_CACHE_BATCH	4
+
+struct dma_pool_cache {
+	spinlock_t lock;
+	unsigned int nr[DMA_POOL_CACHE_ORDERS];
+	unsigned long addr[DMA_POOL_CACHE_ORDERS][DMA_POOL_CACHE_SIZE];
+};
+
 static struct gen_pool *atomic_pool_dma __ro_after_init;
+static struct dma_pool_cache __percpu *atomic_cache_dma __ro_after_init;
 static unsigned long pool_size_dma;
 static struct gen_pool *atomic_pool_dma32 __ro_after_init;
+static struct dma_pool_cache __percpu *atomic_cache_dma32 __ro_after_init;
 static unsigned long pool_size_dma32;
 static struct gen_pool *atomic_pool_kernel __ro_after_init;
+static struct dma_pool_cache __percpu *atomic_cache_kernel __ro_after_init;
 static unsigned long pool_size_kernel;
 
 /* Size can be defined by the coherent_pool command line */
@@ -184,6 +204,25 @@ static __init struct gen_pool *__dma_atomic_pool_init(size_t pool_size,
 	return pool;
 }
 
+static __init struct dma_pool_cache __percpu *dma_pool_cache_init(
+		struct gen_pool *pool)
+{
+	struct dma_pool_cache __percpu *pcp;
+	int cpu;
+
+	if (!pool)
+		return NULL;
+
+	/* Without the caches all allocations go to the gen_pool directly. */
+	pcp = alloc_percpu(struct dma_pool_cache);
+	if (!pcp)
+		return NULL;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(pcp, cpu)->lock);
+	return pcp;
+}
+
 static int __init dma_atomic_pool_init(void)
 {
 	int ret = 0;
@@ -203,17 +242,20 @@ static int __init dma_atomic_pool_init(void)
 						    GFP_KERNEL);
 	if (!atomic_pool_kernel)
 		ret = -ENOMEM;
+	atomic_cache_kernel = dma_pool_cache_init(atomic_pool_kernel);
 	if (has_managed_dma()) {
 		atomic_pool_dma = __dma_atomic_pool_init(atomic_pool_size,
 						GFP_KERNEL | GFP_DMA);
 		if (!atomic_pool_dma)
 			ret = -ENOMEM;
+		atomic_cache_dma = dma_pool_cache_init(atomic_pool_dma);
 	}
 	if (IS_ENABLED(CONFIG_ZONE_DMA32)) {
 		atomic_pool_dma32 = __dma_atomic_pool_init(atomic_pool_size,
 						GFP_KERNEL | GFP_DMA32);
 		if (!atomic_pool_dma32)
 			ret = -ENOMEM;
+		atomic_cache_dma32 = dma_pool_cache_init(atomic_pool_dma32);
 	}
 
 	dma_atomic_pool_debugfs_init();
@@ -237,24 +279,144 @@ static inline struct gen_pool *dma_guess_pool(struct gen_pool *prev, gfp_t gfp)
 	return NULL;
 }
 
+/* The per CPU caches of @pool, if objects of @size are cached at all. */
+static struct dma_pool_cache __percpu *dma_pool_cache(struct gen_pool *pool,
+						      size_t size)
+{
+	if (get_order(size) >= DMA_POOL_CACHE_ORDERS)
+		return NULL;
+	if (pool == atomic_pool_kernel)
+		return atomic_cache_kernel;
+	if (pool == atomic_pool_dma32)
+		return atomic_cache_dma32;
+	return atomic_cache_dma;
+}
+
+static void dma_pool_cache_refill(struct gen_pool *pool,
+				  struct dma_pool_cache *cache,
+				  unsigned int order)
+{
+	unsigned long *objs = cache->addr[order];
+	size_t size = PAGE_SIZE << order;
+	unsigned long addr;
+	int i;
+
+	addr = gen_pool_alloc(pool, size * DMA_POOL_CACHE_BATCH);
+	if (addr) {
+		for (i = 0; i < DMA_POOL_CACHE_BATCH; i++)
+			objs[cache->nr[order]++] = addr + i * size;
+	} else {
+		addr = gen_pool_alloc(pool, size);
+		if (addr)
+			objs[cache->nr[order]++] = addr;
+	}
+
+	/*
+	 * Expand the pool before it runs dry: the objects in the caches are
+	 * no longer available to the other CPUs.
+	 */
+	if (gen_pool_avail(pool) < atomic_pool_size)
+		schedule_work(&atomic_pool_work);
+}
+
+static unsigned long dma_pool_cache_alloc(struct gen_pool *pool,
+		struct dma_pool_cache __percpu *pcp, unsigned int order)
+{
+	struct dma_pool_cache *cache;
+	unsigned long flags, addr = 0;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(pcp);
+	spin_lock(&cache->lock);
+	if (!cache->nr[order])
+		dma_pool_cache_refill(pool, cache, order);
+	if (cache->nr[order])
+		addr = cache->addr[order][--cache->nr[order]];
+	spin_unlock(&cache->lock);
+	local_irq_restore(flags);
+
+	return addr;
+}
+
+static void dma_pool_cache_free(struct gen_pool *pool,
+		struct dma_pool_cache __percpu *pcp, unsigned long addr,
+		unsigned int order)
+{
+	struct dma_pool_cache *cache;
+	unsigned long flags;
+	int i;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(pcp);
+	spin_lock(&cache->lock);
+	if (cache->nr[order] == DMA_POOL_CACHE_SIZE) {
+		for (i = 0; i < DMA_POOL_CACHE_BATCH; i++) {
+			cache->nr[order]--;
+			gen_pool_free(pool, cache->addr[order][cache->nr[order]],
+				      PAGE_SIZE << order);
+		}
+	}
+	cache->addr[order][cache->nr[order]++] = addr;
+	spin_unlock(&cache->lock);
+	local_irq_restore(flags);
+}
+
+/* Return the objects cached on all CPUs to @pool. */
+static void dma_pool_cache_drain(struct gen_pool *pool,
+				 struct dma_pool_cache __percpu *pcp)
+{
+	struct dma_pool_cache *cache;
+	unsigned long flags;
+	unsigned int order;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(pcp, cpu);
+		spin_lock_irqsave(&cache->lock, flags);
+		for (order = 0; order < DMA_POOL_CACHE_ORDERS; order++) {
+			while (cache->nr[order])
+				gen_pool_free(pool,
+					cache->addr[order][--cache->nr[order]],
+					PAGE_SIZE << order);
+		}
+		spin_unlock_irqrestore(&cache->lock, flags);
+	}
+}
+
 static struct page *__dma_alloc_from_pool(struct device *dev, size_t size,
 		struct gen_pool *pool, void **cpu_addr,
 		bool (*phys_addr_ok)(struct device *, phys_addr_t, size_t))
 {
+	struct dma_pool_cache __percpu *pcp = dma_pool_cache(pool, size);
+	unsigned int order = get_order(size);
 	unsigned long addr;
 	phys_addr_t phys;
 
-	addr = gen_pool_alloc(pool, size);
+	if (pcp) {
+		/* Cached objects always have the full size of their class. */
+		size = PAGE_SIZE << order;
+		addr = dma_pool_cache_alloc(pool, pcp, order);
+		if (!addr) {
+			/* The free space may sit in the caches of other CPUs */
+			dma_pool_cache_drain(pool, pcp);
+			addr = gen_pool_alloc(pool, size);
+		}
+	} else {
+		addr = gen_pool_alloc(pool, size);
+	}
 	if (!addr)
 		return NULL;
 
 	phys = gen_pool_virt_to_phys(pool, addr);
 	if (phys_addr_ok && !phys_addr_ok(dev, phys, size)) {
-		gen_pool_free(pool, addr, size);
+		if (pcp)
+			dma_pool_cache_free(pool, pcp, addr, order);
+		else
+			gen_pool_free(pool, addr, size);
 		return NULL;
 	}
 
-	if (gen_pool_avail(pool) < atomic_pool_size)
+	if (!pcp && gen_pool_avail(pool) < atomic_pool_size)
 		schedule_work(&atomic_pool_work);
 
 	*cpu_addr = (void *)addr;
@@ -282,12 +444,18 @@ struct page *dma_alloc_from_pool(struct device *dev, size_t size,
 
 bool dma_free_from_pool(struct device *dev, void *start, size_t size)
 {
+	struct dma_pool_cache __percpu *pcp;
 	struct gen_pool *pool = NULL;
 
 	while ((pool = dma_guess_pool(pool, 0))) {
 		if (!gen_pool_has_addr(pool, (unsigned long)start, size))
 			continue;
-		gen_pool_free(pool, (unsigned long)start, size);
+		pcp = dma_pool_cache(pool, size);
+		if (pcp)
+			dma_pool_cache_free(pool, pcp, (unsigned long)start,
+					    get_order(size));
+		else
+			gen_pool_free(pool, (unsigned long)start, size);
 		return true;
 	}
 
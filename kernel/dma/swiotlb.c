@@ -35,16 +35,21 @@
 #include <linux/memblock.h>
 #include <linux/mm.h>
 #include <linux/pfn.h>
+#include <linux/rculist.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/set_memory.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/swiotlb.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #ifdef CONFIG_DMA_RESTRICTED_POOL
 #include <linux/of.h>
 #include <linux/of_fdt.h>
 #include <linux/of_reserved_mem.h>
+#endif
+#if defined(CONFIG_DMA_RESTRICTED_POOL) || defined(CONFIG_SWIOTLB_DYNAMIC)
 #include <linux/slab.h>
 #endif
 
@@ -71,8 +76,35 @@ struct io_tlb_slot {
 static bool swiotlb_force_bounce;
 static bool swiotlb_force_disable;
 
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+
+/*
+ * A new pool is allocated in the background once this percentage of all
+ * slots is in use, and dynamic pools are freed again once the usage would
+ * stay below SWIOTLB_SHRINK_PCT without them.
+ */
+#define SWIOTLB_GROW_PCT	75
+#define SWIOTLB_SHRINK_PCT	50
+#define SWIOTLB_SHRINK_DELAY	(10 * HZ)
+
+static void swiotlb_dyn_alloc(struct work_struct *work);
+static void swiotlb_dyn_shrink(struct work_struct *work);
+
+struct io_tlb_mem io_tlb_default_mem = {
+	.lock = __SPIN_LOCK_UNLOCKED(io_tlb_default_mem.lock),
+	.pools = LIST_HEAD_INIT(io_tlb_default_mem.pools),
+	.dyn_alloc = __WORK_INITIALIZER(io_tlb_default_mem.dyn_alloc,
+					swiotlb_dyn_alloc),
+	.dyn_shrink = __DELAYED_WORK_INITIALIZER(io_tlb_default_mem.dyn_shrink,
+						 swiotlb_dyn_shrink, 0),
+};
+
+#else  /* !CONFIG_SWIOTLB_DYNAMIC */
+
 struct io_tlb_mem io_tlb_default_mem;
 
+#endif	/* CONFIG_SWIOTLB_DYNAMIC */
+
 static unsigned long default_nslabs = IO_TLB_DEFAULT_SIZE >> IO_TLB_SHIFT;
 static unsigned long default_nareas;
 
@@ -83,15 +115,25 @@ static unsigned long default_nareas;
  *
  * @used:	The number of used IO TLB block.
  * @index:	The slot index to start searching in this area for next round.
+ * @closed:	%true if no new slots may be allocated from this area, because
+ *		the pool it belongs to is about to be freed.
  * @lock:	The lock to protect the above data structures in the map and
  *		unmap calls.
  */
 struct io_tlb_area {
 	unsigned long used;
 	unsigned int index;
+	bool closed;
 	spinlock_t lock;
 };
 
+/*
+ * The area a CPU starts searching in, relative to its own one. It is moved
+ * to wherever the CPU last found free slots, so that a CPU whose home area
+ * is exhausted does not contend on that area's lock over and over again.
+ */
+static DEFINE_PER_CPU(unsigned int, swiotlb_area_offset);
+
 /*
  * Round up number of slabs to the next power of 2. The last area is going
  * be smaller than the rest if default_nslabs is not power of two.
@@ -178,15 +220,15 @@ void __init swiotlb_adjust_size(unsigned long size)
 
 void swiotlb_print_info(void)
 {
-	struct io_tlb_mem *mem = &io_tlb_default_mem;
+	struct io_tlb_pool *pool = &io_tlb_default_mem.defpool;
 
-	if (!mem->nslabs) {
+	if (!pool->nslabs) {
 		pr_warn("No low mem\n");
 		return;
 	}
 
-	pr_info("mapped [mem %pa-%pa] (%luMB)\n", &mem->start, &mem->end,
-	       (mem->nslabs << IO_TLB_SHIFT) >> 20);
+	pr_info("mapped [mem %pa-%pa] (%luMB)\n", &pool->start, &pool->end,
+	       (pool->nslabs << IO_TLB_SHIFT) >> 20);
 }
 
 static inline unsigned long io_tlb_offset(unsigned long val)
@@ -207,18 +249,18 @@ static inline unsigned long nr_slots(u64 val)
  */
 void __init swiotlb_update_mem_attributes(void)
 {
-	struct io_tlb_mem *mem = &io_tlb_default_mem;
+	struct io_tlb_pool *pool = &io_tlb_default_mem.defpool;
 	unsigned long bytes;
 
-	if (!mem->nslabs || mem->late_alloc)
+	if (!pool->nslabs || pool->late_alloc)
 		return;
-	bytes = PAGE_ALIGN(mem->nslabs << IO_TLB_SHIFT);
-	set_memory_decrypted((unsigned long)mem->vaddr, bytes >> PAGE_SHIFT);
+	bytes = PAGE_ALIGN(pool->nslabs << IO_TLB_SHIFT);
+	set_memory_decrypted((unsigned long)pool->vaddr, bytes >> PAGE_SHIFT);
 }
 
-static void swiotlb_init_io_tlb_mem(struct io_tlb_mem *mem, phys_addr_t start,
-		unsigned long nslabs, unsigned int flags,
-		bool late_alloc, unsigned int nareas)
+static void swiotlb_init_io_tlb_pool(struct io_tlb_pool *mem,
+		phys_addr_t start, unsigned long nslabs, bool late_alloc,
+		unsigned int nareas, int nid)
 {
 	void *vaddr = phys_to_virt(start);
 	unsigned long bytes = nslabs << IO_TLB_SHIFT, i;
@@ -229,13 +271,13 @@ static void swiotlb_init_io_tlb_mem(struct io_tlb_mem *mem, phys_addr_t start,
 	mem->late_alloc = late_alloc;
 	mem->nareas = nareas;
 	mem->area_nslabs = nslabs / mem->nareas;
-
-	mem->force_bounce = swiotlb_force_bounce || (flags & SWIOTLB_FORCE);
+	mem->nid = nid;
 
 	for (i = 0; i < mem->nareas; i++) {
 		spin_lock_init(&mem->areas[i].lock);
 		mem->areas[i].index = 0;
 		mem->areas[i].used = 0;
+		mem->areas[i].closed = false;
 	}
 
 	for (i = 0; i < mem->nslabs; i++) {
@@ -249,6 +291,23 @@ static void swiotlb_init_io_tlb_mem(struct io_tlb_mem *mem, phys_addr_t start,
 	return;
 }
 
+/**
+ * add_mem_pool() - add a memory pool to the allocator
+ * @mem:	Software IO TLB allocator.
+ * @pool:	Memory pool to be added.
+ */
+static void add_mem_pool(struct io_tlb_mem *mem, struct io_tlb_pool *pool)
+{
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+	spin_lock(&mem->lock);
+	list_add_tail_rcu(&pool->node, &mem->pools);
+	WRITE_ONCE(mem->nslabs, mem->nslabs + pool->nslabs);
+	spin_unlock(&mem->lock);
+#else
+	mem->nslabs += pool->nslabs;
+#endif
+}
+
 static void __init *swiotlb_memblock_alloc(unsigned long nslabs,
 		unsigned int flags,
 		int (*remap)(void *tlb, unsigned long nslabs))
@@ -289,6 +348,7 @@ void __init swiotlb_init_remap(bool addressing_limit, unsigned int flags,
 		int (*remap)(void *tlb, unsigned long nslabs))
 {
 	struct io_tlb_mem *mem = &io_tlb_default_mem;
+	struct io_tlb_pool *pool = &mem->defpool;
 	unsigned long nslabs;
 	size_t alloc_size;
 	void *tlb;
@@ -318,23 +378,36 @@ void __init swiotlb_init_remap(bool addressing_limit, unsigned int flags,
 		default_nslabs = nslabs;
 	}
 
-	alloc_size = PAGE_ALIGN(array_size(sizeof(*mem->slots), nslabs));
-	mem->slots = memblock_alloc(alloc_size, PAGE_SIZE);
-	if (!mem->slots) {
+	alloc_size = PAGE_ALIGN(array_size(sizeof(*pool->slots), nslabs));
+	pool->slots = memblock_alloc(alloc_size, PAGE_SIZE);
+	if (!pool->slots) {
 		pr_warn("%s: Failed to allocate %zu bytes align=0x%lx\n",
 			__func__, alloc_size, PAGE_SIZE);
 		return;
 	}
 
-	mem->areas = memblock_alloc(array_size(sizeof(struct io_tlb_area),
+	pool->areas = memblock_alloc(array_size(sizeof(struct io_tlb_area),
 		default_nareas), SMP_CACHE_BYTES);
-	if (!mem->areas) {
-		pr_warn("%s: Failed to allocate mem->areas.\n", __func__);
+	if (!pool->areas) {
+		pr_warn("%s: Failed to allocate pool->areas.\n", __func__);
 		return;
 	}
 
-	swiotlb_init_io_tlb_mem(mem, __pa(tlb), nslabs, flags, false,
-				default_nareas);
+	swiotlb_init_io_tlb_pool(pool, __pa(tlb), nslabs, false, default_nareas,
+				 early_pfn_to_nid(PHYS_PFN(__pa(tlb))));
+
+	mem->force_bounce = swiotlb_force_bounce || (flags & SWIOTLB_FORCE);
+
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+	/* Dynamic pools cannot be remapped the way the initial one is. */
+	if (!remap)
+		mem->can_grow = true;
+	if (flags & SWIOTLB_ANY)
+		mem->phys_limit = virt_to_phys(high_memory - 1);
+	else
+		mem->phys_limit = ARCH_LOW_ADDRESS_LIMIT;
+#endif
+	add_mem_pool(mem, pool);
 
 	if (flags & SWIOTLB_VERBOSE)
 		swiotlb_print_info();
@@ -354,6 +427,7 @@ int swiotlb_init_late(size_t size, gfp_t gfp_mask,
 		int (*remap)(void *tlb, unsigned long nslabs))
 {
 	struct io_tlb_mem *mem = &io_tlb_default_mem;
+	struct io_tlb_pool *pool = &mem->defpool;
 	unsigned long nslabs = ALIGN(size >> IO_TLB_SHIFT, IO_TLB_SEGSIZE);
 	unsigned char *vstart = NULL;
 	unsigned int order, area_order;
@@ -400,28 +474,42 @@ int swiotlb_init_late(size_t size, gfp_t gfp_mask,
 	if (!default_nareas)
 		swiotlb_adjust_nareas(num_possible_cpus());
 
-	area_order = get_order(array_size(sizeof(*mem->areas),
+	area_order = get_order(array_size(sizeof(*pool->areas),
 		default_nareas));
-	mem->areas = (struct io_tlb_area *)
+	pool->areas = (struct io_tlb_area *)
 		__get_free_pages(GFP_KERNEL | __GFP_ZERO, area_order);
-	if (!mem->areas)
+	if (!pool->areas)
 		goto error_area;
 
-	mem->slots = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
-		get_order(array_size(sizeof(*mem->slots), nslabs)));
-	if (!mem->slots)
+	pool->slots = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
+		get_order(array_size(sizeof(*pool->slots), nslabs)));
+	if (!pool->slots)
 		goto error_slots;
 
 	set_memory_decrypted((unsigned long)vstart,
 			     (nslabs << IO_TLB_SHIFT) >> PAGE_SHIFT);
-	swiotlb_init_io_tlb_mem(mem, virt_to_phys(vstart), nslabs, 0, true,
-				default_nareas);
+	swiotlb_init_io_tlb_pool(pool, virt_to_phys(vstart), nslabs, true,
+				 default_nareas,
+				 page_to_nid(virt_to_page(vstart)));
+	mem->force_bounce = swiotlb_force_bounce;
+
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+	if (!remap)
+		mem->can_grow = true;
+	if (gfp_mask & __GFP_DMA)
+		mem->phys_limit = DMA_BIT_MASK(zone_dma_bits);
+	else if (gfp_mask & __GFP_DMA32)
+		mem->phys_limit = DMA_BIT_MASK(32);
+	else
+		mem->phys_limit = virt_to_phys(high_memory - 1);
+#endif
+	add_mem_pool(mem, pool);
 
 	swiotlb_print_info();
 	return 0;
 
 error_slots:
-	free_pages((unsigned long)mem->areas, area_order);
+	free_pages((unsigned long)pool->areas, area_order);
 error_area:
 	free_pages((unsigned long)vstart, order);
 	return -ENOMEM;
@@ -430,6 +518,7 @@ int swiotlb_init_late(size_t size, gfp_t gfp_mask,
 void __init swiotlb_exit(void)
 {
 	struct io_tlb_mem *mem = &io_tlb_default_mem;
+	struct io_tlb_pool *pool = &mem->defpool;
 	unsigned long tbl_vaddr;
 	size_t tbl_size, slots_size;
 	unsigned int area_order;
@@ -440,26 +529,40 @@ void __init swiotlb_exit(void)
 	if (!mem->nslabs)
 		return;
 
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+	/* Somebody already needed more than the default pool. */
+	mem->can_grow = false;
+	flush_work(&mem->dyn_alloc);
+	if (mem->nslabs != pool->nslabs)
+		return;
+#endif
+
 	pr_info("tearing down default memory pool\n");
-	tbl_vaddr = (unsigned long)phys_to_virt(mem->start);
-	tbl_size = PAGE_ALIGN(mem->end - mem->start);
-	slots_size = PAGE_ALIGN(array_size(sizeof(*mem->slots), mem->nslabs));
+	tbl_vaddr = (unsigned long)phys_to_virt(pool->start);
+	tbl_size = PAGE_ALIGN(pool->end - pool->start);
+	slots_size = PAGE_ALIGN(array_size(sizeof(*pool->slots), pool->nslabs));
 
 	set_memory_encrypted(tbl_vaddr, tbl_size >> PAGE_SHIFT);
-	if (mem->late_alloc) {
-		area_order = get_order(array_size(sizeof(*mem->areas),
-			mem->nareas));
-		free_pages((unsigned long)mem->areas, area_order);
+	if (pool->late_alloc) {
+		area_order = get_order(array_size(sizeof(*pool->areas),
+			pool->nareas));
+		free_pages((unsigned long)pool->areas, area_order);
 		free_pages(tbl_vaddr, get_order(tbl_size));
-		free_pages((unsigned long)mem->slots, get_order(slots_size));
+		free_pages((unsigned long)pool->slots, get_order(slots_size));
 	} else {
-		memblock_free_late(__pa(mem->areas),
-			array_size(sizeof(*mem->areas), mem->nareas));
-		memblock_free_late(mem->start, tbl_size);
-		memblock_free_late(__pa(mem->slots), slots_size);
+		memblock_free_late(__pa(pool->areas),
+			array_size(sizeof(*pool->areas), pool->nareas));
+		memblock_free_late(pool->start, tbl_size);
+		memblock_free_late(__pa(pool->slots), slots_size);
 	}
 
-	memset(mem, 0, sizeof(*mem));
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+	list_del_rcu(&pool->node);
+	synchronize_rcu();
+#endif
+	memset(pool, 0, sizeof(*pool));
+	mem->nslabs = 0;
+	mem->force_bounce = false;
 }
 
 /*
@@ -476,7 +579,7 @@ static unsigned int swiotlb_align_offset(struct device *dev, u64 addr)
 static void swiotlb_bounce(struct device *dev, phys_addr_t tlb_addr, size_t size,
 			   enum dma_data_direction dir)
 {
-	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
+	struct io_tlb_pool *mem = swiotlb_find_pool(dev, tlb_addr);
 	int index = (tlb_addr - mem->start) >> IO_TLB_SHIFT;
 	phys_addr_t orig_addr = mem->slots[index].orig_addr;
 	size_t alloc_size = mem->slots[index].alloc_size;
@@ -558,7 +661,7 @@ static inline unsigned long get_max_slots(unsigned long boundary_mask)
 	return nr_slots(boundary_mask + 1);
 }
 
-static unsigned int wrap_area_index(struct io_tlb_mem *mem, unsigned int index)
+static unsigned int wrap_area_index(struct io_tlb_pool *mem, unsigned int index)
 {
 	if (index >= mem->area_nslabs)
 		return 0;
@@ -590,7 +693,19 @@ static void dec_used(struct io_tlb_mem *mem, unsigned int nslots)
 	atomic_long_sub(nslots, &mem->total_used);
 }
 
-#else /* !CONFIG_DEBUG_FS */
+#elif defined(CONFIG_SWIOTLB_DYNAMIC)
+
+static void inc_used_and_hiwater(struct io_tlb_mem *mem, unsigned int nslots)
+{
+	atomic_long_add(nslots, &mem->total_used);
+}
+
+static void dec_used(struct io_tlb_mem *mem, unsigned int nslots)
+{
+	atomic_long_sub(nslots, &mem->total_used);
+}
+
+#else /* !CONFIG_DEBUG_FS && !CONFIG_SWIOTLB_DYNAMIC */
 static void inc_used_and_hiwater(struct io_tlb_mem *mem, unsigned int nslots)
 {
 }
@@ -601,13 +716,12 @@ static void dec_used(struct io_tlb_mem *mem, unsigned int nslots)
 
 /*
  * Find a suitable number of IO TLB entries size that will fit this request and
- * allocate a buffer from that IO TLB pool.
+ * allocate a buffer from that IO TLB area of @mem.
  */
-static int swiotlb_do_find_slots(struct device *dev, int area_index,
-		phys_addr_t orig_addr, size_t alloc_size,
+static int swiotlb_area_find_slots(struct device *dev, struct io_tlb_pool *mem,
+		int area_index, phys_addr_t orig_addr, size_t alloc_size,
 		unsigned int alloc_align_mask)
 {
-	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
 	struct io_tlb_area *area = mem->areas + area_index;
 	unsigned long boundary_mask = dma_get_seg_boundary(dev);
 	dma_addr_t tbl_dma_addr =
@@ -640,7 +754,7 @@ static int swiotlb_do_find_slots(struct device *dev, int area_index,
 	stride = (iotlb_align_mask >> IO_TLB_SHIFT) + 1;
 
 	spin_lock_irqsave(&area->lock, flags);
-	if (unlikely(nslots > mem->area_nslabs - area->used))
+	if (unlikely(area->closed || nslots > mem->area_nslabs - area->used))
 		goto not_found;
 
 	slot_base = area_index * mem->area_nslabs;
@@ -694,39 +808,349 @@ static int swiotlb_do_find_slots(struct device *dev, int area_index,
 	area->used += nslots;
 	spin_unlock_irqrestore(&area->lock, flags);
 
-	inc_used_and_hiwater(mem, nslots);
+	inc_used_and_hiwater(dev->dma_io_tlb_mem, nslots);
 	return slot_index;
 }
 
-static int swiotlb_find_slots(struct device *dev, phys_addr_t orig_addr,
-		size_t alloc_size, unsigned int alloc_align_mask)
+/*
+ * Allocate slots from @pool, starting in the area this CPU last allocated
+ * from.
+ */
+static int swiotlb_pool_find_slots(struct device *dev, struct io_tlb_pool *pool,
+		phys_addr_t orig_addr, size_t alloc_size,
+		unsigned int alloc_align_mask)
 {
-	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
-	int start = raw_smp_processor_id() & (mem->nareas - 1);
+	unsigned int cpu = raw_smp_processor_id();
+	unsigned int offset = raw_cpu_read(swiotlb_area_offset);
+	int start = (cpu + offset) & (pool->nareas - 1);
 	int i = start, index;
 
 	do {
-		index = swiotlb_do_find_slots(dev, i, orig_addr, alloc_size,
-					      alloc_align_mask);
-		if (index >= 0)
+		index = swiotlb_area_find_slots(dev, pool, i, orig_addr,
+						alloc_size, alloc_align_mask);
+		if (index >= 0) {
+			if (i != start)
+				raw_cpu_write(swiotlb_area_offset, i - cpu);
 			return index;
-		if (++i >= mem->nareas)
+		}
+		if (++i >= pool->nareas)
 			i = 0;
 	} while (i != start);
 
 	return -1;
 }
 
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+
 static unsigned long mem_used(struct io_tlb_mem *mem)
 {
+	return atomic_long_read(&mem->total_used);
+}
+
+/*
+ * Allocate a pool of up to @nslabs slabs on node @nid. Dynamic pools are
+ * limited to what the page allocator can hand out in one piece, so a large
+ * default size is made up of several of them.
+ */
+static struct io_tlb_pool *swiotlb_alloc_pool(struct io_tlb_mem *mem, int nid,
+		unsigned long nslabs)
+{
+	unsigned int order = min_t(unsigned int,
+				   get_order(nslabs << IO_TLB_SHIFT), MAX_ORDER);
+	unsigned int min_order = get_order(IO_TLB_MIN_SLABS << IO_TLB_SHIFT);
+	unsigned int nareas;
+	struct io_tlb_pool *pool;
+	struct page *page;
+	gfp_t gfp = GFP_KERNEL | __GFP_NOWARN;
+
+	if (mem->phys_limit <= DMA_BIT_MASK(zone_dma_bits))
+		gfp |= GFP_DMA;
+	else if (mem->phys_limit <= DMA_BIT_MASK(32))
+		gfp |= GFP_DMA32;
+
+	pool = kzalloc_node(sizeof(*pool), GFP_KERNEL, nid);
+	if (!pool)
+		return NULL;
+
+	for (;;) {
+		page = alloc_pages_node(nid, gfp, order);
+		if (page)
+			break;
+		if (order <= min_order)
+			goto error_pool;
+		order--;
+	}
+
+	if (page_to_phys(page) + (PAGE_SIZE << order) - 1 > mem->phys_limit)
+		goto error_pages;
+
+	nslabs = SLABS_PER_PAGE << order;
+	nareas = min_t(unsigned int, mem->defpool.nareas,
+		       nslabs / IO_TLB_SEGSIZE);
+	nareas = rounddown_pow_of_two(max(nareas, 1U));
+
+	pool->areas = kcalloc_node(nareas, sizeof(*pool->areas), GFP_KERNEL,
+				   nid);
+	if (!pool->areas)
+		goto error_pages;
+
+	pool->slots = kvmalloc_node(array_size(nslabs, sizeof(*pool->slots)),
+				    GFP_KERNEL, nid);
+	if (!pool->slots)
+		goto error_areas;
+
+	if (set_memory_decrypted((unsigned long)page_address(page),
+				 1 << order)) {
+		/* The pages are in an unknown state, leak them. */
+		kvfree(pool->slots);
+		kfree(pool->areas);
+		kfree(pool);
+		return NULL;
+	}
+
+	swiotlb_init_io_tlb_pool(pool, page_to_phys(page), nslabs, true,
+				 nareas, page_to_nid(page));
+	return pool;
+
+error_areas:
+	kfree(pool->areas);
+error_pages:
+	__free_pages(page, order);
+error_pool:
+	kfree(pool);
+	return NULL;
+}
+
+static void swiotlb_free_pool(struct io_tlb_pool *pool)
+{
+	size_t bytes = pool->end - pool->start;
+	unsigned int order = get_order(bytes);
+
+	if (!set_memory_encrypted((unsigned long)pool->vaddr,
+				  bytes >> PAGE_SHIFT))
+		free_pages((unsigned long)pool->vaddr, order);
+	kvfree(pool->slots);
+	kfree(pool->areas);
+	kfree(pool);
+}
+
+static void swiotlb_dyn_alloc(struct work_struct *work)
+{
+	struct io_tlb_mem *mem =
+		container_of(work, struct io_tlb_mem, dyn_alloc);
+	struct io_tlb_pool *pool;
+
+	pool = swiotlb_alloc_pool(mem, READ_ONCE(mem->dyn_nid),
+				  default_nslabs);
+	if (!pool) {
+		pr_warn_ratelimited("Failed to allocate new pool");
+		return;
+	}
+
+	add_mem_pool(mem, pool);
+	mod_delayed_work(system_unbound_wq, &mem->dyn_shrink,
+			 SWIOTLB_SHRINK_DELAY);
+}
+
+/*
+ * Stop further allocations from @pool. Fails, and leaves the pool alone,
+ * if any of its slots is still in use.
+ */
+static bool swiotlb_close_pool(struct io_tlb_pool *pool)
+{
+	struct io_tlb_area *area;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < pool->nareas; i++) {
+		area = &pool->areas[i];
+		spin_lock_irqsave(&area->lock, flags);
+		if (area->used) {
+			spin_unlock_irqrestore(&area->lock, flags);
+			goto reopen;
+		}
+		area->closed = true;
+		spin_unlock_irqrestore(&area->lock, flags);
+	}
+	return true;
+
+reopen:
+	while (i--) {
+		area = &pool->areas[i];
+		spin_lock_irqsave(&area->lock, flags);
+		area->closed = false;
+		spin_unlock_irqrestore(&area->lock, flags);
+	}
+	return false;
+}
+
+/*
+ * Free the empty dynamic pools, newest first, as long as the remaining
+ * slots keep the usage below SWIOTLB_SHRINK_PCT. Runs again later while
+ * any dynamic pool is left.
+ */
+static void swiotlb_dyn_shrink(struct work_struct *work)
+{
+	struct io_tlb_mem *mem =
+		container_of(to_delayed_work(work), struct io_tlb_mem,
+			     dyn_shrink);
+	struct io_tlb_pool *pool, *victim;
+	unsigned long left;
+	bool more;
+
+	do {
+		victim = NULL;
+		more = false;
+
+		spin_lock(&mem->lock);
+		list_for_each_entry_reverse(pool, &mem->pools, node) {
+			if (pool == &mem->defpool)
+				break;
+			more = true;
+			left = mem->nslabs - pool->nslabs;
+			if (mem_used(mem) * 100 > left * SWIOTLB_SHRINK_PCT)
+				break;
+			if (swiotlb_close_pool(pool)) {
+				victim = pool;
+				list_del_rcu(&pool->node);
+				WRITE_ONCE(mem->nslabs, left);
+				break;
+			}
+		}
+		spin_unlock(&mem->lock);
+
+		if (victim) {
+			synchronize_rcu();
+			swiotlb_free_pool(victim);
+		}
+	} while (victim);
+
+	if (more)
+		queue_delayed_work(system_unbound_wq, &mem->dyn_shrink,
+				   SWIOTLB_SHRINK_DELAY);
+}
+
+/*
+ * Grow ahead of demand: mappings are created in atomic context and cannot
+ * wait for a new pool, so one is allocated in the background before the
+ * existing ones run full, and after any mapping failure.
+ */
+static void swiotlb_dyn_grow(struct io_tlb_mem *mem, int nid, bool failed)
+{
+	if (!mem->can_grow)
+		return;
+	if (!failed &&
+	    mem_used(mem) * 100 < READ_ONCE(mem->nslabs) * SWIOTLB_GROW_PCT)
+		return;
+
+	WRITE_ONCE(mem->dyn_nid, nid);
+	schedule_work(&mem->dyn_alloc);
+}
+
+/**
+ * swiotlb_find_slots() - search for slots in the whole swiotlb
+ * @dev:		Device which maps the buffer.
+ * @orig_addr:		Original (non-bounced) IO buffer address.
+ * @alloc_size:		Total requested size of the bounce buffer,
+ *			including initial alignment padding.
+ * @alloc_align_mask:	Required alignment of the allocated buffer.
+ * @retpool:		Used memory pool, updated on return.
+ *
+ * Search through the pools of the device's IO TLB for a sequence of slots
+ * that match the allocation constraints. Pools on the device's node are
+ * tried first.
+ *
+ * Return: Index of the first allocated slot, or -1 on error.
+ */
+static int swiotlb_find_slots(struct device *dev, phys_addr_t orig_addr,
+		size_t alloc_size, unsigned int alloc_align_mask,
+		struct io_tlb_pool **retpool)
+{
+	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
+	struct io_tlb_pool *pool;
+	int nid = dev_to_node(dev);
+	bool local = true;
+	int index;
+
+	if (nid == NUMA_NO_NODE)
+		nid = numa_node_id();
+
+	rcu_read_lock();
+again:
+	list_for_each_entry_rcu(pool, &mem->pools, node) {
+		if ((pool->nid == nid) != local)
+			continue;
+		index = swiotlb_pool_find_slots(dev, pool, orig_addr,
+						alloc_size, alloc_align_mask);
+		if (index >= 0) {
+			rcu_read_unlock();
+			swiotlb_dyn_grow(mem, nid, false);
+			*retpool = pool;
+			return index;
+		}
+	}
+	if (local) {
+		local = false;
+		goto again;
+	}
+	rcu_read_unlock();
+
+	swiotlb_dyn_grow(mem, nid, true);
+	return -1;
+}
+
+/**
+ * __swiotlb_find_pool() - find the dynamic IO TLB pool for a physical address
+ * @dev:        Device which has mapped the DMA buffer.
+ * @paddr:      Physical address within the DMA buffer.
+ *
+ * Slow path of swiotlb_find_pool(), for addresses outside the default pool.
+ *
+ * Return: Memory pool which contains @paddr, or %NULL if none.
+ */
+struct io_tlb_pool *__swiotlb_find_pool(struct device *dev, phys_addr_t paddr)
+{
+	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
+	struct io_tlb_pool *pool;
+
+	if (READ_ONCE(mem->nslabs) == mem->defpool.nslabs)
+		return NULL;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(pool, &mem->pools, node) {
+		if (paddr >= pool->start && paddr < pool->end)
+			goto out;
+	}
+	pool = NULL;
+out:
+	rcu_read_unlock();
+	return pool;
+}
+
+#else  /* !CONFIG_SWIOTLB_DYNAMIC */
+
+static unsigned long mem_used(struct io_tlb_mem *mem)
+{
+	struct io_tlb_pool *pool = &mem->defpool;
 	int i;
 	unsigned long used = 0;
 
-	for (i = 0; i < mem->nareas; i++)
-		used += mem->areas[i].used;
+	for (i = 0; i < pool->nareas; i++)
+		used += pool->areas[i].used;
 	return used;
 }
 
+static int swiotlb_find_slots(struct device *dev, phys_addr_t orig_addr,
+		size_t alloc_size, unsigned int alloc_align_mask,
+		struct io_tlb_pool **retpool)
+{
+	*retpool = &dev->dma_io_tlb_mem->defpool;
+	return swiotlb_pool_find_slots(dev, *retpool, orig_addr, alloc_size,
+				       alloc_align_mask);
+}
+
+#endif	/* CONFIG_SWIOTLB_DYNAMIC */
+
 phys_addr_t swiotlb_tbl_map_single(struct device *dev, phys_addr_t orig_addr,
 		size_t mapping_size, size_t alloc_size,
 		unsigned int alloc_align_mask, enum dma_data_direction dir,
@@ -734,6 +1158,7 @@ phys_addr_t swiotlb_tbl_map_single(struct device *dev, phys_addr_t orig_addr,
 {
 	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
 	unsigned int offset = swiotlb_align_offset(dev, orig_addr);
+	struct io_tlb_pool *pool;
 	unsigned int i;
 	int index;
 	phys_addr_t tlb_addr;
@@ -754,7 +1179,7 @@ phys_addr_t swiotlb_tbl_map_single(struct device *dev, phys_addr_t orig_addr,
 	}
 
 	index = swiotlb_find_slots(dev, orig_addr,
-				   alloc_size + offset, alloc_align_mask);
+				   alloc_size + offset, alloc_align_mask, &pool);
 	if (index == -1) {
 		if (!(attrs & DMA_ATTR_NO_WARN))
 			dev_warn_ratelimited(dev,
@@ -769,8 +1194,8 @@ phys_addr_t swiotlb_tbl_map_single(struct device *dev, phys_addr_t orig_addr,
 	 * needed.
 	 */
 	for (i = 0; i < nr_slots(alloc_size + offset); i++)
-		mem->slots[index + i].orig_addr = slot_addr(orig_addr, i);
-	tlb_addr = slot_addr(mem->start, index) + offset;
+		pool->slots[index + i].orig_addr = slot_addr(orig_addr, i);
+	tlb_addr = slot_addr(pool->start, index) + offset;
 	/*
 	 * When dir == DMA_FROM_DEVICE we could omit the copy from the orig
 	 * to the tlb buffer, if we knew for sure the device will
@@ -784,7 +1209,7 @@ phys_addr_t swiotlb_tbl_map_single(struct device *dev, phys_addr_t orig_addr,
 
 static void swiotlb_release_slots(struct device *dev, phys_addr_t tlb_addr)
 {
-	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
+	struct io_tlb_pool *mem = swiotlb_find_pool(dev, tlb_addr);
 	unsigned long flags;
 	unsigned int offset = swiotlb_align_offset(dev, tlb_addr);
 	int index = (tlb_addr - offset - mem->start) >> IO_TLB_SHIFT;
@@ -828,7 +1253,7 @@ static void swiotlb_release_slots(struct device *dev, phys_addr_t tlb_addr)
 	area->used -= nslots;
 	spin_unlock_irqrestore(&area->lock, flags);
 
-	dec_used(mem, nslots);
+	dec_used(dev->dma_io_tlb_mem, nslots);
 }
 
 /*
@@ -957,10 +1382,42 @@ DEFINE_DEBUGFS_ATTRIBUTE(fops_io_tlb_used, io_tlb_used_get, NULL, "%llu\n");
 DEFINE_DEBUGFS_ATTRIBUTE(fops_io_tlb_hiwater, io_tlb_hiwater_get,
 				io_tlb_hiwater_set, "%llu\n");
 
+static void swiotlb_show_pool(struct seq_file *m, struct io_tlb_pool *pool)
+{
+	unsigned long used = 0;
+	int i;
+
+	for (i = 0; i < pool->nareas; i++)
+		used += READ_ONCE(pool->areas[i].used);
+
+	seq_printf(m, "%pa-%pa %d %lu %lu\n", &pool->start, &pool->end,
+		   pool->nid, pool->nslabs, used);
+}
+
+/*
+ * One line per memory pool: the physical address range, the NUMA node, and
+ * the number of total and used slots.
+ */
+static int io_tlb_pools_show(struct seq_file *m, void *v)
+{
+	struct io_tlb_mem *mem = m->private;
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+	struct io_tlb_pool *pool;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(pool, &mem->pools, node)
+		swiotlb_show_pool(m, pool);
+	rcu_read_unlock();
+#else
+	swiotlb_show_pool(m, &mem->defpool);
+#endif
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(io_tlb_pools);
+
 static void swiotlb_create_debugfs_files(struct io_tlb_mem *mem,
 					 const char *dirname)
 {
-	atomic_long_set(&mem->total_used, 0);
 	atomic_long_set(&mem->used_hiwater, 0);
 
 	mem->debugfs = debugfs_create_dir(dirname, io_tlb_default_mem.debugfs);
@@ -972,6 +1429,8 @@ static void swiotlb_create_debugfs_files(struct io_tlb_mem *mem,
 			&fops_io_tlb_used);
 	debugfs_create_file("io_tlb_used_hiwater", 0600, mem->debugfs, mem,
 			&fops_io_tlb_hiwater);
+	debugfs_create_file("io_tlb_pools", 0400, mem->debugfs, mem,
+			&io_tlb_pools_fops);
 }
 
 static int __init swiotlb_create_default_debugfs(void)
@@ -996,17 +1455,18 @@ static inline void swiotlb_create_debugfs_files(struct io_tlb_mem *mem,
 struct page *swiotlb_alloc(struct device *dev, size_t size)
 {
 	struct io_tlb_mem *mem = dev->dma_io_tlb_mem;
+	struct io_tlb_pool *pool;
 	phys_addr_t tlb_addr;
 	int index;
 
 	if (!mem)
 		return NULL;
 
-	index = swiotlb_find_slots(dev, 0, size, 0);
+	index = swiotlb_find_slots(dev, 0, size, 0, &pool);
 	if (index == -1)
 		return NULL;
 
-	tlb_addr = slot_addr(mem->start, index);
+	tlb_addr = slot_addr(pool->start, index);
 
 	return pfn_to_page(PFN_DOWN(tlb_addr));
 }
@@ -1027,6 +1487,7 @@ static int rmem_swiotlb_device_init(struct reserved_mem *rmem,
 				    struct device *dev)
 {
 	struct io_tlb_mem *mem = rmem->priv;
+	struct io_tlb_pool *pool;
 	unsigned long nslabs = rmem->size >> IO_TLB_SHIFT;
 
 	/* Set Per-device io tlb area to one */
@@ -1047,25 +1508,33 @@ static int rmem_swiotlb_device_init(struct reserved_mem *rmem,
 		if (!mem)
 			return -ENOMEM;
 
-		mem->slots = kcalloc(nslabs, sizeof(*mem->slots), GFP_KERNEL);
-		if (!mem->slots) {
+		pool = &mem->defpool;
+
+		pool->slots = kcalloc(nslabs, sizeof(*pool->slots), GFP_KERNEL);
+		if (!pool->slots) {
 			kfree(mem);
 			return -ENOMEM;
 		}
 
-		mem->areas = kcalloc(nareas, sizeof(*mem->areas),
+		pool->areas = kcalloc(nareas, sizeof(*pool->areas),
 				GFP_KERNEL);
-		if (!mem->areas) {
-			kfree(mem->slots);
+		if (!pool->areas) {
+			kfree(pool->slots);
 			kfree(mem);
 			return -ENOMEM;
 		}
 
 		set_memory_decrypted((unsigned long)phys_to_virt(rmem->base),
 				     rmem->size >> PAGE_SHIFT);
-		swiotlb_init_io_tlb_mem(mem, rmem->base, nslabs, SWIOTLB_FORCE,
-					false, nareas);
+		swiotlb_init_io_tlb_pool(pool, rmem->base, nslabs, false, nareas,
+					 pfn_to_nid(PHYS_PFN(rmem->base)));
+		mem->force_bounce = true;
 		mem->for_alloc = true;
+#ifdef CONFIG_SWIOTLB_DYNAMIC
+		spin_lock_init(&mem->lock);
+		INIT_LIST_HEAD(&mem->pools);
+#endif
+		add_mem_pool(mem, pool);
 
 		rmem->priv = mem;
 
@@ -11,6 +11,7 @@
 #include <linux/perf_event.h>
 #include <linux/slab.h>
 #include <linux/sched/task_stack.h>
+#include <linux/xxhash.h>
 
 #include "internal.h"
 
@@ -225,6 +226,92 @@ get_perf_callchain(struct pt_regs *regs, u32 init_nr, bool kernel, bool user,
 	return entry;
 }
 
+/*
+ * With attr.callchain_dedup, the user part of a callchain is only sent in
+ * full the first time it is seen; it is then preceded by
+ * PERF_CONTEXT_USER_ID and a 64 bit hash of the user frames:
+ *
+ *   ..., PERF_CONTEXT_USER_ID, id, PERF_CONTEXT_USER, ip, ip, ...
+ *
+ * Later samples with the same user frames end in just
+ *
+ *   ..., PERF_CONTEXT_USER_ID, id
+ *
+ * The ids which have been sent are remembered in a small direct mapped
+ * table. When records are lost, the definitions may have been lost with
+ * them, so the table is cleared and everything is sent in full again.
+ */
+#define PERF_CALLCHAIN_CACHE_BITS	8
+#define PERF_CALLCHAIN_CACHE_SIZE	(1 << PERF_CALLCHAIN_CACHE_BITS)
+
+struct perf_callchain_cache {
+	long	lost;
+	u64	ids[PERF_CALLCHAIN_CACHE_SIZE];
+};
+
+int perf_callchain_cache_alloc(struct perf_event *event)
+{
+	event->callchain_cache = kzalloc(sizeof(struct perf_callchain_cache),
+					 GFP_KERNEL);
+	return event->callchain_cache ? 0 : -ENOMEM;
+}
+
+void perf_callchain_cache_free(struct perf_event *event)
+{
+	kfree(event->callchain_cache);
+	event->callchain_cache = NULL;
+}
+
+void perf_callchain_dedup(struct perf_event *event,
+			  struct perf_callchain_entry *entry)
+{
+	struct perf_callchain_cache *cache = event->callchain_cache;
+	u64 nr = entry->nr, user, id, *slot;
+	struct perf_buffer *rb;
+	long lost = 0;
+
+	for (user = 0; user < nr; user++) {
+		if (entry->ip[user] == PERF_CONTEXT_USER)
+			break;
+	}
+	if (user + 1 >= nr)
+		return;
+
+	rcu_read_lock();
+	rb = rcu_dereference(event->rb);
+	if (rb)
+		lost = local_read(&rb->lost);
+	rcu_read_unlock();
+
+	if (lost != cache->lost) {
+		memset(cache->ids, 0, sizeof(cache->ids));
+		cache->lost = lost;
+	}
+
+	/* 0 marks an empty slot */
+	id = xxh64(&entry->ip[user + 1], (nr - user - 1) * sizeof(u64), 0) ?: 1;
+	slot = &cache->ids[id & (PERF_CALLCHAIN_CACHE_SIZE - 1)];
+
+	if (*slot == id) {
+		entry->ip[user] = PERF_CONTEXT_USER_ID;
+		entry->ip[user + 1] = id;
+		entry->nr = user + 2;
+		return;
+	}
+
+	/* No room for the definition, send this one as it is. */
+	if (nr + 2 > sysctl_perf_event_max_stack +
+		     sysctl_perf_event_max_contexts_per_stack)
+		return;
+
+	memmove(&entry->ip[user + 2], &entry->ip[user],
+		(nr - user) * sizeof(u64));
+	entry->ip[user] = PERF_CONTEXT_USER_ID;
+	entry->ip[user + 1] = id;
+	entry->nr = nr + 2;
+	*slot = id;
+}
+
 /*
  * Used for sysctl_perf_event_max_stack and
  * sysctl_perf_event_max_contexts_per_stack.
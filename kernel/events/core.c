@@ -55,6 +55,7 @@
 #include <linux/pgtable.h>
 #include <linux/buildid.h>
 #include <linux/task_work.h>
+#include <linux/seq_file.h>
 
 #include "internal.h"
 
@@ -5165,6 +5166,7 @@ static void _free_event(struct perf_event *event)
 		if (event->attr.sample_type & PERF_SAMPLE_CALLCHAIN)
 			put_callchain_buffers();
 	}
+	perf_callchain_cache_free(event);
 
 	perf_event_free_bpf_prog(event);
 	perf_addr_filters_splice(event, NULL);
@@ -6384,6 +6386,14 @@ static int perf_mmap(struct file *file, struct vm_area_struct *vma)
 	if (!(vma->vm_flags & VM_SHARED))
 		return -EINVAL;
 
+	/*
+	 * A read-only buffer is overwritten like a backward one, which
+	 * callchain_dedup can't cope with, see perf_copy_attr().
+	 */
+	if (event->attr.callchain_dedup && !vma->vm_pgoff &&
+	    !(vma->vm_flags & VM_WRITE))
+		return -EINVAL;
+
 	ret = security_perf_event_read(event);
 	if (ret)
 		return ret;
@@ -6593,6 +6603,27 @@ static int perf_fasync(int fd, struct file *filp, int on)
 	return 0;
 }
 
+#ifdef CONFIG_PROC_FS
+/*
+ * Tell the owner of a buffer how much of it perf_event_contig_chunks got
+ * backed with contiguous chunks, and whether it had to settle for less.
+ */
+static void perf_show_fdinfo(struct seq_file *m, struct file *filp)
+{
+	struct perf_event *event = filp->private_data;
+	struct perf_buffer *rb;
+
+	mutex_lock(&event->mmap_mutex);
+	rb = event->rb;
+	if (rb) {
+		seq_printf(m, "data_chunk_pages:\t%d\n", rb->data_chunk_pages);
+		seq_printf(m, "aux_chunk_pages:\t%d\n", rb->aux_chunk_pages);
+		seq_printf(m, "chunk_fallback:\t%d\n", rb->chunk_fallback);
+	}
+	mutex_unlock(&event->mmap_mutex);
+}
+#endif
+
 static const struct file_operations perf_fops = {
 	.llseek			= no_llseek,
 	.release		= perf_release,
@@ -6602,6 +6633,9 @@ static const struct file_operations perf_fops = {
 	.compat_ioctl		= perf_compat_ioctl,
 	.mmap			= perf_mmap,
 	.fasync			= perf_fasync,
+#ifdef CONFIG_PROC_FS
+	.show_fdinfo		= perf_show_fdinfo,
+#endif
 };
 
 /*
@@ -7555,7 +7589,12 @@ perf_callchain(struct perf_event *event, struct pt_regs *regs)
 
 	callchain = get_perf_callchain(regs, 0, kernel, user,
 				       max_stack, crosstask, true);
-	return callchain ?: &__empty_callchain;
+	if (!callchain)
+		return &__empty_callchain;
+
+	if (event->callchain_cache)
+		perf_callchain_dedup(event, callchain);
+	return callchain;
 }
 
 static __always_inline u64 __cond_set(u64 flags, u64 s, u64 d)
@@ -11992,15 +12031,23 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 		}
 	}
 
+	if (attr->callchain_dedup) {
+		err = perf_callchain_cache_alloc(event);
+		if (err)
+			goto err_callchain_buffer;
+	}
+
 	err = security_perf_event_alloc(event);
 	if (err)
-		goto err_callchain_buffer;
+		goto err_callchain_cache;
 
 	/* symmetric to unaccount_event() in _free_event() */
 	account_event(event);
 
 	return event;
 
+err_callchain_cache:
+	perf_callchain_cache_free(event);
 err_callchain_buffer:
 	if (!event->parent) {
 		if (event->attr.sample_type & PERF_SAMPLE_CALLCHAIN)
@@ -12143,6 +12190,18 @@ static int perf_copy_attr(struct perf_event_attr __user *uattr,
 	if (attr->sigtrap && !attr->remove_on_exec)
 		return -EINVAL;
 
+	/*
+	 * The ids refer to callchains sent on the same event. Inherited
+	 * events would need to share the cache across CPUs. A backward
+	 * buffer overwrites the oldest records, which may be the ones that
+	 * defined the ids still in use.
+	 */
+	if (attr->callchain_dedup &&
+	    (!(attr->sample_type & PERF_SAMPLE_CALLCHAIN) ||
+	     attr->exclude_callchain_user || attr->inherit ||
+	     attr->write_backward))
+		return -EINVAL;
+
 out:
 	return ret;
 
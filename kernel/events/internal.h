@@ -54,6 +54,11 @@ struct perf_buffer {
 	void				**aux_pages;
 	void				*aux_priv;
 
+	/* see perf_event_contig_chunks */
+	int				data_chunk_pages;
+	int				aux_chunk_pages;
+	int				chunk_fallback;
+
 	struct perf_event_mmap_page	*user_page;
 	void				*data_pages[];
 };
@@ -243,4 +248,9 @@ static inline bool arch_perf_have_user_stack_dump(void)
 #define perf_user_stack_pointer(regs) 0
 #endif /* CONFIG_HAVE_PERF_USER_STACK_DUMP */
 
+extern int perf_callchain_cache_alloc(struct perf_event *event);
+extern void perf_callchain_cache_free(struct perf_event *event);
+extern void perf_callchain_dedup(struct perf_event *event,
+				 struct perf_callchain_entry *entry);
+
 #endif /* _KERNEL_EVENTS_INTERNAL_H */
@@ -14,6 +14,7 @@
 #include <linux/circ_buf.h>
 #include <linux/poll.h>
 #include <linux/nospec.h>
+#include <linux/sysctl.h>
 
 #include "internal.h"
 
@@ -604,6 +605,123 @@ long perf_output_copy_aux(struct perf_output_handle *aux_handle,
 }
 
 #define PERF_AUX_GFP	(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN | __GFP_NORETRY)
+#define PERF_CHUNK_GFP	(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN | \
+			 __GFP_RETRY_MAYFAIL)
+
+#define PERF_PMD_ORDER	(PMD_SHIFT - PAGE_SHIFT)
+#define PERF_PUD_ORDER	(PUD_SHIFT - PAGE_SHIFT)
+
+enum {
+	PERF_CHUNKS_OFF,
+	PERF_CHUNKS_PMD,
+	PERF_CHUNKS_PUD,
+};
+
+/*
+ * Back data and AUX buffers with physically contiguous PMD (1) or PUD (2)
+ * sized chunks from the node of the event's CPU. Whatever can't be had that
+ * way falls back to the regular allocations, which is reported in the
+ * event's fdinfo.
+ *
+ * These are not huge page mappings: the chunks are split, and user space
+ * still maps the buffer page by page through perf_mmap_fault(). What they
+ * buy is node locality and fewer, larger chunks for AUX hardware that
+ * writes by physical address.
+ */
+static int sysctl_perf_event_contig_chunks __read_mostly;
+static int perf_contig_chunks_max = PERF_CHUNKS_PUD;
+
+static struct ctl_table perf_rb_sysctls[] = {
+	{
+		.procname	= "perf_event_contig_chunks",
+		.data		= &sysctl_perf_event_contig_chunks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &perf_contig_chunks_max,
+	},
+	{ }
+};
+
+static int __init perf_rb_sysctl_init(void)
+{
+	register_sysctl_init("kernel", perf_rb_sysctls);
+	return 0;
+}
+late_initcall(perf_rb_sysctl_init);
+
+/* The largest chunk order that is enabled and fits into @nr_pages. */
+static int rb_chunk_order(int nr_pages)
+{
+	int mode = READ_ONCE(sysctl_perf_event_contig_chunks);
+	int order = ilog2(nr_pages);
+
+	if (mode >= PERF_CHUNKS_PUD && order >= PERF_PUD_ORDER)
+		return PERF_PUD_ORDER;
+	if (mode >= PERF_CHUNKS_PMD && order >= PERF_PMD_ORDER)
+		return PERF_PMD_ORDER;
+	return 0;
+}
+
+static struct page *__rb_alloc_chunk(int node, int order)
+{
+	struct page *page;
+
+	if (order <= MAX_ORDER) {
+		gfp_t gfp = PERF_CHUNK_GFP;
+
+		if (node != NUMA_NO_NODE)
+			gfp |= __GFP_THISNODE;
+
+		page = alloc_pages_node(node, gfp, order);
+		if (page)
+			split_page(page, order);
+		return page;
+	}
+
+#ifdef CONFIG_CONTIG_ALLOC
+	{
+		nodemask_t nodes;
+		unsigned long i;
+
+		if (node == NUMA_NO_NODE)
+			node = numa_mem_id();
+		nodes = nodemask_of_node(node);
+
+		page = alloc_contig_pages(1UL << order, GFP_KERNEL | __GFP_NOWARN,
+					  node, &nodes);
+		if (!page)
+			return NULL;
+
+		for (i = 0; i < 1UL << order; i++) {
+			clear_highpage(page + i);
+			cond_resched();
+		}
+		return page;
+	}
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Allocate 1 << *@order pages on @node, falling back to a PMD sized chunk
+ * if a PUD sized one is not available. The pages are returned zeroed and
+ * split, *@order is what was actually allocated.
+ */
+static struct page *rb_alloc_chunk(int node, int *order)
+{
+	struct page *page;
+
+	page = __rb_alloc_chunk(node, *order);
+	if (!page && *order > PERF_PMD_ORDER) {
+		*order = PERF_PMD_ORDER;
+		page = __rb_alloc_chunk(node, *order);
+	}
+
+	return page;
+}
 
 static struct page *rb_alloc_aux_page(int node, int order)
 {
@@ -664,6 +782,7 @@ static void __rb_free_aux(struct perf_buffer *rb)
 
 		kfree(rb->aux_pages);
 		rb->aux_nr_pages = 0;
+		rb->aux_chunk_pages = 0;
 	}
 }
 
@@ -673,6 +792,7 @@ int rb_alloc_aux(struct perf_buffer *rb, struct perf_event *event,
 	bool overwrite = !(flags & RING_BUFFER_WRITABLE);
 	int node = (event->cpu == -1) ? -1 : cpu_to_node(event->cpu);
 	int ret = -ENOMEM, max_order;
+	bool no_sg;
 
 	if (!has_aux(event))
 		return -EOPNOTSUPP;
@@ -699,6 +819,15 @@ int rb_alloc_aux(struct perf_buffer *rb, struct perf_event *event,
 		watermark = 0;
 	}
 
+	/*
+	 * In overwrite mode, PMUs that don't support SG may not handle more
+	 * than one contiguous allocation, since they rely on PMI to do double
+	 * buffering. In this case, the entire buffer has to be one contiguous
+	 * chunk.
+	 */
+	no_sg = (event->pmu->capabilities & PERF_PMU_CAP_AUX_NO_SG) &&
+		overwrite;
+
 	rb->aux_pages = kcalloc_node(nr_pages, sizeof(void *), GFP_KERNEL,
 				     node);
 	if (!rb->aux_pages)
@@ -706,27 +835,52 @@ int rb_alloc_aux(struct perf_buffer *rb, struct perf_event *event,
 
 	rb->free_aux = event->pmu->free_aux;
 	for (rb->aux_nr_pages = 0; rb->aux_nr_pages < nr_pages;) {
-		struct page *page;
-		int last, order;
+		struct page *page = NULL;
+		int last, order, chunk, nr;
 
 		order = min(max_order, ilog2(nr_pages - rb->aux_nr_pages));
-		page = rb_alloc_aux_page(node, order);
-		if (!page)
-			goto out;
+		chunk = rb_chunk_order(1 << order);
+		/*
+		 * A chunk smaller than the buffer would only make the
+		 * single-chunk requirement below fail.
+		 */
+		if (no_sg && chunk != order)
+			chunk = 0;
+		if (chunk) {
+			int want = chunk;
+
+			page = rb_alloc_chunk(node, &chunk);
+			if (chunk != want || !page)
+				rb->chunk_fallback = 1;
+		}
 
-		for (last = rb->aux_nr_pages + (1 << page_private(page));
+		if (page) {
+			int sub = no_sg ? chunk : min(chunk, MAX_ORDER);
+
+			/*
+			 * SG capable drivers only know chunks up to MAX_ORDER,
+			 * describe a larger one as a run of those. A no-SG
+			 * driver gets the whole chunk as a single one.
+			 */
+			nr = 1 << chunk;
+			for (last = 0; last < nr; last += 1 << sub) {
+				SetPagePrivate(page + last);
+				set_page_private(page + last, sub);
+			}
+			rb->aux_chunk_pages += nr;
+		} else {
+			page = rb_alloc_aux_page(node, order);
+			if (!page)
+				goto out;
+			nr = 1 << page_private(page);
+		}
+
+		for (last = rb->aux_nr_pages + nr;
 		     last > rb->aux_nr_pages; rb->aux_nr_pages++)
 			rb->aux_pages[rb->aux_nr_pages] = page_address(page++);
 	}
 
-	/*
-	 * In overwrite mode, PMUs that don't support SG may not handle more
-	 * than one contiguous allocation, since they rely on PMI to do double
-	 * buffering. In this case, the entire buffer has to be one contiguous
-	 * chunk.
-	 */
-	if ((event->pmu->capabilities & PERF_PMU_CAP_AUX_NO_SG) &&
-	    overwrite) {
+	if (no_sg) {
 		struct page *page = virt_to_page(rb->aux_pages[0]);
 
 		if (page_private(page) != max_order)
@@ -826,10 +980,28 @@ struct perf_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	if (!rb->user_page)
 		goto fail_user_page;
 
-	for (i = 0; i < nr_pages; i++) {
+	for (i = 0; i < nr_pages;) {
+		struct page *page = NULL;
+		int j, chunk, want;
+
+		chunk = want = rb_chunk_order(nr_pages - i);
+		if (chunk) {
+			page = rb_alloc_chunk(node, &chunk);
+			if (chunk != want || !page)
+				rb->chunk_fallback = 1;
+		}
+
+		if (page) {
+			for (j = 0; j < 1 << chunk; j++)
+				rb->data_pages[i++] = page_address(page + j);
+			rb->data_chunk_pages += 1 << chunk;
+			continue;
+		}
+
 		rb->data_pages[i] = perf_mmap_alloc_page(cpu);
 		if (!rb->data_pages[i])
 			goto fail_data_pages;
+		i++;
 	}
 
 	rb->nr_pages = nr_pages;
@@ -26,6 +26,7 @@
 #include <linux/task_work.h>
 #include <linux/shmem_fs.h>
 #include <linux/khugepaged.h>
+#include <linux/sort.h>
 
 #include <linux/uprobes.h>
 
@@ -83,6 +84,9 @@ struct delayed_uprobe {
 };
 
 static DEFINE_MUTEX(delayed_uprobe_lock);
+
+/* Serializes uprobe_register_batch() and uprobe_unregister_batch(). */
+static DEFINE_MUTEX(uprobes_batch_mutex);
 static LIST_HEAD(delayed_uprobe_list);
 
 /*
@@ -957,10 +961,14 @@ static inline struct map_info *free_map_info(struct map_info *info)
 	return next;
 }
 
+/*
+ * Collect the mms which map any part of [@first, @last] of @mapping. vaddr
+ * is the address of @first, or of the start of the vma if @first is below.
+ */
 static struct map_info *
-build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
+build_map_info(struct address_space *mapping, loff_t first, loff_t last,
+	       bool is_register)
 {
-	unsigned long pgoff = offset >> PAGE_SHIFT;
 	struct vm_area_struct *vma;
 	struct map_info *curr = NULL;
 	struct map_info *prev = NULL;
@@ -969,7 +977,8 @@ build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
 
  again:
 	i_mmap_lock_read(mapping);
-	vma_interval_tree_foreach(vma, &mapping->i_mmap, pgoff, pgoff) {
+	vma_interval_tree_foreach(vma, &mapping->i_mmap,
+				  first >> PAGE_SHIFT, last >> PAGE_SHIFT) {
 		if (!valid_vma(vma, is_register))
 			continue;
 
@@ -997,7 +1006,8 @@ build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
 		curr = info;
 
 		info->mm = vma->vm_mm;
-		info->vaddr = offset_to_vaddr(vma, offset);
+		info->vaddr = offset_to_vaddr(vma,
+				max(first, vaddr_to_offset(vma, vma->vm_start)));
 	}
 	i_mmap_unlock_read(mapping);
 
@@ -1035,8 +1045,8 @@ register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new)
 	int err = 0;
 
 	percpu_down_write(&dup_mmap_sem);
-	info = build_map_info(uprobe->inode->i_mapping,
-					uprobe->offset, is_register);
+	info = build_map_info(uprobe->inode->i_mapping, uprobe->offset,
+			      uprobe->offset, is_register);
 	if (IS_ERR(info)) {
 		err = PTR_ERR(info);
 		goto out;
@@ -1134,12 +1144,9 @@ EXPORT_SYMBOL_GPL(uprobe_unregister);
  * Return errno if it cannot successully install probes
  * else return 0 (success)
  */
-static int __uprobe_register(struct inode *inode, loff_t offset,
+static int uprobe_check_args(struct inode *inode, loff_t offset,
 			     loff_t ref_ctr_offset, struct uprobe_consumer *uc)
 {
-	struct uprobe *uprobe;
-	int ret;
-
 	/* Uprobe must have at least one set consumer */
 	if (!uc->handler && !uc->ret_handler)
 		return -EINVAL;
@@ -1161,6 +1168,19 @@ static int __uprobe_register(struct inode *inode, loff_t offset,
 	if (!IS_ALIGNED(ref_ctr_offset, sizeof(short)))
 		return -EINVAL;
 
+	return 0;
+}
+
+static int __uprobe_register(struct inode *inode, loff_t offset,
+			     loff_t ref_ctr_offset, struct uprobe_consumer *uc)
+{
+	struct uprobe *uprobe;
+	int ret;
+
+	ret = uprobe_check_args(inode, offset, ref_ctr_offset, uc);
+	if (ret)
+		return ret;
+
  retry:
 	uprobe = alloc_uprobe(inode, offset, ref_ctr_offset);
 	if (!uprobe)
@@ -1202,6 +1222,240 @@ int uprobe_register_refctr(struct inode *inode, loff_t offset,
 }
 EXPORT_SYMBOL_GPL(uprobe_register_refctr);
 
+/*
+ * Install or remove the breakpoints of all @probes, which must be sorted by
+ * offset, in every mm mapping @inode. Unlike calling register_for_each_vma()
+ * for each probe, the file's vmas are looked up once for the whole offset
+ * range and each vma is locked once for all the probes it maps.
+ */
+static int register_batch_for_each_vma(struct inode *inode,
+				       struct uprobe_batch *probes, int cnt,
+				       bool is_register)
+{
+	struct map_info *info;
+	int i, err = 0;
+
+	percpu_down_write(&dup_mmap_sem);
+	info = build_map_info(inode->i_mapping, probes[0].offset,
+			      probes[cnt - 1].offset, is_register);
+	if (IS_ERR(info)) {
+		err = PTR_ERR(info);
+		goto out;
+	}
+
+	while (info) {
+		struct mm_struct *mm = info->mm;
+		struct vm_area_struct *vma;
+		loff_t start, end;
+
+		if (err && is_register)
+			goto free;
+
+		mmap_write_lock(mm);
+		vma = find_vma(mm, info->vaddr);
+		if (!vma || !valid_vma(vma, is_register) ||
+		    file_inode(vma->vm_file) != inode ||
+		    vma->vm_start > info->vaddr)
+			goto unlock;
+
+		if (!is_register && !test_bit(MMF_HAS_UPROBES, &mm->flags))
+			goto unlock;
+
+		start = vaddr_to_offset(vma, vma->vm_start);
+		end = vaddr_to_offset(vma, vma->vm_end);
+		for (i = 0; i < cnt && probes[i].offset < end; i++) {
+			struct uprobe *uprobe = probes[i].uprobe;
+			unsigned long vaddr;
+
+			if (probes[i].offset < start)
+				continue;
+
+			vaddr = offset_to_vaddr(vma, probes[i].offset);
+			if (is_register) {
+				if (consumer_filter(probes[i].uc,
+						UPROBE_FILTER_REGISTER, mm))
+					err = install_breakpoint(uprobe, mm,
+								 vma, vaddr);
+				if (err)
+					break;
+			} else if (!filter_chain(uprobe,
+					UPROBE_FILTER_UNREGISTER, mm)) {
+				err |= remove_breakpoint(uprobe, mm, vaddr);
+			}
+		}
+
+ unlock:
+		mmap_write_unlock(mm);
+ free:
+		mmput(mm);
+		info = free_map_info(info);
+	}
+ out:
+	percpu_up_write(&dup_mmap_sem);
+	return err;
+}
+
+static int uprobe_batch_cmp(const void *a, const void *b)
+{
+	const struct uprobe_batch *pa = a, *pb = b;
+
+	if (pa->offset < pb->offset)
+		return -1;
+	return pa->offset > pb->offset;
+}
+
+/*
+ * Probes at the same offset share their uprobe and are adjacent once
+ * sorted, only the first of them takes the uprobe's register_rwsem.
+ */
+static inline bool uprobe_batch_first(struct uprobe_batch *probes, int i)
+{
+	return !i || probes[i - 1].uprobe != probes[i].uprobe;
+}
+
+static void uprobe_batch_lock(struct uprobe_batch *probes, int cnt)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		if (uprobe_batch_first(probes, i))
+			down_write_nest_lock(&probes[i].uprobe->register_rwsem,
+					     &uprobes_batch_mutex);
+	}
+}
+
+static void uprobe_batch_unlock(struct uprobe_batch *probes, int cnt)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		if (uprobe_batch_first(probes, i))
+			up_write(&probes[i].uprobe->register_rwsem);
+	}
+}
+
+static void
+__uprobe_unregister_batch(struct inode *inode, struct uprobe_batch *probes,
+			  int cnt)
+{
+	struct uprobe *uprobe;
+	int i, err;
+
+	for (i = 0; i < cnt; i++)
+		WARN_ON(!consumer_del(probes[i].uprobe, probes[i].uc));
+
+	err = register_batch_for_each_vma(inode, probes, cnt, false);
+	/* Like __uprobe_unregister(), keep the uprobes if any bp remains */
+	if (err)
+		return;
+
+	for (i = 0; i < cnt; i++) {
+		uprobe = probes[i].uprobe;
+		if (!uprobe->consumers && uprobe_is_active(uprobe))
+			delete_uprobe(uprobe);
+	}
+}
+
+/*
+ * uprobe_register_batch - register many probes in one file at once.
+ * @inode: the file in which the probes have to be placed.
+ * @probes: offset, ref_ctr_offset and consumer of each probe.
+ * @cnt: number of entries in @probes.
+ *
+ * Equivalent to calling uprobe_register_refctr() for each entry of @probes,
+ * but the mms mapping @inode are only walked once for all of them. Either
+ * all probes are registered or, on error, none is. @probes is sorted by
+ * offset; it has to be passed unchanged to uprobe_unregister_batch().
+ */
+int uprobe_register_batch(struct inode *inode, struct uprobe_batch *probes,
+			  int cnt)
+{
+	struct uprobe *uprobe;
+	int i, ret;
+
+	if (cnt <= 0)
+		return -EINVAL;
+
+	for (i = 0; i < cnt; i++) {
+		ret = uprobe_check_args(inode, probes[i].offset,
+					probes[i].ref_ctr_offset, probes[i].uc);
+		if (ret)
+			return ret;
+	}
+
+	sort(probes, cnt, sizeof(*probes), uprobe_batch_cmp, NULL);
+
+	mutex_lock(&uprobes_batch_mutex);
+ retry:
+	for (i = 0; i < cnt; i++) {
+		uprobe = alloc_uprobe(inode, probes[i].offset,
+				      probes[i].ref_ctr_offset);
+		if (IS_ERR_OR_NULL(uprobe)) {
+			ret = uprobe ? PTR_ERR(uprobe) : -ENOMEM;
+			goto put;
+		}
+		probes[i].uprobe = uprobe;
+	}
+
+	uprobe_batch_lock(probes, cnt);
+
+	/* See __uprobe_register() for the race with delete_uprobe(). */
+	ret = -EAGAIN;
+	for (i = 0; i < cnt; i++) {
+		if (unlikely(!uprobe_is_active(probes[i].uprobe)))
+			goto unlock;
+	}
+
+	for (i = 0; i < cnt; i++)
+		consumer_add(probes[i].uprobe, probes[i].uc);
+
+	ret = register_batch_for_each_vma(inode, probes, cnt, true);
+	if (ret)
+		__uprobe_unregister_batch(inode, probes, cnt);
+
+ unlock:
+	uprobe_batch_unlock(probes, cnt);
+	i = cnt;
+ put:
+	while (i--)
+		put_uprobe(probes[i].uprobe);
+
+	if (unlikely(ret == -EAGAIN))
+		goto retry;
+	mutex_unlock(&uprobes_batch_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(uprobe_register_batch);
+
+/*
+ * uprobe_unregister_batch - unregister probes added by uprobe_register_batch().
+ * @inode: the file in which the probes have to be removed.
+ * @probes: the array passed to uprobe_register_batch().
+ * @cnt: number of entries in @probes.
+ */
+void uprobe_unregister_batch(struct inode *inode, struct uprobe_batch *probes,
+			     int cnt)
+{
+	int i;
+
+	mutex_lock(&uprobes_batch_mutex);
+	for (i = 0; i < cnt; i++) {
+		probes[i].uprobe = find_uprobe(inode, probes[i].offset);
+		if (WARN_ON(!probes[i].uprobe))
+			goto put;
+	}
+
+	uprobe_batch_lock(probes, cnt);
+	__uprobe_unregister_batch(inode, probes, cnt);
+	uprobe_batch_unlock(probes, cnt);
+	i = cnt;
+ put:
+	while (i--)
+		put_uprobe(probes[i].uprobe);
+	mutex_unlock(&uprobes_batch_mutex);
+}
+EXPORT_SYMBOL_GPL(uprobe_unregister_batch);
+
 /*
  * uprobe_apply - unregister an already registered probe.
  * @inode: the file in which the probe has to be removed.
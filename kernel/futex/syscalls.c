@@ -305,6 +305,43 @@ SYSCALL_DEFINE5(futex_waitv, struct futex_waitv __user *, waiters,
 	return ret;
 }
 
+/**
+ * sys_futex_wakev - Wake waiters on a list of futexes
+ * @waiters:    List of futexes to wake
+ * @nr_futexes: Length of the list
+ * @flags:      Unused, must be 0
+ *
+ * The vectored counterpart of FUTEX_WAKE: for each `struct futex_waitv` in
+ * the list, wake up to @val waiters of @uaddr. Futexes which share a hash
+ * bucket are handled under one acquisition of the bucket lock. Each entry
+ * has individual flags, as with futex_waitv().
+ *
+ * Returns the total number of woken waiters.
+ */
+SYSCALL_DEFINE3(futex_wakev, struct futex_waitv __user *, waiters,
+		unsigned int, nr_futexes, unsigned int, flags)
+{
+	struct futex_vector *futexv;
+	int ret;
+
+	if (flags)
+		return -EINVAL;
+
+	if (!nr_futexes || nr_futexes > FUTEX_WAITV_MAX || !waiters)
+		return -EINVAL;
+
+	futexv = kcalloc(nr_futexes, sizeof(*futexv), GFP_KERNEL);
+	if (!futexv)
+		return -ENOMEM;
+
+	ret = futex_parse_waitv(futexv, waiters, nr_futexes);
+	if (!ret)
+		ret = futex_wake_multiple(futexv, nr_futexes);
+
+	kfree(futexv);
+	return ret;
+}
+
 #ifdef CONFIG_COMPAT
 COMPAT_SYSCALL_DEFINE2(set_robust_list,
 		struct compat_robust_list_head __user *, head,
@@ -3,6 +3,7 @@
 #include <linux/sched/task.h>
 #include <linux/sched/signal.h>
 #include <linux/freezer.h>
+#include <linux/sort.h>
 
 #include "futex.h"
 
@@ -137,13 +138,40 @@ void futex_wake_mark(struct wake_q_head *wake_q, struct futex_q *q)
 	wake_q_add_safe(wake_q, p);
 }
 
+/*
+ * Mark up to @nr_wake waiters matching @key and @bitset on the locked @hb
+ * for wakeup.
+ */
+static int __futex_wake(struct futex_hash_bucket *hb, union futex_key *key,
+			int nr_wake, u32 bitset, struct wake_q_head *wake_q)
+{
+	struct futex_q *this, *next;
+	int ret = 0;
+
+	plist_for_each_entry_safe(this, next, &hb->chain, list) {
+		if (futex_match (&this->key, key)) {
+			if (this->pi_state || this->rt_waiter)
+				return -EINVAL;
+
+			/* Check if one of the bits is set in both bitsets */
+			if (!(this->bitset & bitset))
+				continue;
+
+			futex_wake_mark(wake_q, this);
+			if (++ret >= nr_wake)
+				break;
+		}
+	}
+
+	return ret;
+}
+
 /*
  * Wake up waiters matching bitset queued on this futex (uaddr).
  */
 int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 {
 	struct futex_hash_bucket *hb;
-	struct futex_q *this, *next;
 	union futex_key key = FUTEX_KEY_INIT;
 	int ret;
 	DEFINE_WAKE_Q(wake_q);
@@ -163,26 +191,102 @@ int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 
 	spin_lock(&hb->lock);
 
-	plist_for_each_entry_safe(this, next, &hb->chain, list) {
-		if (futex_match (&this->key, &key)) {
-			if (this->pi_state || this->rt_waiter) {
-				ret = -EINVAL;
-				break;
-			}
+	ret = __futex_wake(hb, &key, nr_wake, bitset, &wake_q);
 
-			/* Check if one of the bits is set in both bitsets */
-			if (!(this->bitset & bitset))
+	spin_unlock(&hb->lock);
+	wake_up_q(&wake_q);
+	return ret;
+}
+
+static int futex_vector_cmp(const void *a, const void *b)
+{
+	const struct futex_vector *va = a, *vb = b;
+
+	if (va->q.lock_ptr == vb->q.lock_ptr)
+		return 0;
+	return va->q.lock_ptr < vb->q.lock_ptr ? -1 : 1;
+}
+
+/*
+ * Look up the hash bucket of each entry, remembered in q.lock_ptr, and sort
+ * the entries by it.
+ */
+static void futex_wake_multiple_sort(struct futex_vector *vs,
+				     unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		vs[i].q.lock_ptr = &futex_hash(&vs[i].q.key)->lock;
+
+	sort(vs, count, sizeof(*vs), futex_vector_cmp, NULL);
+}
+
+/**
+ * futex_wake_multiple - Wake waiters on a list of futexes
+ * @vs:		The futex list to wake, w.val is the number of waiters to wake
+ * @count:	The size of the list
+ *
+ * The entries are grouped by hash bucket so that each bucket lock is taken
+ * only once, no matter how many of the futexes hash to it. All waiters are
+ * woken in one go once the last bucket is unlocked.
+ *
+ * Return:
+ *  - >=0 - The total number of woken waiters
+ *  -  <0 - -EFAULT, or -EINVAL if one of the futexes has PI waiters
+ */
+int futex_wake_multiple(struct futex_vector *vs, unsigned int count)
+{
+	struct futex_hash_bucket *hb;
+	unsigned int i, j;
+	int ret, woken = 0;
+	DEFINE_WAKE_Q(wake_q);
+
+	for (i = 0; i < count; i++) {
+		ret = get_futex_key(u64_to_user_ptr(vs[i].w.uaddr),
+				    !(vs[i].w.flags & FUTEX_PRIVATE_FLAG),
+				    &vs[i].q.key, FUTEX_READ);
+		if (unlikely(ret))
+			return ret;
+	}
+
+	futex_wake_multiple_sort(vs, count);
+
+	i = 0;
+	while (i < count) {
+		hb = container_of(vs[i].q.lock_ptr, struct futex_hash_bucket,
+				  lock);
+		for (j = i + 1; j < count && vs[j].q.lock_ptr == &hb->lock; j++)
+			;
+
+		/* Make sure we really have tasks to wakeup */
+		if (!futex_hb_waiters_pending(hb)) {
+			i = j;
+			continue;
+		}
+
+		spin_lock(&hb->lock);
+		for (; i < j; i++) {
+			if (!vs[i].w.val)
 				continue;
 
-			futex_wake_mark(&wake_q, this);
-			if (++ret >= nr_wake)
+			ret = __futex_wake(hb, &vs[i].q.key,
+					   min_t(u64, vs[i].w.val, INT_MAX),
+					   FUTEX_BITSET_MATCH_ANY, &wake_q);
+			if (ret < 0)
 				break;
+			woken += ret;
+		}
+		spin_unlock(&hb->lock);
+
+		if (ret < 0) {
+			woken = ret;
+			break;
 		}
 	}
 
-	spin_unlock(&hb->lock);
 	wake_up_q(&wake_q);
-	return ret;
+	return woken;
 }
 
 static int futex_atomic_op_inuser(unsigned int encoded_op, u32 __user *uaddr)
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * In-kernel interrupt affinity balancer.
+ *
+ * Every autobalance.interval_ms the irq and softirq time of each CPU is
+ * sampled together with the per CPU counts of the interrupts which user
+ * space could move as well, see irq_can_set_affinity_usr(). When the busiest
+ * CPU spent more than autobalance.imbalance_pct of the interval more in
+ * interrupt context than the least busy one, the interrupt whose estimated
+ * share of the load fits best into half of the difference is moved over.
+ *
+ * An interrupt is not moved again before autobalance.cooldown_ms has
+ * passed. Together with the threshold this keeps the balancer from
+ * bouncing interrupts between CPUs when the load is bursty.
+ *
+ * Each move is reported on the "moves" multicast group of the
+ * "irq_balance" generic netlink family.
+ */
+#define pr_fmt(fmt) "irq_autobalance: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <net/genetlink.h>
+#include <uapi/linux/irq_balance.h>
+
+#include "internals.h"
+
+static unsigned int interval_ms;
+static unsigned int imbalance_pct = 25;
+static unsigned int cooldown_ms = 2000;
+static bool irq_balance_ready;
+static bool irq_balance_genl;
+
+struct irq_balance_cpu {
+	u64		irqtime;	/* irq + softirq time at the last scan */
+	u64		load;		/* ... of the last interval */
+	unsigned int	events;		/* movable interrupts in the last interval */
+};
+
+static DEFINE_PER_CPU(struct irq_balance_cpu, irq_balance_cpu);
+static cpumask_var_t irq_balance_cpus;
+static u64 irq_balance_last;
+
+static void irq_balance_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_fn);
+
+static const struct genl_multicast_group irq_balance_mcgrps[] = {
+	{ .name = IRQ_BALANCE_MCGRP_MOVES, },
+};
+
+static struct genl_family irq_balance_family __ro_after_init = {
+	.name		= IRQ_BALANCE_GENL_NAME,
+	.version	= IRQ_BALANCE_GENL_VERSION,
+	.maxattr	= IRQ_BALANCE_A_MAX,
+	.module		= THIS_MODULE,
+	.mcgrps		= irq_balance_mcgrps,
+	.n_mcgrps	= ARRAY_SIZE(irq_balance_mcgrps),
+};
+
+struct irq_balance_move {
+	unsigned int	irq;
+	unsigned int	from;
+	unsigned int	to;
+	u32		rate;
+	u32		from_load;
+	u32		to_load;
+};
+
+static void irq_balance_notify(struct irq_balance_move *mv)
+{
+	struct sk_buff *skb;
+	void *hdr;
+
+	if (!irq_balance_genl ||
+	    !genl_has_listeners(&irq_balance_family, &init_net, 0))
+		return;
+
+	skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+	if (!skb)
+		return;
+
+	hdr = genlmsg_put(skb, 0, 0, &irq_balance_family, 0,
+			  IRQ_BALANCE_CMD_MOVE);
+	if (!hdr)
+		goto out_free;
+
+	if (nla_put_u32(skb, IRQ_BALANCE_A_IRQ, mv->irq) ||
+	    nla_put_u32(skb, IRQ_BALANCE_A_FROM_CPU, mv->from) ||
+	    nla_put_u32(skb, IRQ_BALANCE_A_TO_CPU, mv->to) ||
+	    nla_put_u32(skb, IRQ_BALANCE_A_RATE, mv->rate) ||
+	    nla_put_u32(skb, IRQ_BALANCE_A_FROM_LOAD, mv->from_load) ||
+	    nla_put_u32(skb, IRQ_BALANCE_A_TO_LOAD, mv->to_load))
+		goto out_free;
+
+	genlmsg_end(skb, hdr);
+	genlmsg_multicast(&irq_balance_family, skb, 0, 0, GFP_KERNEL);
+	return;
+
+out_free:
+	nlmsg_free(skb);
+}
+
+static u64 irq_balance_cpu_time(int cpu)
+{
+	u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+	return cpustat[CPUTIME_IRQ] + cpustat[CPUTIME_SOFTIRQ];
+}
+
+/*
+ * The single CPU a movable interrupt is currently routed to, or -1 for
+ * interrupts the balancer leaves alone.
+ */
+static int irq_balance_desc_cpu(struct irq_desc *desc)
+{
+	const struct cpumask *m;
+	unsigned int irq = irq_desc_get_irq(desc);
+
+	if (!desc->action || desc->affinity_hint ||
+	    !irq_can_set_affinity_usr(irq))
+		return -1;
+
+	m = irq_data_get_effective_affinity_mask(&desc->irq_data);
+	if (cpumask_weight(m) != 1)
+		return -1;
+
+	return cpumask_first(m);
+}
+
+/* Sample the per CPU load and the interrupt counts of the last interval. */
+static void irq_balance_sample(void)
+{
+	struct irq_balance_cpu *bc;
+	struct irq_desc *desc;
+	unsigned int irq, count;
+	int cpu;
+	u64 t;
+
+	for_each_online_cpu(cpu) {
+		bc = per_cpu_ptr(&irq_balance_cpu, cpu);
+		t = irq_balance_cpu_time(cpu);
+		bc->load = t - bc->irqtime;
+		bc->irqtime = t;
+		bc->events = 0;
+	}
+
+	for_each_irq_desc(irq, desc) {
+		cpu = irq_balance_desc_cpu(desc);
+		if (cpu < 0 || !cpu_online(cpu)) {
+			desc->balance_cpu = -1;
+			continue;
+		}
+
+		count = kstat_irqs_cpu(irq, cpu);
+		if (desc->balance_cpu != cpu) {
+			desc->balance_cpu = cpu;
+			desc->balance_delta = 0;
+		} else {
+			desc->balance_delta = count - desc->balance_count;
+		}
+		desc->balance_count = count;
+
+		per_cpu_ptr(&irq_balance_cpu, cpu)->events += desc->balance_delta;
+	}
+}
+
+static int irq_balance_find_target(int busiest, u64 threshold)
+{
+	u64 load, min_load = U64_MAX, min_node_load = U64_MAX;
+	int cpu, target = -1, node_target = -1;
+	int node = cpu_to_node(busiest);
+
+	for_each_cpu(cpu, irq_balance_cpus) {
+		load = per_cpu_ptr(&irq_balance_cpu, cpu)->load;
+		if (load < min_load) {
+			min_load = load;
+			target = cpu;
+		}
+		if (cpu_to_node(cpu) == node && load < min_node_load) {
+			min_node_load = load;
+			node_target = cpu;
+		}
+	}
+
+	/* Stay on the node if that is good enough. */
+	load = per_cpu_ptr(&irq_balance_cpu, busiest)->load;
+	if (node_target >= 0 && node_target != busiest &&
+	    load - min_node_load > threshold)
+		return node_target;
+
+	if (target < 0 || target == busiest || load - min_load <= threshold)
+		return -1;
+
+	return target;
+}
+
+/*
+ * Pick the interrupt on @busiest whose estimated load gets the two CPUs
+ * closest to each other. Moving an interrupt which carries more than half
+ * of the difference would just move the imbalance.
+ */
+static struct irq_desc *irq_balance_pick(int busiest, u64 diff, u64 *est)
+{
+	struct irq_balance_cpu *bc = per_cpu_ptr(&irq_balance_cpu, busiest);
+	unsigned long cooldown = msecs_to_jiffies(READ_ONCE(cooldown_ms));
+	struct irq_desc *desc, *best = NULL;
+	unsigned int irq;
+	u64 load;
+
+	if (!bc->events)
+		return NULL;
+
+	*est = 0;
+	for_each_irq_desc(irq, desc) {
+		if (desc->balance_cpu != busiest || !desc->balance_delta)
+			continue;
+
+		if (desc->balance_moved &&
+		    time_before(jiffies, desc->balance_moved + cooldown))
+			continue;
+
+		load = div_u64(bc->load * desc->balance_delta, bc->events);
+		if (load > diff / 2 || load <= *est)
+			continue;
+
+		*est = load;
+		best = desc;
+	}
+
+	return best;
+}
+
+static void irq_balance_fn(struct work_struct *work)
+{
+	u64 now = ktime_get_ns(), period = now - irq_balance_last;
+	struct irq_balance_move mv;
+	u64 load, max_load = 0, threshold, est;
+	int cpu, busiest = -1, target;
+	struct irq_desc *desc;
+	unsigned int interval;
+	bool moved = false;
+
+	irq_balance_last = now;
+
+	cpus_read_lock();
+	irq_lock_sparse();
+
+	irq_balance_sample();
+
+	cpumask_and(irq_balance_cpus, cpu_online_mask, irq_default_affinity);
+	for_each_cpu(cpu, irq_balance_cpus) {
+		load = per_cpu_ptr(&irq_balance_cpu, cpu)->load;
+		if (load > max_load) {
+			max_load = load;
+			busiest = cpu;
+		}
+	}
+
+	threshold = div_u64(period * READ_ONCE(imbalance_pct), 100);
+	if (busiest < 0 || !period)
+		goto unlock;
+
+	target = irq_balance_find_target(busiest, threshold);
+	if (target < 0)
+		goto unlock;
+
+	mv.from_load = div64_u64(max_load * 1000, period);
+	load = per_cpu_ptr(&irq_balance_cpu, target)->load;
+	mv.to_load = div64_u64(load * 1000, period);
+
+	desc = irq_balance_pick(busiest, max_load - load, &est);
+	if (!desc)
+		goto unlock;
+
+	mv.irq = irq_desc_get_irq(desc);
+	mv.from = busiest;
+	mv.to = target;
+	mv.rate = div64_u64((u64)desc->balance_delta * NSEC_PER_SEC, period);
+
+	if (!irq_set_affinity(mv.irq, cpumask_of(target))) {
+		desc->balance_moved = jiffies ? : 1;
+		moved = true;
+	}
+
+unlock:
+	irq_unlock_sparse();
+	cpus_read_unlock();
+
+	if (moved)
+		irq_balance_notify(&mv);
+
+	interval = READ_ONCE(interval_ms);
+	if (interval)
+		queue_delayed_work(system_unbound_wq, &irq_balance_work,
+				   msecs_to_jiffies(interval));
+}
+
+static int irq_balance_set_interval(const char *val,
+				    const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (ret || !irq_balance_ready)
+		return ret;
+
+	if (interval_ms)
+		mod_delayed_work(system_unbound_wq, &irq_balance_work, 0);
+	else
+		cancel_delayed_work_sync(&irq_balance_work);
+
+	return 0;
+}
+
+static const struct kernel_param_ops irq_balance_interval_ops = {
+	.set	= irq_balance_set_interval,
+	.get	= param_get_uint,
+};
+
+module_param_cb(interval_ms, &irq_balance_interval_ops, &interval_ms, 0644);
+MODULE_PARM_DESC(interval_ms, "Balancing interval in ms, 0 disables the balancer");
+module_param(imbalance_pct, uint, 0644);
+MODULE_PARM_DESC(imbalance_pct, "Minimum irq load difference, in percent of the interval");
+module_param(cooldown_ms, uint, 0644);
+MODULE_PARM_DESC(cooldown_ms, "Minimum time between two moves of an interrupt");
+
+static int __init irq_balance_init(void)
+{
+	int ret;
+
+	if (!zalloc_cpumask_var(&irq_balance_cpus, GFP_KERNEL))
+		return -ENOMEM;
+
+	ret = genl_register_family(&irq_balance_family);
+	if (ret)
+		pr_warn("netlink notifications unavailable: %d\n", ret);
+	else
+		irq_balance_genl = true;
+
+	irq_balance_last = ktime_get_ns();
+	irq_balance_ready = true;
+
+	if (interval_ms)
+		queue_delayed_work(system_unbound_wq, &irq_balance_work,
+				   msecs_to_jiffies(interval_ms));
+	return 0;
+}
+late_initcall(irq_balance_init);
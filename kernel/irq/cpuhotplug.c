@@ -9,6 +9,7 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
+#include <linux/cpuhotplug.h>
 #include <linux/interrupt.h>
 #include <linux/ratelimit.h>
 #include <linux/irq.h>
@@ -172,6 +173,84 @@ void irq_migrate_all_off_this_cpu(void)
 	}
 }
 
+#ifdef CONFIG_GENERIC_IRQ_EFFECTIVE_AFF_MASK
+/*
+ * Route an interrupt which is targeted at @cpu to another online CPU of
+ * its affinity mask. Only the effective affinity changes, the affinity
+ * mask is kept as is. Everything which needs special treatment, i.e.
+ * managed, per CPU, not started interrupts, interrupts which cannot be
+ * moved in process context or those which would break their affinity, is
+ * left to irq_migrate_all_off_this_cpu().
+ */
+static bool irq_premigrate_one(struct irq_desc *desc, unsigned int cpu)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+	struct irq_chip *chip = irq_data_get_irq_chip(d);
+	/* Serialized by the CPU hotplug lock */
+	static struct cpumask dest, affinity;
+	const struct cpumask *m;
+	int err;
+
+	if (!chip || !chip->irq_set_affinity)
+		return false;
+
+	if (irqd_is_per_cpu(d) || !irqd_is_started(d) ||
+	    irqd_affinity_is_managed(d) || !irq_can_move_pcntxt(d) ||
+	    irq_move_pending(d))
+		return false;
+
+	m = irq_data_get_effective_affinity_mask(d);
+	if (!cpumask_test_cpu(cpu, m))
+		return false;
+
+	cpumask_andnot(&dest, irq_data_get_affinity_mask(d), cpumask_of(cpu));
+	if (!cpumask_intersects(&dest, cpu_online_mask))
+		return false;
+
+	cpumask_copy(&affinity, irq_data_get_affinity_mask(d));
+	err = irq_do_set_affinity(d, &dest, false);
+	cpumask_copy(desc->irq_common_data.affinity, &affinity);
+
+	return !err;
+}
+
+/*
+ * irq_migrate_all_off_this_cpu() runs in stop_machine() context and
+ * reprograms every interrupt which targets the outgoing CPU. Do the bulk
+ * of that work here, in the hotplug thread while the CPU is still online,
+ * so that only the interrupts which need the fixup in the final stage and
+ * the ones which were set up in between are left to it.
+ */
+static int irq_affinity_offline_cpu(unsigned int cpu)
+{
+	unsigned int irq, moved = 0;
+	struct irq_desc *desc;
+
+	irq_lock_sparse();
+	for_each_active_irq(irq) {
+		desc = irq_to_desc(irq);
+		raw_spin_lock_irq(&desc->lock);
+		moved += irq_premigrate_one(desc, cpu);
+		raw_spin_unlock_irq(&desc->lock);
+	}
+	irq_unlock_sparse();
+
+	pr_debug("CPU%u: %u interrupts moved ahead of offlining\n", cpu, moved);
+	return 0;
+}
+
+static int __init irq_affinity_offline_init(void)
+{
+	int ret;
+
+	ret = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN,
+					"irq/affinity:offline", NULL,
+					irq_affinity_offline_cpu);
+	return ret < 0 ? ret : 0;
+}
+core_initcall(irq_affinity_offline_init);
+#endif
+
 static bool hk_should_isolate(struct irq_data *data, unsigned int cpu)
 {
 	const struct cpumask *hk_mask;
@@ -125,6 +125,12 @@ static void desc_set_defaults(unsigned int irq, struct irq_desc *desc, int node,
 	for_each_possible_cpu(cpu)
 		*per_cpu_ptr(desc->kstat_irqs, cpu) = 0;
 	desc_smp_init(desc, node, affinity);
+#ifdef CONFIG_IRQ_AUTOBALANCE
+	desc->balance_cpu = -1;
+	desc->balance_count = 0;
+	desc->balance_delta = 0;
+	desc->balance_moved = 0;
+#endif
 }
 
 int nr_irqs = NR_IRQS;
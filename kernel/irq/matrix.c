@@ -125,48 +125,94 @@ static unsigned int matrix_alloc_area(struct irq_matrix *m, struct cpumap *cm,
 	return area;
 }
 
-/* Find the best CPU which has the lowest vector allocation count */
-static unsigned int matrix_find_best_cpu(struct irq_matrix *m,
-					const struct cpumask *msk)
+/*
+ * Find the best CPU in @msk and @nodemsk which has the lowest vector
+ * allocation count. On a tie prefer the CPU which has less managed
+ * vectors allocated, so regular vectors do not pile up on the CPUs
+ * which serve the managed queues of other devices.
+ */
+static unsigned int __matrix_find_best_cpu(struct irq_matrix *m,
+					   const struct cpumask *msk,
+					   const struct cpumask *nodemsk)
 {
-	unsigned int cpu, best_cpu, maxavl = 0;
+	unsigned int cpu, best_cpu, maxavl = 0, managed = UINT_MAX;
 	struct cpumap *cm;
 
 	best_cpu = UINT_MAX;
 
-	for_each_cpu(cpu, msk) {
+	for_each_cpu_and(cpu, msk, nodemsk) {
 		cm = per_cpu_ptr(m->maps, cpu);
 
-		if (!cm->online || cm->available <= maxavl)
+		if (!cm->online || !cm->available || cm->available < maxavl)
+			continue;
+		if (cm->available == maxavl && cm->managed_allocated >= managed)
 			continue;
 
 		best_cpu = cpu;
 		maxavl = cm->available;
+		managed = cm->managed_allocated;
 	}
 	return best_cpu;
 }
 
-/* Find the best CPU which has the lowest number of managed IRQs allocated */
-static unsigned int matrix_find_best_cpu_managed(struct irq_matrix *m,
-						const struct cpumask *msk)
+/* Prefer the CPUs of @node, if any of them is in @msk and has room */
+static unsigned int matrix_find_best_cpu(struct irq_matrix *m,
+					 const struct cpumask *msk, int node)
 {
-	unsigned int cpu, best_cpu, allocated = UINT_MAX;
+	unsigned int cpu;
+
+	if (node != NUMA_NO_NODE) {
+		cpu = __matrix_find_best_cpu(m, msk, cpumask_of_node(node));
+		if (cpu != UINT_MAX)
+			return cpu;
+	}
+	return __matrix_find_best_cpu(m, msk, cpu_possible_mask);
+}
+
+/*
+ * Find the best CPU which has the lowest number of managed IRQs allocated.
+ * On a tie prefer the CPU which has less regular vectors allocated.
+ */
+static unsigned int __matrix_find_best_cpu_managed(struct irq_matrix *m,
+						   const struct cpumask *msk,
+						   const struct cpumask *nodemsk)
+{
+	unsigned int cpu, best_cpu, allocated = UINT_MAX, regular = UINT_MAX;
 	struct cpumap *cm;
 
 	best_cpu = UINT_MAX;
 
-	for_each_cpu(cpu, msk) {
+	for_each_cpu_and(cpu, msk, nodemsk) {
 		cm = per_cpu_ptr(m->maps, cpu);
 
 		if (!cm->online || cm->managed_allocated > allocated)
 			continue;
+		if (cm->managed_allocated == allocated &&
+		    cm->allocated - cm->managed_allocated >= regular)
+			continue;
 
 		best_cpu = cpu;
 		allocated = cm->managed_allocated;
+		regular = cm->allocated - cm->managed_allocated;
 	}
 	return best_cpu;
 }
 
+static unsigned int matrix_find_best_cpu_managed(struct irq_matrix *m,
+						 const struct cpumask *msk,
+						 int node)
+{
+	unsigned int cpu;
+
+	if (node != NUMA_NO_NODE) {
+		cpu = __matrix_find_best_cpu_managed(m, msk,
+						     cpumask_of_node(node));
+		if (cpu != UINT_MAX)
+			return cpu;
+	}
+	return __matrix_find_best_cpu_managed(m, msk, cpu_possible_mask);
+}
+
 /**
  * irq_matrix_assign_system - Assign system wide entry in the matrix
  * @m:		Matrix pointer
@@ -281,10 +327,14 @@ void irq_matrix_remove_managed(struct irq_matrix *m, const struct cpumask *msk)
  * irq_matrix_alloc_managed - Allocate a managed interrupt in a CPU map
  * @m:		Matrix pointer
  * @msk:	Which CPUs to search in
+ * @node:	Preferred NUMA node, or NUMA_NO_NODE
  * @mapped_cpu:	Pointer to store the CPU for which the irq was allocated
+ *
+ * CPUs in @msk which belong to @node are preferred. The other CPUs in @msk
+ * are only used when none of them is online.
  */
 int irq_matrix_alloc_managed(struct irq_matrix *m, const struct cpumask *msk,
-			     unsigned int *mapped_cpu)
+			     int node, unsigned int *mapped_cpu)
 {
 	unsigned int bit, cpu, end;
 	struct cpumap *cm;
@@ -292,7 +342,7 @@ int irq_matrix_alloc_managed(struct irq_matrix *m, const struct cpumask *msk,
 	if (cpumask_empty(msk))
 		return -EINVAL;
 
-	cpu = matrix_find_best_cpu_managed(m, msk);
+	cpu = matrix_find_best_cpu_managed(m, msk, node);
 	if (cpu == UINT_MAX)
 		return -ENOSPC;
 
@@ -371,11 +421,16 @@ void irq_matrix_remove_reserved(struct irq_matrix *m)
  * irq_matrix_alloc - Allocate a regular interrupt in a CPU map
  * @m:		Matrix pointer
  * @msk:	Which CPUs to search in
+ * @node:	Preferred NUMA node, usually the one of the device, or
+ *		NUMA_NO_NODE
  * @reserved:	Allocate previously reserved interrupts
  * @mapped_cpu: Pointer to store the CPU for which the irq was allocated
+ *
+ * CPUs in @msk which belong to @node are preferred. The other CPUs in @msk
+ * are only used when none of the node local ones has a vector left.
  */
 int irq_matrix_alloc(struct irq_matrix *m, const struct cpumask *msk,
-		     bool reserved, unsigned int *mapped_cpu)
+		     int node, bool reserved, unsigned int *mapped_cpu)
 {
 	unsigned int cpu, bit;
 	struct cpumap *cm;
@@ -387,7 +442,7 @@ int irq_matrix_alloc(struct irq_matrix *m, const struct cpumask *msk,
 	if (cpumask_empty(msk))
 		return -EINVAL;
 
-	cpu = matrix_find_best_cpu(m, msk);
+	cpu = matrix_find_best_cpu(m, msk, node);
 	if (cpu == UINT_MAX)
 		return -ENOSPC;
 
@@ -479,6 +534,33 @@ unsigned int irq_matrix_allocated(struct irq_matrix *m)
 }
 
 #ifdef CONFIG_GENERIC_IRQ_DEBUGFS
+/* Per node summary of the online CPU maps. 'reg' are the regular vectors */
+static void matrix_debug_show_nodes(struct seq_file *sf, struct irq_matrix *m,
+				    int ind)
+{
+	unsigned int avl, man, mac, act;
+	int node, cpu, ncpus;
+
+	seq_printf(sf, "%*s| Node | CPUs |  avl  |  man  |  mac  |  reg  |  act\n",
+		   ind, " ");
+	for_each_online_node(node) {
+		avl = man = mac = act = ncpus = 0;
+		for_each_cpu_and(cpu, cpumask_of_node(node), cpu_online_mask) {
+			struct cpumap *cm = per_cpu_ptr(m->maps, cpu);
+
+			avl += cm->available;
+			man += cm->managed;
+			mac += cm->managed_allocated;
+			act += cm->allocated;
+			ncpus++;
+		}
+		if (!ncpus)
+			continue;
+		seq_printf(sf, "%*s %5d  %5d  %6u  %6u  %6u  %6u  %6u\n", ind, " ",
+			   node, ncpus, avl, man, mac, act - mac, act);
+	}
+}
+
 /**
  * irq_matrix_debug_show - Show detailed allocation information
  * @sf:		Pointer to the seq_file to print to
@@ -508,6 +590,7 @@ void irq_matrix_debug_show(struct seq_file *sf, struct irq_matrix *m, int ind)
 			   cm->managed_allocated, cm->allocated,
 			   m->matrix_bits, cm->alloc_map);
 	}
+	matrix_debug_show_nodes(sf, m, ind);
 	cpus_read_unlock();
 }
 #endif
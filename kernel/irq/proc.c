@@ -12,6 +12,10 @@
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/xarray.h>
+#include <uapi/linux/irq_counters.h>
 
 #include "internals.h"
 
@@ -31,6 +35,9 @@
  * The read from /proc/interrupts is a different problem because there
  * is no protection. So the lookup and the access to irqdesc
  * information must be protected by sparse_irq_lock.
+ *
+ * /proc/irq/counters only reads the per CPU counts, which is safe
+ * under RCU like the count part of show_interrupts().
  */
 static struct proc_dir_entry *root_irq_dir;
 
@@ -419,6 +426,153 @@ void unregister_handler_proc(unsigned int irq, struct irqaction *action)
 	proc_remove(action->dir);
 }
 
+/*
+ * /proc/irq/counters: binary per CPU interrupt counts, see
+ * <uapi/linux/irq_counters.h>. Each open file keeps the counts it
+ * returned last, so readers get the deltas without any text formatting
+ * and without walking the interrupts they are not interested in.
+ */
+struct irq_counters_file {
+	struct mutex	lock;
+	struct xarray	last;		/* irq -> unsigned int[nr_cpu_ids] */
+	unsigned int	*counts;
+};
+
+/* Same selection as show_interrupts() */
+static bool irq_counters_snapshot(struct irq_desc *desc, unsigned int *counts)
+{
+	unsigned int any = 0;
+	int cpu;
+
+	if (!desc || irq_settings_is_hidden(desc) || !desc->kstat_irqs)
+		return false;
+
+	memset(counts, 0, nr_cpu_ids * sizeof(*counts));
+	for_each_possible_cpu(cpu) {
+		counts[cpu] = data_race(*per_cpu_ptr(desc->kstat_irqs, cpu));
+		any |= counts[cpu];
+	}
+	return any || (desc->action && !irq_desc_is_chained(desc));
+}
+
+static unsigned int *irq_counters_last(struct irq_counters_file *f,
+				       unsigned int irq)
+{
+	unsigned int *last = xa_load(&f->last, irq);
+
+	if (last)
+		return last;
+
+	last = kcalloc(nr_cpu_ids, sizeof(*last), GFP_KERNEL);
+	if (!last)
+		return NULL;
+	if (xa_err(xa_store(&f->last, irq, last, GFP_KERNEL))) {
+		kfree(last);
+		return NULL;
+	}
+	return last;
+}
+
+static ssize_t irq_counters_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	size_t hsize = offsetof(struct irq_counters_record, counts);
+	size_t csize = nr_cpu_ids * sizeof(__u32);
+	struct irq_counters_file *f = file->private_data;
+	struct irq_counters_record rec = { .nr_cpus = nr_cpu_ids };
+	unsigned int irq, *last;
+	struct irq_desc *desc;
+	ssize_t ret = 0;
+	size_t done = 0;
+	bool show;
+	int cpu;
+
+	if (count < hsize + csize)
+		return -EINVAL;
+	if (*ppos < 0)
+		return -EINVAL;
+	if (*ppos >= nr_irqs)
+		return 0;
+
+	mutex_lock(&f->lock);
+	for (irq = *ppos; count - done >= hsize + csize; irq++) {
+		rcu_read_lock();
+		irq = irq_get_next_irq(irq);
+		desc = irq < nr_irqs ? irq_to_desc(irq) : NULL;
+		show = irq_counters_snapshot(desc, f->counts);
+		rcu_read_unlock();
+
+		if (irq >= nr_irqs)
+			break;
+		if (!show)
+			continue;
+
+		last = irq_counters_last(f, irq);
+		if (!last) {
+			ret = -ENOMEM;
+			break;
+		}
+		for_each_possible_cpu(cpu) {
+			unsigned int cnt = f->counts[cpu];
+
+			f->counts[cpu] = cnt - last[cpu];
+			last[cpu] = cnt;
+		}
+
+		rec.irq = irq;
+		if (copy_to_user(buf + done, &rec, hsize) ||
+		    copy_to_user(buf + done + hsize, f->counts, csize)) {
+			ret = -EFAULT;
+			break;
+		}
+		done += hsize + csize;
+	}
+	*ppos = irq;
+	mutex_unlock(&f->lock);
+
+	return done ? done : ret;
+}
+
+static int irq_counters_open(struct inode *inode, struct file *file)
+{
+	struct irq_counters_file *f;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return -ENOMEM;
+
+	f->counts = kcalloc(nr_cpu_ids, sizeof(*f->counts), GFP_KERNEL);
+	if (!f->counts) {
+		kfree(f);
+		return -ENOMEM;
+	}
+	mutex_init(&f->lock);
+	xa_init(&f->last);
+	file->private_data = f;
+	return 0;
+}
+
+static int irq_counters_release(struct inode *inode, struct file *file)
+{
+	struct irq_counters_file *f = file->private_data;
+	unsigned long irq;
+	void *last;
+
+	xa_for_each(&f->last, irq, last)
+		kfree(last);
+	xa_destroy(&f->last);
+	kfree(f->counts);
+	kfree(f);
+	return 0;
+}
+
+static const struct proc_ops irq_counters_proc_ops = {
+	.proc_open	= irq_counters_open,
+	.proc_read	= irq_counters_read,
+	.proc_lseek	= default_llseek,
+	.proc_release	= irq_counters_release,
+};
+
 static void register_default_affinity_proc(void)
 {
 #ifdef CONFIG_SMP
@@ -438,6 +592,7 @@ void init_irq_proc(void)
 		return;
 
 	register_default_affinity_proc();
+	proc_create("counters", 0444, root_irq_dir, &irq_counters_proc_ops);
 
 	/*
 	 * Create entries for all existing IRQs.
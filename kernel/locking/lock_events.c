@@ -19,6 +19,7 @@
 #include <linux/debugfs.h>
 #include <linux/sched.h>
 #include <linux/sched/clock.h>
+#include <linux/seq_file.h>
 #include <linux/fs.h>
 
 #include "lock_events.h"
@@ -42,6 +43,11 @@
  * summed and computed whenever the corresponding debugfs files are read. This
  * minimizes added overhead making the counts usable even in a production
  * environment.
+ *
+ * The <debugfs>/lock_event_counts/wait_hist/ directory has a log2 histogram
+ * of the time spent waiting in the slowpath of each class of lock, taken
+ * only while "1" is written to its "enable" file. The histograms are per-cpu
+ * as well, and are reset together with the event counts.
  */
 static const char * const lockevent_names[lockevent_num + 1] = {
 
@@ -55,6 +61,19 @@ static const char * const lockevent_names[lockevent_num + 1] = {
  */
 DEFINE_PER_CPU(unsigned long, lockevents[lockevent_num]);
 
+/*
+ * Per-cpu wait time histograms
+ */
+DEFINE_STATIC_KEY_FALSE(lockwait_hist_key);
+DEFINE_PER_CPU(unsigned long, lockwait_hist[lockwait_num][LOCKWAIT_BUCKETS]);
+
+static const char * const lockwait_names[lockwait_num] = {
+	[LOCKWAIT_qspinlock]	= "qspinlock",
+	[LOCKWAIT_mutex]	= "mutex",
+	[LOCKWAIT_rwsem_read]	= "rwsem_read",
+	[LOCKWAIT_rwsem_write]	= "rwsem_write",
+};
+
 /*
  * The lockevent_read() function can be overridden.
  */
@@ -97,11 +116,17 @@ static ssize_t lockevent_write(struct file *file, const char __user *user_buf,
 		return count;
 
 	for_each_possible_cpu(cpu) {
-		int i;
+		int i, j;
 		unsigned long *ptr = per_cpu_ptr(lockevents, cpu);
 
 		for (i = 0 ; i < lockevent_num; i++)
 			WRITE_ONCE(ptr[i], 0);
+
+		for (i = 0; i < lockwait_num; i++) {
+			ptr = per_cpu(lockwait_hist[i], cpu);
+			for (j = 0; j < LOCKWAIT_BUCKETS; j++)
+				WRITE_ONCE(ptr[j], 0);
+		}
 	}
 	return count;
 }
@@ -115,6 +140,73 @@ static const struct file_operations fops_lockevent = {
 	.llseek = default_llseek,
 };
 
+/*
+ * Show the histogram of a lock wait class as the lower bound of each
+ * bucket, in ns, followed by its count. Buckets after the last non-empty
+ * one are not shown.
+ */
+static int lockwait_hist_show(struct seq_file *m, void *v)
+{
+	unsigned long hist[LOCKWAIT_BUCKETS] = { };
+	long class = (long)m->private;
+	int cpu, i, last = -1;
+
+	for_each_possible_cpu(cpu) {
+		unsigned long *ptr = per_cpu(lockwait_hist[class], cpu);
+
+		for (i = 0; i < LOCKWAIT_BUCKETS; i++)
+			hist[i] += READ_ONCE(ptr[i]);
+	}
+
+	for (i = 0; i < LOCKWAIT_BUCKETS; i++) {
+		if (hist[i])
+			last = i;
+	}
+
+	seq_puts(m, "# wait(ns) >=  count\n");
+	for (i = 0; i <= last; i++)
+		seq_printf(m, "%12llu  %lu\n", i ? 1ULL << (i - 1) : 0ULL, hist[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lockwait_hist);
+
+static ssize_t lockwait_enable_read(struct file *file, char __user *user_buf,
+				    size_t count, loff_t *ppos)
+{
+	char buf[3];
+
+	buf[0] = static_key_enabled(&lockwait_hist_key) ? '1' : '0';
+	buf[1] = '\n';
+	buf[2] = 0;
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, 2);
+}
+
+static ssize_t lockwait_enable_write(struct file *file, const char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(user_buf, count, &enable);
+	if (ret)
+		return ret;
+
+	if (enable)
+		static_branch_enable(&lockwait_hist_key);
+	else
+		static_branch_disable(&lockwait_hist_key);
+
+	return count;
+}
+
+static const struct file_operations fops_lockwait_enable = {
+	.read = lockwait_enable_read,
+	.write = lockwait_enable_write,
+	.llseek = default_llseek,
+};
+
 #ifdef CONFIG_PARAVIRT_SPINLOCKS
 #include <asm/paravirt.h>
 
@@ -144,6 +236,7 @@ static inline bool skip_lockevent(const char *name)
 static int __init init_lockevent_counts(void)
 {
 	struct dentry *d_counts = debugfs_create_dir(LOCK_EVENTS_DIR, NULL);
+	struct dentry *d_hist;
 	int i;
 
 	if (!d_counts)
@@ -169,6 +262,23 @@ static int __init init_lockevent_counts(void)
 				 &fops_lockevent))
 		goto fail_undo;
 
+	/*
+	 * Create the wait time histogram files
+	 */
+	d_hist = debugfs_create_dir("wait_hist", d_counts);
+	if (IS_ERR(d_hist))
+		goto fail_undo;
+
+	for (i = 0; i < lockwait_num; i++) {
+		if (!debugfs_create_file(lockwait_names[i], 0400, d_hist,
+					 (void *)(long)i, &lockwait_hist_fops))
+			goto fail_undo;
+	}
+
+	if (!debugfs_create_file("enable", 0600, d_hist, NULL,
+				 &fops_lockwait_enable))
+		goto fail_undo;
+
 	return 0;
 fail_undo:
 	debugfs_remove_recursive(d_counts);
@@ -24,7 +24,28 @@ enum lock_events {
 	LOCKEVENT_reset_cnts = lockevent_num,
 };
 
+/*
+ * Classes of lock slowpaths that have a wait time histogram. The wait time
+ * is only measured while enabled through the wait_hist/enable debugfs file.
+ */
+enum lock_wait_class {
+	LOCKWAIT_qspinlock,
+	LOCKWAIT_mutex,
+	LOCKWAIT_rwsem_read,
+	LOCKWAIT_rwsem_write,
+	lockwait_num,	/* Total number of lock wait classes */
+};
+
+/*
+ * Bucket 0 counts waits of 0ns, bucket n waits of [2^(n-1), 2^n) ns. The
+ * last bucket also counts all the longer waits.
+ */
+#define LOCKWAIT_BUCKETS	40
+
 #ifdef CONFIG_LOCK_EVENT_COUNTS
+#include <linux/jump_label.h>
+#include <linux/sched/clock.h>
+
 /*
  * Per-cpu counters
  */
@@ -50,11 +71,41 @@ static inline void __lockevent_add(enum lock_events event, int inc)
 
 #define lockevent_add(ev, c)	__lockevent_add(LOCKEVENT_ ##ev, c)
 
+DECLARE_STATIC_KEY_FALSE(lockwait_hist_key);
+DECLARE_PER_CPU(unsigned long, lockwait_hist[lockwait_num][LOCKWAIT_BUCKETS]);
+
+/*
+ * Return the start time of a lock wait, or 0 if the histograms are
+ * disabled.
+ */
+static __always_inline u64 lockwait_start(void)
+{
+	if (static_branch_unlikely(&lockwait_hist_key))
+		return local_clock() ?: 1;
+	return 0;
+}
+
+static inline void __lockwait_end(enum lock_wait_class class, u64 start)
+{
+	u64 delta;
+
+	if (!start)
+		return;
+
+	delta = local_clock() - start;
+	raw_cpu_inc(lockwait_hist[class][min(fls64(delta), LOCKWAIT_BUCKETS - 1)]);
+}
+
+#define lockwait_end(cls, start)	__lockwait_end(LOCKWAIT_ ##cls, start)
+
 #else  /* CONFIG_LOCK_EVENT_COUNTS */
 
 #define lockevent_inc(ev)
 #define lockevent_add(ev, c)
 #define lockevent_cond_inc(ev, c)
 
+#define lockwait_start()		0
+#define lockwait_end(cls, start)	do { (void)(start); } while (0)
+
 #endif /* CONFIG_LOCK_EVENT_COUNTS */
 #endif /* __LOCKING_LOCK_EVENTS_H */
@@ -35,6 +35,16 @@ LOCK_EVENT(pv_wait_head)	/* # of vCPU wait's at the queue head	   */
 LOCK_EVENT(pv_wait_node)	/* # of vCPU wait's at non-head queue node */
 #endif /* CONFIG_PARAVIRT_SPINLOCKS */
 
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+/*
+ * Locking events for the NUMA-aware qspinlock slowpath.
+ */
+LOCK_EVENT(cna_intra_node)	/* # of MCS hand-offs within the lock's node */
+LOCK_EVENT(cna_splice_next)	/* # of waiters moved to the secondary queue */
+LOCK_EVENT(cna_splice_head)	/* # of secondary queues moved back	     */
+LOCK_EVENT(cna_flush)		/* # of secondary queue flushes (fairness)   */
+#endif /* CONFIG_NUMA_AWARE_SPINLOCKS */
+
 /*
  * Locking events for qspinlock
  *
@@ -3741,6 +3741,64 @@ static inline struct lock_chain *lookup_chain_cache(u64 chain_key)
 	return NULL;
 }
 
+/*
+ * Per-CPU cache of recently looked up chains, direct-mapped by chain key.
+ * Nearly all acquisitions hit a chain that was validated long ago; finding
+ * it here avoids walking the shared chain hash buckets on every lock.
+ *
+ * Entries point into lock_chains[], which is never freed, and are checked
+ * against the chain key, so a stale entry just misses. To make sure an
+ * entry can't match once its chain is reused for another key, zapping a
+ * chain bumps chain_cache_gen. Chains are only reused after a grace
+ * period, and lookups run with IRQs disabled, so a CPU still seeing the
+ * old generation can't observe the reuse.
+ */
+#define CHAIN_CACHE_BITS	6
+#define CHAIN_CACHE_SIZE	(1UL << CHAIN_CACHE_BITS)
+
+struct chain_cache {
+	unsigned int		gen;
+	struct lock_chain	*chains[CHAIN_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct chain_cache, chain_cache);
+static unsigned int chain_cache_gen;
+
+/* Must be called with the graph lock held. */
+static inline void chain_cache_invalidate(void)
+{
+	WRITE_ONCE(chain_cache_gen, chain_cache_gen + 1);
+}
+
+/*
+ * Look up a dependency chain, trying this CPU's cache first. Must be called
+ * with IRQs disabled.
+ */
+static inline struct lock_chain *lookup_chain_cache_cpu(u64 chain_key)
+{
+	struct chain_cache *cc = this_cpu_ptr(&chain_cache);
+	unsigned int gen = READ_ONCE(chain_cache_gen);
+	struct lock_chain **slot, *chain;
+
+	if (unlikely(cc->gen != gen)) {
+		memset(cc->chains, 0, sizeof(cc->chains));
+		cc->gen = gen;
+	}
+
+	slot = &cc->chains[hash_64(chain_key, CHAIN_CACHE_BITS)];
+	chain = *slot;
+	if (chain && READ_ONCE(chain->chain_key) == chain_key) {
+		debug_atomic_inc(chain_cache_hits);
+		return chain;
+	}
+
+	chain = lookup_chain_cache(chain_key);
+	if (chain)
+		*slot = chain;
+
+	return chain;
+}
+
 /*
  * If the key is not present yet in dependency chain cache then
  * add it and return 1 - in this case the new dependency chain is
@@ -3752,7 +3810,7 @@ static inline int lookup_chain_cache_add(struct task_struct *curr,
 					 u64 chain_key)
 {
 	struct lock_class *class = hlock_class(hlock);
-	struct lock_chain *chain = lookup_chain_cache(chain_key);
+	struct lock_chain *chain = lookup_chain_cache_cpu(chain_key);
 
 	if (chain) {
 cache_hit:
@@ -3861,6 +3919,7 @@ static inline int validate_chain(struct task_struct *curr,
 }
 
 static void init_chain_block_buckets(void)	{ }
+static inline void chain_cache_invalidate(void)	{ }
 #endif /* CONFIG_PROVE_LOCKING */
 
 /*
@@ -5995,6 +6054,7 @@ void lockdep_reset(void)
 	debug_locks = 1;
 	for (i = 0; i < CHAINHASH_SIZE; i++)
 		INIT_HLIST_HEAD(chainhash_table + i);
+	chain_cache_invalidate();
 	raw_local_irq_restore(flags);
 }
 
@@ -6022,6 +6082,7 @@ static void remove_class_from_lock_chain(struct pending_free *pf,
 	free_chain_hlocks(chain->base, chain->depth);
 	/* Overwrite the chain key for concurrent RCU readers. */
 	WRITE_ONCE(chain->chain_key, INITIAL_CHAIN_KEY);
+	chain_cache_invalidate();
 	dec_chains(chain->irq_context);
 
 	/*
@@ -206,6 +206,8 @@ static void lockdep_stats_debug_show(struct seq_file *m)
 		debug_atomic_read(chain_lookup_misses));
 	seq_printf(m, " chain lookup hits:             %11llu\n",
 		debug_atomic_read(chain_lookup_hits));
+	seq_printf(m, " chain cache hits:              %11llu\n",
+		debug_atomic_read(chain_cache_hits));
 	seq_printf(m, " cyclic checks:                 %11llu\n",
 		debug_atomic_read(nr_cyclic_checks));
 	seq_printf(m, " redundant checks:              %11llu\n",
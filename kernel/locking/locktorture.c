@@ -29,6 +29,8 @@
 #include <linux/slab.h>
 #include <linux/torture.h>
 #include <linux/reboot.h>
+#include <linux/sched/clock.h>
+#include <linux/topology.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Paul E. McKenney <paulmck@linux.ibm.com>");
@@ -54,6 +56,15 @@ torture_param(int, verbose, 1,
 torture_param(int, nested_locks, 0, "Number of nested locks (max = 8)");
 /* Going much higher trips "BUG: MAX_LOCKDEP_CHAIN_HLOCKS too low!" errors */
 #define MAX_NESTED_LOCKS 8
+torture_param(int, hist_stats, 0,
+	     "Collect acquire/hold latency histograms and per-node stats");
+torture_param(int, cs_ns, 0, "Extra critical section length (ns)");
+torture_param(int, cs_lines, 0,
+	     "Number of shared cachelines accessed in each critical section");
+torture_param(int, cs_write_pct, 100,
+	     "Percentage of writers' cacheline accesses that are writes");
+torture_param(int, writer_numa, 0,
+	     "Pin writers to NUMA nodes, round-robin (disables shuffling)");
 
 static char *torture_type = IS_ENABLED(CONFIG_PREEMPT_RT) ? "raw_spin_lock" : "spin_lock";
 module_param(torture_type, charp, 0444);
@@ -68,11 +79,28 @@ static bool lock_is_write_held;
 static atomic_t lock_is_read_held;
 static unsigned long last_lock_release;
 
+/*
+ * Latency histograms have log2 buckets: bucket 0 counts 0ns, bucket n
+ * counts [2^(n-1), 2^n) ns and the last one also counts anything longer.
+ */
+#define LOCK_TORTURE_HIST_BUCKETS	36
+
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
+	int node;			/* pinned node, or NUMA_NO_NODE */
+	long *n_node_acquired;		/* per node of the acquiring CPU */
+	unsigned long acquire_hist[LOCK_TORTURE_HIST_BUCKETS];
+	unsigned long hold_hist[LOCK_TORTURE_HIST_BUCKETS];
 };
 
+/* Shared data accessed from the critical sections, see cs_lines. */
+struct lock_torture_line {
+	unsigned long val;
+} ____cacheline_aligned_in_smp;
+
+static struct lock_torture_line *cs_data;
+
 /* Forward reference. */
 static void lock_torture_cleanup(void);
 
@@ -803,6 +831,66 @@ static struct lock_torture_ops percpu_rwsem_lock_ops = {
 	.name		= "percpu_rwsem_lock"
 };
 
+static void lock_torture_hist_add(unsigned long *hist, u64 ns)
+{
+	hist[min(fls64(ns), LOCK_TORTURE_HIST_BUCKETS - 1)]++;
+}
+
+/* Record an acquisition that started waiting at @start. Returns the time. */
+static u64 lock_torture_acquired(struct lock_stress_stats *statp, u64 start)
+{
+	u64 now;
+
+	statp->n_lock_acquired++;
+	if (!hist_stats)
+		return 0;
+
+	now = local_clock();
+	lock_torture_hist_add(statp->acquire_hist, now - start);
+	if (statp->n_node_acquired)
+		statp->n_node_acquired[numa_node_id()]++;
+
+	return now;
+}
+
+static void lock_torture_released(struct lock_stress_stats *statp, u64 acquired)
+{
+	if (hist_stats)
+		lock_torture_hist_add(statp->hold_hist, local_clock() - acquired);
+}
+
+/*
+ * Touch the shared cachelines and spin for cs_ns, emulating the work done
+ * under a contended lock. Readers never write.
+ */
+static void lock_torture_cs(struct torture_random_state *trsp, bool write)
+{
+	int i;
+
+	for (i = 0; i < cs_lines; i++) {
+		if (write && (torture_random(trsp) % 100) < cs_write_pct)
+			WRITE_ONCE(cs_data[i].val, cs_data[i].val + 1);
+		else
+			(void)READ_ONCE(cs_data[i].val);
+	}
+
+	if (cs_ns)
+		ndelay(cs_ns);
+}
+
+/* Return the @n-th node with CPUs, modulo the number of such nodes. */
+static int lock_torture_nth_node(int n)
+{
+	int node;
+
+	n %= num_node_state(N_CPU);
+	for_each_node_state(node, N_CPU) {
+		if (!n--)
+			return node;
+	}
+	return first_online_node;
+}
+
 /*
  * Lock torture writer kthread.  Repeatedly acquires and releases
  * the lock, checking for duplicate acquisitions.
@@ -812,12 +900,18 @@ static int lock_torture_writer(void *arg)
 	struct lock_stress_stats *lwsp = arg;
 	int tid = lwsp - cxt.lwsa;
 	DEFINE_TORTURE_RANDOM(rand);
+	u64 start = 0, acquired = 0;
 	u32 lockset_mask;
 	bool skip_main_lock;
 
 	VERBOSE_TOROUT_STRING("lock_torture_writer task started");
 	set_user_nice(current, MAX_NICE);
 
+	if (writer_numa) {
+		lwsp->node = lock_torture_nth_node(tid);
+		set_cpus_allowed_ptr(current, cpumask_of_node(lwsp->node));
+	}
+
 	do {
 		if ((torture_random(&rand) & 0xfffff) == 0)
 			schedule_timeout_uninterruptible(1);
@@ -839,6 +933,8 @@ static int lock_torture_writer(void *arg)
 			cxt.cur_ops->nested_lock(tid, lockset_mask);
 
 		if (!skip_main_lock) {
+			if (hist_stats)
+				start = local_clock();
 			cxt.cur_ops->writelock(tid);
 			if (WARN_ON_ONCE(lock_is_write_held))
 				lwsp->n_lock_fail++;
@@ -846,10 +942,13 @@ static int lock_torture_writer(void *arg)
 			if (WARN_ON_ONCE(atomic_read(&lock_is_read_held)))
 				lwsp->n_lock_fail++; /* rare, but... */
 
-			lwsp->n_lock_acquired++;
+			acquired = lock_torture_acquired(lwsp, start);
+			/* cs_data is only protected by the main lock */
+			lock_torture_cs(&rand, true);
 		}
 		cxt.cur_ops->write_delay(&rand);
 		if (!skip_main_lock) {
+			lock_torture_released(lwsp, acquired);
 			lock_is_write_held = false;
 			WRITE_ONCE(last_lock_release, jiffies);
 			cxt.cur_ops->writeunlock(tid);
@@ -874,6 +973,7 @@ static int lock_torture_reader(void *arg)
 	struct lock_stress_stats *lrsp = arg;
 	int tid = lrsp - cxt.lrsa;
 	DEFINE_TORTURE_RANDOM(rand);
+	u64 start = 0, acquired;
 
 	VERBOSE_TOROUT_STRING("lock_torture_reader task started");
 	set_user_nice(current, MAX_NICE);
@@ -882,13 +982,17 @@ static int lock_torture_reader(void *arg)
 		if ((torture_random(&rand) & 0xfffff) == 0)
 			schedule_timeout_uninterruptible(1);
 
+		if (hist_stats)
+			start = local_clock();
 		cxt.cur_ops->readlock(tid);
 		atomic_inc(&lock_is_read_held);
 		if (WARN_ON_ONCE(lock_is_write_held))
 			lrsp->n_lock_fail++; /* rare, but... */
 
-		lrsp->n_lock_acquired++;
+		acquired = lock_torture_acquired(lrsp, start);
+		lock_torture_cs(&rand, false);
 		cxt.cur_ops->read_delay(&rand);
+		lock_torture_released(lrsp, acquired);
 		atomic_dec(&lock_is_read_held);
 		cxt.cur_ops->readunlock(tid);
 
@@ -972,6 +1076,120 @@ static void lock_torture_stats_print(void)
 	}
 }
 
+static void lock_torture_print_hist(const char *role, const char *metric,
+				    struct lock_stress_stats *statp, int n_stress,
+				    bool hold)
+{
+	unsigned long hist[LOCK_TORTURE_HIST_BUCKETS] = { };
+	int i, b, last = -1;
+	char *buf, *p;
+
+	for (i = 0; i < n_stress; i++) {
+		unsigned long *h = hold ? statp[i].hold_hist : statp[i].acquire_hist;
+
+		for (b = 0; b < LOCK_TORTURE_HIST_BUCKETS; b++)
+			hist[b] += data_race(h[b]);
+	}
+	for (b = 0; b < LOCK_TORTURE_HIST_BUCKETS; b++) {
+		if (hist[b])
+			last = b;
+	}
+
+	buf = kmalloc(LOCK_TORTURE_HIST_BUCKETS * 48 + 128, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	p = buf + sprintf(buf, "%s-hist: role=%s metric=%s", torture_type,
+			  role, metric);
+	for (b = 0; b <= last; b++)
+		p += sprintf(p, " %llu=%lu", b ? 1ULL << (b - 1) : 0ULL, hist[b]);
+	pr_alert("%s\n", buf);
+	kfree(buf);
+}
+
+/*
+ * Print the per-thread and per-node acquisition counts, and the latency
+ * histograms, at the end of the test. Each line is "<type>-<kind>:"
+ * followed by space separated key=value pairs. Histogram buckets are
+ * "<lower bound in ns>=<count>".
+ */
+static void __lock_torture_print_report(const char *role,
+					struct lock_stress_stats *statp,
+					int n_stress)
+{
+	long node_sum, node_threads;
+	int i, node;
+
+	if (!statp)
+		return;
+
+	for (i = 0; i < n_stress; i++)
+		pr_alert("%s-thread: role=%s tid=%d node=%d acquired=%ld fail=%ld\n",
+			 torture_type, role, i, statp[i].node,
+			 data_race(statp[i].n_lock_acquired),
+			 data_race(statp[i].n_lock_fail));
+
+	for_each_online_node(node) {
+		node_sum = 0;
+		node_threads = 0;
+		for (i = 0; i < n_stress; i++) {
+			if (statp[i].n_node_acquired)
+				node_sum += data_race(statp[i].n_node_acquired[node]);
+			if (statp[i].node == node)
+				node_threads++;
+		}
+		pr_alert("%s-node: role=%s node=%d pinned_threads=%ld acquired=%ld\n",
+			 torture_type, role, node, node_threads, node_sum);
+	}
+
+	lock_torture_print_hist(role, "acquire_ns", statp, n_stress, false);
+	lock_torture_print_hist(role, "hold_ns", statp, n_stress, true);
+}
+
+static void lock_torture_print_report(void)
+{
+	if (!hist_stats)
+		return;
+
+	__lock_torture_print_report("write", cxt.lwsa, cxt.nrealwriters_stress);
+	if (cxt.cur_ops->readlock)
+		__lock_torture_print_report("read", cxt.lrsa,
+					    cxt.nrealreaders_stress);
+}
+
+static void lock_torture_free_stats(struct lock_stress_stats *statp, int n_stress)
+{
+	int i;
+
+	if (!statp)
+		return;
+
+	for (i = 0; i < n_stress; i++)
+		kfree(statp[i].n_node_acquired);
+	kfree(statp);
+}
+
+static int lock_torture_init_stats(struct lock_stress_stats *statp, int n_stress)
+{
+	int i;
+
+	for (i = 0; i < n_stress; i++) {
+		memset(&statp[i], 0, sizeof(statp[i]));
+		statp[i].node = NUMA_NO_NODE;
+	}
+
+	if (!hist_stats)
+		return 0;
+
+	for (i = 0; i < n_stress; i++) {
+		statp[i].n_node_acquired = kcalloc(nr_node_ids, sizeof(long),
+						   GFP_KERNEL);
+		if (!statp[i].n_node_acquired)
+			return -ENOMEM;
+	}
+	return 0;
+}
+
 /*
  * Periodically prints torture statistics, if periodic statistics printing
  * was specified via the stat_interval module parameter.
@@ -996,11 +1214,12 @@ lock_torture_print_module_parms(struct lock_torture_ops *cur_ops,
 				const char *tag)
 {
 	pr_alert("%s" TORTURE_FLAG
-		 "--- %s%s: nwriters_stress=%d nreaders_stress=%d nested_locks=%d stat_interval=%d verbose=%d shuffle_interval=%d stutter=%d shutdown_secs=%d onoff_interval=%d onoff_holdoff=%d\n",
+		 "--- %s%s: nwriters_stress=%d nreaders_stress=%d nested_locks=%d stat_interval=%d verbose=%d shuffle_interval=%d stutter=%d shutdown_secs=%d onoff_interval=%d onoff_holdoff=%d hist_stats=%d cs_ns=%d cs_lines=%d cs_write_pct=%d writer_numa=%d\n",
 		 torture_type, tag, cxt.debug_lock ? " [debug]": "",
 		 cxt.nrealwriters_stress, cxt.nrealreaders_stress,
 		 nested_locks, stat_interval, verbose, shuffle_interval,
-		 stutter, shutdown_secs, onoff_interval, onoff_holdoff);
+		 stutter, shutdown_secs, onoff_interval, onoff_holdoff,
+		 hist_stats, cs_ns, cs_lines, cs_write_pct, writer_numa);
 }
 
 static void lock_torture_cleanup(void)
@@ -1038,6 +1257,7 @@ static void lock_torture_cleanup(void)
 
 	torture_stop_kthread(lock_torture_stats, stats_task);
 	lock_torture_stats_print();  /* -After- the stats thread is stopped! */
+	lock_torture_print_report();
 
 	if (atomic_read(&cxt.n_lock_torture_errors))
 		lock_torture_print_module_parms(cxt.cur_ops,
@@ -1049,12 +1269,14 @@ static void lock_torture_cleanup(void)
 		lock_torture_print_module_parms(cxt.cur_ops,
 						"End of test: SUCCESS");
 
-	kfree(cxt.lwsa);
+	lock_torture_free_stats(cxt.lwsa, cxt.nrealwriters_stress);
 	cxt.lwsa = NULL;
-	kfree(cxt.lrsa);
+	lock_torture_free_stats(cxt.lrsa, cxt.nrealreaders_stress);
 	cxt.lrsa = NULL;
 
 end:
+	kfree(cs_data);
+	cs_data = NULL;
 	if (cxt.init_called) {
 		if (cxt.cur_ops->exit)
 			cxt.cur_ops->exit();
@@ -1144,9 +1366,12 @@ static int __init lock_torture_init(void)
 			goto unwind;
 		}
 
-		for (i = 0; i < cxt.nrealwriters_stress; i++) {
-			cxt.lwsa[i].n_lock_fail = 0;
-			cxt.lwsa[i].n_lock_acquired = 0;
+		if (lock_torture_init_stats(cxt.lwsa, cxt.nrealwriters_stress)) {
+			VERBOSE_TOROUT_STRING("cxt.lwsa: Out of memory");
+			firsterr = -ENOMEM;
+			lock_torture_free_stats(cxt.lwsa, cxt.nrealwriters_stress);
+			cxt.lwsa = NULL;
+			goto unwind;
 		}
 	}
 
@@ -1168,19 +1393,28 @@ static int __init lock_torture_init(void)
 			cxt.lrsa = kmalloc_array(cxt.nrealreaders_stress,
 						 sizeof(*cxt.lrsa),
 						 GFP_KERNEL);
-			if (cxt.lrsa == NULL) {
+			if (cxt.lrsa == NULL ||
+			    lock_torture_init_stats(cxt.lrsa, cxt.nrealreaders_stress)) {
 				VERBOSE_TOROUT_STRING("cxt.lrsa: Out of memory");
 				firsterr = -ENOMEM;
-				kfree(cxt.lwsa);
+				lock_torture_free_stats(cxt.lwsa, cxt.nrealwriters_stress);
 				cxt.lwsa = NULL;
+				lock_torture_free_stats(cxt.lrsa, cxt.nrealreaders_stress);
+				cxt.lrsa = NULL;
 				goto unwind;
 			}
+		}
+	}
 
-			for (i = 0; i < cxt.nrealreaders_stress; i++) {
-				cxt.lrsa[i].n_lock_fail = 0;
-				cxt.lrsa[i].n_lock_acquired = 0;
-			}
+	if (cs_lines > 0) {
+		cs_data = kcalloc(cs_lines, sizeof(*cs_data), GFP_KERNEL);
+		if (!cs_data) {
+			VERBOSE_TOROUT_STRING("cs_data: Out of memory");
+			firsterr = -ENOMEM;
+			goto unwind;
 		}
+	} else {
+		cs_lines = 0;
 	}
 
 	lock_torture_print_module_parms(cxt.cur_ops, "Start of test");
@@ -1192,7 +1426,8 @@ static int __init lock_torture_init(void)
 		if (torture_init_error(firsterr))
 			goto unwind;
 	}
-	if (shuffle_interval > 0) {
+	/* The shuffler would undo the NUMA placement of the writers. */
+	if (shuffle_interval > 0 && !writer_numa) {
 		firsterr = torture_shuffle_init(shuffle_interval);
 		if (torture_init_error(firsterr))
 			goto unwind;
@@ -34,6 +34,7 @@
 #include <trace/events/lock.h>
 
 #ifndef CONFIG_PREEMPT_RT
+#include "lock_events.h"
 #include "mutex.h"
 
 #ifdef CONFIG_DEBUG_MUTEXES
@@ -572,6 +573,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 {
 	struct mutex_waiter waiter;
 	struct ww_mutex *ww;
+	u64 wait_start;
 	int ret;
 
 	if (!use_ww_ctx)
@@ -602,6 +604,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	preempt_disable();
 	mutex_acquire_nest(&lock->dep_map, subclass, 0, nest_lock, ip);
 
+	wait_start = lockwait_start();
 	trace_contention_begin(lock, LCB_F_MUTEX | LCB_F_SPIN);
 	if (__mutex_trylock(lock) ||
 	    mutex_optimistic_spin(lock, ww_ctx, NULL)) {
@@ -610,6 +613,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 		if (ww_ctx)
 			ww_mutex_set_context_fastpath(ww, ww_ctx);
 		trace_contention_end(lock, 0);
+		lockwait_end(mutex, wait_start);
 		preempt_enable();
 		return 0;
 	}
@@ -720,6 +724,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	/* got the lock - cleanup and rejoice! */
 	lock_acquired(&lock->dep_map, ip);
 	trace_contention_end(lock, 0);
+	lockwait_end(mutex, wait_start);
 
 	if (ww_ctx)
 		ww_mutex_lock_acquired(ww, ww_ctx);
@@ -22,6 +22,9 @@ int __percpu_init_rwsem(struct percpu_rw_semaphore *sem,
 	rcuwait_init(&sem->writer);
 	init_waitqueue_head(&sem->waiters);
 	atomic_set(&sem->block, 0);
+	atomic_set(&sem->batch_held, 0);
+	sem->batch_delay = 0;
+	timer_setup(&sem->batch_timer, percpu_rwsem_batch_expire, 0);
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	debug_check_no_locks_freed((void *)sem, sizeof(*sem));
 	lockdep_init_map(&sem->dep_map, name, key, 0);
@@ -39,6 +42,10 @@ void percpu_free_rwsem(struct percpu_rw_semaphore *sem)
 	if (!sem->read_count)
 		return;
 
+	timer_delete_sync(&sem->batch_timer);
+	if (atomic_xchg(&sem->batch_held, 0))
+		rcu_sync_exit(&sem->rss);
+
 	rcu_sync_dtor(&sem->rss);
 	free_percpu(sem->read_count);
 	sem->read_count = NULL; /* catch use after free bugs */
@@ -227,8 +234,12 @@ void __sched percpu_down_write(struct percpu_rw_semaphore *sem)
 	rwsem_acquire(&sem->dep_map, 0, 0, _RET_IP_);
 	trace_contention_begin(sem, LCB_F_PERCPU | LCB_F_WRITE);
 
-	/* Notify readers to take the slow path. */
-	rcu_sync_enter(&sem->rss);
+	/*
+	 * Notify readers to take the slow path, unless a previous writer
+	 * left them there for us; see percpu_rwsem_set_write_batch().
+	 */
+	if (!atomic_xchg(&sem->batch_held, 0))
+		rcu_sync_enter(&sem->rss);
 
 	/*
 	 * Try set sem->block; this provides writer-writer exclusion.
@@ -253,6 +264,8 @@ EXPORT_SYMBOL_GPL(percpu_down_write);
 
 void percpu_up_write(struct percpu_rw_semaphore *sem)
 {
+	unsigned long delay;
+
 	rwsem_release(&sem->dep_map, _RET_IP_);
 
 	/*
@@ -272,6 +285,18 @@ void percpu_up_write(struct percpu_rw_semaphore *sem)
 	 */
 	__wake_up(&sem->waiters, TASK_NORMAL, 1, sem);
 
+	/*
+	 * When batching writers, park our rcu_sync reference rather than
+	 * dropping it, so readers stay on the slow path and the next writer
+	 * can take over without another grace period. The reference is only
+	 * dropped once no writer came along for sem->batch_delay.
+	 */
+	delay = READ_ONCE(sem->batch_delay);
+	if (delay && !atomic_xchg(&sem->batch_held, 1)) {
+		mod_timer(&sem->batch_timer, jiffies + delay);
+		return;
+	}
+
 	/*
 	 * Once this completes (at least one RCU-sched grace period hence) the
 	 * reader fast path will be available again. Safe to use outside the
@@ -280,3 +305,38 @@ void percpu_up_write(struct percpu_rw_semaphore *sem)
 	rcu_sync_exit(&sem->rss);
 }
 EXPORT_SYMBOL_GPL(percpu_up_write);
+
+void percpu_rwsem_batch_expire(struct timer_list *t)
+{
+	struct percpu_rw_semaphore *sem = from_timer(sem, t, batch_timer);
+
+	/* No writer took over the parked reference; let readers go fast. */
+	if (atomic_xchg(&sem->batch_held, 0))
+		rcu_sync_exit(&sem->rss);
+}
+EXPORT_SYMBOL_GPL(percpu_rwsem_batch_expire);
+
+/**
+ * percpu_rwsem_set_write_batch - batch back-to-back writers
+ * @sem: the percpu_rw_semaphore
+ * @delay: time in jiffies the readers stay on the slow path after a writer
+ *	   is done, or 0 to disable batching
+ *
+ * Every writer normally takes the readers off the fast path and lets them
+ * back on one grace period after it is done, so that a stream of writers
+ * each waiting for a grace period ends up serialized on RCU. With batching,
+ * the readers only return to the fast path once the write side has been
+ * idle for @delay, and writers arriving before that do not wait for a
+ * grace period at all.
+ */
+void percpu_rwsem_set_write_batch(struct percpu_rw_semaphore *sem,
+				  unsigned long delay)
+{
+	WRITE_ONCE(sem->batch_delay, delay);
+
+	if (!delay) {
+		timer_delete_sync(&sem->batch_timer);
+		percpu_rwsem_batch_expire(&sem->batch_timer);
+	}
+}
+EXPORT_SYMBOL_GPL(percpu_rwsem_set_write_batch);
@@ -13,6 +13,7 @@
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
 #include <linux/mm.h>
+#include <linux/timekeeping.h>
 
 #ifndef ARCH_SHF_SMALL
 #define ARCH_SHF_SMALL 0
@@ -46,6 +47,17 @@ extern const struct kernel_symbol __stop___ksymtab_gpl[];
 extern const s32 __start___kcrctab[];
 extern const s32 __start___kcrctab_gpl[];
 
+/* Phases of loading a module timed by CONFIG_MODULE_STATS */
+enum mod_load_phase {
+	MOD_LOAD_DECOMPRESS,
+	MOD_LOAD_LAYOUT,
+	MOD_LOAD_SYMBOLS,
+	MOD_LOAD_RELOCS,
+	MOD_LOAD_FORMATION,
+	MOD_LOAD_INIT,
+	MOD_LOAD_PHASES,
+};
+
 struct load_info {
 	const char *name;
 	/* pointer to module in temporary copy, freed at end of load_module() */
@@ -59,6 +71,9 @@ struct load_info {
 #ifdef CONFIG_KALLSYMS
 	unsigned long mod_kallsyms_init_off;
 #endif
+#ifdef CONFIG_MODULE_STATS
+	u64 phase_ns[MOD_LOAD_PHASES];
+#endif
 #ifdef CONFIG_MODULE_DECOMPRESS
 #ifdef CONFIG_MODULE_STATS
 	unsigned long compressed_len;
@@ -200,6 +215,19 @@ struct mod_fail_load {
 int try_add_failed_module(const char *name, enum fail_dup_mod_reason reason);
 void mod_stat_bump_invalid(struct load_info *info, int flags);
 void mod_stat_bump_becoming(struct load_info *info, int flags);
+void mod_stat_add_load_times(struct module *mod, struct load_info *info);
+void mod_stat_init_time(struct module *mod, u64 ns);
+
+static inline u64 mod_stat_clock(void)
+{
+	return ktime_get_ns();
+}
+
+static inline void mod_stat_phase(struct load_info *info,
+				  enum mod_load_phase phase, u64 start)
+{
+	info->phase_ns[phase] += ktime_get_ns() - start;
+}
 
 #else
 
@@ -220,6 +248,25 @@ static inline void mod_stat_bump_becoming(struct load_info *info, int flags)
 {
 }
 
+static inline void mod_stat_add_load_times(struct module *mod,
+					   struct load_info *info)
+{
+}
+
+static inline void mod_stat_init_time(struct module *mod, u64 ns)
+{
+}
+
+static inline u64 mod_stat_clock(void)
+{
+	return 0;
+}
+
+static inline void mod_stat_phase(struct load_info *info,
+				  enum mod_load_phase phase, u64 start)
+{
+}
+
 #endif /* CONFIG_MODULE_STATS */
 
 #ifdef CONFIG_MODULE_DEBUG_AUTOLOAD_DUPS
@@ -336,6 +383,8 @@ static inline void kmemleak_load_module(const struct module *mod,
 void init_build_id(struct module *mod, const struct load_info *info);
 void layout_symtab(struct module *mod, struct load_info *info);
 void add_kallsyms(struct module *mod, const struct load_info *info);
+void free_kallsyms_index(struct module *mod);
+void module_kallsyms_changed(void);
 
 static inline bool sect_empty(const Elf_Shdr *sect)
 {
@@ -345,6 +394,8 @@ static inline bool sect_empty(const Elf_Shdr *sect)
 static inline void init_build_id(struct module *mod, const struct load_info *info) { }
 static inline void layout_symtab(struct module *mod, struct load_info *info) { }
 static inline void add_kallsyms(struct module *mod, const struct load_info *info) { }
+static inline void free_kallsyms_index(struct module *mod) { }
+static inline void module_kallsyms_changed(void) { }
 #endif /* CONFIG_KALLSYMS */
 
 #ifdef CONFIG_SYSFS
@@ -10,6 +10,7 @@
 #include <linux/kallsyms.h>
 #include <linux/buildid.h>
 #include <linux/bsearch.h>
+#include <linux/sort.h>
 #include "internal.h"
 
 /* Lookup exported symbol in given range of kernel_symbols */
@@ -162,6 +163,70 @@ void layout_symtab(struct module *mod, struct load_info *info)
 	mod_mem_init_data->size += nsrc * sizeof(char);
 }
 
+static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
+{
+	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+}
+
+/* Can @symnum be the answer to an address lookup? */
+static bool kallsyms_symbol_addressable(struct mod_kallsyms *kallsyms,
+					unsigned int symnum)
+{
+	const char *name = kallsyms_symbol_name(kallsyms, symnum);
+
+	if (kallsyms->symtab[symnum].st_shndx == SHN_UNDEF)
+		return false;
+
+	/*
+	 * We ignore unnamed symbols: they're uninformative
+	 * and inserted at a whim.
+	 */
+	return *name != '\0' && !is_mapping_symbol(name);
+}
+
+static int cmp_kallsyms_addr(const void *a, const void *b, const void *priv)
+{
+	const struct mod_kallsyms *kallsyms = priv;
+	unsigned int ia = *(const unsigned int *)a;
+	unsigned int ib = *(const unsigned int *)b;
+	unsigned long va = kallsyms_symbol_value(&kallsyms->symtab[ia]);
+	unsigned long vb = kallsyms_symbol_value(&kallsyms->symtab[ib]);
+
+	if (va != vb)
+		return va < vb ? -1 : 1;
+	return ia < ib ? -1 : ia > ib;
+}
+
+/*
+ * Sort the symbols find_kallsyms_symbol() may return by address, and
+ * among the same address by symbol number. Without the index lookups
+ * fall back to scanning the whole table.
+ */
+static void build_kallsyms_index(struct mod_kallsyms *kallsyms)
+{
+	unsigned int i, n = 0, *idx;
+
+	idx = kvmalloc_array(kallsyms->num_symtab, sizeof(*idx), GFP_KERNEL);
+	if (!idx)
+		return;
+
+	for (i = 1; i < kallsyms->num_symtab; i++) {
+		if (kallsyms_symbol_addressable(kallsyms, i))
+			idx[n++] = i;
+	}
+
+	sort_r(idx, n, sizeof(*idx), cmp_kallsyms_addr, NULL, kallsyms);
+
+	kallsyms->addr_index = idx;
+	kallsyms->num_addr_index = n;
+}
+
+void free_kallsyms_index(struct module *mod)
+{
+	kvfree(mod->core_kallsyms.addr_index);
+	mod->core_kallsyms.addr_index = NULL;
+}
+
 /*
  * We use the full symtab and strtab which layout_symtab arranged to
  * be appended to the init section.  Later we switch to the cut-down
@@ -190,6 +255,8 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	rcu_dereference(mod->kallsyms)->strtab =
 		(void *)info->sechdrs[info->index.str].sh_addr;
 	rcu_dereference(mod->kallsyms)->typetab = init_data_base + info->init_typeoffs;
+	/* Lookups during init are rare, they scan the full symtab. */
+	rcu_dereference(mod->kallsyms)->addr_index = NULL;
 
 	/*
 	 * Now populate the cut down core kallsyms for after init
@@ -222,6 +289,8 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	}
 	rcu_read_unlock();
 	mod->core_kallsyms.num_symtab = ndst;
+
+	build_kallsyms_index(&mod->core_kallsyms);
 }
 
 #if IS_ENABLED(CONFIG_STACKTRACE_BUILD_ID)
@@ -244,9 +313,42 @@ void init_build_id(struct module *mod, const struct load_info *info)
 }
 #endif
 
-static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
+/*
+ * Find what the scan in find_kallsyms_symbol() would, in the address index:
+ * the first of the symbols at the highest address not above @addr. The
+ * address of the symbol after @addr lowers *@nextval.
+ */
+static unsigned int find_kallsyms_index(struct mod_kallsyms *kallsyms,
+					unsigned long addr,
+					unsigned long *nextval)
 {
-	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+	const unsigned int *idx = kallsyms->addr_index;
+	unsigned int lo = 0, hi = kallsyms->num_addr_index, mid;
+	unsigned long val;
+
+	/* The first symbol above @addr. */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (kallsyms_symbol_value(&kallsyms->symtab[idx[mid]]) <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < kallsyms->num_addr_index) {
+		val = kallsyms_symbol_value(&kallsyms->symtab[idx[lo]]);
+		*nextval = min(*nextval, val);
+	}
+
+	if (!lo)
+		return 0;
+
+	val = kallsyms_symbol_value(&kallsyms->symtab[idx[lo - 1]]);
+	while (lo > 1 &&
+	       kallsyms_symbol_value(&kallsyms->symtab[idx[lo - 2]]) == val)
+		lo--;
+
+	return idx[lo - 1];
 }
 
 /*
@@ -273,6 +375,15 @@ static const char *find_kallsyms_symbol(struct module *mod,
 
 	bestval = kallsyms_symbol_value(&kallsyms->symtab[best]);
 
+	if (kallsyms->addr_index) {
+		i = find_kallsyms_index(kallsyms, addr, &nextval);
+		if (i && kallsyms_symbol_value(&kallsyms->symtab[i]) > bestval) {
+			best = i;
+			bestval = kallsyms_symbol_value(&kallsyms->symtab[i]);
+		}
+		goto found;
+	}
+
 	/*
 	 * Scan for closest preceding symbol, and next symbol. (ELF
 	 * starts real symbols at 1).
@@ -281,15 +392,7 @@ static const char *find_kallsyms_symbol(struct module *mod,
 		const Elf_Sym *sym = &kallsyms->symtab[i];
 		unsigned long thisval = kallsyms_symbol_value(sym);
 
-		if (sym->st_shndx == SHN_UNDEF)
-			continue;
-
-		/*
-		 * We ignore unnamed symbols: they're uninformative
-		 * and inserted at a whim.
-		 */
-		if (*kallsyms_symbol_name(kallsyms, i) == '\0' ||
-		    is_mapping_symbol(kallsyms_symbol_name(kallsyms, i)))
+		if (!kallsyms_symbol_addressable(kallsyms, i))
 			continue;
 
 		if (thisval <= addr && thisval > bestval) {
@@ -300,6 +403,7 @@ static const char *find_kallsyms_symbol(struct module *mod,
 			nextval = thisval;
 	}
 
+found:
 	if (!best)
 		return NULL;
 
@@ -409,21 +513,64 @@ int lookup_module_symbol_attrs(unsigned long addr, unsigned long *size,
 	return -ERANGE;
 }
 
+/*
+ * /proc/kallsyms asks module_get_kallsym() for one symbol number after the
+ * other. Remember on which module and at which symbol number the last call
+ * ended up, so that the next one needn't walk the module list from the
+ * start. Anything that changes which modules are listed or the size of
+ * their symbol tables calls module_kallsyms_changed(), which invalidates
+ * the hint. A module we have a hint for can only be freed after an RCU
+ * grace period, so it is safe to use while preemption is disabled.
+ */
+struct module_kallsym_hint {
+	struct module *mod;
+	unsigned int base;
+	unsigned long gen;
+};
+
+static DEFINE_PER_CPU(struct module_kallsym_hint, module_kallsym_hint);
+static atomic_long_t module_kallsyms_gen;
+
+void module_kallsyms_changed(void)
+{
+	atomic_long_inc(&module_kallsyms_gen);
+}
+
 int module_get_kallsym(unsigned int symnum, unsigned long *value, char *type,
 		       char *name, char *module_name, int *exported)
 {
+	struct module_kallsym_hint *hint;
+	unsigned int base = 0;
 	struct module *mod;
+	unsigned long gen;
 
 	preempt_disable();
-	list_for_each_entry_rcu(mod, &modules, list) {
+	hint = this_cpu_ptr(&module_kallsym_hint);
+	gen = atomic_long_read(&module_kallsyms_gen);
+	if (hint->mod && hint->gen == gen && symnum >= hint->base) {
+		mod = hint->mod;
+		base = hint->base;
+	} else {
+		mod = list_first_or_null_rcu(&modules, struct module, list);
+		if (!mod)
+			goto out;
+	}
+
+	list_for_each_entry_from_rcu(mod, &modules, list) {
 		struct mod_kallsyms *kallsyms;
 
 		if (mod->state == MODULE_STATE_UNFORMED)
 			continue;
 		kallsyms = rcu_dereference_sched(mod->kallsyms);
-		if (symnum < kallsyms->num_symtab) {
-			const Elf_Sym *sym = &kallsyms->symtab[symnum];
+		if (symnum - base < kallsyms->num_symtab) {
+			const Elf_Sym *sym;
 
+			hint->mod = mod;
+			hint->base = base;
+			hint->gen = gen;
+
+			symnum -= base;
+			sym = &kallsyms->symtab[symnum];
 			*value = kallsyms_symbol_value(sym);
 			*type = kallsyms->typetab[symnum];
 			strscpy(name, kallsyms_symbol_name(kallsyms, symnum), KSYM_NAME_LEN);
@@ -432,8 +579,9 @@ int module_get_kallsym(unsigned int symnum, unsigned long *value, char *type,
 			preempt_enable();
 			return 0;
 		}
-		symnum -= kallsyms->num_symtab;
+		base += kallsyms->num_symtab;
 	}
+out:
 	preempt_enable();
 	return -ERANGE;
 }
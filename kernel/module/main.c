@@ -299,7 +299,8 @@ static bool find_exported_symbol_in_section(const struct symsearch *syms,
  * Find an exported symbol and return it, along with, (optional) crc and
  * (optional) module which owns it.  Needs preempt disabled or module_mutex.
  */
-bool find_symbol(struct find_symbol_arg *fsa)
+/* Find an exported symbol of the kernel proper. Needs no locking. */
+static bool find_kernel_symbol(struct find_symbol_arg *fsa)
 {
 	static const struct symsearch arr[] = {
 		{ __start___ksymtab, __stop___ksymtab, __start___kcrctab,
@@ -308,15 +309,25 @@ bool find_symbol(struct find_symbol_arg *fsa)
 		  __start___kcrctab_gpl,
 		  GPL_ONLY },
 	};
-	struct module *mod;
 	unsigned int i;
 
-	module_assert_mutex_or_preempt();
-
 	for (i = 0; i < ARRAY_SIZE(arr); i++)
 		if (find_exported_symbol_in_section(&arr[i], NULL, fsa))
 			return true;
 
+	return false;
+}
+
+bool find_symbol(struct find_symbol_arg *fsa)
+{
+	struct module *mod;
+	unsigned int i;
+
+	module_assert_mutex_or_preempt();
+
+	if (find_kernel_symbol(fsa))
+		return true;
+
 	list_for_each_entry_rcu(mod, &modules, list,
 				lockdep_is_held(&module_mutex)) {
 		struct symsearch arr[] = {
@@ -1112,6 +1123,17 @@ static bool inherit_taint(struct module *mod, struct module *owner, const char *
 	return true;
 }
 
+/* Checks of a symbol @mod imports which don't depend on its owner. */
+static int check_resolved_symbol(struct module *mod,
+				 const struct load_info *info,
+				 const struct find_symbol_arg *fsa)
+{
+	if (!check_version(info, fsa->name, mod, fsa->crc))
+		return -EINVAL;
+
+	return verify_namespace_is_imported(info, fsa->sym, mod);
+}
+
 /* Resolve a symbol for this module.  I.e. if we find one, record usage. */
 static const struct kernel_symbol *resolve_symbol(struct module *mod,
 						  const struct load_info *info,
@@ -1125,6 +1147,24 @@ static const struct kernel_symbol *resolve_symbol(struct module *mod,
 	};
 	int err;
 
+	/*
+	 * Symbols of the kernel proper can't go away and there is no module
+	 * to take a reference on, so they don't need module_mutex. As they
+	 * are most of what a module imports, this keeps modules loading in
+	 * parallel from taking turns on the mutex for every symbol.
+	 */
+	if (find_kernel_symbol(&fsa)) {
+		if (fsa.license == GPL_ONLY)
+			mod->using_gplonly_symbols = true;
+
+		err = check_resolved_symbol(mod, info, &fsa);
+		if (err) {
+			strncpy(ownername, module_name(NULL), MODULE_NAME_LEN);
+			return ERR_PTR(err);
+		}
+		return fsa.sym;
+	}
+
 	/*
 	 * The module_mutex should not be a heavily contended lock;
 	 * if we get the occasional sleep here, we'll go an extra iteration
@@ -1143,12 +1183,7 @@ static const struct kernel_symbol *resolve_symbol(struct module *mod,
 		goto getname;
 	}
 
-	if (!check_version(info, name, mod, fsa.crc)) {
-		fsa.sym = ERR_PTR(-EINVAL);
-		goto getname;
-	}
-
-	err = verify_namespace_is_imported(info, fsa.sym, mod);
+	err = check_resolved_symbol(mod, info, &fsa);
 	if (err) {
 		fsa.sym = ERR_PTR(err);
 		goto getname;
@@ -1227,6 +1262,8 @@ static void module_memory_free(void *ptr, enum mod_mem_type type)
 
 static void free_mod_mem(struct module *mod)
 {
+	free_kallsyms_index(mod);
+
 	for_each_mod_mem_type(type) {
 		struct module_memory *mod_mem = &mod->mem[type];
 
@@ -1257,6 +1294,7 @@ static void free_module(struct module *mod)
 	 */
 	mutex_lock(&module_mutex);
 	mod->state = MODULE_STATE_UNFORMED;
+	module_kallsyms_changed();
 	mutex_unlock(&module_mutex);
 
 	/* Arch-specific cleanup. */
@@ -2501,6 +2539,7 @@ static noinline int do_init_module(struct module *mod)
 {
 	int ret = 0;
 	struct mod_initfree *freeinit;
+	u64 start;
 #if defined(CONFIG_MODULE_STATS)
 	unsigned int text_size = 0, total_size = 0;
 
@@ -2523,10 +2562,12 @@ static noinline int do_init_module(struct module *mod)
 	freeinit->init_data = mod->mem[MOD_INIT_DATA].base;
 	freeinit->init_rodata = mod->mem[MOD_INIT_RODATA].base;
 
+	start = mod_stat_clock();
 	do_mod_ctors(mod);
 	/* Start the module */
 	if (mod->init != NULL)
 		ret = do_one_initcall(mod->init);
+	mod_stat_init_time(mod, mod_stat_clock() - start);
 	if (ret < 0) {
 		goto fail_free_freeinit;
 	}
@@ -2566,6 +2607,7 @@ static noinline int do_init_module(struct module *mod)
 #ifdef CONFIG_KALLSYMS
 	/* Switch to core kallsyms now init is done: kallsyms may be walking! */
 	rcu_assign_pointer(mod->kallsyms, &mod->core_kallsyms);
+	module_kallsyms_changed();
 #endif
 	module_enable_ro(mod, true);
 	mod_tree_remove_init(mod);
@@ -2721,6 +2763,15 @@ static int complete_formation(struct module *mod, struct load_info *info)
 {
 	int err;
 
+	/*
+	 * Nobody but us can see the module memory yet. Changing its
+	 * permissions flushes the TLB on all CPUs, don't make parallel
+	 * loads wait for that on the mutex.
+	 */
+	module_enable_ro(mod, false);
+	module_enable_nx(mod);
+	module_enable_x(mod);
+
 	mutex_lock(&module_mutex);
 
 	/* Find duplicate symbols (must be called under lock). */
@@ -2732,15 +2783,12 @@ static int complete_formation(struct module *mod, struct load_info *info)
 	module_bug_finalize(info->hdr, info->sechdrs, mod);
 	module_cfi_finalize(info->hdr, info->sechdrs, mod);
 
-	module_enable_ro(mod, false);
-	module_enable_nx(mod);
-	module_enable_x(mod);
-
 	/*
 	 * Mark state as coming so strong_try_module_get() ignores us,
 	 * but kallsyms etc. can see us.
 	 */
 	mod->state = MODULE_STATE_COMING;
+	module_kallsyms_changed();
 	mutex_unlock(&module_mutex);
 
 	return 0;
@@ -2831,6 +2879,7 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	bool module_allocated = false;
 	long err = 0;
 	char *after_dashes;
+	u64 start;
 
 	/*
 	 * Do the signature check (if any) first. All that
@@ -2862,7 +2911,9 @@ static int load_module(struct load_info *info, const char __user *uargs,
 		goto free_copy;
 
 	/* Figure out module layout, and allocate all the memory. */
+	start = mod_stat_clock();
 	mod = layout_and_allocate(info, flags);
+	mod_stat_phase(info, MOD_LOAD_LAYOUT, start);
 	if (IS_ERR(mod)) {
 		err = PTR_ERR(mod);
 		goto free_copy;
@@ -2911,11 +2962,15 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	setup_modinfo(mod, info);
 
 	/* Fix up syms, so that st_value is a pointer to location. */
+	start = mod_stat_clock();
 	err = simplify_symbols(mod, info);
+	mod_stat_phase(info, MOD_LOAD_SYMBOLS, start);
 	if (err < 0)
 		goto free_modinfo;
 
+	start = mod_stat_clock();
 	err = apply_relocations(mod, info);
+	mod_stat_phase(info, MOD_LOAD_RELOCS, start);
 	if (err < 0)
 		goto free_modinfo;
 
@@ -2938,7 +2993,9 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	ftrace_module_init(mod);
 
 	/* Finally it's fully formed, ready to start executing. */
+	start = mod_stat_clock();
 	err = complete_formation(mod, info);
+	mod_stat_phase(info, MOD_LOAD_FORMATION, start);
 	if (err)
 		goto ddebug_cleanup;
 
@@ -2971,6 +3028,8 @@ static int load_module(struct load_info *info, const char __user *uargs,
 			goto sysfs_cleanup;
 	}
 
+	mod_stat_add_load_times(mod, info);
+
 	/* Get rid of temporary copy. */
 	free_copy(info, flags);
 
@@ -3009,6 +3068,7 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	/* Unlink carefully: kallsyms could be walking list. */
 	list_del_rcu(&mod->list);
 	mod_tree_remove(mod);
+	module_kallsyms_changed();
 	wake_up_all(&module_wq);
 	/* Wait for RCU-sched synchronizing before releasing mod->list. */
 	synchronize_rcu();
@@ -3061,6 +3121,7 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 {
 	struct load_info info = { };
 	void *buf = NULL;
+	u64 start;
 	int len;
 	int err;
 
@@ -3084,7 +3145,9 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 	}
 
 	if (flags & MODULE_INIT_COMPRESSED_FILE) {
+		start = mod_stat_clock();
 		err = module_decompress(&info, buf, len);
+		mod_stat_phase(&info, MOD_LOAD_DECOMPRESS, start);
 		vfree(buf); /* compressed data is no longer needed */
 		if (err) {
 			mod_stat_inc(&failed_decompress);
@@ -14,6 +14,7 @@
 #include <linux/debugfs.h>
 #include <linux/rculist.h>
 #include <linux/math.h>
+#include <linux/seq_file.h>
 
 #include "internal.h"
 
@@ -99,6 +100,126 @@
  */
 static LIST_HEAD(dup_failed_modules);
 
+/**
+ * DOC: module load phase timings
+ *
+ * For each module loaded, the debugfs file load_times shows how long the
+ * last load of it spent in each phase, in microseconds:
+ *
+ *   * decompress: module_decompress(), for MODULE_INIT_COMPRESSED_FILE
+ *   * layout: layout_and_allocate()
+ *   * symbols: simplify_symbols(), resolving the symbols the module imports
+ *   * relocs: apply_relocations()
+ *   * formation: complete_formation(), including the wait for module_mutex
+ *   * init: the module's constructors and init function
+ *
+ * Modules load in parallel, so the sum over all modules can well exceed
+ * the time it took to load them.
+ */
+struct mod_load_times {
+	struct list_head list;
+	char name[MODULE_NAME_LEN];
+	u64 phase_ns[MOD_LOAD_PHASES];
+};
+
+static LIST_HEAD(mod_load_times_list);
+static DEFINE_MUTEX(mod_load_times_lock);
+
+static const char * const mod_load_phase_names[MOD_LOAD_PHASES] = {
+	[MOD_LOAD_DECOMPRESS]	= "decompress",
+	[MOD_LOAD_LAYOUT]	= "layout",
+	[MOD_LOAD_SYMBOLS]	= "symbols",
+	[MOD_LOAD_RELOCS]	= "relocs",
+	[MOD_LOAD_FORMATION]	= "formation",
+	[MOD_LOAD_INIT]		= "init",
+};
+
+static struct mod_load_times *mod_load_times_find(const char *name)
+{
+	struct mod_load_times *t;
+
+	list_for_each_entry(t, &mod_load_times_list, list) {
+		if (!strcmp(t->name, name))
+			return t;
+	}
+
+	return NULL;
+}
+
+void mod_stat_add_load_times(struct module *mod, struct load_info *info)
+{
+	struct mod_load_times *t;
+
+	mutex_lock(&mod_load_times_lock);
+	t = mod_load_times_find(mod->name);
+	if (!t) {
+		t = kmalloc(sizeof(*t), GFP_KERNEL);
+		if (!t)
+			goto out;
+		strscpy(t->name, mod->name, MODULE_NAME_LEN);
+		list_add_tail(&t->list, &mod_load_times_list);
+	}
+	memcpy(t->phase_ns, info->phase_ns, sizeof(t->phase_ns));
+out:
+	mutex_unlock(&mod_load_times_lock);
+}
+
+void mod_stat_init_time(struct module *mod, u64 ns)
+{
+	struct mod_load_times *t;
+
+	mutex_lock(&mod_load_times_lock);
+	t = mod_load_times_find(mod->name);
+	if (t)
+		t->phase_ns[MOD_LOAD_INIT] = ns;
+	mutex_unlock(&mod_load_times_lock);
+}
+
+static void *mod_load_times_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&mod_load_times_lock);
+	return seq_list_start_head(&mod_load_times_list, *pos);
+}
+
+static void *mod_load_times_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &mod_load_times_list, pos);
+}
+
+static void mod_load_times_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&mod_load_times_lock);
+}
+
+static int mod_load_times_show(struct seq_file *m, void *v)
+{
+	struct mod_load_times *t;
+	int i;
+
+	if (v == &mod_load_times_list) {
+		seq_printf(m, "%-25s", "Module-name");
+		for (i = 0; i < MOD_LOAD_PHASES; i++)
+			seq_printf(m, "\t%10s", mod_load_phase_names[i]);
+		seq_putc(m, '\n');
+		return 0;
+	}
+
+	t = list_entry(v, struct mod_load_times, list);
+	seq_printf(m, "%-25s", t->name);
+	for (i = 0; i < MOD_LOAD_PHASES; i++)
+		seq_printf(m, "\t%10llu", div_u64(t->phase_ns[i], NSEC_PER_USEC));
+	seq_putc(m, '\n');
+	return 0;
+}
+
+static const struct seq_operations mod_load_times_sops = {
+	.start	= mod_load_times_start,
+	.next	= mod_load_times_next,
+	.stop	= mod_load_times_stop,
+	.show	= mod_load_times_show,
+};
+DEFINE_SEQ_ATTRIBUTE(mod_load_times);
+
 /**
  * DOC: module statistics debugfs counters
  *
@@ -424,6 +545,8 @@ static int __init module_stats_init(void)
 	mod_debug_add_atomic(failed_load_modules);
 
 	debugfs_create_file("stats", 0400, mod_debugfs_root, mod_debugfs_root, &fops_mod_stats);
+	debugfs_create_file("load_times", 0400, mod_debugfs_root, NULL,
+			    &mod_load_times_fops);
 
 	return 0;
 }
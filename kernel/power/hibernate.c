@@ -31,6 +31,8 @@
 #include <linux/ktime.h>
 #include <linux/security.h>
 #include <linux/secretmem.h>
+#include <linux/moduleparam.h>
+#include <linux/crypto.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -68,6 +70,81 @@ bool snapshot_test;
 
 static const struct platform_hibernation_ops *hibernation_ops;
 
+/* Image compressors, the header flags tell the resuming kernel which one. */
+static const struct hib_comp_algo {
+	const char *name;
+	unsigned int flag;
+} hib_comp_algos[] = {
+	{ "lzo",	0 },
+	{ "lz4",	SF_COMPRESSION_ALG_LZ4 },
+	{ "zstd",	SF_COMPRESSION_ALG_ZSTD },
+};
+
+static const struct hib_comp_algo *hib_comp_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hib_comp_algos); i++)
+		if (sysfs_streq(name, hib_comp_algos[i].name))
+			return &hib_comp_algos[i];
+
+	return NULL;
+}
+
+static const struct hib_comp_algo *hib_comp;
+
+/* Image header flags for the compressor of the next image. */
+unsigned int hib_comp_flags(void)
+{
+	const struct hib_comp_algo *algo = READ_ONCE(hib_comp);
+
+	if (!algo)
+		algo = hib_comp_lookup(CONFIG_HIBERNATION_DEF_COMP);
+
+	return algo ? algo->flag : 0;
+}
+
+/* Name of the compressor recorded in @flags, NULL if it is unknown. */
+const char *hib_comp_name(unsigned int flags)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hib_comp_algos); i++)
+		if (hib_comp_algos[i].flag == (flags & SF_COMPRESSION_ALG_MASK))
+			return hib_comp_algos[i].name;
+
+	return NULL;
+}
+
+/*
+ * The crypto algorithms are not registered yet when the command line is
+ * parsed, so only the name is checked here. hibernate() checks that the
+ * compressor is available before the image is created.
+ */
+static int hib_comp_set(const char *val, const struct kernel_param *kp)
+{
+	const struct hib_comp_algo *algo = hib_comp_lookup(val);
+
+	if (!algo)
+		return -EINVAL;
+
+	WRITE_ONCE(hib_comp, algo);
+	return 0;
+}
+
+static int hib_comp_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%s\n", hib_comp_name(hib_comp_flags()));
+}
+
+static const struct kernel_param_ops hib_comp_ops = {
+	.set	= hib_comp_set,
+	.get	= hib_comp_get,
+};
+
+module_param_cb(compressor, &hib_comp_ops, NULL, 0644);
+MODULE_PARM_DESC(compressor, "Compression algorithm of hibernation images: lzo, lz4 or zstd");
+
 static atomic_t hibernate_atomic = ATOMIC_INIT(1);
 
 bool hibernate_acquire(void)
@@ -729,6 +806,15 @@ int hibernate(void)
 		return -EPERM;
 	}
 
+	if (!nocompress) {
+		const char *comp = hib_comp_name(hib_comp_flags());
+
+		if (!crypto_has_comp(comp, 0, 0)) {
+			pr_err("%s compression is not available\n", comp);
+			return -EOPNOTSUPP;
+		}
+	}
+
 	sleep_flags = lock_system_sleep();
 	/* The snapshot device should not be opened while we're running */
 	if (!hibernate_acquire()) {
@@ -769,7 +855,7 @@ int hibernate(void)
 		if (nocompress)
 			flags |= SF_NOCOMPRESS_MODE;
 		else
-		        flags |= SF_CRC32_MODE;
+		        flags |= SF_CRC32_MODE | hib_comp_flags();
 
 		pm_pr_dbg("Writing hibernation image.\n");
 		error = swsusp_write(flags);
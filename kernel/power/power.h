@@ -173,12 +173,20 @@ extern int swsusp_swap_in_use(void);
 #define SF_CRC32_MODE	        4
 #define SF_HW_SIG		8
 
+/* Compressor of the image, LZO if none of these is set. */
+#define SF_COMPRESSION_ALG_LZ4	16
+#define SF_COMPRESSION_ALG_ZSTD	32
+#define SF_COMPRESSION_ALG_MASK	(SF_COMPRESSION_ALG_LZ4 | \
+				 SF_COMPRESSION_ALG_ZSTD)
+
 /* kernel/power/hibernate.c */
 extern int swsusp_check(void);
 extern void swsusp_free(void);
 extern int swsusp_read(unsigned int *flags_p);
 extern int swsusp_write(unsigned int flags);
 extern void swsusp_close(fmode_t);
+extern unsigned int hib_comp_flags(void);
+extern const char *hib_comp_name(unsigned int flags);
 #ifdef CONFIG_SUSPEND
 extern int swsusp_unmark(void);
 #endif
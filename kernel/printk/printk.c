@@ -49,6 +49,7 @@
 #include <linux/sched/task_stack.h>
 
 #include <linux/uaccess.h>
+#include <uapi/linux/kmsg.h>
 #include <asm/sections.h>
 
 #include <trace/events/initcall.h>
@@ -706,6 +707,7 @@ struct devkmsg_user {
 	atomic64_t seq;
 	struct ratelimit_state rs;
 	struct mutex lock;
+	unsigned int format;
 	struct printk_buffers pbufs;
 };
 
@@ -784,6 +786,94 @@ static ssize_t devkmsg_write(struct kiocb *iocb, struct iov_iter *from)
 	return ret;
 }
 
+/*
+ * Copy one record in the KMSG_FORMAT_BINARY layout to @buf, the text
+ * straight from the ringbuffer. Returns the size of the record, 0 if it
+ * got recycled while being copied or -EINVAL if it does not fit.
+ */
+static ssize_t devkmsg_copy_record(char __user *buf, size_t count,
+				   struct printk_record_view *v)
+{
+	struct dev_printk_info *dev_info = &v->info.dev_info;
+	struct kmsg_record rec = {
+		.text_len	= v->text_len,
+		.subsystem_len	= strnlen(dev_info->subsystem,
+					  sizeof(dev_info->subsystem)),
+		.device_len	= strnlen(dev_info->device,
+					  sizeof(dev_info->device)),
+		.seq		= v->info.seq,
+		.ts_nsec	= v->info.ts_nsec,
+		.caller_id	= v->info.caller_id,
+		.facility	= v->info.facility,
+		.level		= v->info.level,
+		.flags		= v->info.flags & LOG_CONT ? KMSG_RECORD_CONT : 0,
+	};
+	size_t len = sizeof(rec);
+
+	rec.size = ALIGN(len + rec.text_len + rec.subsystem_len +
+			 rec.device_len, 8);
+	if (rec.size > count)
+		return -EINVAL;
+
+	if (copy_to_user(buf, &rec, sizeof(rec)) ||
+	    copy_to_user(buf + len, v->text, rec.text_len))
+		return -EFAULT;
+
+	if (!prb_read_view_done(prb, v))
+		return 0;
+
+	len += rec.text_len;
+	if (copy_to_user(buf + len, dev_info->subsystem, rec.subsystem_len))
+		return -EFAULT;
+	len += rec.subsystem_len;
+	if (copy_to_user(buf + len, dev_info->device, rec.device_len))
+		return -EFAULT;
+	len += rec.device_len;
+	if (clear_user(buf + len, rec.size - len))
+		return -EFAULT;
+
+	return rec.size;
+}
+
+/*
+ * KMSG_FORMAT_BINARY read: as many records as fit into @buf, without
+ * formatting and without an intermediate copy of the text.
+ */
+static ssize_t devkmsg_read_binary(struct file *file, char __user *buf,
+				   size_t count)
+{
+	struct devkmsg_user *user = file->private_data;
+	struct printk_record_view v;
+	ssize_t ret, len = 0;
+	u64 seq;
+
+	seq = atomic64_read(&user->seq);
+	if (!prb_read_view(prb, seq, &v)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		/* See devkmsg_read() for the pairing. */
+		ret = wait_event_interruptible(log_wait,
+				prb_read_view(prb, seq, &v));
+		if (ret)
+			return ret;
+	}
+
+	do {
+		ret = devkmsg_copy_record(buf + len, count - len, &v);
+		if (ret < 0)
+			break;
+
+		len += ret;
+		seq = v.info.seq + 1;
+	} while (prb_read_view(prb, seq, &v));
+
+	atomic64_set(&user->seq, seq);
+
+	/* A partial read is a success, only fail if nothing was copied. */
+	return len ? len : ret;
+}
+
 static ssize_t devkmsg_read(struct file *file, char __user *buf,
 			    size_t count, loff_t *ppos)
 {
@@ -798,6 +888,11 @@ static ssize_t devkmsg_read(struct file *file, char __user *buf,
 	if (ret)
 		return ret;
 
+	if (user->format == KMSG_FORMAT_BINARY) {
+		ret = devkmsg_read_binary(file, buf, count);
+		goto out;
+	}
+
 	if (!printk_get_next_message(&pmsg, atomic64_read(&user->seq), true, false)) {
 		if (file->f_flags & O_NONBLOCK) {
 			ret = -EAGAIN;
@@ -884,6 +979,25 @@ static loff_t devkmsg_llseek(struct file *file, loff_t offset, int whence)
 	return ret;
 }
 
+static long devkmsg_ioctl(struct file *file, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct devkmsg_user *user = file->private_data;
+
+	switch (cmd) {
+	case KMSG_IOC_SET_FORMAT:
+		if (arg != KMSG_FORMAT_TEXT && arg != KMSG_FORMAT_BINARY)
+			return -EINVAL;
+
+		mutex_lock(&user->lock);
+		user->format = arg;
+		mutex_unlock(&user->lock);
+		return 0;
+	}
+
+	return -ENOTTY;
+}
+
 static __poll_t devkmsg_poll(struct file *file, poll_table *wait)
 {
 	struct devkmsg_user *user = file->private_data;
@@ -927,6 +1041,7 @@ static int devkmsg_open(struct inode *inode, struct file *file)
 	ratelimit_set_flags(&user->rs, RATELIMIT_MSG_ON_RELEASE);
 
 	mutex_init(&user->lock);
+	user->format = KMSG_FORMAT_TEXT;
 
 	atomic64_set(&user->seq, prb_first_valid_seq(prb));
 
@@ -950,6 +1065,8 @@ const struct file_operations kmsg_fops = {
 	.read = devkmsg_read,
 	.write_iter = devkmsg_write,
 	.llseek = devkmsg_llseek,
+	.unlocked_ioctl = devkmsg_ioctl,
+	.compat_ioctl = devkmsg_ioctl,
 	.poll = devkmsg_poll,
 	.release = devkmsg_release,
 };
@@ -1974,6 +1974,102 @@ bool prb_read_valid_info(struct printk_ringbuffer *rb, u64 seq,
 	return _prb_read_valid(rb, &seq, &r, line_count);
 }
 
+/*
+ * Like prb_read() but instead of copying the text data, point @v at it in
+ * the text data ring.
+ */
+static int prb_read_view_seq(struct printk_ringbuffer *rb, u64 seq,
+			     struct printk_record_view *v)
+{
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	struct printk_info *info = to_info(desc_ring, seq);
+	struct prb_desc *rdesc = to_desc(desc_ring, seq);
+	struct prb_desc desc;
+	unsigned int data_size;
+	const char *data;
+	unsigned long id;
+	int err;
+
+	id = DESC_ID(atomic_long_read(&rdesc->state_var));
+
+	err = desc_read_finalized_seq(desc_ring, id, seq, &desc);
+	if (err)
+		return err;
+
+	memcpy(&v->info, info, sizeof(v->info));
+
+	data = get_data(&rb->text_data_ring, &desc.text_blk_lpos, &data_size);
+	if (!data || data_size < v->info.text_len)
+		return -ENOENT;
+
+	v->text = data;
+	v->text_len = v->info.text_len;
+	v->id = id;
+
+	/* Ensure @info and the text position belong to @seq. */
+	return desc_read_finalized_seq(desc_ring, id, seq, &desc);
+}
+
+/**
+ * prb_read_view() - Non-blocking zero-copy read of a requested record or
+ *                   (if gone) the next available record.
+ *
+ * @rb:  The ringbuffer to read from.
+ * @seq: The sequence number of the record to read.
+ * @v:   A view to describe the record in.
+ *
+ * Unlike prb_read_valid() the text is not copied out: @v->text points to
+ * it within the ringbuffer, where a writer may recycle it at any time. A
+ * reader copies it to wherever it is needed and then calls
+ * prb_read_view_done() to learn whether the copy can be trusted.
+ *
+ * Context: Any context.
+ * Return: true if a record was found, otherwise false.
+ *
+ * On success, the reader must check v->info.seq to see which record was
+ * actually read. Failure means @seq refers to a not yet written record.
+ */
+bool prb_read_view(struct printk_ringbuffer *rb, u64 seq,
+		   struct printk_record_view *v)
+{
+	u64 tail_seq;
+	int err;
+
+	/* See _prb_read_valid() for the error handling. */
+	while ((err = prb_read_view_seq(rb, seq, v))) {
+		tail_seq = prb_first_seq(rb);
+
+		if (seq < tail_seq)
+			seq = tail_seq;
+		else if (err == -ENOENT)
+			seq++;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * prb_read_view_done() - Check a record read by prb_read_view().
+ *
+ * @rb: The ringbuffer the record was read from.
+ * @v:  The view filled in by prb_read_view().
+ *
+ * Context: Any context.
+ * Return: true if the text of @v was not recycled before this call, so
+ *         that anything read from @v->text before is valid.
+ */
+bool prb_read_view_done(struct printk_ringbuffer *rb,
+			struct printk_record_view *v)
+{
+	struct prb_desc desc;
+
+	/* desc_read:D orders the reader's text loads before the check. */
+	return !desc_read_finalized_seq(&rb->desc_ring, v->id, v->info.seq,
+					&desc);
+}
+
 /**
  * prb_first_valid_seq() - Get the sequence number of the oldest available
  *                         record.
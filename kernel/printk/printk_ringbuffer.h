@@ -44,6 +44,20 @@ struct printk_record {
 	unsigned int		text_buf_size;
 };
 
+/*
+ * A record as seen by a zero-copy reader, see prb_read_view().
+ *
+ * @info is a copy of the meta data. @text points into the ringbuffer and
+ * only is known to have been valid once prb_read_view_done() confirmed it.
+ * @id is private to the ringbuffer code.
+ */
+struct printk_record_view {
+	struct printk_info	info;
+	const char		*text;
+	unsigned int		text_len;
+	unsigned long		id;
+};
+
 /* Specifies the logical position and span of a data block. */
 struct prb_data_blk_lpos {
 	unsigned long	begin;
@@ -377,6 +391,10 @@ bool prb_read_valid(struct printk_ringbuffer *rb, u64 seq,
 		    struct printk_record *r);
 bool prb_read_valid_info(struct printk_ringbuffer *rb, u64 seq,
 			 struct printk_info *info, unsigned int *line_count);
+bool prb_read_view(struct printk_ringbuffer *rb, u64 seq,
+		   struct printk_record_view *v);
+bool prb_read_view_done(struct printk_ringbuffer *rb,
+			struct printk_record_view *v);
 
 u64 prb_first_valid_seq(struct printk_ringbuffer *rb);
 u64 prb_next_seq(struct printk_ringbuffer *rb);
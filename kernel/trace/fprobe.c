@@ -348,6 +348,75 @@ int register_fprobe_syms(struct fprobe *fp, const char **syms, int num)
 }
 EXPORT_SYMBOL_GPL(register_fprobe_syms);
 
+/**
+ * register_fprobes_ips() - Register several fprobes to ftrace by address.
+ * @fps: An array of fprobe data structures to be registered.
+ * @addrs: An array of @cnt arrays of target ftrace location addresses.
+ * @nums: The number of entries of each array in @addrs.
+ * @cnt: The number of fprobes in @fps.
+ *
+ * Does the same as register_fprobe_ips() on each of @fps, with @fps[i]
+ * probing the @nums[i] addresses in @addrs[i], but the ftrace records
+ * for all of them are updated in a single code patching pass. Use this
+ * rather than a loop of register_fprobe_ips() when attaching many fprobes
+ * at once.
+ *
+ * Either all of @fps are registered or none of them is. They are
+ * unregistered one at a time with unregister_fprobe().
+ *
+ * Return 0 if @fps are registered successfully, -errno if not.
+ */
+int register_fprobes_ips(struct fprobe **fps, unsigned long **addrs,
+			 int *nums, int cnt)
+{
+	struct ftrace_ops **ops;
+	int nr_ready = 0;
+	int ret = 0;
+	int i;
+
+	if (!fps || !addrs || !nums || cnt <= 0)
+		return -EINVAL;
+
+	ops = kcalloc(cnt, sizeof(*ops), GFP_KERNEL);
+	if (!ops)
+		return -ENOMEM;
+
+	for (i = 0; i < cnt; i++) {
+		if (!fps[i] || !addrs[i] || nums[i] <= 0) {
+			ret = -EINVAL;
+			break;
+		}
+
+		fprobe_init(fps[i]);
+
+		ret = ftrace_set_filter_ips(&fps[i]->ops, addrs[i], nums[i], 0, 0);
+		if (ret)
+			break;
+
+		ret = fprobe_init_rethook(fps[i], nums[i]);
+		if (ret) {
+			/* Like register_fprobe_ips(), undo this one in place */
+			fprobe_fail_cleanup(fps[i]);
+			break;
+		}
+		ops[i] = &fps[i]->ops;
+		nr_ready++;
+	}
+
+	if (!ret)
+		ret = register_ftrace_functions(ops, cnt);
+
+	/* On failure none of @fps is registered, only their setup is left */
+	if (ret) {
+		for (i = nr_ready - 1; i >= 0; i--)
+			fprobe_fail_cleanup(fps[i]);
+	}
+
+	kfree(ops);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_fprobes_ips);
+
 /**
  * unregister_fprobe() - Unregister fprobe from ftrace
  * @fp: A fprobe data structure to be unregistered.
@@ -3043,7 +3043,14 @@ static void ftrace_startup_all(int command)
 	update_all_ops = false;
 }
 
-int ftrace_startup(struct ftrace_ops *ops, int command)
+/*
+ * First half of ftrace_startup(): add @ops to the list and account its
+ * functions in the records, without touching the code yet. What needs
+ * updating is or'ed into @command. On success @ops is left with
+ * FTRACE_OPS_FL_ADDING set, which ftrace_startup_finish() clears once the
+ * code has been updated.
+ */
+static int ftrace_startup_prepare(struct ftrace_ops *ops, int *command)
 {
 	int ret;
 
@@ -3078,10 +3085,13 @@ int ftrace_startup(struct ftrace_ops *ops, int command)
 	}
 
 	if (ftrace_hash_rec_enable(ops, 1))
-		command |= FTRACE_UPDATE_CALLS;
+		*command |= FTRACE_UPDATE_CALLS;
 
-	ftrace_startup_enable(command);
+	return 0;
+}
 
+static int ftrace_startup_finish(struct ftrace_ops *ops)
+{
 	/*
 	 * If ftrace is in an undefined state, we just remove ops from list
 	 * to prevent the NULL pointer, instead of totally rolling it back and
@@ -3097,6 +3107,19 @@ int ftrace_startup(struct ftrace_ops *ops, int command)
 	return 0;
 }
 
+int ftrace_startup(struct ftrace_ops *ops, int command)
+{
+	int ret;
+
+	ret = ftrace_startup_prepare(ops, &command);
+	if (ret)
+		return ret;
+
+	ftrace_startup_enable(command);
+
+	return ftrace_startup_finish(ops);
+}
+
 int ftrace_shutdown(struct ftrace_ops *ops, int command)
 {
 	int ret;
@@ -7257,6 +7280,17 @@ core_initcall(ftrace_nodyn_init);
 
 static inline int ftrace_init_dyn_tracefs(struct dentry *d_tracer) { return 0; }
 static inline void ftrace_startup_all(int command) { }
+static inline void ftrace_startup_enable(int command) { }
+
+static inline int ftrace_startup_prepare(struct ftrace_ops *ops, int *command)
+{
+	return ftrace_startup(ops, 0);
+}
+
+static inline int ftrace_startup_finish(struct ftrace_ops *ops)
+{
+	return 0;
+}
 
 static void ftrace_update_trampoline(struct ftrace_ops *ops)
 {
@@ -8015,6 +8049,98 @@ int register_ftrace_function(struct ftrace_ops *ops)
 }
 EXPORT_SYMBOL_GPL(register_ftrace_function);
 
+/**
+ * register_ftrace_functions - register several functions for profiling at once
+ * @ops:	array of ops structures to register
+ * @cnt:	number of entries in @ops
+ *
+ * Does the same as calling register_ftrace_function() on each of @ops,
+ * but the records of all of them are accounted first and the code is
+ * then updated in a single pass, instead of one pass (and, on most
+ * architectures, one stop_machine()) per ops. Attaching to a large
+ * number of functions through many ops is a lot cheaper this way.
+ *
+ * Either all of @ops are registered or, on failure, none of them is.
+ * They are unregistered one at a time with unregister_ftrace_function().
+ *
+ * Returns:
+ *         0 on success;
+ *         Negative on failure.
+ */
+int register_ftrace_functions(struct ftrace_ops **ops, int cnt)
+{
+	int nr_prepared = 0, nr_started = 0;
+	int command = 0;
+	u64 start;
+	int ret = 0;
+	int i;
+
+	if (cnt <= 0)
+		return -EINVAL;
+
+	start = ftrace_now(raw_smp_processor_id());
+
+	lock_direct_mutex();
+	for (i = 0; i < cnt; i++) {
+		/* An ops whose preparation failed has nothing to clean up */
+		ret = prepare_direct_functions_for_ipmodify(ops[i]);
+		if (ret < 0)
+			goto out_unlock;
+		ftrace_ops_init(ops[i]);
+		nr_prepared++;
+	}
+
+	mutex_lock(&ftrace_lock);
+
+	for (i = 0; i < cnt; i++) {
+		ret = ftrace_startup_prepare(ops[i], &command);
+		if (ret)
+			break;
+		nr_started++;
+	}
+
+	if (ret) {
+		/*
+		 * Nothing has been patched for the ops started so far,
+		 * but they are on the ops list already and may have been
+		 * called through the list function. Take them out the
+		 * regular way, which also synchronizes with those callers.
+		 */
+		for (i = nr_started - 1; i >= 0; i--) {
+			ftrace_shutdown(ops[i], 0);
+			ops[i]->flags &= ~FTRACE_OPS_FL_ADDING;
+		}
+		mutex_unlock(&ftrace_lock);
+		goto out_unlock;
+	}
+
+	ftrace_startup_enable(command);
+
+	for (i = 0; i < cnt; i++) {
+		int err = ftrace_startup_finish(ops[i]);
+
+		if (err)
+			ret = err;
+	}
+
+	mutex_unlock(&ftrace_lock);
+
+	pr_debug("ftrace: registered %d ops in %llu us\n",
+		 cnt, div_u64(ftrace_now(raw_smp_processor_id()) - start,
+				  NSEC_PER_USEC));
+
+out_unlock:
+	unlock_direct_mutex();
+
+	if (ret < 0) {
+		/* Undo the preparation of every ops that went through it */
+		for (i = nr_prepared - 1; i >= 0; i--)
+			cleanup_direct_functions_after_ipmodify(ops[i]);
+	}
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_ftrace_functions);
+
 /**
  * unregister_ftrace_function - unregister a function for profiling.
  * @ops:	ops structure that holds the function to unregister
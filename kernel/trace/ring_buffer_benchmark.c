@@ -6,10 +6,14 @@
  */
 #include <linux/ring_buffer.h>
 #include <linux/completion.h>
+#include <linux/sched/clock.h>
+#include <linux/irq_work.h>
 #include <linux/kthread.h>
 #include <uapi/linux/sched/types.h>
 #include <linux/module.h>
+#include <linux/random.h>
 #include <linux/ktime.h>
+#include <linux/slab.h>
 #include <asm/local.h>
 
 struct rb_page {
@@ -60,6 +64,22 @@ MODULE_PARM_DESC(producer_fifo, "use fifo for producer: 0 - disabled, 1 - low pr
 module_param(consumer_fifo, int, 0644);
 MODULE_PARM_DESC(consumer_fifo, "use fifo for consumer: 0 - disabled, 1 - low prio, 2 - fifo");
 
+static bool stress;
+module_param(stress, bool, 0444);
+MODULE_PARM_DESC(stress, "run a producer per CPU and several readers instead");
+
+static unsigned int stress_readers = 2;
+module_param(stress_readers, uint, 0644);
+MODULE_PARM_DESC(stress_readers, "# of concurrent readers in stress mode");
+
+static unsigned int stress_max_size = 128;
+module_param(stress_max_size, uint, 0644);
+MODULE_PARM_DESC(stress_max_size, "max random payload added to events in stress mode");
+
+static unsigned int stress_nest = 16;
+module_param(stress_nest, uint, 0644);
+MODULE_PARM_DESC(stress_nest, "write from an interrupt inside 1 in N reservations in stress mode (0 - never)");
+
 static int read_events;
 
 static int test_error;
@@ -368,6 +388,350 @@ static void ring_buffer_producer(void)
 	}
 }
 
+/*
+ * Stress mode: a producer thread on every CPU writes events of random
+ * sizes, and every so often raises an interrupt on its own CPU while it
+ * holds a reservation, so that the interrupt writes a nested event. At
+ * the same time, several readers consume all the per CPU buffers, like
+ * concurrent trace_pipe readers would.
+ */
+struct rb_stress_entry {
+	int			cpu;
+	unsigned int		size;
+};
+
+/*
+ * Reserve latencies are kept in log-linear buckets: 8 buckets per power
+ * of two, up to 4 seconds.
+ */
+#define RB_LAT_SUB_BITS		3
+#define RB_LAT_SUB		(1 << RB_LAT_SUB_BITS)
+#define RB_LAT_MAX_SHIFT	32
+#define RB_LAT_BUCKETS		((RB_LAT_MAX_SHIFT - RB_LAT_SUB_BITS + 1) * RB_LAT_SUB)
+
+struct rb_stress_cpu {
+	struct task_struct	*thread;
+	struct irq_work		irq_work;
+	/* updated by the producer thread */
+	unsigned long		hit;
+	unsigned long		missed;
+	u64			lat_max;
+	unsigned long		lat[RB_LAT_BUCKETS];
+	/* updated by the interrupt */
+	unsigned long		nested_hit;
+	unsigned long		nested_missed;
+};
+
+static DEFINE_PER_CPU(struct rb_stress_cpu, rb_stress_cpu);
+
+struct rb_stress_reader {
+	struct task_struct	*thread;
+	unsigned long		read;
+	unsigned long		lost;
+};
+
+static unsigned int rb_lat_bucket(u64 ns)
+{
+	unsigned int shift;
+
+	if (ns < RB_LAT_SUB)
+		return ns;
+
+	shift = fls64(ns) - 1;
+	if (shift >= RB_LAT_MAX_SHIFT)
+		return RB_LAT_BUCKETS - 1;
+
+	return (shift - RB_LAT_SUB_BITS + 1) * RB_LAT_SUB +
+		((ns >> (shift - RB_LAT_SUB_BITS)) & (RB_LAT_SUB - 1));
+}
+
+/* The largest latency that falls in a bucket */
+static u64 rb_lat_bucket_max(unsigned int bucket)
+{
+	unsigned int shift;
+	u64 sub;
+
+	if (bucket < RB_LAT_SUB)
+		return bucket;
+
+	shift = bucket / RB_LAT_SUB + RB_LAT_SUB_BITS - 1;
+	sub = bucket % RB_LAT_SUB;
+
+	return ((RB_LAT_SUB + sub + 1) << (shift - RB_LAT_SUB_BITS)) - 1;
+}
+
+static u64 rb_lat_percentile(unsigned long *lat, unsigned long total,
+			     unsigned int permille)
+{
+	unsigned long target, sum = 0;
+	unsigned int i;
+
+	target = DIV_ROUND_UP_ULL((u64)total * permille, 1000);
+
+	for (i = 0; i < RB_LAT_BUCKETS; i++) {
+		sum += lat[i];
+		if (sum >= target)
+			return rb_lat_bucket_max(i);
+	}
+
+	return rb_lat_bucket_max(RB_LAT_BUCKETS - 1);
+}
+
+static void rb_stress_write(struct rb_stress_cpu *c, bool nested)
+{
+	struct ring_buffer_event *event;
+	struct rb_stress_entry *entry;
+	unsigned int len;
+	u64 start, delta;
+
+	len = sizeof(*entry) + get_random_u32_below(stress_max_size + 1);
+
+	start = local_clock();
+	event = ring_buffer_lock_reserve(buffer, len);
+	delta = local_clock() - start;
+
+	if (!event) {
+		if (nested)
+			c->nested_missed++;
+		else
+			c->missed++;
+		return;
+	}
+
+	entry = ring_buffer_event_data(event);
+	entry->cpu = raw_smp_processor_id();
+	entry->size = len;
+
+	if (nested) {
+		c->nested_hit++;
+	} else {
+		c->hit++;
+		c->lat[rb_lat_bucket(delta)]++;
+		if (delta > c->lat_max)
+			c->lat_max = delta;
+
+		/* Have an interrupt write while this event is reserved */
+		if (stress_nest && !get_random_u32_below(stress_nest))
+			irq_work_queue(&c->irq_work);
+	}
+
+	ring_buffer_unlock_commit(buffer);
+}
+
+static void rb_stress_irq(struct irq_work *work)
+{
+	struct rb_stress_cpu *c = container_of(work, struct rb_stress_cpu, irq_work);
+
+	rb_stress_write(c, true);
+}
+
+static int rb_stress_producer(void *arg)
+{
+	struct rb_stress_cpu *c = arg;
+	int i;
+
+	while (!kthread_should_stop()) {
+		if (test_error) {
+			schedule_timeout_interruptible(HZ);
+			continue;
+		}
+
+		for (i = 0; i < write_iteration; i++)
+			rb_stress_write(c, false);
+
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int rb_stress_consumer(void *arg)
+{
+	struct rb_stress_reader *r = arg;
+	struct ring_buffer_event *event;
+	struct rb_stress_entry *entry;
+	unsigned long lost;
+	bool found;
+	int cpu;
+
+	while (!kthread_should_stop()) {
+		found = false;
+
+		for_each_online_cpu(cpu) {
+			if (test_error)
+				break;
+
+			event = ring_buffer_consume(buffer, cpu, NULL, &lost);
+			if (!event)
+				continue;
+
+			found = true;
+			r->lost += lost;
+			r->read++;
+
+			entry = ring_buffer_event_data(event);
+			if (entry->cpu != cpu ||
+			    ring_buffer_event_length(event) < entry->size)
+				TEST_ERROR();
+		}
+
+		if (!found)
+			schedule_timeout_interruptible(1);
+		else
+			cond_resched();
+	}
+
+	return 0;
+}
+
+static void rb_stress_set_prio(struct task_struct *p, int fifo, int nice)
+{
+	if (fifo >= 2)
+		sched_set_fifo(p);
+	else if (fifo == 1)
+		sched_set_fifo_low(p);
+	else
+		set_user_nice(p, nice);
+}
+
+static void ring_buffer_stress(void)
+{
+	unsigned long hit = 0, missed = 0, nested_hit = 0, nested_missed = 0;
+	unsigned long read = 0, lost = 0;
+	struct rb_stress_reader *readers;
+	unsigned long long events, time;
+	ktime_t start_time, end_time;
+	unsigned long *lat;
+	u64 lat_max = 0;
+	int nr_producers = 0;
+	int cpu, i, b;
+
+	readers = kcalloc(stress_readers, sizeof(*readers), GFP_KERNEL);
+	lat = kcalloc(RB_LAT_BUCKETS, sizeof(*lat), GFP_KERNEL);
+	if (!readers || !lat) {
+		TEST_ERROR();
+		goto out_free;
+	}
+
+	trace_printk("Starting ring buffer stress\n");
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		struct rb_stress_cpu *c = per_cpu_ptr(&rb_stress_cpu, cpu);
+		struct task_struct *t;
+
+		memset(c, 0, sizeof(*c));
+		c->irq_work = IRQ_WORK_INIT_HARD(rb_stress_irq);
+
+		t = kthread_create_on_cpu(rb_stress_producer, c, cpu, "rb_producer/%u");
+		if (IS_ERR(t)) {
+			TEST_ERROR();
+			continue;
+		}
+		rb_stress_set_prio(t, producer_fifo, producer_nice);
+		c->thread = t;
+		nr_producers++;
+	}
+	cpus_read_unlock();
+
+	for (i = 0; i < stress_readers; i++) {
+		struct task_struct *t;
+
+		t = kthread_create(rb_stress_consumer, &readers[i], "rb_consumer/%d", i);
+		if (IS_ERR(t)) {
+			TEST_ERROR();
+			continue;
+		}
+		rb_stress_set_prio(t, consumer_fifo, consumer_nice);
+		readers[i].thread = t;
+	}
+
+	start_time = ktime_get();
+
+	for_each_possible_cpu(cpu) {
+		struct rb_stress_cpu *c = per_cpu_ptr(&rb_stress_cpu, cpu);
+
+		if (c->thread)
+			wake_up_process(c->thread);
+	}
+	for (i = 0; i < stress_readers; i++) {
+		if (readers[i].thread)
+			wake_up_process(readers[i].thread);
+	}
+
+	do {
+		schedule_timeout_interruptible(HZ);
+		end_time = ktime_get();
+	} while (ktime_us_delta(end_time, start_time) < RUN_TIME * USEC_PER_SEC &&
+		 !break_test());
+
+	for_each_possible_cpu(cpu) {
+		struct rb_stress_cpu *c = per_cpu_ptr(&rb_stress_cpu, cpu);
+
+		if (!c->thread)
+			continue;
+		kthread_stop(c->thread);
+		c->thread = NULL;
+		irq_work_sync(&c->irq_work);
+
+		hit += c->hit;
+		missed += c->missed;
+		nested_hit += c->nested_hit;
+		nested_missed += c->nested_missed;
+		lat_max = max(lat_max, c->lat_max);
+		for (b = 0; b < RB_LAT_BUCKETS; b++)
+			lat[b] += c->lat[b];
+	}
+	end_time = ktime_get();
+
+	for (i = 0; i < stress_readers; i++) {
+		if (!readers[i].thread)
+			continue;
+		kthread_stop(readers[i].thread);
+		read += readers[i].read;
+		lost += readers[i].lost;
+	}
+
+	trace_printk("End ring buffer stress\n");
+
+	if (test_error)
+		trace_printk("ERROR!\n");
+
+	time = ktime_us_delta(end_time, start_time);
+	events = hit + nested_hit;
+
+	trace_printk("Producers: %d, readers: %u\n", nr_producers, stress_readers);
+	trace_printk("Time:      %llu (usecs)\n", time);
+	trace_printk("Hit:       %lu\n", hit);
+	trace_printk("Missed:    %lu\n", missed);
+	trace_printk("Nested:    %lu (missed %lu)\n", nested_hit, nested_missed);
+	trace_printk("Read:      %lu\n", read);
+	trace_printk("Lost:      %lu (reported to readers)\n", lost);
+	trace_printk("Overruns:  %lu\n", ring_buffer_overruns(buffer));
+	trace_printk("Entries:   %lu\n", ring_buffer_entries(buffer));
+	trace_printk("Total:     %lu (of %llu written)\n",
+		     read + ring_buffer_overruns(buffer) + ring_buffer_entries(buffer),
+		     events);
+
+	if (time)
+		trace_printk("Events per sec: %llu\n",
+			     div64_u64(events * USEC_PER_SEC, time));
+	else
+		trace_printk("TIME IS ZERO??\n");
+
+	if (hit)
+		trace_printk("Reserve latency (ns): p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu\n",
+			     rb_lat_percentile(lat, hit, 500),
+			     rb_lat_percentile(lat, hit, 900),
+			     rb_lat_percentile(lat, hit, 990),
+			     rb_lat_percentile(lat, hit, 999),
+			     lat_max);
+
+ out_free:
+	kfree(readers);
+	kfree(lat);
+}
+
 static void wait_to_die(void)
 {
 	set_current_state(TASK_INTERRUPTIBLE);
@@ -408,7 +772,10 @@ static int ring_buffer_producer_thread(void *arg)
 			wait_for_completion(&read_start);
 		}
 
-		ring_buffer_producer();
+		if (stress)
+			ring_buffer_stress();
+		else
+			ring_buffer_producer();
 		if (break_test())
 			goto out_kill;
 
@@ -436,7 +803,8 @@ static int __init ring_buffer_benchmark_init(void)
 	if (!buffer)
 		return -ENOMEM;
 
-	if (!disable_reader) {
+	/* Stress mode runs its own readers */
+	if (!disable_reader && !stress) {
 		consumer = kthread_create(ring_buffer_consumer_thread,
 					  NULL, "rb_consumer");
 		ret = PTR_ERR(consumer);
@@ -454,7 +822,7 @@ static int __init ring_buffer_benchmark_init(void)
 	/*
 	 * Run them as low-prio background tasks by default:
 	 */
-	if (!disable_reader) {
+	if (consumer) {
 		if (consumer_fifo >= 2)
 			sched_set_fifo(consumer);
 		else if (consumer_fifo == 1)
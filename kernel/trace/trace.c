@@ -49,6 +49,8 @@
 #include <linux/irq_work.h>
 #include <linux/workqueue.h>
 
+#include <uapi/linux/trace_mmap.h>
+
 #include <asm/setup.h> /* COMMAND_LINE_SIZE */
 
 #include "trace.h"
@@ -1260,13 +1262,26 @@ int tracing_alloc_snapshot_instance(struct trace_array *tr)
 
 	if (!tr->allocated_snapshot) {
 
+		spin_lock(&tr->snapshot_map_lock);
+		if (tr->mapped) {
+			spin_unlock(&tr->snapshot_map_lock);
+			return -EBUSY;
+		}
+		tr->snapshot_allocating = true;
+		spin_unlock(&tr->snapshot_map_lock);
+
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
 				   &tr->array_buffer, RING_BUFFER_ALL_CPUS);
+		if (ret >= 0)
+			tr->allocated_snapshot = true;
+
+		spin_lock(&tr->snapshot_map_lock);
+		tr->snapshot_allocating = false;
+		spin_unlock(&tr->snapshot_map_lock);
+
 		if (ret < 0)
 			return ret;
-
-		tr->allocated_snapshot = true;
 	}
 
 	return 0;
@@ -4983,7 +4998,7 @@ static int tracing_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
-static int tracing_release_generic_tr(struct inode *inode, struct file *file)
+int tracing_release_generic_tr(struct inode *inode, struct file *file)
 {
 	struct trace_array *tr = inode->i_private;
 
@@ -5728,7 +5743,7 @@ static const char readme_msg[] =
 	"\t            [:<var1>=<field|var_ref|numeric_literal>[,<var2>=...]]\n"
 	"\t            [:values=<field1[,field2,...]>]\n"
 	"\t            [:sort=<field1[,field2,...]>]\n"
-	"\t            [:size=#entries]\n"
+	"\t            [:size=#entries][:grow]\n"
 	"\t            [:pause][:continue][:clear]\n"
 	"\t            [:name=histname1]\n"
 	"\t            [:nohitcount]\n"
@@ -5760,6 +5775,8 @@ static const char readme_msg[] =
 	"\t    be modified by appending '.descending' or '.ascending' to a\n"
 	"\t    sort field.  The 'size' parameter can be used to specify more\n"
 	"\t    or fewer than the default 2048 entries for the hashtable size.\n"
+	"\t    With 'grow', 'size' (or the default) is only the initial size,\n"
+	"\t    and the table doubles as it fills up, to at most 131072 entries.\n"
 	"\t    If a hist trigger is given a name using the 'name' parameter,\n"
 	"\t    its histogram data will be shared with other triggers of the\n"
 	"\t    same name, and trigger hits will update this common data.\n\n"
@@ -5780,7 +5797,8 @@ static const char readme_msg[] =
 	"\t            .buckets=size  display values in groups of size rather than raw number\n"
 	"\t            .usecs      display a common_timestamp in microseconds\n"
 	"\t            .percent    display a number of percentage value\n"
-	"\t            .graph      display a bar-graph of a value\n\n"
+	"\t            .graph      display a bar-graph of a value\n"
+	"\t            .quantiles  display p50/p90/p99/p99.9 of a value\n\n"
 	"\t    The 'pause' parameter can be used to pause an existing hist\n"
 	"\t    trigger or to start a hist trigger but not log any events\n"
 	"\t    until told to do so.  'continue' can be used to start or\n"
@@ -8437,14 +8455,31 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
-/* An ioctl call with cmd 0 to the ring buffer file will wake up all waiters */
+/*
+ * An ioctl call with cmd 0 to the ring buffer file will wake up all waiters.
+ * TRACE_MMAP_IOCTL_GET_READER swaps in the next reader page of a mapped
+ * buffer, see ring_buffer_map_get_reader().
+ */
 static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct ftrace_buffer_info *info = file->private_data;
 	struct trace_iterator *iter = &info->iter;
+	int err;
+
+	if (cmd == TRACE_MMAP_IOCTL_GET_READER) {
+		if (!(file->f_flags & O_NONBLOCK)) {
+			err = ring_buffer_wait(iter->array_buffer->buffer,
+					       iter->cpu_file,
+					       iter->tr->buffer_percent);
+			if (err)
+				return err;
+		}
 
-	if (cmd)
+		return ring_buffer_map_get_reader(iter->array_buffer->buffer,
+						  iter->cpu_file);
+	} else if (cmd) {
 		return -ENOIOCTLCMD;
+	}
 
 	mutex_lock(&trace_types_lock);
 
@@ -8458,11 +8493,112 @@ static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned
 	return 0;
 }
 
+#ifdef CONFIG_TRACER_MAX_TRACE
+static int get_snapshot_map(struct trace_array *tr)
+{
+	int err = 0;
+
+	/*
+	 * Called with mmap_lock held. lockdep would be unhappy if we would now
+	 * take trace_types_lock. Instead use the specific snapshot_map_lock.
+	 */
+	spin_lock(&tr->snapshot_map_lock);
+
+	if (tr->allocated_snapshot || tr->snapshot_allocating ||
+	    tr->mapped == UINT_MAX)
+		err = -EBUSY;
+	else
+		tr->mapped++;
+
+	spin_unlock(&tr->snapshot_map_lock);
+
+	return err;
+}
+
+static void dup_snapshot_map(struct trace_array *tr)
+{
+	spin_lock(&tr->snapshot_map_lock);
+	if (!WARN_ON(!tr->mapped))
+		tr->mapped++;
+	spin_unlock(&tr->snapshot_map_lock);
+}
+
+static void put_snapshot_map(struct trace_array *tr)
+{
+	spin_lock(&tr->snapshot_map_lock);
+	if (!WARN_ON(!tr->mapped))
+		tr->mapped--;
+	spin_unlock(&tr->snapshot_map_lock);
+}
+#else
+static inline int get_snapshot_map(struct trace_array *tr) { return 0; }
+static inline void dup_snapshot_map(struct trace_array *tr) { }
+static inline void put_snapshot_map(struct trace_array *tr) { }
+#endif
+
+/*
+ * The VMA is copied when it is moved with mremap(). Take the references the
+ * copy drops in tracing_buffers_mmap_close().
+ */
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	ring_buffer_map_dup(iter->array_buffer->buffer, iter->cpu_file);
+	dup_snapshot_map(iter->tr);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	WARN_ON(ring_buffer_unmap(iter->array_buffer->buffer, iter->cpu_file));
+	put_snapshot_map(iter->tr);
+}
+
+/*
+ * The mapping is one meta-page followed by the sub-buffers and is only
+ * meaningful as a whole, don't let a partial munmap() or mprotect() split it.
+ */
+static int tracing_buffers_may_split(struct vm_area_struct *vma,
+				     unsigned long addr)
+{
+	return -EINVAL;
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+	.may_split	= tracing_buffers_may_split,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret = 0;
+
+	ret = get_snapshot_map(iter->tr);
+	if (ret)
+		return ret;
+
+	ret = ring_buffer_map(iter->array_buffer->buffer, iter->cpu_file, vma);
+	if (ret)
+		put_snapshot_map(iter->tr);
+
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return ret;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
+	.mmap		= tracing_buffers_mmap,
 	.splice_read	= tracing_buffers_splice_read,
 	.unlocked_ioctl = tracing_buffers_ioctl,
 	.llseek		= no_llseek,
@@ -9390,6 +9526,9 @@ static struct trace_array *trace_array_create(const char *name)
 	raw_spin_lock_init(&tr->start_lock);
 
 	tr->max_lock = (arch_spinlock_t)__ARCH_SPIN_LOCK_UNLOCKED;
+#ifdef CONFIG_TRACER_MAX_TRACE
+	spin_lock_init(&tr->snapshot_map_lock);
+#endif
 
 	tr->current_trace = &nop_trace;
 
@@ -9517,6 +9656,7 @@ static int __remove_instance(struct trace_array *tr)
 	ftrace_clear_pids(tr);
 	ftrace_destroy_function_files(tr);
 	tracefs_remove(tr->dir);
+	osnoise_free_instance(tr);
 	free_percpu(tr->last_func_repeats);
 	free_trace_buffers(tr);
 	clear_tracing_err_log(tr);
@@ -9685,6 +9825,9 @@ init_tracer_tracefs(struct trace_array *tr, struct dentry *d_tracer)
 		tracing_init_tracefs_percpu(tr, cpu);
 
 	ftrace_init_tracefs(tr, d_tracer);
+
+	if (osnoise_init_instance(tr, d_tracer))
+		MEM_FAIL(1, "Could not allocate osnoise instance files");
 }
 
 static struct vfsmount *trace_automount(struct dentry *mntpt, void *ingore)
@@ -10347,6 +10490,9 @@ __init static int tracer_alloc_buffers(void)
 	global_trace.current_trace = &nop_trace;
 
 	global_trace.max_lock = (arch_spinlock_t)__ARCH_SPIN_LOCK_UNLOCKED;
+#ifdef CONFIG_TRACER_MAX_TRACE
+	spin_lock_init(&global_trace.snapshot_map_lock);
+#endif
 
 	ftrace_init_global_array_ops(&global_trace);
 
@@ -311,6 +311,14 @@ struct trace_array {
 	 */
 	struct array_buffer	max_buffer;
 	bool			allocated_snapshot;
+	/*
+	 * A mapped buffer must not be swapped with the snapshot, so mapping
+	 * and allocating the snapshot exclude each other. Protected by
+	 * snapshot_map_lock, as mmap can't take trace_types_lock.
+	 */
+	spinlock_t		snapshot_map_lock;
+	bool			snapshot_allocating;
+	unsigned int		mapped;
 #endif
 #ifdef CONFIG_TRACER_MAX_TRACE
 	unsigned long		max_latency;
@@ -385,6 +393,9 @@ struct trace_array {
 	struct cond_snapshot	*cond_snapshot;
 #endif
 	struct trace_func_repeats	__percpu *last_func_repeats;
+#ifdef CONFIG_OSNOISE_TRACER
+	struct osnoise_instance_config	*osnoise;
+#endif
 };
 
 enum {
@@ -586,6 +597,7 @@ void tracing_reset_all_online_cpus(void);
 void tracing_reset_all_online_cpus_unlocked(void);
 int tracing_open_generic(struct inode *inode, struct file *filp);
 int tracing_open_generic_tr(struct inode *inode, struct file *filp);
+int tracing_release_generic_tr(struct inode *inode, struct file *file);
 bool tracing_is_disabled(void);
 bool tracer_tracing_is_on(struct trace_array *tr);
 void tracer_tracing_on(struct trace_array *tr);
@@ -1036,6 +1048,17 @@ static inline void ftrace_pid_follow_fork(struct trace_array *tr, bool enable) {
 #define ftrace_init_array_ops(tr, func) do { } while (0)
 #endif /* CONFIG_FUNCTION_TRACER */
 
+#ifdef CONFIG_OSNOISE_TRACER
+int osnoise_init_instance(struct trace_array *tr, struct dentry *d_tracer);
+void osnoise_free_instance(struct trace_array *tr);
+#else
+static inline int osnoise_init_instance(struct trace_array *tr, struct dentry *d_tracer)
+{
+	return 0;
+}
+static inline void osnoise_free_instance(struct trace_array *tr) { }
+#endif
+
 #if defined(CONFIG_FUNCTION_TRACER) && defined(CONFIG_DYNAMIC_FTRACE)
 
 struct ftrace_probe_ops {
@@ -1184,6 +1207,16 @@ extern int trace_get_user(struct trace_parser *parser, const char __user *ubuf,
 # define STACK_FLAGS
 #endif
 
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+# define FILTER_BPF_FLAGS			\
+		C(FILTER_BPF,		"filter-bpf"),	\
+		C(FILTER_STATS,		"filter-stats"),
+#else
+# define FILTER_BPF_FLAGS
+# define TRACE_ITER_FILTER_BPF		0UL
+# define TRACE_ITER_FILTER_STATS	0UL
+#endif
+
 /*
  * trace_iterator_flags is an enumeration that defines bit
  * positions into trace_flags that controls the output.
@@ -1220,7 +1253,8 @@ extern int trace_get_user(struct trace_parser *parser, const char __user *ubuf,
 		FUNCTION_FLAGS					\
 		FGRAPH_FLAGS					\
 		STACK_FLAGS					\
-		BRANCH_FLAGS
+		BRANCH_FLAGS					\
+		FILTER_BPF_FLAGS
 
 /*
  * By defining C, we can make TRACE_FLAGS a list of bit names
@@ -1292,10 +1326,16 @@ struct ftrace_event_field {
 };
 
 struct prog_entry;
+struct bpf_prog;
+struct event_filter_stats;
 
 struct event_filter {
 	struct prog_entry __rcu	*prog;
 	char			*filter_string;
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+	struct bpf_prog		*bpf_prog;
+	struct event_filter_stats __percpu *stats;
+#endif
 };
 
 struct event_subsystem {
@@ -1479,6 +1519,10 @@ extern enum regex_type
 filter_parse_regex(char *buff, int len, char **search, int *not);
 extern void print_event_filter(struct trace_event_file *file,
 			       struct trace_seq *s);
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+extern void print_event_filter_stats(struct trace_event_file *file,
+				     struct trace_seq *s);
+#endif
 extern int apply_event_filter(struct trace_event_file *file,
 			      char *filter_string);
 extern int apply_subsystem_event_filter(struct trace_subsystem_dir *dir,
@@ -1711,6 +1711,41 @@ event_filter_read(struct file *filp, char __user *ubuf, size_t cnt,
 	return r;
 }
 
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+static ssize_t
+event_filter_stats_read(struct file *filp, char __user *ubuf, size_t cnt,
+			loff_t *ppos)
+{
+	struct trace_event_file *file;
+	struct trace_seq *s;
+	int r = -ENODEV;
+
+	if (*ppos)
+		return 0;
+
+	s = kmalloc(sizeof(*s), GFP_KERNEL);
+
+	if (!s)
+		return -ENOMEM;
+
+	trace_seq_init(s);
+
+	mutex_lock(&event_mutex);
+	file = event_file_data(filp);
+	if (file)
+		print_event_filter_stats(file, s);
+	mutex_unlock(&event_mutex);
+
+	if (file)
+		r = simple_read_from_buffer(ubuf, cnt, ppos,
+					    s->buffer, trace_seq_used(s));
+
+	kfree(s);
+
+	return r;
+}
+#endif
+
 static ssize_t
 event_filter_write(struct file *filp, const char __user *ubuf, size_t cnt,
 		   loff_t *ppos)
@@ -2132,6 +2167,14 @@ static const struct file_operations ftrace_event_filter_fops = {
 	.llseek = default_llseek,
 };
 
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+static const struct file_operations ftrace_event_filter_stats_fops = {
+	.open = tracing_open_generic,
+	.read = event_filter_stats_read,
+	.llseek = default_llseek,
+};
+#endif
+
 static const struct file_operations ftrace_subsystem_filter_fops = {
 	.open = subsystem_open,
 	.read = subsystem_filter_read,
@@ -2464,6 +2507,10 @@ event_create_dir(struct dentry *parent, struct trace_event_file *file)
 	if (!(call->flags & TRACE_EVENT_FL_IGNORE_ENABLE)) {
 		trace_create_file("filter", TRACE_MODE_WRITE, file->dir,
 				  file, &ftrace_event_filter_fops);
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+		trace_create_file("filter_stats", TRACE_MODE_READ, file->dir,
+				  file, &ftrace_event_filter_stats_fops);
+#endif
 
 		trace_create_file("trigger", TRACE_MODE_WRITE, file->dir,
 				  file, &event_trigger_fops);
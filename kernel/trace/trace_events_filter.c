@@ -11,6 +11,7 @@
 #include <linux/mutex.h>
 #include <linux/perf_event.h>
 #include <linux/slab.h>
+#include <linux/filter.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -1048,11 +1049,63 @@ static int test_pred_visited_fn(struct filter_pred *pred, void *event)
 
 static int filter_pred_fn_call(struct filter_pred *pred, void *event);
 
+static int __filter_match_preds(struct prog_entry *prog, void *rec)
+{
+	int i;
+
+	for (i = 0; prog[i].pred; i++) {
+		struct filter_pred *pred = prog[i].pred;
+		int match = filter_pred_fn_call(pred, rec);
+		if (match == prog[i].when_to_branch)
+			i = prog[i].target;
+	}
+	return prog[i].target;
+}
+
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+struct event_filter_stats {
+	u64			evals;
+	u64			matches;
+	u64			sampled;
+	u64			sampled_ns;
+};
+
+/* Only time one evaluation out of this many, reading the clock isn't free */
+#define FILTER_STATS_SAMPLE	64
+
+static int filter_match_stats(struct event_filter *filter,
+			      struct prog_entry *prog, void *rec)
+{
+	u64 start = 0;
+	bool sample;
+	int match;
+
+	sample = !(this_cpu_inc_return(filter->stats->evals) &
+		   (FILTER_STATS_SAMPLE - 1));
+	if (sample)
+		start = trace_clock_local();
+
+	if (filter->bpf_prog)
+		match = !!bpf_prog_run(filter->bpf_prog, rec);
+	else
+		match = __filter_match_preds(prog, rec);
+
+	if (sample) {
+		this_cpu_add(filter->stats->sampled_ns,
+			     trace_clock_local() - start);
+		this_cpu_inc(filter->stats->sampled);
+	}
+	if (match)
+		this_cpu_inc(filter->stats->matches);
+
+	return match;
+}
+#endif
+
 /* return 1 if event matches, 0 otherwise (discard) */
 int filter_match_preds(struct event_filter *filter, void *rec)
 {
 	struct prog_entry *prog;
-	int i;
 
 	/* no filter is considered a match */
 	if (!filter)
@@ -1063,13 +1116,11 @@ int filter_match_preds(struct event_filter *filter, void *rec)
 	if (!prog)
 		return 1;
 
-	for (i = 0; prog[i].pred; i++) {
-		struct filter_pred *pred = prog[i].pred;
-		int match = filter_pred_fn_call(pred, rec);
-		if (match == prog[i].when_to_branch)
-			i = prog[i].target;
-	}
-	return prog[i].target;
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+	if (filter->stats)
+		return filter_match_stats(filter, prog, rec);
+#endif
+	return __filter_match_preds(prog, rec);
 }
 EXPORT_SYMBOL_GPL(filter_match_preds);
 
@@ -1145,6 +1196,52 @@ void print_event_filter(struct trace_event_file *file, struct trace_seq *s)
 		trace_seq_puts(s, "none\n");
 }
 
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+/* caller must hold event_mutex */
+void print_event_filter_stats(struct trace_event_file *file,
+			      struct trace_seq *s)
+{
+	struct event_filter *filter = event_filter(file);
+	struct event_filter_stats sum = { };
+	const char *mode;
+	int cpu;
+
+	if (!filter || !rcu_access_pointer(filter->prog)) {
+		trace_seq_puts(s, "none\n");
+		return;
+	}
+
+	if (!filter->bpf_prog)
+		mode = "interpreter";
+	else if (filter->bpf_prog->jited)
+		mode = "bpf-jit";
+	else
+		mode = "bpf";
+
+	trace_seq_printf(s, "mode: %s\n", mode);
+
+	if (!filter->stats) {
+		trace_seq_puts(s, "stats: disabled\n");
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct event_filter_stats *stats;
+
+		stats = per_cpu_ptr(filter->stats, cpu);
+		sum.evals += READ_ONCE(stats->evals);
+		sum.matches += READ_ONCE(stats->matches);
+		sum.sampled += READ_ONCE(stats->sampled);
+		sum.sampled_ns += READ_ONCE(stats->sampled_ns);
+	}
+
+	trace_seq_printf(s, "evaluations: %llu\n", sum.evals);
+	trace_seq_printf(s, "matches: %llu\n", sum.matches);
+	trace_seq_printf(s, "avg_ns: %llu\n",
+			 sum.sampled ? div64_u64(sum.sampled_ns, sum.sampled) : 0);
+}
+#endif
+
 void print_subsystem_event_filter(struct event_subsystem *system,
 				  struct trace_seq *s)
 {
@@ -1188,6 +1285,11 @@ static void __free_filter(struct event_filter *filter)
 	if (!filter)
 		return;
 
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+	if (filter->bpf_prog)
+		bpf_prog_free(filter->bpf_prog);
+	free_percpu(filter->stats);
+#endif
 	free_prog(filter);
 	kfree(filter->filter_string);
 	kfree(filter);
@@ -1849,6 +1951,240 @@ static int process_preds(struct trace_event_call *call,
 	return 0;
 }
 
+#ifdef CONFIG_TRACE_EVENT_FILTER_BPF
+/* Longest BPF sequence filter_emit_pred() emits for one predicate */
+#define FILTER_BPF_PRED_INSNS	10
+
+/*
+ * Emit the code for the predicate of @entry: compute its match into R0,
+ * then take the branch of the loop in __filter_match_preds() if that is
+ * when_to_branch. The offset of that last jump is left for the caller to
+ * fix up. R1 holds the event record.
+ *
+ * Only the numeric comparisons are translated; false is returned for
+ * any other predicate, and the filter then stays interpreted.
+ */
+static bool filter_emit_pred(struct prog_entry *entry, struct bpf_insn *insn,
+			     int *len)
+{
+	struct filter_pred *pred = entry->pred;
+	bool is_signed = false, equality = false;
+	int size, bits, n = 0;
+	u8 jmp_op;
+	u64 val;
+
+	switch (pred->fn_num) {
+	case FILTER_PRED_FN_64:
+		equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U64:
+		size = BPF_DW;
+		bits = 64;
+		break;
+	case FILTER_PRED_FN_S64:
+		size = BPF_DW;
+		bits = 64;
+		is_signed = true;
+		break;
+	case FILTER_PRED_FN_32:
+		equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U32:
+		size = BPF_W;
+		bits = 32;
+		break;
+	case FILTER_PRED_FN_S32:
+		size = BPF_W;
+		bits = 32;
+		is_signed = true;
+		break;
+	case FILTER_PRED_FN_16:
+		equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U16:
+		size = BPF_H;
+		bits = 16;
+		break;
+	case FILTER_PRED_FN_S16:
+		size = BPF_H;
+		bits = 16;
+		is_signed = true;
+		break;
+	case FILTER_PRED_FN_8:
+		equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U8:
+		size = BPF_B;
+		bits = 8;
+		break;
+	case FILTER_PRED_FN_S8:
+		size = BPF_B;
+		bits = 8;
+		is_signed = true;
+		break;
+	default:
+		return false;
+	}
+
+	if (pred->offset > S16_MAX)
+		return false;
+
+	if (equality) {
+		jmp_op = BPF_JEQ;
+	} else {
+		switch (pred->op) {
+		case OP_LT:
+			jmp_op = is_signed ? BPF_JSLT : BPF_JLT;
+			break;
+		case OP_LE:
+			jmp_op = is_signed ? BPF_JSLE : BPF_JLE;
+			break;
+		case OP_GT:
+			jmp_op = is_signed ? BPF_JSGT : BPF_JGT;
+			break;
+		case OP_GE:
+			jmp_op = is_signed ? BPF_JSGE : BPF_JGE;
+			break;
+		case OP_BAND:
+			/* Sign extension doesn't change whether any bit is shared */
+			jmp_op = BPF_JSET;
+			is_signed = false;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	/* Same truncation as the (type)pred->val of the pred functions */
+	val = pred->val;
+	if (bits < 64) {
+		val &= (1ULL << bits) - 1;
+		if (is_signed)
+			val = (u64)((s64)(val << (64 - bits)) >> (64 - bits));
+	}
+
+	/* R2 = field; R3 = val; R0 = (R2 op R3) ^ not */
+	insn[n++] = BPF_LDX_MEM(size, BPF_REG_2, BPF_REG_1, pred->offset);
+	if (is_signed && bits < 64) {
+		insn[n++] = BPF_ALU64_IMM(BPF_LSH, BPF_REG_2, 64 - bits);
+		insn[n++] = BPF_ALU64_IMM(BPF_ARSH, BPF_REG_2, 64 - bits);
+	}
+	insn[n++] = (struct bpf_insn) {
+		.code		= BPF_LD | BPF_DW | BPF_IMM,
+		.dst_reg	= BPF_REG_3,
+		.imm		= (u32)val,
+	};
+	insn[n++] = (struct bpf_insn) {
+		.imm		= (u32)(val >> 32),
+	};
+	insn[n++] = BPF_MOV64_IMM(BPF_REG_0, 1);
+	insn[n++] = BPF_JMP_REG(jmp_op, BPF_REG_2, BPF_REG_3, 1);
+	insn[n++] = BPF_MOV64_IMM(BPF_REG_0, 0);
+	if (equality && pred->not)
+		insn[n++] = BPF_ALU64_IMM(BPF_XOR, BPF_REG_0, 1);
+	insn[n++] = BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, entry->when_to_branch, 0);
+
+	*len = n;
+	return true;
+}
+
+/*
+ * Translate the program of @filter into BPF, laid out as one block per
+ * predicate followed by the TRUE and FALSE returns, so that it computes
+ * exactly what __filter_match_preds() does. Taking the branch of entry
+ * i continues at entry prog[i].target + 1.
+ */
+static struct bpf_prog *filter_compile_bpf(struct prog_entry *prog)
+{
+	struct bpf_insn *insns;
+	struct bpf_prog *fp = NULL;
+	int *start, *jmp_at;
+	int i, n, len = 0, err;
+
+	for (n = 0; prog[n].pred; n++)
+		;
+
+	/* The final returns, see predicate_parse() */
+	if (prog[n + 1].pred)
+		return NULL;
+
+	if (n * FILTER_BPF_PRED_INSNS + 4 > BPF_MAXINSNS)
+		return NULL;
+
+	insns = kcalloc(n * FILTER_BPF_PRED_INSNS + 4, sizeof(*insns),
+			GFP_KERNEL);
+	start = kcalloc(n + 2, sizeof(*start), GFP_KERNEL);
+	jmp_at = kcalloc(n, sizeof(*jmp_at), GFP_KERNEL);
+	if (!insns || !start || !jmp_at)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		int insn_len;
+
+		/* The interpreter only ever moves forward, so must we */
+		if (prog[i].target <= i || prog[i].target > n)
+			goto out;
+
+		start[i] = len;
+		if (!filter_emit_pred(&prog[i], &insns[len], &insn_len))
+			goto out;
+		len += insn_len;
+		jmp_at[i] = len - 1;
+	}
+
+	for (i = n; i < n + 2; i++) {
+		start[i] = len;
+		insns[len++] = BPF_MOV64_IMM(BPF_REG_0, prog[i].target);
+		insns[len++] = BPF_EXIT_INSN();
+	}
+
+	for (i = 0; i < n; i++)
+		insns[jmp_at[i]].off = start[prog[i].target + 1] - jmp_at[i] - 1;
+
+	fp = bpf_prog_alloc(bpf_prog_size(len), 0);
+	if (!fp)
+		goto out;
+
+	fp->len = len;
+	memcpy(fp->insnsi, insns, bpf_prog_insn_size(fp));
+
+	/* JITs the program if the BPF JIT is enabled */
+	fp = bpf_prog_select_runtime(fp, &err);
+	if (err) {
+		bpf_prog_free(fp);
+		fp = NULL;
+	}
+ out:
+	kfree(jmp_at);
+	kfree(start);
+	kfree(insns);
+
+	return fp;
+}
+
+/*
+ * Set up the optional parts of a freshly parsed filter: its statistics if
+ * the filter-stats option is set, and its BPF translation if the filter-bpf
+ * option is set. Failing either just leaves the filter evaluated as usual,
+ * without counting.
+ */
+static void filter_prepare_prog(struct trace_array *tr,
+				struct event_filter *filter)
+{
+	/* Not visible to the event yet */
+	struct prog_entry *prog = rcu_dereference_raw(filter->prog);
+
+	if (tr && (tr->trace_flags & TRACE_ITER_FILTER_STATS))
+		filter->stats = alloc_percpu(struct event_filter_stats);
+
+	if (tr && (tr->trace_flags & TRACE_ITER_FILTER_BPF))
+		filter->bpf_prog = filter_compile_bpf(prog);
+}
+#else
+static inline void filter_prepare_prog(struct trace_array *tr,
+				       struct event_filter *filter) { }
+#endif
+
 static inline void event_set_filtered_flag(struct trace_event_file *file)
 {
 	unsigned long old_flags = file->flags;
@@ -1906,8 +2242,10 @@ static int process_system_preds(struct trace_subsystem_dir *dir,
 			filter_disable(file);
 			parse_error(pe, FILT_ERR_BAD_SUBSYS_FILTER, 0);
 			append_filter_err(tr, pe, filter);
-		} else
+		} else {
+			filter_prepare_prog(tr, filter);
 			event_set_filtered_flag(file);
+		}
 
 
 		filter_item = kzalloc(sizeof(*filter_item), GFP_KERNEL);
@@ -2037,6 +2375,8 @@ static int create_filter(struct trace_array *tr,
 	err = process_preds(call, filter_string, *filterp, pe);
 	if (err && set_str)
 		append_filter_err(tr, pe, *filterp);
+	else if (!err)
+		filter_prepare_prog(tr, *filterp);
 	create_filter_finish(pe);
 
 	return err;
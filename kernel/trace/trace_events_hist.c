@@ -96,6 +96,17 @@ typedef u64 (*hist_field_fn_t) (struct hist_field *field,
 #define HIST_CONST_DIGITS_MAX	21
 #define HIST_DIV_SHIFT		20  /* For optimizing division by constants */
 
+/*
+ * .quantiles values are kept in a log-linear histogram per element: exact
+ * below HIST_QUANTILE_SUB, then HIST_QUANTILE_SUB buckets per power of two
+ * (so within 1/HIST_QUANTILE_SUB of the value), up to 2^HIST_QUANTILE_MAX_SHIFT.
+ */
+#define HIST_QUANTILE_SUB_BITS	3
+#define HIST_QUANTILE_SUB	(1 << HIST_QUANTILE_SUB_BITS)
+#define HIST_QUANTILE_MAX_SHIFT	48
+#define HIST_QUANTILE_BUCKETS	((HIST_QUANTILE_MAX_SHIFT - HIST_QUANTILE_SUB_BITS + 1) * \
+				 HIST_QUANTILE_SUB)
+
 enum field_op_id {
 	FIELD_OP_NONE,
 	FIELD_OP_PLUS,
@@ -194,6 +205,9 @@ struct hist_field {
 
 	unsigned int			var_str_idx;
 
+	/* Index of this value's histogram in hist_elt_data->quantiles */
+	unsigned int			quantile_idx;
+
 	/* Numeric literals are represented as u64 */
 	u64				constant;
 	/* Used to optimize division by constants */
@@ -506,6 +520,7 @@ enum hist_field_flags {
 	HIST_FIELD_FL_CONST		= 1 << 18,
 	HIST_FIELD_FL_PERCENT		= 1 << 19,
 	HIST_FIELD_FL_GRAPH		= 1 << 20,
+	HIST_FIELD_FL_QUANTILES		= 1 << 21,
 };
 
 struct var_defs {
@@ -525,6 +540,7 @@ struct hist_trigger_attrs {
 	bool		clear;
 	bool		ts_in_usecs;
 	bool		no_hitcount;
+	bool		grow;
 	unsigned int	map_bits;
 
 	char		*assignment_str[TRACING_MAP_VARS_MAX];
@@ -553,6 +569,7 @@ struct hist_trigger_data {
 	unsigned int			n_fields;
 	unsigned int			n_vars;
 	unsigned int			n_var_str;
+	unsigned int			n_quantiles;
 	unsigned int			key_size;
 	struct tracing_map_sort_key	sort_keys[TRACING_MAP_SORT_KEYS_MAX];
 	unsigned int			n_sort_keys;
@@ -676,6 +693,7 @@ struct hist_elt_data {
 	u64 *var_ref_vals;
 	char **field_var_str;
 	int n_field_var_str;
+	atomic_t *quantiles;
 };
 
 struct snapshot_context {
@@ -1567,6 +1585,8 @@ parse_hist_trigger_attrs(struct trace_array *tr, char *trigger_str)
 			attrs->cont = true;
 		else if (strcmp(str, "clear") == 0)
 			attrs->clear = true;
+		else if (strcmp(str, "grow") == 0)
+			attrs->grow = true;
 		else {
 			ret = parse_action(str, attrs);
 			if (ret)
@@ -1618,6 +1638,7 @@ static void hist_elt_data_free(struct hist_elt_data *elt_data)
 
 	kfree(elt_data->field_var_str);
 
+	kfree(elt_data->quantiles);
 	kfree(elt_data->comm);
 	kfree(elt_data);
 }
@@ -1680,11 +1701,34 @@ static int hist_trigger_elt_data_alloc(struct tracing_map_elt *elt)
 		}
 	}
 
+	if (hist_data->n_quantiles) {
+		elt_data->quantiles = kcalloc(hist_data->n_quantiles *
+					      HIST_QUANTILE_BUCKETS,
+					      sizeof(atomic_t), GFP_KERNEL);
+		if (!elt_data->quantiles) {
+			hist_elt_data_free(elt_data);
+			return -ENOMEM;
+		}
+	}
+
 	elt->private_data = elt_data;
 
 	return 0;
 }
 
+static void hist_trigger_elt_data_clear(struct tracing_map_elt *elt)
+{
+	struct hist_trigger_data *hist_data = elt->map->private_data;
+	struct hist_elt_data *elt_data = elt->private_data;
+	unsigned int i;
+
+	if (!elt_data || !elt_data->quantiles)
+		return;
+
+	for (i = 0; i < hist_data->n_quantiles * HIST_QUANTILE_BUCKETS; i++)
+		atomic_set(&elt_data->quantiles[i], 0);
+}
+
 static void hist_trigger_elt_data_init(struct tracing_map_elt *elt)
 {
 	struct hist_elt_data *elt_data = elt->private_data;
@@ -1696,9 +1740,50 @@ static void hist_trigger_elt_data_init(struct tracing_map_elt *elt)
 static const struct tracing_map_ops hist_trigger_elt_data_ops = {
 	.elt_alloc	= hist_trigger_elt_data_alloc,
 	.elt_free	= hist_trigger_elt_data_free,
+	.elt_clear	= hist_trigger_elt_data_clear,
 	.elt_init	= hist_trigger_elt_data_init,
 };
 
+static unsigned int hist_quantile_bucket(u64 val)
+{
+	unsigned int shift;
+
+	if (val < HIST_QUANTILE_SUB)
+		return val;
+
+	shift = fls64(val) - 1;
+	if (shift >= HIST_QUANTILE_MAX_SHIFT)
+		return HIST_QUANTILE_BUCKETS - 1;
+
+	return (shift - HIST_QUANTILE_SUB_BITS + 1) * HIST_QUANTILE_SUB +
+		((val >> (shift - HIST_QUANTILE_SUB_BITS)) &
+		 (HIST_QUANTILE_SUB - 1));
+}
+
+/* The largest value that falls into bucket @idx */
+static u64 hist_quantile_bucket_max(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < HIST_QUANTILE_SUB)
+		return idx;
+
+	shift = idx / HIST_QUANTILE_SUB - 1;
+
+	return ((u64)(HIST_QUANTILE_SUB + idx % HIST_QUANTILE_SUB) << shift) +
+		(1ULL << shift) - 1;
+}
+
+static void hist_quantile_update(struct hist_elt_data *elt_data,
+				 struct hist_field *hist_field, u64 val)
+{
+	atomic_t *buckets;
+
+	buckets = elt_data->quantiles +
+		hist_field->quantile_idx * HIST_QUANTILE_BUCKETS;
+	atomic_inc(&buckets[hist_quantile_bucket(val)]);
+}
+
 static const char *get_hist_field_flags(struct hist_field *hist_field)
 {
 	const char *flags_str = NULL;
@@ -1723,6 +1808,8 @@ static const char *get_hist_field_flags(struct hist_field *hist_field)
 		flags_str = "percent";
 	else if (hist_field->flags & HIST_FIELD_FL_GRAPH)
 		flags_str = "graph";
+	else if (hist_field->flags & HIST_FIELD_FL_QUANTILES)
+		flags_str = "quantiles";
 	else if (hist_field->flags & HIST_FIELD_FL_STACKTRACE)
 		flags_str = "stacktrace";
 
@@ -2354,6 +2441,10 @@ parse_field(struct hist_trigger_data *hist_data, struct trace_event_file *file,
 			if (*flags & (HIST_FIELD_FL_VAR | HIST_FIELD_FL_KEY))
 				goto error;
 			*flags |= HIST_FIELD_FL_GRAPH;
+		} else if (strcmp(modifier, "quantiles") == 0) {
+			if (*flags & (HIST_FIELD_FL_VAR | HIST_FIELD_FL_KEY))
+				goto error;
+			*flags |= HIST_FIELD_FL_QUANTILES;
 		} else {
  error:
 			hist_err(tr, HIST_ERR_BAD_FIELD_MODIFIER, errpos(modifier));
@@ -4247,6 +4338,9 @@ static int __create_val_field(struct hist_trigger_data *hist_data,
 		ret = -EINVAL;
 	}
 
+	if (hist_field->flags & HIST_FIELD_FL_QUANTILES)
+		hist_field->quantile_idx = hist_data->n_quantiles++;
+
 	hist_data->fields[val_idx] = hist_field;
 
 	++hist_data->n_vals;
@@ -5113,7 +5207,9 @@ create_hist_data(unsigned int map_bits,
 
 	map_ops = &hist_trigger_elt_data_ops;
 
-	hist_data->map = tracing_map_create(map_bits, hist_data->key_size,
+	/* A growable map starts out at map_bits and may grow to the max */
+	hist_data->map = tracing_map_create(attrs->grow ? TRACING_MAP_BITS_MAX :
+					    map_bits, hist_data->key_size,
 					    map_ops, hist_data);
 	if (IS_ERR(hist_data->map)) {
 		ret = PTR_ERR(hist_data->map);
@@ -5121,6 +5217,9 @@ create_hist_data(unsigned int map_bits,
 		goto free;
 	}
 
+	if (attrs->grow)
+		tracing_map_set_growable(hist_data->map, map_bits);
+
 	ret = create_tracing_map_fields(hist_data);
 	if (ret)
 		goto free;
@@ -5190,6 +5289,8 @@ static void hist_trigger_elt_update(struct hist_trigger_data *hist_data,
 			continue;
 		}
 		tracing_map_update_sum(elt, i, hist_val);
+		if (hist_field->flags & HIST_FIELD_FL_QUANTILES)
+			hist_quantile_update(elt_data, hist_field, hist_val);
 	}
 
 	for_each_hist_key_field(i, hist_data) {
@@ -5484,6 +5585,53 @@ static void hist_trigger_print_val(struct seq_file *m, unsigned int idx,
 	}
 }
 
+/* Quantiles printed for .quantiles values, in parts per thousand */
+static const unsigned int hist_quantiles[] = { 500, 900, 990, 999 };
+
+static void hist_quantile_print(struct seq_file *m, unsigned int q, u64 val)
+{
+	if (q % 10)
+		seq_printf(m, " p%u.%u=%llu", q / 10, q % 10, val);
+	else
+		seq_printf(m, " p%u=%llu", q / 10, val);
+}
+
+static void hist_trigger_print_quantiles(struct seq_file *m,
+					 const char *field_name,
+					 struct hist_field *hist_field,
+					 struct tracing_map_elt *elt)
+{
+	struct hist_elt_data *elt_data = elt->private_data;
+	u64 count = 0, total = 0, target;
+	unsigned int i, q = 0;
+	atomic_t *buckets;
+
+	buckets = elt_data->quantiles +
+		hist_field->quantile_idx * HIST_QUANTILE_BUCKETS;
+
+	for (i = 0; i < HIST_QUANTILE_BUCKETS; i++)
+		total += atomic_read(&buckets[i]);
+
+	seq_printf(m, " %s:", field_name);
+
+	for (i = 0; i < HIST_QUANTILE_BUCKETS && q < ARRAY_SIZE(hist_quantiles); i++) {
+		count += atomic_read(&buckets[i]);
+
+		/* Walk all buckets the quantiles have been reached by now */
+		while (q < ARRAY_SIZE(hist_quantiles)) {
+			target = DIV_ROUND_UP_ULL(total * hist_quantiles[q], 1000);
+			if (!total || count < target)
+				break;
+			hist_quantile_print(m, hist_quantiles[q],
+					    hist_quantile_bucket_max(i));
+			q++;
+		}
+	}
+
+	for (; q < ARRAY_SIZE(hist_quantiles); q++)
+		hist_quantile_print(m, hist_quantiles[q], 0);
+}
+
 static void hist_trigger_entry_print(struct seq_file *m,
 				     struct hist_trigger_data *hist_data,
 				     struct hist_val_stat *stats,
@@ -5507,7 +5655,11 @@ static void hist_trigger_entry_print(struct seq_file *m,
 			continue;
 
 		seq_puts(m, " ");
-		hist_trigger_print_val(m, i, field_name, flags, stats, elt);
+		if (flags & HIST_FIELD_FL_QUANTILES)
+			hist_trigger_print_quantiles(m, field_name,
+						     hist_data->fields[i], elt);
+		else
+			hist_trigger_print_val(m, i, field_name, flags, stats, elt);
 	}
 
 	print_actions(m, hist_data, elt);
@@ -6039,7 +6191,9 @@ static int event_hist_trigger_print(struct seq_file *m,
 		if (sort_key->descending)
 			seq_puts(m, ".descending");
 	}
-	seq_printf(m, ":size=%u", (1 << hist_data->map->map_bits));
+	seq_printf(m, ":size=%u", (1 << hist_data->map->init_bits));
+	if (hist_data->attrs->grow)
+		seq_puts(m, ":grow");
 	if (hist_data->enable_timestamps)
 		seq_printf(m, ":clock=%s", hist_data->attrs->clock);
 	if (hist_data->attrs->no_hitcount)
@@ -22,6 +22,7 @@
 #include <linux/cpumask.h>
 #include <linux/delay.h>
 #include <linux/sched/clock.h>
+#include <linux/cgroup.h>
 #include <uapi/linux/sched/types.h>
 #include <linux/sched.h>
 #include "trace.h"
@@ -80,6 +81,26 @@ struct osnoise_instance {
 
 static struct list_head osnoise_instances;
 
+static struct cpumask osnoise_cpumask;
+static struct cpumask save_cpumask;
+
+/*
+ * Per-instance configuration.
+ *
+ * Instances other than the top level one can restrict osnoise/timerlat to
+ * their own set of CPUs, and use their own period and runtime there, via
+ * the osnoise/ directory of the instance. If the CPU sets of two running
+ * instances overlap, the CPUs in common use the parameters of the one that
+ * started first. An empty cpus, or a zero value, follows the top level
+ * osnoise/ configuration.
+ */
+struct osnoise_instance_config {
+	cpumask_var_t	cpumask;		/* own CPUs, if not empty */
+	u64		sample_period;		/* own period, if not zero */
+	u64		sample_runtime;		/* own runtime, if not zero */
+	u64		timerlat_period;	/* own timerlat period, if not zero */
+};
+
 static bool osnoise_has_registered_instances(void)
 {
 	return !!list_first_or_null_rcu(&osnoise_instances,
@@ -162,6 +183,69 @@ static void osnoise_unregister_instance(struct trace_array *tr)
 	kvfree_rcu_mightsleep(inst);
 }
 
+/*
+ * osnoise_instance_cpus - the CPUs an instance measures
+ */
+static const struct cpumask *osnoise_instance_cpus(struct trace_array *tr)
+{
+	struct osnoise_instance_config *cfg = tr->osnoise;
+
+	if (cfg && !cpumask_empty(cfg->cpumask))
+		return cfg->cpumask;
+
+	return &osnoise_cpumask;
+}
+
+/*
+ * osnoise_instance_has_cpu - check if a sample from cpu belongs to tr
+ */
+static bool osnoise_instance_has_cpu(struct trace_array *tr, int cpu)
+{
+	return cpumask_test_cpu(cpu, osnoise_instance_cpus(tr));
+}
+
+/*
+ * osnoise_cpu_config - the configuration of the instance owning a CPU
+ *
+ * Returns the configuration of the first registered instance that has cpu
+ * in its own set of CPUs, or NULL if cpu follows the top level
+ * configuration. It must be called under rcu_read_lock().
+ */
+static struct osnoise_instance_config *osnoise_cpu_config(int cpu)
+{
+	struct osnoise_instance_config *cfg;
+	struct osnoise_instance *inst;
+
+	list_for_each_entry_rcu(inst, &osnoise_instances, list) {
+		cfg = inst->tr->osnoise;
+		if (cfg && cpumask_test_cpu(cpu, cfg->cpumask))
+			return cfg;
+	}
+
+	return NULL;
+}
+
+/*
+ * osnoise_run_cpumask - the CPUs on which the workload has to run
+ *
+ * That is the union of the CPUs of all the registered instances and, if
+ * not NULL, of tr, which is about to be registered.
+ */
+static void osnoise_run_cpumask(struct cpumask *mask, struct trace_array *tr)
+{
+	struct osnoise_instance *inst;
+
+	if (tr)
+		cpumask_copy(mask, osnoise_instance_cpus(tr));
+	else
+		cpumask_clear(mask);
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(inst, &osnoise_instances, list)
+		cpumask_or(mask, mask, osnoise_instance_cpus(inst->tr));
+	rcu_read_unlock();
+}
+
 /*
  * NMI runtime info.
  */
@@ -523,6 +607,8 @@ static void trace_osnoise_sample(struct osnoise_sample *sample)
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(inst, &osnoise_instances, list) {
+		if (!osnoise_instance_has_cpu(inst->tr, smp_processor_id()))
+			continue;
 		buffer = inst->tr->array_buffer.buffer;
 		__trace_osnoise_sample(sample, buffer);
 	}
@@ -597,6 +683,8 @@ static void trace_timerlat_sample(struct timerlat_sample *sample)
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(inst, &osnoise_instances, list) {
+		if (!osnoise_instance_has_cpu(inst->tr, smp_processor_id()))
+			continue;
 		buffer = inst->tr->array_buffer.buffer;
 		__trace_timerlat_sample(sample, buffer);
 	}
@@ -686,6 +774,8 @@ static void timerlat_dump_stack(u64 latency)
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(inst, &osnoise_instances, list) {
+		if (!osnoise_instance_has_cpu(inst->tr, smp_processor_id()))
+			continue;
 		buffer = inst->tr->array_buffer.buffer;
 		__timerlat_dump_stack(buffer, fstack, size);
 
@@ -1157,6 +1247,26 @@ thread_entry(struct osnoise_variables *osn_var, struct task_struct *t)
 	local_inc(&osn_var->int_counter);
 }
 
+/*
+ * osnoise_task_cgroup_id - the id of the cgroup v2 a noisy thread runs in
+ *
+ * Used to attribute thread noise to the workload it comes from.
+ */
+static u64 osnoise_task_cgroup_id(struct task_struct *t)
+{
+#ifdef CONFIG_CGROUPS
+	u64 id;
+
+	rcu_read_lock();
+	id = cgroup_id(task_dfl_cgroup(t));
+	rcu_read_unlock();
+
+	return id;
+#else
+	return 0;
+#endif
+}
+
 /*
  * thread_exit - Report the end of a thread noise window
  *
@@ -1176,7 +1286,9 @@ thread_exit(struct osnoise_variables *osn_var, struct task_struct *t)
 
 	duration = get_int_safe_duration(osn_var, &osn_var->thread.delta_start);
 
-	trace_thread_noise(t, osn_var->thread.arrival_time, duration);
+	if (trace_thread_noise_enabled())
+		trace_thread_noise(t, osn_var->thread.arrival_time, duration,
+				   osnoise_task_cgroup_id(t));
 
 	osn_var->thread.arrival_time = 0;
 }
@@ -1274,6 +1386,8 @@ static __always_inline void osnoise_stop_tracing(void)
 	rcu_read_lock();
 	list_for_each_entry_rcu(inst, &osnoise_instances, list) {
 		tr = inst->tr;
+		if (!osnoise_instance_has_cpu(tr, smp_processor_id()))
+			continue;
 		trace_array_printk_buf(tr->array_buffer.buffer, _THIS_IP_,
 				"stop tracing hit on cpu %d\n", smp_processor_id());
 
@@ -1296,6 +1410,8 @@ static void notify_new_max_latency(u64 latency)
 	rcu_read_lock();
 	list_for_each_entry_rcu(inst, &osnoise_instances, list) {
 		tr = inst->tr;
+		if (!osnoise_instance_has_cpu(tr, smp_processor_id()))
+			continue;
 		if (tracer_tracing_is_on(tr) && tr->max_latency < latency) {
 			tr->max_latency = latency;
 			latency_fsnotify(tr);
@@ -1304,6 +1420,36 @@ static void notify_new_max_latency(u64 latency)
 	rcu_read_unlock();
 }
 
+/*
+ * osnoise_get_params - the period and runtime of the current CPU
+ *
+ * Those are the ones of the instance owning the CPU, if any, or the top
+ * level ones otherwise.
+ */
+static void osnoise_get_params(u64 *period, u64 *runtime)
+{
+	struct osnoise_instance_config *cfg;
+
+	mutex_lock(&interface_lock);
+	*period = osnoise_data.sample_period;
+	*runtime = osnoise_data.sample_runtime;
+
+	rcu_read_lock();
+	cfg = osnoise_cpu_config(smp_processor_id());
+	if (cfg) {
+		if (cfg->sample_period)
+			*period = cfg->sample_period;
+		if (cfg->sample_runtime)
+			*runtime = cfg->sample_runtime;
+	}
+	rcu_read_unlock();
+	mutex_unlock(&interface_lock);
+
+	/* Only one of them might have been set for the instance */
+	if (*runtime > *period)
+		*runtime = *period;
+}
+
 /*
  * run_osnoise - Sample the time and look for osnoise
  *
@@ -1323,7 +1469,7 @@ static int run_osnoise(void)
 	struct osnoise_sample s;
 	bool disable_preemption;
 	unsigned int threshold;
-	u64 runtime, stop_in;
+	u64 period, runtime, stop_in;
 	u64 sum_noise = 0;
 	int hw_count = 0;
 	int ret = -1;
@@ -1339,6 +1485,11 @@ static int run_osnoise(void)
 	 */
 	osn_var->pid = current->pid;
 
+	/*
+	 * Read the config before IRQs and preemption get disabled.
+	 */
+	osnoise_get_params(&period, &runtime);
+
 	/*
 	 * Save the current stats for the diff
 	 */
@@ -1368,7 +1519,7 @@ static int run_osnoise(void)
 	 * Transform the *_us config to nanoseconds to avoid the
 	 * division on the main loop.
 	 */
-	runtime = osnoise_data.sample_runtime * NSEC_PER_USEC;
+	runtime *= NSEC_PER_USEC;
 	stop_in = osnoise_data.stop_tracing * NSEC_PER_USEC;
 
 	/*
@@ -1511,20 +1662,16 @@ static int run_osnoise(void)
 	return ret;
 }
 
-static struct cpumask osnoise_cpumask;
-static struct cpumask save_cpumask;
-
 /*
  * osnoise_sleep - sleep until the next period
  */
 static void osnoise_sleep(void)
 {
-	u64 interval;
+	u64 interval, period, runtime;
 	ktime_t wake_time;
 
-	mutex_lock(&interface_lock);
-	interval = osnoise_data.sample_period - osnoise_data.sample_runtime;
-	mutex_unlock(&interface_lock);
+	osnoise_get_params(&period, &runtime);
+	interval = period - runtime;
 
 	/*
 	 * differently from hwlat_detector, the osnoise tracer can run
@@ -1669,8 +1816,17 @@ static enum hrtimer_restart timerlat_irq(struct hrtimer *timer)
  */
 static int wait_next_period(struct timerlat_variables *tlat)
 {
+	struct osnoise_instance_config *cfg;
 	ktime_t next_abs_period, now;
-	u64 rel_period = osnoise_data.timerlat_period * 1000;
+	u64 rel_period;
+
+	rcu_read_lock();
+	cfg = osnoise_cpu_config(smp_processor_id());
+	if (cfg && cfg->timerlat_period)
+		rel_period = cfg->timerlat_period * 1000;
+	else
+		rel_period = osnoise_data.timerlat_period * 1000;
+	rcu_read_unlock();
 
 	now = hrtimer_cb_get_time(&tlat->timer);
 	next_abs_period = ns_to_ktime(tlat->abs_period + rel_period);
@@ -1838,9 +1994,9 @@ static int start_kthread(unsigned int cpu)
  * start_per_cpu_kthread - Kick off per-cpu osnoise sampling kthreads
  *
  * This starts the kernel thread that will look for osnoise on many
- * cpus.
+ * cpus. If not NULL, tr is the instance about to be registered.
  */
-static int start_per_cpu_kthreads(void)
+static int start_per_cpu_kthreads(struct trace_array *tr)
 {
 	struct cpumask *current_mask = &save_cpumask;
 	int retval = 0;
@@ -1850,7 +2006,8 @@ static int start_per_cpu_kthreads(void)
 	/*
 	 * Run only on online CPUs in which osnoise is allowed to run.
 	 */
-	cpumask_and(current_mask, cpu_online_mask, &osnoise_cpumask);
+	osnoise_run_cpumask(current_mask, tr);
+	cpumask_and(current_mask, current_mask, cpu_online_mask);
 
 	for_each_possible_cpu(cpu)
 		per_cpu(per_cpu_osnoise_var, cpu).kthread = NULL;
@@ -1869,6 +2026,52 @@ static int start_per_cpu_kthreads(void)
 	return retval;
 }
 
+/*
+ * osnoise_cpu_running - check if the workload is running on a CPU
+ */
+static bool osnoise_cpu_running(unsigned int cpu)
+{
+	struct osnoise_variables *osn_var = per_cpu_ptr(&per_cpu_osnoise_var, cpu);
+
+	if (osn_var->kthread)
+		return true;
+
+	return !timerlat_enabled() && !test_bit(OSN_WORKLOAD, &osnoise_options) &&
+	       osn_var->sampling;
+}
+
+/*
+ * osnoise_sync_per_cpu_kthreads - make the workload follow the instances
+ *
+ * When an instance with its own set of CPUs comes or goes while other
+ * instances keep running, the workload has to be started or stopped on
+ * its CPUs only.
+ */
+static void osnoise_sync_per_cpu_kthreads(void)
+{
+	struct cpumask *run_mask = &save_cpumask;
+	unsigned int cpu;
+	bool wanted;
+
+	if (!osnoise_has_registered_instances())
+		return;
+
+	cpus_read_lock();
+	osnoise_run_cpumask(run_mask, NULL);
+
+	for_each_online_cpu(cpu) {
+		wanted = cpumask_test_cpu(cpu, run_mask);
+		if (wanted == osnoise_cpu_running(cpu))
+			continue;
+
+		if (wanted)
+			start_kthread(cpu);
+		else
+			stop_kthread(cpu);
+	}
+	cpus_read_unlock();
+}
+
 #ifdef CONFIG_HOTPLUG_CPU
 static void osnoise_hotplug_workfn(struct work_struct *dummy)
 {
@@ -1882,7 +2085,8 @@ static void osnoise_hotplug_workfn(struct work_struct *dummy)
 	mutex_lock(&interface_lock);
 	cpus_read_lock();
 
-	if (!cpumask_test_cpu(cpu, &osnoise_cpumask))
+	osnoise_run_cpumask(&save_cpumask, NULL);
+	if (!cpumask_test_cpu(cpu, &save_cpumask))
 		goto out_unlock;
 
 	start_kthread(cpu);
@@ -2070,7 +2274,7 @@ static ssize_t osnoise_options_write(struct file *filp, const char __user *ubuf,
 	mutex_unlock(&interface_lock);
 
 	if (running)
-		start_per_cpu_kthreads();
+		start_per_cpu_kthreads(NULL);
 	mutex_unlock(&trace_types_lock);
 
 	return retval;
@@ -2086,22 +2290,22 @@ static ssize_t osnoise_options_write(struct file *filp, const char __user *ubuf,
  * Prints the "cpus" output into the user-provided buffer.
  */
 static ssize_t
-osnoise_cpus_read(struct file *filp, char __user *ubuf, size_t count,
-		  loff_t *ppos)
+__osnoise_cpus_read(const struct cpumask *mask, char __user *ubuf, size_t count,
+		    loff_t *ppos)
 {
 	char *mask_str;
 	int len;
 
 	mutex_lock(&interface_lock);
 
-	len = snprintf(NULL, 0, "%*pbl\n", cpumask_pr_args(&osnoise_cpumask)) + 1;
+	len = snprintf(NULL, 0, "%*pbl\n", cpumask_pr_args(mask)) + 1;
 	mask_str = kmalloc(len, GFP_KERNEL);
 	if (!mask_str) {
 		count = -ENOMEM;
 		goto out_unlock;
 	}
 
-	len = snprintf(mask_str, len, "%*pbl\n", cpumask_pr_args(&osnoise_cpumask));
+	len = snprintf(mask_str, len, "%*pbl\n", cpumask_pr_args(mask));
 	if (len >= count) {
 		count = -EINVAL;
 		goto out_free;
@@ -2117,6 +2321,13 @@ osnoise_cpus_read(struct file *filp, char __user *ubuf, size_t count,
 	return count;
 }
 
+static ssize_t
+osnoise_cpus_read(struct file *filp, char __user *ubuf, size_t count,
+		  loff_t *ppos)
+{
+	return __osnoise_cpus_read(&osnoise_cpumask, ubuf, count, ppos);
+}
+
 /*
  * osnoise_cpus_write - Write function for "cpus" entry
  * @filp: The active open file structure
@@ -2174,7 +2385,7 @@ osnoise_cpus_write(struct file *filp, const char __user *ubuf, size_t count,
 	mutex_unlock(&interface_lock);
 
 	if (running)
-		start_per_cpu_kthreads();
+		start_per_cpu_kthreads(NULL);
 	mutex_unlock(&trace_types_lock);
 
 	free_cpumask_var(osnoise_cpumask_new);
@@ -2266,6 +2477,225 @@ static const struct file_operations osnoise_options_fops = {
 	.write		= osnoise_options_write
 };
 
+/*
+ * osnoise_instance_cpus_read - Read function for an instance "cpus" entry
+ *
+ * An empty output means that the instance follows the top level
+ * osnoise/cpus.
+ */
+static ssize_t
+osnoise_instance_cpus_read(struct file *filp, char __user *ubuf, size_t count,
+			   loff_t *ppos)
+{
+	struct trace_array *tr = filp->private_data;
+
+	return __osnoise_cpus_read(tr->osnoise->cpumask, ubuf, count, ppos);
+}
+
+/*
+ * osnoise_instance_cpus_write - Write function for an instance "cpus" entry
+ *
+ * Gives the instance its own set of CPUs. Writing an empty list makes the
+ * instance follow the top level osnoise/cpus again.
+ */
+static ssize_t
+osnoise_instance_cpus_write(struct file *filp, const char __user *ubuf,
+			    size_t count, loff_t *ppos)
+{
+	struct trace_array *tr = filp->private_data;
+	cpumask_var_t cpumask_new;
+	int running, err;
+	char buf[256];
+
+	if (count >= 256)
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (!zalloc_cpumask_var(&cpumask_new, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = cpulist_parse(strstrip(buf), cpumask_new);
+	if (err)
+		goto out_free;
+
+	mutex_lock(&trace_types_lock);
+
+	running = osnoise_instance_registered(tr);
+	if (running)
+		stop_per_cpu_kthreads();
+
+	mutex_lock(&interface_lock);
+	cpus_read_lock();
+
+	cpumask_copy(tr->osnoise->cpumask, cpumask_new);
+
+	cpus_read_unlock();
+	mutex_unlock(&interface_lock);
+
+	if (running)
+		start_per_cpu_kthreads(NULL);
+
+	mutex_unlock(&trace_types_lock);
+
+	err = count;
+
+out_free:
+	free_cpumask_var(cpumask_new);
+	return err;
+}
+
+static ssize_t
+osnoise_instance_val_read(struct file *filp, char __user *ubuf, size_t cnt,
+			  loff_t *ppos, size_t offset)
+{
+	struct trace_array *tr = filp->private_data;
+	char buf[U64_STR_SIZE];
+	u64 val;
+	int len;
+
+	mutex_lock(&interface_lock);
+	val = *(u64 *)((void *)tr->osnoise + offset);
+	mutex_unlock(&interface_lock);
+
+	len = snprintf(buf, sizeof(buf), "%llu\n", val);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t
+osnoise_instance_val_write(struct file *filp, const char __user *ubuf,
+			   size_t cnt, loff_t *ppos, size_t offset,
+			   u64 min, u64 max)
+{
+	struct trace_array *tr = filp->private_data;
+	u64 val;
+	int err;
+
+	err = kstrtoull_from_user(ubuf, cnt, 10, &val);
+	if (err)
+		return err;
+
+	/* Zero goes back to the top level value */
+	if (val && (val < min || val > max))
+		return -EINVAL;
+
+	mutex_lock(&interface_lock);
+	*(u64 *)((void *)tr->osnoise + offset) = val;
+	mutex_unlock(&interface_lock);
+
+	return cnt;
+}
+
+/*
+ * Instance period_us, runtime_us and timerlat_period_us. A runtime longer
+ * than the period in use is cut to the period.
+ */
+#define DEFINE_OSNOISE_INSTANCE_FOPS(field, min, max)				\
+static ssize_t									\
+osnoise_instance_##field##_read(struct file *filp, char __user *ubuf,		\
+				size_t cnt, loff_t *ppos)			\
+{										\
+	return osnoise_instance_val_read(filp, ubuf, cnt, ppos,		\
+			offsetof(struct osnoise_instance_config, field));	\
+}										\
+										\
+static ssize_t									\
+osnoise_instance_##field##_write(struct file *filp, const char __user *ubuf,	\
+				 size_t cnt, loff_t *ppos)			\
+{										\
+	return osnoise_instance_val_write(filp, ubuf, cnt, ppos,		\
+			offsetof(struct osnoise_instance_config, field),	\
+			min, max);						\
+}										\
+										\
+static const struct file_operations osnoise_instance_##field##_fops = {	\
+	.open		= tracing_open_generic_tr,				\
+	.read		= osnoise_instance_##field##_read,			\
+	.write		= osnoise_instance_##field##_write,			\
+	.release	= tracing_release_generic_tr,				\
+	.llseek		= generic_file_llseek,					\
+}
+
+DEFINE_OSNOISE_INSTANCE_FOPS(sample_period, 1, U64_MAX);
+DEFINE_OSNOISE_INSTANCE_FOPS(sample_runtime, 1, U64_MAX);
+#ifdef CONFIG_TIMERLAT_TRACER
+DEFINE_OSNOISE_INSTANCE_FOPS(timerlat_period, 100, 1000000);
+#endif
+
+static const struct file_operations osnoise_instance_cpus_fops = {
+	.open		= tracing_open_generic_tr,
+	.read		= osnoise_instance_cpus_read,
+	.write		= osnoise_instance_cpus_write,
+	.release	= tracing_release_generic_tr,
+	.llseek		= generic_file_llseek,
+};
+
+/*
+ * osnoise_init_instance - create the osnoise/ directory of an instance
+ *
+ * The top level trace array uses the osnoise/ files created by
+ * init_tracefs() instead.
+ */
+int osnoise_init_instance(struct trace_array *tr, struct dentry *d_tracer)
+{
+	struct osnoise_instance_config *cfg;
+	struct dentry *dir;
+
+	if (tr->flags & TRACE_ARRAY_FL_GLOBAL)
+		return 0;
+
+	cfg = kzalloc(sizeof(*cfg), GFP_KERNEL);
+	if (!cfg)
+		return -ENOMEM;
+
+	if (!zalloc_cpumask_var(&cfg->cpumask, GFP_KERNEL)) {
+		kfree(cfg);
+		return -ENOMEM;
+	}
+
+	tr->osnoise = cfg;
+
+	dir = tracefs_create_dir("osnoise", d_tracer);
+	if (!dir)
+		return -ENOMEM;
+
+	trace_create_file("cpus", TRACE_MODE_WRITE, dir, tr,
+			  &osnoise_instance_cpus_fops);
+	trace_create_file("period_us", TRACE_MODE_WRITE, dir, tr,
+			  &osnoise_instance_sample_period_fops);
+	trace_create_file("runtime_us", TRACE_MODE_WRITE, dir, tr,
+			  &osnoise_instance_sample_runtime_fops);
+#ifdef CONFIG_TIMERLAT_TRACER
+	trace_create_file("timerlat_period_us", TRACE_MODE_WRITE, dir, tr,
+			  &osnoise_instance_timerlat_period_fops);
+#endif
+
+	return 0;
+}
+
+/*
+ * osnoise_free_instance - free the osnoise configuration of an instance
+ *
+ * The instance is no longer registered at this point, but the workload
+ * of other instances might still be looking at its configuration.
+ */
+void osnoise_free_instance(struct trace_array *tr)
+{
+	struct osnoise_instance_config *cfg = tr->osnoise;
+
+	if (!cfg)
+		return;
+
+	tr->osnoise = NULL;
+	synchronize_rcu();
+
+	free_cpumask_var(cfg->cpumask);
+	kfree(cfg);
+}
+
 #ifdef CONFIG_TIMERLAT_TRACER
 #ifdef CONFIG_STACKTRACE
 static int init_timerlat_stack_tracefs(struct dentry *top_dir)
@@ -2410,7 +2840,7 @@ static void osnoise_unhook_events(void)
 /*
  * osnoise_workload_start - start the workload and hook to events
  */
-static int osnoise_workload_start(void)
+static int osnoise_workload_start(struct trace_array *tr)
 {
 	int retval;
 
@@ -2437,7 +2867,7 @@ static int osnoise_workload_start(void)
 	barrier();
 	trace_osnoise_callback_enabled = true;
 
-	retval = start_per_cpu_kthreads();
+	retval = start_per_cpu_kthreads(tr);
 	if (retval) {
 		trace_osnoise_callback_enabled = false;
 		/*
@@ -2502,16 +2932,18 @@ static void osnoise_tracer_start(struct trace_array *tr)
 	if (osnoise_instance_registered(tr))
 		return;
 
-	retval = osnoise_workload_start();
+	retval = osnoise_workload_start(tr);
 	if (retval)
 		pr_err(BANNER "Error starting osnoise tracer\n");
 
 	osnoise_register_instance(tr);
+	osnoise_sync_per_cpu_kthreads();
 }
 
 static void osnoise_tracer_stop(struct trace_array *tr)
 {
 	osnoise_unregister_instance(tr);
+	osnoise_sync_per_cpu_kthreads();
 	osnoise_workload_stop();
 }
 
@@ -2557,11 +2989,12 @@ static void timerlat_tracer_start(struct trace_array *tr)
 	if (osnoise_instance_registered(tr))
 		return;
 
-	retval = osnoise_workload_start();
+	retval = osnoise_workload_start(tr);
 	if (retval)
 		pr_err(BANNER "Error starting timerlat tracer\n");
 
 	osnoise_register_instance(tr);
+	osnoise_sync_per_cpu_kthreads();
 
 	return;
 }
@@ -2571,6 +3004,7 @@ static void timerlat_tracer_stop(struct trace_array *tr)
 	int cpu;
 
 	osnoise_unregister_instance(tr);
+	osnoise_sync_per_cpu_kthreads();
 
 	/*
 	 * Instruct the threads to stop only if this is the last instance.
@@ -291,8 +291,11 @@ static void tracing_map_array_clear(struct tracing_map_array *a)
 	if (!a->pages)
 		return;
 
-	for (i = 0; i < a->n_pages; i++)
+	for (i = 0; i < a->n_pages; i++) {
+		if (!a->pages[i])
+			break;
 		memset(a->pages[i], 0, PAGE_SIZE);
+	}
 }
 
 static void tracing_map_array_free(struct tracing_map_array *a)
@@ -318,11 +321,41 @@ static void tracing_map_array_free(struct tracing_map_array *a)
 	kfree(a);
 }
 
-static struct tracing_map_array *tracing_map_array_alloc(unsigned int n_elts,
-						  unsigned int entry_size)
+/*
+ * Make sure the pages backing the first n_elts entries of the array are
+ * allocated.  Pages are always populated in order, which is what
+ * tracing_map_array_free() and tracing_map_array_clear() rely on.
+ */
+static int tracing_map_array_populate(struct tracing_map_array *a,
+				      unsigned int n_elts)
+{
+	unsigned int i, n_pages;
+
+	n_pages = DIV_ROUND_UP(n_elts, a->entries_per_page);
+	if (n_pages > a->n_pages)
+		n_pages = a->n_pages;
+
+	for (i = 0; i < n_pages; i++) {
+		if (a->pages[i])
+			continue;
+		a->pages[i] = (void *)get_zeroed_page(GFP_KERNEL);
+		if (!a->pages[i])
+			return -ENOMEM;
+		kmemleak_alloc(a->pages[i], PAGE_SIZE, 1, GFP_KERNEL);
+	}
+
+	return 0;
+}
+
+/*
+ * Allocate an array able to hold n_elts entries, of which only the
+ * first n_populate are backed by pages yet.
+ */
+static struct tracing_map_array *
+__tracing_map_array_alloc(unsigned int n_elts, unsigned int entry_size,
+			  unsigned int n_populate)
 {
 	struct tracing_map_array *a;
-	unsigned int i;
 
 	a = kzalloc(sizeof(*a), GFP_KERNEL);
 	if (!a)
@@ -340,12 +373,8 @@ static struct tracing_map_array *tracing_map_array_alloc(unsigned int n_elts,
 	if (!a->pages)
 		goto free;
 
-	for (i = 0; i < a->n_pages; i++) {
-		a->pages[i] = (void *)get_zeroed_page(GFP_KERNEL);
-		if (!a->pages[i])
-			goto free;
-		kmemleak_alloc(a->pages[i], PAGE_SIZE, 1, GFP_KERNEL);
-	}
+	if (tracing_map_array_populate(a, n_populate))
+		goto free;
  out:
 	return a;
  free:
@@ -355,6 +384,12 @@ static struct tracing_map_array *tracing_map_array_alloc(unsigned int n_elts,
 	goto out;
 }
 
+static struct tracing_map_array *tracing_map_array_alloc(unsigned int n_elts,
+						  unsigned int entry_size)
+{
+	return __tracing_map_array_alloc(n_elts, entry_size, n_elts);
+}
+
 static void tracing_map_elt_clear(struct tracing_map_elt *elt)
 {
 	unsigned i;
@@ -451,15 +486,31 @@ static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
 
 static struct tracing_map_elt *get_free_elt(struct tracing_map *map)
 {
-	struct tracing_map_elt *elt = NULL;
-	int idx;
-
-	idx = atomic_inc_return(&map->next_elt);
-	if (idx < map->max_elts) {
-		elt = *(TRACING_MAP_ELT(map->elts, idx));
-		if (map->ops && map->ops->elt_init)
-			map->ops->elt_init(elt);
-	}
+	struct tracing_map_elt *elt;
+	unsigned int nr_elts;
+	int idx, old;
+
+	/*
+	 * Only claim an index once it is known to be backed by an elt, so
+	 * that failed claims don't burn indexes a later grow makes valid.
+	 * Pairs with the smp_store_release() in tracing_map_grow_work().
+	 */
+	old = atomic_read(&map->next_elt);
+	do {
+		nr_elts = smp_load_acquire(&map->nr_elts);
+		idx = old + 1;
+		if (idx >= nr_elts)
+			return NULL;
+	} while (!atomic_try_cmpxchg(&map->next_elt, &old, idx));
+
+	elt = *(TRACING_MAP_ELT(map->elts, idx));
+	if (map->ops && map->ops->elt_init)
+		map->ops->elt_init(elt);
+
+	if (map->growable && nr_elts < map->max_elts &&
+	    idx >= TRACING_MAP_GROW_THRESHOLD(nr_elts) &&
+	    !atomic_xchg(&map->grow_pending, 1))
+		irq_work_queue(&map->grow_irq_work);
 
 	return elt;
 }
@@ -471,37 +522,70 @@ static void tracing_map_free_elts(struct tracing_map *map)
 	if (!map->elts)
 		return;
 
-	for (i = 0; i < map->max_elts; i++) {
+	for (i = 0; i < map->nr_elts; i++) {
 		tracing_map_elt_free(*(TRACING_MAP_ELT(map->elts, i)));
 		*(TRACING_MAP_ELT(map->elts, i)) = NULL;
 	}
 
 	tracing_map_array_free(map->elts);
 	map->elts = NULL;
+	map->nr_elts = 0;
 }
 
 static int tracing_map_alloc_elts(struct tracing_map *map)
 {
-	unsigned int i;
+	unsigned int i, n_elts = 1 << map->init_bits;
 
-	map->elts = tracing_map_array_alloc(map->max_elts,
-					    sizeof(struct tracing_map_elt *));
+	map->elts = __tracing_map_array_alloc(map->max_elts,
+					      sizeof(struct tracing_map_elt *),
+					      n_elts);
 	if (!map->elts)
 		return -ENOMEM;
 
-	for (i = 0; i < map->max_elts; i++) {
+	for (i = 0; i < n_elts; i++) {
 		*(TRACING_MAP_ELT(map->elts, i)) = tracing_map_elt_alloc(map);
 		if (IS_ERR(*(TRACING_MAP_ELT(map->elts, i)))) {
 			*(TRACING_MAP_ELT(map->elts, i)) = NULL;
+			map->nr_elts = i;
 			tracing_map_free_elts(map);
 
 			return -ENOMEM;
 		}
 	}
+	map->nr_elts = n_elts;
 
 	return 0;
 }
 
+static void tracing_map_free_table(struct tracing_map_table *table)
+{
+	if (!table)
+		return;
+
+	tracing_map_array_free(table->entries);
+	kfree(table);
+}
+
+static struct tracing_map_table *tracing_map_alloc_table(unsigned int bits)
+{
+	struct tracing_map_table *table;
+
+	table = kzalloc(sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return NULL;
+
+	table->bits = bits;
+	table->size = 1 << (bits + 1);
+	table->entries = tracing_map_array_alloc(table->size,
+					sizeof(struct tracing_map_entry));
+	if (!table->entries) {
+		kfree(table);
+		return NULL;
+	}
+
+	return table;
+}
+
 static inline bool keys_match(void *key, void *test_key, unsigned key_size)
 {
 	bool match = true;
@@ -512,22 +596,144 @@ static inline bool keys_match(void *key, void *test_key, unsigned key_size)
 	return match;
 }
 
+/*
+ * Copy an existing key_hash/elt pair into a table that no insertion
+ * can fill up, see tracing_map_grow_table().
+ */
+static void tracing_map_table_add(struct tracing_map *map,
+				  struct tracing_map_table *table,
+				  u32 key_hash, struct tracing_map_elt *elt)
+{
+	struct tracing_map_entry *entry;
+	struct tracing_map_elt *val;
+	u32 idx;
+
+	idx = key_hash >> (32 - (table->bits + 1));
+
+	while (1) {
+		idx &= (table->size - 1);
+		entry = TRACING_MAP_ENTRY(table->entries, idx);
+
+		if (!entry->key && !cmpxchg(&entry->key, 0, key_hash)) {
+			WRITE_ONCE(entry->val, elt);
+			return;
+		}
+
+		/*
+		 * Two CPUs can race to insert the same new key into both
+		 * tables while the new one is being published.  Keep the
+		 * copy already in the new table, detect_dups() would only
+		 * complain about a second one.
+		 */
+		if (entry->key == key_hash) {
+			val = READ_ONCE(entry->val);
+			if (val && keys_match(elt->key, val->key, map->key_size))
+				return;
+		}
+
+		idx++;
+	}
+}
+
+/*
+ * Move a growable map to a tracing_map_entry array of 2 ** (bits + 1)
+ * entries, see the overview at the beginning of tracing_map.h.  Called
+ * with table_lock held.
+ */
+static int tracing_map_grow_table(struct tracing_map *map, unsigned int bits)
+{
+	struct tracing_map_table *table, *old_table = map->table;
+	struct tracing_map_entry *entry;
+	unsigned int i;
+
+	table = tracing_map_alloc_table(bits);
+	if (!table)
+		return -ENOMEM;
+
+	WRITE_ONCE(map->old_table, old_table);
+	/* Pairs with the smp_load_acquire() in __tracing_map_insert() */
+	smp_store_release(&map->table, table);
+
+	/* Wait for the insertions that may still add to the old table */
+	synchronize_rcu();
+
+	for (i = 0; i < old_table->size; i++) {
+		entry = TRACING_MAP_ENTRY(old_table->entries, i);
+		if (entry->key && entry->val)
+			tracing_map_table_add(map, table, entry->key,
+					      entry->val);
+	}
+
+	/* Pairs with the smp_load_acquire() in __tracing_map_insert() */
+	smp_store_release(&map->old_table, NULL);
+	synchronize_rcu();
+
+	tracing_map_free_table(old_table);
+
+	return 0;
+}
+
+/*
+ * Double the pool of elts of a growable map, up to max_elts, and the
+ * tracing_map_entry array along with it if needed.  Runs from a
+ * workqueue so that it can sleep, while insertions carry on with the
+ * elts that are already there.
+ */
+static void tracing_map_grow_work(struct work_struct *work)
+{
+	struct tracing_map *map = container_of(work, struct tracing_map,
+					       grow_work);
+	unsigned int i, nr_elts = map->nr_elts, new_nr_elts;
+	struct tracing_map_elt *elt;
+
+	new_nr_elts = min(nr_elts * 2, map->max_elts);
+
+	mutex_lock(&map->table_lock);
+
+	if (new_nr_elts > map->table->size / 2 &&
+	    tracing_map_grow_table(map, ilog2(new_nr_elts)))
+		goto unlock;
+
+	if (tracing_map_array_populate(map->elts, new_nr_elts))
+		goto unlock;
+
+	for (i = nr_elts; i < new_nr_elts; i++) {
+		elt = tracing_map_elt_alloc(map);
+		if (IS_ERR(elt))
+			break;
+		*(TRACING_MAP_ELT(map->elts, i)) = elt;
+	}
+
+	/* Publish the new elts to get_free_elt() */
+	smp_store_release(&map->nr_elts, i);
+ unlock:
+	mutex_unlock(&map->table_lock);
+	atomic_set(&map->grow_pending, 0);
+}
+
+static void tracing_map_grow_irq_work(struct irq_work *iwork)
+{
+	struct tracing_map *map = container_of(iwork, struct tracing_map,
+					       grow_irq_work);
+
+	queue_work(system_unbound_wq, &map->grow_work);
+}
+
 static inline struct tracing_map_elt *
-__tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
+tracing_map_table_insert(struct tracing_map *map,
+			 struct tracing_map_table *table,
+			 void *key, u32 key_hash, bool lookup_only)
 {
-	u32 idx, key_hash, test_key;
+	u32 idx, test_key;
 	int dup_try = 0;
 	struct tracing_map_entry *entry;
 	struct tracing_map_elt *val;
 
-	key_hash = jhash(key, map->key_size, 0);
-	if (key_hash == 0)
-		key_hash = 1;
-	idx = key_hash >> (32 - (map->map_bits + 1));
+	idx = key_hash >> (32 - (table->bits + 1));
 
 	while (1) {
-		idx &= (map->map_size - 1);
-		entry = TRACING_MAP_ENTRY(map->map, idx);
+		idx &= (table->size - 1);
+		entry = TRACING_MAP_ENTRY(table->entries, idx);
 		test_key = entry->key;
 
 		if (test_key && test_key == key_hash) {
@@ -551,7 +757,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 				 */
 
 				dup_try++;
-				if (dup_try > map->map_size) {
+				if (dup_try > table->size) {
 					atomic64_inc(&map->drops);
 					break;
 				}
@@ -594,6 +800,40 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 	return NULL;
 }
 
+static inline struct tracing_map_elt *
+__tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
+{
+	struct tracing_map_table *table, *old_table;
+	struct tracing_map_elt *val;
+	u32 key_hash;
+
+	key_hash = jhash(key, map->key_size, 0);
+	if (key_hash == 0)
+		key_hash = 1;
+
+	/* Pairs with the smp_store_release()s in tracing_map_grow_table() */
+	table = smp_load_acquire(&map->table);
+	old_table = smp_load_acquire(&map->old_table);
+
+	/*
+	 * While a growable map moves to a larger table, keys that are not
+	 * copied over yet are only in the old one: look there first, and
+	 * only add new keys to the new table.
+	 */
+	if (unlikely(old_table)) {
+		val = tracing_map_table_insert(map, old_table, key, key_hash,
+					       true);
+		if (val) {
+			if (!lookup_only)
+				atomic64_inc(&map->hits);
+			return val;
+		}
+	}
+
+	return tracing_map_table_insert(map, table, key, key_hash,
+					lookup_only);
+}
+
 /**
  * tracing_map_insert - Insert key and/or retrieve val from a tracing_map
  * @map: The tracing_map to insert into
@@ -629,7 +869,9 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
  * If this was a newly inserted key, the val will be a newly allocated
  * and associated tracing_map_elt pointer val.  If the key wasn't
  * found and the pool of tracing_map_elts has been exhausted, NULL is
- * returned and no further insertions will succeed.
+ * returned and no further insertions will succeed - unless the map
+ * is growable, in which case insertions succeed again once the pool
+ * has been grown.
  */
 struct tracing_map_elt *tracing_map_insert(struct tracing_map *map, void *key)
 {
@@ -673,9 +915,14 @@ void tracing_map_destroy(struct tracing_map *map)
 	if (!map)
 		return;
 
+	if (map->growable) {
+		irq_work_sync(&map->grow_irq_work);
+		cancel_work_sync(&map->grow_work);
+	}
+
 	tracing_map_free_elts(map);
 
-	tracing_map_array_free(map->map);
+	tracing_map_free_table(map->table);
 	kfree(map);
 }
 
@@ -698,9 +945,11 @@ void tracing_map_clear(struct tracing_map *map)
 	atomic64_set(&map->hits, 0);
 	atomic64_set(&map->drops, 0);
 
-	tracing_map_array_clear(map->map);
+	mutex_lock(&map->table_lock);
+	tracing_map_array_clear(map->table->entries);
+	mutex_unlock(&map->table_lock);
 
-	for (i = 0; i < map->max_elts; i++)
+	for (i = 0; i < READ_ONCE(map->nr_elts); i++)
 		tracing_map_elt_clear(*(TRACING_MAP_ELT(map->elts, i)));
 }
 
@@ -777,38 +1026,51 @@ struct tracing_map *tracing_map_create(unsigned int map_bits,
 		return ERR_PTR(-ENOMEM);
 
 	map->map_bits = map_bits;
+	map->init_bits = map_bits;
 	map->max_elts = (1 << map_bits);
 	atomic_set(&map->next_elt, -1);
+	mutex_init(&map->table_lock);
 
-	map->map_size = (1 << (map_bits + 1));
 	map->ops = ops;
 
 	map->private_data = private_data;
 
-	map->map = tracing_map_array_alloc(map->map_size,
-					   sizeof(struct tracing_map_entry));
-	if (!map->map)
-		goto free;
-
 	map->key_size = key_size;
 	for (i = 0; i < TRACING_MAP_KEYS_MAX; i++)
 		map->key_idx[i] = -1;
- out:
+
 	return map;
- free:
-	tracing_map_destroy(map);
-	map = ERR_PTR(-ENOMEM);
+}
 
-	goto out;
+/**
+ * tracing_map_set_growable - Let a map grow as it fills up
+ * @map: The tracing_map, not yet initialized with tracing_map_init()
+ * @init_bits: The initial size of the map (2 ** init_bits)
+ *
+ * Turns the size the map was created with into a ceiling rather than
+ * a preallocation: tracing_map_init() will only allocate the map and
+ * its pool of tracing_map_elts for 2 ** init_bits elements, which are
+ * grown in the background as they fill up.  See the overview at the
+ * beginning of tracing_map.h.
+ */
+void tracing_map_set_growable(struct tracing_map *map, unsigned int init_bits)
+{
+	map->init_bits = clamp_t(unsigned int, init_bits, TRACING_MAP_BITS_MIN,
+				 map->map_bits);
+	map->growable = true;
+	atomic_set(&map->grow_pending, 0);
+	init_irq_work(&map->grow_irq_work, tracing_map_grow_irq_work);
+	INIT_WORK(&map->grow_work, tracing_map_grow_work);
 }
 
 /**
  * tracing_map_init - Allocate and clear a map's tracing_map_elts
  * @map: The tracing_map to initialize
  *
- * Allocates a clears a pool of tracing_map_elts equal to the
- * user-specified size of 2 ** map_bits (internally maintained as
- * 'max_elts' in struct tracing_map).  Before using, the map fields
+ * Allocates the tracing_map_entry array and allocates and clears a
+ * pool of tracing_map_elts equal to the user-specified size of
+ * 2 ** map_bits (internally maintained as 'max_elts' in struct
+ * tracing_map), or 2 ** init_bits for a growable map.  Before using, the map fields
  * should be added to the map with tracing_map_add_sum_field() and
  * tracing_map_add_key_field().  tracing_map_init() should then be
  * called to allocate the array of tracing_map_elts, in order to avoid
@@ -828,6 +1090,10 @@ int tracing_map_init(struct tracing_map *map)
 	if (map->n_fields < 2)
 		return -EINVAL; /* need at least 1 key and 1 val */
 
+	map->table = tracing_map_alloc_table(map->init_bits);
+	if (!map->table)
+		return -ENOMEM;
+
 	err = tracing_map_alloc_elts(map);
 	if (err)
 		return err;
@@ -1074,26 +1340,36 @@ int tracing_map_sort_entries(struct tracing_map *map,
 	int (*cmp_entries_fn)(const void *, const void *);
 	struct tracing_map_sort_entry *sort_entry, **entries;
 	int i, n_entries, ret;
+	unsigned int nr_elts;
+
+	/* A growable map may gain elts while we walk it, ignore those */
+	nr_elts = READ_ONCE(map->nr_elts);
 
-	entries = vmalloc(array_size(sizeof(sort_entry), map->max_elts));
+	entries = vmalloc(array_size(sizeof(sort_entry), nr_elts));
 	if (!entries)
 		return -ENOMEM;
 
-	for (i = 0, n_entries = 0; i < map->map_size; i++) {
+	mutex_lock(&map->table_lock);
+	for (i = 0, n_entries = 0; i < map->table->size; i++) {
 		struct tracing_map_entry *entry;
 
-		entry = TRACING_MAP_ENTRY(map->map, i);
+		entry = TRACING_MAP_ENTRY(map->table->entries, i);
 
 		if (!entry->key || !entry->val)
 			continue;
 
+		if (n_entries == nr_elts)
+			break;
+
 		entries[n_entries] = create_sort_entry(entry->val->key,
 						       entry->val);
 		if (!entries[n_entries++]) {
+			mutex_unlock(&map->table_lock);
 			ret = -ENOMEM;
 			goto free;
 		}
 	}
+	mutex_unlock(&map->table_lock);
 
 	if (n_entries == 0) {
 		ret = 0;
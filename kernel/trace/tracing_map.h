@@ -2,10 +2,17 @@
 #ifndef __TRACING_MAP_H
 #define __TRACING_MAP_H
 
+#include <linux/irq_work.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
 #define TRACING_MAP_BITS_DEFAULT	11
 #define TRACING_MAP_BITS_MAX		17
 #define TRACING_MAP_BITS_MIN		7
 
+/* When to grow the element pool of a growable map (3/4 full) */
+#define TRACING_MAP_GROW_THRESHOLD(n)	(((n) >> 1) + ((n) >> 2))
+
 #define TRACING_MAP_KEYS_MAX		3
 #define TRACING_MAP_VALS_MAX		3
 #define TRACING_MAP_FIELDS_MAX		(TRACING_MAP_KEYS_MAX + \
@@ -22,7 +29,7 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * structures and how they interact with the API.
  *
  * The central data structure of the tracing_map is an initially
- * zeroed array of struct tracing_map_entry (stored in the map field
+ * zeroed array of struct tracing_map_entry (stored in the table field
  * of struct tracing_map).  tracing_map_entry is a very simple data
  * structure containing only two fields: a 32-bit unsigned 'key'
  * variable and a pointer named 'val'.  This array of struct
@@ -66,8 +73,8 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * with the tracing_map_entry array in the tracing_map.  Because of
  * the way the insertion algorithm works, the size of the allocated
  * tracing_map_entry array is always twice the maximum number of
- * elements (2 * max_elts).  This value is stored in the map_size
- * field of struct tracing_map.
+ * elements (2 * max_elts).  This value is stored in the size field
+ * of struct tracing_map_table.
  *
  * Because tracing_map_insert() needs to work from any context,
  * including from within the memory allocation functions themselves,
@@ -76,7 +83,7 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * tracing_map_insert().
  *
  * The tracing_map_entry array is allocated as a single block by
- * tracing_map_create().
+ * tracing_map_init().
  *
  * Because the tracing_map_elts are much larger objects and can't
  * generally be allocated together as a single large array without
@@ -125,6 +132,28 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * user, tracing_map_sort_entry objects contain a number of additional
  * fields which are used for caching and internal purposes and can
  * safely be ignored.
+ *
+ * A map can also be made growable, by calling tracing_map_set_growable()
+ * before tracing_map_init().  In that case max_elts is only the ceiling,
+ * and tracing_map_init() allocates the tracing_map_entry array and the
+ * pool of tracing_map_elts for the initial number of bits passed to
+ * tracing_map_set_growable() (init_bits) instead.  Once get_free_elt()
+ * has handed out TRACING_MAP_GROW_THRESHOLD() of the elts, it kicks an
+ * irq_work (so that this works in any context, including NMI) which
+ * queues grow_work.  The work doubles the pool and publishes it by
+ * raising nr_elts.  Insertion never waits for it and keeps going on
+ * the existing pool in the meantime; only if the pool runs out before
+ * the work has run are events counted as drops, as in a fixed-size map.
+ *
+ * When the pool outgrows its tracing_map_entry array, grow_work first
+ * moves to a table twice as large.  The new table is published in
+ * 'table' with the previous one kept in 'old_table', where insertions
+ * look for keys first.  Once the insertions which could still add to
+ * the old table are known to be done (an RCU grace period, as they all
+ * run with preemption disabled), its entries are copied over and it is
+ * freed after another grace period.  table_lock keeps
+ * tracing_map_sort_entries() and tracing_map_clear() off a table that
+ * is being replaced.
 */
 
 struct tracing_map_field {
@@ -149,6 +178,13 @@ struct tracing_map_entry {
 	struct tracing_map_elt		*val;
 };
 
+/* A tracing_map_entry array of 2 ** (bits + 1) entries */
+struct tracing_map_table {
+	unsigned int			bits;
+	unsigned int			size;
+	struct tracing_map_array	*entries;
+};
+
 struct tracing_map_sort_key {
 	unsigned int			field_idx;
 	bool				descending;
@@ -183,11 +219,14 @@ struct tracing_map_array {
 struct tracing_map {
 	unsigned int			key_size;
 	unsigned int			map_bits;
-	unsigned int			map_size;
+	unsigned int			init_bits;
 	unsigned int			max_elts;
+	unsigned int			nr_elts;
 	atomic_t			next_elt;
 	struct tracing_map_array	*elts;
-	struct tracing_map_array	*map;
+	struct tracing_map_table	*table;
+	struct tracing_map_table	*old_table;
+	struct mutex			table_lock;
 	const struct tracing_map_ops	*ops;
 	void				*private_data;
 	struct tracing_map_field	fields[TRACING_MAP_FIELDS_MAX];
@@ -198,6 +237,10 @@ struct tracing_map {
 	unsigned int			n_vars;
 	atomic64_t			hits;
 	atomic64_t			drops;
+	bool				growable;
+	atomic_t			grow_pending;
+	struct irq_work			grow_irq_work;
+	struct work_struct		grow_work;
 };
 
 /**
@@ -242,6 +285,8 @@ tracing_map_create(unsigned int map_bits,
 		   unsigned int key_size,
 		   const struct tracing_map_ops *ops,
 		   void *private_data);
+extern void tracing_map_set_growable(struct tracing_map *map,
+				     unsigned int init_bits);
 extern int tracing_map_init(struct tracing_map *map);
 
 extern int tracing_map_add_sum_field(struct tracing_map *map);
@@ -119,19 +119,112 @@ const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #define RAID6_TEST_DISKS	8
 #define RAID6_TEST_DISKS_ORDER	3
 
-static inline const struct raid6_recov_calls *raid6_choose_recov(void)
+/* Recovery algorithm in use, and the one asked for with recov_algo= */
+static const struct raid6_recov_calls *raid6_recov_cur;
+static const struct raid6_recov_calls *raid6_recov_forced;
+
+static void raid6_use_recov(const struct raid6_recov_calls *rec)
+{
+	raid6_2data_recov = rec->data2;
+	raid6_datap_recov = rec->datap;
+	raid6_recov_cur = rec;
+}
+
+#ifdef __KERNEL__
+static int raid6_recov_algo_set(const char *val, const struct kernel_param *kp)
+{
+	const struct raid6_recov_calls *const *algo;
+
+	for (algo = raid6_recov_algos; *algo; algo++) {
+		if (!sysfs_streq(val, (*algo)->name))
+			continue;
+		if ((*algo)->valid && !(*algo)->valid())
+			return -EOPNOTSUPP;
+
+		/* Before raid6_select_algo() this only records the choice */
+		raid6_recov_forced = *algo;
+		if (raid6_recov_cur) {
+			raid6_use_recov(*algo);
+			pr_info("raid6: using %s recovery algorithm\n",
+				(*algo)->name);
+		}
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int raid6_recov_algo_get(char *buffer, const struct kernel_param *kp)
+{
+	const struct raid6_recov_calls *rec = raid6_recov_cur ?: raid6_recov_forced;
+
+	return sysfs_emit(buffer, "%s\n", rec ? rec->name : "");
+}
+
+static const struct kernel_param_ops raid6_recov_algo_ops = {
+	.set = raid6_recov_algo_set,
+	.get = raid6_recov_algo_get,
+};
+module_param_cb(recov_algo, &raid6_recov_algo_ops, NULL, 0644);
+MODULE_PARM_DESC(recov_algo, "Recovery algorithm to use instead of the benchmarked one");
+#endif
+
+static unsigned long raid6_time_recov(const struct raid6_recov_calls *rec,
+	void *(*const dptrs)[RAID6_TEST_DISKS], const int disks)
+{
+	unsigned long perf = 0, j0, j1;
+
+	preempt_disable();
+	j0 = jiffies;
+	while ((j1 = jiffies) == j0)
+		cpu_relax();
+	while (time_before(jiffies, j1 + (1 << RAID6_TIME_JIFFIES_LG2))) {
+		rec->data2(disks, PAGE_SIZE, 0, 1, *dptrs);
+		perf++;
+	}
+	preempt_enable();
+
+	return perf;
+}
+
+/*
+ * The highest priority recovery routine is not always the fastest, e.g.
+ * wide vectors may clock the CPU down, so with the benchmark enabled all
+ * valid ones are timed. Must be called after raid6_choose_gen(), as the
+ * recovery routines regenerate the syndrome with raid6_call.
+ */
+static inline const struct raid6_recov_calls *raid6_choose_recov(
+	void *(*const dptrs)[RAID6_TEST_DISKS], const int disks)
 {
 	const struct raid6_recov_calls *const *algo;
 	const struct raid6_recov_calls *best;
+	unsigned long perf, bestperf = 0;
 
-	for (best = NULL, algo = raid6_recov_algos; *algo; algo++)
-		if (!best || (*algo)->priority > best->priority)
-			if (!(*algo)->valid || (*algo)->valid())
+	for (best = NULL, algo = raid6_recov_algos; *algo; algo++) {
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
+
+		if (raid6_recov_forced || !IS_ENABLED(CONFIG_RAID6_PQ_BENCHMARK)) {
+			if (!best || (*algo)->priority > best->priority)
 				best = *algo;
+			continue;
+		}
+
+		perf = raid6_time_recov(*algo, dptrs, disks);
+		pr_info("raid6: %-8s recov() %5ld MB/s\n", (*algo)->name,
+			(perf * HZ * 2) >>
+			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2));
+		if (!best || perf > bestperf) {
+			bestperf = perf;
+			best = *algo;
+		}
+	}
+
+	if (raid6_recov_forced)
+		best = raid6_recov_forced;
 
 	if (best) {
-		raid6_2data_recov = best->data2;
-		raid6_datap_recov = best->datap;
+		raid6_use_recov(best);
 
 		pr_info("raid6: using %s recovery algorithm\n", best->name);
 	} else
@@ -261,7 +354,7 @@ int __init raid6_select_algo(void)
 	gen_best = raid6_choose_gen(&dptrs, disks);
 
 	/* select raid recover functions */
-	rec_best = raid6_choose_recov();
+	rec_best = gen_best ? raid6_choose_recov(&dptrs, disks) : NULL;
 
 	free_pages((unsigned long)disk_ptr, RAID6_TEST_DISKS_ORDER);
 
@@ -15,6 +15,7 @@
 #define DFLTCC_FIRST_FHT_BLOCK_SIZE 4096
 #define DFLTCC_DHT_MIN_SAMPLE_SIZE 4096
 #define DFLTCC_RIBM 0
+#define DFLTCC_SOFTWARE_THRESHOLD 512 /* Use software for one-shot calls below X bytes */
 
 #define DFLTCC_FACILITY 151
 
@@ -121,4 +122,19 @@ return (zlib_dfltcc_support != ZLIB_DFLTCC_DISABLED &&
 
 #define DEFLATE_DFLTCC_ENABLED() is_dfltcc_enabled()
 
+/*
+ * A whole stream that is smaller than DFLTCC_SOFTWARE_THRESHOLD is handled
+ * faster in software than by setting up the parameter block and issuing
+ * DFLTCC. Not done in debug mode, which is meant to exercise the hardware.
+ */
+static inline int dfltcc_is_small_stream(
+    z_streamp strm,
+    int flush
+)
+{
+    return zlib_dfltcc_support != ZLIB_DFLTCC_FULL_DEBUG &&
+           flush == Z_FINISH &&
+           strm->avail_in < DFLTCC_SOFTWARE_THRESHOLD;
+}
+
 #endif /* DFLTCC_H */
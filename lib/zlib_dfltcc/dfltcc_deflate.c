@@ -138,6 +138,14 @@ int dfltcc_deflate(
         return 0;
     }
 
+    /* Small one-shot stream - compress it in software. Nothing has been
+     * consumed yet, so the switch is safe; it lasts until the next reset.
+     */
+    if (strm->total_in == 0 && dfltcc_is_small_stream(strm, flush)) {
+        memset(&dfltcc_state->common.af, 0, sizeof(dfltcc_state->common.af));
+        return 0;
+    }
+
 again:
     masked_avail_in = 0;
     soft_bcc = 0;
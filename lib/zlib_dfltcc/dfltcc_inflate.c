@@ -119,6 +119,15 @@ dfltcc_inflate_action dfltcc_inflate(
     if (strm->avail_in == 0 && !param->cf)
         return DFLTCC_INFLATE_BREAK;
 
+    /* Small one-shot stream - decompress it in software. The output size
+     * is checked as well, since a few bytes of input may expand to a lot.
+     */
+    if (!dfltcc_was_inflate_used(strm) && dfltcc_is_small_stream(strm, flush) &&
+            strm->avail_out < DFLTCC_SOFTWARE_THRESHOLD) {
+        dfltcc_inflate_disable(strm);
+        return DFLTCC_INFLATE_SOFTWARE;
+    }
+
     if (!state->window || state->wsize == 0) {
         state->mode = MEM;
         return DFLTCC_INFLATE_CONTINUE;
@@ -318,6 +318,98 @@ static void damon_test_update_monitoring_result(struct kunit *test)
 	KUNIT_EXPECT_EQ(test, r->age, 20);
 }
 
+static void damon_test_workers_assign(struct kunit *test)
+{
+	struct damon_ctx *c = damon_new_ctx();
+	struct damon_worker workers[2] = {
+		{ .id = 0, .nid = 0 },
+		{ .id = 1, .nid = 0 },
+	};
+	struct damon_workers pool = { .workers = workers, .nr = 2 };
+	struct damon_target *t[3];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(t); i++) {
+		t[i] = damon_new_target();
+		damon_add_target(c, t[i]);
+	}
+	for (i = 0; i < 3; i++)
+		damon_add_region(damon_new_region(i * 10, i * 10 + 5), t[0]);
+
+	/* The targets without pids go to the least loaded worker */
+	damon_workers_assign(c, &pool);
+	KUNIT_EXPECT_EQ(test, t[0]->worker, 0u);
+	KUNIT_EXPECT_EQ(test, t[1]->worker, 1u);
+	KUNIT_EXPECT_EQ(test, t[2]->worker, 1u);
+	KUNIT_EXPECT_EQ(test, workers[0].nr_regions, 4ul);
+	KUNIT_EXPECT_EQ(test, workers[1].nr_regions, 2ul);
+
+	damon_destroy_ctx(c);
+}
+
+static void damon_test_set_effective_quota(struct kunit *test)
+{
+	struct damos_quota quota = {
+		.goal = {
+			.metric = DAMOS_QUOTA_USER_INPUT,
+			.target_value = 10000,
+			.current_value = 5000,
+		},
+		.min_sz = 4096,
+	};
+
+	KUNIT_EXPECT_EQ(test, damon_feed_loop_next_input(10000, 5000),
+			15000ul);
+	KUNIT_EXPECT_EQ(test, damon_feed_loop_next_input(20000, 10000),
+			20000ul);
+	KUNIT_EXPECT_EQ(test, damon_feed_loop_next_input(20000, 20000),
+			10000ul);
+
+	/* Far below the target, but not below min_sz */
+	damos_set_effective_quota(&quota);
+	KUNIT_EXPECT_EQ(test, quota.esz, 4096ul);
+
+	/* Nothing achieved yet, double the quota */
+	quota.goal.current_value = 0;
+	damos_set_effective_quota(&quota);
+	KUNIT_EXPECT_EQ(test, quota.esz, 8192ul);
+
+	/* Capped by the size quota, without growing beyond it internally */
+	quota.sz = 10000;
+	damos_set_effective_quota(&quota);
+	KUNIT_EXPECT_EQ(test, quota.esz, 10000ul);
+	KUNIT_EXPECT_EQ(test, quota.esz_bp, 10000ul * 10000);
+
+	/* Above the target, shrink back */
+	quota.goal.current_value = 15000;
+	damos_set_effective_quota(&quota);
+	KUNIT_EXPECT_EQ(test, quota.esz, 5000ul);
+}
+
+static void damon_test_access_hist_bucket(struct kunit *test)
+{
+	struct damon_attrs attrs = {
+		.sample_interval = 5000,
+		.aggr_interval = 100000,
+	};
+
+	/* 20 samples per aggregation, one per bucket */
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 0), 0u);
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 7), 7u);
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 19), 19u);
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 20), 19u);
+
+	attrs.aggr_interval = 1000000;
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 9), 0u);
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 10), 1u);
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 199), 19u);
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 500), 19u);
+
+	/* Aggregation interval shorter than the sampling interval */
+	attrs.aggr_interval = 1000;
+	KUNIT_EXPECT_EQ(test, damon_access_hist_bucket(&attrs, 0), 19u);
+}
+
 static struct kunit_case damon_test_cases[] = {
 	KUNIT_CASE(damon_test_target),
 	KUNIT_CASE(damon_test_regions),
@@ -329,6 +421,9 @@ static struct kunit_case damon_test_cases[] = {
 	KUNIT_CASE(damon_test_ops_registration),
 	KUNIT_CASE(damon_test_set_regions),
 	KUNIT_CASE(damon_test_update_monitoring_result),
+	KUNIT_CASE(damon_test_workers_assign),
+	KUNIT_CASE(damon_test_set_effective_quota),
+	KUNIT_CASE(damon_test_access_hist_bucket),
 	{},
 };
 
@@ -11,8 +11,12 @@
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/nodemask.h>
+#include <linux/psi.h>
+#include <linux/sched/task.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/workqueue.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/damon.h>
@@ -303,6 +307,8 @@ static struct damos_quota *damos_quota_init_priv(struct damos_quota *quota)
 	quota->total_charged_sz = 0;
 	quota->total_charged_ns = 0;
 	quota->esz = 0;
+	quota->esz_bp = 0;
+	quota->goal.last_psi_total = 0;
 	quota->charged_sz = 0;
 	quota->charged_from = 0;
 	quota->charge_target_from = NULL;
@@ -375,6 +381,7 @@ struct damon_target *damon_new_target(void)
 	t->nr_regions = 0;
 	INIT_LIST_HEAD(&t->regions_list);
 	INIT_LIST_HEAD(&t->list);
+	t->worker = 0;
 
 	return t;
 }
@@ -939,27 +946,106 @@ static void damon_do_apply_schemes(struct damon_ctx *c,
 	}
 }
 
-/* Shouldn't be called if quota->ms and quota->sz are zero */
+static bool damos_quota_is_set(struct damos_quota *quota)
+{
+	return quota->ms || quota->sz ||
+		quota->goal.metric != DAMOS_QUOTA_GOAL_NONE;
+}
+
+static u64 damos_get_some_mem_psi_total(void)
+{
+#ifdef CONFIG_PSI
+	if (static_branch_likely(&psi_disabled))
+		return 0;
+	return div_u64(psi_system.total[PSI_AVGS][PSI_MEM_SOME],
+			NSEC_PER_USEC);
+#else
+	return 0;
+#endif
+}
+
+static void damos_set_quota_goal_current_value(struct damos_quota_goal *goal)
+{
+	u64 now_psi_total;
+
+	switch (goal->metric) {
+	case DAMOS_QUOTA_SOME_MEM_PSI_US:
+		now_psi_total = damos_get_some_mem_psi_total();
+		goal->current_value = now_psi_total - goal->last_psi_total;
+		goal->last_psi_total = now_psi_total;
+		break;
+	case DAMOS_QUOTA_FREE_MEM_BP:
+		goal->current_value = global_zone_page_state(NR_FREE_PAGES) *
+			10000 / totalram_pages();
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Next input of a feedback loop that tries to get @score to 10000.  The
+ * input is changed by the relative distance of @score to the goal, but by
+ * at most @last_input.
+ */
+static unsigned long damon_feed_loop_next_input(unsigned long last_input,
+		unsigned long score)
+{
+	const unsigned long goal = 10000;
+	/* Keep the compensation from rounding down to zero */
+	const unsigned long min_input = 10000;
+	unsigned long diff_bp, compensation;
+
+	diff_bp = (max(goal, score) - min(goal, score)) * 10000 / goal;
+	compensation = mult_frac(last_input, min(diff_bp, 10000UL), 10000);
+
+	if (goal > score)
+		return last_input + min(compensation, ULONG_MAX - last_input);
+	if (last_input > compensation + min_input)
+		return last_input - compensation;
+	return min_input;
+}
+
+/* Shouldn't be called if damos_quota_is_set() is false */
 static void damos_set_effective_quota(struct damos_quota *quota)
 {
+	struct damos_quota_goal *goal = &quota->goal;
 	unsigned long throughput;
-	unsigned long esz;
-
-	if (!quota->ms) {
-		quota->esz = quota->sz;
-		return;
+	unsigned long esz = ULONG_MAX;
+	unsigned long score;
+
+	if (goal->metric != DAMOS_QUOTA_GOAL_NONE) {
+		damos_set_quota_goal_current_value(goal);
+		if (goal->target_value)
+			score = mult_frac(goal->current_value, 10000,
+					goal->target_value);
+		else
+			score = goal->current_value ? ULONG_MAX : 10000;
+		quota->esz_bp = damon_feed_loop_next_input(
+				max(quota->esz_bp, 10000UL), score);
+		/* More than the whole memory would not make a difference */
+		esz = min(quota->esz_bp / 10000,
+				totalram_pages() << PAGE_SHIFT);
+		esz = max(esz, quota->min_sz);
 	}
 
-	if (quota->total_charged_ns)
-		throughput = quota->total_charged_sz * 1000000 /
-			quota->total_charged_ns;
-	else
-		throughput = PAGE_SIZE * 1024;
-	esz = throughput * quota->ms;
+	if (quota->ms) {
+		if (quota->total_charged_ns)
+			throughput = quota->total_charged_sz * 1000000 /
+				quota->total_charged_ns;
+		else
+			throughput = PAGE_SIZE * 1024;
+		esz = min(throughput * quota->ms, esz);
+	}
 
 	if (quota->sz && quota->sz < esz)
 		esz = quota->sz;
 	quota->esz = esz;
+
+	/* Don't keep growing the tuned quota beyond the bounds */
+	if (goal->metric != DAMOS_QUOTA_GOAL_NONE &&
+			check_mul_overflow(esz, 10000UL, &quota->esz_bp))
+		quota->esz_bp = ULONG_MAX;
 }
 
 static void damos_adjust_quota(struct damon_ctx *c, struct damos *s)
@@ -970,7 +1056,7 @@ static void damos_adjust_quota(struct damon_ctx *c, struct damos *s)
 	unsigned long cumulated_sz;
 	unsigned int score, max_score = 0;
 
-	if (!quota->ms && !quota->sz)
+	if (!damos_quota_is_set(quota))
 		return;
 
 	/* New charge window starts */
@@ -1298,63 +1384,312 @@ static int kdamond_wait_activation(struct damon_ctx *ctx)
 	return -EBUSY;
 }
 
+/*
+ * Access check workers
+ *
+ * A pool of unbound work items doing the per target access checks of one
+ * context.  Each worker prefers one NUMA node and gets the targets whose
+ * processes run on that node, balanced by their number of regions.  kdamond
+ * waits for all the workers after queueing them, so each sampling still ends
+ * with the checks of every target done.
+ */
+struct damon_worker {
+	struct work_struct work;
+	struct damon_ctx *ctx;
+	unsigned int id;
+	int nid;
+	bool check;			/* check accesses, else prepare checks */
+	unsigned int max_nr_accesses;
+	unsigned long nr_regions;	/* regions of the assigned targets */
+};
+
+struct damon_workers {
+	struct workqueue_struct *wq;
+	struct damon_worker *workers;
+	unsigned int nr;
+	unsigned int nr_requested;
+};
+
+static void damon_worker_fn(struct work_struct *work)
+{
+	struct damon_worker *w = container_of(work, struct damon_worker, work);
+	struct damon_ctx *ctx = w->ctx;
+	struct damon_target *t;
+	unsigned int nr_accesses;
+
+	w->max_nr_accesses = 0;
+	damon_for_each_target(t, ctx) {
+		if (t->worker != w->id)
+			continue;
+		if (!w->check) {
+			ctx->ops.prepare_access_checks_target(ctx, t);
+			continue;
+		}
+		nr_accesses = ctx->ops.check_accesses_target(ctx, t);
+		w->max_nr_accesses = max(w->max_nr_accesses, nr_accesses);
+		cond_resched();
+	}
+}
+
+/* Node the processes of @t run on, NUMA_NO_NODE if unknown. */
+static int damon_target_nid(struct damon_ctx *ctx, struct damon_target *t)
+{
+	struct task_struct *task;
+	int nid = NUMA_NO_NODE;
+
+	if (!damon_target_has_pid(ctx))
+		return nid;
+
+	rcu_read_lock();
+	task = pid_task(t->pid, PIDTYPE_PID);
+	if (task)
+		nid = cpu_to_node(task_cpu(task));
+	rcu_read_unlock();
+	return nid;
+}
+
+static struct damon_worker *damon_least_loaded_worker(
+		struct damon_workers *pool, int nid)
+{
+	struct damon_worker *w, *best = NULL;
+	unsigned int i;
+
+	for (i = 0; i < pool->nr; i++) {
+		w = &pool->workers[i];
+		if (nid != NUMA_NO_NODE && w->nid != nid)
+			continue;
+		if (!best || w->nr_regions < best->nr_regions)
+			best = w;
+	}
+	return best;
+}
+
+static void damon_workers_assign(struct damon_ctx *ctx,
+		struct damon_workers *pool)
+{
+	struct damon_target *t;
+	struct damon_worker *w;
+	unsigned int i;
+
+	for (i = 0; i < pool->nr; i++)
+		pool->workers[i].nr_regions = 0;
+
+	damon_for_each_target(t, ctx) {
+		w = damon_least_loaded_worker(pool, damon_target_nid(ctx, t));
+		if (!w)
+			w = damon_least_loaded_worker(pool, NUMA_NO_NODE);
+		t->worker = w->id;
+		w->nr_regions += damon_nr_regions(t) + 1;
+	}
+}
+
+static void damon_workers_destroy(struct damon_workers *pool)
+{
+	if (pool->wq)
+		destroy_workqueue(pool->wq);
+	kfree(pool->workers);
+	pool->wq = NULL;
+	pool->workers = NULL;
+	pool->nr = 0;
+}
+
+/*
+ * Set up the workers for the nr_workers of @ctx.  Failing that, the access
+ * checks are just done by kdamond itself.
+ */
+static void damon_workers_init(struct damon_ctx *ctx,
+		struct damon_workers *pool)
+{
+	unsigned int i, nr = min(ctx->attrs.nr_workers, num_online_cpus());
+	int nid = NUMA_NO_NODE;
+
+	pool->nr_requested = ctx->attrs.nr_workers;
+	if (nr < 2 || !ctx->ops.prepare_access_checks_target ||
+			!ctx->ops.check_accesses_target)
+		return;
+
+	pool->workers = kcalloc(nr, sizeof(*pool->workers), GFP_KERNEL);
+	if (!pool->workers)
+		goto fail;
+	pool->wq = alloc_workqueue("kdamond.%d", WQ_UNBOUND, nr,
+			current->pid);
+	if (!pool->wq)
+		goto fail;
+
+	for (i = 0; i < nr; i++) {
+		struct damon_worker *w = &pool->workers[i];
+
+		INIT_WORK(&w->work, damon_worker_fn);
+		w->ctx = ctx;
+		w->id = i;
+		nid = next_node_in(nid, node_states[N_CPU]);
+		w->nid = nid;
+	}
+	pool->nr = nr;
+	damon_workers_assign(ctx, pool);
+	return;
+
+fail:
+	pr_warn("kdamond (%d) cannot start %u access check workers\n",
+			current->pid, nr);
+	damon_workers_destroy(pool);
+}
+
+/* Run the prepare or check phase on all workers and wait for them. */
+static unsigned int damon_workers_run(struct damon_workers *pool, bool check)
+{
+	unsigned int i, max_nr_accesses = 0;
+	struct damon_worker *w;
+
+	for (i = 0; i < pool->nr; i++) {
+		w = &pool->workers[i];
+		w->check = check;
+		queue_work_node(w->nid, pool->wq, &w->work);
+	}
+	for (i = 0; i < pool->nr; i++) {
+		w = &pool->workers[i];
+		flush_work(&w->work);
+		max_nr_accesses = max(max_nr_accesses, w->max_nr_accesses);
+	}
+	return max_nr_accesses;
+}
+
+static void kdamond_prepare_access_checks(struct damon_ctx *ctx,
+		struct damon_workers *pool)
+{
+	if (pool->nr)
+		damon_workers_run(pool, false);
+	else if (ctx->ops.prepare_access_checks)
+		ctx->ops.prepare_access_checks(ctx);
+}
+
+static unsigned int kdamond_check_accesses(struct damon_ctx *ctx,
+		struct damon_workers *pool)
+{
+	if (pool->nr)
+		return damon_workers_run(pool, true);
+	if (ctx->ops.check_accesses)
+		return ctx->ops.check_accesses(ctx);
+	return 0;
+}
+
+static void kdamond_account_phase(u64 *stat, u64 start)
+{
+	WRITE_ONCE(*stat, *stat + ktime_get_ns() - start);
+}
+
+/* Return the &struct damon_access_hist bucket for @nr_accesses. */
+static unsigned int damon_access_hist_bucket(struct damon_attrs *attrs,
+		unsigned int nr_accesses)
+{
+	unsigned int max_nr_accesses = 0;
+
+	if (attrs->sample_interval)
+		max_nr_accesses = attrs->aggr_interval / attrs->sample_interval;
+	if (nr_accesses >= max_nr_accesses)
+		return DAMON_ACCESS_HIST_NR_BUCKETS - 1;
+	return nr_accesses * DAMON_ACCESS_HIST_NR_BUCKETS / max_nr_accesses;
+}
+
+static void kdamond_update_access_hist(struct damon_ctx *ctx)
+{
+	unsigned long sz[DAMON_ACCESS_HIST_NR_BUCKETS] = {};
+	struct damon_target *t;
+	struct damon_region *r;
+	unsigned int i;
+
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t)
+			sz[damon_access_hist_bucket(&ctx->attrs,
+					r->nr_accesses)] += damon_sz_region(r);
+	}
+
+	for (i = 0; i < DAMON_ACCESS_HIST_NR_BUCKETS; i++)
+		WRITE_ONCE(ctx->access_hist.sz[i], sz[i]);
+}
+
 /*
  * The monitoring daemon that runs as a kernel thread
  */
 static int kdamond_fn(void *data)
 {
 	struct damon_ctx *ctx = data;
+	struct damon_phase_stats *stats = &ctx->phase_stats;
+	struct damon_workers pool = {};
 	struct damon_target *t;
 	struct damon_region *r, *next;
 	unsigned int max_nr_accesses = 0;
 	unsigned long sz_limit = 0;
+	u64 start;
 
 	pr_debug("kdamond (%d) starts\n", current->pid);
 
+	memset(stats, 0, sizeof(*stats));
+	memset(&ctx->access_hist, 0, sizeof(ctx->access_hist));
 	if (ctx->ops.init)
 		ctx->ops.init(ctx);
 	if (ctx->callback.before_start && ctx->callback.before_start(ctx))
 		goto done;
 
 	sz_limit = damon_region_sz_limit(ctx);
+	damon_workers_init(ctx, &pool);
 
 	while (!kdamond_need_stop(ctx)) {
 		if (kdamond_wait_activation(ctx))
 			break;
 
-		if (ctx->ops.prepare_access_checks)
-			ctx->ops.prepare_access_checks(ctx);
+		start = ktime_get_ns();
+		kdamond_prepare_access_checks(ctx, &pool);
+		kdamond_account_phase(&stats->prepare_ns, start);
 		if (ctx->callback.after_sampling &&
 				ctx->callback.after_sampling(ctx))
 			break;
 
 		kdamond_usleep(ctx->attrs.sample_interval);
 
-		if (ctx->ops.check_accesses)
-			max_nr_accesses = ctx->ops.check_accesses(ctx);
+		start = ktime_get_ns();
+		max_nr_accesses = kdamond_check_accesses(ctx, &pool);
+		kdamond_account_phase(&stats->check_ns, start);
+		WRITE_ONCE(stats->nr_samples, stats->nr_samples + 1);
 
 		if (kdamond_aggregate_interval_passed(ctx)) {
+			start = ktime_get_ns();
 			kdamond_merge_regions(ctx,
 					max_nr_accesses / 10,
 					sz_limit);
+			kdamond_update_access_hist(ctx);
+			kdamond_account_phase(&stats->aggr_ns, start);
 			if (ctx->callback.after_aggregation &&
 					ctx->callback.after_aggregation(ctx))
 				break;
+			start = ktime_get_ns();
 			if (!list_empty(&ctx->schemes))
 				kdamond_apply_schemes(ctx);
 			kdamond_reset_aggregated(ctx);
 			kdamond_split_regions(ctx);
 			if (ctx->ops.reset_aggregated)
 				ctx->ops.reset_aggregated(ctx);
+			kdamond_account_phase(&stats->aggr_ns, start);
+
+			/* The callback may have changed targets or workers */
+			if (ctx->attrs.nr_workers != pool.nr_requested) {
+				damon_workers_destroy(&pool);
+				damon_workers_init(ctx, &pool);
+			} else if (pool.nr) {
+				damon_workers_assign(ctx, &pool);
+			}
 		}
 
 		if (kdamond_need_update_operations(ctx)) {
+			start = ktime_get_ns();
 			if (ctx->ops.update)
 				ctx->ops.update(ctx);
 			sz_limit = damon_region_sz_limit(ctx);
+			kdamond_account_phase(&stats->update_ns, start);
 		}
 	}
 done:
+	damon_workers_destroy(&pool);
 	damon_for_each_target(t, ctx) {
 		damon_for_each_region_safe(r, next, t)
 			damon_destroy_region(r, t);
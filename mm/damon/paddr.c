@@ -11,6 +11,8 @@
 #include <linux/page_idle.h>
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/swap.h>
 
 #include "../internal.h"
@@ -31,52 +33,38 @@ static bool __damon_pa_mkold(struct folio *folio, struct vm_area_struct *vma,
 	return true;
 }
 
-static void damon_pa_mkold(unsigned long paddr)
+static void damon_pa_mkold_folio(struct folio *folio)
 {
-	struct folio *folio = damon_get_folio(PHYS_PFN(paddr));
 	struct rmap_walk_control rwc = {
 		.rmap_one = __damon_pa_mkold,
 		.anon_lock = folio_lock_anon_vma_read,
 	};
 	bool need_lock;
 
-	if (!folio)
-		return;
-
 	if (!folio_mapped(folio) || !folio_raw_mapping(folio)) {
 		folio_set_idle(folio);
-		goto out;
+		return;
 	}
 
 	need_lock = !folio_test_anon(folio) || folio_test_ksm(folio);
 	if (need_lock && !folio_trylock(folio))
-		goto out;
+		return;
 
 	rmap_walk(folio, &rwc);
 
 	if (need_lock)
 		folio_unlock(folio);
-
-out:
-	folio_put(folio);
 }
 
-static void __damon_pa_prepare_access_check(struct damon_region *r)
+static void damon_pa_mkold(unsigned long paddr)
 {
-	r->sampling_addr = damon_rand(r->ar.start, r->ar.end);
-
-	damon_pa_mkold(r->sampling_addr);
-}
+	struct folio *folio = damon_get_folio(PHYS_PFN(paddr));
 
-static void damon_pa_prepare_access_checks(struct damon_ctx *ctx)
-{
-	struct damon_target *t;
-	struct damon_region *r;
+	if (!folio)
+		return;
 
-	damon_for_each_target(t, ctx) {
-		damon_for_each_region(r, t)
-			__damon_pa_prepare_access_check(r);
-	}
+	damon_pa_mkold_folio(folio);
+	folio_put(folio);
 }
 
 static bool __damon_pa_young(struct folio *folio, struct vm_area_struct *vma,
@@ -111,9 +99,8 @@ static bool __damon_pa_young(struct folio *folio, struct vm_area_struct *vma,
 	return *accessed == false;
 }
 
-static bool damon_pa_young(unsigned long paddr, unsigned long *folio_sz)
+static bool damon_pa_young_folio(struct folio *folio)
 {
-	struct folio *folio = damon_get_folio(PHYS_PFN(paddr));
 	bool accessed = false;
 	struct rmap_walk_control rwc = {
 		.arg = &accessed,
@@ -122,32 +109,272 @@ static bool damon_pa_young(unsigned long paddr, unsigned long *folio_sz)
 	};
 	bool need_lock;
 
-	if (!folio)
-		return false;
-
-	if (!folio_mapped(folio) || !folio_raw_mapping(folio)) {
-		if (folio_test_idle(folio))
-			accessed = false;
-		else
-			accessed = true;
-		goto out;
-	}
+	if (!folio_mapped(folio) || !folio_raw_mapping(folio))
+		return !folio_test_idle(folio);
 
 	need_lock = !folio_test_anon(folio) || folio_test_ksm(folio);
 	if (need_lock && !folio_trylock(folio))
-		goto out;
+		return false;
 
 	rmap_walk(folio, &rwc);
 
 	if (need_lock)
 		folio_unlock(folio);
 
-out:
+	return accessed;
+}
+
+static bool damon_pa_young(unsigned long paddr, unsigned long *folio_sz)
+{
+	struct folio *folio = damon_get_folio(PHYS_PFN(paddr));
+	bool accessed;
+
+	if (!folio)
+		return false;
+
+	accessed = damon_pa_young_folio(folio);
 	*folio_sz = folio_size(folio);
 	folio_put(folio);
 	return accessed;
 }
 
+/*
+ * A sampled folio.  Samples are sorted by their rmap anchor, the anon_vma or
+ * address_space returned by folio_raw_mapping(), so that the rmap of all
+ * sampled folios sharing an anchor is walked under a single acquisition of its
+ * lock.  @mapping is NULL for folios which need no or an unbatched rmap walk.
+ */
+struct damon_pa_sample {
+	struct folio *folio;
+	void *mapping;
+	struct damon_region *r;
+	bool accessed;
+	bool deferred;
+};
+
+static int damon_pa_sample_cmp(const void *a, const void *b)
+{
+	const struct damon_pa_sample *x = a, *y = b;
+
+	if (x->mapping != y->mapping)
+		return x->mapping < y->mapping ? -1 : 1;
+	if (x->folio != y->folio)
+		return x->folio < y->folio ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Collect the folios of the sampling addresses of all regions of @ctx, sorted
+ * by their rmap anchor.  Returns NULL if the array cannot be allocated, in
+ * which case the caller falls back to checking the regions one by one.
+ */
+static struct damon_pa_sample *damon_pa_get_samples(struct damon_ctx *ctx,
+		bool prepare, unsigned int *nr)
+{
+	struct damon_pa_sample *samples, *s;
+	struct damon_target *t;
+	struct damon_region *r;
+	struct folio *folio;
+	unsigned int nr_regions = 0;
+
+	damon_for_each_target(t, ctx)
+		nr_regions += damon_nr_regions(t);
+	if (!nr_regions)
+		return NULL;
+
+	samples = kvmalloc_array(nr_regions, sizeof(*samples), GFP_KERNEL);
+	if (!samples)
+		return NULL;
+
+	s = samples;
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t) {
+			if (prepare)
+				r->sampling_addr = damon_rand(r->ar.start,
+						r->ar.end);
+			folio = damon_get_folio(PHYS_PFN(r->sampling_addr));
+			s->folio = folio;
+			s->mapping = NULL;
+			s->r = r;
+			s->accessed = false;
+			s->deferred = false;
+			if (folio && folio_mapped(folio) &&
+					!folio_test_ksm(folio))
+				s->mapping = folio_raw_mapping(folio);
+			s++;
+		}
+	}
+
+	*nr = nr_regions;
+	sort(samples, nr_regions, sizeof(*samples), damon_pa_sample_cmp, NULL);
+	return samples;
+}
+
+static void damon_pa_put_samples(struct damon_pa_sample *samples,
+		unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		if (samples[i].folio)
+			folio_put(samples[i].folio);
+	}
+	kvfree(samples);
+}
+
+/* Walk the rmap of @s, whose anchor lock is held by the caller. */
+static void damon_pa_walk_locked(struct damon_pa_sample *s, bool mkold)
+{
+	struct rmap_walk_control rwc = {
+		.arg = &s->accessed,
+		.rmap_one = mkold ? __damon_pa_mkold : __damon_pa_young,
+	};
+
+	if (!folio_mapped(s->folio)) {
+		if (mkold)
+			folio_set_idle(s->folio);
+		else
+			s->accessed = !folio_test_idle(s->folio);
+		return;
+	}
+	rmap_walk_locked(s->folio, &rwc);
+}
+
+/*
+ * Walk the rmap of the @nr samples starting at @s, which shared one anchor
+ * when they were collected, under a single acquisition of the anon_vma or
+ * i_mmap lock.  The anchors were read without any lock, so every folio is
+ * checked against the locked one again; samples which don't match any more
+ * are marked deferred, to be walked on their own by rmap_walk() after the
+ * lock is dropped.
+ */
+static void damon_pa_walk_group(struct damon_pa_sample *s, unsigned int nr,
+		bool mkold)
+{
+	struct folio *first = s->folio;
+	struct address_space *mapping = NULL;
+	struct anon_vma *anon_vma = NULL;
+	unsigned int i;
+
+	if (folio_test_anon(first)) {
+		anon_vma = folio_lock_anon_vma_read(first, NULL);
+		if (!anon_vma)
+			goto defer_all;
+	} else {
+		/* The locked folio keeps the mapping from being freed */
+		if (!folio_trylock(first))
+			goto defer_all;
+		mapping = folio_mapping(first);
+		if (!mapping || folio_test_anon(first)) {
+			folio_unlock(first);
+			goto defer_all;
+		}
+		i_mmap_lock_read(mapping);
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct folio *folio = s[i].folio;
+
+		if (i && folio == s[i - 1].folio) {
+			s[i].accessed = s[i - 1].accessed;
+			continue;
+		}
+		if (anon_vma) {
+			if (folio_test_anon(folio) && !folio_test_ksm(folio) &&
+			    folio_anon_vma(folio) == anon_vma)
+				damon_pa_walk_locked(&s[i], mkold);
+			else
+				s[i].deferred = true;
+			continue;
+		}
+		/*
+		 * rmap_walk_locked() of a file folio requires the folio lock.
+		 * As damon_pa_mkold() and damon_pa_young() do, skip the folio
+		 * if it is contended.
+		 */
+		if (folio != first && !folio_trylock(folio))
+			continue;
+		if (!folio_test_anon(folio) && folio_mapping(folio) == mapping)
+			damon_pa_walk_locked(&s[i], mkold);
+		else
+			s[i].deferred = true;
+		if (folio != first)
+			folio_unlock(folio);
+	}
+
+	if (anon_vma) {
+		anon_vma_unlock_read(anon_vma);
+	} else {
+		i_mmap_unlock_read(mapping);
+		folio_unlock(first);
+	}
+	return;
+
+defer_all:
+	for (i = 0; i < nr; i++)
+		s[i].deferred = true;
+}
+
+static void damon_pa_walk_samples(struct damon_pa_sample *samples,
+		unsigned int nr, bool mkold)
+{
+	struct damon_pa_sample *s;
+	unsigned int i, j;
+
+	for (i = 0; i < nr; i = j) {
+		for (j = i + 1; j < nr; j++) {
+			if (samples[j].mapping != samples[i].mapping)
+				break;
+		}
+		if (samples[i].mapping && j - i > 1)
+			damon_pa_walk_group(&samples[i], j - i, mkold);
+		else
+			for (s = &samples[i]; s < &samples[j]; s++)
+				s->deferred = true;
+	}
+
+	for (i = 0; i < nr; i++) {
+		s = &samples[i];
+		if (!s->deferred || !s->folio)
+			continue;
+		if (i && s->folio == samples[i - 1].folio) {
+			s->accessed = samples[i - 1].accessed;
+			continue;
+		}
+		if (mkold)
+			damon_pa_mkold_folio(s->folio);
+		else
+			s->accessed = damon_pa_young_folio(s->folio);
+	}
+}
+
+static void __damon_pa_prepare_access_check(struct damon_region *r)
+{
+	r->sampling_addr = damon_rand(r->ar.start, r->ar.end);
+
+	damon_pa_mkold(r->sampling_addr);
+}
+
+static void damon_pa_prepare_access_checks(struct damon_ctx *ctx)
+{
+	struct damon_pa_sample *samples;
+	struct damon_target *t;
+	struct damon_region *r;
+	unsigned int nr;
+
+	samples = damon_pa_get_samples(ctx, true, &nr);
+	if (samples) {
+		damon_pa_walk_samples(samples, nr, true);
+		damon_pa_put_samples(samples, nr);
+		return;
+	}
+
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t)
+			__damon_pa_prepare_access_check(r);
+	}
+}
+
 static void __damon_pa_check_access(struct damon_region *r)
 {
 	static unsigned long last_addr;
@@ -171,9 +398,24 @@ static void __damon_pa_check_access(struct damon_region *r)
 
 static unsigned int damon_pa_check_accesses(struct damon_ctx *ctx)
 {
+	struct damon_pa_sample *samples;
 	struct damon_target *t;
 	struct damon_region *r;
 	unsigned int max_nr_accesses = 0;
+	unsigned int i, nr;
+
+	samples = damon_pa_get_samples(ctx, false, &nr);
+	if (samples) {
+		damon_pa_walk_samples(samples, nr, false);
+		for (i = 0; i < nr; i++) {
+			r = samples[i].r;
+			if (samples[i].accessed)
+				r->nr_accesses++;
+			max_nr_accesses = max(r->nr_accesses, max_nr_accesses);
+		}
+		damon_pa_put_samples(samples, nr);
+		return max_nr_accesses;
+	}
 
 	damon_for_each_target(t, ctx) {
 		damon_for_each_region(r, t) {
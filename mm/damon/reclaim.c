@@ -62,6 +62,20 @@ static struct damos_quota damon_reclaim_quota = {
 };
 DEFINE_DAMON_MODULES_DAMOS_QUOTAS(damon_reclaim_quota);
 
+/*
+ * Desired level of memory pressure stall time in microseconds.
+ *
+ * If this is set, DAMON_RECLAIM tunes its size quota every quota reset
+ * interval (``quota_reset_interval_ms``) so that the system-wide ``some``
+ * memory PSI during the interval gets close to this value, reclaiming more
+ * while there is less pressure and less while there is more.  The other
+ * quotas still cap the tuned quota.  Zero disables the tuning.
+ *
+ * Disabled by default.
+ */
+static unsigned long quota_mem_pressure_us __read_mostly;
+module_param(quota_mem_pressure_us, ulong, 0600);
+
 static struct damos_watermarks damon_reclaim_wmarks = {
 	.metric = DAMOS_WMARK_FREE_MEM_RATE,
 	.interval = 5000000,	/* 5 seconds */
@@ -158,6 +172,12 @@ static int damon_reclaim_apply_parameters(void)
 	if (err)
 		return err;
 
+	damon_reclaim_quota.goal = (struct damos_quota_goal){
+		.metric = quota_mem_pressure_us ?
+			DAMOS_QUOTA_SOME_MEM_PSI_US : DAMOS_QUOTA_GOAL_NONE,
+		.target_value = quota_mem_pressure_us,
+	};
+
 	/* Will be freed by next 'damon_set_schemes()' below */
 	scheme = damon_reclaim_new_scheme();
 	if (!scheme)
@@ -795,6 +795,122 @@ static const struct kobj_type damon_sysfs_weights_ktype = {
 	.default_groups = damon_sysfs_weights_groups,
 };
 
+/*
+ * quota goal directory
+ */
+
+struct damon_sysfs_quota_goal {
+	struct kobject kobj;
+	enum damos_quota_goal_metric metric;
+	unsigned long target_value;
+	unsigned long current_value;
+};
+
+/* This should match with enum damos_quota_goal_metric */
+static const char * const damon_sysfs_quota_goal_metric_strs[] = {
+	"none",
+	"user_input",
+	"some_mem_psi_us",
+	"free_mem_bp",
+};
+
+static struct damon_sysfs_quota_goal *damon_sysfs_quota_goal_alloc(void)
+{
+	return kzalloc(sizeof(struct damon_sysfs_quota_goal), GFP_KERNEL);
+}
+
+static ssize_t target_metric_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%s\n",
+			damon_sysfs_quota_goal_metric_strs[goal->metric]);
+}
+
+static ssize_t target_metric_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+	enum damos_quota_goal_metric m;
+
+	for (m = 0; m < NR_DAMOS_QUOTA_GOAL_METRICS; m++) {
+		if (sysfs_streq(buf, damon_sysfs_quota_goal_metric_strs[m])) {
+			goal->metric = m;
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+
+static ssize_t target_value_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%lu\n", goal->target_value);
+}
+
+static ssize_t target_value_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+	int err = kstrtoul(buf, 0, &goal->target_value);
+
+	return err ? err : count;
+}
+
+static ssize_t current_value_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%lu\n", goal->current_value);
+}
+
+static ssize_t current_value_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+	int err = kstrtoul(buf, 0, &goal->current_value);
+
+	return err ? err : count;
+}
+
+static void damon_sysfs_quota_goal_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct damon_sysfs_quota_goal, kobj));
+}
+
+static struct kobj_attribute damon_sysfs_quota_goal_target_metric_attr =
+		__ATTR_RW_MODE(target_metric, 0600);
+
+static struct kobj_attribute damon_sysfs_quota_goal_target_value_attr =
+		__ATTR_RW_MODE(target_value, 0600);
+
+static struct kobj_attribute damon_sysfs_quota_goal_current_value_attr =
+		__ATTR_RW_MODE(current_value, 0600);
+
+static struct attribute *damon_sysfs_quota_goal_attrs[] = {
+	&damon_sysfs_quota_goal_target_metric_attr.attr,
+	&damon_sysfs_quota_goal_target_value_attr.attr,
+	&damon_sysfs_quota_goal_current_value_attr.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(damon_sysfs_quota_goal);
+
+static const struct kobj_type damon_sysfs_quota_goal_ktype = {
+	.release = damon_sysfs_quota_goal_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_groups = damon_sysfs_quota_goal_groups,
+};
+
 /*
  * quotas directory
  */
@@ -802,9 +918,12 @@ static const struct kobj_type damon_sysfs_weights_ktype = {
 struct damon_sysfs_quotas {
 	struct kobject kobj;
 	struct damon_sysfs_weights *weights;
+	struct damon_sysfs_quota_goal *goal;
 	unsigned long ms;
 	unsigned long sz;
 	unsigned long reset_interval_ms;
+	unsigned long min_sz;
+	unsigned long effective_sz;	/* Effective size quota in bytes */
 };
 
 static struct damon_sysfs_quotas *damon_sysfs_quotas_alloc(void)
@@ -815,6 +934,7 @@ static struct damon_sysfs_quotas *damon_sysfs_quotas_alloc(void)
 static int damon_sysfs_quotas_add_dirs(struct damon_sysfs_quotas *quotas)
 {
 	struct damon_sysfs_weights *weights;
+	struct damon_sysfs_quota_goal *goal;
 	int err;
 
 	weights = damon_sysfs_weights_alloc(0, 0, 0);
@@ -823,15 +943,36 @@ static int damon_sysfs_quotas_add_dirs(struct damon_sysfs_quotas *quotas)
 
 	err = kobject_init_and_add(&weights->kobj, &damon_sysfs_weights_ktype,
 			&quotas->kobj, "weights");
-	if (err)
+	if (err) {
 		kobject_put(&weights->kobj);
-	else
-		quotas->weights = weights;
+		return err;
+	}
+	quotas->weights = weights;
+
+	goal = damon_sysfs_quota_goal_alloc();
+	if (!goal) {
+		err = -ENOMEM;
+		goto put_weights_out;
+	}
+
+	err = kobject_init_and_add(&goal->kobj,
+			&damon_sysfs_quota_goal_ktype, &quotas->kobj, "goal");
+	if (err) {
+		kobject_put(&goal->kobj);
+		goto put_weights_out;
+	}
+	quotas->goal = goal;
+	return 0;
+
+put_weights_out:
+	kobject_put(&weights->kobj);
+	quotas->weights = NULL;
 	return err;
 }
 
 static void damon_sysfs_quotas_rm_dirs(struct damon_sysfs_quotas *quotas)
 {
+	kobject_put(&quotas->goal->kobj);
 	kobject_put(&quotas->weights->kobj);
 }
 
@@ -898,6 +1039,36 @@ static ssize_t reset_interval_ms_store(struct kobject *kobj,
 	return count;
 }
 
+static ssize_t min_bytes_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quotas *quotas = container_of(kobj,
+			struct damon_sysfs_quotas, kobj);
+
+	return sysfs_emit(buf, "%lu\n", quotas->min_sz);
+}
+
+static ssize_t min_bytes_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quotas *quotas = container_of(kobj,
+			struct damon_sysfs_quotas, kobj);
+	int err = kstrtoul(buf, 0, &quotas->min_sz);
+
+	if (err)
+		return -EINVAL;
+	return count;
+}
+
+static ssize_t effective_bytes_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quotas *quotas = container_of(kobj,
+			struct damon_sysfs_quotas, kobj);
+
+	return sysfs_emit(buf, "%lu\n", quotas->effective_sz);
+}
+
 static void damon_sysfs_quotas_release(struct kobject *kobj)
 {
 	kfree(container_of(kobj, struct damon_sysfs_quotas, kobj));
@@ -912,10 +1083,18 @@ static struct kobj_attribute damon_sysfs_quotas_sz_attr =
 static struct kobj_attribute damon_sysfs_quotas_reset_interval_ms_attr =
 		__ATTR_RW_MODE(reset_interval_ms, 0600);
 
+static struct kobj_attribute damon_sysfs_quotas_min_sz_attr =
+		__ATTR_RW_MODE(min_bytes, 0600);
+
+static struct kobj_attribute damon_sysfs_quotas_effective_bytes_attr =
+		__ATTR_RO_MODE(effective_bytes, 0400);
+
 static struct attribute *damon_sysfs_quotas_attrs[] = {
 	&damon_sysfs_quotas_ms_attr.attr,
 	&damon_sysfs_quotas_sz_attr.attr,
 	&damon_sysfs_quotas_reset_interval_ms_attr.attr,
+	&damon_sysfs_quotas_min_sz_attr.attr,
+	&damon_sysfs_quotas_effective_bytes_attr.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(damon_sysfs_quotas);
@@ -1496,10 +1675,17 @@ static struct damos *damon_sysfs_mk_scheme(
 		.min_age_region = access_pattern->age->min,
 		.max_age_region = access_pattern->age->max,
 	};
+	struct damon_sysfs_quota_goal *sysfs_goal = sysfs_quotas->goal;
 	struct damos_quota quota = {
 		.ms = sysfs_quotas->ms,
 		.sz = sysfs_quotas->sz,
 		.reset_interval = sysfs_quotas->reset_interval_ms,
+		.goal = {
+			.metric = sysfs_goal->metric,
+			.target_value = sysfs_goal->target_value,
+			.current_value = sysfs_goal->current_value,
+		},
+		.min_sz = sysfs_quotas->min_sz,
 		.weight_sz = sysfs_weights->sz,
 		.weight_nr_accesses = sysfs_weights->nr_accesses,
 		.weight_age = sysfs_weights->age,
@@ -1547,6 +1733,14 @@ static void damon_sysfs_update_scheme(struct damos *scheme,
 	scheme->quota.ms = sysfs_quotas->ms;
 	scheme->quota.sz = sysfs_quotas->sz;
 	scheme->quota.reset_interval = sysfs_quotas->reset_interval_ms;
+	if (scheme->quota.goal.metric != sysfs_quotas->goal->metric)
+		scheme->quota.goal.last_psi_total = 0;
+	scheme->quota.goal.metric = sysfs_quotas->goal->metric;
+	scheme->quota.goal.target_value = sysfs_quotas->goal->target_value;
+	if (sysfs_quotas->goal->metric == DAMOS_QUOTA_USER_INPUT)
+		scheme->quota.goal.current_value =
+			sysfs_quotas->goal->current_value;
+	scheme->quota.min_sz = sysfs_quotas->min_sz;
 	scheme->quota.weight_sz = sysfs_weights->sz;
 	scheme->quota.weight_nr_accesses = sysfs_weights->nr_accesses;
 	scheme->quota.weight_age = sysfs_weights->age;
@@ -1614,6 +1808,33 @@ void damon_sysfs_schemes_update_stats(
 	}
 }
 
+/*
+ * Copy the effective size quotas and the current goal metric values of the
+ * schemes of @ctx to the sysfs files.
+ */
+void damon_sysfs_schemes_update_effective_quotas(
+		struct damon_sysfs_schemes *sysfs_schemes,
+		struct damon_ctx *ctx)
+{
+	struct damos *scheme;
+	int schemes_idx = 0;
+
+	damon_for_each_scheme(scheme, ctx) {
+		struct damon_sysfs_quotas *sysfs_quotas;
+
+		/* user could have removed the scheme sysfs dir */
+		if (schemes_idx >= sysfs_schemes->nr)
+			break;
+
+		sysfs_quotas =
+			sysfs_schemes->schemes_arr[schemes_idx++]->quotas;
+		sysfs_quotas->effective_sz = scheme->quota.esz;
+		if (scheme->quota.goal.metric != DAMOS_QUOTA_USER_INPUT)
+			sysfs_quotas->goal->current_value =
+				scheme->quota.goal.current_value;
+	}
+}
+
 /*
  * damon_sysfs_schemes that need to update its schemes regions dir.  Protected
  * by damon_sysfs_lock
@@ -544,6 +544,7 @@ struct damon_sysfs_attrs {
 	struct kobject kobj;
 	struct damon_sysfs_intervals *intervals;
 	struct damon_sysfs_ul_range *nr_regions_range;
+	unsigned int nr_workers;
 };
 
 static struct damon_sysfs_attrs *damon_sysfs_attrs_alloc(void)
@@ -553,6 +554,7 @@ static struct damon_sysfs_attrs *damon_sysfs_attrs_alloc(void)
 	if (!attrs)
 		return NULL;
 	attrs->kobj = (struct kobject){};
+	attrs->nr_workers = 0;
 	return attrs;
 }
 
@@ -602,12 +604,40 @@ static void damon_sysfs_attrs_rm_dirs(struct damon_sysfs_attrs *attrs)
 	kobject_put(&attrs->intervals->kobj);
 }
 
+static ssize_t nr_workers_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_attrs *attrs = container_of(kobj,
+			struct damon_sysfs_attrs, kobj);
+
+	return sysfs_emit(buf, "%u\n", attrs->nr_workers);
+}
+
+static ssize_t nr_workers_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_attrs *attrs = container_of(kobj,
+			struct damon_sysfs_attrs, kobj);
+	unsigned int nr;
+	int err = kstrtouint(buf, 0, &nr);
+
+	if (err)
+		return err;
+
+	attrs->nr_workers = nr;
+	return count;
+}
+
 static void damon_sysfs_attrs_release(struct kobject *kobj)
 {
 	kfree(container_of(kobj, struct damon_sysfs_attrs, kobj));
 }
 
+static struct kobj_attribute damon_sysfs_attrs_nr_workers_attr =
+		__ATTR_RW_MODE(nr_workers, 0600);
+
 static struct attribute *damon_sysfs_attrs_attrs[] = {
+	&damon_sysfs_attrs_nr_workers_attr.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(damon_sysfs_attrs);
@@ -932,6 +962,307 @@ static const struct kobj_type damon_sysfs_contexts_ktype = {
 	.default_groups = damon_sysfs_contexts_groups,
 };
 
+/*
+ * phase_times directory
+ */
+
+struct damon_sysfs_phase_times {
+	struct kobject kobj;
+	struct damon_ctx **damon_ctx;	/* of the kdamond */
+};
+
+static struct damon_sysfs_phase_times *damon_sysfs_phase_times_alloc(
+		struct damon_ctx **damon_ctx)
+{
+	struct damon_sysfs_phase_times *times = kzalloc(sizeof(*times),
+			GFP_KERNEL);
+
+	if (!times)
+		return NULL;
+	times->damon_ctx = damon_ctx;
+	return times;
+}
+
+/*
+ * Read one of the &struct damon_phase_stats fields of the context that was
+ * last started by the kdamond, at @offset.
+ */
+static ssize_t damon_sysfs_phase_time_show(struct kobject *kobj, char *buf,
+		size_t offset)
+{
+	struct damon_sysfs_phase_times *times = container_of(kobj,
+			struct damon_sysfs_phase_times, kobj);
+	struct damon_ctx *ctx;
+	u64 val = 0;
+
+	if (!mutex_trylock(&damon_sysfs_lock))
+		return -EBUSY;
+	ctx = *times->damon_ctx;
+	if (ctx)
+		val = READ_ONCE(*(u64 *)((char *)&ctx->phase_stats + offset));
+	mutex_unlock(&damon_sysfs_lock);
+	return sysfs_emit(buf, "%llu\n", val);
+}
+
+static ssize_t prepare_ns_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return damon_sysfs_phase_time_show(kobj, buf,
+			offsetof(struct damon_phase_stats, prepare_ns));
+}
+
+static ssize_t check_ns_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return damon_sysfs_phase_time_show(kobj, buf,
+			offsetof(struct damon_phase_stats, check_ns));
+}
+
+static ssize_t aggr_ns_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return damon_sysfs_phase_time_show(kobj, buf,
+			offsetof(struct damon_phase_stats, aggr_ns));
+}
+
+static ssize_t update_ns_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return damon_sysfs_phase_time_show(kobj, buf,
+			offsetof(struct damon_phase_stats, update_ns));
+}
+
+static ssize_t nr_samples_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return damon_sysfs_phase_time_show(kobj, buf,
+			offsetof(struct damon_phase_stats, nr_samples));
+}
+
+static void damon_sysfs_phase_times_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct damon_sysfs_phase_times, kobj));
+}
+
+static struct kobj_attribute damon_sysfs_phase_times_prepare_ns_attr =
+		__ATTR_RO_MODE(prepare_ns, 0400);
+
+static struct kobj_attribute damon_sysfs_phase_times_check_ns_attr =
+		__ATTR_RO_MODE(check_ns, 0400);
+
+static struct kobj_attribute damon_sysfs_phase_times_aggr_ns_attr =
+		__ATTR_RO_MODE(aggr_ns, 0400);
+
+static struct kobj_attribute damon_sysfs_phase_times_update_ns_attr =
+		__ATTR_RO_MODE(update_ns, 0400);
+
+static struct kobj_attribute damon_sysfs_phase_times_nr_samples_attr =
+		__ATTR_RO_MODE(nr_samples, 0400);
+
+static struct attribute *damon_sysfs_phase_times_attrs[] = {
+	&damon_sysfs_phase_times_prepare_ns_attr.attr,
+	&damon_sysfs_phase_times_check_ns_attr.attr,
+	&damon_sysfs_phase_times_aggr_ns_attr.attr,
+	&damon_sysfs_phase_times_update_ns_attr.attr,
+	&damon_sysfs_phase_times_nr_samples_attr.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(damon_sysfs_phase_times);
+
+static const struct kobj_type damon_sysfs_phase_times_ktype = {
+	.release = damon_sysfs_phase_times_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_groups = damon_sysfs_phase_times_groups,
+};
+
+/*
+ * snapshot directory
+ */
+
+/*
+ * struct damon_sysfs_region_record - A region in the snapshot/regions file.
+ * @start:		Start address of the region (inclusive).
+ * @end:		End address of the region (exclusive).
+ * @nr_accesses:	Access frequency of the region.
+ * @age:		Age of the region.
+ * @target_idx:		Index of the monitoring target of the region.
+ * @reserved:		Zero.
+ *
+ * The regions file is an array of these records, in the order of the targets
+ * and their regions.
+ */
+struct damon_sysfs_region_record {
+	__u64 start;
+	__u64 end;
+	__u32 nr_accesses;
+	__u32 age;
+	__u32 target_idx;
+	__u32 reserved;
+};
+
+struct damon_sysfs_snapshot {
+	struct kobject kobj;
+	struct damon_ctx **damon_ctx;	/* of the kdamond */
+	struct damon_sysfs_region_record *records;
+	unsigned int nr_records;
+};
+
+static struct damon_sysfs_snapshot *damon_sysfs_snapshot_alloc(
+		struct damon_ctx **damon_ctx)
+{
+	struct damon_sysfs_snapshot *snapshot = kzalloc(sizeof(*snapshot),
+			GFP_KERNEL);
+
+	if (!snapshot)
+		return NULL;
+	snapshot->damon_ctx = damon_ctx;
+	return snapshot;
+}
+
+/*
+ * Take a snapshot of the regions of @ctx.  Should be called from DAMON
+ * callbacks while holding ``damon_sysfs_lock``.
+ */
+static int damon_sysfs_snapshot_update(struct damon_sysfs_snapshot *snapshot,
+		struct damon_ctx *ctx)
+{
+	struct damon_sysfs_region_record *records, *rec;
+	struct damon_target *t;
+	struct damon_region *r;
+	unsigned int nr = 0, target_idx = 0;
+
+	damon_for_each_target(t, ctx)
+		nr += damon_nr_regions(t);
+
+	records = kvcalloc(nr, sizeof(*records), GFP_KERNEL);
+	if (nr && !records)
+		return -ENOMEM;
+
+	rec = records;
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t) {
+			rec->start = r->ar.start;
+			rec->end = r->ar.end;
+			rec->nr_accesses = r->nr_accesses;
+			rec->age = r->age;
+			rec->target_idx = target_idx;
+			rec++;
+		}
+		target_idx++;
+	}
+
+	kvfree(snapshot->records);
+	snapshot->records = records;
+	snapshot->nr_records = nr;
+	return 0;
+}
+
+static ssize_t regions_read(struct file *file, struct kobject *kobj,
+		struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct damon_sysfs_snapshot *snapshot = container_of(kobj,
+			struct damon_sysfs_snapshot, kobj);
+	size_t size;
+
+	if (!mutex_trylock(&damon_sysfs_lock))
+		return -EBUSY;
+	size = snapshot->nr_records * sizeof(*snapshot->records);
+	if (off < size) {
+		count = min_t(size_t, count, size - off);
+		memcpy(buf, (char *)snapshot->records + off, count);
+	} else {
+		count = 0;
+	}
+	mutex_unlock(&damon_sysfs_lock);
+	return count;
+}
+
+static ssize_t nr_regions_snapshot_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_snapshot *snapshot = container_of(kobj,
+			struct damon_sysfs_snapshot, kobj);
+	unsigned int nr;
+
+	if (!mutex_trylock(&damon_sysfs_lock))
+		return -EBUSY;
+	nr = snapshot->nr_records;
+	mutex_unlock(&damon_sysfs_lock);
+	return sysfs_emit(buf, "%u\n", nr);
+}
+
+/*
+ * Show the access frequency histogram of the context that was last started
+ * by the kdamond.  Each line is the frequency range of a bucket, in percent
+ * of the maximum, and the total size of its regions in bytes.
+ */
+static ssize_t access_histogram_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_snapshot *snapshot = container_of(kobj,
+			struct damon_sysfs_snapshot, kobj);
+	unsigned long sz[DAMON_ACCESS_HIST_NR_BUCKETS] = {};
+	struct damon_ctx *ctx;
+	int i, len = 0;
+
+	if (!mutex_trylock(&damon_sysfs_lock))
+		return -EBUSY;
+	ctx = *snapshot->damon_ctx;
+	if (ctx) {
+		for (i = 0; i < DAMON_ACCESS_HIST_NR_BUCKETS; i++)
+			sz[i] = READ_ONCE(ctx->access_hist.sz[i]);
+	}
+	mutex_unlock(&damon_sysfs_lock);
+
+	for (i = 0; i < DAMON_ACCESS_HIST_NR_BUCKETS; i++)
+		len += sysfs_emit_at(buf, len, "%d %d %lu\n",
+				i * 100 / DAMON_ACCESS_HIST_NR_BUCKETS,
+				(i + 1) * 100 / DAMON_ACCESS_HIST_NR_BUCKETS,
+				sz[i]);
+	return len;
+}
+
+static void damon_sysfs_snapshot_release(struct kobject *kobj)
+{
+	struct damon_sysfs_snapshot *snapshot = container_of(kobj,
+			struct damon_sysfs_snapshot, kobj);
+
+	kvfree(snapshot->records);
+	kfree(snapshot);
+}
+
+static struct kobj_attribute damon_sysfs_snapshot_nr_regions_attr =
+		__ATTR(nr_regions, 0400, nr_regions_snapshot_show, NULL);
+
+static struct kobj_attribute damon_sysfs_snapshot_access_histogram_attr =
+		__ATTR_RO_MODE(access_histogram, 0400);
+
+static struct bin_attribute damon_sysfs_snapshot_regions_attr =
+		__BIN_ATTR(regions, 0400, regions_read, NULL, 0);
+
+static struct attribute *damon_sysfs_snapshot_attrs[] = {
+	&damon_sysfs_snapshot_nr_regions_attr.attr,
+	&damon_sysfs_snapshot_access_histogram_attr.attr,
+	NULL,
+};
+
+static struct bin_attribute *damon_sysfs_snapshot_bin_attrs[] = {
+	&damon_sysfs_snapshot_regions_attr,
+	NULL,
+};
+
+static const struct attribute_group damon_sysfs_snapshot_group = {
+	.attrs = damon_sysfs_snapshot_attrs,
+	.bin_attrs = damon_sysfs_snapshot_bin_attrs,
+};
+__ATTRIBUTE_GROUPS(damon_sysfs_snapshot);
+
+static const struct kobj_type damon_sysfs_snapshot_ktype = {
+	.release = damon_sysfs_snapshot_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_groups = damon_sysfs_snapshot_groups,
+};
+
 /*
  * kdamond directory
  */
@@ -939,6 +1270,8 @@ static const struct kobj_type damon_sysfs_contexts_ktype = {
 struct damon_sysfs_kdamond {
 	struct kobject kobj;
 	struct damon_sysfs_contexts *contexts;
+	struct damon_sysfs_phase_times *phase_times;
+	struct damon_sysfs_snapshot *snapshot;
 	struct damon_ctx *damon_ctx;
 };
 
@@ -950,6 +1283,8 @@ static struct damon_sysfs_kdamond *damon_sysfs_kdamond_alloc(void)
 static int damon_sysfs_kdamond_add_dirs(struct damon_sysfs_kdamond *kdamond)
 {
 	struct damon_sysfs_contexts *contexts;
+	struct damon_sysfs_phase_times *phase_times;
+	struct damon_sysfs_snapshot *snapshot;
 	int err;
 
 	contexts = damon_sysfs_contexts_alloc();
@@ -965,11 +1300,51 @@ static int damon_sysfs_kdamond_add_dirs(struct damon_sysfs_kdamond *kdamond)
 	}
 	kdamond->contexts = contexts;
 
+	phase_times = damon_sysfs_phase_times_alloc(&kdamond->damon_ctx);
+	if (!phase_times) {
+		err = -ENOMEM;
+		goto rm_contexts_out;
+	}
+
+	err = kobject_init_and_add(&phase_times->kobj,
+			&damon_sysfs_phase_times_ktype, &kdamond->kobj,
+			"phase_times");
+	if (err) {
+		kobject_put(&phase_times->kobj);
+		goto rm_contexts_out;
+	}
+	kdamond->phase_times = phase_times;
+
+	snapshot = damon_sysfs_snapshot_alloc(&kdamond->damon_ctx);
+	if (!snapshot) {
+		err = -ENOMEM;
+		goto rm_phase_times_out;
+	}
+
+	err = kobject_init_and_add(&snapshot->kobj,
+			&damon_sysfs_snapshot_ktype, &kdamond->kobj,
+			"snapshot");
+	if (err) {
+		kobject_put(&snapshot->kobj);
+		goto rm_phase_times_out;
+	}
+	kdamond->snapshot = snapshot;
+
+	return 0;
+
+rm_phase_times_out:
+	kobject_put(&phase_times->kobj);
+	kdamond->phase_times = NULL;
+rm_contexts_out:
+	kobject_put(&contexts->kobj);
+	kdamond->contexts = NULL;
 	return err;
 }
 
 static void damon_sysfs_kdamond_rm_dirs(struct damon_sysfs_kdamond *kdamond)
 {
+	kobject_put(&kdamond->snapshot->kobj);
+	kobject_put(&kdamond->phase_times->kobj);
 	damon_sysfs_contexts_rm_dirs(kdamond->contexts);
 	kobject_put(&kdamond->contexts->kobj);
 }
@@ -1009,6 +1384,16 @@ enum damon_sysfs_cmd {
 	 * regions
 	 */
 	DAMON_SYSFS_CMD_CLEAR_SCHEMES_TRIED_REGIONS,
+	/*
+	 * @DAMON_SYSFS_CMD_UPDATE_SCHEMES_EFFECTIVE_QUOTAS: Update the effective
+	 * quotas of the schemes.
+	 */
+	DAMON_SYSFS_CMD_UPDATE_SCHEMES_EFFECTIVE_QUOTAS,
+	/*
+	 * @DAMON_SYSFS_CMD_UPDATE_REGIONS_SNAPSHOT: Update the regions snapshot
+	 * sysfs files.
+	 */
+	DAMON_SYSFS_CMD_UPDATE_REGIONS_SNAPSHOT,
 	/*
 	 * @NR_DAMON_SYSFS_CMDS: Total number of DAMON sysfs commands.
 	 */
@@ -1023,6 +1408,8 @@ static const char * const damon_sysfs_cmd_strs[] = {
 	"update_schemes_stats",
 	"update_schemes_tried_regions",
 	"clear_schemes_tried_regions",
+	"update_schemes_effective_quotas",
+	"update_regions_snapshot",
 };
 
 /*
@@ -1074,6 +1461,7 @@ static int damon_sysfs_set_attrs(struct damon_ctx *ctx,
 		.ops_update_interval = sys_intervals->update_us,
 		.min_nr_regions = sys_nr_regions->min,
 		.max_nr_regions = sys_nr_regions->max,
+		.nr_workers = sys_attrs->nr_workers,
 	};
 	return damon_set_attrs(ctx, &attrs);
 }
@@ -1247,6 +1635,28 @@ static int damon_sysfs_upd_schemes_stats(struct damon_sysfs_kdamond *kdamond)
 	return 0;
 }
 
+static int damon_sysfs_upd_schemes_effective_quotas(
+		struct damon_sysfs_kdamond *kdamond)
+{
+	struct damon_ctx *ctx = kdamond->damon_ctx;
+
+	if (!ctx)
+		return -EINVAL;
+	damon_sysfs_schemes_update_effective_quotas(
+			kdamond->contexts->contexts_arr[0]->schemes, ctx);
+	return 0;
+}
+
+static int damon_sysfs_upd_regions_snapshot(
+		struct damon_sysfs_kdamond *kdamond)
+{
+	struct damon_ctx *ctx = kdamond->damon_ctx;
+
+	if (!ctx)
+		return -EINVAL;
+	return damon_sysfs_snapshot_update(kdamond->snapshot, ctx);
+}
+
 static int damon_sysfs_upd_schemes_regions_start(
 		struct damon_sysfs_kdamond *kdamond)
 {
@@ -1363,6 +1773,12 @@ static int damon_sysfs_cmd_request_callback(struct damon_ctx *c)
 	case DAMON_SYSFS_CMD_CLEAR_SCHEMES_TRIED_REGIONS:
 		err = damon_sysfs_clear_schemes_regions(kdamond);
 		break;
+	case DAMON_SYSFS_CMD_UPDATE_SCHEMES_EFFECTIVE_QUOTAS:
+		err = damon_sysfs_upd_schemes_effective_quotas(kdamond);
+		break;
+	case DAMON_SYSFS_CMD_UPDATE_REGIONS_SNAPSHOT:
+		err = damon_sysfs_upd_regions_snapshot(kdamond);
+		break;
 	default:
 		break;
 	}
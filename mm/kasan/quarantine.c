@@ -85,20 +85,49 @@ static void qlist_move_all(struct qlist_head *from, struct qlist_head *to)
 	(1024 > 4 * CONFIG_NR_CPUS ? 1024 : 4 * CONFIG_NR_CPUS)
 
 /*
- * The object quarantine consists of per-cpu queues and a global queue,
- * guarded by quarantine_lock.
+ * The object quarantine consists of per-cpu queues and per-node global
+ * queues. Full per-cpu batches are moved to the global queue of the nearest
+ * memory node of the CPU, and each node's queue has its own lock and a size
+ * limit in proportion to the node's memory, so that the limits add up to the
+ * global one. Any reduction enforces the limits of all queues. Until the
+ * per-node queues are allocated, and for nodes without one, the shared global
+ * queue is used instead.
  */
 static DEFINE_PER_CPU(struct qlist_head, cpu_quarantine);
 
-/* Round-robin FIFO array of batches. */
-static struct qlist_head global_quarantine[QUARANTINE_BATCHES];
-static int quarantine_head;
-static int quarantine_tail;
-/* Total size of all objects in global_quarantine across all batches. */
-static unsigned long quarantine_size;
-static DEFINE_RAW_SPINLOCK(quarantine_lock);
+struct global_quarantine {
+	/* Round-robin FIFO array of batches. */
+	struct qlist_head batches[QUARANTINE_BATCHES];
+	int head;
+	int tail;
+	/* Total size of all objects in batches. */
+	unsigned long size;
+	/* Maximum size of the queue. */
+	unsigned long max_size;
+	/*
+	 * Target size of a batch.
+	 * Usually equal to QUARANTINE_PERCPU_SIZE unless we have too much RAM.
+	 */
+	unsigned long batch_size;
+	/* Node of the queue, or NUMA_NO_NODE for the shared queue. */
+	int nid;
+	raw_spinlock_t lock;
+};
+
+static struct global_quarantine shared_quarantine = {
+	.nid = NUMA_NO_NODE,
+	.lock = __RAW_SPIN_LOCK_UNLOCKED(shared_quarantine.lock),
+};
+static struct global_quarantine *node_quarantine[MAX_NUMNODES] __read_mostly;
 DEFINE_STATIC_SRCU(remove_cache_srcu);
 
+static struct global_quarantine *quarantine_of(int nid)
+{
+	struct global_quarantine *gq = READ_ONCE(node_quarantine[nid]);
+
+	return gq ? gq : &shared_quarantine;
+}
+
 struct cpu_shrink_qlist {
 	raw_spinlock_t lock;
 	struct qlist_head qlist;
@@ -108,15 +137,6 @@ static DEFINE_PER_CPU(struct cpu_shrink_qlist, shrink_qlist) = {
 	.lock = __RAW_SPIN_LOCK_UNLOCKED(shrink_qlist.lock),
 };
 
-/* Maximum size of the global queue. */
-static unsigned long quarantine_max_size;
-
-/*
- * Target size of a batch in global_quarantine.
- * Usually equal to QUARANTINE_PERCPU_SIZE unless we have too much RAM.
- */
-static unsigned long quarantine_batch_size;
-
 /*
  * The fraction of physical memory the quarantine is allowed to occupy.
  * Quarantine doesn't support memory shrinker with SLAB allocator, so we keep
@@ -219,22 +239,24 @@ bool kasan_quarantine_put(struct kmem_cache *cache, void *object)
 	}
 	qlist_put(q, &meta->quarantine_link, cache->size);
 	if (unlikely(q->bytes > QUARANTINE_PERCPU_SIZE)) {
+		struct global_quarantine *gq = quarantine_of(numa_mem_id());
+
 		qlist_move_all(q, &temp);
 
-		raw_spin_lock(&quarantine_lock);
-		WRITE_ONCE(quarantine_size, quarantine_size + temp.bytes);
-		qlist_move_all(&temp, &global_quarantine[quarantine_tail]);
-		if (global_quarantine[quarantine_tail].bytes >=
-				READ_ONCE(quarantine_batch_size)) {
+		raw_spin_lock(&gq->lock);
+		WRITE_ONCE(gq->size, gq->size + temp.bytes);
+		qlist_move_all(&temp, &gq->batches[gq->tail]);
+		if (gq->batches[gq->tail].bytes >=
+				READ_ONCE(gq->batch_size)) {
 			int new_tail;
 
-			new_tail = quarantine_tail + 1;
+			new_tail = gq->tail + 1;
 			if (new_tail == QUARANTINE_BATCHES)
 				new_tail = 0;
-			if (new_tail != quarantine_head)
-				quarantine_tail = new_tail;
+			if (new_tail != gq->head)
+				gq->tail = new_tail;
 		}
-		raw_spin_unlock(&quarantine_lock);
+		raw_spin_unlock(&gq->lock);
 	}
 
 	local_irq_restore(flags);
@@ -242,15 +264,45 @@ bool kasan_quarantine_put(struct kmem_cache *cache, void *object)
 	return true;
 }
 
-void kasan_quarantine_reduce(void)
+static unsigned long node_managed_pages(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	unsigned long pages = 0;
+	int i;
+
+	for (i = 0; i < MAX_NR_ZONES; i++)
+		pages += zone_managed_pages(&pgdat->node_zones[i]);
+	return pages;
+}
+
+/*
+ * Pages of the memory @gq accounts for: those of its node, or for the shared
+ * queue those of all nodes without a queue of their own.
+ */
+static unsigned long quarantine_managed_pages(struct global_quarantine *gq)
+{
+	unsigned long pages;
+	int nid;
+
+	if (gq->nid != NUMA_NO_NODE)
+		return node_managed_pages(gq->nid);
+
+	pages = totalram_pages();
+	for_each_node_state(nid, N_MEMORY) {
+		if (READ_ONCE(node_quarantine[nid]))
+			pages -= min(pages, node_managed_pages(nid));
+	}
+	return pages;
+}
+
+static void quarantine_reduce(struct global_quarantine *gq)
 {
 	size_t total_size, new_quarantine_size, percpu_quarantines;
-	unsigned long flags;
+	unsigned long flags, pages;
 	int srcu_idx;
 	struct qlist_head to_free = QLIST_INIT;
 
-	if (likely(READ_ONCE(quarantine_size) <=
-		   READ_ONCE(quarantine_max_size)))
+	if (likely(READ_ONCE(gq->size) <= READ_ONCE(gq->max_size)))
 		return;
 
 	/*
@@ -263,36 +315,62 @@ void kasan_quarantine_reduce(void)
 	 * expected case).
 	 */
 	srcu_idx = srcu_read_lock(&remove_cache_srcu);
-	raw_spin_lock_irqsave(&quarantine_lock, flags);
+	raw_spin_lock_irqsave(&gq->lock, flags);
 
 	/*
 	 * Update quarantine size in case of hotplug. Allocate a fraction of
-	 * the installed memory to quarantine minus per-cpu queue limits.
+	 * the installed memory of the queue to quarantine minus the queue's
+	 * share of the per-cpu queue limits.
 	 */
-	total_size = (totalram_pages() << PAGE_SHIFT) /
-		QUARANTINE_FRACTION;
-	percpu_quarantines = QUARANTINE_PERCPU_SIZE * num_online_cpus();
+	pages = quarantine_managed_pages(gq);
+	total_size = (pages << PAGE_SHIFT) / QUARANTINE_FRACTION;
+	percpu_quarantines = mult_frac((size_t)QUARANTINE_PERCPU_SIZE *
+			num_online_cpus(), pages, max(totalram_pages(), 1UL));
 	new_quarantine_size = (total_size < percpu_quarantines) ?
 		0 : total_size - percpu_quarantines;
-	WRITE_ONCE(quarantine_max_size, new_quarantine_size);
+	WRITE_ONCE(gq->max_size, new_quarantine_size);
 	/* Aim at consuming at most 1/2 of slots in quarantine. */
-	WRITE_ONCE(quarantine_batch_size, max((size_t)QUARANTINE_PERCPU_SIZE,
+	WRITE_ONCE(gq->batch_size, max((size_t)QUARANTINE_PERCPU_SIZE,
 		2 * total_size / QUARANTINE_BATCHES));
 
-	if (likely(quarantine_size > quarantine_max_size)) {
-		qlist_move_all(&global_quarantine[quarantine_head], &to_free);
-		WRITE_ONCE(quarantine_size, quarantine_size - to_free.bytes);
-		quarantine_head++;
-		if (quarantine_head == QUARANTINE_BATCHES)
-			quarantine_head = 0;
+	if (likely(gq->size > gq->max_size)) {
+		qlist_move_all(&gq->batches[gq->head], &to_free);
+		WRITE_ONCE(gq->size, gq->size - to_free.bytes);
+		gq->head++;
+		if (gq->head == QUARANTINE_BATCHES)
+			gq->head = 0;
 	}
 
-	raw_spin_unlock_irqrestore(&quarantine_lock, flags);
+	raw_spin_unlock_irqrestore(&gq->lock, flags);
 
 	qlist_free_all(&to_free, NULL);
 	srcu_read_unlock(&remove_cache_srcu, srcu_idx);
 }
 
+void kasan_quarantine_reduce(void)
+{
+	struct global_quarantine *local = quarantine_of(numa_mem_id());
+	struct global_quarantine *gq;
+	int nid;
+
+	quarantine_reduce(local);
+
+	/*
+	 * Reduction runs on allocation, and the CPUs of a node may free much
+	 * more than they allocate. Check the other queues too, so that the
+	 * global limit holds no matter where objects are allocated. Queues
+	 * within their limit cost one lockless size check each.
+	 */
+	for_each_node_state(nid, N_MEMORY) {
+		gq = READ_ONCE(node_quarantine[nid]);
+		if (gq && gq != local)
+			quarantine_reduce(gq);
+	}
+	/* Also drains what was queued before the per-node queues were set up */
+	if (local != &shared_quarantine)
+		quarantine_reduce(&shared_quarantine);
+}
+
 static void qlist_move_cache(struct qlist_head *from,
 				   struct qlist_head *to,
 				   struct kmem_cache *cache)
@@ -344,12 +422,34 @@ static void per_cpu_remove_cache(void *arg)
 	__per_cpu_remove_cache(q, arg);
 }
 
+static void quarantine_remove_cache(struct global_quarantine *gq,
+				    struct kmem_cache *cache)
+{
+	unsigned long flags, i;
+	struct qlist_head to_free = QLIST_INIT;
+
+	raw_spin_lock_irqsave(&gq->lock, flags);
+	for (i = 0; i < QUARANTINE_BATCHES; i++) {
+		if (qlist_empty(&gq->batches[i]))
+			continue;
+		qlist_move_cache(&gq->batches[i], &to_free, cache);
+		/* Scanning whole quarantine can take a while. */
+		raw_spin_unlock_irqrestore(&gq->lock, flags);
+		cond_resched();
+		raw_spin_lock_irqsave(&gq->lock, flags);
+	}
+	raw_spin_unlock_irqrestore(&gq->lock, flags);
+
+	qlist_free_all(&to_free, cache);
+}
+
 /* Free all quarantined objects belonging to cache. */
 void kasan_quarantine_remove_cache(struct kmem_cache *cache)
 {
-	unsigned long flags, i;
+	unsigned long flags;
 	struct qlist_head to_free = QLIST_INIT;
-	int cpu;
+	struct global_quarantine *gq;
+	int cpu, nid;
 	struct cpu_shrink_qlist *sq;
 
 	/*
@@ -369,19 +469,12 @@ void kasan_quarantine_remove_cache(struct kmem_cache *cache)
 	}
 	qlist_free_all(&to_free, cache);
 
-	raw_spin_lock_irqsave(&quarantine_lock, flags);
-	for (i = 0; i < QUARANTINE_BATCHES; i++) {
-		if (qlist_empty(&global_quarantine[i]))
-			continue;
-		qlist_move_cache(&global_quarantine[i], &to_free, cache);
-		/* Scanning whole quarantine can take a while. */
-		raw_spin_unlock_irqrestore(&quarantine_lock, flags);
-		cond_resched();
-		raw_spin_lock_irqsave(&quarantine_lock, flags);
+	quarantine_remove_cache(&shared_quarantine, cache);
+	for_each_node(nid) {
+		gq = READ_ONCE(node_quarantine[nid]);
+		if (gq)
+			quarantine_remove_cache(gq, cache);
 	}
-	raw_spin_unlock_irqrestore(&quarantine_lock, flags);
-
-	qlist_free_all(&to_free, cache);
 
 	synchronize_srcu(&remove_cache_srcu);
 }
@@ -407,10 +500,34 @@ static int kasan_cpu_offline(unsigned int cpu)
 	return 0;
 }
 
+static void __init kasan_node_quarantine_init(void)
+{
+	struct global_quarantine *gq;
+	int nid;
+
+	/* A single node keeps using the shared queue. */
+	if (num_node_state(N_MEMORY) < 2)
+		return;
+
+	for_each_node_state(nid, N_MEMORY) {
+		gq = kvzalloc_node(sizeof(*gq), GFP_KERNEL, nid);
+		if (!gq) {
+			pr_warn("kasan: no quarantine for node %d, using the shared one\n",
+				nid);
+			continue;
+		}
+		gq->nid = nid;
+		raw_spin_lock_init(&gq->lock);
+		WRITE_ONCE(node_quarantine[nid], gq);
+	}
+}
+
 static int __init kasan_cpu_quarantine_init(void)
 {
 	int ret = 0;
 
+	kasan_node_quarantine_init();
+
 	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "mm/kasan:online",
 				kasan_cpu_online, kasan_cpu_offline);
 	if (ret < 0)
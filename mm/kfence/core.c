@@ -118,9 +118,18 @@ EXPORT_SYMBOL(__kfence_pool); /* Export for test modules. */
 static_assert(CONFIG_KFENCE_NUM_OBJECTS > 0);
 struct kfence_metadata kfence_metadata[CONFIG_KFENCE_NUM_OBJECTS];
 
-/* Freelist with available objects. */
-static struct list_head kfence_freelist = LIST_HEAD_INIT(kfence_freelist);
-static DEFINE_RAW_SPINLOCK(kfence_freelist_lock); /* Lock protecting freelist. */
+/*
+ * Freelists with available objects, one per node of the object pages, so that
+ * allocations prefer node-local objects and CPUs of different nodes do not
+ * contend on the same lock.
+ */
+struct kfence_freelist {
+	struct list_head list;
+	raw_spinlock_t lock; /* Lock protecting list. */
+};
+
+static struct kfence_freelist kfence_freelist[MAX_NUMNODES];
+static nodemask_t kfence_freelist_nodes; /* Nodes with non-empty freelists at init. */
 
 /*
  * The static key to set up a KFENCE allocation; or if static keys are not used
@@ -379,6 +388,51 @@ static inline void check_canary(const struct kfence_metadata *meta)
 	}
 }
 
+static void kfence_freelist_put(struct kfence_metadata *meta)
+{
+	struct kfence_freelist *fl = &kfence_freelist[meta->nid];
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&fl->lock, flags);
+	KFENCE_WARN_ON(!list_empty(&meta->list));
+	list_add_tail(&meta->list, &fl->list);
+	raw_spin_unlock_irqrestore(&fl->lock, flags);
+}
+
+/* Get a free object, preferably from the local node. */
+static struct kfence_metadata *kfence_freelist_get(void)
+{
+	struct kfence_metadata *meta = NULL;
+	struct kfence_freelist *fl;
+	unsigned long flags;
+	int nid, start;
+
+	start = numa_mem_id();
+	if (!node_isset(start, kfence_freelist_nodes))
+		start = next_node_in(start, kfence_freelist_nodes);
+	if (start >= MAX_NUMNODES)
+		return NULL;
+
+	nid = start;
+	do {
+		fl = &kfence_freelist[nid];
+		/* Do not bother with the lock of an empty freelist. */
+		if (!data_race(list_empty(&fl->list))) {
+			raw_spin_lock_irqsave(&fl->lock, flags);
+			meta = list_first_entry_or_null(&fl->list,
+							struct kfence_metadata, list);
+			if (meta)
+				list_del_init(&meta->list);
+			raw_spin_unlock_irqrestore(&fl->lock, flags);
+			if (meta)
+				return meta;
+		}
+		nid = next_node_in(nid, kfence_freelist_nodes);
+	} while (nid != start);
+
+	return NULL;
+}
+
 static void *kfence_guarded_alloc(struct kmem_cache *cache, size_t size, gfp_t gfp,
 				  unsigned long *stack_entries, size_t num_stack_entries,
 				  u32 alloc_stack_hash)
@@ -392,12 +446,7 @@ static void *kfence_guarded_alloc(struct kmem_cache *cache, size_t size, gfp_t g
 				  !get_random_u32_below(CONFIG_KFENCE_STRESS_TEST_FAULTS);
 
 	/* Try to obtain a free object. */
-	raw_spin_lock_irqsave(&kfence_freelist_lock, flags);
-	if (!list_empty(&kfence_freelist)) {
-		meta = list_entry(kfence_freelist.next, struct kfence_metadata, list);
-		list_del_init(&meta->list);
-	}
-	raw_spin_unlock_irqrestore(&kfence_freelist_lock, flags);
+	meta = kfence_freelist_get();
 	if (!meta) {
 		atomic_long_inc(&counters[KFENCE_COUNTER_SKIP_CAPACITY]);
 		return NULL;
@@ -413,10 +462,8 @@ static void *kfence_guarded_alloc(struct kmem_cache *cache, size_t size, gfp_t g
 		 * report that there is a possibility of deadlock. Fix it by
 		 * using trylock and bailing out gracefully.
 		 */
-		raw_spin_lock_irqsave(&kfence_freelist_lock, flags);
 		/* Put the object back on the freelist. */
-		list_add_tail(&meta->list, &kfence_freelist);
-		raw_spin_unlock_irqrestore(&kfence_freelist_lock, flags);
+		kfence_freelist_put(meta);
 
 		return NULL;
 	}
@@ -539,10 +586,7 @@ static void kfence_guarded_free(void *addr, struct kfence_metadata *meta, bool z
 	kcsan_end_scoped_access(&assert_page_exclusive);
 	if (!zombie) {
 		/* Add it to the tail of the freelist for reuse. */
-		raw_spin_lock_irqsave(&kfence_freelist_lock, flags);
-		KFENCE_WARN_ON(!list_empty(&meta->list));
-		list_add_tail(&meta->list, &kfence_freelist);
-		raw_spin_unlock_irqrestore(&kfence_freelist_lock, flags);
+		kfence_freelist_put(meta);
 
 		atomic_long_dec(&counters[KFENCE_COUNTER_ALLOCATED]);
 		atomic_long_inc(&counters[KFENCE_COUNTER_FREES]);
@@ -609,6 +653,12 @@ static unsigned long kfence_init_pool(void)
 		addr += PAGE_SIZE;
 	}
 
+	for (i = 0; i < MAX_NUMNODES; i++) {
+		INIT_LIST_HEAD(&kfence_freelist[i].list);
+		raw_spin_lock_init(&kfence_freelist[i].lock);
+	}
+	nodes_clear(kfence_freelist_nodes);
+
 	for (i = 0; i < CONFIG_KFENCE_NUM_OBJECTS; i++) {
 		struct kfence_metadata *meta = &kfence_metadata[i];
 
@@ -617,7 +667,9 @@ static unsigned long kfence_init_pool(void)
 		raw_spin_lock_init(&meta->lock);
 		meta->state = KFENCE_OBJECT_UNUSED;
 		meta->addr = addr; /* Initialize for validation in metadata_to_pageaddr(). */
-		list_add_tail(&meta->list, &kfence_freelist);
+		meta->nid = page_to_nid(virt_to_page(addr));
+		list_add_tail(&meta->list, &kfence_freelist[meta->nid].list);
+		node_set(meta->nid, kfence_freelist_nodes);
 
 		/* Protect the right redzone. */
 		if (unlikely(!kfence_protect(addr + PAGE_SIZE)))
@@ -52,7 +52,7 @@ struct kfence_track {
 
 /* KFENCE metadata per guarded allocation. */
 struct kfence_metadata {
-	struct list_head list;		/* Freelist node; access under kfence_freelist_lock. */
+	struct list_head list;		/* Freelist node; access under the freelist lock. */
 	struct rcu_head rcu_head;	/* For delayed freeing. */
 
 	/*
@@ -67,6 +67,9 @@ struct kfence_metadata {
 	/* The current state of the object; see above. */
 	enum kfence_object_state state;
 
+	/* Node of the object page, and of the freelist the object is kept on. */
+	int nid;
+
 	/*
 	 * Allocated object address; cannot be calculated from size, because of
 	 * alignment requirements.
@@ -21,6 +21,7 @@
 #include <linux/proc_fs.h>
 #include <linux/err.h>
 #include <linux/cpumask.h>
+#include <linux/hash.h>
 
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter_ipv4/ip_tables.h>
@@ -218,6 +219,96 @@ struct ipt_entry *ipt_next_entry(const struct ipt_entry *entry)
 	return (void *)entry + entry->next_offset;
 }
 
+/* Rule index.
+ *
+ * A run of consecutive rules which all match a single destination address
+ * (/32, not inverted) can only match packets to one of those addresses.
+ * Each such run gets a small hash of its addresses, so that the table
+ * walk jumps from the start of the run to the first rule for the packet's
+ * destination, and from a rule that does not match to the next rule in
+ * the run for the same destination. Rules reached any other way, e.g.
+ * when returning from a chain, are still walked one by one.
+ */
+#define IPT_INDEX_MIN_RUN	8
+#define IPT_INDEX_HEAD		0x80000000U
+#define IPT_INDEX_NONE		0xFFFFFFFFU
+
+struct ipt_index_run {
+	unsigned int	end;		/* offset of the rule after the run */
+	unsigned int	head_next;	/* next rule for the first rule's dst */
+	unsigned int	bucket;		/* first bucket of the run */
+	unsigned int	bits;
+};
+
+struct ipt_index_bucket {
+	__be32		dst;
+	unsigned int	off;		/* first rule for dst in the run */
+};
+
+struct ipt_index {
+	/* Per 8 bytes of rules: 0 outside of runs, IPT_INDEX_HEAD | run
+	 * for the first rule of a run, else 1 + offset of the next rule
+	 * in the run for the same dst, or of the rule after the run.
+	 */
+	unsigned int		*next;
+	struct ipt_index_run	*runs;
+	struct ipt_index_bucket	*buckets;
+};
+
+static inline bool ipt_index_rule(const struct ipt_entry *e)
+{
+	return e->ip.dmsk.s_addr == htonl(0xFFFFFFFF) &&
+	       !(e->ip.invflags & IPT_INV_DSTIP);
+}
+
+static inline unsigned int
+ipt_index_slot(const struct ipt_index *index, const void *table_base,
+	       const struct ipt_entry *e)
+{
+	return index->next[((const void *)e - table_base) >> 3];
+}
+
+/* Entering a rule: from the first rule of a run, go to the first rule in
+ * it for the packet's dst, or past the run if there is none.
+ */
+static inline struct ipt_entry *
+ipt_index_enter(const struct ipt_index *index, const void *table_base,
+		struct ipt_entry *e, __be32 daddr)
+{
+	unsigned int slot = ipt_index_slot(index, table_base, e);
+	const struct ipt_index_bucket *b;
+	const struct ipt_index_run *run;
+	unsigned int i, mask;
+
+	if (!(slot & IPT_INDEX_HEAD))
+		return e;
+
+	run = &index->runs[slot & ~IPT_INDEX_HEAD];
+	mask = (1U << run->bits) - 1;
+	for (i = hash_32((__force u32)daddr, run->bits); ; i = (i + 1) & mask) {
+		b = &index->buckets[run->bucket + i];
+		if (b->off == IPT_INDEX_NONE)
+			return get_entry(table_base, run->end);
+		if (b->dst == daddr)
+			return get_entry(table_base, b->off);
+	}
+}
+
+/* Leaving a rule that did not match */
+static inline struct ipt_entry *
+ipt_index_next(const struct ipt_index *index, const void *table_base,
+	       struct ipt_entry *e, __be32 daddr)
+{
+	unsigned int slot = ipt_index_slot(index, table_base, e);
+
+	if (!slot || e->ip.dst.s_addr != daddr)
+		return ipt_next_entry(e);
+	if (slot & IPT_INDEX_HEAD)
+		return get_entry(table_base,
+				 index->runs[slot & ~IPT_INDEX_HEAD].head_next);
+	return get_entry(table_base, slot - 1);
+}
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(void *priv,
@@ -235,6 +326,7 @@ ipt_do_table(void *priv,
 	struct ipt_entry *e, **jumpstack;
 	unsigned int stackidx, cpu;
 	const struct xt_table_info *private;
+	const struct ipt_index *index;
 	struct xt_action_param acpar;
 	unsigned int addend;
 
@@ -261,6 +353,7 @@ ipt_do_table(void *priv,
 	cpu        = smp_processor_id();
 	table_base = private->entries;
 	jumpstack  = (struct ipt_entry **)private->jumpstack[cpu];
+	index      = private->index;
 
 	/* Switch to alternate jumpstack if we're being invoked via TEE.
 	 * TEE issues XT_CONTINUE verdict on original skb so we must not
@@ -280,10 +373,16 @@ ipt_do_table(void *priv,
 		struct xt_counters *counter;
 
 		WARN_ON(!e);
+		if (index)
+			e = ipt_index_enter(index, table_base, e, ip->daddr);
 		if (!ip_packet_match(ip, indev, outdev,
 		    &e->ip, acpar.fragoff)) {
  no_match:
-			e = ipt_next_entry(e);
+			if (index)
+				e = ipt_index_next(index, table_base, e,
+						   ip->daddr);
+			else
+				e = ipt_next_entry(e);
 			continue;
 		}
 
@@ -654,6 +753,137 @@ cleanup_entry(struct ipt_entry *e, struct net *net)
 	xt_percpu_counter_free(&e->counters);
 }
 
+static void ipt_free_table_info(struct xt_table_info *info)
+{
+	kvfree(info->index);
+	xt_free_table_info(info);
+}
+
+static void ipt_index_link(struct ipt_index *index, struct ipt_index_run *run,
+			   unsigned int start, unsigned int from,
+			   unsigned int to)
+{
+	if (from == start)
+		run->head_next = to;
+	else
+		index->next[from >> 3] = to + 1;
+}
+
+/* Build the rule index of a checked table. Without one, or if it can not
+ * be allocated, the rules are simply walked one by one.
+ */
+static void ipt_build_index(struct xt_table_info *newinfo, void *entry0)
+{
+	unsigned int nruns = 0, nbuckets = 0, count = 0, r, b, i, mask;
+	unsigned int start = 0, end, off, *last;
+	struct ipt_index_bucket *bucket;
+	struct ipt_index_run *run;
+	struct ipt_index *index;
+	struct ipt_entry *iter, *e;
+	size_t nslots, size;
+	__be32 dst;
+
+	/* Count the runs long enough to be worth indexing */
+	xt_entry_foreach(iter, entry0, newinfo->size) {
+		if (ipt_index_rule(iter)) {
+			count++;
+			continue;
+		}
+		if (count >= IPT_INDEX_MIN_RUN) {
+			nruns++;
+			nbuckets += roundup_pow_of_two(2 * count);
+		}
+		count = 0;
+	}
+	if (count >= IPT_INDEX_MIN_RUN) {
+		nruns++;
+		nbuckets += roundup_pow_of_two(2 * count);
+	}
+	if (!nruns)
+		return;
+
+	nslots = newinfo->size >> 3;
+	size = sizeof(*index) + nslots * sizeof(*index->next) +
+	       nruns * sizeof(*index->runs) +
+	       (size_t)nbuckets * sizeof(*index->buckets);
+	index = kvzalloc(size, GFP_KERNEL_ACCOUNT);
+	if (!index)
+		return;
+	last = kvmalloc_array(nbuckets, sizeof(*last), GFP_KERNEL);
+	if (!last) {
+		kvfree(index);
+		return;
+	}
+	index->next = (void *)(index + 1);
+	index->runs = (void *)(index->next + nslots);
+	index->buckets = (void *)(index->runs + nruns);
+	for (b = 0; b < nbuckets; b++)
+		index->buckets[b].off = IPT_INDEX_NONE;
+
+	r = 0;
+	nbuckets = 0;
+	count = 0;
+	xt_entry_foreach(iter, entry0, newinfo->size) {
+		off = (void *)iter - entry0;
+		if (ipt_index_rule(iter)) {
+			if (!count++)
+				start = off;
+			if (off + iter->next_offset < newinfo->size)
+				continue;
+			off = newinfo->size;
+		}
+		if (count < IPT_INDEX_MIN_RUN) {
+			count = 0;
+			continue;
+		}
+
+		/* Rules from start up to off form a run */
+		end = off;
+		run = &index->runs[r];
+		run->end = end;
+		run->bucket = nbuckets;
+		run->bits = ilog2(roundup_pow_of_two(2 * count));
+		mask = (1U << run->bits) - 1;
+		nbuckets += mask + 1;
+
+		/* Chain up the rules for each dst, remembering the last one
+		 * seen in each bucket.
+		 */
+		for (off = start; off < end; off += e->next_offset) {
+			e = entry0 + off;
+			dst = e->ip.dst.s_addr;
+			for (i = hash_32((__force u32)dst, run->bits); ;
+			     i = (i + 1) & mask) {
+				bucket = &index->buckets[run->bucket + i];
+				if (bucket->off == IPT_INDEX_NONE) {
+					bucket->dst = dst;
+					bucket->off = off;
+					break;
+				}
+				if (bucket->dst == dst) {
+					ipt_index_link(index, run, start,
+						       last[run->bucket + i],
+						       off);
+					break;
+				}
+			}
+			last[run->bucket + i] = off;
+		}
+		for (i = 0; i <= mask; i++) {
+			bucket = &index->buckets[run->bucket + i];
+			if (bucket->off != IPT_INDEX_NONE)
+				ipt_index_link(index, run, start,
+					       last[run->bucket + i], end);
+		}
+		index->next[start >> 3] = IPT_INDEX_HEAD | r;
+		r++;
+		count = 0;
+	}
+
+	kvfree(last);
+	newinfo->index = index;
+}
+
 /* Checks and translates the user-supplied table segment (held in
    newinfo) */
 static int
@@ -729,6 +959,7 @@ translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 		return ret;
 	}
 
+	ipt_build_index(newinfo, entry0);
 	return ret;
  out_free:
 	kvfree(offsets);
@@ -1081,7 +1312,7 @@ __do_replace(struct net *net, const char *name, unsigned int valid_hooks,
 	xt_entry_foreach(iter, oldinfo->entries, oldinfo->size)
 		cleanup_entry(iter, net);
 
-	xt_free_table_info(oldinfo);
+	ipt_free_table_info(oldinfo);
 	if (copy_to_user(counters_ptr, counters,
 			 sizeof(struct xt_counters) * num_counters) != 0) {
 		/* Silent error, can't fail, new table is already in place */
@@ -1144,7 +1375,7 @@ do_replace(struct net *net, sockptr_t arg, unsigned int len)
 	xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 		cleanup_entry(iter, net);
  free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1466,11 +1697,11 @@ translate_compat_table(struct net *net,
 
 	*pinfo = newinfo;
 	*pentry0 = entry1;
-	xt_free_table_info(info);
+	ipt_free_table_info(info);
 	return 0;
 
 free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 out_unlock:
 	xt_compat_flush_offsets(AF_INET);
@@ -1528,7 +1759,7 @@ compat_do_replace(struct net *net, sockptr_t arg, unsigned int len)
 	xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 		cleanup_entry(iter, net);
  free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1709,7 +1940,7 @@ static void __ipt_unregister_table(struct net *net, struct xt_table *table)
 		cleanup_entry(iter, net);
 	if (private->number > private->initial_entries)
 		module_put(table_owner);
-	xt_free_table_info(private);
+	ipt_free_table_info(private);
 }
 
 int ipt_register_table(struct net *net, const struct xt_table *table,
@@ -1733,7 +1964,7 @@ int ipt_register_table(struct net *net, const struct xt_table *table,
 
 	ret = translate_table(net, newinfo, loc_cpu_entry, repl);
 	if (ret != 0) {
-		xt_free_table_info(newinfo);
+		ipt_free_table_info(newinfo);
 		return ret;
 	}
 
@@ -1743,7 +1974,7 @@ int ipt_register_table(struct net *net, const struct xt_table *table,
 
 		xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 			cleanup_entry(iter, net);
-		xt_free_table_info(newinfo);
+		ipt_free_table_info(newinfo);
 		return PTR_ERR(new_table);
 	}
 
@@ -188,7 +188,7 @@ static void kcm_rfree(struct sk_buff *skb)
 	}
 }
 
-static int kcm_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+static int __kcm_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct sk_buff_head *list = &sk->sk_receive_queue;
 
@@ -208,10 +208,18 @@ static int kcm_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 
 	skb_queue_tail(list, skb);
 
-	if (!sock_flag(sk, SOCK_DEAD))
+	return 0;
+}
+
+static int kcm_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+{
+	int err;
+
+	err = __kcm_queue_rcv_skb(sk, skb);
+	if (!err && !sock_flag(sk, SOCK_DEAD))
 		sk->sk_data_ready(sk);
 
-	return 0;
+	return err;
 }
 
 /* Requeue received messages for a kcm socket to other kcm sockets. This is
@@ -312,6 +320,13 @@ static void unreserve_rx_kcm(struct kcm_psock *psock,
 	if (!kcm)
 		return;
 
+	/* Messages queued by kcm_rcv_strparser() while the KCM was
+	 * reserved are announced here, once for the whole batch.
+	 */
+	if (!skb_queue_empty_lockless(&kcm->sk.sk_receive_queue) &&
+	    !sock_flag(&kcm->sk, SOCK_DEAD))
+		kcm->sk.sk_data_ready(&kcm->sk);
+
 	spin_lock_bh(&mux->rx_lock);
 
 	psock->rx_kcm = NULL;
@@ -376,7 +391,11 @@ static void kcm_rcv_strparser(struct strparser *strp, struct sk_buff *skb)
 		return;
 	}
 
-	if (kcm_queue_rcv_skb(&kcm->sk, skb)) {
+	/* The reader is woken up when the reservation is dropped at the end
+	 * of the strparser run, so that it finds every message parsed in it
+	 * at once instead of being woken up for each of them.
+	 */
+	if (__kcm_queue_rcv_skb(&kcm->sk, skb)) {
 		/* Should mean socket buffer full */
 		unreserve_rx_kcm(psock, false);
 		goto try_queue;
@@ -248,6 +248,51 @@ static ssize_t sta_airtime_write(struct file *file, const char __user *userbuf,
 }
 STA_OPS_RW(airtime);
 
+static ssize_t sta_tx_latency_read(struct file *file, char __user *userbuf,
+				   size_t count, loff_t *ppos)
+{
+	static const char * const bucket[AIRTIME_TX_LATENCY_BUCKETS] = {
+		"<1", "1-2", "2-4", "4-8", "8-16", "16-32", "32-64", ">=64",
+	};
+	struct sta_info *sta = file->private_data;
+	size_t bufsz = 600;
+	char *buf = kzalloc(bufsz, GFP_KERNEL), *p = buf;
+	ssize_t rv;
+	int ac, i;
+
+	if (!buf)
+		return -ENOMEM;
+
+	p += scnprintf(p, bufsz + buf - p,
+		       "ms\t\tVO\t\tVI\t\tBE\t\tBK\n");
+	for (i = 0; i < AIRTIME_TX_LATENCY_BUCKETS; i++) {
+		p += scnprintf(p, bufsz + buf - p, "%s", bucket[i]);
+		for (ac = 0; ac < IEEE80211_NUM_ACS; ac++)
+			p += scnprintf(p, bufsz + buf - p, "\t\t%u",
+				       READ_ONCE(sta->airtime[ac].tx_latency[i]));
+		p += scnprintf(p, bufsz + buf - p, "\n");
+	}
+
+	rv = simple_read_from_buffer(userbuf, count, ppos, buf, p - buf);
+	kfree(buf);
+	return rv;
+}
+
+static ssize_t sta_tx_latency_write(struct file *file,
+				    const char __user *userbuf,
+				    size_t count, loff_t *ppos)
+{
+	struct sta_info *sta = file->private_data;
+	int ac;
+
+	for (ac = 0; ac < IEEE80211_NUM_ACS; ac++)
+		memset(sta->airtime[ac].tx_latency, 0,
+		       sizeof(sta->airtime[ac].tx_latency));
+
+	return count;
+}
+STA_OPS_RW(tx_latency);
+
 static ssize_t sta_aql_read(struct file *file, char __user *userbuf,
 				size_t count, loff_t *ppos)
 {
@@ -1075,6 +1120,7 @@ void ieee80211_sta_debugfs_add(struct sta_info *sta)
 
 	DEBUGFS_ADD(aqm);
 	DEBUGFS_ADD(airtime);
+	DEBUGFS_ADD(tx_latency);
 
 	if (wiphy_ext_feature_isset(local->hw.wiphy,
 				    NL80211_EXT_FEATURE_AQL))
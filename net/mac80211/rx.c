@@ -4204,10 +4204,12 @@ static bool ieee80211_rx_data_set_sta(struct ieee80211_rx_data *rx,
 void ieee80211_release_reorder_timeout(struct sta_info *sta, int tid)
 {
 	struct sk_buff_head frames;
+	LIST_HEAD(list);
 	struct ieee80211_rx_data rx = {
 		/* This is OK -- must be QoS data frame */
 		.security_idx = tid,
 		.seqno_idx = tid,
+		.list = &list,
 	};
 	struct tid_ampdu_rx *tid_agg_rx;
 	int link_id = -1;
@@ -4239,6 +4241,10 @@ void ieee80211_release_reorder_timeout(struct sta_info *sta, int tid)
 	}
 
 	ieee80211_rx_handlers(&rx, &frames);
+	/* A timeout can release a whole window's worth of frames; hand them
+	 * up as one list rather than one netif_receive_skb() call each.
+	 */
+	netif_receive_skb_list(&list);
 }
 
 void ieee80211_mark_rx_ba_filtered_frames(struct ieee80211_sta *pubsta, u8 tid,
@@ -4248,10 +4254,12 @@ void ieee80211_mark_rx_ba_filtered_frames(struct ieee80211_sta *pubsta, u8 tid,
 	struct sta_info *sta;
 	struct tid_ampdu_rx *tid_agg_rx;
 	struct sk_buff_head frames;
+	LIST_HEAD(list);
 	struct ieee80211_rx_data rx = {
 		/* This is OK -- must be QoS data frame */
 		.security_idx = tid,
 		.seqno_idx = tid,
+		.list = &list,
 	};
 	int i, diff;
 
@@ -4313,6 +4321,7 @@ void ieee80211_mark_rx_ba_filtered_frames(struct ieee80211_sta *pubsta, u8 tid,
 	spin_unlock_bh(&tid_agg_rx->reorder_lock);
 
 	ieee80211_rx_handlers(&rx, &frames);
+	netif_receive_skb_list(&list);
 
  out:
 	rcu_read_unlock();
@@ -135,6 +135,9 @@ enum ieee80211_agg_stop_reason {
 #define AIRTIME_USE_TX		BIT(0)
 #define AIRTIME_USE_RX		BIT(1)
 
+/* Queueing delay histogram buckets: < 1 ms, then powers of two up to 64 ms */
+#define AIRTIME_TX_LATENCY_BUCKETS	8
+
 struct airtime_info {
 	u64 rx_airtime;
 	u64 tx_airtime;
@@ -143,6 +146,7 @@ struct airtime_info {
 	atomic_t aql_tx_pending; /* Estimated airtime for frames pending */
 	u32 aql_limit_low;
 	u32 aql_limit_high;
+	u32 tx_latency[AIRTIME_TX_LATENCY_BUCKETS]; /* time spent in the txq */
 };
 
 void ieee80211_sta_update_pending_airtime(struct ieee80211_local *local,
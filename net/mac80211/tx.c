@@ -1358,6 +1358,17 @@ static void ieee80211_set_skb_enqueue_time(struct sk_buff *skb)
 		IEEE80211_SKB_CB(skb)->control.enqueue_time = now;
 }
 
+static void ieee80211_sta_tx_latency(struct sta_info *sta, u8 ac,
+				     const struct sk_buff *skb)
+{
+	codel_time_t delay = codel_get_time() -
+			     IEEE80211_SKB_CB(skb)->control.enqueue_time;
+	u32 ms = codel_time_to_us(delay) / USEC_PER_MSEC;
+
+	sta->airtime[ac].tx_latency[min_t(u32, fls(ms),
+					  AIRTIME_TX_LATENCY_BUCKETS - 1)]++;
+}
+
 static u32 codel_skb_len_func(const struct sk_buff *skb)
 {
 	return skb->len;
@@ -3954,6 +3965,9 @@ struct sk_buff *ieee80211_tx_dequeue(struct ieee80211_hw *hw,
 encap_out:
 	IEEE80211_SKB_CB(skb)->control.vif = vif;
 
+	if (tx.sta)
+		ieee80211_sta_tx_latency(tx.sta, txq->ac, skb);
+
 	if (tx.sta &&
 	    wiphy_ext_feature_isset(local->hw.wiphy, NL80211_EXT_FEATURE_AQL)) {
 		bool ampdu = txq->ac != IEEE80211_AC_VO;
@@ -55,6 +55,7 @@ enum linux_mptcp_mib_field {
 					 * conflict with another subflow while updating msk rcv wnd
 					 */
 	MPTCP_MIB_RCVWNDCONFLICT,	/* Conflict with while updating msk rcv wnd */
+	MPTCP_MIB_REDUNDANTSEGS,	/* Segments sent again on another subflow in redundant mode */
 	__MPTCP_MIB_MAX
 };
 
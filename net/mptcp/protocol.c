@@ -496,7 +496,7 @@ static long mptcp_timeout_from_subflow(const struct mptcp_subflow_context *subfl
 	       inet_csk(ssk)->icsk_timeout - jiffies : 0;
 }
 
-static void mptcp_set_timeout(struct sock *sk)
+void mptcp_set_timeout(struct sock *sk)
 {
 	struct mptcp_subflow_context *subflow;
 	long tout = 0;
@@ -838,6 +838,8 @@ static bool __mptcp_finish_join(struct mptcp_sock *msk, struct sock *ssk)
 	if (sk->sk_socket && !ssk->sk_socket)
 		mptcp_sock_graft(ssk, sk->sk_socket);
 
+	/* redundant mode copies only data queued after the join */
+	mptcp_subflow_ctx(ssk)->redundant_seq = msk->snd_nxt;
 	mptcp_sockopt_sync_locked(msk, ssk);
 	return true;
 }
@@ -1404,11 +1406,11 @@ bool mptcp_subflow_active(struct mptcp_subflow_context *subflow)
 #define SSK_MODE_BACKUP	1
 #define SSK_MODE_MAX	2
 
-/* implement the mptcp packet scheduler;
+/* implement the default mptcp packet scheduler;
  * returns the subflow that will transmit the next DSS
  * additionally updates the rtx timeout
  */
-static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
+struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
 {
 	struct subflow_send_info send_info[SSK_MODE_MAX];
 	struct mptcp_subflow_context *subflow;
@@ -1533,6 +1535,83 @@ static void mptcp_update_post_push(struct mptcp_sock *msk,
 		msk->snd_nxt = snd_nxt_new;
 }
 
+/* Redundant mode: after new data has been pushed, queue a copy of
+ * everything in flight that a subflow has not carried yet on each other
+ * active subflow, so that the first copy to arrive gets delivered. The
+ * peer drops the others as duplicate DSS. Subflows whose write queue is
+ * already above the budget are skipped, which leaves bulk transfers
+ * alone and confines the duplication to interactive traffic.
+ */
+static void __mptcp_push_redundant(struct sock *sk)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct mptcp_subflow_context *subflow;
+	unsigned int budget;
+
+	budget = mptcp_redundant_budget(sock_net(sk));
+	if (!budget || __mptcp_check_fallback(msk) ||
+	    READ_ONCE(msk->csum_enabled))
+		return;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+		struct mptcp_sendmsg_info info = {};
+		struct mptcp_data_frag *dfrag;
+		size_t copied = 0;
+		u64 seq;
+
+		seq = subflow->redundant_seq;
+		if (!after64(msk->snd_nxt, seq))
+			continue;
+
+		subflow->redundant_seq = msk->snd_nxt;
+		if (before64(seq, msk->snd_una))
+			seq = msk->snd_una;
+
+		if (!mptcp_subflow_active(subflow) ||
+		    READ_ONCE(ssk->sk_wmem_queued) > budget)
+			continue;
+
+		lock_sock(ssk);
+		list_for_each_entry(dfrag, &msk->rtx_queue, list) {
+			if (!after64(dfrag->data_seq + dfrag->already_sent, seq))
+				continue;
+
+			info.sent = before64(dfrag->data_seq, seq) ?
+				    seq - dfrag->data_seq : 0;
+			info.limit = dfrag->already_sent;
+			while (info.sent < info.limit) {
+				int ret = mptcp_sendmsg_frag(sk, ssk, dfrag, &info);
+
+				if (ret <= 0)
+					goto push;
+
+				MPTCP_INC_STATS(sock_net(sk), MPTCP_MIB_REDUNDANTSEGS);
+				copied += ret;
+				info.sent += ret;
+			}
+		}
+push:
+		if (copied) {
+			tcp_push(ssk, 0, info.mss_now, tcp_sk(ssk)->nonagle,
+				 info.size_goal);
+			WRITE_ONCE(msk->allow_infinite_fallback, false);
+		}
+		release_sock(ssk);
+	}
+}
+
+/* don't queue the bytes at @seq, just sent on @ssk, again on it in
+ * redundant mode
+ */
+static void mptcp_redundant_sent(struct sock *ssk, u64 seq, int len)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+
+	if (subflow->redundant_seq == seq)
+		subflow->redundant_seq += len;
+}
+
 void mptcp_check_and_set_pending(struct sock *sk)
 {
 	if (mptcp_send_head(sk))
@@ -1558,7 +1637,7 @@ void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 			int ret = 0;
 
 			prev_ssk = ssk;
-			ssk = mptcp_subflow_get_send(msk);
+			ssk = mptcp_sched_get_send(msk);
 
 			/* First check. If the ssk has changed since
 			 * the last round, release prev_ssk
@@ -1584,6 +1663,8 @@ void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 			}
 
 			do_check_data_fin = true;
+			mptcp_redundant_sent(ssk, dfrag->data_seq + info.sent, ret);
+
 			info.sent += ret;
 			len -= ret;
 
@@ -1597,6 +1678,9 @@ void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 		mptcp_push_release(ssk, &info);
 
 out:
+	if (do_check_data_fin)
+		__mptcp_push_redundant(sk);
+
 	/* ensure the rtx timer is running */
 	if (!mptcp_timer_pending(sk))
 		mptcp_reset_timer(sk);
@@ -1625,7 +1709,7 @@ static void __mptcp_subflow_push_pending(struct sock *sk, struct sock *ssk, bool
 			/* check for a different subflow usage only after
 			 * spooling the first chunk of data
 			 */
-			xmit_ssk = first ? ssk : mptcp_subflow_get_send(msk);
+			xmit_ssk = first ? ssk : mptcp_sched_get_send(msk);
 			if (!xmit_ssk)
 				goto out;
 			if (xmit_ssk != ssk) {
@@ -1638,6 +1722,7 @@ static void __mptcp_subflow_push_pending(struct sock *sk, struct sock *ssk, bool
 			if (ret <= 0)
 				goto out;
 
+			mptcp_redundant_sent(ssk, dfrag->data_seq + info.sent, ret);
 			info.sent += ret;
 			copied += ret;
 			len -= ret;
@@ -2238,7 +2323,7 @@ static void mptcp_timeout_timer(struct timer_list *t)
  *
  * A backup subflow is returned only if that is the only kind available.
  */
-static struct sock *mptcp_subflow_get_retrans(struct mptcp_sock *msk)
+struct sock *mptcp_subflow_get_retrans(struct mptcp_sock *msk)
 {
 	struct sock *backup = NULL, *pick = NULL;
 	struct mptcp_subflow_context *subflow;
@@ -2551,7 +2636,7 @@ static void __mptcp_retrans(struct sock *sk)
 	mptcp_clean_una_wakeup(sk);
 
 	/* first check ssk: need to kick "stale" logic */
-	ssk = mptcp_subflow_get_retrans(msk);
+	ssk = mptcp_sched_get_retrans(msk);
 	dfrag = mptcp_rtx_head(sk);
 	if (!dfrag) {
 		if (mptcp_data_fin_enabled(msk)) {
@@ -2722,6 +2807,7 @@ static int __mptcp_init_sock(struct sock *sk)
 	msk->timer_ival = TCP_RTO_MIN;
 
 	msk->first = NULL;
+	msk->sched = NULL;
 	inet_csk(sk)->icsk_sync_mss = mptcp_sync_mss;
 	WRITE_ONCE(msk->csum_enabled, mptcp_is_checksum_enabled(sock_net(sk)));
 	WRITE_ONCE(msk->allow_infinite_fallback, true);
@@ -2763,6 +2849,10 @@ static int mptcp_init_sock(struct sock *sk)
 	if (unlikely(!net->mib.mptcp_statistics) && !mptcp_mib_alloc(net))
 		return -ENOMEM;
 
+	ret = mptcp_init_sched_by_name(mptcp_sk(sk), mptcp_get_scheduler(net));
+	if (ret)
+		return ret;
+
 	set_bit(SOCK_CUSTOM_SOCKOPT, &sk->sk_socket->flags);
 
 	/* fetch the ca name; do it outside __mptcp_init_sock(), so that clone will
@@ -3135,6 +3225,7 @@ struct sock *mptcp_sk_clone(const struct sock *sk,
 	__mptcp_init_sock(nsk);
 
 	msk = mptcp_sk(nsk);
+	mptcp_init_sched(msk, mptcp_sk(sk)->sched);
 	msk->local_key = subflow_req->local_key;
 	msk->token = subflow_req->token;
 	msk->subflow = NULL;
@@ -3261,6 +3352,7 @@ static void mptcp_destroy(struct sock *sk)
 	 */
 	mptcp_dispose_initial_subflow(msk);
 	mptcp_destroy_common(msk, 0);
+	mptcp_release_sched(msk);
 	sk_sockets_allocated_dec(sk);
 }
 
@@ -3435,6 +3527,7 @@ void mptcp_finish_connect(struct sock *ssk)
 	WRITE_ONCE(msk->write_seq, subflow->idsn + 1);
 	WRITE_ONCE(msk->snd_nxt, msk->write_seq);
 	WRITE_ONCE(msk->snd_una, msk->write_seq);
+	subflow->redundant_seq = msk->snd_nxt;
 
 	mptcp_pm_new_connection(msk, ssk, 0);
 
@@ -3938,6 +4031,7 @@ void __init mptcp_proto_init(void)
 
 	mptcp_subflow_init();
 	mptcp_pm_init();
+	mptcp_sched_init();
 	mptcp_token_init();
 
 	if (proto_register(&mptcp_prot, 1) != 0)
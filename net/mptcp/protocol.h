@@ -319,6 +319,7 @@ struct mptcp_sock {
 	u32 setsockopt_seq;
 	char		ca_name[TCP_CA_NAME_MAX];
 	struct mptcp_sock	*dl_next;
+	struct mptcp_sched_ops	*sched;
 };
 
 #define mptcp_data_lock(sk) spin_lock_bh(&(sk)->sk_lock.slock)
@@ -444,6 +445,7 @@ struct mptcp_subflow_context {
 	struct_group(reset,
 
 	unsigned long avg_pacing_rate; /* protected by msk socket lock */
+	u64	redundant_seq; /* msk data queued up to, protected by msk socket lock */
 	u64	local_key;
 	u64	remote_key;
 	u64	idsn;
@@ -613,6 +615,8 @@ int mptcp_is_checksum_enabled(const struct net *net);
 int mptcp_allow_join_id0(const struct net *net);
 unsigned int mptcp_stale_loss_cnt(const struct net *net);
 int mptcp_get_pm_type(const struct net *net);
+const char *mptcp_get_scheduler(const struct net *net);
+unsigned int mptcp_redundant_budget(const struct net *net);
 void mptcp_copy_inaddrs(struct sock *msk, const struct sock *ssk);
 void mptcp_subflow_fully_established(struct mptcp_subflow_context *subflow,
 				     const struct mptcp_options_received *mp_opt);
@@ -637,6 +641,42 @@ void mptcp_set_owner_r(struct sk_buff *skb, struct sock *sk);
 bool mptcp_addresses_equal(const struct mptcp_addr_info *a,
 			   const struct mptcp_addr_info *b, bool use_port);
 
+#define MPTCP_SCHED_NAME_MAX	16
+
+/* Packet scheduler: picks the subflow for the next chunk of data.
+ *
+ * @get_send returns the subflow to push new data on, or NULL if none can
+ * take more data right now. @get_retrans returns the subflow to
+ * retransmit on, or NULL; if it is not provided the default one is used.
+ * Both are called with the msk socket lock held, and neither is called
+ * once the msk has fallen back to plain TCP.
+ */
+struct mptcp_sched_ops {
+	struct sock *(*get_send)(struct mptcp_sock *msk);
+	struct sock *(*get_retrans)(struct mptcp_sock *msk);
+
+	char			name[MPTCP_SCHED_NAME_MAX];
+	struct module		*owner;
+	struct list_head	list;
+
+	void (*init)(struct mptcp_sock *msk);
+	void (*release)(struct mptcp_sock *msk);
+} ____cacheline_aligned_in_smp;
+
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched);
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched);
+bool mptcp_sched_exists(const char *name);
+void mptcp_sched_init(void);
+int mptcp_init_sched(struct mptcp_sock *msk,
+		     struct mptcp_sched_ops *sched);
+int mptcp_init_sched_by_name(struct mptcp_sock *msk, const char *name);
+void mptcp_release_sched(struct mptcp_sock *msk);
+struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk);
+struct sock *mptcp_subflow_get_retrans(struct mptcp_sock *msk);
+struct sock *mptcp_sched_get_send(struct mptcp_sock *msk);
+struct sock *mptcp_sched_get_retrans(struct mptcp_sock *msk);
+void mptcp_set_timeout(struct sock *sk);
+
 /* called with sk socket lock held */
 int __mptcp_subflow_connect(struct sock *sk, const struct mptcp_addr_info *loc,
 			    const struct mptcp_addr_info *remote);
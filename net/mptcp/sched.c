@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * Packet scheduler registration, modelled after the TCP congestion
+ * control one.
+ */
+
+#define pr_fmt(fmt) "MPTCP: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include "protocol.h"
+
+static DEFINE_SPINLOCK(mptcp_sched_list_lock);
+static LIST_HEAD(mptcp_sched_list);
+
+static struct mptcp_sched_ops mptcp_sched_default = {
+	.get_send	= mptcp_subflow_get_send,
+	.get_retrans	= mptcp_subflow_get_retrans,
+	.name		= "default",
+	.owner		= THIS_MODULE,
+};
+
+/* Must be called with rcu lock held */
+static struct mptcp_sched_ops *mptcp_sched_find_rcu(const char *name)
+{
+	struct mptcp_sched_ops *sched;
+
+	list_for_each_entry_rcu(sched, &mptcp_sched_list, list) {
+		if (!strcmp(sched->name, name))
+			return sched;
+	}
+
+	return NULL;
+}
+
+bool mptcp_sched_exists(const char *name)
+{
+	bool ret;
+
+	rcu_read_lock();
+	ret = !!mptcp_sched_find_rcu(name);
+	rcu_read_unlock();
+
+	return ret;
+}
+
+/* Round-robin: push each chunk on the next active subflow after the one
+ * used last that has send space. Backup subflows are only used when no
+ * other subflow can take data.
+ */
+static struct sock *mptcp_sched_rr_get_send(struct mptcp_sock *msk)
+{
+	struct sock *ssk, *first = NULL, *next = NULL, *backup = NULL;
+	struct mptcp_subflow_context *subflow;
+	struct sock *last = msk->last_snd;
+	bool past_last = false;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		ssk = mptcp_subflow_tcp_sock(subflow);
+		if (ssk == last)
+			past_last = true;
+
+		if (!mptcp_subflow_active(subflow) ||
+		    !sk_stream_memory_free(ssk))
+			continue;
+
+		if (subflow->backup) {
+			if (!backup)
+				backup = ssk;
+			continue;
+		}
+		if (!first)
+			first = ssk;
+		if (past_last && ssk != last) {
+			next = ssk;
+			break;
+		}
+	}
+
+	/* wrap around, possibly back to the last one */
+	if (!next)
+		next = first ? first : backup;
+
+	mptcp_set_timeout((struct sock *)msk);
+	msk->last_snd = next;
+	return next;
+}
+
+static struct mptcp_sched_ops mptcp_sched_rr = {
+	.get_send	= mptcp_sched_rr_get_send,
+	.name		= "roundrobin",
+	.owner		= THIS_MODULE,
+};
+
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched)
+{
+	int ret = 0;
+
+	if (!sched->get_send) {
+		pr_err("%s does not implement required ops\n", sched->name);
+		return -EINVAL;
+	}
+
+	spin_lock(&mptcp_sched_list_lock);
+	if (mptcp_sched_find_rcu(sched->name)) {
+		pr_notice("%s already registered\n", sched->name);
+		ret = -EEXIST;
+	} else {
+		list_add_tail_rcu(&sched->list, &mptcp_sched_list);
+		pr_debug("%s registered\n", sched->name);
+	}
+	spin_unlock(&mptcp_sched_list_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(mptcp_register_scheduler);
+
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched)
+{
+	if (sched == &mptcp_sched_default)
+		return;
+
+	spin_lock(&mptcp_sched_list_lock);
+	list_del_rcu(&sched->list);
+	spin_unlock(&mptcp_sched_list_lock);
+
+	/* Wait for outstanding lookups to finish; sockets using the
+	 * scheduler hold a reference on its module, so there are none.
+	 */
+	synchronize_rcu();
+}
+EXPORT_SYMBOL_GPL(mptcp_unregister_scheduler);
+
+void mptcp_sched_init(void)
+{
+	mptcp_register_scheduler(&mptcp_sched_default);
+	mptcp_register_scheduler(&mptcp_sched_rr);
+}
+
+/* Attach @sched, on which the caller holds a module reference, to @msk.
+ * NULL selects the default scheduler.
+ */
+static int __mptcp_init_sched(struct mptcp_sock *msk,
+			      struct mptcp_sched_ops *sched)
+{
+	if (!sched)
+		sched = &mptcp_sched_default;
+
+	msk->sched = sched;
+	if (msk->sched->init)
+		msk->sched->init(msk);
+
+	pr_debug("sched=%s", msk->sched->name);
+
+	return 0;
+}
+
+/* Attach @sched, which must be kept registered by the caller, e.g. by
+ * the listener that uses it, to @msk. Falls back to the default
+ * scheduler if its module is going away.
+ */
+int mptcp_init_sched(struct mptcp_sock *msk,
+		     struct mptcp_sched_ops *sched)
+{
+	if (sched && !try_module_get(sched->owner))
+		sched = NULL;
+
+	return __mptcp_init_sched(msk, sched);
+}
+
+/* Attach the scheduler called @name to @msk, or the default one if there
+ * is none. The module reference is taken before leaving the RCU read
+ * side section, so the scheduler can't be unregistered in between.
+ */
+int mptcp_init_sched_by_name(struct mptcp_sock *msk, const char *name)
+{
+	struct mptcp_sched_ops *sched;
+
+	rcu_read_lock();
+	sched = mptcp_sched_find_rcu(name);
+	if (sched && !try_module_get(sched->owner))
+		sched = NULL;
+	rcu_read_unlock();
+
+	return __mptcp_init_sched(msk, sched);
+}
+
+void mptcp_release_sched(struct mptcp_sock *msk)
+{
+	struct mptcp_sched_ops *sched = msk->sched;
+
+	if (!sched)
+		return;
+
+	msk->sched = NULL;
+	if (sched->release)
+		sched->release(msk);
+
+	if (sched != &mptcp_sched_default)
+		module_put(sched->owner);
+}
+
+struct sock *mptcp_sched_get_send(struct mptcp_sock *msk)
+{
+	struct mptcp_sched_ops *sched = msk->sched;
+
+	/* the default scheduler also covers the fallback case */
+	if (!sched || sched == &mptcp_sched_default ||
+	    __mptcp_check_fallback(msk))
+		return mptcp_subflow_get_send(msk);
+
+	return sched->get_send(msk);
+}
+
+struct sock *mptcp_sched_get_retrans(struct mptcp_sock *msk)
+{
+	struct mptcp_sched_ops *sched = msk->sched;
+
+	if (!sched || !sched->get_retrans || __mptcp_check_fallback(msk))
+		return mptcp_subflow_get_retrans(msk);
+
+	return sched->get_retrans(msk);
+}
@@ -835,6 +835,7 @@ static struct sock *subflow_syn_recv_sock(const struct sock *sk,
 			 * created mptcp socket
 			 */
 			owner->setsockopt_seq = ctx->setsockopt_seq;
+			ctx->redundant_seq = owner->snd_nxt;
 			mptcp_pm_new_connection(owner, child, 1);
 			mptcp_token_accept(subflow_req, owner);
 
@@ -1421,6 +1421,8 @@ ip_set_put_flags(struct sk_buff *skb, struct ip_set *set)
 		cadt_flags |= IPSET_FLAG_WITH_SKBINFO;
 	if (SET_WITH_FORCEADD(set))
 		cadt_flags |= IPSET_FLAG_WITH_FORCEADD;
+	if (SET_WITH_PREALLOC(set))
+		cadt_flags |= IPSET_FLAG_WITH_PREALLOC;
 
 	if (!cadt_flags)
 		return 0;
@@ -43,6 +43,8 @@
 /* Max muber of elements in the array block when tuned */
 #define AHASH_MAX_TUNED			64
 #define AHASH_MAX(h)			((h)->bucketsize)
+/* Number of network sizes hashed ahead when testing by nets */
+#define AHASH_TEST_BATCH		8
 
 /* A hash bucket */
 struct hbucket {
@@ -1158,23 +1160,23 @@ mtype_test_cidrs(struct ip_set *set, struct mtype_elem *d,
 #if IPSET_NET_COUNT == 2
 	struct mtype_elem orig = *d;
 	int ret, i, j = 0, k;
+	u32 key;
 #else
-	int ret, i, j = 0;
+	struct mtype_elem orig;
+	struct hbucket *buckets[AHASH_TEST_BATCH];
+	int ret, i, j = 0, b, nr;
 #endif
-	u32 key, multi = 0;
+	u32 multi = 0;
 
 	pr_debug("test by nets\n");
-	for (; j < NLEN && h->nets[j].cidr[0] && !multi; j++) {
 #if IPSET_NET_COUNT == 2
+	for (; j < NLEN && h->nets[j].cidr[0] && !multi; j++) {
 		mtype_data_reset_elem(d, &orig);
 		mtype_data_netmask(d, NCIDR_GET(h->nets[j].cidr[0]), false);
 		for (k = 0; k < NLEN && h->nets[k].cidr[1] && !multi;
 		     k++) {
 			mtype_data_netmask(d, NCIDR_GET(h->nets[k].cidr[1]),
 					   true);
-#else
-		mtype_data_netmask(d, NCIDR_GET(h->nets[j].cidr[0]));
-#endif
 		key = HKEY(d, h->initval, t->htable_bits);
 		n = rcu_dereference_bh(hbucket(t, key));
 		if (!n)
@@ -1193,10 +1195,48 @@ mtype_test_cidrs(struct ip_set *set, struct mtype_elem *d,
 			multi = 0;
 #endif
 		}
-#if IPSET_NET_COUNT == 2
 		}
+	}
+#else
+	for (; j < NLEN && h->nets[j].cidr[0] && !multi; j += nr) {
+		/* Look up the buckets of a batch of network sizes and
+		 * prefetch their heads before walking any of them, so that
+		 * the cache misses of a set with many network sizes overlap.
+		 */
+		orig = *d;
+		for (nr = 0; nr < AHASH_TEST_BATCH && j + nr < NLEN &&
+			     h->nets[j + nr].cidr[0]; nr++) {
+			mtype_data_netmask(d, NCIDR_GET(h->nets[j + nr].cidr[0]));
+			n = rcu_dereference_bh(hbucket(t, HKEY(d, h->initval,
+							       t->htable_bits)));
+			if (n)
+				prefetch(n);
+			buckets[nr] = n;
+		}
+		*d = orig;
+		for (b = 0; b < nr && !multi; b++) {
+			mtype_data_netmask(d, NCIDR_GET(h->nets[j + b].cidr[0]));
+			n = buckets[b];
+			if (!n)
+				continue;
+			for (i = 0; i < n->pos; i++) {
+				if (!test_bit(i, n->used))
+					continue;
+				data = ahash_data(n, i, set->dsize);
+				if (!mtype_data_equal(data, d, &multi))
+					continue;
+				ret = mtype_data_match(data, ext, mext, set,
+						       flags);
+				if (ret != 0)
+					return ret;
+#ifdef IP_SET_HASH_WITH_MULTI
+				/* No match, reset multiple match flag */
+				multi = 0;
 #endif
+			}
+		}
 	}
+#endif
 	return 0;
 }
 #endif
@@ -1452,7 +1492,7 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 #ifdef IP_SET_HASH_WITH_MARKMASK
 	u32 markmask;
 #endif
-	u8 hbits;
+	u8 hbits, bucketsize;
 #if defined(IP_SET_HASH_WITH_NETMASK) || defined(IP_SET_HASH_WITH_BITMASK)
 	int ret __attribute__((unused)) = 0;
 	u8 netmask = set->family == NFPROTO_IPV4 ? 32 : 128;
@@ -1540,6 +1580,29 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 	if (tb[IPSET_ATTR_MAXELEM])
 		maxelem = ip_set_get_h32(tb[IPSET_ATTR_MAXELEM]);
 
+	bucketsize = AHASH_MAX_SIZE;
+	if (tb[IPSET_ATTR_BUCKETSIZE]) {
+		bucketsize = nla_get_u8(tb[IPSET_ATTR_BUCKETSIZE]);
+		if (bucketsize < AHASH_INIT_SIZE)
+			bucketsize = AHASH_INIT_SIZE;
+		else if (bucketsize > AHASH_MAX_SIZE)
+			bucketsize = AHASH_MAX_SIZE;
+		else if (bucketsize % 2)
+			bucketsize += 1;
+	}
+
+	/* Size the table for maxelem elements up front when asked to: with
+	 * maxelem / bucketsize buckets, filling up the set, e.g. by a
+	 * restore, skips the resizes from hashsize on and at most hits the
+	 * odd one caused by uneven buckets.
+	 */
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_PREALLOC)) {
+		set->flags |= IPSET_CREATE_FLAG_PREALLOC;
+		hashsize = max(hashsize, DIV_ROUND_UP(maxelem, bucketsize));
+	}
+
 	hsize = sizeof(*h);
 	h = kzalloc(hsize, GFP_KERNEL);
 	if (!h)
@@ -1581,16 +1644,7 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 		h->initval = ntohl(nla_get_be32(tb[IPSET_ATTR_INITVAL]));
 	else
 		get_random_bytes(&h->initval, sizeof(h->initval));
-	h->bucketsize = AHASH_MAX_SIZE;
-	if (tb[IPSET_ATTR_BUCKETSIZE]) {
-		h->bucketsize = nla_get_u8(tb[IPSET_ATTR_BUCKETSIZE]);
-		if (h->bucketsize < AHASH_INIT_SIZE)
-			h->bucketsize = AHASH_INIT_SIZE;
-		else if (h->bucketsize > AHASH_MAX_SIZE)
-			h->bucketsize = AHASH_MAX_SIZE;
-		else if (h->bucketsize % 2)
-			h->bucketsize += 1;
-	}
+	h->bucketsize = bucketsize;
 	t->htable_bits = hbits;
 	t->maxelem = h->maxelem / ahash_numof_locks(hbits);
 	RCU_INIT_POINTER(h->table, t);
@@ -32,6 +32,8 @@
 #include <linux/seq_file.h>
 #include <linux/jhash.h>
 #include <linux/random.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
 
 #include <net/net_namespace.h>
 #include <net/ip_vs.h>
@@ -41,21 +43,49 @@
 #define CONFIG_IP_VS_TAB_BITS	12
 #endif
 
+#define IP_VS_CONN_TAB_MAX_BITS	26
+
 /*
  * Connection hash size. Default is what was selected at compile time.
+ * The table starts out with that size and is never shrunk below it, but
+ * grows with the number of connections up to conn_tab_max_bits.
 */
 static int ip_vs_conn_tab_bits = CONFIG_IP_VS_TAB_BITS;
 module_param_named(conn_tab_bits, ip_vs_conn_tab_bits, int, 0444);
 MODULE_PARM_DESC(conn_tab_bits, "Set connections' hash size");
 
-/* size and mask values */
+static int ip_vs_conn_tab_max_bits = 20;
+module_param_named(conn_tab_max_bits, ip_vs_conn_tab_max_bits, int, 0444);
+MODULE_PARM_DESC(conn_tab_max_bits, "Set connections' maximum hash size");
+
+/* current size */
 int ip_vs_conn_tab_size __read_mostly;
-static int ip_vs_conn_tab_mask __read_mostly;
+
+struct ip_vs_conn_tab {
+	unsigned int		size;
+	unsigned int		mask;
+	struct hlist_head	buckets[];
+};
 
 /*
- *  Connection hash table: for input and output packets lookups of IPVS
+ *  Connection hash table: for input and output packets lookups of IPVS.
+ *  New entries always go to ip_vs_conn_tab. While the table is resized,
+ *  ip_vs_conn_tab_old is the table the entries are moved out of, one
+ *  bucket at a time under ip_vs_conn_tab_seq, so that a lookup which
+ *  misses in both tables can tell it has to look again.
  */
-static struct hlist_head *ip_vs_conn_tab __read_mostly;
+static struct ip_vs_conn_tab __rcu *ip_vs_conn_tab __read_mostly;
+static struct ip_vs_conn_tab __rcu *ip_vs_conn_tab_old __read_mostly;
+static seqcount_t ip_vs_conn_tab_seq = SEQCNT_ZERO(ip_vs_conn_tab_seq);
+
+/* serializes resizing with the walkers of the whole table */
+static DEFINE_MUTEX(ip_vs_conn_tab_mutex);
+
+static void ip_vs_conn_tab_resize(struct work_struct *work);
+static DECLARE_WORK(ip_vs_conn_tab_work, ip_vs_conn_tab_resize);
+
+/*  number of connections in all netns */
+static atomic_t ip_vs_conn_count = ATOMIC_INIT(0);
 
 /*  SLAB cache for IPVS connections */
 static struct kmem_cache *ip_vs_conn_cachep __read_mostly;
@@ -102,7 +132,23 @@ static inline void ct_write_unlock_bh(unsigned int key)
 static void ip_vs_conn_expire(struct timer_list *t);
 
 /*
- *	Returns hash value for IPVS connection entry
+ *	Bucket of the hash value @hash in the current table (@i == 0) or,
+ *	while a resize is in progress, in the old one (@i == 1).
+ *	Called under RCU.
+ */
+static inline struct hlist_head *ip_vs_conn_bucket(unsigned int hash, int i)
+{
+	struct ip_vs_conn_tab *t;
+
+	if (i > 1)
+		return NULL;
+	t = rcu_dereference(i ? ip_vs_conn_tab_old : ip_vs_conn_tab);
+	return t ? &t->buckets[hash & t->mask] : NULL;
+}
+
+/*
+ *	Returns hash value for IPVS connection entry, the bucket is taken
+ *	from the low bits when the table is accessed.
  */
 static unsigned int ip_vs_conn_hashkey(struct netns_ipvs *ipvs, int af, unsigned int proto,
 				       const union nf_inet_addr *addr,
@@ -112,11 +158,11 @@ static unsigned int ip_vs_conn_hashkey(struct netns_ipvs *ipvs, int af, unsigned
 	if (af == AF_INET6)
 		return (jhash_3words(jhash(addr, 16, ip_vs_conn_rnd),
 				    (__force u32)port, proto, ip_vs_conn_rnd) ^
-			((size_t)ipvs>>8)) & ip_vs_conn_tab_mask;
+			((size_t)ipvs>>8));
 #endif
 	return (jhash_3words((__force u32)addr->ip, (__force u32)port, proto,
 			    ip_vs_conn_rnd) ^
-		((size_t)ipvs>>8)) & ip_vs_conn_tab_mask;
+		((size_t)ipvs>>8));
 }
 
 static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
@@ -126,8 +172,7 @@ static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
 	__be16 port;
 
 	if (p->pe_data && p->pe->hashkey_raw)
-		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse) &
-			ip_vs_conn_tab_mask;
+		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse);
 
 	if (likely(!inverse)) {
 		addr = p->caddr;
@@ -162,6 +207,7 @@ static unsigned int ip_vs_conn_hashkey_conn(const struct ip_vs_conn *cp)
  */
 static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 {
+	struct ip_vs_conn_tab *t;
 	unsigned int hash;
 	int ret;
 
@@ -177,7 +223,9 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 	if (!(cp->flags & IP_VS_CONN_F_HASHED)) {
 		cp->flags |= IP_VS_CONN_F_HASHED;
 		refcount_inc(&cp->refcnt);
-		hlist_add_head_rcu(&cp->c_list, &ip_vs_conn_tab[hash]);
+		/* The table only changes with all bucket locks held */
+		t = rcu_dereference_protected(ip_vs_conn_tab, 1);
+		hlist_add_head_rcu(&cp->c_list, &t->buckets[hash & t->mask]);
 		ret = 1;
 	} else {
 		pr_err("%s(): request for already hashed, called from %pS\n",
@@ -252,6 +300,106 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 	return ret;
 }
 
+static struct ip_vs_conn_tab *ip_vs_conn_tab_alloc(int bits)
+{
+	struct ip_vs_conn_tab *t;
+	unsigned int idx;
+
+	t = kvmalloc(struct_size(t, buckets, 1U << bits), GFP_KERNEL);
+	if (!t)
+		return NULL;
+
+	t->size = 1U << bits;
+	t->mask = t->size - 1;
+	for (idx = 0; idx < t->size; idx++)
+		INIT_HLIST_HEAD(&t->buckets[idx]);
+
+	return t;
+}
+
+/* Queue a resize when the number of connections has moved too far away
+ * from the table size: grow above two entries per bucket and shrink
+ * below one per eight, each time to about one entry per bucket.
+ */
+static inline void ip_vs_conn_tab_check(unsigned int count)
+{
+	unsigned int size = READ_ONCE(ip_vs_conn_tab_size);
+
+	if (unlikely((count > 2 * size &&
+		      size < 1U << ip_vs_conn_tab_max_bits) ||
+		     (count < size / 8 && size > 1U << ip_vs_conn_tab_bits)))
+		queue_work(system_unbound_wq, &ip_vs_conn_tab_work);
+}
+
+/*
+ *	Resize the connection table while it is in use. The new table is
+ *	installed with all bucket locks held, so from then on entries are
+ *	only hashed into it. The old buckets are then moved over one at a
+ *	time under their lock, which is the same for an entry in both
+ *	tables as they have at least CT_LOCKARRAY_SIZE buckets.
+ */
+static void ip_vs_conn_tab_resize(struct work_struct *work)
+{
+	struct ip_vs_conn_tab *old, *new;
+	unsigned int idx, len, max_len = 0;
+	struct ip_vs_conn *cp;
+	struct hlist_node *n;
+	int bits;
+
+	mutex_lock(&ip_vs_conn_tab_mutex);
+
+	old = rcu_dereference_protected(ip_vs_conn_tab,
+					lockdep_is_held(&ip_vs_conn_tab_mutex));
+	bits = order_base_2(atomic_read(&ip_vs_conn_count));
+	bits = clamp(bits, ip_vs_conn_tab_bits, ip_vs_conn_tab_max_bits);
+	if (1U << bits == old->size)
+		goto out;
+
+	new = ip_vs_conn_tab_alloc(bits);
+	if (!new)
+		goto out;
+
+	local_bh_disable();
+	for (idx = 0; idx < CT_LOCKARRAY_SIZE; idx++)
+		spin_lock_nest_lock(&__ip_vs_conntbl_lock_array[idx].l,
+				    &ip_vs_conn_tab_mutex);
+	write_seqcount_begin(&ip_vs_conn_tab_seq);
+	rcu_assign_pointer(ip_vs_conn_tab_old, old);
+	rcu_assign_pointer(ip_vs_conn_tab, new);
+	WRITE_ONCE(ip_vs_conn_tab_size, new->size);
+	write_seqcount_end(&ip_vs_conn_tab_seq);
+	for (idx = 0; idx < CT_LOCKARRAY_SIZE; idx++)
+		spin_unlock(&__ip_vs_conntbl_lock_array[idx].l);
+	local_bh_enable();
+
+	for (idx = 0; idx < old->size; idx++) {
+		len = 0;
+		ct_write_lock_bh(idx);
+		write_seqcount_begin(&ip_vs_conn_tab_seq);
+		hlist_for_each_entry_safe(cp, n, &old->buckets[idx], c_list) {
+			unsigned int hash = ip_vs_conn_hashkey_conn(cp);
+
+			hlist_del_rcu(&cp->c_list);
+			hlist_add_head_rcu(&cp->c_list,
+					   &new->buckets[hash & new->mask]);
+			len++;
+		}
+		write_seqcount_end(&ip_vs_conn_tab_seq);
+		ct_write_unlock_bh(idx);
+		max_len = max(max_len, len);
+		cond_resched();
+	}
+
+	pr_info("Connection hash table resized (size=%u->%u, conns=%d, longest chain=%u)\n",
+		old->size, new->size, atomic_read(&ip_vs_conn_count), max_len);
+
+	RCU_INIT_POINTER(ip_vs_conn_tab_old, NULL);
+	synchronize_rcu();
+	kvfree(old);
+out:
+	mutex_unlock(&ip_vs_conn_tab_mutex);
+}
+
 
 /*
  *  Gets ip_vs_conn associated with supplied parameters in the ip_vs_conn_tab.
@@ -262,28 +410,39 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 static inline struct ip_vs_conn *
 __ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
+	unsigned int hash, seq;
+	struct hlist_head *head;
 	struct ip_vs_conn *cp;
+	int i;
 
 	hash = ip_vs_conn_hashkey_param(p, false);
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
-		if (p->cport == cp->cport && p->vport == cp->vport &&
-		    cp->af == p->af &&
-		    ip_vs_addr_equal(p->af, p->caddr, &cp->caddr) &&
-		    ip_vs_addr_equal(p->af, p->vaddr, &cp->vaddr) &&
-		    ((!p->cport) ^ (!(cp->flags & IP_VS_CONN_F_NO_CPORT))) &&
-		    p->protocol == cp->protocol &&
-		    cp->ipvs == p->ipvs) {
-			if (!__ip_vs_conn_get(cp))
-				continue;
-			/* HIT */
-			rcu_read_unlock();
-			return cp;
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
+		for (i = 0; (head = ip_vs_conn_bucket(hash, i)); i++) {
+			hlist_for_each_entry_rcu(cp, head, c_list) {
+				if (p->cport == cp->cport &&
+				    p->vport == cp->vport &&
+				    cp->af == p->af &&
+				    ip_vs_addr_equal(p->af, p->caddr,
+						     &cp->caddr) &&
+				    ip_vs_addr_equal(p->af, p->vaddr,
+						     &cp->vaddr) &&
+				    ((!p->cport) ^
+				     (!(cp->flags & IP_VS_CONN_F_NO_CPORT))) &&
+				    p->protocol == cp->protocol &&
+				    cp->ipvs == p->ipvs) {
+					if (!__ip_vs_conn_get(cp))
+						continue;
+					/* HIT */
+					rcu_read_unlock();
+					return cp;
+				}
+			}
 		}
-	}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
 
 	rcu_read_unlock();
 
@@ -348,38 +507,49 @@ EXPORT_SYMBOL_GPL(ip_vs_conn_in_get_proto);
 /* Get reference to connection template */
 struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
+	unsigned int hash, seq;
+	struct hlist_head *head;
 	struct ip_vs_conn *cp;
+	int i;
 
 	hash = ip_vs_conn_hashkey_param(p, false);
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
-		if (unlikely(p->pe_data && p->pe->ct_match)) {
-			if (cp->ipvs != p->ipvs)
-				continue;
-			if (p->pe == cp->pe && p->pe->ct_match(p, cp)) {
-				if (__ip_vs_conn_get(cp))
-					goto out;
-			}
-			continue;
-		}
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
+		for (i = 0; (head = ip_vs_conn_bucket(hash, i)); i++) {
+			hlist_for_each_entry_rcu(cp, head, c_list) {
+				if (unlikely(p->pe_data && p->pe->ct_match)) {
+					if (cp->ipvs != p->ipvs)
+						continue;
+					if (p->pe == cp->pe &&
+					    p->pe->ct_match(p, cp)) {
+						if (__ip_vs_conn_get(cp))
+							goto out;
+					}
+					continue;
+				}
 
-		if (cp->af == p->af &&
-		    ip_vs_addr_equal(p->af, p->caddr, &cp->caddr) &&
-		    /* protocol should only be IPPROTO_IP if
-		     * p->vaddr is a fwmark */
-		    ip_vs_addr_equal(p->protocol == IPPROTO_IP ? AF_UNSPEC :
-				     p->af, p->vaddr, &cp->vaddr) &&
-		    p->vport == cp->vport && p->cport == cp->cport &&
-		    cp->flags & IP_VS_CONN_F_TEMPLATE &&
-		    p->protocol == cp->protocol &&
-		    cp->ipvs == p->ipvs) {
-			if (__ip_vs_conn_get(cp))
-				goto out;
+				if (cp->af == p->af &&
+				    ip_vs_addr_equal(p->af, p->caddr,
+						     &cp->caddr) &&
+				    /* protocol should only be IPPROTO_IP if
+				     * p->vaddr is a fwmark */
+				    ip_vs_addr_equal(p->protocol == IPPROTO_IP ?
+						     AF_UNSPEC : p->af,
+						     p->vaddr, &cp->vaddr) &&
+				    p->vport == cp->vport &&
+				    p->cport == cp->cport &&
+				    cp->flags & IP_VS_CONN_F_TEMPLATE &&
+				    p->protocol == cp->protocol &&
+				    cp->ipvs == p->ipvs) {
+					if (__ip_vs_conn_get(cp))
+						goto out;
+				}
+			}
 		}
-	}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
 	cp = NULL;
 
   out:
@@ -400,10 +570,12 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
  *	p->vaddr, p->vport: pkt dest address (foreign host) */
 struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
+	unsigned int hash, seq;
+	struct hlist_head *head;
 	struct ip_vs_conn *cp, *ret=NULL;
 	const union nf_inet_addr *saddr;
 	__be16 sport;
+	int i;
 
 	/*
 	 *	Check for "full" addressed entries
@@ -412,31 +584,38 @@ struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
-		if (p->vport != cp->cport)
-			continue;
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
+		for (i = 0; (head = ip_vs_conn_bucket(hash, i)); i++) {
+			hlist_for_each_entry_rcu(cp, head, c_list) {
+				if (p->vport != cp->cport)
+					continue;
 
-		if (IP_VS_FWD_METHOD(cp) != IP_VS_CONN_F_MASQ) {
-			sport = cp->vport;
-			saddr = &cp->vaddr;
-		} else {
-			sport = cp->dport;
-			saddr = &cp->daddr;
-		}
+				if (IP_VS_FWD_METHOD(cp) != IP_VS_CONN_F_MASQ) {
+					sport = cp->vport;
+					saddr = &cp->vaddr;
+				} else {
+					sport = cp->dport;
+					saddr = &cp->daddr;
+				}
 
-		if (p->cport == sport && cp->af == p->af &&
-		    ip_vs_addr_equal(p->af, p->vaddr, &cp->caddr) &&
-		    ip_vs_addr_equal(p->af, p->caddr, saddr) &&
-		    p->protocol == cp->protocol &&
-		    cp->ipvs == p->ipvs) {
-			if (!__ip_vs_conn_get(cp))
-				continue;
-			/* HIT */
-			ret = cp;
-			break;
+				if (p->cport == sport && cp->af == p->af &&
+				    ip_vs_addr_equal(p->af, p->vaddr,
+						     &cp->caddr) &&
+				    ip_vs_addr_equal(p->af, p->caddr, saddr) &&
+				    p->protocol == cp->protocol &&
+				    cp->ipvs == p->ipvs) {
+					if (!__ip_vs_conn_get(cp))
+						continue;
+					/* HIT */
+					ret = cp;
+					goto out;
+				}
+			}
 		}
-	}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
 
+out:
 	rcu_read_unlock();
 
 	IP_VS_DBG_BUF(9, "lookup/out %s %s:%d->%s:%d %s\n",
@@ -899,6 +1078,7 @@ static void ip_vs_conn_expire(struct timer_list *t)
 		else
 			call_rcu(&cp->rcu_head, ip_vs_conn_rcu_free);
 		atomic_dec(&ipvs->conn_count);
+		ip_vs_conn_tab_check(atomic_dec_return(&ip_vs_conn_count));
 		return;
 	}
 
@@ -1000,6 +1180,7 @@ ip_vs_conn_new(const struct ip_vs_conn_param *p, int dest_af,
 	cp->out_seq.delta = 0;
 
 	atomic_inc(&ipvs->conn_count);
+	ip_vs_conn_tab_check(atomic_inc_return(&ip_vs_conn_count));
 	if (flags & IP_VS_CONN_F_NO_CPORT)
 		atomic_inc(&ip_vs_conn_no_cport_cnt);
 
@@ -1049,19 +1230,29 @@ struct ip_vs_iter_state {
 	struct hlist_head	*l;
 };
 
+/* The walkers of the whole table hold ip_vs_conn_tab_mutex, so that
+ * the table can not be replaced when they drop RCU to reschedule.
+ */
+static inline struct ip_vs_conn_tab *ip_vs_conn_tab_walk(void)
+{
+	return rcu_dereference_protected(ip_vs_conn_tab,
+					 lockdep_is_held(&ip_vs_conn_tab_mutex));
+}
+
 static void *ip_vs_conn_array(struct seq_file *seq, loff_t pos)
 {
 	int idx;
 	struct ip_vs_conn *cp;
 	struct ip_vs_iter_state *iter = seq->private;
+	struct ip_vs_conn_tab *t = ip_vs_conn_tab_walk();
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+	for (idx = 0; idx < t->size; idx++) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			/* __ip_vs_conn_get() is not needed by
 			 * ip_vs_conn_seq_show and ip_vs_conn_sync_seq_show
 			 */
 			if (pos-- == 0) {
-				iter->l = &ip_vs_conn_tab[idx];
+				iter->l = &t->buckets[idx];
 				return cp;
 			}
 		}
@@ -1077,6 +1268,7 @@ static void *ip_vs_conn_seq_start(struct seq_file *seq, loff_t *pos)
 	struct ip_vs_iter_state *iter = seq->private;
 
 	iter->l = NULL;
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
 	return *pos ? ip_vs_conn_array(seq, *pos - 1) :SEQ_START_TOKEN;
 }
@@ -1085,6 +1277,7 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 {
 	struct ip_vs_conn *cp = v;
 	struct ip_vs_iter_state *iter = seq->private;
+	struct ip_vs_conn_tab *t = ip_vs_conn_tab_walk();
 	struct hlist_node *e;
 	struct hlist_head *l = iter->l;
 	int idx;
@@ -1098,10 +1291,10 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	if (e)
 		return hlist_entry(e, struct ip_vs_conn, c_list);
 
-	idx = l - ip_vs_conn_tab;
-	while (++idx < ip_vs_conn_tab_size) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
-			iter->l = &ip_vs_conn_tab[idx];
+	idx = l - t->buckets;
+	while (++idx < t->size) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
+			iter->l = &t->buckets[idx];
 			return cp;
 		}
 		cond_resched_rcu();
@@ -1114,6 +1307,7 @@ static void ip_vs_conn_seq_stop(struct seq_file *seq, void *v)
 	__releases(RCU)
 {
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 }
 
 static int ip_vs_conn_seq_show(struct seq_file *seq, void *v)
@@ -1307,10 +1501,11 @@ void ip_vs_random_dropentry(struct netns_ipvs *ipvs)
 	/*
 	 * Randomly scan 1/32 of the whole table every second
 	 */
-	for (idx = 0; idx < (ip_vs_conn_tab_size>>5); idx++) {
-		unsigned int hash = get_random_u32() & ip_vs_conn_tab_mask;
+	for (idx = 0; idx < (READ_ONCE(ip_vs_conn_tab_size)>>5); idx++) {
+		unsigned int hash = get_random_u32();
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+		hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(hash, 0),
+					 c_list) {
 			if (cp->ipvs != ipvs)
 				continue;
 			if (atomic_read(&cp->n_control))
@@ -1372,12 +1567,15 @@ static void ip_vs_conn_flush(struct netns_ipvs *ipvs)
 {
 	int idx;
 	struct ip_vs_conn *cp, *cp_c;
+	struct ip_vs_conn_tab *t;
 
 flush_again:
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
+	t = ip_vs_conn_tab_walk();
+	for (idx = 0; idx < t->size; idx++) {
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			if (cp->ipvs != ipvs)
 				continue;
 			if (atomic_read(&cp->n_control))
@@ -1393,6 +1591,7 @@ static void ip_vs_conn_flush(struct netns_ipvs *ipvs)
 		cond_resched_rcu();
 	}
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 
 	/* the counter may be not NULL, because maybe some conn entries
 	   are run by slow timer handler or unhashed but still referred */
@@ -1408,10 +1607,13 @@ void ip_vs_expire_nodest_conn_flush(struct netns_ipvs *ipvs)
 	int idx;
 	struct ip_vs_conn *cp, *cp_c;
 	struct ip_vs_dest *dest;
+	struct ip_vs_conn_tab *t;
 
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+	t = ip_vs_conn_tab_walk();
+	for (idx = 0; idx < t->size; idx++) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			if (cp->ipvs != ipvs)
 				continue;
 
@@ -1437,6 +1639,7 @@ void ip_vs_expire_nodest_conn_flush(struct netns_ipvs *ipvs)
 			break;
 	}
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 }
 #endif
 
@@ -1481,7 +1684,7 @@ void __net_exit ip_vs_conn_net_cleanup(struct netns_ipvs *ipvs)
 
 int __init ip_vs_conn_init(void)
 {
-	size_t tab_array_size;
+	struct ip_vs_conn_tab *t;
 	int idx;
 
 	/* Compute size and mask */
@@ -1489,35 +1692,38 @@ int __init ip_vs_conn_init(void)
 		pr_info("conn_tab_bits not in [8, 20]. Using default value\n");
 		ip_vs_conn_tab_bits = CONFIG_IP_VS_TAB_BITS;
 	}
-	ip_vs_conn_tab_size = 1 << ip_vs_conn_tab_bits;
-	ip_vs_conn_tab_mask = ip_vs_conn_tab_size - 1;
+	if (ip_vs_conn_tab_max_bits < ip_vs_conn_tab_bits ||
+	    ip_vs_conn_tab_max_bits > IP_VS_CONN_TAB_MAX_BITS) {
+		pr_info("conn_tab_max_bits not in [%d, %d]. Using %d\n",
+			ip_vs_conn_tab_bits, IP_VS_CONN_TAB_MAX_BITS,
+			ip_vs_conn_tab_bits);
+		ip_vs_conn_tab_max_bits = ip_vs_conn_tab_bits;
+	}
 
 	/*
 	 * Allocate the connection hash table and initialize its list heads
 	 */
-	tab_array_size = array_size(ip_vs_conn_tab_size,
-				    sizeof(*ip_vs_conn_tab));
-	ip_vs_conn_tab = vmalloc(tab_array_size);
-	if (!ip_vs_conn_tab)
+	t = ip_vs_conn_tab_alloc(ip_vs_conn_tab_bits);
+	if (!t)
 		return -ENOMEM;
+	ip_vs_conn_tab_size = t->size;
+	RCU_INIT_POINTER(ip_vs_conn_tab, t);
 
 	/* Allocate ip_vs_conn slab cache */
 	ip_vs_conn_cachep = kmem_cache_create("ip_vs_conn",
 					      sizeof(struct ip_vs_conn), 0,
 					      SLAB_HWCACHE_ALIGN, NULL);
 	if (!ip_vs_conn_cachep) {
-		vfree(ip_vs_conn_tab);
+		kvfree(t);
 		return -ENOMEM;
 	}
 
-	pr_info("Connection hash table configured (size=%d, memory=%zdKbytes)\n",
-		ip_vs_conn_tab_size, tab_array_size / 1024);
+	pr_info("Connection hash table configured (size=%d, max=%d, memory=%zdKbytes)\n",
+		ip_vs_conn_tab_size, 1 << ip_vs_conn_tab_max_bits,
+		struct_size(t, buckets, t->size) / 1024);
 	IP_VS_DBG(0, "Each connection entry needs %zd bytes at least\n",
 		  sizeof(struct ip_vs_conn));
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++)
-		INIT_HLIST_HEAD(&ip_vs_conn_tab[idx]);
-
 	for (idx = 0; idx < CT_LOCKARRAY_SIZE; idx++)  {
 		spin_lock_init(&__ip_vs_conntbl_lock_array[idx].l);
 	}
@@ -1530,9 +1736,10 @@ int __init ip_vs_conn_init(void)
 
 void ip_vs_conn_cleanup(void)
 {
+	cancel_work_sync(&ip_vs_conn_tab_work);
 	/* Wait all ip_vs_conn_rcu_free() callbacks to complete */
 	rcu_barrier();
 	/* Release the empty cache */
 	kmem_cache_destroy(ip_vs_conn_cachep);
-	vfree(ip_vs_conn_tab);
+	kvfree(rcu_dereference_protected(ip_vs_conn_tab, 1));
 }
@@ -322,6 +322,32 @@ sb_dequeue(struct netns_ipvs *ipvs, struct ipvs_master_sync_state *ms)
 	return sb;
 }
 
+/*
+ * Move all queued buffers to @list, so that the master thread takes
+ * sync_lock once per batch rather than once per message. The @sent
+ * buffers of the previous batch count against sync_qlen_max until
+ * then, so the queue does not grow beyond it while they are sent.
+ */
+static inline unsigned int
+sb_dequeue_batch(struct netns_ipvs *ipvs, struct ipvs_master_sync_state *ms,
+		 struct list_head *list, unsigned int sent)
+{
+	unsigned int n;
+
+	spin_lock_bh(&ipvs->sync_lock);
+	ms->sync_queue_len -= sent;
+	n = ms->sync_queue_len;
+	if (!n) {
+		__set_current_state(TASK_INTERRUPTIBLE);
+	} else {
+		list_splice_tail_init(&ms->sync_queue, list);
+		ms->sync_queue_delay = 0;
+	}
+	spin_unlock_bh(&ipvs->sync_lock);
+
+	return n;
+}
+
 /*
  * Create a new sync buffer for Version 1 proto.
  */
@@ -1640,17 +1666,22 @@ static void master_wakeup_work_handler(struct work_struct *work)
 	spin_unlock_bh(&ipvs->sync_lock);
 }
 
-/* Get next buffer to send */
-static inline struct ip_vs_sync_buff *
-next_sync_buff(struct netns_ipvs *ipvs, struct ipvs_master_sync_state *ms)
+/* Get next buffers to send, returns the number taken from the queue */
+static inline unsigned int
+next_sync_buffs(struct netns_ipvs *ipvs, struct ipvs_master_sync_state *ms,
+		struct list_head *list, unsigned int sent)
 {
 	struct ip_vs_sync_buff *sb;
+	unsigned int n;
 
-	sb = sb_dequeue(ipvs, ms);
-	if (sb)
-		return sb;
+	n = sb_dequeue_batch(ipvs, ms, list, sent);
+	if (n)
+		return n;
 	/* Do not delay entries in buffer for more than 2 seconds */
-	return get_curr_sync_buff(ipvs, ms, IPVS_SYNC_FLUSH_TIME);
+	sb = get_curr_sync_buff(ipvs, ms, IPVS_SYNC_FLUSH_TIME);
+	if (sb)
+		list_add_tail(&sb->list, list);
+	return 0;
 }
 
 static int sync_thread_master(void *data)
@@ -1659,36 +1690,41 @@ static int sync_thread_master(void *data)
 	struct netns_ipvs *ipvs = tinfo->ipvs;
 	struct ipvs_master_sync_state *ms = &ipvs->ms[tinfo->id];
 	struct sock *sk = tinfo->sock->sk;
-	struct ip_vs_sync_buff *sb;
+	struct ip_vs_sync_buff *sb, *next;
+	unsigned int batch = 0;
+	LIST_HEAD(list);
 
 	pr_info("sync thread started: state = MASTER, mcast_ifn = %s, "
 		"syncid = %d, id = %d\n",
 		ipvs->mcfg.mcast_ifn, ipvs->mcfg.syncid, tinfo->id);
 
 	for (;;) {
-		sb = next_sync_buff(ipvs, ms);
+		batch = next_sync_buffs(ipvs, ms, &list, batch);
 		if (unlikely(kthread_should_stop()))
 			break;
-		if (!sb) {
+		if (list_empty(&list)) {
 			schedule_timeout(IPVS_SYNC_CHECK_PERIOD);
 			continue;
 		}
-		while (ip_vs_send_sync_msg(tinfo->sock, sb->mesg) < 0) {
-			/* (Ab)use interruptible sleep to avoid increasing
-			 * the load avg.
-			 */
-			__wait_event_interruptible(*sk_sleep(sk),
-						   sock_writeable(sk) ||
-						   kthread_should_stop());
-			if (unlikely(kthread_should_stop()))
-				goto done;
+		list_for_each_entry_safe(sb, next, &list, list) {
+			while (ip_vs_send_sync_msg(tinfo->sock, sb->mesg) < 0) {
+				/* (Ab)use interruptible sleep to avoid
+				 * increasing the load avg.
+				 */
+				__wait_event_interruptible(*sk_sleep(sk),
+							   sock_writeable(sk) ||
+							   kthread_should_stop());
+				if (unlikely(kthread_should_stop()))
+					goto done;
+			}
+			list_del(&sb->list);
+			ip_vs_sync_buff_release(sb);
 		}
-		ip_vs_sync_buff_release(sb);
 	}
 
 done:
 	__set_current_state(TASK_RUNNING);
-	if (sb)
+	list_for_each_entry_safe(sb, next, &list, list)
 		ip_vs_sync_buff_release(sb);
 
 	/* clean up the sync_buff queue */
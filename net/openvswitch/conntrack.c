@@ -462,6 +462,13 @@ ovs_ct_expect_find(struct net *net, const struct nf_conntrack_zone *zone,
 	struct nf_conntrack_tuple tuple;
 	struct nf_conntrack_expect *exp;
 
+	/* Most packets of established flows are looked up while there are
+	 * no expectations at all; don't pay for the tuple extraction and
+	 * the expectation hash walk on every one of them.
+	 */
+	if (!READ_ONCE(nf_ct_pernet(net)->expect_count))
+		return NULL;
+
 	if (!nf_ct_get_tuplepr(skb, skb_network_offset(skb), proto, net, &tuple))
 		return NULL;
 
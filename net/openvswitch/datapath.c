@@ -123,12 +123,12 @@ int lockdep_ovsl_is_held(void)
 #endif
 
 static struct vport *new_vport(const struct vport_parms *);
-static int queue_gso_packets(struct datapath *dp, struct sk_buff *,
-			     const struct sw_flow_key *,
+static int queue_gso_packets(struct datapath *dp, int dp_ifindex,
+			     struct sk_buff *, const struct sw_flow_key *,
 			     const struct dp_upcall_info *,
 			     uint32_t cutlen);
-static int queue_userspace_packet(struct datapath *dp, struct sk_buff *,
-				  const struct sw_flow_key *,
+static int queue_userspace_packet(struct datapath *dp, int dp_ifindex,
+				  struct sk_buff *, const struct sw_flow_key *,
 				  const struct dp_upcall_info *,
 				  uint32_t cutlen);
 
@@ -314,7 +314,7 @@ int ovs_dp_upcall(struct datapath *dp, struct sk_buff *skb,
 		  uint32_t cutlen)
 {
 	struct dp_stats_percpu *stats;
-	int err;
+	int err, dp_ifindex;
 
 	if (trace_ovs_dp_upcall_enabled())
 		trace_ovs_dp_upcall(dp, skb, key, upcall_info);
@@ -324,10 +324,19 @@ int ovs_dp_upcall(struct datapath *dp, struct sk_buff *skb,
 		goto err;
 	}
 
-	if (!skb_is_gso(skb))
-		err = queue_userspace_packet(dp, skb, key, upcall_info, cutlen);
+	/* Look the datapath ifindex up once for the whole upcall rather
+	 * than once per GSO segment, and don't bother segmenting a packet
+	 * that could not be delivered anyway.
+	 */
+	dp_ifindex = get_dpifindex(dp);
+	if (!dp_ifindex)
+		err = -ENODEV;
+	else if (!skb_is_gso(skb))
+		err = queue_userspace_packet(dp, dp_ifindex, skb, key,
+					     upcall_info, cutlen);
 	else
-		err = queue_gso_packets(dp, skb, key, upcall_info, cutlen);
+		err = queue_gso_packets(dp, dp_ifindex, skb, key,
+					upcall_info, cutlen);
 
 	ovs_vport_update_upcall_stats(skb, upcall_info, !err);
 	if (err)
@@ -345,7 +354,8 @@ int ovs_dp_upcall(struct datapath *dp, struct sk_buff *skb,
 	return err;
 }
 
-static int queue_gso_packets(struct datapath *dp, struct sk_buff *skb,
+static int queue_gso_packets(struct datapath *dp, int dp_ifindex,
+			     struct sk_buff *skb,
 			     const struct sw_flow_key *key,
 			     const struct dp_upcall_info *upcall_info,
 			     uint32_t cutlen)
@@ -376,7 +386,8 @@ static int queue_gso_packets(struct datapath *dp, struct sk_buff *skb,
 		if (gso_type & SKB_GSO_UDP && skb != segs)
 			key = &later_key;
 
-		err = queue_userspace_packet(dp, skb, key, upcall_info, cutlen);
+		err = queue_userspace_packet(dp, dp_ifindex, skb, key,
+					     upcall_info, cutlen);
 		if (err)
 			break;
 
@@ -430,7 +441,8 @@ static void pad_packet(struct datapath *dp, struct sk_buff *skb)
 	}
 }
 
-static int queue_userspace_packet(struct datapath *dp, struct sk_buff *skb,
+static int queue_userspace_packet(struct datapath *dp, int dp_ifindex,
+				  struct sk_buff *skb,
 				  const struct sw_flow_key *key,
 				  const struct dp_upcall_info *upcall_info,
 				  uint32_t cutlen)
@@ -441,13 +453,9 @@ static int queue_userspace_packet(struct datapath *dp, struct sk_buff *skb,
 	struct nlattr *nla;
 	size_t len;
 	unsigned int hlen;
-	int err, dp_ifindex;
+	int err;
 	u64 hash;
 
-	dp_ifindex = get_dpifindex(dp);
-	if (!dp_ifindex)
-		return -ENODEV;
-
 	if (skb_vlan_tag_present(skb)) {
 		nskb = skb_clone(skb, GFP_ATOMIC);
 		if (!nskb)
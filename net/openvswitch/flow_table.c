@@ -1104,6 +1104,36 @@ static int compare_mask_and_count(const void *a, const void *b)
 	return (s64)mc_b->counter - (s64)mc_a->counter;
 }
 
+/* Point the mask cache entries of all CPUs at the new positions of the
+ * masks after a rebalance, rather than letting each of them miss once
+ * and walk the whole mask array. The cache is only a hint, so racing
+ * with the lookups on the other CPUs is fine.
+ */
+static void tbl_mask_cache_remap(struct flow_table *table,
+				 const u32 *new_index, u32 masks_entries)
+{
+	struct mask_cache *mc = rcu_dereference_ovsl(table->mask_cache);
+	int cpu;
+	u32 i;
+
+	if (!mc->cache_size)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct mask_cache_entry *entries;
+
+		entries = per_cpu_ptr(mc->mask_cache, cpu);
+		for (i = 0; i < mc->cache_size; i++) {
+			u32 index = READ_ONCE(entries[i].mask_index);
+
+			if (index < masks_entries)
+				WRITE_ONCE(entries[i].mask_index,
+					   new_index[index]);
+		}
+		cond_resched();
+	}
+}
+
 /* Must be called with OVS mutex held. */
 void ovs_flow_masks_rebalance(struct flow_table *table)
 {
@@ -1111,6 +1141,7 @@ void ovs_flow_masks_rebalance(struct flow_table *table)
 	struct mask_count *masks_and_count;
 	struct mask_array *new;
 	int masks_entries = 0;
+	u32 *new_index;
 	int i;
 
 	/* Build array of all current entries with use counters. */
@@ -1174,9 +1205,13 @@ void ovs_flow_masks_rebalance(struct flow_table *table)
 	if (!new)
 		goto free_mask_entries;
 
+	new_index = kmalloc_array(masks_entries, sizeof(*new_index),
+				  GFP_KERNEL);
 	for (i = 0; i < masks_entries; i++) {
 		int index = masks_and_count[i].index;
 
+		if (new_index)
+			new_index[index] = new->count;
 		if (ovsl_dereference(ma->masks[index]))
 			new->masks[new->count++] = ma->masks[index];
 	}
@@ -1184,6 +1219,11 @@ void ovs_flow_masks_rebalance(struct flow_table *table)
 	rcu_assign_pointer(table->mask_array, new);
 	call_rcu(&ma->rcu, mask_array_rcu_cb);
 
+	if (new_index) {
+		tbl_mask_cache_remap(table, new_index, masks_entries);
+		kfree(new_index);
+	}
+
 free_mask_entries:
 	kfree(masks_and_count);
 }
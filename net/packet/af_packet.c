@@ -4547,6 +4547,8 @@ static int packet_mmap(struct file *file, struct socket *sock,
 	struct packet_sock *po = pkt_sk(sk);
 	unsigned long size, expected_size;
 	struct packet_ring_buffer *rb;
+	unsigned int max_pages = 0;
+	struct page **pages;
 	unsigned long start;
 	int err = -EINVAL;
 	int i;
@@ -4562,6 +4564,7 @@ static int packet_mmap(struct file *file, struct socket *sock,
 			expected_size += rb->pg_vec_len
 						* rb->pg_vec_pages
 						* PAGE_SIZE;
+			max_pages = max(max_pages, rb->pg_vec_pages);
 		}
 	}
 
@@ -4572,24 +4575,35 @@ static int packet_mmap(struct file *file, struct socket *sock,
 	if (size != expected_size)
 		goto out;
 
+	/* Blocks are mapped whole, so that a ring of large blocks takes
+	 * one page table walk and lock per block rather than per page.
+	 */
+	pages = kvmalloc_array(max_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages) {
+		err = -ENOMEM;
+		goto out;
+	}
+
 	start = vma->vm_start;
 	for (rb = &po->rx_ring; rb <= &po->tx_ring; rb++) {
 		if (rb->pg_vec == NULL)
 			continue;
 
 		for (i = 0; i < rb->pg_vec_len; i++) {
-			struct page *page;
 			void *kaddr = rb->pg_vec[i].buffer;
+			unsigned long nr_pages;
 			int pg_num;
 
 			for (pg_num = 0; pg_num < rb->pg_vec_pages; pg_num++) {
-				page = pgv_to_page(kaddr);
-				err = vm_insert_page(vma, start, page);
-				if (unlikely(err))
-					goto out;
-				start += PAGE_SIZE;
+				pages[pg_num] = pgv_to_page(kaddr);
 				kaddr += PAGE_SIZE;
 			}
+
+			nr_pages = rb->pg_vec_pages;
+			err = vm_insert_pages(vma, start, pages, &nr_pages);
+			if (unlikely(err))
+				goto out_free;
+			start += rb->pg_vec_pages * PAGE_SIZE;
 		}
 	}
 
@@ -4597,6 +4611,8 @@ static int packet_mmap(struct file *file, struct socket *sock,
 	vma->vm_ops = &packet_mmap_ops;
 	err = 0;
 
+out_free:
+	kvfree(pages);
 out:
 	mutex_unlock(&po->pg_vec_lock);
 	return err;
@@ -93,8 +93,11 @@ enum {
 
 /* Max number of multipaths per RDS connection. Must be a power of 2 */
 #define	RDS_MPATH_WORKERS	8
+/* The number of paths negotiated with the peer need not be a power of 2,
+ * so spread sockets over all of them rather than masking.
+ */
 #define	RDS_MPATH_HASH(rs, n) (jhash_1word((rs)->rs_bound_port, \
-			       (rs)->rs_hash_initval) & ((n) - 1))
+			       (rs)->rs_hash_initval) % (n))
 
 #define IS_CANONICAL(laddr, faddr) (htonl(laddr) < htonl(faddr))
 
@@ -141,14 +141,19 @@ static bool smc_tx_is_corked(struct smc_sock *smc)
  *     message's completion
  *  3. Don't cork to much data in a single RDMA Write to prevent burst
  *     traffic, total corked message should not exceed sendbuf/2
+ *  4. Don't cork more than the peer can take right now: a single RDMA
+ *     Write can't carry more than that anyway, so waiting for more
+ *     only adds latency
  */
 static bool smc_should_autocork(struct smc_sock *smc)
 {
 	struct smc_connection *conn = &smc->conn;
-	int corking_size;
+	unsigned int corking_size;
 
 	corking_size = min_t(unsigned int, conn->sndbuf_desc->len >> 1,
 			     sock_net(&smc->sk)->smc.sysctl_autocorking_size);
+	corking_size = min_t(unsigned int, corking_size,
+			     atomic_read(&conn->peer_rmbe_space));
 
 	if (atomic_read(&conn->cdc_pend_tx_wr) == 0 ||
 	    smc_tx_prepared_sends(conn) > corking_size)
@@ -2487,8 +2487,8 @@ int tipc_link_bc_ack_rcv(struct tipc_link *r, u16 acked, u16 gap,
 			 struct sk_buff_head *retrq)
 {
 	struct tipc_link *l = r->bc_sndlink;
-	bool unused = false;
-	int rc = 0;
+	bool retransmitted = false;
+	int released, rc = 0;
 
 	if (!link_is_up(r) || !r->bc_peer_is_up)
 		return 0;
@@ -2502,8 +2502,14 @@ int tipc_link_bc_ack_rcv(struct tipc_link *r, u16 acked, u16 gap,
 		return 0;
 
 	trace_tipc_link_bc_ack(r, acked, gap, &l->transmq);
-	tipc_link_advance_transmq(l, r, acked, gap, ga, retrq, &unused, &rc);
+	released = tipc_link_advance_transmq(l, r, acked, gap, ga, retrq,
+					     &retransmitted, &rc);
 
+	/* Let the broadcast window adapt between its configured limits
+	 * just like a unicast link's, instead of staying at min_win
+	 */
+	if (released || retransmitted)
+		tipc_link_update_cwin(l, released, retransmitted);
 	tipc_link_advance_backlog(l, xmitq);
 	if (unlikely(!skb_queue_empty(&l->wakeupq)))
 		link_prepare_wakeup(l);
@@ -36,6 +36,7 @@
  */
 
 #include <net/sock.h>
+#include <linux/hash.h>
 #include <linux/list_sort.h>
 #include <linux/rbtree_augmented.h>
 #include "core.h"
@@ -217,7 +218,10 @@ static struct service_range *service_range_match_next(struct rb_node *n,
 
 static int hash(int x)
 {
-	return x & (TIPC_NAMETBL_SIZE - 1);
+	/* Service types are often allocated in strides or share their low
+	 * bits, so mix all of them in rather than just masking.
+	 */
+	return hash_32(x, ilog2(TIPC_NAMETBL_SIZE));
 }
 
 /**
@@ -929,6 +929,34 @@ static int tls_sw_push_pending_record(struct sock *sk, int flags)
 				   &copied, flags);
 }
 
+/* A full record with more of the message left to copy is followed by
+ * another record from the same call. Hand it to TCP with MSG_MORE so the
+ * records of one sendmsg() are queued as a batch and pushed out together
+ * with the last one, rather than each record ending in a short segment.
+ */
+static int tls_sw_rec_flags(struct msghdr *msg, bool full_record)
+{
+	if (full_record && msg_data_left(msg))
+		return msg->msg_flags | MSG_MORE;
+	return msg->msg_flags;
+}
+
+/* sendmsg() is bailing out before the record that was to end the batch:
+ * push what went to TCP with MSG_MORE, and make sure the last record still
+ * waiting for its encryption to complete doesn't keep TCP corked either.
+ */
+static void tls_sw_uncork_records(struct sock *sk,
+				  struct tls_sw_context_tx *ctx)
+{
+	struct tls_rec *rec;
+
+	if (!list_empty(&ctx->tx_list)) {
+		rec = list_last_entry(&ctx->tx_list, struct tls_rec, list);
+		rec->tx_flags &= ~MSG_MORE;
+	}
+	tcp_push_pending_frames(sk);
+}
+
 int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 {
 	long timeo = sock_sndtimeo(sk, msg->msg_flags & MSG_DONTWAIT);
@@ -939,6 +967,7 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	unsigned char record_type = TLS_RECORD_TYPE_DATA;
 	bool is_kvec = iov_iter_is_kvec(&msg->msg_iter);
 	bool eor = !(msg->msg_flags & MSG_MORE);
+	bool corked = false;
 	size_t try_to_copy;
 	ssize_t copied = 0;
 	struct sk_msg *msg_pl, *msg_en;
@@ -949,6 +978,7 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	int record_room;
 	int num_zc = 0;
 	int orig_size;
+	int rec_flags;
 	int ret = 0;
 	int pending;
 
@@ -1030,9 +1060,11 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 			copied += try_to_copy;
 
 			sk_msg_sg_copy_set(msg_pl, first);
+			rec_flags = tls_sw_rec_flags(msg, full_record);
+			corked |= rec_flags != msg->msg_flags;
 			ret = bpf_exec_tx_verdict(msg_pl, sk, full_record,
 						  record_type, &copied,
-						  msg->msg_flags);
+						  rec_flags);
 			if (ret) {
 				if (ret == -EINPROGRESS)
 					num_async++;
@@ -1083,9 +1115,11 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 		tls_ctx->pending_open_record_frags = true;
 		copied += try_to_copy;
 		if (full_record || eor) {
+			rec_flags = tls_sw_rec_flags(msg, full_record);
+			corked |= rec_flags != msg->msg_flags;
 			ret = bpf_exec_tx_verdict(msg_pl, sk, full_record,
 						  record_type, &copied,
-						  msg->msg_flags);
+						  rec_flags);
 			if (ret) {
 				if (ret == -EINPROGRESS)
 					num_async++;
@@ -1148,6 +1182,9 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	}
 
 send_end:
+	if (corked && eor && msg_data_left(msg))
+		tls_sw_uncork_records(sk, ctx);
+
 	ret = sk_stream_error(sk, msg->msg_flags, ret);
 
 	release_sock(sk);
@@ -1638,7 +1675,7 @@ tls_decrypt_sw(struct sock *sk, struct tls_context *tls_ctx,
 	if (unlikely(darg->zc && prot->version == TLS_1_3_VERSION &&
 		     darg->tail != TLS_RECORD_TYPE_DATA)) {
 		darg->zc = false;
-		if (!darg->tail)
+		if (!darg->tail && tls_ctx->rx_no_pad)
 			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXNOPADVIOL);
 		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSDECRYPTRETRY);
 		return tls_decrypt_sw(sk, tls_ctx, msg, darg);
@@ -1943,6 +1980,7 @@ int tls_sw_recvmsg(struct sock *sk,
 	bool released = true;
 	bool bpf_strp_enabled;
 	bool zc_capable;
+	bool zc_guess, zc_learned = false;
 
 	if (unlikely(flags & MSG_ERRQUEUE))
 		return sock_recv_errqueue(sk, msg, len, SOL_IP, IP_RECVERR);
@@ -1970,12 +2008,15 @@ int tls_sw_recvmsg(struct sock *sk,
 	target = sock_rcvlowat(sk, flags & MSG_WAITALL, len);
 	len = len - copied;
 
-	zc_capable = !bpf_strp_enabled && !is_kvec && !is_peek &&
-		ctx->zc_capable;
+	zc_capable = !bpf_strp_enabled && !is_kvec && !is_peek;
+	/* TLS 1.3 without TLS_RX_EXPECT_NO_PAD, see below */
+	zc_guess = zc_capable && !ctx->zc_capable;
+	zc_capable &= ctx->zc_capable;
 	decrypted = 0;
 	while (len && (decrypted + copied < target || tls_strp_msg_ready(ctx))) {
 		struct tls_decrypt_arg darg;
 		int to_decrypt, chunk;
+		bool guessed;
 
 		err = tls_rx_rec_wait(sk, psock, flags & MSG_DONTWAIT,
 				      released);
@@ -2003,6 +2044,19 @@ int tls_sw_recvmsg(struct sock *sk,
 		    tlm->control == TLS_RECORD_TYPE_DATA)
 			darg.zc = true;
 
+		/* Without TLS_RX_EXPECT_NO_PAD, a TLS 1.3 record is only
+		 * decrypted into the user buffer once this call has seen an
+		 * unpadded full-length data record, and only while such
+		 * guesses keep succeeding. A sender which fills its records
+		 * gets ZC for all but the first record of a large read, and
+		 * one which pads never costs a second decryption for it.
+		 */
+		guessed = zc_learned && to_decrypt == TLS_MAX_PAYLOAD_SIZE &&
+			  to_decrypt <= len &&
+			  tlm->control == TLS_RECORD_TYPE_DATA;
+		if (guessed)
+			darg.zc = true;
+
 		/* Do not use async mode if record is non-data */
 		if (tlm->control == TLS_RECORD_TYPE_DATA && !bpf_strp_enabled)
 			darg.async = ctx->async_capable;
@@ -2043,6 +2097,14 @@ int tls_sw_recvmsg(struct sock *sk,
 		chunk = rxm->full_len;
 		tls_rx_rec_done(ctx);
 
+		if (zc_guess) {
+			if (guessed && !darg.zc)
+				zc_guess = zc_learned = false;
+			else if (!darg.zc && chunk == TLS_MAX_PAYLOAD_SIZE &&
+				 control == TLS_RECORD_TYPE_DATA)
+				zc_learned = true;
+		}
+
 		if (!darg.zc) {
 			bool partially_consumed = chunk > len;
 			struct sk_buff *skb = darg.skb;
@@ -3776,6 +3776,7 @@ static int __init af_unix_init(void)
 static void __exit af_unix_exit(void)
 {
 	sock_unregister(PF_UNIX);
+	unix_gc_flush();
 	proto_unregister(&unix_dgram_proto);
 	proto_unregister(&unix_stream_proto);
 	unregister_pernet_subsys(&unix_net_ops);
@@ -26,12 +26,14 @@
 #include <net/xdp_sock_drv.h>
 #include <net/busy_poll.h>
 #include <net/xdp.h>
+#include <trace/events/xdp.h>
 
 #include "xsk_queue.h"
 #include "xdp_umem.h"
 #include "xsk.h"
 
 #define TX_BATCH_SIZE 32
+#define XSK_XMIT_BULK 16
 
 static DEFINE_PER_CPU(struct list_head, xskmap_flush_list);
 
@@ -512,14 +514,77 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 	return skb;
 }
 
+/* Give skbs[0..nb) to the driver under one tx lock, all but the last one
+ * with xmit_more set, and return how many it took.
+ */
+static u32 xsk_generic_xmit_bulk(struct xdp_sock *xs, struct sk_buff **skbs,
+				 u32 nb, int *err)
+{
+	struct net_device *dev = xs->dev;
+	struct netdev_queue *txq;
+	int ret;
+	u32 i;
+
+	txq = netdev_get_tx_queue(dev, xs->queue_id);
+	*err = 0;
+
+	local_bh_disable();
+	dev_xmit_recursion_inc();
+	HARD_TX_LOCK(dev, txq, smp_processor_id());
+	for (i = 0; i < nb; i++) {
+		if (netif_xmit_frozen_or_drv_stopped(txq)) {
+			*err = NETDEV_TX_BUSY;
+			break;
+		}
+		ret = netdev_start_xmit(skbs[i], dev, txq, i + 1 < nb);
+		if (ret == NETDEV_TX_BUSY) {
+			*err = NETDEV_TX_BUSY;
+			break;
+		}
+		/* Ignore NET_XMIT_CN as packet might have been sent */
+		if (ret == NET_XMIT_DROP)
+			*err = NET_XMIT_DROP;
+	}
+	HARD_TX_UNLOCK(dev, txq);
+	dev_xmit_recursion_dec();
+	local_bh_enable();
+
+	return i;
+}
+
+/* Give back the descriptors of skbs the driver didn't take, so that
+ * user-space can retry them.
+ */
+static void xsk_generic_xmit_cancel(struct xdp_sock *xs, struct sk_buff **skbs,
+				    u32 nb, u32 cons)
+{
+	unsigned long flags;
+	u32 i;
+
+	for (i = 0; i < nb; i++) {
+		skbs[i]->destructor = sock_wfree;
+		/* Free skb without triggering the perf drop trace */
+		consume_skb(skbs[i]);
+	}
+
+	spin_lock_irqsave(&xs->pool->cq_lock, flags);
+	xskq_prod_cancel_n(xs->pool->cq, nb);
+	spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+	xskq_cons_cancel_n(xs->tx, xs->tx->cached_cons - cons);
+}
+
 static int __xsk_generic_xmit(struct sock *sk)
 {
 	struct xdp_sock *xs = xdp_sk(sk);
+	struct sk_buff *skbs[XSK_XMIT_BULK];
+	u32 cons[XSK_XMIT_BULK];
 	u32 max_batch = TX_BATCH_SIZE;
 	bool sent_frame = false;
+	struct net_device *dev;
 	struct xdp_desc desc;
 	struct sk_buff *skb;
 	unsigned long flags;
+	bool stop = false;
 	int err = 0;
 
 	mutex_lock(&xs->mutex);
@@ -533,59 +598,109 @@ static int __xsk_generic_xmit(struct sock *sk)
 	if (xs->queue_id >= xs->dev->real_num_tx_queues)
 		goto out;
 
-	while (xskq_cons_peek_desc(xs->tx, &desc, xs->pool)) {
-		if (max_batch-- == 0) {
-			err = -EAGAIN;
-			goto out;
-		}
-
-		/* This is the backpressure mechanism for the Tx path.
-		 * Reserve space in the completion queue and only proceed
-		 * if there is space in it. This avoids having to implement
-		 * any buffering in the Tx path.
+	dev = xs->dev;
+	while (!stop) {
+		bool dropped = false;
+		bool again = false;
+		u32 nb = 0, sent, i;
+		int ret;
+
+		/* Build up to XSK_XMIT_BULK skbs. Only the first descriptor
+		 * of a bulk may refresh the ring, as that publishes the
+		 * consumer pointer. This way the rest of the bulk can still
+		 * be given back if the driver is busy.
 		 */
-		spin_lock_irqsave(&xs->pool->cq_lock, flags);
-		if (xskq_prod_reserve(xs->pool->cq)) {
-			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			goto out;
-		}
-		spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+		while (nb < XSK_XMIT_BULK) {
+			if (nb ? !xskq_cons_read_desc(xs->tx, &desc, xs->pool) :
+				 !xskq_cons_peek_desc(xs->tx, &desc, xs->pool)) {
+				if (!nb) {
+					xs->tx->queue_empty_descs++;
+					stop = true;
+				}
+				break;
+			}
+
+			if (max_batch-- == 0) {
+				err = -EAGAIN;
+				stop = true;
+				break;
+			}
 
-		skb = xsk_build_skb(xs, &desc);
-		if (IS_ERR(skb)) {
-			err = PTR_ERR(skb);
+			/* This is the backpressure mechanism for the Tx path.
+			 * Reserve space in the completion queue and only proceed
+			 * if there is space in it. This avoids having to implement
+			 * any buffering in the Tx path.
+			 */
 			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
+			if (xskq_prod_reserve(xs->pool->cq)) {
+				spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+				stop = true;
+				break;
+			}
 			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			goto out;
+
+			skb = xsk_build_skb(xs, &desc);
+			if (IS_ERR(skb)) {
+				err = PTR_ERR(skb);
+				spin_lock_irqsave(&xs->pool->cq_lock, flags);
+				xskq_prod_cancel(xs->pool->cq);
+				spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+				stop = true;
+				break;
+			}
+
+			cons[nb] = xs->tx->cached_cons;
+			xskq_cons_release(xs->tx);
+
+			/* What __dev_direct_xmit() does before taking the lock */
+			if (likely(netif_running(dev) && netif_carrier_ok(dev))) {
+				struct sk_buff *orig_skb = skb;
+
+				skb = validate_xmit_skb_list(skb, dev, &again);
+				if (likely(skb == orig_skb)) {
+					skb_set_queue_mapping(skb, xs->queue_id);
+					skbs[nb++] = skb;
+					continue;
+				}
+			}
+			dev_core_stats_tx_dropped_inc(dev);
+			kfree_skb_list(skb);
+			dropped = true;
+			stop = true;
+			break;
+		}
+		if (!nb) {
+			if (dropped)
+				err = -EBUSY;
+			break;
 		}
 
-		err = __dev_direct_xmit(skb, xs->queue_id);
-		if  (err == NETDEV_TX_BUSY) {
+		sent = xsk_generic_xmit_bulk(xs, skbs, nb, &ret);
+		if (sent)
+			sent_frame = true;
+		if (ret == NETDEV_TX_BUSY && !dropped) {
 			/* Tell user-space to retry the send */
-			skb->destructor = sock_wfree;
-			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
-			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			/* Free skb without triggering the perf drop trace */
-			consume_skb(skb);
+			xsk_generic_xmit_cancel(xs, skbs + sent, nb - sent,
+						cons[sent]);
 			err = -EAGAIN;
-			goto out;
+			break;
 		}
-
-		xskq_cons_release(xs->tx);
-		/* Ignore NET_XMIT_CN as packet might have been sent */
-		if (err == NET_XMIT_DROP) {
+		if (ret == NETDEV_TX_BUSY) {
+			/* The descriptor after these was already completed
+			 * as dropped, so these can't be given back any more.
+			 */
+			for (i = sent; i < nb; i++) {
+				dev_core_stats_tx_dropped_inc(dev);
+				kfree_skb(skbs[i]);
+			}
+		}
+		if (ret == NET_XMIT_DROP || dropped) {
 			/* SKB completed but not sent */
 			err = -EBUSY;
-			goto out;
+			break;
 		}
-
-		sent_frame = true;
 	}
 
-	xs->tx->queue_empty_descs++;
-
 out:
 	if (sent_frame)
 		if (xsk_tx_writeable(xs))
@@ -619,6 +734,42 @@ static bool xsk_no_wakeup(struct sock *sk)
 #endif
 }
 
+/* Busy poll on behalf of the Rx ring. The budget is capped by the room
+ * left in the ring, since anything NAPI produces beyond that is dropped,
+ * and no poll is done at all while the ring is full: the application has
+ * a backlog to work through first, and skipping the poll leaves the NAPI
+ * context to interrupts or to its own deferral timer in the meantime.
+ */
+static void xsk_rx_busy_loop(struct xdp_sock *xs)
+{
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	struct sock *sk = &xs->sk;
+	unsigned int napi_id = READ_ONCE(sk->sk_napi_id);
+	u32 queued, room;
+	u64 start;
+	u16 budget;
+
+	if (napi_id < MIN_NAPI_ID)
+		return;
+
+	queued = xskq_nb_queued(xs->rx);
+	room = xs->rx->nentries - min(queued, xs->rx->nentries);
+	if (!room)
+		return;
+
+	budget = READ_ONCE(sk->sk_busy_poll_budget) ?: BUSY_POLL_BUDGET;
+	budget = min_t(u32, budget, room);
+
+	start = trace_xsk_busy_poll_enabled() ? ktime_get_ns() : 0;
+	napi_busy_loop(napi_id, NULL, NULL, READ_ONCE(sk->sk_prefer_busy_poll),
+		       budget);
+	if (start)
+		trace_xsk_busy_poll(xs->dev, xs->queue_id, napi_id, budget,
+				    xskq_nb_queued(xs->rx) - queued,
+				    ktime_get_ns() - start);
+#endif
+}
+
 static int xsk_check_common(struct xdp_sock *xs)
 {
 	if (unlikely(!xsk_is_bound(xs)))
@@ -690,7 +841,7 @@ static int __xsk_recvmsg(struct socket *sock, struct msghdr *m, size_t len, int
 		return -EOPNOTSUPP;
 
 	if (sk_can_busy_loop(sk))
-		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+		xsk_rx_busy_loop(xs); /* only support non-blocking sockets */
 
 	if (xsk_no_wakeup(sk))
 		return 0;
@@ -475,71 +475,6 @@ static bool xp_check_aligned(struct xsk_buff_pool *pool, u64 *addr)
 	return *addr < pool->addrs_cnt;
 }
 
-static struct xdp_buff_xsk *__xp_alloc(struct xsk_buff_pool *pool)
-{
-	struct xdp_buff_xsk *xskb;
-	u64 addr;
-	bool ok;
-
-	if (pool->free_heads_cnt == 0)
-		return NULL;
-
-	for (;;) {
-		if (!xskq_cons_peek_addr_unchecked(pool->fq, &addr)) {
-			pool->fq->queue_empty_descs++;
-			return NULL;
-		}
-
-		ok = pool->unaligned ? xp_check_unaligned(pool, &addr) :
-		     xp_check_aligned(pool, &addr);
-		if (!ok) {
-			pool->fq->invalid_descs++;
-			xskq_cons_release(pool->fq);
-			continue;
-		}
-		break;
-	}
-
-	if (pool->unaligned) {
-		xskb = pool->free_heads[--pool->free_heads_cnt];
-		xp_init_xskb_addr(xskb, pool, addr);
-		if (pool->dma_pages_cnt)
-			xp_init_xskb_dma(xskb, pool, pool->dma_pages, addr);
-	} else {
-		xskb = &pool->heads[xp_aligned_extract_idx(pool, addr)];
-	}
-
-	xskq_cons_release(pool->fq);
-	return xskb;
-}
-
-struct xdp_buff *xp_alloc(struct xsk_buff_pool *pool)
-{
-	struct xdp_buff_xsk *xskb;
-
-	if (!pool->free_list_cnt) {
-		xskb = __xp_alloc(pool);
-		if (!xskb)
-			return NULL;
-	} else {
-		pool->free_list_cnt--;
-		xskb = list_first_entry(&pool->free_list, struct xdp_buff_xsk,
-					free_list_node);
-		list_del_init(&xskb->free_list_node);
-	}
-
-	xskb->xdp.data = xskb->xdp.data_hard_start + XDP_PACKET_HEADROOM;
-	xskb->xdp.data_meta = xskb->xdp.data;
-
-	if (pool->dma_need_sync) {
-		dma_sync_single_range_for_device(pool->dev, xskb->dma, 0,
-						 pool->frame_len,
-						 DMA_BIDIRECTIONAL);
-	}
-	return &xskb->xdp;
-}
-EXPORT_SYMBOL(xp_alloc);
-
 static u32 xp_alloc_new_from_fq(struct xsk_buff_pool *pool, struct xdp_buff **xdp, u32 max)
 {
 	u32 i, cached_cons, nb_entries;
@@ -583,6 +518,64 @@ static u32 xp_alloc_new_from_fq(struct xsk_buff_pool *pool, struct xdp_buff **xd
 	return nb_entries;
 }
 
+/* Number of frames xp_alloc() takes off the fill ring at a time */
+#define XP_ALLOC_REFILL_BATCH	16
+
+/* Move a batch of frames from the fill ring to the free list, so that
+ * xp_alloc() reads the ring once per batch instead of once per frame.
+ */
+static void xp_refill_free_list(struct xsk_buff_pool *pool)
+{
+	struct xdp_buff *xdp[XP_ALLOC_REFILL_BATCH];
+	struct xdp_buff_xsk *xskb;
+	u32 i, nb_entries;
+
+	/* Like xskq_cons_peek_addr_unchecked(), give the consumed entries
+	 * back to user-space once the cached ones are used up.
+	 */
+	if (pool->fq->cached_prod == pool->fq->cached_cons)
+		xskq_cons_get_entries(pool->fq);
+
+	nb_entries = xp_alloc_new_from_fq(pool, xdp, XP_ALLOC_REFILL_BATCH);
+	if (!nb_entries) {
+		pool->fq->queue_empty_descs++;
+		return;
+	}
+
+	for (i = 0; i < nb_entries; i++) {
+		xskb = container_of(xdp[i], struct xdp_buff_xsk, xdp);
+		list_add_tail(&xskb->free_list_node, &pool->free_list);
+	}
+	pool->free_list_cnt += nb_entries;
+}
+
+struct xdp_buff *xp_alloc(struct xsk_buff_pool *pool)
+{
+	struct xdp_buff_xsk *xskb;
+
+	if (!pool->free_list_cnt) {
+		xp_refill_free_list(pool);
+		if (!pool->free_list_cnt)
+			return NULL;
+	}
+
+	pool->free_list_cnt--;
+	xskb = list_first_entry(&pool->free_list, struct xdp_buff_xsk,
+				free_list_node);
+	list_del_init(&xskb->free_list_node);
+
+	xskb->xdp.data = xskb->xdp.data_hard_start + XDP_PACKET_HEADROOM;
+	xskb->xdp.data_meta = xskb->xdp.data;
+
+	if (pool->dma_need_sync) {
+		dma_sync_single_range_for_device(pool->dev, xskb->dma, 0,
+						 pool->frame_len,
+						 DMA_BIDIRECTIONAL);
+	}
+	return &xskb->xdp;
+}
+EXPORT_SYMBOL(xp_alloc);
+
 static u32 xp_alloc_reused(struct xsk_buff_pool *pool, struct xdp_buff **xdp, u32 nb_entries)
 {
 	struct xdp_buff_xsk *xskb;
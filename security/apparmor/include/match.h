@@ -100,6 +100,7 @@ struct aa_dfa {
 	u16 flags;
 	u32 max_oob;
 	struct table_header *tables[YYTD_ID_TSIZE];
+	u16 *accel;	/* per state: 1 + the only byte leaving it, or 0 */
 };
 
 extern struct aa_dfa *nulldfa;
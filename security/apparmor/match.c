@@ -262,6 +262,56 @@ static int verify_dfa(struct aa_dfa *dfa)
 	return error;
 }
 
+/**
+ * dfa_compute_accel - find the states that can be skipped over
+ * @dfa: verified dfa to compute the acceleration table for (NOT NULL)
+ *
+ * A state whose default transition is back to itself, and that leaves on
+ * exactly one input byte, stays put until that byte shows up. Such states
+ * come from "**" and similar rules, and long paths spend most of their
+ * matching in them, so the matcher searches for the byte with strchrnul()
+ * or memchr() instead of stepping through each one.
+ *
+ * The table is an optimisation only, it is simply left out if it can't be
+ * allocated.
+ */
+static void dfa_compute_accel(struct aa_dfa *dfa)
+{
+	u16 *def = DEFAULT_TABLE(dfa);
+	u32 *base = BASE_TABLE(dfa);
+	u16 *next = NEXT_TABLE(dfa);
+	u16 *check = CHECK_TABLE(dfa);
+	u8 *equiv = dfa->tables[YYTD_ID_EC] ? EQUIV_TABLE(dfa) : NULL;
+	size_t i, state_count = dfa->tables[YYTD_ID_BASE]->td_lolen;
+	u16 *accel;
+
+	accel = kvcalloc(state_count, sizeof(*accel), GFP_KERNEL);
+	if (!accel)
+		return;
+
+	/* state 0 is DFA_NOMATCH, it never needs matching */
+	for (i = 1; i < state_count; i++) {
+		u32 b = base[i];
+		int c, exits = 0, exit_c = 0;
+
+		if (def[i] != i || (b & MATCH_FLAG_DIFF_ENCODE))
+			continue;
+
+		for (c = 0; c < 256 && exits < 2; c++) {
+			unsigned int pos = base_idx(b) + (equiv ? equiv[c] : c);
+
+			if (check[pos] == i && next[pos] != i) {
+				exits++;
+				exit_c = c;
+			}
+		}
+		if (exits == 1)
+			accel[i] = exit_c + 1;
+	}
+
+	dfa->accel = accel;
+}
+
 /**
  * dfa_free - free a dfa allocated by aa_dfa_unpack
  * @dfa: the dfa to free  (MAYBE NULL)
@@ -277,6 +327,7 @@ static void dfa_free(struct aa_dfa *dfa)
 			kvfree(dfa->tables[i]);
 			dfa->tables[i] = NULL;
 		}
+		kvfree(dfa->accel);
 		kfree(dfa);
 	}
 }
@@ -396,6 +447,8 @@ struct aa_dfa *aa_dfa_unpack(void *blob, size_t size, int flags)
 		error = verify_dfa(dfa);
 		if (error)
 			goto fail;
+		/* the table walk relies on the bounds verify_dfa() checked */
+		dfa_compute_accel(dfa);
 	}
 
 	return dfa;
@@ -443,7 +496,9 @@ aa_state_t aa_dfa_match_len(struct aa_dfa *dfa, aa_state_t start,
 	u32 *base = BASE_TABLE(dfa);
 	u16 *next = NEXT_TABLE(dfa);
 	u16 *check = CHECK_TABLE(dfa);
+	u16 *accel = dfa->accel;
 	aa_state_t state = start;
+	const char *p;
 
 	if (state == DFA_NOMATCH)
 		return DFA_NOMATCH;
@@ -452,13 +507,29 @@ aa_state_t aa_dfa_match_len(struct aa_dfa *dfa, aa_state_t start,
 	if (dfa->tables[YYTD_ID_EC]) {
 		/* Equivalence class table defined */
 		u8 *equiv = EQUIV_TABLE(dfa);
-		for (; len; len--)
+		for (; len; len--) {
+			if (accel && accel[state]) {
+				p = memchr(str, accel[state] - 1, len);
+				if (!p)
+					break;
+				len -= p - str;
+				str = p;
+			}
 			match_char(state, def, base, next, check,
 				   equiv[(u8) *str++]);
+		}
 	} else {
 		/* default is direct to next state */
-		for (; len; len--)
+		for (; len; len--) {
+			if (accel && accel[state]) {
+				p = memchr(str, accel[state] - 1, len);
+				if (!p)
+					break;
+				len -= p - str;
+				str = p;
+			}
 			match_char(state, def, base, next, check, (u8) *str++);
+		}
 	}
 
 	return state;
@@ -482,6 +553,7 @@ aa_state_t aa_dfa_match(struct aa_dfa *dfa, aa_state_t start, const char *str)
 	u32 *base = BASE_TABLE(dfa);
 	u16 *next = NEXT_TABLE(dfa);
 	u16 *check = CHECK_TABLE(dfa);
+	u16 *accel = dfa->accel;
 	aa_state_t state = start;
 
 	if (state == DFA_NOMATCH)
@@ -492,13 +564,25 @@ aa_state_t aa_dfa_match(struct aa_dfa *dfa, aa_state_t start, const char *str)
 		/* Equivalence class table defined */
 		u8 *equiv = EQUIV_TABLE(dfa);
 		/* default is direct to next state */
-		while (*str)
+		while (*str) {
+			if (accel && accel[state]) {
+				str = strchrnul(str, accel[state] - 1);
+				if (!*str)
+					break;
+			}
 			match_char(state, def, base, next, check,
 				   equiv[(u8) *str++]);
+		}
 	} else {
 		/* default is direct to next state */
-		while (*str)
+		while (*str) {
+			if (accel && accel[state]) {
+				str = strchrnul(str, accel[state] - 1);
+				if (!*str)
+					break;
+			}
 			match_char(state, def, base, next, check, (u8) *str++);
+		}
 	}
 
 	return state;
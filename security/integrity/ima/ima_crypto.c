@@ -18,6 +18,8 @@
 #include <linux/scatterlist.h>
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/fsverity.h>
+#include <linux/hashtable.h>
 #include <crypto/hash.h>
 
 #include "ima.h"
@@ -52,7 +54,111 @@ static const struct kernel_param_ops param_ops_bufsize = {
 #define param_check_bufsize(name, p) __param_check(name, p, unsigned int)
 
 module_param_named(ahash_bufsize, ima_bufsize, bufsize, 0644);
-MODULE_PARM_DESC(ahash_bufsize, "Maximum ahash buffer size");
+MODULE_PARM_DESC(ahash_bufsize, "Maximum file read buffer size");
+
+/*
+ * Files with fs-verity enabled can't be modified, and their verity digest
+ * identifies their content. Container images often carry the same binary
+ * in many layers, i.e. in many inodes, so file hashes are remembered by
+ * verity digest and calculated once per content rather than per inode.
+ */
+static unsigned int ima_verity_cache_max = 1024;
+module_param_named(verity_cache_size, ima_verity_cache_max, uint, 0644);
+MODULE_PARM_DESC(verity_cache_size, "Number of file hashes cached by fs-verity digest");
+
+struct ima_verity_entry {
+	struct hlist_node hnode;
+	struct list_head lru;
+	enum hash_algo verity_algo;
+	enum hash_algo algo;
+	u8 verity_digest[FS_VERITY_MAX_DIGEST_SIZE];
+	u8 digest[IMA_MAX_DIGEST_SIZE];
+};
+
+static DEFINE_HASHTABLE(ima_verity_cache, 8);
+static LIST_HEAD(ima_verity_lru);
+static unsigned int ima_verity_cache_count;
+static DEFINE_SPINLOCK(ima_verity_lock);
+
+static u32 ima_verity_key(const u8 *verity_digest)
+{
+	u32 key;
+
+	/* the digest is uniformly distributed already */
+	memcpy(&key, verity_digest, sizeof(key));
+	return key;
+}
+
+static struct ima_verity_entry *
+ima_verity_find(enum hash_algo verity_algo, const u8 *verity_digest,
+		enum hash_algo algo)
+{
+	struct ima_verity_entry *e;
+
+	lockdep_assert_held(&ima_verity_lock);
+
+	hash_for_each_possible(ima_verity_cache, e, hnode,
+			       ima_verity_key(verity_digest)) {
+		if (e->verity_algo == verity_algo && e->algo == algo &&
+		    !memcmp(e->verity_digest, verity_digest,
+			    hash_digest_size[verity_algo]))
+			return e;
+	}
+	return NULL;
+}
+
+static bool ima_verity_cache_lookup(enum hash_algo verity_algo,
+				    const u8 *verity_digest,
+				    struct ima_digest_data *hash)
+{
+	struct ima_verity_entry *e;
+
+	spin_lock(&ima_verity_lock);
+	e = ima_verity_find(verity_algo, verity_digest, hash->algo);
+	if (e) {
+		list_move(&e->lru, &ima_verity_lru);
+		hash->length = hash_digest_size[hash->algo];
+		memcpy(hash->digest, e->digest, hash->length);
+	}
+	spin_unlock(&ima_verity_lock);
+
+	return e;
+}
+
+static void ima_verity_cache_insert(enum hash_algo verity_algo,
+				    const u8 *verity_digest,
+				    struct ima_digest_data *hash)
+{
+	struct ima_verity_entry *e, *old = NULL;
+
+	e = kzalloc(sizeof(*e), GFP_KERNEL);
+	if (!e)
+		return;
+
+	e->verity_algo = verity_algo;
+	e->algo = hash->algo;
+	memcpy(e->verity_digest, verity_digest, hash_digest_size[verity_algo]);
+	memcpy(e->digest, hash->digest, hash->length);
+
+	spin_lock(&ima_verity_lock);
+	if (ima_verity_find(verity_algo, verity_digest, hash->algo)) {
+		/* raced with another opener of the same content */
+		old = e;
+		goto out;
+	}
+	hash_add(ima_verity_cache, &e->hnode, ima_verity_key(verity_digest));
+	list_add(&e->lru, &ima_verity_lru);
+	if (++ima_verity_cache_count > READ_ONCE(ima_verity_cache_max)) {
+		old = list_last_entry(&ima_verity_lru, struct ima_verity_entry,
+				      lru);
+		hash_del(&old->hnode);
+		list_del(&old->lru);
+		ima_verity_cache_count--;
+	}
+out:
+	spin_unlock(&ima_verity_lock);
+	kfree(old);
+}
 
 static struct crypto_shash *ima_shash_tfm;
 static struct crypto_ahash *ima_ahash_tfm;
@@ -458,6 +564,7 @@ static int ima_calc_file_hash_tfm(struct file *file,
 				  struct crypto_shash *tfm)
 {
 	loff_t i_size, offset = 0;
+	size_t rbuf_size;
 	char *rbuf;
 	int rc;
 	SHASH_DESC_ON_STACK(shash, tfm);
@@ -475,14 +582,15 @@ static int ima_calc_file_hash_tfm(struct file *file,
 	if (i_size == 0)
 		goto out;
 
-	rbuf = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	/* Large reads take fewer trips through the VFS, see ahash_bufsize */
+	rbuf = ima_alloc_pages(i_size, &rbuf_size, 1);
 	if (!rbuf)
 		return -ENOMEM;
 
 	while (offset < i_size) {
 		int rbuf_len;
 
-		rbuf_len = integrity_kernel_read(file, offset, rbuf, PAGE_SIZE);
+		rbuf_len = integrity_kernel_read(file, offset, rbuf, rbuf_size);
 		if (rbuf_len < 0) {
 			rc = rbuf_len;
 			break;
@@ -497,7 +605,7 @@ static int ima_calc_file_hash_tfm(struct file *file,
 		if (rc)
 			break;
 	}
-	kfree(rbuf);
+	ima_free_pages(rbuf, rbuf_size);
 out:
 	if (!rc)
 		rc = crypto_shash_final(shash, hash->digest);
@@ -535,6 +643,9 @@ static int ima_calc_file_shash(struct file *file, struct ima_digest_data *hash)
  */
 int ima_calc_file_hash(struct file *file, struct ima_digest_data *hash)
 {
+	u8 verity_digest[FS_VERITY_MAX_DIGEST_SIZE];
+	enum hash_algo verity_algo;
+	bool verity = false;
 	loff_t i_size;
 	int rc;
 	struct file *f = file;
@@ -562,15 +673,27 @@ int ima_calc_file_hash(struct file *file, struct ima_digest_data *hash)
 		new_file_instance = true;
 	}
 
+	if (READ_ONCE(ima_verity_cache_max) && IS_VERITY(file_inode(f)) &&
+	    !fsverity_get_digest(file_inode(f), verity_digest, &verity_algo)) {
+		verity = true;
+		if (ima_verity_cache_lookup(verity_algo, verity_digest, hash)) {
+			rc = 0;
+			goto out;
+		}
+	}
+
 	i_size = i_size_read(file_inode(f));
 
 	if (ima_ahash_minsize && i_size >= ima_ahash_minsize) {
 		rc = ima_calc_file_ahash(f, hash);
 		if (!rc)
-			goto out;
+			goto out_cache;
 	}
 
 	rc = ima_calc_file_shash(f, hash);
+out_cache:
+	if (!rc && verity)
+		ima_verity_cache_insert(verity_algo, verity_digest, hash);
 out:
 	if (new_file_instance)
 		fput(f);
@@ -20,6 +20,9 @@
 #include <linux/skbuff.h>
 #include <linux/percpu.h>
 #include <linux/list.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <net/sock.h>
 #include <linux/un.h>
 #include <net/af_unix.h>
@@ -34,7 +37,9 @@
 #define CREATE_TRACE_POINTS
 #include <trace/events/avc.h>
 
-#define AVC_CACHE_SLOTS			512
+#define AVC_DEF_CACHE_SLOTS		512
+#define AVC_MIN_CACHE_SLOTS		16
+#define AVC_MAX_CACHE_SLOTS		(1 << 18)
 #define AVC_DEF_CACHE_THRESHOLD		512
 #define AVC_CACHE_RECLAIM		16
 
@@ -68,10 +73,22 @@ struct avc_xperms_node {
 	struct list_head xpd_head; /* list head of extended_perms_decision */
 };
 
+struct avc_slot {
+	struct hlist_head	head;	/* head for avc_node->list */
+	spinlock_t		lock;	/* lock for writes */
+};
+
+/*
+ * The hash table is replaced as a whole on resize, so it is only ever
+ * used under rcu_read_lock(), also by writers.
+ */
+struct avc_table {
+	unsigned int		size;	/* power of two */
+	struct avc_slot		slots[];
+};
+
 struct avc_cache {
-	struct hlist_head	slots[AVC_CACHE_SLOTS]; /* head for avc_node->list */
-	spinlock_t		slots_lock[AVC_CACHE_SLOTS]; /* lock for writes */
-	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
+	struct avc_table __rcu	*table;
 	atomic_t		active_nodes;
 	u32			latest_notif;	/* latest revocation notification */
 };
@@ -93,17 +110,59 @@ struct selinux_avc {
 
 static struct selinux_avc selinux_avc;
 
-void selinux_avc_init(void)
+/* Per-CPU LRU hint for the reclaim scan, so CPUs don't share one counter */
+static DEFINE_PER_CPU(unsigned int, avc_lru_hint);
+
+static DEFINE_MUTEX(avc_resize_mutex);
+
+static unsigned int avc_cache_slots_boot __initdata = AVC_DEF_CACHE_SLOTS;
+
+static int __init avc_cache_slots_setup(char *str)
 {
-	int i;
+	unsigned int slots;
 
-	selinux_avc.avc_cache_threshold = AVC_DEF_CACHE_THRESHOLD;
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
-		INIT_HLIST_HEAD(&selinux_avc.avc_cache.slots[i]);
-		spin_lock_init(&selinux_avc.avc_cache.slots_lock[i]);
+	if (!kstrtouint(str, 0, &slots))
+		avc_cache_slots_boot = clamp_t(unsigned int, slots,
+					       AVC_MIN_CACHE_SLOTS,
+					       AVC_MAX_CACHE_SLOTS);
+	return 1;
+}
+__setup("selinux_avc_slots=", avc_cache_slots_setup);
+
+static struct avc_table *avc_table_alloc(unsigned int size)
+{
+	struct avc_table *table;
+	unsigned int i;
+
+	size = roundup_pow_of_two(size);
+	table = kvzalloc(struct_size(table, slots, size), GFP_KERNEL);
+	if (!table)
+		return NULL;
+
+	table->size = size;
+	for (i = 0; i < size; i++) {
+		INIT_HLIST_HEAD(&table->slots[i].head);
+		spin_lock_init(&table->slots[i].lock);
 	}
+
+	return table;
+}
+
+void __init selinux_avc_init(void)
+{
+	struct avc_table *table;
+	int cpu;
+
+	selinux_avc.avc_cache_threshold = AVC_DEF_CACHE_THRESHOLD;
+	table = avc_table_alloc(avc_cache_slots_boot);
+	if (!table)
+		panic("SELinux: failed to allocate the AVC hash table\n");
+	RCU_INIT_POINTER(selinux_avc.avc_cache.table, table);
 	atomic_set(&selinux_avc.avc_cache.active_nodes, 0);
-	atomic_set(&selinux_avc.avc_cache.lru_hint, 0);
+
+	/* Spread the CPUs' reclaim scans over the table */
+	for_each_possible_cpu(cpu)
+		per_cpu(avc_lru_hint, cpu) = cpu * (table->size / nr_cpu_ids);
 }
 
 unsigned int avc_get_cache_threshold(void)
@@ -122,9 +181,11 @@ static struct kmem_cache *avc_xperms_data_cachep __ro_after_init;
 static struct kmem_cache *avc_xperms_decision_cachep __ro_after_init;
 static struct kmem_cache *avc_xperms_cachep __ro_after_init;
 
-static inline int avc_hash(u32 ssid, u32 tsid, u16 tclass)
+static inline struct avc_slot *avc_hash(struct avc_table *table,
+				       u32 ssid, u32 tsid, u16 tclass)
 {
-	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_CACHE_SLOTS - 1);
+	return &table->slots[jhash_3words(ssid, tsid, tclass, 0) &
+			     (table->size - 1)];
 }
 
 /**
@@ -150,16 +211,19 @@ void __init avc_init(void)
 
 int avc_get_hash_stats(char *page)
 {
-	int i, chain_len, max_chain_len, slots_used;
+	int i, chain_len, max_chain_len, slots_used, size;
+	struct avc_table *table;
 	struct avc_node *node;
 	struct hlist_head *head;
 
 	rcu_read_lock();
 
+	table = rcu_dereference(selinux_avc.avc_cache.table);
+	size = table->size;
 	slots_used = 0;
 	max_chain_len = 0;
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
-		head = &selinux_avc.avc_cache.slots[i];
+	for (i = 0; i < size; i++) {
+		head = &table->slots[i].head;
 		if (!hlist_empty(head)) {
 			slots_used++;
 			chain_len = 0;
@@ -175,7 +239,18 @@ int avc_get_hash_stats(char *page)
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
 			 "longest chain: %d\n",
 			 atomic_read(&selinux_avc.avc_cache.active_nodes),
-			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
+			 slots_used, size, max_chain_len);
+}
+
+unsigned int avc_get_cache_slots(void)
+{
+	unsigned int size;
+
+	rcu_read_lock();
+	size = rcu_dereference(selinux_avc.avc_cache.table)->size;
+	rcu_read_unlock();
+
+	return size;
 }
 
 /*
@@ -460,36 +535,35 @@ static void avc_node_replace(struct avc_node *new, struct avc_node *old)
 
 static inline int avc_reclaim_node(void)
 {
+	struct avc_table *table;
 	struct avc_node *node;
-	int hvalue, try, ecx;
+	unsigned int hvalue, try;
+	int ecx = 0;
 	unsigned long flags;
-	struct hlist_head *head;
-	spinlock_t *lock;
+	struct avc_slot *slot;
 
-	for (try = 0, ecx = 0; try < AVC_CACHE_SLOTS; try++) {
-		hvalue = atomic_inc_return(&selinux_avc.avc_cache.lru_hint) &
-			(AVC_CACHE_SLOTS - 1);
-		head = &selinux_avc.avc_cache.slots[hvalue];
-		lock = &selinux_avc.avc_cache.slots_lock[hvalue];
+	rcu_read_lock();
+	table = rcu_dereference(selinux_avc.avc_cache.table);
+	for (try = 0; try < table->size; try++) {
+		hvalue = this_cpu_inc_return(avc_lru_hint) & (table->size - 1);
+		slot = &table->slots[hvalue];
 
-		if (!spin_trylock_irqsave(lock, flags))
+		if (!spin_trylock_irqsave(&slot->lock, flags))
 			continue;
 
-		rcu_read_lock();
-		hlist_for_each_entry(node, head, list) {
+		hlist_for_each_entry(node, &slot->head, list) {
 			avc_node_delete(node);
 			avc_cache_stats_incr(reclaims);
 			ecx++;
 			if (ecx >= AVC_CACHE_RECLAIM) {
-				rcu_read_unlock();
-				spin_unlock_irqrestore(lock, flags);
+				spin_unlock_irqrestore(&slot->lock, flags);
 				goto out;
 			}
 		}
-		rcu_read_unlock();
-		spin_unlock_irqrestore(lock, flags);
+		spin_unlock_irqrestore(&slot->lock, flags);
 	}
 out:
+	rcu_read_unlock();
 	return ecx;
 }
 
@@ -523,12 +597,11 @@ static void avc_node_populate(struct avc_node *node, u32 ssid, u32 tsid, u16 tcl
 static inline struct avc_node *avc_search_node(u32 ssid, u32 tsid, u16 tclass)
 {
 	struct avc_node *node, *ret = NULL;
-	int hvalue;
-	struct hlist_head *head;
+	struct avc_slot *slot;
 
-	hvalue = avc_hash(ssid, tsid, tclass);
-	head = &selinux_avc.avc_cache.slots[hvalue];
-	hlist_for_each_entry_rcu(node, head, list) {
+	slot = avc_hash(rcu_dereference(selinux_avc.avc_cache.table),
+			ssid, tsid, tclass);
+	hlist_for_each_entry_rcu(node, &slot->head, list) {
 		if (ssid == node->ae.ssid &&
 		    tclass == node->ae.tclass &&
 		    tsid == node->ae.tsid) {
@@ -609,10 +682,8 @@ static void avc_insert(u32 ssid, u32 tsid, u16 tclass,
 		       struct av_decision *avd, struct avc_xperms_node *xp_node)
 {
 	struct avc_node *pos, *node = NULL;
-	int hvalue;
 	unsigned long flag;
-	spinlock_t *lock;
-	struct hlist_head *head;
+	struct avc_slot *slot;
 
 	if (avc_latest_notif_update(avd->seqno, 1))
 		return;
@@ -627,11 +698,11 @@ static void avc_insert(u32 ssid, u32 tsid, u16 tclass,
 		return;
 	}
 
-	hvalue = avc_hash(ssid, tsid, tclass);
-	head = &selinux_avc.avc_cache.slots[hvalue];
-	lock = &selinux_avc.avc_cache.slots_lock[hvalue];
-	spin_lock_irqsave(lock, flag);
-	hlist_for_each_entry(pos, head, list) {
+	rcu_read_lock();
+	slot = avc_hash(rcu_dereference(selinux_avc.avc_cache.table),
+			ssid, tsid, tclass);
+	spin_lock_irqsave(&slot->lock, flag);
+	hlist_for_each_entry(pos, &slot->head, list) {
 		if (pos->ae.ssid == ssid &&
 			pos->ae.tsid == tsid &&
 			pos->ae.tclass == tclass) {
@@ -639,9 +710,10 @@ static void avc_insert(u32 ssid, u32 tsid, u16 tclass,
 			goto found;
 		}
 	}
-	hlist_add_head_rcu(&node->list, head);
+	hlist_add_head_rcu(&node->list, &slot->head);
 found:
-	spin_unlock_irqrestore(lock, flag);
+	spin_unlock_irqrestore(&slot->lock, flag);
+	rcu_read_unlock();
 	return;
 }
 
@@ -834,11 +906,10 @@ static int avc_update_node(u32 event, u32 perms, u8 driver, u8 xperm, u32 ssid,
 			   struct extended_perms_decision *xpd,
 			   u32 flags)
 {
-	int hvalue, rc = 0;
+	int rc = 0;
 	unsigned long flag;
 	struct avc_node *pos, *node, *orig = NULL;
-	struct hlist_head *head;
-	spinlock_t *lock;
+	struct avc_slot *slot;
 
 	node = avc_alloc_node();
 	if (!node) {
@@ -847,14 +918,13 @@ static int avc_update_node(u32 event, u32 perms, u8 driver, u8 xperm, u32 ssid,
 	}
 
 	/* Lock the target slot */
-	hvalue = avc_hash(ssid, tsid, tclass);
-
-	head = &selinux_avc.avc_cache.slots[hvalue];
-	lock = &selinux_avc.avc_cache.slots_lock[hvalue];
+	rcu_read_lock();
+	slot = avc_hash(rcu_dereference(selinux_avc.avc_cache.table),
+			ssid, tsid, tclass);
 
-	spin_lock_irqsave(lock, flag);
+	spin_lock_irqsave(&slot->lock, flag);
 
-	hlist_for_each_entry(pos, head, list) {
+	hlist_for_each_entry(pos, &slot->head, list) {
 		if (ssid == pos->ae.ssid &&
 		    tsid == pos->ae.tsid &&
 		    tclass == pos->ae.tclass &&
@@ -912,39 +982,73 @@ static int avc_update_node(u32 event, u32 perms, u8 driver, u8 xperm, u32 ssid,
 	}
 	avc_node_replace(node, orig);
 out_unlock:
-	spin_unlock_irqrestore(lock, flag);
+	spin_unlock_irqrestore(&slot->lock, flag);
+	rcu_read_unlock();
 out:
 	return rc;
 }
 
-/**
- * avc_flush - Flush the cache
- */
-static void avc_flush(void)
+static void avc_table_flush(struct avc_table *table)
 {
-	struct hlist_head *head;
+	struct avc_slot *slot;
 	struct avc_node *node;
-	spinlock_t *lock;
 	unsigned long flag;
-	int i;
+	unsigned int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
-		head = &selinux_avc.avc_cache.slots[i];
-		lock = &selinux_avc.avc_cache.slots_lock[i];
+	for (i = 0; i < table->size; i++) {
+		slot = &table->slots[i];
 
-		spin_lock_irqsave(lock, flag);
-		/*
-		 * With preemptable RCU, the outer spinlock does not
-		 * prevent RCU grace periods from ending.
-		 */
-		rcu_read_lock();
-		hlist_for_each_entry(node, head, list)
+		spin_lock_irqsave(&slot->lock, flag);
+		hlist_for_each_entry(node, &slot->head, list)
 			avc_node_delete(node);
-		rcu_read_unlock();
-		spin_unlock_irqrestore(lock, flag);
+		spin_unlock_irqrestore(&slot->lock, flag);
 	}
 }
 
+/**
+ * avc_flush - Flush the cache
+ */
+static void avc_flush(void)
+{
+	/*
+	 * With preemptable RCU, the slot spinlocks do not prevent RCU
+	 * grace periods from ending.
+	 */
+	rcu_read_lock();
+	avc_table_flush(rcu_dereference(selinux_avc.avc_cache.table));
+	rcu_read_unlock();
+}
+
+/**
+ * avc_set_cache_slots - Resize the AVC hash table
+ * @slots: new number of hash slots, rounded up to a power of two
+ *
+ * The cached decisions are dropped rather than rehashed, they are
+ * recomputed on demand.
+ */
+int avc_set_cache_slots(unsigned int slots)
+{
+	struct avc_table *new, *old;
+
+	if (slots < AVC_MIN_CACHE_SLOTS || slots > AVC_MAX_CACHE_SLOTS)
+		return -EINVAL;
+
+	new = avc_table_alloc(slots);
+	if (!new)
+		return -ENOMEM;
+
+	mutex_lock(&avc_resize_mutex);
+	old = rcu_replace_pointer(selinux_avc.avc_cache.table, new,
+				  lockdep_is_held(&avc_resize_mutex));
+	/* Nobody can reach the old table after this, not even writers */
+	synchronize_rcu();
+	avc_table_flush(old);
+	mutex_unlock(&avc_resize_mutex);
+
+	kvfree(old);
+	return 0;
+}
+
 /**
  * avc_ss_reset - Flush the cache and revalidate migrated permissions.
  * @seqno: policy sequence number
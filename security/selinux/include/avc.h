@@ -167,6 +167,8 @@ int avc_add_callback(int (*callback)(u32 event), u32 events);
 int avc_get_hash_stats(char *page);
 unsigned int avc_get_cache_threshold(void);
 void avc_set_cache_threshold(unsigned int cache_threshold);
+unsigned int avc_get_cache_slots(void);
+int avc_set_cache_slots(unsigned int slots);
 
 /* Attempt to free avc node cache */
 void avc_disable(void);
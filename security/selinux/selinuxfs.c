@@ -1484,6 +1484,54 @@ static ssize_t sel_write_avc_cache_threshold(struct file *file,
 	return ret;
 }
 
+static ssize_t sel_read_avc_cache_slots(struct file *filp, char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	char tmpbuf[TMPBUFLEN];
+	ssize_t length;
+
+	length = scnprintf(tmpbuf, TMPBUFLEN, "%u", avc_get_cache_slots());
+	return simple_read_from_buffer(buf, count, ppos, tmpbuf, length);
+}
+
+static ssize_t sel_write_avc_cache_slots(struct file *file,
+					 const char __user *buf,
+					 size_t count, loff_t *ppos)
+
+{
+	char *page;
+	ssize_t ret;
+	unsigned int new_value;
+
+	ret = avc_has_perm(current_sid(), SECINITSID_SECURITY,
+			   SECCLASS_SECURITY, SECURITY__SETSECPARAM,
+			   NULL);
+	if (ret)
+		return ret;
+
+	if (count >= PAGE_SIZE)
+		return -ENOMEM;
+
+	/* No partial writes. */
+	if (*ppos != 0)
+		return -EINVAL;
+
+	page = memdup_user_nul(buf, count);
+	if (IS_ERR(page))
+		return PTR_ERR(page);
+
+	ret = -EINVAL;
+	if (sscanf(page, "%u", &new_value) != 1)
+		goto out;
+
+	ret = avc_set_cache_slots(new_value);
+	if (!ret)
+		ret = count;
+out:
+	kfree(page);
+	return ret;
+}
+
 static ssize_t sel_read_avc_hash_stats(struct file *filp, char __user *buf,
 				       size_t count, loff_t *ppos)
 {
@@ -1532,6 +1580,12 @@ static const struct file_operations sel_avc_cache_threshold_ops = {
 	.llseek		= generic_file_llseek,
 };
 
+static const struct file_operations sel_avc_cache_slots_ops = {
+	.read		= sel_read_avc_cache_slots,
+	.write		= sel_write_avc_cache_slots,
+	.llseek		= generic_file_llseek,
+};
+
 static const struct file_operations sel_avc_hash_stats_ops = {
 	.read		= sel_read_avc_hash_stats,
 	.llseek		= generic_file_llseek,
@@ -1617,6 +1671,8 @@ static int sel_make_avc_files(struct dentry *dir)
 		{ "cache_threshold",
 		  &sel_avc_cache_threshold_ops, S_IRUGO|S_IWUSR },
 		{ "hash_stats", &sel_avc_hash_stats_ops, S_IRUGO },
+		{ "cache_slots",
+		  &sel_avc_cache_slots_ops, S_IRUGO|S_IWUSR },
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 		{ "cache_stats", &sel_avc_cache_stats_ops, S_IRUGO },
 #endif
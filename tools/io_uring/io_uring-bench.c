@@ -1,9 +1,22 @@
 // SPDX-License-Identifier: GPL-2.0
 /*
- * Simple benchmark program that uses the various features of io_uring
- * to provide fast random access to a device/file. It has various
- * options that are control how we use io_uring, see the OPTIONS section
- * below. This uses the raw io_uring interface.
+ * Benchmark and regression harness that uses the various features of
+ * io_uring. It started out as a random O_DIRECT read benchmark and now
+ * covers:
+ *
+ *   - random reads of files/devices, optionally with IOPOLL
+ *   - no-op requests, to measure the core submission/completion overhead
+ *   - send, zerocopy send and recv over a loopback TCP connection, the
+ *     latter optionally from a provided buffer ring
+ *
+ * each of them with or without SQPOLL (optionally sharing one SQ thread
+ * between rings), registered files and registered buffers. Every thread
+ * drives its own ring, and a run can sweep the number of threads to check
+ * scaling. Completion latency percentiles are reported at the end of a
+ * run, optionally as JSON so results from different kernels can be
+ * compared mechanically. See the OPTIONS section and usage() below.
+ *
+ * This uses the raw io_uring interface.
  *
  * Copyright (C) 2018-2019 Jens Axboe
  */
@@ -14,6 +27,7 @@
 #include <stddef.h>
 #include <signal.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -22,6 +36,10 @@
 #include <sys/resource.h>
 #include <sys/mman.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 #include <linux/fs.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -51,16 +69,36 @@ struct io_cq_ring {
 	struct io_uring_cqe *cqes;
 };
 
-#define DEPTH			128
-
-#define BATCH_SUBMIT		32
-#define BATCH_COMPLETE		32
+#define MAX_DEPTH		4096
+#define MAX_FDS			16
+#define MAX_THREADS		64
 
-#define BS			4096
+/* provided buffer group used for recv */
+#define BUF_GROUP		0
 
-#define MAX_FDS			16
+/*
+ * Latency histogram, log2 buckets with LAT_SUB linear sub-buckets each.
+ * That gives ~6% resolution over the full range of a 64-bit value.
+ */
+#define LAT_SUB_BITS		4
+#define LAT_SUB			(1U << LAT_SUB_BITS)
+#define LAT_BUCKETS		(64 * LAT_SUB)
+
+enum bench_mode {
+	MODE_READ,
+	MODE_NOP,
+	MODE_SEND,
+	MODE_SEND_ZC,
+	MODE_RECV,
+};
 
-static unsigned sq_ring_mask, cq_ring_mask;
+static const char *mode_names[] = {
+	[MODE_READ]	= "read",
+	[MODE_NOP]	= "nop",
+	[MODE_SEND]	= "send",
+	[MODE_SEND_ZC]	= "send-zc",
+	[MODE_RECV]	= "recv",
+};
 
 struct file {
 	unsigned long max_blocks;
@@ -69,57 +107,190 @@ struct file {
 	int fixed_fd;
 };
 
+/* one per in-flight request, user_data holds the slot index */
+struct io_slot {
+	unsigned long long issue_ns;
+	struct file *file;
+	/* send-zc: data CQE seen, waiting for the notification */
+	int wait_notif;
+};
+
+struct lat_stat {
+	unsigned long hist[LAT_BUCKETS];
+	unsigned long long min, max, sum;
+	unsigned long nr;
+};
+
 struct submitter {
 	pthread_t thread;
+	pthread_t helper;
 	int ring_fd;
 	struct drand48_data rand;
 	struct io_sq_ring sq_ring;
 	struct io_uring_sqe *sqes;
-	struct iovec iovecs[DEPTH];
 	struct io_cq_ring cq_ring;
-	int inflight;
-	unsigned long reaps;
-	unsigned long done;
-	unsigned long calls;
-	volatile int finish;
+	struct iovec iovecs[MAX_DEPTH];
+	struct io_slot slots[MAX_DEPTH];
+	unsigned free_slots[MAX_DEPTH];
+	unsigned nr_free;
+	unsigned inflight;
+	unsigned unsubmitted;
+	volatile unsigned long done;
+	volatile unsigned long calls;
+	volatile unsigned long reaps;
+	volatile unsigned long long bytes;
+	volatile int exited;
+
+	/* provided buffer ring for recv */
+	struct io_uring_buf_ring *br;
+	unsigned br_mask;
+	unsigned short br_tail;
+
+	/* loopback connection for the network modes */
+	int sock_fd;
+	int peer_fd;
 
 	__s32 *fds;
 
 	struct file files[MAX_FDS];
 	unsigned nr_files;
 	unsigned cur_file;
+
+	struct lat_stat lat;
 };
 
-static struct submitter submitters[1];
+static struct submitter *submitters;
 static volatile int finish;
+static volatile int stop;
+
+static char **file_names;
+static unsigned nr_file_names;
 
 /*
- * OPTIONS: Set these to test the various features of io_uring.
+ * OPTIONS: Set these to test the various features of io_uring. All of them
+ * can be changed from the command line as well.
  */
+static enum bench_mode mode = MODE_READ;
+static unsigned depth = 128;		/* per ring queue depth */
+static unsigned batch_submit = 32;	/* max requests per submit */
+static unsigned batch_complete = 32;	/* min requests to wait for */
+static unsigned bs = 4096;		/* request size */
 static int polled = 1;		/* use IO polling */
 static int fixedbufs = 1;	/* use fixed user buffers */
 static int register_files = 1;	/* use fixed files */
 static int buffered = 0;	/* use buffered IO, not O_DIRECT */
 static int sq_thread_poll = 0;	/* use kernel submission/poller thread */
 static int sq_thread_cpu = -1;	/* pin above thread to this CPU */
-static int do_nop = 0;		/* no-op SQ ring commands */
+static int sq_thread_share = 0;	/* all rings share the first SQ thread */
+static int buf_ring = 0;	/* recv into a provided buffer ring */
+static int track_lat = 1;	/* measure completion latency */
+static unsigned nr_threads = 1;	/* threads/rings to run */
+static int sweep = 0;		/* scale 1..nr_threads in powers of 2 */
+static unsigned runtime = 0;	/* seconds, 0 means until interrupted */
+static int json = 0;		/* emit results as JSON */
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned lat_bucket(unsigned long long ns)
+{
+	unsigned msb;
+
+	if (ns < LAT_SUB)
+		return ns;
+	msb = 63 - __builtin_clzll(ns);
+	return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) |
+		((ns >> (msb - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+static unsigned long long lat_value(unsigned idx)
+{
+	unsigned shift = idx >> LAT_SUB_BITS;
+
+	if (!shift)
+		return idx;
+	return (unsigned long long) (LAT_SUB | (idx & (LAT_SUB - 1))) <<
+		(shift - 1);
+}
+
+static void lat_add(struct lat_stat *lat, unsigned long long ns)
+{
+	lat->hist[lat_bucket(ns)]++;
+	if (!lat->nr || ns < lat->min)
+		lat->min = ns;
+	if (ns > lat->max)
+		lat->max = ns;
+	lat->sum += ns;
+	lat->nr++;
+}
+
+static void lat_merge(struct lat_stat *dst, struct lat_stat *src)
+{
+	unsigned i;
+
+	if (!src->nr)
+		return;
+	for (i = 0; i < LAT_BUCKETS; i++)
+		dst->hist[i] += src->hist[i];
+	if (!dst->nr || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->sum += src->sum;
+	dst->nr += src->nr;
+}
+
+static unsigned long long lat_percentile(struct lat_stat *lat, double pct)
+{
+	unsigned long target, seen = 0;
+	unsigned i;
+
+	if (!lat->nr)
+		return 0;
+	target = (unsigned long) (lat->nr * pct / 100.0);
+	if (target >= lat->nr)
+		target = lat->nr - 1;
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += lat->hist[i];
+		if (seen > target)
+			return lat_value(i);
+	}
+	return lat->max;
+}
+
+static int is_net_mode(void)
+{
+	return mode == MODE_SEND || mode == MODE_SEND_ZC || mode == MODE_RECV;
+}
 
 static int io_uring_register_buffers(struct submitter *s)
 {
-	if (do_nop)
+	if (mode == MODE_NOP)
 		return 0;
 
 	return io_uring_register(s->ring_fd, IORING_REGISTER_BUFFERS, s->iovecs,
-					DEPTH);
+					depth);
 }
 
 static int io_uring_register_files(struct submitter *s)
 {
 	unsigned i;
 
-	if (do_nop)
+	if (mode == MODE_NOP)
 		return 0;
 
+	if (is_net_mode()) {
+		s->fds = calloc(1, sizeof(__s32));
+		s->fds[0] = s->sock_fd;
+		return io_uring_register(s->ring_fd, IORING_REGISTER_FILES,
+						s->fds, 1);
+	}
+
 	s->fds = calloc(s->nr_files, sizeof(__s32));
 	for (i = 0; i < s->nr_files; i++) {
 		s->fds[i] = s->files[i].real_fd;
@@ -130,6 +301,51 @@ static int io_uring_register_files(struct submitter *s)
 					s->nr_files);
 }
 
+static void buf_ring_add(struct submitter *s, unsigned bid)
+{
+	struct io_uring_buf *buf = &s->br->bufs[s->br_tail & s->br_mask];
+
+	buf->addr = (unsigned long) s->iovecs[bid].iov_base;
+	buf->len = bs;
+	buf->bid = bid;
+	s->br_tail++;
+}
+
+static void buf_ring_commit(struct submitter *s)
+{
+	__atomic_store_n(&s->br->tail, s->br_tail, __ATOMIC_RELEASE);
+}
+
+static int io_uring_register_buf_ring(struct submitter *s)
+{
+	struct io_uring_buf_reg reg;
+	unsigned entries = 1, i;
+	size_t len;
+
+	while (entries < depth)
+		entries <<= 1;
+	len = entries * sizeof(struct io_uring_buf);
+	s->br = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (s->br == MAP_FAILED) {
+		s->br = NULL;
+		return -1;
+	}
+	s->br_mask = entries - 1;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) s->br;
+	reg.ring_entries = entries;
+	reg.bgid = BUF_GROUP;
+	if (io_uring_register(s->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+		return -1;
+
+	for (i = 0; i < depth; i++)
+		buf_ring_add(s, i);
+	buf_ring_commit(s);
+	return 0;
+}
+
 static int lk_gettid(void)
 {
 	return syscall(__NR_gettid);
@@ -137,20 +353,12 @@ static int lk_gettid(void)
 
 static unsigned file_depth(struct submitter *s)
 {
-	return (DEPTH + s->nr_files - 1) / s->nr_files;
+	return (depth + s->nr_files - 1) / s->nr_files;
 }
 
-static void init_io(struct submitter *s, unsigned index)
+static struct file *pick_file(struct submitter *s)
 {
-	struct io_uring_sqe *sqe = &s->sqes[index];
-	unsigned long offset;
 	struct file *f;
-	long r;
-
-	if (do_nop) {
-		sqe->opcode = IORING_OP_NOP;
-		return;
-	}
 
 	if (s->nr_files == 1) {
 		f = &s->files[0];
@@ -164,9 +372,68 @@ static void init_io(struct submitter *s, unsigned index)
 		}
 	}
 	f->pending_ios++;
+	return f;
+}
+
+static void init_io(struct submitter *s, unsigned index, unsigned slot)
+{
+	struct io_uring_sqe *sqe = &s->sqes[index];
+	struct io_slot *io = &s->slots[slot];
+	void *buf = s->iovecs[slot].iov_base;
+	unsigned long offset;
+	struct file *f;
+	long r;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = slot;
+	io->file = NULL;
+	io->wait_notif = 0;
+	if (track_lat)
+		io->issue_ns = now_ns();
+
+	switch (mode) {
+	case MODE_NOP:
+		sqe->opcode = IORING_OP_NOP;
+		return;
+	case MODE_READ:
+		break;
+	case MODE_SEND:
+	case MODE_SEND_ZC:
+	case MODE_RECV:
+		if (register_files) {
+			sqe->flags = IOSQE_FIXED_FILE;
+			sqe->fd = 0;
+		} else {
+			sqe->fd = s->sock_fd;
+		}
+		sqe->len = bs;
+		if (mode == MODE_RECV) {
+			sqe->opcode = IORING_OP_RECV;
+			if (buf_ring) {
+				sqe->flags |= IOSQE_BUFFER_SELECT;
+				sqe->buf_group = BUF_GROUP;
+			} else {
+				sqe->addr = (unsigned long) buf;
+			}
+		} else if (mode == MODE_SEND) {
+			sqe->opcode = IORING_OP_SEND;
+			sqe->addr = (unsigned long) buf;
+		} else {
+			sqe->opcode = IORING_OP_SEND_ZC;
+			sqe->addr = (unsigned long) buf;
+			if (fixedbufs) {
+				sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+				sqe->buf_index = slot;
+			}
+		}
+		return;
+	}
+
+	f = pick_file(s);
+	io->file = f;
 
 	lrand48_r(&s->rand, &r);
-	offset = (r % (f->max_blocks - 1)) * BS;
+	offset = (r % (f->max_blocks - 1)) * bs;
 
 	if (register_files) {
 		sqe->flags = IOSQE_FIXED_FILE;
@@ -177,18 +444,17 @@ static void init_io(struct submitter *s, unsigned index)
 	}
 	if (fixedbufs) {
 		sqe->opcode = IORING_OP_READ_FIXED;
-		sqe->addr = (unsigned long) s->iovecs[index].iov_base;
-		sqe->len = BS;
-		sqe->buf_index = index;
+		sqe->addr = (unsigned long) buf;
+		sqe->len = bs;
+		sqe->buf_index = slot;
 	} else {
 		sqe->opcode = IORING_OP_READV;
-		sqe->addr = (unsigned long) &s->iovecs[index];
+		sqe->addr = (unsigned long) &s->iovecs[slot];
 		sqe->len = 1;
 		sqe->buf_index = 0;
 	}
 	sqe->ioprio = 0;
 	sqe->off = offset;
-	sqe->user_data = (unsigned long) f;
 }
 
 static int prep_more_ios(struct submitter *s, unsigned max_ios)
@@ -197,18 +463,18 @@ static int prep_more_ios(struct submitter *s, unsigned max_ios)
 	unsigned index, tail, next_tail, prepped = 0;
 
 	next_tail = tail = *ring->tail;
-	do {
+	while (prepped < max_ios && s->nr_free) {
 		next_tail++;
 		read_barrier();
-		if (next_tail == *ring->head)
+		if (next_tail - *ring->head > *ring->ring_entries)
 			break;
 
-		index = tail & sq_ring_mask;
-		init_io(s, index);
+		index = tail & *ring->ring_mask;
+		init_io(s, index, s->free_slots[--s->nr_free]);
 		ring->array[index] = index;
 		prepped++;
 		tail = next_tail;
-	} while (prepped < max_ios);
+	}
 
 	if (*ring->tail != tail) {
 		/* order tail store with writes to sqes above */
@@ -216,6 +482,7 @@ static int prep_more_ios(struct submitter *s, unsigned max_ios)
 		*ring->tail = tail;
 		write_barrier();
 	}
+	s->inflight += prepped;
 	return prepped;
 }
 
@@ -231,45 +498,102 @@ static int get_file_size(struct file *f)
 		if (ioctl(f->real_fd, BLKGETSIZE64, &bytes) != 0)
 			return -1;
 
-		f->max_blocks = bytes / BS;
+		f->max_blocks = bytes / bs;
 		return 0;
 	} else if (S_ISREG(st.st_mode)) {
-		f->max_blocks = st.st_size / BS;
+		f->max_blocks = st.st_size / bs;
 		return 0;
 	}
 
 	return -1;
 }
 
+static void put_slot(struct submitter *s, unsigned slot,
+		     unsigned long long now)
+{
+	struct io_slot *io = &s->slots[slot];
+
+	if (io->file)
+		io->file->pending_ios--;
+	if (track_lat)
+		lat_add(&s->lat, now - io->issue_ns);
+	s->free_slots[s->nr_free++] = slot;
+	s->inflight--;
+	s->done++;
+}
+
+/*
+ * Returns the number of requests completed, or -1 on an unexpected result.
+ * Once the run is being torn down errors are expected, as sockets are shut
+ * down under in-flight requests.
+ */
+static int check_cqe(struct submitter *s, struct io_uring_cqe *cqe)
+{
+	struct io_slot *io = &s->slots[cqe->user_data];
+
+	switch (mode) {
+	case MODE_NOP:
+		return 1;
+	case MODE_READ:
+		if (cqe->res != (int) bs) {
+			printf("io: unexpected ret=%d\n", cqe->res);
+			if (polled && cqe->res == -EOPNOTSUPP)
+				printf("Your filesystem doesn't support poll\n");
+			return -1;
+		}
+		s->bytes += cqe->res;
+		return 1;
+	case MODE_SEND_ZC:
+		if (cqe->flags & IORING_CQE_F_NOTIF)
+			return 1;
+		if (cqe->flags & IORING_CQE_F_MORE)
+			io->wait_notif = 1;
+		/* fall through */
+	case MODE_SEND:
+	case MODE_RECV:
+		if (cqe->res <= 0) {
+			if (finish)
+				return io->wait_notif ? 0 : 1;
+			printf("io: unexpected ret=%d\n", cqe->res);
+			return -1;
+		}
+		s->bytes += cqe->res;
+		if (mode == MODE_RECV && buf_ring &&
+		    (cqe->flags & IORING_CQE_F_BUFFER)) {
+			buf_ring_add(s, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			buf_ring_commit(s);
+		}
+		return !io->wait_notif;
+	}
+	return -1;
+}
+
 static int reap_events(struct submitter *s)
 {
 	struct io_cq_ring *ring = &s->cq_ring;
 	struct io_uring_cqe *cqe;
 	unsigned head, reaped = 0;
+	unsigned long long now = 0;
 
 	head = *ring->head;
 	do {
-		struct file *f;
+		int ret;
 
 		read_barrier();
 		if (head == *ring->tail)
 			break;
-		cqe = &ring->cqes[head & cq_ring_mask];
-		if (!do_nop) {
-			f = (struct file *) (uintptr_t) cqe->user_data;
-			f->pending_ios--;
-			if (cqe->res != BS) {
-				printf("io: unexpected ret=%d\n", cqe->res);
-				if (polled && cqe->res == -EOPNOTSUPP)
-					printf("Your filesystem doesn't support poll\n");
-				return -1;
-			}
-		}
-		reaped++;
+		if (track_lat && !now)
+			now = now_ns();
+		cqe = &ring->cqes[head & *ring->ring_mask];
+		ret = check_cqe(s, cqe);
+		if (ret < 0)
+			return -1;
+		if (ret)
+			put_slot(s, cqe->user_data, now);
+		reaped += ret;
 		head++;
 	} while (1);
 
-	s->inflight -= reaped;
 	*ring->head = head;
 	write_barrier();
 	return reaped;
@@ -279,100 +603,171 @@ static void *submitter_fn(void *data)
 {
 	struct submitter *s = data;
 	struct io_sq_ring *ring = &s->sq_ring;
-	int ret, prepped;
+	int ret;
 
-	printf("submitter=%d\n", lk_gettid());
+	if (!json)
+		printf("submitter=%d\n", lk_gettid());
 
 	srand48_r(pthread_self(), &s->rand);
 
-	prepped = 0;
-	do {
-		int to_wait, to_submit, this_reap, to_prep;
+	while (!finish) {
+		unsigned to_submit, to_wait, flags = 0;
+		int r;
 
-		if (!prepped && s->inflight < DEPTH) {
-			to_prep = min(DEPTH - s->inflight, BATCH_SUBMIT);
-			prepped = prep_more_ios(s, to_prep);
-		}
-		s->inflight += prepped;
-submit_more:
-		to_submit = prepped;
-submit:
-		if (to_submit && (s->inflight + to_submit <= DEPTH))
-			to_wait = 0;
-		else
-			to_wait = min(s->inflight + to_submit, BATCH_COMPLETE);
+		to_submit = prep_more_ios(s, min(depth - s->inflight,
+						 batch_submit));
+		to_submit += s->unsubmitted;
 
-		/*
-		 * Only need to call io_uring_enter if we're not using SQ thread
-		 * poll, or if IORING_SQ_NEED_WAKEUP is set.
-		 */
-		if (!sq_thread_poll || (*ring->flags & IORING_SQ_NEED_WAKEUP)) {
-			unsigned flags = 0;
+		/* only block for completions once the queue is full */
+		if (!s->nr_free)
+			to_wait = min(s->inflight, batch_complete);
+		else
+			to_wait = 0;
 
-			if (to_wait)
-				flags = IORING_ENTER_GETEVENTS;
-			if ((*ring->flags & IORING_SQ_NEED_WAKEUP))
+		if (to_wait)
+			flags |= IORING_ENTER_GETEVENTS;
+		if (sq_thread_poll) {
+			if (*ring->flags & IORING_SQ_NEED_WAKEUP)
 				flags |= IORING_ENTER_SQ_WAKEUP;
-			ret = io_uring_enter(s->ring_fd, to_submit, to_wait,
-						flags, NULL);
-			s->calls++;
+			s->unsubmitted = 0;
 		}
 
 		/*
-		 * For non SQ thread poll, we already got the events we needed
-		 * through the io_uring_enter() above. For SQ thread poll, we
-		 * need to loop here until we find enough events.
+		 * Only need to call io_uring_enter if we're not using SQ thread
+		 * poll, or if we need to wake it up or wait for events.
 		 */
-		this_reap = 0;
-		do {
-			int r;
-			r = reap_events(s);
-			if (r == -1) {
-				s->finish = 1;
-				break;
-			} else if (r > 0)
-				this_reap += r;
-		} while (sq_thread_poll && this_reap < to_wait);
-		s->reaps += this_reap;
-
-		if (ret >= 0) {
-			if (!ret) {
-				to_submit = 0;
-				if (s->inflight)
-					goto submit;
-				continue;
-			} else if (ret < to_submit) {
-				int diff = to_submit - ret;
-
-				s->done += ret;
-				prepped -= diff;
-				goto submit_more;
-			}
-			s->done += ret;
-			prepped = 0;
-			continue;
-		} else if (ret < 0) {
-			if (errno == EAGAIN) {
-				if (s->finish)
+		if (!sq_thread_poll || flags) {
+			ret = io_uring_enter(s->ring_fd,
+					sq_thread_poll ? 0 : to_submit,
+					to_wait, flags, NULL);
+			s->calls++;
+			if (ret < 0) {
+				if (errno != EAGAIN && errno != EINTR &&
+				    errno != EBUSY) {
+					printf("io_submit: %s\n",
+						strerror(errno));
 					break;
-				if (this_reap)
-					goto submit;
-				to_submit = 0;
-				goto submit;
+				}
+				ret = 0;
 			}
-			printf("io_submit: %s\n", strerror(errno));
-			break;
+			if (!sq_thread_poll)
+				s->unsubmitted = to_submit - ret;
 		}
-	} while (!s->finish);
 
+		r = reap_events(s);
+		if (r < 0)
+			break;
+		s->reaps += r;
+	}
+
+	s->exited = 1;
 	finish = 1;
 	return NULL;
 }
 
+/*
+ * The other end of the loopback connection: sinks data for the send modes
+ * and feeds it for recv.
+ */
+static void *net_helper_fn(void *data)
+{
+	struct submitter *s = data;
+	size_t len = mode == MODE_RECV ? bs : 65536;
+	char *buf;
+	ssize_t ret;
+
+	buf = calloc(1, len);
+	if (!buf)
+		return NULL;
+
+	while (!finish) {
+		if (mode == MODE_RECV)
+			ret = write(s->peer_fd, buf, len);
+		else
+			ret = read(s->peer_fd, buf, len);
+		if (ret <= 0)
+			break;
+	}
+	free(buf);
+	return NULL;
+}
+
+static int setup_connection(struct submitter *s)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int lfd, one = 1;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(lfd, 1) ||
+	    getsockname(lfd, (struct sockaddr *) &addr, &len)) {
+		perror("listen");
+		close(lfd);
+		return 1;
+	}
+
+	s->sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (s->sock_fd < 0 ||
+	    connect(s->sock_fd, (struct sockaddr *) &addr, sizeof(addr))) {
+		perror("connect");
+		close(lfd);
+		return 1;
+	}
+	s->peer_fd = accept(lfd, NULL, NULL);
+	close(lfd);
+	if (s->peer_fd < 0) {
+		perror("accept");
+		return 1;
+	}
+	setsockopt(s->sock_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	setsockopt(s->peer_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return 0;
+}
+
+static int setup_files(struct submitter *s)
+{
+	unsigned i;
+	int flags;
+
+	flags = O_RDONLY | O_NOATIME;
+	if (!buffered)
+		flags |= O_DIRECT;
+
+	for (i = 0; i < nr_file_names; i++) {
+		struct file *f = &s->files[s->nr_files];
+
+		f->real_fd = open(file_names[i], flags);
+		if (f->real_fd < 0) {
+			perror("open");
+			return 1;
+		}
+		if (get_file_size(f)) {
+			printf("failed getting size of device/file\n");
+			return 1;
+		}
+		if (f->max_blocks <= 1) {
+			printf("Zero file/device size?\n");
+			return 1;
+		}
+		f->max_blocks--;
+		s->nr_files++;
+	}
+	return 0;
+}
+
 static void sig_int(int sig)
 {
-	printf("Exiting on signal %d\n", sig);
-	submitters[0].finish = 1;
+	if (!json)
+		printf("Exiting on signal %d\n", sig);
+	stop = 1;
 	finish = 1;
 }
 
@@ -384,6 +779,9 @@ static void arm_sig_int(void)
 	act.sa_handler = sig_int;
 	act.sa_flags = SA_RESTART;
 	sigaction(SIGINT, &act, NULL);
+
+	/* shutting down sockets under in-flight sends must not kill us */
+	signal(SIGPIPE, SIG_IGN);
 }
 
 static int setup_ring(struct submitter *s)
@@ -396,7 +794,7 @@ static int setup_ring(struct submitter *s)
 
 	memset(&p, 0, sizeof(p));
 
-	if (polled && !do_nop)
+	if (polled && mode == MODE_READ)
 		p.flags |= IORING_SETUP_IOPOLL;
 	if (sq_thread_poll) {
 		p.flags |= IORING_SETUP_SQPOLL;
@@ -404,9 +802,13 @@ static int setup_ring(struct submitter *s)
 			p.flags |= IORING_SETUP_SQ_AFF;
 			p.sq_thread_cpu = sq_thread_cpu;
 		}
+		if (sq_thread_share && s != &submitters[0]) {
+			p.flags |= IORING_SETUP_ATTACH_WQ;
+			p.wq_fd = submitters[0].ring_fd;
+		}
 	}
 
-	fd = io_uring_setup(DEPTH, &p);
+	fd = io_uring_setup(depth, &p);
 	if (fd < 0) {
 		perror("io_uring_setup");
 		return 1;
@@ -429,39 +831,92 @@ static int setup_ring(struct submitter *s)
 		}
 	}
 
+	if (buf_ring && mode == MODE_RECV) {
+		ret = io_uring_register_buf_ring(s);
+		if (ret < 0) {
+			perror("io_uring_register_buf_ring");
+			return 1;
+		}
+	}
+
 	ptr = mmap(0, p.sq_off.array + p.sq_entries * sizeof(__u32),
 			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
 			IORING_OFF_SQ_RING);
-	printf("sq_ring ptr = 0x%p\n", ptr);
+	if (!json)
+		printf("sq_ring ptr = 0x%p\n", ptr);
 	sring->head = ptr + p.sq_off.head;
 	sring->tail = ptr + p.sq_off.tail;
 	sring->ring_mask = ptr + p.sq_off.ring_mask;
 	sring->ring_entries = ptr + p.sq_off.ring_entries;
 	sring->flags = ptr + p.sq_off.flags;
 	sring->array = ptr + p.sq_off.array;
-	sq_ring_mask = *sring->ring_mask;
 
 	s->sqes = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe),
 			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
 			IORING_OFF_SQES);
-	printf("sqes ptr    = 0x%p\n", s->sqes);
+	if (!json)
+		printf("sqes ptr    = 0x%p\n", s->sqes);
 
 	ptr = mmap(0, p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe),
 			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
 			IORING_OFF_CQ_RING);
-	printf("cq_ring ptr = 0x%p\n", ptr);
+	if (!json)
+		printf("cq_ring ptr = 0x%p\n", ptr);
 	cring->head = ptr + p.cq_off.head;
 	cring->tail = ptr + p.cq_off.tail;
 	cring->ring_mask = ptr + p.cq_off.ring_mask;
 	cring->ring_entries = ptr + p.cq_off.ring_entries;
 	cring->cqes = ptr + p.cq_off.cqes;
-	cq_ring_mask = *cring->ring_mask;
 	return 0;
 }
 
-static void file_depths(char *buf)
+static int setup_submitter(struct submitter *s)
+{
+	unsigned i;
+
+	s->ring_fd = s->sock_fd = s->peer_fd = -1;
+	for (i = 0; i < depth; i++) {
+		void *buf;
+
+		if (posix_memalign(&buf, 4096, bs)) {
+			printf("failed alloc\n");
+			return 1;
+		}
+		memset(buf, 0, bs);
+		s->iovecs[i].iov_base = buf;
+		s->iovecs[i].iov_len = bs;
+		s->free_slots[i] = depth - 1 - i;
+	}
+	s->nr_free = depth;
+
+	if (mode == MODE_READ && setup_files(s))
+		return 1;
+	if (is_net_mode() && setup_connection(s))
+		return 1;
+	return setup_ring(s);
+}
+
+static void teardown_submitter(struct submitter *s)
+{
+	unsigned i;
+
+	if (s->ring_fd >= 0)
+		close(s->ring_fd);
+	if (s->sock_fd >= 0)
+		close(s->sock_fd);
+	if (s->peer_fd >= 0)
+		close(s->peer_fd);
+	for (i = 0; i < s->nr_files; i++)
+		close(s->files[i].real_fd);
+	for (i = 0; i < depth; i++)
+		free(s->iovecs[i].iov_base);
+	if (s->br)
+		munmap(s->br, (s->br_mask + 1) * sizeof(struct io_uring_buf));
+	free(s->fds);
+}
+
+static void file_depths(struct submitter *s, char *buf)
 {
-	struct submitter *s = &submitters[0];
 	unsigned i;
 	char *p;
 
@@ -477,116 +932,338 @@ static void file_depths(char *buf)
 	}
 }
 
-int main(int argc, char *argv[])
-{
-	struct submitter *s = &submitters[0];
-	unsigned long done, calls, reap;
-	int err, i, flags, fd;
-	char *fdepths;
-	void *ret;
-
-	if (!do_nop && argc < 2) {
-		printf("%s: filename\n", argv[0]);
-		return 1;
-	}
-
-	flags = O_RDONLY | O_NOATIME;
-	if (!buffered)
-		flags |= O_DIRECT;
-
-	i = 1;
-	while (!do_nop && i < argc) {
-		struct file *f;
+struct bench_result {
+	unsigned threads;
+	unsigned long done;
+	unsigned long calls;
+	unsigned long long bytes;
+	unsigned long long elapsed_ns;
+	struct lat_stat lat;
+};
 
-		if (s->nr_files == MAX_FDS) {
-			printf("Max number of files (%d) reached\n", MAX_FDS);
-			break;
-		}
-		fd = open(argv[i], flags);
-		if (fd < 0) {
-			perror("open");
-			return 1;
-		}
+static const double pcts[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
 
-		f = &s->files[s->nr_files];
-		f->real_fd = fd;
-		if (get_file_size(f)) {
-			printf("failed getting size of device/file\n");
-			return 1;
-		}
-		if (f->max_blocks <= 1) {
-			printf("Zero file/device size?\n");
-			return 1;
-		}
-		f->max_blocks--;
+static void print_result(struct bench_result *res, int first)
+{
+	unsigned long long secs_ns = res->elapsed_ns ? res->elapsed_ns : 1;
+	unsigned long iops = res->done * 1000000000ULL / secs_ns;
+	unsigned long long bw = res->bytes * 1000000000ULL / secs_ns / 1024;
+	unsigned long long mean = res->lat.nr ? res->lat.sum / res->lat.nr : 0;
+	unsigned i;
 
-		printf("Added file %s\n", argv[i]);
-		s->nr_files++;
-		i++;
+	if (!json) {
+		printf("threads=%u, mode=%s, IOPS=%lu, BW=%lluKiB/s, calls=%lu\n",
+			res->threads, mode_names[mode], iops, bw, res->calls);
+		if (!track_lat)
+			return;
+		printf("lat (nsec): min=%llu, mean=%llu, max=%llu\n",
+			res->lat.min, mean, res->lat.max);
+		for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+			printf("  p%-6g = %llu\n", pcts[i],
+				lat_percentile(&res->lat, pcts[i]));
+		return;
 	}
 
-	if (fixedbufs) {
-		struct rlimit rlim;
-
-		rlim.rlim_cur = RLIM_INFINITY;
-		rlim.rlim_max = RLIM_INFINITY;
-		if (setrlimit(RLIMIT_MEMLOCK, &rlim) < 0) {
-			perror("setrlimit");
-			return 1;
-		}
+	printf("%s{\"mode\": \"%s\", \"threads\": %u, \"depth\": %u, "
+		"\"bs\": %u, \"iopoll\": %d, \"sqpoll\": %d, "
+		"\"sqpoll_shared\": %d, \"fixedbufs\": %d, \"regfiles\": %d, "
+		"\"buffered\": %d, \"bufring\": %d, \"elapsed_ns\": %llu, "
+		"\"ios\": %lu, \"iops\": %lu, \"bw_kib\": %llu, "
+		"\"calls\": %lu",
+		first ? "" : ",\n",
+		mode_names[mode], res->threads, depth, bs,
+		polled && mode == MODE_READ, sq_thread_poll,
+		sq_thread_poll && sq_thread_share, fixedbufs, register_files,
+		buffered, buf_ring && mode == MODE_RECV, res->elapsed_ns,
+		res->done, iops, bw, res->calls);
+	if (track_lat) {
+		printf(", \"lat_ns\": {\"min\": %llu, \"mean\": %llu, "
+			"\"max\": %llu",
+			res->lat.min, mean, res->lat.max);
+		for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+			printf(", \"p%g\": %llu", pcts[i],
+				lat_percentile(&res->lat, pcts[i]));
+		printf("}");
 	}
+	printf("}");
+}
 
-	arm_sig_int();
-
-	for (i = 0; i < DEPTH; i++) {
-		void *buf;
-
-		if (posix_memalign(&buf, BS, BS)) {
-			printf("failed alloc\n");
-			return 1;
+static int run_bench(unsigned threads, struct bench_result *res)
+{
+	unsigned long done = 0, calls = 0, reap = 0;
+	unsigned long long start;
+	unsigned i, secs = 0;
+	char *fdepths = NULL;
+	int err = 0;
+
+	submitters = calloc(threads, sizeof(struct submitter));
+	if (!submitters) {
+		printf("failed alloc\n");
+		return 1;
+	}
+	finish = 0;
+
+	/* in order, so later rings can attach to the first SQ thread */
+	for (i = 0; i < threads; i++) {
+		err = setup_submitter(&submitters[i]);
+		if (err) {
+			printf("ring setup failed: %s, %d\n", strerror(errno),
+				err);
+			threads = i + 1;
+			goto out;
 		}
-		s->iovecs[i].iov_base = buf;
-		s->iovecs[i].iov_len = BS;
 	}
-
-	err = setup_ring(s);
-	if (err) {
-		printf("ring setup failed: %s, %d\n", strerror(errno), err);
-		return 1;
+	if (!json) {
+		printf("mode=%s, polled=%d, fixedbufs=%d, buffered=%d",
+			mode_names[mode], polled && mode == MODE_READ,
+			fixedbufs, buffered);
+		printf(" QD=%d, sq_ring=%d, cq_ring=%d, threads=%u\n", depth,
+			*submitters[0].sq_ring.ring_entries,
+			*submitters[0].cq_ring.ring_entries, threads);
 	}
-	printf("polled=%d, fixedbufs=%d, buffered=%d", polled, fixedbufs, buffered);
-	printf(" QD=%d, sq_ring=%d, cq_ring=%d\n", DEPTH, *s->sq_ring.ring_entries, *s->cq_ring.ring_entries);
 
-	pthread_create(&s->thread, NULL, submitter_fn, s);
+	start = now_ns();
+	for (i = 0; i < threads; i++) {
+		struct submitter *s = &submitters[i];
 
-	fdepths = malloc(8 * s->nr_files);
-	reap = calls = done = 0;
+		if (is_net_mode())
+			pthread_create(&s->helper, NULL, net_helper_fn, s);
+		pthread_create(&s->thread, NULL, submitter_fn, s);
+	}
+
+	fdepths = malloc(8 * MAX_FDS);
 	do {
 		unsigned long this_done = 0;
 		unsigned long this_reap = 0;
 		unsigned long this_call = 0;
 		unsigned long rpc = 0, ipc = 0;
+		unsigned exited = 0;
 
 		sleep(1);
-		this_done += s->done;
-		this_call += s->calls;
-		this_reap += s->reaps;
+		for (i = 0; i < threads; i++) {
+			this_done += submitters[i].done;
+			this_call += submitters[i].calls;
+			this_reap += submitters[i].reaps;
+			exited += submitters[i].exited;
+		}
 		if (this_call - calls) {
 			rpc = (this_done - done) / (this_call - calls);
 			ipc = (this_reap - reap) / (this_call - calls);
 		} else
 			rpc = ipc = -1;
-		file_depths(fdepths);
-		printf("IOPS=%lu, IOS/call=%ld/%ld, inflight=%u (%s)\n",
-				this_done - done, rpc, ipc, s->inflight,
-				fdepths);
+		if (!json) {
+			file_depths(&submitters[0], fdepths);
+			printf("IOPS=%lu, IOS/call=%ld/%ld, inflight=%u (%s)\n",
+					this_done - done, rpc, ipc,
+					submitters[0].inflight, fdepths);
+		}
 		done = this_done;
 		calls = this_call;
 		reap = this_reap;
+		if (exited == threads)
+			break;
+		if (runtime && ++secs >= runtime)
+			break;
 	} while (!finish);
 
-	pthread_join(s->thread, &ret);
-	close(s->ring_fd);
+	finish = 1;
+	res->elapsed_ns = now_ns() - start;
+
+	/* unblock requests and helpers stuck on the loopback connection */
+	for (i = 0; i < threads; i++) {
+		struct submitter *s = &submitters[i];
+
+		if (!is_net_mode())
+			continue;
+		shutdown(s->sock_fd, SHUT_RDWR);
+		shutdown(s->peer_fd, SHUT_RDWR);
+	}
+
+	memset(&res->lat, 0, sizeof(res->lat));
+	res->threads = threads;
+	res->done = res->calls = res->bytes = 0;
+	for (i = 0; i < threads; i++) {
+		struct submitter *s = &submitters[i];
+		void *ret;
+
+		pthread_join(s->thread, &ret);
+		if (is_net_mode())
+			pthread_join(s->helper, &ret);
+		res->done += s->done;
+		res->calls += s->calls;
+		res->bytes += s->bytes;
+		lat_merge(&res->lat, &s->lat);
+	}
+out:
+	/* tear down in reverse, attached rings go before the SQ thread owner */
+	for (i = threads; i > 0; i--)
+		teardown_submitter(&submitters[i - 1]);
+	free(submitters);
+	submitters = NULL;
 	free(fdepths);
+	return err;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s [options] [file ...]\n"
+	"  -m <mode>   read, nop, send, send-zc or recv (default read)\n"
+	"  -d <depth>  queue depth per ring (default %u)\n"
+	"  -s <nr>     max requests per submit (default %u)\n"
+	"  -c <nr>     min requests to wait for (default %u)\n"
+	"  -b <bytes>  request size (default %u)\n"
+	"  -p <bool>   IOPOLL, read mode only (default %d)\n"
+	"  -B <bool>   registered buffers (default %d)\n"
+	"  -F <bool>   registered files (default %d)\n"
+	"  -O <bool>   O_DIRECT (default %d)\n"
+	"  -S <bool>   SQPOLL (default %d)\n"
+	"  -C <cpu>    pin the SQPOLL thread\n"
+	"  -A <bool>   share one SQPOLL thread between all rings (default %d)\n"
+	"  -R <bool>   recv from a provided buffer ring (default %d)\n"
+	"  -L <bool>   track completion latency (default %d)\n"
+	"  -n <nr>     threads, each with its own ring (default %u)\n"
+	"  -W          sweep 1, 2, 4, ... up to -n threads\n"
+	"  -t <secs>   runtime per run, 0 runs until interrupted (default %u)\n"
+	"  -j          print results as JSON\n",
+	argv0, depth, batch_submit, batch_complete, bs, polled, fixedbufs,
+	register_files, !buffered, sq_thread_poll, sq_thread_share, buf_ring,
+	track_lat, nr_threads, runtime);
+}
+
+static int parse_mode(const char *str)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+		if (!strcmp(str, mode_names[i])) {
+			mode = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_result res;
+	unsigned threads;
+	int opt, first = 1;
+
+	while ((opt = getopt(argc, argv, "m:d:s:c:b:p:B:F:O:S:C:A:R:L:n:Wt:jh")) != -1) {
+		switch (opt) {
+		case 'm':
+			if (parse_mode(optarg)) {
+				printf("unknown mode %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 's':
+			batch_submit = atoi(optarg);
+			break;
+		case 'c':
+			batch_complete = atoi(optarg);
+			break;
+		case 'b':
+			bs = atoi(optarg);
+			break;
+		case 'p':
+			polled = !!atoi(optarg);
+			break;
+		case 'B':
+			fixedbufs = !!atoi(optarg);
+			break;
+		case 'F':
+			register_files = !!atoi(optarg);
+			break;
+		case 'O':
+			buffered = !atoi(optarg);
+			break;
+		case 'S':
+			sq_thread_poll = !!atoi(optarg);
+			break;
+		case 'C':
+			sq_thread_cpu = atoi(optarg);
+			break;
+		case 'A':
+			sq_thread_share = !!atoi(optarg);
+			break;
+		case 'R':
+			buf_ring = !!atoi(optarg);
+			break;
+		case 'L':
+			track_lat = !!atoi(optarg);
+			break;
+		case 'n':
+			nr_threads = atoi(optarg);
+			break;
+		case 'W':
+			sweep = 1;
+			break;
+		case 't':
+			runtime = atoi(optarg);
+			break;
+		case 'j':
+			json = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (!depth || depth > MAX_DEPTH || !bs || !batch_submit ||
+	    !batch_complete) {
+		printf("invalid depth/batch/block size\n");
+		return 1;
+	}
+	if (!nr_threads || nr_threads > MAX_THREADS) {
+		printf("threads must be between 1 and %d\n", MAX_THREADS);
+		return 1;
+	}
+
+	file_names = &argv[optind];
+	nr_file_names = argc - optind;
+	if (mode == MODE_READ && !nr_file_names) {
+		printf("%s: filename\n", argv[0]);
+		return 1;
+	}
+	if (nr_file_names > MAX_FDS) {
+		printf("Max number of files (%d) reached\n", MAX_FDS);
+		nr_file_names = MAX_FDS;
+	}
+	/* sweeps and JSON reports are for unattended runs */
+	if ((sweep || json) && !runtime)
+		runtime = 10;
+
+	if (fixedbufs) {
+		struct rlimit rlim;
+
+		rlim.rlim_cur = RLIM_INFINITY;
+		rlim.rlim_max = RLIM_INFINITY;
+		/* newer kernels charge memcg instead, don't insist */
+		if (setrlimit(RLIMIT_MEMLOCK, &rlim) < 0)
+			perror("setrlimit");
+	}
+
+	arm_sig_int();
+
+	if (json)
+		printf("[");
+	threads = sweep ? 1 : nr_threads;
+	while (!stop) {
+		if (run_bench(threads, &res))
+			return 1;
+		print_result(&res, first);
+		first = 0;
+		if (threads == nr_threads)
+			break;
+		threads = min(threads * 2, nr_threads);
+	}
+	if (json)
+		printf("]\n");
 	return 0;
 }
@@ -3,6 +3,7 @@
 #define BENCH_H
 
 #include <sys/time.h>
+#include <linux/types.h>
 
 extern struct timeval bench__start, bench__end, bench__runtime;
 
@@ -44,6 +45,8 @@ int bench_breakpoint_thread(int argc, const char **argv);
 int bench_breakpoint_enable(int argc, const char **argv);
 int bench_pmu_scan(int argc, const char **argv);
 
+void bench_print_lat_pct(const char *name, u64 *lat, unsigned long nr);
+
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
 #define BENCH_FORMAT_SIMPLE_STR		"simple"
@@ -42,7 +42,15 @@
  *
  * Note that because fds are private to each thread, this workload does
  * not stress scenarios where multiple tasks are awoken per ready IO; ie:
- * EPOLLEXCLUSIVE semantics.
+ * EPOLLEXCLUSIVE semantics. The --herd option does: all threads then
+ * monitor the same fdmap, each through its own epoll instance, and every
+ * wakeup that finds nothing left to read is counted as wasted. With
+ * --exclusive the fds are added with EPOLLEXCLUSIVE, which should bring
+ * the wasted wakeups down.
+ *
+ * With --latency, the time from the writer making an fd ready to a
+ * worker returning from epoll_wait(2) with it is sampled, and its
+ * percentiles are reported as well.
  *
  * The end result/metric is throughput: number of ops/second where an
  * operation consists of:
@@ -71,7 +79,9 @@
 #include <stdlib.h>
 #include <linux/compiler.h>
 #include <linux/kernel.h>
+#include <linux/time64.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/resource.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -106,6 +116,17 @@ static unsigned int nested = 0;
 static bool et; /* edge-trigger */
 static bool oneshot;
 static bool multiq; /* use an epoll instance per thread */
+static bool herd; /* all threads monitor the same fds */
+static bool exclusive; /* EPOLLEXCLUSIVE, with --herd */
+static bool latency; /* sample wakeup latencies */
+
+/* shared fdmap for --herd */
+static int *herd_fdmap;
+
+/* for --latency: when each fd was made ready, in ns, 0 if it wasn't */
+static u64 *fd_stamp;
+
+#define LAT_SAMPLES (1 << 16) /* per thread, the most recent ones */
 
 /* amount of fds to monitor, per thread */
 static unsigned int nfds = 64;
@@ -120,6 +141,9 @@ struct worker {
 	int epollfd; /* for --multiq */
 	pthread_t thread;
 	unsigned long ops;
+	unsigned long wasted; /* --herd wakeups with nothing to read */
+	unsigned long nr_lat;
+	u64 *lat;
 	int *fdmap;
 };
 
@@ -138,6 +162,9 @@ static const struct option options[] = {
 	OPT_UINTEGER( 'N', "nested",  &nested,   "Nesting level epoll hierarchy (default is 0, no nesting)"),
 	OPT_BOOLEAN( 'S', "oneshot",  &oneshot,   "Use EPOLLONESHOT semantics"),
 	OPT_BOOLEAN( 'E', "edge",  &et,   "Use Edge-triggered interface (default is LT)"),
+	OPT_BOOLEAN( 'H', "herd",  &herd,   "All threads monitor the same file descriptors (thundering herd), implies --multiq"),
+	OPT_BOOLEAN( 'X', "exclusive",  &exclusive,   "Use EPOLLEXCLUSIVE semantics, implies --herd"),
+	OPT_BOOLEAN( 'l', "latency",  &latency,   "Report wakeup latency percentiles"),
 
 	OPT_END()
 };
@@ -179,6 +206,14 @@ static void shuffle(void *array, size_t n, size_t size)
 	free(aux);
 }
 
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
 
 static void *workerfn(void *arg)
 {
@@ -189,6 +224,7 @@ static void *workerfn(void *arg)
 	uint64_t val;
 	int to = nonblocking? 0 : -1;
 	int efd = multiq ? w->epollfd : epollfd;
+	u64 now = 0, stamp;
 
 	mutex_lock(&thread_lock);
 	threads_starting--;
@@ -209,25 +245,46 @@ static void *workerfn(void *arg)
 		} while (ret < 0 && errno == EINTR);
 		if (ret < 0)
 			err(EXIT_FAILURE, "epoll_wait");
+		if (latency)
+			now = now_ns();
 
 		fd = ev.data.fd;
 
-		do {
+		if (herd) {
+			/* someone else may have gotten to it first */
 			r = read(fd, &val, sizeof(val));
-		} while (!done && (r < 0 && errno == EAGAIN));
+			if (r < 0 && errno == EAGAIN) {
+				w->wasted++;
+				goto rearm;
+			}
+		} else {
+			do {
+				r = read(fd, &val, sizeof(val));
+			} while (!done && (r < 0 && errno == EAGAIN));
+		}
+
+		if (latency && r > 0) {
+			stamp = __atomic_exchange_n(&fd_stamp[fd], 0, __ATOMIC_RELAXED);
+			if (stamp && now > stamp)
+				w->lat[w->nr_lat++ % LAT_SAMPLES] = now - stamp;
+		}
 
 		if (et) {
 			ev.events = EPOLLIN | EPOLLET;
 			ret = epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev);
 		}
 
+		ops++;
+rearm:
+		/*
+		 * A wasted herd wakeup consumed the oneshot event too, so
+		 * rearm in that case as well or the fd is never seen again.
+		 */
 		if (oneshot) {
 			/* rearm the file descriptor with a new event mask */
 			ev.events |= EPOLLIN | EPOLLONESHOT;
 			ret = epoll_ctl(efd, EPOLL_CTL_MOD, fd, &ev);
 		}
-
-		ops++;
 	}  while (!done);
 
 	if (multiq)
@@ -302,6 +359,8 @@ static int do_threads(struct worker *worker, struct perf_cpu_map *cpu)
 		events |= EPOLLONESHOT;
 	if (et)
 		events |= EPOLLET;
+	if (exclusive)
+		events |= EPOLLEXCLUSIVE;
 
 	printinfo("starting worker/consumer %sthreads%s\n",
 		  noaffinity ?  "":"CPU affinity ",
@@ -327,7 +386,16 @@ static int do_threads(struct worker *worker, struct perf_cpu_map *cpu)
 		}
 
 		w->tid = i;
-		w->fdmap = calloc(nfds, sizeof(int));
+		if (latency) {
+			w->lat = calloc(LAT_SAMPLES, sizeof(*w->lat));
+			if (!w->lat)
+				return 1;
+		}
+
+		if (herd)
+			w->fdmap = herd_fdmap;
+		else
+			w->fdmap = calloc(nfds, sizeof(int));
 		if (!w->fdmap)
 			return 1;
 
@@ -335,9 +403,11 @@ static int do_threads(struct worker *worker, struct perf_cpu_map *cpu)
 			int efd = multiq ? w->epollfd : epollfd;
 			struct epoll_event ev;
 
-			w->fdmap[j] = eventfd(0, EFD_NONBLOCK);
-			if (w->fdmap[j] < 0)
-				err(EXIT_FAILURE, "eventfd");
+			if (!herd) {
+				w->fdmap[j] = eventfd(0, EFD_NONBLOCK);
+				if (w->fdmap[j] < 0)
+					err(EXIT_FAILURE, "eventfd");
+			}
 
 			ev.data.fd = w->fdmap[j];
 			ev.events = events;
@@ -381,6 +451,8 @@ static void *writerfn(void *p)
 {
 	struct worker *worker = p;
 	size_t i, j, iter;
+	/* with --herd, all fdmaps are the same one */
+	size_t nr = herd ? 1 : nthreads;
 	const uint64_t val = 1;
 	ssize_t sz;
 	struct timespec ts = { .tv_sec = 0,
@@ -394,7 +466,7 @@ static void *writerfn(void *p)
 			shuffle((void *)worker, nthreads, sizeof(*worker));
 		}
 
-		for (i = 0; i < nthreads; i++) {
+		for (i = 0; i < nr; i++) {
 			struct worker *w = &worker[i];
 
 			if (randomize) {
@@ -402,6 +474,15 @@ static void *writerfn(void *p)
 			}
 
 			for (j = 0; j < nfds; j++) {
+				if (latency) {
+					u64 zero = 0;
+
+					/* only the first write makes it ready */
+					__atomic_compare_exchange_n(&fd_stamp[w->fdmap[j]],
+								    &zero, now_ns(), false,
+								    __ATOMIC_RELAXED,
+								    __ATOMIC_RELAXED);
+				}
 				do {
 					sz = write(w->fdmap[j], &val, sizeof(val));
 				} while (!wdone && (sz < 0 && errno == EAGAIN));
@@ -423,6 +504,31 @@ static int cmpworker(const void *p1, const void *p2)
 	return w1->tid > w2->tid;
 }
 
+static void print_latency(struct worker *worker)
+{
+	unsigned long nr = 0, n;
+	unsigned int i;
+	u64 *lat;
+
+	for (i = 0; i < nthreads; i++)
+		nr += min(worker[i].nr_lat, (unsigned long)LAT_SAMPLES);
+	if (!nr)
+		return;
+
+	lat = calloc(nr, sizeof(*lat));
+	if (!lat)
+		err(EXIT_FAILURE, "calloc");
+
+	for (nr = 0, i = 0; i < nthreads; i++) {
+		n = min(worker[i].nr_lat, (unsigned long)LAT_SAMPLES);
+		memcpy(lat + nr, worker[i].lat, n * sizeof(*lat));
+		nr += n;
+	}
+	bench_print_lat_pct("Wakeup latency", lat, nr);
+
+	free(lat);
+}
+
 int bench_epoll_wait(int argc, const char **argv)
 {
 	int ret = 0;
@@ -439,6 +545,15 @@ int bench_epoll_wait(int argc, const char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (exclusive)
+		herd = true;
+	if (herd) {
+		/* each thread needs its own epoll instance to be woken */
+		multiq = true;
+		if (exclusive && (oneshot || nested))
+			errx(EXIT_FAILURE, "EPOLLEXCLUSIVE can't be used with --oneshot or --nested");
+	}
+
 	memset(&act, 0, sizeof(act));
 	sigfillset(&act.sa_mask);
 	act.sa_sigaction = toggle_done;
@@ -481,9 +596,28 @@ int bench_epoll_wait(int argc, const char **argv)
 	if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
 		err(EXIT_FAILURE, "setrlimit");
 
-	printf("Run summary [PID %d]: %d threads monitoring%s on "
-	       "%d file-descriptors for %d secs.\n\n",
-	       getpid(), nthreads, oneshot ? " (EPOLLONESHOT semantics)": "", nfds, nsecs);
+	if (latency) {
+		fd_stamp = calloc(rl.rlim_cur, sizeof(*fd_stamp));
+		if (!fd_stamp)
+			goto errmem;
+	}
+
+	if (herd) {
+		herd_fdmap = calloc(nfds, sizeof(int));
+		if (!herd_fdmap)
+			goto errmem;
+		for (i = 0; i < nfds; i++) {
+			herd_fdmap[i] = eventfd(0, EFD_NONBLOCK);
+			if (herd_fdmap[i] < 0)
+				err(EXIT_FAILURE, "eventfd");
+		}
+	}
+
+	printf("Run summary [PID %d]: %d threads monitoring%s%s on "
+	       "%d %sfile-descriptors for %d secs.\n\n",
+	       getpid(), nthreads, oneshot ? " (EPOLLONESHOT semantics)": "",
+	       exclusive ? " (EPOLLEXCLUSIVE semantics)": "", nfds,
+	       herd ? "shared " : "", nsecs);
 
 	init_stats(&throughput_stats);
 	mutex_init(&thread_lock);
@@ -537,7 +671,10 @@ int bench_epoll_wait(int argc, const char **argv)
 
 		update_stats(&throughput_stats, t);
 
-		if (nfds == 1)
+		if (herd)
+			printf("[thread %2d] [ %04ld ops/sec, %lu wasted wakeups ]\n",
+			       worker[i].tid, t, worker[i].wasted);
+		else if (nfds == 1)
 			printf("[thread %2d] fdmap: %p [ %04ld ops/sec ]\n",
 			       worker[i].tid, &worker[i].fdmap[0], t);
 		else
@@ -547,6 +684,8 @@ int bench_epoll_wait(int argc, const char **argv)
 	}
 
 	print_summary();
+	if (latency)
+		print_latency(worker);
 
 	close(epollfd);
 	return ret;
@@ -21,6 +21,7 @@
 #include <linux/zalloc.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <perf/cpumap.h>
 
 #include "../util/mutex.h"
@@ -42,6 +43,7 @@ static struct cond thread_parent, thread_worker;
 
 struct worker {
 	int tid;
+	int node;
 	u_int32_t *futex;
 	pthread_t thread;
 	unsigned long ops;
@@ -50,6 +52,8 @@ struct worker {
 static struct bench_futex_parameters params = {
 	.nfutexes = 1024,
 	.runtime  = 10,
+	.nbuckets = -1,
+	.nprocs	  = 1,
 };
 
 static const struct option options[] = {
@@ -59,6 +63,9 @@ static const struct option options[] = {
 	OPT_BOOLEAN( 's', "silent",  &params.silent, "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &params.fshared, "Use shared futexes instead of private ones"),
 	OPT_BOOLEAN( 'm', "mlockall", &params.mlockall, "Lock all current and future memory"),
+	OPT_INTEGER( 'b', "buckets", &params.nbuckets, "Use a private hash with that many buckets, 0 to size it by thread count"),
+	OPT_BOOLEAN( 'N', "numa", &params.numa, "Spread threads over NUMA nodes and report per node throughput"),
+	OPT_UINTEGER('p', "processes", &params.nprocs, "Run the benchmark in that many processes at once"),
 	OPT_END()
 };
 
@@ -120,52 +127,53 @@ static void print_summary(void)
 	       (int)bench__runtime.tv_sec);
 }
 
-int bench_futex_hash(int argc, const char **argv)
+static void print_node_summary(struct worker *worker, unsigned int nworkers,
+			       int nr_nodes)
 {
-	int ret = 0;
-	cpu_set_t *cpuset;
-	struct sigaction act;
-	unsigned int i;
-	pthread_attr_t thread_attr;
-	struct worker *worker = NULL;
-	struct perf_cpu_map *cpu;
-	int nrcpus;
-	size_t size;
-
-	argc = parse_options(argc, argv, options, bench_futex_hash_usage, 0);
-	if (argc) {
-		usage_with_options(bench_futex_hash_usage, options);
-		exit(EXIT_FAILURE);
-	}
-
-	cpu = perf_cpu_map__new(NULL);
-	if (!cpu)
-		goto errmem;
+	struct stats node_stats;
+	unsigned int i, nthreads;
+	unsigned long avg;
+	int n, node;
+
+	for (n = 0; n < nr_nodes; n++) {
+		node = futex_numa_node(n);
+		init_stats(&node_stats);
+		nthreads = 0;
+
+		for (i = 0; i < nworkers; i++) {
+			if (worker[i].node != node)
+				continue;
+			update_stats(&node_stats, bench__runtime.tv_sec > 0 ?
+				     worker[i].ops / bench__runtime.tv_sec : 0);
+			nthreads++;
+		}
 
-	memset(&act, 0, sizeof(act));
-	sigfillset(&act.sa_mask);
-	act.sa_sigaction = toggle_done;
-	sigaction(SIGINT, &act, NULL);
+		if (!nthreads)
+			continue;
 
-	if (params.mlockall) {
-		if (mlockall(MCL_CURRENT | MCL_FUTURE))
-			err(EXIT_FAILURE, "mlockall");
+		avg = avg_stats(&node_stats);
+		printf("[node %2d] %3u threads, averaged %ld operations/sec (+- %.2f%%)\n",
+		       node, nthreads, avg,
+		       rel_stddev_stats(stddev_stats(&node_stats), avg));
 	}
+}
 
-	if (!params.nthreads) /* default to the number of CPUs */
-		params.nthreads = perf_cpu_map__nr(cpu);
-
-	worker = calloc(params.nthreads, sizeof(*worker));
-	if (!worker)
-		goto errmem;
-
-	if (!params.fshared)
-		futex_flag = FUTEX_PRIVATE_FLAG;
+/*
+ * Run params.nthreads workers in this process. @proc numbers the process,
+ * so that the threads of all processes are placed on distinct CPUs.
+ */
+static void run_process(struct worker *worker, unsigned int proc,
+			struct perf_cpu_map *cpu)
+{
+	pthread_attr_t thread_attr;
+	cpu_set_t *cpuset;
+	struct perf_cpu c;
+	unsigned int i, nr;
+	int nrcpus, ret;
+	size_t size;
 
-	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n\n",
-	       getpid(), params.nthreads, params.nfutexes, params.fshared ? "shared":"private", params.runtime);
+	futex_set_nbuckets_param(&params);
 
-	init_stats(&throughput_stats);
 	mutex_init(&thread_lock);
 	cond_init(&thread_parent);
 	cond_init(&thread_worker);
@@ -180,14 +188,22 @@ int bench_futex_hash(int argc, const char **argv)
 	size = CPU_ALLOC_SIZE(nrcpus);
 
 	for (i = 0; i < params.nthreads; i++) {
-		worker[i].tid = i;
+		nr = proc * params.nthreads + i;
+		worker[i].tid = nr;
 		worker[i].futex = calloc(params.nfutexes, sizeof(*worker[i].futex));
 		if (!worker[i].futex)
-			goto errmem;
+			err(EXIT_FAILURE, "calloc");
+
+		if (params.numa) {
+			c = futex_numa_cpu(cpu, nr, &worker[i].node);
+		} else {
+			c = perf_cpu_map__cpu(cpu, nr % nrcpus);
+			worker[i].node = -1;
+		}
 
 		CPU_ZERO_S(size, cpuset);
 
-		CPU_SET_S(perf_cpu_map__cpu(cpu, i % perf_cpu_map__nr(cpu)).cpu, size, cpuset);
+		CPU_SET_S(c.cpu, size, cpuset);
 		ret = pthread_attr_setaffinity_np(&thread_attr, size, cpuset);
 		if (ret) {
 			CPU_FREE(cpuset);
@@ -219,12 +235,94 @@ int bench_futex_hash(int argc, const char **argv)
 			err(EXIT_FAILURE, "pthread_join");
 	}
 
-	/* cleanup & report results */
 	cond_destroy(&thread_parent);
 	cond_destroy(&thread_worker);
 	mutex_destroy(&thread_lock);
+}
 
-	for (i = 0; i < params.nthreads; i++) {
+int bench_futex_hash(int argc, const char **argv)
+{
+	int ret = 0;
+	struct sigaction act;
+	unsigned int i, nworkers;
+	struct worker *worker = NULL;
+	struct perf_cpu_map *cpu;
+	int nr_nodes = 0;
+	pid_t *pids;
+	size_t size;
+
+	argc = parse_options(argc, argv, options, bench_futex_hash_usage, 0);
+	if (argc) {
+		usage_with_options(bench_futex_hash_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = perf_cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	memset(&act, 0, sizeof(act));
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (params.mlockall) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE))
+			err(EXIT_FAILURE, "mlockall");
+	}
+
+	if (!params.nthreads) /* default to the number of CPUs */
+		params.nthreads = perf_cpu_map__nr(cpu);
+
+	if (!params.nprocs)
+		params.nprocs = 1;
+
+	if (params.numa)
+		nr_nodes = futex_numa_init(cpu);
+
+	/* Shared with the child processes, which report their ops in it. */
+	nworkers = params.nprocs * params.nthreads;
+	size = nworkers * sizeof(*worker);
+	worker = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (worker == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	pids = calloc(params.nprocs, sizeof(*pids));
+	if (!pids)
+		goto errmem;
+
+	if (!params.fshared)
+		futex_flag = FUTEX_PRIVATE_FLAG;
+
+	printf("Run summary [PID %d]: %d processes, %d threads each, each operating on %d [%s] futexes for %d secs.\n\n",
+	       getpid(), params.nprocs, params.nthreads, params.nfutexes,
+	       params.fshared ? "shared":"private", params.runtime);
+
+	init_stats(&throughput_stats);
+	fflush(stdout);
+
+	for (i = 1; i < params.nprocs; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			err(EXIT_FAILURE, "fork");
+		if (!pids[i]) {
+			run_process(worker + i * params.nthreads, i, cpu);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	run_process(worker, 0, cpu);
+
+	for (i = 1; i < params.nprocs; i++) {
+		if (waitpid(pids[i], NULL, 0) < 0)
+			err(EXIT_FAILURE, "waitpid");
+	}
+
+	/* report results */
+	futex_print_nbuckets(&params);
+
+	for (i = 0; i < nworkers; i++) {
 		unsigned long t = bench__runtime.tv_sec > 0 ?
 			worker[i].ops / bench__runtime.tv_sec : 0;
 		update_stats(&throughput_stats, t);
@@ -237,13 +335,19 @@ int bench_futex_hash(int argc, const char **argv)
 				       worker[i].tid, &worker[i].futex[0],
 				       &worker[i].futex[params.nfutexes-1], t);
 		}
-
-		zfree(&worker[i].futex);
 	}
 
+	if (params.numa)
+		print_node_summary(worker, nworkers, nr_nodes);
+
 	print_summary();
 
-	free(worker);
+	/* The futexes of the child processes went away with them. */
+	for (i = 0; i < params.nthreads; i++)
+		zfree(&worker[i].futex);
+
+	munmap(worker, size);
+	free(pids);
 	free(cpu);
 	return ret;
 errmem:
@@ -54,10 +54,15 @@ static struct mutex thread_lock;
 static struct cond thread_parent, thread_worker;
 static pthread_barrier_t barrier;
 static struct stats waketime_stats, wakeup_stats;
+static struct stats *node_waketime_stats;
+static struct futex_lat_hist waketime_hist;
 static unsigned int threads_starting;
 static int futex_flag = 0;
+static int nr_nodes;
 
-static struct bench_futex_parameters params;
+static struct bench_futex_parameters params = {
+	.nbuckets = -1,
+};
 
 static const struct option options[] = {
 	OPT_UINTEGER('t', "threads", &params.nthreads, "Specify amount of threads"),
@@ -65,6 +70,8 @@ static const struct option options[] = {
 	OPT_BOOLEAN( 's', "silent",  &params.silent, "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &params.fshared, "Use shared futexes instead of private ones"),
 	OPT_BOOLEAN( 'm', "mlockall", &params.mlockall, "Lock all current and future memory"),
+	OPT_INTEGER( 'b', "buckets", &params.nbuckets, "Use a private hash with that many buckets, 0 to size it by thread count"),
+	OPT_BOOLEAN( 'N', "numa", &params.numa, "Spread blocked and waking threads over NUMA nodes, report wake latency per node"),
 
 	OPT_END()
 };
@@ -95,25 +102,50 @@ static void *waking_workerfn(void *arg)
 	return NULL;
 }
 
-static void wakeup_threads(struct thread_data *td, pthread_attr_t thread_attr)
+static void wakeup_threads(struct thread_data *td, pthread_attr_t thread_attr,
+			   struct perf_cpu_map *cpu)
 {
+	cpu_set_t *cpuset = NULL;
+	struct perf_cpu c;
 	unsigned int i;
+	size_t size = 0;
+	int node;
 
 	pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_JOINABLE);
 
 	pthread_barrier_init(&barrier, NULL, params.nwakes + 1);
 
+	if (params.numa) {
+		cpuset = CPU_ALLOC(perf_cpu_map__nr(cpu));
+		BUG_ON(!cpuset);
+		size = CPU_ALLOC_SIZE(perf_cpu_map__nr(cpu));
+	}
+
 	/* create and block all threads */
 	for (i = 0; i < params.nwakes; i++) {
 		/*
 		 * Thread creation order will impact per-thread latency
 		 * as it will affect the order to acquire the hb spinlock.
-		 * For now let the scheduler decide.
+		 * For now let the scheduler decide, unless the wakers are
+		 * to be spread over the nodes.
 		 */
+		if (params.numa) {
+			c = futex_numa_cpu(cpu, i, &node);
+			CPU_ZERO_S(size, cpuset);
+			CPU_SET_S(c.cpu, size, cpuset);
+
+			if (pthread_attr_setaffinity_np(&thread_attr, size, cpuset)) {
+				CPU_FREE(cpuset);
+				err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+			}
+		}
+
 		if (pthread_create(&td[i].worker, &thread_attr,
 				   waking_workerfn, (void *)&td[i]))
 			err(EXIT_FAILURE, "pthread_create");
 	}
+	if (cpuset)
+		CPU_FREE(cpuset);
 
 	pthread_barrier_wait(&barrier);
 
@@ -158,8 +190,16 @@ static void block_threads(pthread_t *w, pthread_attr_t thread_attr,
 
 	/* create and block all threads */
 	for (i = 0; i < params.nthreads; i++) {
+		struct perf_cpu c;
+		int node;
+
+		if (params.numa)
+			c = futex_numa_cpu(cpu, i, &node);
+		else
+			c = perf_cpu_map__cpu(cpu, i % perf_cpu_map__nr(cpu));
+
 		CPU_ZERO_S(size, cpuset);
-		CPU_SET_S(perf_cpu_map__cpu(cpu, i % perf_cpu_map__nr(cpu)).cpu, size, cpuset);
+		CPU_SET_S(c.cpu, size, cpuset);
 
 		if (pthread_attr_setaffinity_np(&thread_attr, size, cpuset)) {
 			CPU_FREE(cpuset);
@@ -201,6 +241,7 @@ static void print_run(struct thread_data *waking_worker, unsigned int run_num)
 static void print_summary(void)
 {
 	unsigned int wakeup_avg;
+	int i;
 	double waketime_avg, waketime_stddev;
 
 	waketime_avg = avg_stats(&waketime_stats);
@@ -212,16 +253,37 @@ static void print_summary(void)
 	       params.nthreads,
 	       waketime_avg / USEC_PER_MSEC,
 	       rel_stddev_stats(waketime_stddev, waketime_avg));
+
+	for (i = 0; i < nr_nodes; i++) {
+		waketime_avg = avg_stats(&node_waketime_stats[i]);
+		waketime_stddev = stddev_stats(&node_waketime_stats[i]);
+
+		printf("[node %2d] Avg per-thread latency in %.4f ms (+-%.2f%%)\n",
+		       futex_numa_node(i), waketime_avg / USEC_PER_MSEC,
+		       rel_stddev_stats(waketime_stddev, waketime_avg));
+	}
+
+	if (!params.silent)
+		futex_lat_hist_print(&waketime_hist, "Per-thread wake latency:");
 }
 
 
 static void do_run_stats(struct thread_data *waking_worker)
 {
 	unsigned int i;
+	unsigned long usecs;
 
 	for (i = 0; i < params.nwakes; i++) {
+		usecs = waking_worker[i].runtime.tv_sec * USEC_PER_SEC +
+			waking_worker[i].runtime.tv_usec;
+
 		update_stats(&waketime_stats, waking_worker[i].runtime.tv_usec);
 		update_stats(&wakeup_stats, waking_worker[i].nwoken);
+		futex_lat_hist_add(&waketime_hist, usecs);
+
+		/* Waker i runs on the (i % nr_nodes)th node, see futex_numa_cpu() */
+		if (nr_nodes)
+			update_stats(&node_waketime_stats[i % nr_nodes], usecs);
 	}
 
 }
@@ -286,10 +348,23 @@ int bench_futex_wake_parallel(int argc, const char **argv)
 	if (!params.fshared)
 		futex_flag = FUTEX_PRIVATE_FLAG;
 
+	futex_set_nbuckets_param(&params);
+
+	if (params.numa) {
+		nr_nodes = futex_numa_init(cpu);
+		node_waketime_stats = calloc(nr_nodes, sizeof(*node_waketime_stats));
+		if (!node_waketime_stats)
+			err(EXIT_FAILURE, "calloc");
+		for (i = 0; i < (unsigned int)nr_nodes; i++)
+			init_stats(&node_waketime_stats[i]);
+	}
+
 	printf("Run summary [PID %d]: blocking on %d threads (at [%s] "
-	       "futex %p), %d threads waking up %d at a time.\n\n",
+	       "futex %p), %d threads waking up %d at a time.\n",
 	       getpid(), params.nthreads, params.fshared ? "shared":"private",
 	       &futex, params.nwakes, nwakes);
+	futex_print_nbuckets(&params);
+	printf("\n");
 
 	init_stats(&wakeup_stats);
 	init_stats(&waketime_stats);
@@ -317,7 +392,7 @@ int bench_futex_wake_parallel(int argc, const char **argv)
 		usleep(100000);
 
 		/* Ok, all threads are patiently blocked, start waking folks up */
-		wakeup_threads(waking_worker, thread_attr);
+		wakeup_threads(waking_worker, thread_attr, cpu);
 
 		for (i = 0; i < params.nthreads; i++) {
 			ret = pthread_join(blocked_worker[i], NULL);
@@ -340,6 +415,7 @@ int bench_futex_wake_parallel(int argc, const char **argv)
 
 	print_summary();
 
+	free(node_waketime_stats);
 	free(blocked_worker);
 	perf_cpu_map__put(cpu);
 	return ret;
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Helpers shared by the futex benchmarks: private hash setup, NUMA aware
+ * thread placement and latency histograms.
+ */
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <linux/kernel.h>
+#include <perf/cpumap.h>
+
+#include "../util/cpumap.h"
+#include "futex.h"
+
+#ifndef PR_FUTEX_HASH
+#define PR_FUTEX_HASH			78
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+#endif
+
+void futex_set_nbuckets_param(struct bench_futex_parameters *params)
+{
+	if (params->nbuckets < 0)
+		return;
+
+	if (params->fshared)
+		errx(EXIT_FAILURE, "the private hash is only used for private futexes");
+
+	if (prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, params->nbuckets, 0, 0))
+		err(EXIT_FAILURE, "prctl(PR_FUTEX_HASH)");
+}
+
+void futex_print_nbuckets(struct bench_futex_parameters *params)
+{
+	int slots;
+
+	if (params->nbuckets < 0)
+		return;
+
+	slots = prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 0, 0, 0);
+	if (params->nbuckets)
+		printf("Futex hash: private, %d buckets\n", slots);
+	else
+		printf("Futex hash: private, %d buckets (sized by thread count)\n",
+		       slots);
+}
+
+/* NUMA nodes which have CPUs in the map, in ascending order. */
+static int *numa_nodes;
+static int nr_numa_nodes;
+
+int futex_numa_init(struct perf_cpu_map *cpu)
+{
+	struct perf_cpu c;
+	int node, max_node, idx;
+	bool *seen;
+
+	if (cpu__setup_cpunode_map())
+		errx(EXIT_FAILURE, "can't read the CPU to NUMA node map");
+
+	max_node = cpu__max_node();
+	seen = calloc(max_node, sizeof(*seen));
+	numa_nodes = calloc(max_node, sizeof(*numa_nodes));
+	if (!seen || !numa_nodes)
+		err(EXIT_FAILURE, "calloc");
+
+	perf_cpu_map__for_each_cpu(c, idx, cpu) {
+		node = cpu__get_node(c);
+		if (node >= 0 && node < max_node)
+			seen[node] = true;
+	}
+
+	for (node = 0; node < max_node; node++) {
+		if (seen[node])
+			numa_nodes[nr_numa_nodes++] = node;
+	}
+	free(seen);
+
+	if (!nr_numa_nodes)
+		errx(EXIT_FAILURE, "no NUMA node has CPUs in the map");
+
+	return nr_numa_nodes;
+}
+
+int futex_numa_node(unsigned int nr)
+{
+	return numa_nodes[nr % nr_numa_nodes];
+}
+
+/*
+ * Pick the CPU for thread @nr so that consecutive threads go to different
+ * nodes, and the threads of a node are spread over its CPUs.
+ */
+struct perf_cpu futex_numa_cpu(struct perf_cpu_map *cpu, unsigned int nr,
+			       int *node)
+{
+	unsigned int nth = nr / nr_numa_nodes, ncpus = 0, i = 0;
+	struct perf_cpu c, ret = { .cpu = -1 };
+	int idx;
+
+	*node = futex_numa_node(nr);
+
+	perf_cpu_map__for_each_cpu(c, idx, cpu) {
+		if (cpu__get_node(c) == *node)
+			ncpus++;
+	}
+
+	nth %= ncpus;
+	perf_cpu_map__for_each_cpu(c, idx, cpu) {
+		if (cpu__get_node(c) != *node)
+			continue;
+		if (i++ == nth) {
+			ret = c;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+void futex_lat_hist_add(struct futex_lat_hist *hist, unsigned long usecs)
+{
+	unsigned int i = 0;
+
+	while (usecs && i < FUTEX_LAT_BUCKETS - 1) {
+		usecs >>= 1;
+		i++;
+	}
+
+	hist->buckets[i]++;
+	hist->total++;
+}
+
+#define FUTEX_LAT_BAR_LEN	46
+
+/* Same layout as the latency histogram of 'perf ftrace latency'. */
+void futex_lat_hist_print(struct futex_lat_hist *hist, const char *title)
+{
+	char bar[] = "##############################################";
+	unsigned int i;
+	int len;
+
+	if (!hist->total)
+		return;
+
+	printf("\n%s\n", title);
+	printf("%-25s| %10s | %-*s |\n", "#   DURATION", "COUNT",
+	       FUTEX_LAT_BAR_LEN, "GRAPH");
+
+	for (i = 0; i < FUTEX_LAT_BUCKETS; i++) {
+		len = hist->buckets[i] * FUTEX_LAT_BAR_LEN / hist->total;
+
+		if (!i)
+			printf("  %8d - %-8d us |", 0, 1);
+		else if (i < FUTEX_LAT_BUCKETS - 1)
+			printf("  %8lu - %-8lu us |", 1UL << (i - 1), 1UL << i);
+		else
+			printf("  %8lu - %-8s us |", 1UL << (i - 1), "...");
+
+		printf(" %10lu | %.*s%*s |\n", hist->buckets[i], len, bar,
+		       FUTEX_LAT_BAR_LEN - len, "");
+	}
+}
@@ -12,6 +12,7 @@
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <linux/futex.h>
+#include <perf/cpumap.h>
 
 struct bench_futex_parameters {
 	bool silent;
@@ -25,8 +26,30 @@ struct bench_futex_parameters {
 	unsigned int nfutexes;
 	unsigned int nwakes;
 	unsigned int nrequeue;
+	int nbuckets; /* private hash, -1 for the global one */
+	bool numa; /* spread threads over NUMA nodes */
+	unsigned int nprocs;
 };
 
+void futex_set_nbuckets_param(struct bench_futex_parameters *params);
+void futex_print_nbuckets(struct bench_futex_parameters *params);
+
+int futex_numa_init(struct perf_cpu_map *cpu);
+int futex_numa_node(unsigned int nr);
+struct perf_cpu futex_numa_cpu(struct perf_cpu_map *cpu, unsigned int nr,
+			       int *node);
+
+/* log2 buckets of microseconds, the last one is open ended */
+#define FUTEX_LAT_BUCKETS	22
+
+struct futex_lat_hist {
+	unsigned long buckets[FUTEX_LAT_BUCKETS];
+	unsigned long total;
+};
+
+void futex_lat_hist_add(struct futex_lat_hist *hist, unsigned long usecs);
+void futex_lat_hist_print(struct futex_lat_hist *hist, const char *title);
+
 /**
  * futex_syscall() - SYS_futex syscall wrapper
  * @uaddr:	address of first futex
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Latency percentile reporting shared by the benchmarks that sample
+ * per-operation latencies.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+
+#include "bench.h"
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Print the p50, p90, p99, p99.9 and max of @nr latencies in nsecs, in
+ * usecs.  @lat is sorted in place.
+ */
+void bench_print_lat_pct(const char *name, u64 *lat, unsigned long nr)
+{
+	static const double pct[] = { 50.0, 90.0, 99.0, 99.9 };
+	unsigned int i;
+
+	if (!nr)
+		return;
+
+	qsort(lat, nr, sizeof(*lat), cmp_u64);
+
+	printf(" %14s:", name);
+	for (i = 0; i < ARRAY_SIZE(pct); i++)
+		printf(" p%g %.1f", pct[i],
+		       (double)lat[(unsigned long)(pct[i] / 100.0 * (nr - 1))] / NSEC_PER_USEC);
+	printf(" max %.1f [usec]\n", (double)lat[nr - 1] / NSEC_PER_USEC);
+}
@@ -21,22 +21,39 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <linux/mempolicy.h>
 #include <linux/time64.h>
-#include <linux/zalloc.h>
 
 #define K 1024
 
+#define MAX_SIZES	64
+
 static const char	*size_str	= "1MB";
 static const char	*function_str	= "all";
+static const char	*page_str	= "default";
 static int		nr_loops	= 1;
+static int		src_node	= -1;
+static int		dst_node	= -1;
 static bool		use_cycles;
 static int		cycles_fd;
 
+enum page_mode {
+	PAGE_DEFAULT,
+	PAGE_SMALL,
+	PAGE_THP,
+	PAGE_HUGETLB,
+};
+
+static enum page_mode	page_mode;
+static size_t		hpage_size;
+
 static const struct option options[] = {
 	OPT_STRING('s', "size", &size_str, "1MB",
-		    "Specify the size of the memory buffers. "
+		    "Specify the size of the memory buffers, or a comma separated list of sizes to sweep. "
 		    "Available units: B, KB, MB, GB and TB (case insensitive)"),
 
 	OPT_STRING('f', "function", &function_str, "all",
@@ -48,6 +65,15 @@ static const struct option options[] = {
 	OPT_BOOLEAN('c', "cycles", &use_cycles,
 		    "Use a cycles event instead of gettimeofday() to measure performance"),
 
+	OPT_STRING('p', "page", &page_str, "default",
+		    "Specify the pages backing the buffers: default, 4k (no THP), thp or hugetlb"),
+
+	OPT_INTEGER(0, "src_node", &src_node,
+		    "Bind the source buffer to this NUMA node (default: no binding)"),
+
+	OPT_INTEGER(0, "dst_node", &dst_node,
+		    "Bind the destination buffer to this NUMA node (default: no binding)"),
+
 	OPT_END()
 };
 
@@ -107,6 +133,79 @@ static double timeval2double(struct timeval *ts)
 			printf(" %14lf GB/sec\n", x / K / K / K);	\
 	} while (0)
 
+/* The default hugetlb page size, which MAP_HUGETLB gets, 0 if unknown */
+static size_t default_hpage_size(void)
+{
+	unsigned long kb = 0;
+	char line[128];
+	FILE *fp;
+
+	fp = fopen("/proc/meminfo", "r");
+	if (!fp)
+		return 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1)
+			break;
+	}
+	fclose(fp);
+
+	return kb * K;
+}
+
+static size_t buf_len(size_t size)
+{
+	size_t align = page_mode == PAGE_HUGETLB ? hpage_size : (size_t)sysconf(_SC_PAGESIZE);
+
+	return (size + align - 1) & ~(align - 1);
+}
+
+/*
+ * Buffers are mmap()ed, so that their pages and node can be chosen. They
+ * are not touched here: the prefault in the do_*() functions faults them
+ * in, under the memory policy set up below.
+ */
+static void *alloc_buf(size_t size, int node)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	size_t len = buf_len(size);
+	void *buf;
+
+	if (page_mode == PAGE_HUGETLB)
+		flags |= MAP_HUGETLB;
+
+	buf = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (buf == MAP_FAILED)
+		return NULL;
+
+	if (page_mode == PAGE_THP && madvise(buf, len, MADV_HUGEPAGE))
+		fprintf(stderr, "# Could not enable THP\n");
+	if (page_mode == PAGE_SMALL && madvise(buf, len, MADV_NOHUGEPAGE))
+		fprintf(stderr, "# Could not disable THP\n");
+
+	if (node >= 0) {
+		unsigned long mask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+
+		if (node >= 1024)
+			goto out_unmap;
+		mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+		if (syscall(SYS_mbind, buf, len, MPOL_BIND, mask, 1024 + 1, MPOL_MF_STRICT))
+			goto out_unmap;
+	}
+
+	return buf;
+
+out_unmap:
+	munmap(buf, len);
+	return NULL;
+}
+
+static void free_buf(void *buf, size_t size)
+{
+	if (buf)
+		munmap(buf, buf_len(size));
+}
+
 struct bench_mem_info {
 	const struct function *functions;
 	u64 (*do_cycles)(const struct function *r, size_t size, void *src, void *dst);
@@ -115,12 +214,13 @@ struct bench_mem_info {
 	bool alloc_src;
 };
 
-static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t size, double size_total)
+static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t size,
+				 double size_total, const char *size_name)
 {
 	const struct function *r = &info->functions[r_idx];
 	double result_bps = 0.0;
 	u64 result_cycles = 0;
-	void *src = NULL, *dst = zalloc(size);
+	void *src = NULL, *dst = alloc_buf(size, dst_node);
 
 	printf("# function '%s' (%s)\n", r->name, r->desc);
 
@@ -128,13 +228,13 @@ static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t
 		goto out_alloc_failed;
 
 	if (info->alloc_src) {
-		src = zalloc(size);
+		src = alloc_buf(size, src_node);
 		if (src == NULL)
 			goto out_alloc_failed;
 	}
 
 	if (bench_format == BENCH_FORMAT_DEFAULT)
-		printf("# Copying %s bytes ...\n\n", size_str);
+		printf("# Copying %s bytes ...\n\n", size_name);
 
 	if (use_cycles) {
 		result_cycles = info->do_cycles(r, size, src, dst);
@@ -165,22 +265,55 @@ static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t
 	}
 
 out_free:
-	free(src);
-	free(dst);
+	free_buf(src, size);
+	free_buf(dst, size);
 	return;
 out_alloc_failed:
-	printf("# Memory allocation failed - maybe size (%s) is too large?\n", size_str);
+	printf("# Memory allocation failed - maybe size (%s) is too large, or the page type or node unavailable?\n",
+	       size_name);
 	goto out_free;
 }
 
-static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *info)
+static void bench_mem_sizes(struct bench_mem_info *info, int r_idx, int nr_sizes,
+			    size_t *sizes, char **size_names)
 {
 	int i;
-	size_t size;
-	double size_total;
+
+	for (i = 0; i < nr_sizes; i++)
+		__bench_mem_function(info, r_idx, sizes[i], (double)sizes[i] * nr_loops,
+				     size_names[i]);
+}
+
+static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *info)
+{
+	int i, nr_sizes = 0, ret = 1;
+	size_t sizes[MAX_SIZES];
+	char *size_names[MAX_SIZES];
+	char *str, *tok, *saveptr = NULL;
 
 	argc = parse_options(argc, argv, options, info->usage, 0);
 
+	if (!strcmp(page_str, "default"))
+		page_mode = PAGE_DEFAULT;
+	else if (!strcmp(page_str, "4k"))
+		page_mode = PAGE_SMALL;
+	else if (!strcmp(page_str, "thp"))
+		page_mode = PAGE_THP;
+	else if (!strcmp(page_str, "hugetlb"))
+		page_mode = PAGE_HUGETLB;
+	else {
+		fprintf(stderr, "Invalid page type:%s\n", page_str);
+		return 1;
+	}
+
+	if (page_mode == PAGE_HUGETLB) {
+		hpage_size = default_hpage_size();
+		if (!hpage_size) {
+			fprintf(stderr, "Failed to get the hugetlb page size\n");
+			return 1;
+		}
+	}
+
 	if (use_cycles) {
 		i = init_cycles();
 		if (i < 0) {
@@ -189,18 +322,32 @@ static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *
 		}
 	}
 
-	size = (size_t)perf_atoll((char *)size_str);
-	size_total = (double)size * nr_loops;
+	str = strdup(size_str);
+	if (!str)
+		return -ENOMEM;
 
-	if ((s64)size <= 0) {
+	for (tok = strtok_r(str, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+		if (nr_sizes == MAX_SIZES) {
+			fprintf(stderr, "Too many sizes, at most %d\n", MAX_SIZES);
+			goto out;
+		}
+		sizes[nr_sizes] = (size_t)perf_atoll(tok);
+		if ((s64)sizes[nr_sizes] <= 0) {
+			fprintf(stderr, "Invalid size:%s\n", tok);
+			goto out;
+		}
+		size_names[nr_sizes++] = tok;
+	}
+	if (!nr_sizes) {
 		fprintf(stderr, "Invalid size:%s\n", size_str);
-		return 1;
+		goto out;
 	}
 
 	if (!strncmp(function_str, "all", 3)) {
 		for (i = 0; info->functions[i].name; i++)
-			__bench_mem_function(info, i, size, size_total);
-		return 0;
+			bench_mem_sizes(info, i, nr_sizes, sizes, size_names);
+		ret = 0;
+		goto out;
 	}
 
 	for (i = 0; info->functions[i].name; i++) {
@@ -215,14 +362,51 @@ static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *
 			printf("\t%s ... %s\n",
 			       info->functions[i].name, info->functions[i].desc);
 		}
-		return 1;
+		goto out;
 	}
 
-	__bench_mem_function(info, i, size, size_total);
+	bench_mem_sizes(info, i, nr_sizes, sizes, size_names);
+	ret = 0;
+out:
+	free(str);
+	return ret;
+}
+
+#ifdef HAVE_ARCH_X86_64_SUPPORT
+/*
+ * Non-temporal store variants, in the spirit of the kernel's
+ * memcpy_flushcache(): the destination bypasses the caches, which pays
+ * off for buffers larger than the LLC or on another node, and costs for
+ * data that is about to be read again.
+ */
+static void *memcpy_movnti(void *dst, const void *src, size_t size)
+{
+	long long *d = dst;
+	const long long *s = src;
+	size_t i;
+
+	for (i = 0; i < size / 8; i++)
+		__builtin_ia32_movnti64(d + i, s[i]);
+	__builtin_ia32_sfence();
+	memcpy(d + i, s + i, size % 8);
 
-	return 0;
+	return dst;
 }
 
+static void *memset_movnti(void *dst, int c, size_t size)
+{
+	long long *d = dst, v = 0x0101010101010101ULL * (unsigned char)c;
+	size_t i;
+
+	for (i = 0; i < size / 8; i++)
+		__builtin_ia32_movnti64(d + i, v);
+	__builtin_ia32_sfence();
+	memset(d + i, c, size % 8);
+
+	return dst;
+}
+#endif
+
 static void memcpy_prefault(memcpy_t fn, size_t size, void *src, void *dst)
 {
 	/* Make sure to always prefault zero pages even if MMAP_THRESH is crossed: */
@@ -278,6 +462,10 @@ struct function memcpy_functions[] = {
 # define MEMCPY_FN(_fn, _name, _desc) {.name = _name, .desc = _desc, .fn.memcpy = _fn},
 # include "mem-memcpy-x86-64-asm-def.h"
 # undef MEMCPY_FN
+
+	{ .name		= "x86-64-movnti",
+	  .desc		= "movnti (non-temporal store) based memcpy()",
+	  .fn.memcpy	= memcpy_movnti },
 #endif
 
 	{ .name = NULL, }
@@ -357,6 +545,10 @@ static const struct function memset_functions[] = {
 # define MEMSET_FN(_fn, _name, _desc) { .name = _name, .desc = _desc, .fn.memset = _fn },
 # include "mem-memset-x86-64-asm-def.h"
 # undef MEMSET_FN
+
+	{ .name		= "x86-64-movnti",
+	  .desc		= "movnti (non-temporal store) based memset()",
+	  .fn.memset	= memset_movnti },
 #endif
 
 	{ .name = NULL, }
@@ -21,6 +21,7 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/time.h>
@@ -128,6 +129,10 @@ struct params {
 	/* Affinity options -C and -N: */
 	char			*cpu_list_str;
 	char			*node_list_str;
+
+	/* Node x node matrix mode: */
+	bool			matrix;
+	const char		*matrix_format;
 };
 
 
@@ -200,6 +205,8 @@ static const struct option options[] = {
 	OPT_BOOLEAN('q', "quiet"	, &quiet,
 		    "quiet mode (do not show any warnings or messages)"),
 	OPT_BOOLEAN('S', "serialize-startup", &p0.serialize_startup,"serialize thread startup"),
+	OPT_BOOLEAN('X', "matrix"	, &p0.matrix,		"measure a cpu node x memory node bandwidth/latency matrix, -T MBs per node pair (default: 256)"),
+	OPT_STRING(0, "matrix_format"	, &p0.matrix_format,	"table|csv|json", "output format of the matrix (default: table)"),
 
 	/* Special option string parsing callbacks: */
         OPT_CALLBACK('C', "cpus", NULL, "cpu[,cpu2,...cpuN]",
@@ -1740,6 +1747,323 @@ static int __bench_numa(const char *name)
 	return 0;
 }
 
+/*
+ * Matrix mode: run a single thread on each node that has CPUs and
+ * measure the memory of each node that has memory - including CPU-less
+ * ones - as well as memory interleaved over all of them. For each pair
+ * we measure sequential and random read bandwidth and the latency of a
+ * dependent pointer chase over randomly ordered cache lines.
+ */
+#define MATRIX_MB_DEFAULT	256
+#define MATRIX_MIN_NS		(200 * NSEC_PER_MSEC)
+#define MATRIX_LINE		64
+#define MATRIX_CHASE_STEPS	(1 << 20)
+
+enum matrix_format {
+	MATRIX_FORMAT_TABLE,
+	MATRIX_FORMAT_CSV,
+	MATRIX_FORMAT_JSON,
+};
+
+struct matrix_res {
+	bool			valid;
+	double			seq_gbs;
+	double			rand_gbs;
+	double			lat_ns;
+};
+
+static volatile u64 matrix_sink;
+
+static u64 matrix_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static bool node_has_memory(int node)
+{
+	return numa_bitmask_isbitset(numa_all_nodes_ptr, node);
+}
+
+static void interleave_memnodes(void)
+{
+	int ret;
+
+	ret = set_mempolicy(MPOL_INTERLEAVE, numa_all_nodes_ptr->maskp,
+			    numa_all_nodes_ptr->size + 1);
+	BUG_ON(ret);
+}
+
+/* Returns bytes per nanosecond, i.e. GB/sec: */
+static double matrix_seq_gbs(u64 *data, long bytes)
+{
+	long words = bytes / sizeof(u64);
+	u64 start, runtime, done = 0, sum = 0;
+	long i;
+
+	start = matrix_time_ns();
+	do {
+		for (i = 0; i < words; i++)
+			sum += data[i];
+		done += bytes;
+		runtime = matrix_time_ns() - start;
+	} while (runtime < MATRIX_MIN_NS);
+
+	matrix_sink += sum;
+
+	return (double)done / runtime;
+}
+
+/* Independent reads of random cache lines, so they can overlap: */
+static double matrix_rand_gbs(u64 *data, long bytes)
+{
+	long lines = bytes / MATRIX_LINE;
+	u64 start, runtime, done = 0, sum = 0;
+	u32 lfsr = 0x5eed;
+	long i;
+
+	start = matrix_time_ns();
+	do {
+		for (i = 0; i < lines; i++) {
+			lfsr = lfsr_32(lfsr);
+			sum += data[(lfsr % lines) * (MATRIX_LINE / sizeof(u64))];
+		}
+		done += lines * MATRIX_LINE;
+		runtime = matrix_time_ns() - start;
+	} while (runtime < MATRIX_MIN_NS);
+
+	matrix_sink += sum;
+
+	return (double)done / runtime;
+}
+
+/*
+ * Link all cache lines of the buffer into a single randomly ordered
+ * cycle (Sattolo's algorithm), so that neither the prefetchers nor the
+ * out-of-order engine can hide the latency of the next load:
+ */
+static void matrix_setup_chase(u64 *data, long bytes)
+{
+	long lines = bytes / MATRIX_LINE;
+	long stride = MATRIX_LINE / sizeof(u64);
+	u32 *perm, tmp;
+	long i, j;
+
+	perm = malloc(lines * sizeof(*perm));
+	BUG_ON(!perm);
+
+	for (i = 0; i < lines; i++)
+		perm[i] = i;
+
+	for (i = lines - 1; i > 0; i--) {
+		j = random() % i;
+		tmp = perm[i];
+		perm[i] = perm[j];
+		perm[j] = tmp;
+	}
+
+	for (i = 0; i < lines; i++)
+		data[i * stride] = (u64)perm[i] * stride;
+
+	free(perm);
+}
+
+static double matrix_chase_ns(u64 *data)
+{
+	u64 start, runtime, steps = 0, idx = 0;
+	long i;
+
+	start = matrix_time_ns();
+	do {
+		for (i = 0; i < MATRIX_CHASE_STEPS; i++)
+			idx = data[idx];
+		steps += MATRIX_CHASE_STEPS;
+		runtime = matrix_time_ns() - start;
+	} while (runtime < MATRIX_MIN_NS);
+
+	matrix_sink += idx;
+
+	return (double)runtime / steps;
+}
+
+/*
+ * Measure memory on @mem_node, or interleaved over all memory nodes if
+ * it is NUMA_NO_NODE, from the CPU we are currently bound to:
+ */
+static void matrix_measure(struct matrix_res *res, int mem_node, long bytes)
+{
+	u64 *data;
+
+	if (mem_node == NUMA_NO_NODE)
+		interleave_memnodes();
+	else
+		bind_to_memnode(mem_node);
+
+	data = (void *)alloc_data(bytes, MAP_PRIVATE, 1, 0, g->p.thp, 0);
+	mempol_restore();
+
+	res->seq_gbs = matrix_seq_gbs(data, bytes);
+	res->rand_gbs = matrix_rand_gbs(data, bytes);
+	matrix_setup_chase(data, bytes);
+	res->lat_ns = matrix_chase_ns(data);
+	res->valid = true;
+
+	free_data(data, bytes);
+}
+
+static const char * const matrix_metrics[] = {
+	"seq-read GB/sec",
+	"rand-read GB/sec",
+	"latency nsecs",
+};
+
+static double matrix_val(const struct matrix_res *res, int metric)
+{
+	switch (metric) {
+	case 0:  return res->seq_gbs;
+	case 1:  return res->rand_gbs;
+	default: return res->lat_ns;
+	}
+}
+
+static void matrix_print_table(struct matrix_res *res, int nr_nodes)
+{
+	int metric, cpu_node, mem_node;
+	struct matrix_res *r;
+
+	for (metric = 0; metric < (int)ARRAY_SIZE(matrix_metrics); metric++) {
+		printf("\n # %s, cpu node (rows) x memory node (columns):\n", matrix_metrics[metric]);
+		printf(" %8s", "");
+		for (mem_node = 0; mem_node < nr_nodes; mem_node++) {
+			if (node_has_memory(mem_node))
+				printf(" %9s%-3d", "node", mem_node);
+		}
+		printf(" %12s\n", "interleave");
+
+		for (cpu_node = 0; cpu_node < nr_nodes; cpu_node++) {
+			r = res + cpu_node * (nr_nodes + 1);
+			if (!r[nr_nodes].valid)
+				continue;
+			printf(" node%-4d", cpu_node);
+			for (mem_node = 0; mem_node <= nr_nodes; mem_node++) {
+				if (r[mem_node].valid)
+					printf(" %12.3f", matrix_val(&r[mem_node], metric));
+			}
+			printf("\n");
+		}
+	}
+}
+
+static void matrix_print_list(struct matrix_res *res, int nr_nodes, int fmt)
+{
+	int cpu_node, mem_node;
+	struct matrix_res *r;
+	char mem[16];
+	bool first = true;
+
+	if (fmt == MATRIX_FORMAT_CSV)
+		printf("cpu_node,mem_node,seq_read_gbs,rand_read_gbs,latency_ns\n");
+	else
+		printf("{\"mb\": %.0f, \"thp\": %d, \"results\": [\n", g->p.mb_thread, g->p.thp);
+
+	for (cpu_node = 0; cpu_node < nr_nodes; cpu_node++) {
+		for (mem_node = 0; mem_node <= nr_nodes; mem_node++) {
+			r = res + cpu_node * (nr_nodes + 1) + mem_node;
+			if (!r->valid)
+				continue;
+
+			if (mem_node == nr_nodes)
+				snprintf(mem, sizeof(mem), fmt == MATRIX_FORMAT_CSV ? "interleave" : "\"interleave\"");
+			else
+				snprintf(mem, sizeof(mem), "%d", mem_node);
+
+			if (fmt == MATRIX_FORMAT_CSV) {
+				printf("%d,%s,%.3f,%.3f,%.3f\n", cpu_node, mem,
+				       r->seq_gbs, r->rand_gbs, r->lat_ns);
+			} else {
+				printf("%s  {\"cpu_node\": %d, \"mem_node\": %s, \"seq_read_gbs\": %.3f, "
+				       "\"rand_read_gbs\": %.3f, \"latency_ns\": %.3f}",
+				       first ? "" : ",\n", cpu_node, mem,
+				       r->seq_gbs, r->rand_gbs, r->lat_ns);
+			}
+			first = false;
+		}
+	}
+
+	if (fmt == MATRIX_FORMAT_JSON)
+		printf("\n]}\n");
+}
+
+static int bench_numa_matrix(void)
+{
+	int nr_nodes, cpu_node, mem_node, fmt;
+	struct matrix_res *res;
+	cpu_set_t *orig_mask;
+	long bytes;
+	int ret = -1;
+
+	g = (void *)alloc_data(sizeof(*g), MAP_SHARED, 1, 0, 0 /* THP */, 0);
+	g->p = p0;
+	g->p.nr_cpus = numa_num_configured_cpus();
+	g->p.nr_nodes = numa_max_node() + 1;
+	nr_nodes = g->p.nr_nodes;
+
+	if (quiet && !g->p.show_details)
+		g->p.show_details = -1;
+
+	if (!g->p.matrix_format || !strcmp(g->p.matrix_format, "table"))
+		fmt = MATRIX_FORMAT_TABLE;
+	else if (!strcmp(g->p.matrix_format, "csv"))
+		fmt = MATRIX_FORMAT_CSV;
+	else if (!strcmp(g->p.matrix_format, "json"))
+		fmt = MATRIX_FORMAT_JSON;
+	else
+		goto out;
+
+	g->p.mb_thread = g->p.mb_thread_str ? atof(g->p.mb_thread_str) : MATRIX_MB_DEFAULT;
+	bytes = g->p.mb_thread * 1024L * 1024L;
+	if (bytes < MATRIX_LINE || bytes / MATRIX_LINE > UINT32_MAX)
+		goto out;
+
+	res = calloc(nr_nodes * (nr_nodes + 1), sizeof(*res));
+	BUG_ON(!res);
+
+	for (cpu_node = 0; cpu_node < nr_nodes; cpu_node++) {
+		if (!is_node_present(cpu_node) || !node_has_cpus(cpu_node))
+			continue;
+
+		orig_mask = bind_to_node(cpu_node);
+
+		for (mem_node = 0; mem_node <= nr_nodes; mem_node++) {
+			if (mem_node < nr_nodes && !node_has_memory(mem_node))
+				continue;
+
+			dprintf("# measuring cpu node %d, memory node %d\n", cpu_node, mem_node);
+			matrix_measure(res + cpu_node * (nr_nodes + 1) + mem_node,
+				       mem_node < nr_nodes ? mem_node : NUMA_NO_NODE, bytes);
+		}
+
+		bind_to_cpumask(orig_mask);
+		CPU_FREE(orig_mask);
+	}
+
+	if (fmt == MATRIX_FORMAT_TABLE)
+		matrix_print_table(res, nr_nodes);
+	else
+		matrix_print_list(res, nr_nodes, fmt);
+
+	free(res);
+	ret = 0;
+out:
+	free_data(g, sizeof(*g));
+	g = NULL;
+
+	return ret;
+}
+
 #define MAX_ARGS 50
 
 static int command_size(const char **argv)
@@ -1915,6 +2239,12 @@ int bench_numa(int argc, const char **argv)
 	if (argc)
 		goto err;
 
+	if (p0.matrix) {
+		if (bench_numa_matrix())
+			goto err;
+		return 0;
+	}
+
 	if (p0.run_all)
 		return bench_all();
 
@@ -24,9 +24,14 @@
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
 #include <poll.h>
 #include <limits.h>
+#include <math.h>
+#include <time.h>
 #include <err.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
 #include <linux/time64.h>
 
 #define DATASIZE 100
@@ -36,6 +41,14 @@ static unsigned int nr_loops = 100;
 static bool thread_mode = false;
 static unsigned int num_groups = 10;
 
+/* RPC mode: */
+static bool rpc_mode = false;
+static unsigned int rpc_fanout = 1;
+static unsigned int rpc_pool = 4;
+static unsigned int rpc_service_us = 10;
+static unsigned int rpc_think_us = 0;
+static const char *rpc_dist_str = "const";
+
 struct sender_context {
 	unsigned int num_fds;
 	int ready_out;
@@ -243,6 +256,330 @@ static unsigned int group(pthread_t *pth,
 	return num_fds * 2;
 }
 
+/*
+ * RPC mode: in each group num_fds clients issue nr_loops requests, each
+ * sent to rpc_fanout connections at once, and wait for all the replies
+ * before thinking for rpc_think_us and issuing the next one. The
+ * connections of a group are served by a pool of rpc_pool server
+ * threads sharing one epoll instance; each request keeps a server busy
+ * for a service time drawn from the chosen distribution.
+ *
+ * Besides the request latency as seen by the client, the servers record
+ * the time from a request being written to a server thread running with
+ * it: the wakeup-to-run latency, including the epoll dispatch.
+ */
+enum rpc_dist {
+	RPC_DIST_CONST,
+	RPC_DIST_EXP,
+};
+
+struct rpc_msg {
+	u64 sent_ns;
+	u64 service_ns;
+};
+
+struct rpc_group {
+	int epfd;
+	int stopfds[2];
+	pthread_t *servers;
+};
+
+struct rpc_client {
+	int *fds;
+	unsigned int seed;
+	u64 *lat;
+};
+
+static enum rpc_dist rpc_dist;
+static u64 *rpc_wakeup_lat;
+static unsigned long rpc_nr_wakeups;
+
+static u64 rpc_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static u64 rpc_service_ns(unsigned int *seed)
+{
+	u64 mean = (u64)rpc_service_us * NSEC_PER_USEC;
+	double u;
+
+	if (rpc_dist == RPC_DIST_CONST)
+		return mean;
+
+	/* Exponential, by inverse transform of a uniform (0, 1] sample: */
+	u = (rand_r(seed) + 1.0) / (RAND_MAX + 1.0);
+
+	return -log(u) * mean;
+}
+
+/* Connections are SOCK_SEQPACKET, so messages are never split: */
+static void rpc_xfer(int fd, struct rpc_msg *msg, bool wr)
+{
+	ssize_t ret;
+
+	if (wr)
+		ret = write(fd, msg, sizeof(*msg));
+	else
+		ret = read(fd, msg, sizeof(*msg));
+	if (ret != sizeof(*msg))
+		err(EXIT_FAILURE, wr ? "RPC: write" : "RPC: read");
+}
+
+static void *rpc_server(struct rpc_group *grp)
+{
+	struct epoll_event ev;
+	struct rpc_msg msg;
+	unsigned long idx;
+	u64 now, end;
+	ssize_t ret;
+	int fd;
+
+	for (;;) {
+		if (epoll_wait(grp->epfd, &ev, 1, -1) != 1) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "RPC: epoll_wait");
+		}
+
+		fd = ev.data.fd;
+		if (fd == grp->stopfds[0])
+			break;
+
+		ret = read(fd, &msg, sizeof(msg));
+		now = rpc_now_ns();
+		if (ret == 0) {
+			/* The client is done with this connection. */
+			close(fd);
+			continue;
+		}
+		if (ret != sizeof(msg))
+			err(EXIT_FAILURE, "RPC: server read");
+
+		idx = __atomic_fetch_add(&rpc_nr_wakeups, 1, __ATOMIC_RELAXED);
+		rpc_wakeup_lat[idx] = now - msg.sent_ns;
+
+		/* Do the work, on the CPU: */
+		end = now + msg.service_ns;
+		while (rpc_now_ns() < end)
+			;
+
+		msg.sent_ns = rpc_now_ns();
+		rpc_xfer(fd, &msg, true);
+
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		if (epoll_ctl(grp->epfd, EPOLL_CTL_MOD, fd, &ev))
+			err(EXIT_FAILURE, "RPC: epoll_ctl");
+	}
+
+	return NULL;
+}
+
+static void *rpc_client(struct rpc_client *cl, int ready_out, int wakefd)
+{
+	struct rpc_msg msg;
+	unsigned int i, j;
+	u64 start;
+
+	ready(ready_out, wakefd);
+
+	for (i = 0; i < nr_loops; i++) {
+		if (rpc_think_us)
+			usleep(rpc_think_us);
+
+		start = rpc_now_ns();
+		for (j = 0; j < rpc_fanout; j++) {
+			msg.service_ns = rpc_service_ns(&cl->seed);
+			msg.sent_ns = rpc_now_ns();
+			rpc_xfer(cl->fds[j], &msg, true);
+		}
+		for (j = 0; j < rpc_fanout; j++)
+			rpc_xfer(cl->fds[j], &msg, false);
+
+		cl->lat[i] = rpc_now_ns() - start;
+	}
+
+	for (j = 0; j < rpc_fanout; j++)
+		close(cl->fds[j]);
+
+	return NULL;
+}
+
+struct rpc_client_arg {
+	struct rpc_client *cl;
+	int ready_out;
+	int wakefd;
+};
+
+static void *rpc_client_thread(void *arg)
+{
+	struct rpc_client_arg *a = arg;
+
+	return rpc_client(a->cl, a->ready_out, a->wakefd);
+}
+
+static int bench_sched_rpc(void)
+{
+	unsigned int nr_clients = num_groups * 20, i, j, c;
+	struct rpc_client_arg *args;
+	struct rpc_client *clients;
+	struct rpc_group *groups;
+	struct timeval start, stop, diff;
+	int readyfds[2], wakefds[2];
+	struct epoll_event ev;
+	pthread_t *pth;
+	u64 *lat;
+	char dummy;
+
+	if (!strcmp(rpc_dist_str, "const"))
+		rpc_dist = RPC_DIST_CONST;
+	else if (!strcmp(rpc_dist_str, "exp"))
+		rpc_dist = RPC_DIST_EXP;
+	else
+		return -1;
+
+	if (!rpc_fanout || !rpc_pool || !nr_loops)
+		return -1;
+
+	groups = calloc(num_groups, sizeof(*groups));
+	clients = calloc(nr_clients, sizeof(*clients));
+	args = calloc(nr_clients, sizeof(*args));
+	pth = calloc(nr_clients, sizeof(*pth));
+	lat = calloc((size_t)nr_clients * nr_loops, sizeof(*lat));
+	rpc_wakeup_lat = calloc((size_t)nr_clients * nr_loops * rpc_fanout,
+				sizeof(*rpc_wakeup_lat));
+	if (!groups || !clients || !args || !pth || !lat || !rpc_wakeup_lat)
+		err(EXIT_FAILURE, "RPC: calloc");
+
+	/* Threads share the process' fds, so these always are threads: */
+	thread_mode = true;
+
+	fdpair(readyfds);
+	fdpair(wakefds);
+
+	for (i = 0; i < num_groups; i++) {
+		struct rpc_group *grp = &groups[i];
+
+		grp->epfd = epoll_create(1);
+		if (grp->epfd < 0)
+			err(EXIT_FAILURE, "RPC: epoll_create");
+
+		/* Level triggered, so that it stops all servers: */
+		if (pipe(grp->stopfds))
+			err(EXIT_FAILURE, "RPC: pipe");
+		ev.events = EPOLLIN;
+		ev.data.fd = grp->stopfds[0];
+		if (epoll_ctl(grp->epfd, EPOLL_CTL_ADD, grp->stopfds[0], &ev))
+			err(EXIT_FAILURE, "RPC: epoll_ctl");
+
+		for (j = 0; j < 20; j++) {
+			struct rpc_client *cl = &clients[i * 20 + j];
+
+			cl->fds = calloc(rpc_fanout, sizeof(int));
+			if (!cl->fds)
+				err(EXIT_FAILURE, "RPC: calloc");
+			cl->seed = i * 20 + j;
+			cl->lat = lat + (size_t)(i * 20 + j) * nr_loops;
+
+			for (c = 0; c < rpc_fanout; c++) {
+				int fds[2];
+
+				if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds))
+					err(EXIT_FAILURE, "RPC: socketpair");
+				cl->fds[c] = fds[0];
+				ev.events = EPOLLIN | EPOLLONESHOT;
+				ev.data.fd = fds[1];
+				if (epoll_ctl(grp->epfd, EPOLL_CTL_ADD, fds[1], &ev))
+					err(EXIT_FAILURE, "RPC: epoll_ctl");
+			}
+		}
+
+		grp->servers = calloc(rpc_pool, sizeof(pthread_t));
+		if (!grp->servers)
+			err(EXIT_FAILURE, "RPC: calloc");
+		for (j = 0; j < rpc_pool; j++)
+			grp->servers[j] = create_worker(grp, (void *)rpc_server);
+	}
+
+	for (i = 0; i < nr_clients; i++) {
+		args[i].cl = &clients[i];
+		args[i].ready_out = readyfds[1];
+		args[i].wakefd = wakefds[0];
+		pth[i] = create_worker(&args[i], rpc_client_thread);
+	}
+
+	for (i = 0; i < nr_clients; i++)
+		if (read(readyfds[0], &dummy, 1) != 1)
+			err(EXIT_FAILURE, "Reading for readyfds");
+
+	gettimeofday(&start, NULL);
+
+	if (write(wakefds[1], &dummy, 1) != 1)
+		err(EXIT_FAILURE, "Writing to start them");
+
+	for (i = 0; i < nr_clients; i++)
+		reap_worker(pth[i]);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	for (i = 0; i < num_groups; i++) {
+		if (write(groups[i].stopfds[1], &dummy, 1) != 1)
+			err(EXIT_FAILURE, "RPC: stop write");
+		for (j = 0; j < rpc_pool; j++)
+			reap_worker(groups[i].servers[j]);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d groups of 20 client threads and %d server threads\n",
+		       num_groups, rpc_pool);
+		printf("# fan-out %u, %s service time %u usecs, think time %u usecs\n\n",
+		       rpc_fanout, rpc_dist_str, rpc_service_us, rpc_think_us);
+		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
+		       (unsigned long) diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+		printf(" %14s: %.0f [requests/sec]\n", "Throughput",
+		       (double)nr_clients * nr_loops /
+		       (diff.tv_sec + diff.tv_usec / (double)USEC_PER_SEC));
+		bench_print_lat_pct("Request", lat,
+				    (unsigned long)nr_clients * nr_loops);
+		bench_print_lat_pct("Wakeup-to-run", rpc_wakeup_lat,
+				    rpc_nr_wakeups);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n", (unsigned long) diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	for (i = 0; i < num_groups; i++) {
+		close(groups[i].epfd);
+		close(groups[i].stopfds[0]);
+		close(groups[i].stopfds[1]);
+		free(groups[i].servers);
+	}
+	for (i = 0; i < nr_clients; i++)
+		free(clients[i].fds);
+	free(rpc_wakeup_lat);
+	free(lat);
+	free(pth);
+	free(args);
+	free(clients);
+	free(groups);
+
+	return 0;
+}
+
 static const struct option options[] = {
 	OPT_BOOLEAN('p', "pipe", &use_pipes,
 		    "Use pipe() instead of socketpair()"),
@@ -250,6 +587,13 @@ static const struct option options[] = {
 		    "Be multi thread instead of multi process"),
 	OPT_UINTEGER('g', "group", &num_groups, "Specify number of groups"),
 	OPT_UINTEGER('l', "nr_loops", &nr_loops, "Specify the number of loops to run (default: 100)"),
+	OPT_BOOLEAN('r', "rpc", &rpc_mode,
+		    "Request/response mode: clients wait for replies from a pool of epoll servers"),
+	OPT_UINTEGER('f', "fanout", &rpc_fanout, "RPC: servers each request is sent to (default: 1)"),
+	OPT_UINTEGER('P', "pool", &rpc_pool, "RPC: server threads per group (default: 4)"),
+	OPT_UINTEGER('s', "service", &rpc_service_us, "RPC: mean service time in usecs (default: 10)"),
+	OPT_STRING('d', "dist", &rpc_dist_str, "const|exp", "RPC: service time distribution (default: const)"),
+	OPT_UINTEGER('T', "think", &rpc_think_us, "RPC: client think time in usecs (default: 0)"),
 	OPT_END()
 };
 
@@ -270,6 +614,12 @@ int bench_sched_messaging(int argc, const char **argv)
 	argc = parse_options(argc, argv, options,
 			     bench_sched_message_usage, 0);
 
+	if (rpc_mode) {
+		if (bench_sched_rpc())
+			usage_with_options(bench_sched_message_usage, options);
+		return 0;
+	}
+
 	pth_tab = malloc(num_fds * 2 * num_groups * sizeof(pthread_t));
 	if (!pth_tab)
 		err(EXIT_FAILURE, "main:malloc()");
@@ -21,6 +21,13 @@ static char *directions[] = {
 	"FROM_DEVICE",
 };
 
+static char *modes[] = {
+	"SINGLE",
+	"SG",
+	"ALLOC",
+	"CROSS_CPU",
+};
+
 int main(int argc, char **argv)
 {
 	struct map_benchmark map;
@@ -31,11 +38,13 @@ int main(int argc, char **argv)
 	int bits = 32, xdelay = 0, dir = DMA_MAP_BIDIRECTIONAL;
 	/* default granule 1 PAGESIZE */
 	int granule = 1;
+	/* default dma_map_single(), one segment for dma_map_sg() */
+	int mode = DMA_MAP_BENCH_SINGLE, nr_segs = 1;
 
 	int cmd = DMA_MAP_BENCHMARK;
 	char *p;
 
-	while ((opt = getopt(argc, argv, "t:s:n:b:d:x:g:")) != -1) {
+	while ((opt = getopt(argc, argv, "t:s:n:b:d:x:g:m:S:")) != -1) {
 		switch (opt) {
 		case 't':
 			threads = atoi(optarg);
@@ -58,6 +67,12 @@ int main(int argc, char **argv)
 		case 'g':
 			granule = atoi(optarg);
 			break;
+		case 'm':
+			mode = atoi(optarg);
+			break;
+		case 'S':
+			nr_segs = atoi(optarg);
+			break;
 		default:
 			return -1;
 		}
@@ -93,11 +108,25 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
-	if (granule < 1 || granule > 1024) {
+	if (granule < 1 || granule > DMA_MAP_MAX_GRANULE) {
 		fprintf(stderr, "invalid granule size\n");
 		exit(1);
 	}
 
+	if (mode < DMA_MAP_BENCH_SINGLE || mode > DMA_MAP_BENCH_CROSS_CPU) {
+		fprintf(stderr, "invalid mode, must be in 0-%d\n",
+			DMA_MAP_BENCH_CROSS_CPU);
+		exit(1);
+	}
+
+	if (mode == DMA_MAP_BENCH_SG &&
+	    (nr_segs < 1 || nr_segs > DMA_MAP_MAX_SEGS ||
+	     nr_segs * granule > DMA_MAP_MAX_GRANULE)) {
+		fprintf(stderr, "invalid number of segments, must be in 1-%d and at most %d pages in total\n",
+			DMA_MAP_MAX_SEGS, DMA_MAP_MAX_GRANULE);
+		exit(1);
+	}
+
 	fd = open("/sys/kernel/debug/dma_map_benchmark", O_RDWR);
 	if (fd == -1) {
 		perror("open");
@@ -112,18 +141,30 @@ int main(int argc, char **argv)
 	map.dma_dir = dir;
 	map.dma_trans_ns = xdelay;
 	map.granule = granule;
+	map.mode = mode;
+	map.nr_segs = nr_segs;
 
 	if (ioctl(fd, cmd, &map)) {
 		perror("ioctl");
 		exit(1);
 	}
 
-	printf("dma mapping benchmark: threads:%d seconds:%d node:%d dir:%s granule: %d\n",
-			threads, seconds, node, dir[directions], granule);
+	printf("dma mapping benchmark: threads:%d seconds:%d node:%d dir:%s granule: %d mode:%s",
+			threads, seconds, node, dir[directions], granule,
+			modes[mode]);
+	if (mode == DMA_MAP_BENCH_SG)
+		printf(" segments:%d", nr_segs);
+	printf("\n");
 	printf("average map latency(us):%.1f standard deviation:%.1f\n",
 			map.avg_map_100ns/10.0, map.map_stddev/10.0);
 	printf("average unmap latency(us):%.1f standard deviation:%.1f\n",
 			map.avg_unmap_100ns/10.0, map.unmap_stddev/10.0);
+	printf("map latency(us) p50:%.3f p99:%.3f p999:%.3f\n",
+			map.map_p50_ns/1000.0, map.map_p99_ns/1000.0,
+			map.map_p999_ns/1000.0);
+	printf("unmap latency(us) p50:%.3f p99:%.3f p999:%.3f\n",
+			map.unmap_p50_ns/1000.0, map.unmap_p99_ns/1000.0,
+			map.unmap_p999_ns/1000.0);
 
 	return 0;
 }
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * futex_wakev() test: wake waiters on a list of futexes in one call.
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "futextest.h"
+#include "futex2test.h"
+#include "logging.h"
+
+#define TEST_NAME "futex-wakev"
+#define WAKE_WAIT_US 10000
+#define NR_FUTEXES 30
+static struct futex_waitv wakev[NR_FUTEXES];
+u_int32_t futexes[NR_FUTEXES] = {0};
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+void *waiterfn(void *arg)
+{
+	struct timespec to = { .tv_sec = 1 };
+
+	futex_wait(arg, 0, &to, FUTEX_PRIVATE_FLAG);
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t waiters[NR_FUTEXES];
+	int res, ret = RET_PASS, woken = 0, tries, c, i;
+
+	while ((c = getopt(argc, argv, "cht:v:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	ksft_print_header();
+	ksft_set_plan(2);
+	ksft_print_msg("%s: Test FUTEX_WAKEV\n", basename(argv[0]));
+
+#ifndef __NR_futex_wakev
+	ksft_exit_skip("futex_wakev not supported by the headers\n");
+#endif
+
+	for (i = 0; i < NR_FUTEXES; i++) {
+		wakev[i].uaddr = (uintptr_t)&futexes[i];
+		wakev[i].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+		wakev[i].val = 1;
+		wakev[i].__reserved = 0;
+
+		if (pthread_create(&waiters[i], NULL, waiterfn, &futexes[i]))
+			error("pthread_create failed\n", errno);
+	}
+
+	usleep(WAKE_WAIT_US);
+
+	/* Some waiters might not have queued themselves yet, retry. */
+	for (tries = 0; tries < 10 && woken < NR_FUTEXES; tries++) {
+		res = futex_wakev(wakev, NR_FUTEXES, 0);
+		if (res < 0)
+			break;
+		woken += res;
+		usleep(WAKE_WAIT_US);
+	}
+
+	for (i = 0; i < NR_FUTEXES; i++)
+		pthread_join(waiters[i], NULL);
+
+	if (res < 0) {
+		ksft_test_result_fail("futex_wakev returned: %d %s\n",
+				      errno, strerror(errno));
+		ret = RET_FAIL;
+	} else if (woken != NR_FUTEXES) {
+		ksft_test_result_fail("futex_wakev woke %d, expecting %d\n",
+				      woken, NR_FUTEXES);
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("futex_wakev private succeeds\n");
+	}
+
+	/* Invalid flags */
+	wakev[0].flags = FUTEX_PRIVATE_FLAG;
+	res = futex_wakev(wakev, NR_FUTEXES, 0);
+	if (res != -1 || errno != EINVAL) {
+		ksft_test_result_fail("futex_wakev with bad flags returned: %d %s\n",
+				      res, strerror(errno));
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("futex_wakev without FUTEX_32 fails\n");
+	}
+
+	ksft_print_cnts();
+	return ret;
+}
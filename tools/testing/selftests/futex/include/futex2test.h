@@ -20,3 +20,15 @@ static inline int futex_waitv(volatile struct futex_waitv *waiters, unsigned lon
 {
 	return syscall(__NR_futex_waitv, waiters, nr_waiters, flags, timo, clockid);
 }
+
+/**
+ * futex_wakev - Wake waiters at multiple futexes
+ * @waiters:    Array of futexes, val is the number of waiters to wake
+ * @nr_waiters: Length of waiters array
+ * @flags: Operation flags
+ */
+static inline int futex_wakev(volatile struct futex_waitv *waiters, unsigned long nr_waiters,
+			      unsigned long flags)
+{
+	return syscall(__NR_futex_wakev, waiters, nr_waiters, flags);
+}
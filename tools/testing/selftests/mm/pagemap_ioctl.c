@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for the PAGEMAP_SCAN ioctl on /proc/self/pagemap.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fs.h>
+#include "../kselftest.h"
+#include "vm_util.h"
+
+#define PAGEMAP_FILE_PATH "/proc/self/pagemap"
+#define NR_PAGES 10
+#define NR_REGIONS 8
+
+static int pagemap_fd;
+static int pagesize;
+
+static long pagemap_scan(char *start, char *end, struct page_region *vec,
+			 unsigned long vec_len, uint64_t max_pages,
+			 uint64_t inverted, uint64_t mask, uint64_t anyof,
+			 uint64_t return_mask, char **walk_end)
+{
+	struct pm_scan_arg arg = {
+		.size = sizeof(arg),
+		.start = (uintptr_t)start,
+		.end = (uintptr_t)end,
+		.vec = (uintptr_t)vec,
+		.vec_len = vec_len,
+		.max_pages = max_pages,
+		.category_inverted = inverted,
+		.category_mask = mask,
+		.category_anyof_mask = anyof,
+		.return_mask = return_mask,
+	};
+	long ret;
+
+	ret = ioctl(pagemap_fd, PAGEMAP_SCAN, &arg);
+	if (walk_end)
+		*walk_end = (char *)(uintptr_t)arg.walk_end;
+	return ret;
+}
+
+static bool region_is(struct page_region *r, char *map, int first, int last)
+{
+	return r->start == (uintptr_t)(map + first * pagesize) &&
+	       r->end == (uintptr_t)(map + last * pagesize);
+}
+
+/* Pages 0-3 and 6 of the map are populated, the others are not */
+static char *map_test_area(void)
+{
+	char *map;
+	int i;
+
+	map = mmap(NULL, NR_PAGES * pagesize, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		ksft_exit_fail_msg("mmap failed\n");
+
+	/* Keep THP from populating the holes */
+	madvise(map, NR_PAGES * pagesize, MADV_NOHUGEPAGE);
+
+	for (i = 0; i < 4; i++)
+		map[i * pagesize] = 1;
+	map[6 * pagesize] = 1;
+
+	return map;
+}
+
+static void test_invalid_args(void)
+{
+	char *map = map_test_area(), *end = map + NR_PAGES * pagesize;
+	struct page_region vec[NR_REGIONS];
+	struct pm_scan_arg arg = {
+		.size = sizeof(arg) - 8,
+		.start = (uintptr_t)map,
+		.end = (uintptr_t)end,
+		.vec = (uintptr_t)vec,
+		.vec_len = NR_REGIONS,
+		.return_mask = PAGE_IS_PRESENT,
+	};
+	bool ok = true;
+
+	if (ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) != -1 || errno != EINVAL)
+		ok = false;
+
+	arg.size = sizeof(arg);
+	arg.flags = PM_SCAN_WP_MATCHING;
+	if (ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) != -1 || errno != EOPNOTSUPP)
+		ok = false;
+
+	arg.flags = 0;
+	arg.category_mask = PAGE_IS_HUGE;
+	if (ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) != -1 || errno != EINVAL)
+		ok = false;
+
+	arg.category_mask = 0;
+	arg.start = (uintptr_t)map + 1;
+	if (ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) != -1 || errno != EINVAL)
+		ok = false;
+
+	munmap(map, NR_PAGES * pagesize);
+	ksft_test_result(ok, "Test %s\n", __func__);
+}
+
+static void test_present(void)
+{
+	char *map = map_test_area(), *end = map + NR_PAGES * pagesize;
+	struct page_region vec[NR_REGIONS];
+	char *walk_end;
+	long ret;
+
+	ret = pagemap_scan(map, end, vec, NR_REGIONS, 0, 0, PAGE_IS_PRESENT,
+			   0, PAGE_IS_PRESENT, &walk_end);
+	ksft_test_result(ret == 2 && region_is(&vec[0], map, 0, 4) &&
+			 region_is(&vec[1], map, 6, 7) &&
+			 vec[0].categories == PAGE_IS_PRESENT &&
+			 walk_end == end,
+			 "Test %s\n", __func__);
+
+	ret = pagemap_scan(map, end, vec, NR_REGIONS, 0, PAGE_IS_PRESENT,
+			   PAGE_IS_PRESENT, 0, PAGE_IS_PRESENT, NULL);
+	ksft_test_result(ret == 2 && region_is(&vec[0], map, 4, 6) &&
+			 region_is(&vec[1], map, 7, NR_PAGES) &&
+			 vec[0].categories == 0,
+			 "Test %s inverted\n", __func__);
+
+	ret = pagemap_scan(map, end, vec, NR_REGIONS, 0, 0, 0,
+			   PAGE_IS_PRESENT | PAGE_IS_SWAPPED, PAGE_IS_PRESENT,
+			   NULL);
+	ksft_test_result(ret == 2 && region_is(&vec[0], map, 0, 4) &&
+			 region_is(&vec[1], map, 6, 7),
+			 "Test %s anyof\n", __func__);
+
+	munmap(map, NR_PAGES * pagesize);
+}
+
+static void test_resume(void)
+{
+	char *map = map_test_area(), *end = map + NR_PAGES * pagesize;
+	struct page_region vec[NR_REGIONS];
+	char *walk_end;
+	long ret;
+
+	/* The vector fills up at the start of the second region */
+	ret = pagemap_scan(map, end, vec, 1, 0, 0, PAGE_IS_PRESENT, 0,
+			   PAGE_IS_PRESENT, &walk_end);
+	ksft_test_result(ret == 1 && region_is(&vec[0], map, 0, 4) &&
+			 walk_end == map + 6 * pagesize,
+			 "Test %s full vector\n", __func__);
+
+	ret = pagemap_scan(walk_end, end, vec, 1, 0, 0, PAGE_IS_PRESENT, 0,
+			   PAGE_IS_PRESENT, &walk_end);
+	ksft_test_result(ret == 1 && region_is(&vec[0], map, 6, 7) &&
+			 walk_end == end,
+			 "Test %s resumed walk\n", __func__);
+
+	ret = pagemap_scan(map, end, vec, NR_REGIONS, 2, 0, PAGE_IS_PRESENT,
+			   0, PAGE_IS_PRESENT, &walk_end);
+	ksft_test_result(ret == 1 && region_is(&vec[0], map, 0, 2) &&
+			 walk_end == map + 2 * pagesize,
+			 "Test %s max_pages\n", __func__);
+
+	munmap(map, NR_PAGES * pagesize);
+}
+
+static void test_soft_dirty(void)
+{
+	char *map = map_test_area(), *end = map + NR_PAGES * pagesize;
+	struct page_region vec[NR_REGIONS];
+	long ret;
+
+	clear_softdirty();
+	map[2 * pagesize]++;
+
+	ret = pagemap_scan(map, end, vec, NR_REGIONS, 0, 0,
+			   PAGE_IS_SOFT_DIRTY, 0, PAGE_IS_SOFT_DIRTY, NULL);
+	if (!ret)
+		ksft_test_result_skip("Test %s no soft-dirty tracking\n",
+				      __func__);
+	else
+		ksft_test_result(ret == 1 && region_is(&vec[0], map, 2, 3),
+				 "Test %s\n", __func__);
+
+	munmap(map, NR_PAGES * pagesize);
+}
+
+int main(int argc, char **argv)
+{
+	ksft_print_header();
+
+	pagemap_fd = open(PAGEMAP_FILE_PATH, O_RDONLY);
+	if (pagemap_fd < 0)
+		ksft_exit_fail_msg("Failed to open %s\n", PAGEMAP_FILE_PATH);
+
+	pagesize = getpagesize();
+
+	if (ioctl(pagemap_fd, PAGEMAP_SCAN, NULL) == -1 && errno == ENOTTY)
+		ksft_exit_skip("PAGEMAP_SCAN is not supported\n");
+
+	ksft_set_plan(8);
+
+	test_invalid_args();
+	test_present();
+	test_resume();
+	test_soft_dirty();
+
+	close(pagemap_fd);
+
+	return ksft_exit_pass();
+}
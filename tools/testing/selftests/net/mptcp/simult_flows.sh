@@ -271,6 +271,79 @@ run_test()
 	fi
 }
 
+# switch to the roundrobin scheduler, after checking that unknown
+# schedulers are rejected
+run_sched_test()
+{
+	if ! ip netns exec $ns1 sysctl -q net.mptcp.scheduler=default >/dev/null 2>&1; then
+		echo "SKIP: packet schedulers not supported"
+		return
+	fi
+
+	printf "%-60s" "unknown scheduler rejected"
+	if ip netns exec $ns1 sysctl -q net.mptcp.scheduler=nonexistent >/dev/null 2>&1; then
+		echo " [ fail ]"
+		ret=1
+		[ $bail -eq 0 ] || exit $ret
+	else
+		echo "[ OK ]"
+	fi
+
+	ip netns exec $ns1 sysctl -q net.mptcp.scheduler=roundrobin
+	ip netns exec $ns3 sysctl -q net.mptcp.scheduler=roundrobin
+	run_test 10 10 0 0 "balanced bwidth, roundrobin scheduler"
+	ip netns exec $ns1 sysctl -q net.mptcp.scheduler=default
+	ip netns exec $ns3 sysctl -q net.mptcp.scheduler=default
+}
+
+# send a small file each way with one lossy path in redundant mode, and
+# check that data was duplicated on the other subflow
+run_redundant_test()
+{
+	local budget=1048576
+	local lret
+	local count
+	local dev
+
+	if ! ip netns exec $ns1 sysctl -q net.mptcp.redundant_budget=0 >/dev/null 2>&1; then
+		echo "SKIP: redundant mode not supported"
+		return
+	fi
+
+	for dev in ns1eth1 ns1eth2; do
+		tc -n $ns1 qdisc del dev $dev root >/dev/null 2>&1
+	done
+	for dev in ns2eth1 ns2eth2; do
+		tc -n $ns2 qdisc del dev $dev root >/dev/null 2>&1
+	done
+	tc -n $ns1 qdisc add dev ns1eth1 root netem rate 10mbit loss 10%
+	tc -n $ns1 qdisc add dev ns1eth2 root netem rate 10mbit
+	tc -n $ns2 qdisc add dev ns2eth1 root netem rate 10mbit loss 10%
+	tc -n $ns2 qdisc add dev ns2eth2 root netem rate 10mbit
+
+	ip netns exec $ns1 sysctl -q net.mptcp.redundant_budget=$budget
+	ip netns exec $ns3 sysctl -q net.mptcp.redundant_budget=$budget
+
+	printf "%-60s" "redundant mode with a lossy path"
+	do_transfer $small $small $((2000 + slack))
+	lret=$?
+
+	count=$(ip netns exec $ns1 nstat -as MPTcpExtMPTCPRedundant | \
+		awk '/MPTcpExtMPTCPRedundant/ {print $2}')
+	if [ $lret -eq 0 ] && [ "${count:-0}" -eq 0 ]; then
+		echo "no redundant copies sent" 1>&2
+		lret=1
+	fi
+
+	ip netns exec $ns1 sysctl -q net.mptcp.redundant_budget=0
+	ip netns exec $ns3 sysctl -q net.mptcp.redundant_budget=0
+
+	if [ $lret -ne 0 ]; then
+		ret=$lret
+		[ $bail -eq 0 ] || exit $ret
+	fi
+}
+
 while getopts "bcdh" option;do
 	case "$option" in
 	"h")
@@ -301,4 +374,6 @@ run_test 10 10 1 50 "balanced bwidth with unbalanced delay"
 run_test 30 10 0 0 "unbalanced bwidth"
 run_test 30 10 1 50 "unbalanced bwidth with unbalanced delay"
 run_test 30 10 50 1 "unbalanced bwidth with opposed, unbalanced delay"
+run_sched_test
+run_redundant_test
 exit $ret
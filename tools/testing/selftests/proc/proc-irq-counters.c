@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test the record stream of /proc/irq/counters: whole records in
+ * ascending interrupt order, the file position following the records and
+ * pread() starting at the interrupt number it is given.
+ */
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct irq_counters_record {
+	uint32_t irq;
+	uint32_t nr_cpus;
+	uint32_t counts[];
+};
+
+#define NR_RECORDS 64
+
+int main(void)
+{
+	struct irq_counters_record *rec;
+	uint32_t nr_cpus, first, prev;
+	size_t rsize, size;
+	ssize_t rv;
+	char *buf;
+	off_t pos;
+	int fd, i;
+
+	fd = open("/proc/irq/counters", O_RDONLY);
+	if (fd == -1) {
+		if (errno == ENOENT)
+			return 4;
+		return 1;
+	}
+
+	/* Too small for a single record. */
+	rv = read(fd, &nr_cpus, sizeof(nr_cpus));
+	assert(rv == -1 && errno == EINVAL);
+
+	/* Learn the record size from the first one. */
+	buf = malloc(1 << 20);
+	assert(buf);
+	rv = read(fd, buf, 1 << 20);
+	if (rv == 0)
+		return 4;
+	assert(rv > 0);
+	rec = (void *)buf;
+	nr_cpus = rec->nr_cpus;
+	assert(nr_cpus > 0);
+	rsize = sizeof(*rec) + nr_cpus * sizeof(uint32_t);
+	assert(rv % rsize == 0);
+
+	first = rec->irq;
+	prev = first;
+	for (i = 1; i < rv / rsize; i++) {
+		rec = (void *)(buf + i * rsize);
+		assert(rec->nr_cpus == nr_cpus);
+		assert(rec->irq > prev);
+		prev = rec->irq;
+	}
+	pos = lseek(fd, 0, SEEK_CUR);
+	assert(pos > prev);
+
+	/* A partial record is never returned. */
+	size = NR_RECORDS * rsize + rsize / 2;
+	rv = pread(fd, buf, size, 0);
+	assert(rv > 0 && rv % rsize == 0 && rv <= NR_RECORDS * rsize);
+	rec = (void *)buf;
+	assert(rec->irq == first);
+
+	/* pread() starts at the given interrupt number. */
+	rv = pread(fd, buf, rsize, prev);
+	assert(rv == rsize);
+	rec = (void *)buf;
+	assert(rec->irq == prev);
+
+	free(buf);
+	close(fd);
+	return 0;
+}
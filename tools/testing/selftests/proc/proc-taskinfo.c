@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test /proc/taskinfo: whole records in ascending PID order, our own
+ * record being there with the right parent, and pread() starting at the
+ * PID it is given.
+ */
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/proc_taskinfo.h>
+
+#define NR_RECORDS 256
+
+int main(void)
+{
+	struct proc_taskinfo *rec, *buf;
+	uint32_t prev = 0;
+	int found = 0;
+	uint64_t id;
+	ssize_t rv;
+	int fd, i;
+
+	fd = open("/proc/taskinfo", O_RDONLY);
+	if (fd == -1) {
+		if (errno == ENOENT)
+			return 4;
+		return 1;
+	}
+
+	/* Too small for a single record. */
+	rv = read(fd, &id, sizeof(id));
+	assert(rv == -1 && errno == EINVAL);
+
+	buf = calloc(NR_RECORDS, sizeof(*buf));
+	assert(buf);
+	while ((rv = read(fd, buf, NR_RECORDS * sizeof(*buf) + 1)) > 0) {
+		assert(rv % sizeof(*buf) == 0);
+		for (i = 0; i < rv / sizeof(*buf); i++) {
+			rec = &buf[i];
+			assert(rec->size == sizeof(*rec));
+			assert(rec->pid > prev);
+			prev = rec->pid;
+			if (rec->pid == getpid()) {
+				assert(rec->ppid == getppid());
+				assert(rec->num_threads == 1);
+				assert(rec->valid & PROC_TASKINFO_IO);
+				found = 1;
+			}
+		}
+		assert(lseek(fd, 0, SEEK_CUR) > prev);
+	}
+	assert(rv == 0);
+	assert(found);
+
+	/* pread() starts at the given PID. */
+	rv = pread(fd, buf, sizeof(*buf), getpid());
+	assert(rv == sizeof(*buf));
+	assert(buf->pid == getpid());
+
+	/* Filtering by our own cgroup still returns us. */
+	id = buf->cgroup_id;
+	if (ioctl(fd, PROC_TASKINFO_SET_CGROUP, &id) == 0) {
+		rv = pread(fd, buf, sizeof(*buf), getpid());
+		assert(rv == sizeof(*buf));
+		assert(buf->pid == getpid());
+	}
+
+	free(buf);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Ring-buffer memory mapping tests
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/trace_mmap.h>
+
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/ioctl.h>
+
+#include "../kselftest_harness.h"
+
+#define TRACEFS_ROOT "/sys/kernel/tracing"
+
+static int tracefs_write(const char *path, const char *value)
+{
+	int fd, ret;
+
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return fd;
+
+	ret = write(fd, value, strlen(value));
+
+	close(fd);
+
+	return ret == -1 ? -errno : 0;
+}
+
+static int tracefs_reset(void)
+{
+	if (tracefs_write(TRACEFS_ROOT "/tracing_on", "0"))
+		return -1;
+	if (tracefs_write(TRACEFS_ROOT "/trace", ""))
+		return -1;
+	if (tracefs_write(TRACEFS_ROOT "/set_event", ""))
+		return -1;
+	if (tracefs_write(TRACEFS_ROOT "/current_tracer", "nop"))
+		return -1;
+
+	return 0;
+}
+
+struct tracefs_cpu_map_desc {
+	struct trace_buffer_meta	*meta;
+	int				cpu_fd;
+};
+
+static int tracefs_cpu_map(struct tracefs_cpu_map_desc *desc, int cpu)
+{
+	int page_size = getpagesize();
+	char *cpu_path;
+	void *map;
+
+	if (asprintf(&cpu_path,
+		     TRACEFS_ROOT "/per_cpu/cpu%d/trace_pipe_raw",
+		     cpu) < 0)
+		return -ENOMEM;
+
+	desc->cpu_fd = open(cpu_path, O_RDONLY | O_NONBLOCK);
+	free(cpu_path);
+	if (desc->cpu_fd < 0)
+		return -ENODEV;
+
+	map = mmap(NULL, page_size, PROT_READ, MAP_SHARED, desc->cpu_fd, 0);
+	if (map == MAP_FAILED) {
+		close(desc->cpu_fd);
+		return -errno;
+	}
+
+	desc->meta = (struct trace_buffer_meta *)map;
+
+	return 0;
+}
+
+static void tracefs_cpu_unmap(struct tracefs_cpu_map_desc *desc)
+{
+	munmap(desc->meta, desc->meta->meta_page_size);
+	close(desc->cpu_fd);
+}
+
+FIXTURE(map) {
+	struct tracefs_cpu_map_desc	map_desc;
+	bool				umount;
+};
+
+FIXTURE_SETUP(map)
+{
+	int cpu = sched_getcpu();
+	cpu_set_t cpu_mask;
+
+	if (getuid() != 0)
+		SKIP(return, "Skipping: %s", "Please run the test as root");
+
+	if (access(TRACEFS_ROOT, F_OK) ||
+	    access(TRACEFS_ROOT "/tracing_on", F_OK)) {
+		if (mount("nodev", TRACEFS_ROOT, "tracefs", 0, NULL))
+			SKIP(return, "Skipping: %s", "tracefs is not available");
+		self->umount = true;
+	}
+
+	ASSERT_GE(cpu, 0);
+
+	ASSERT_EQ(tracefs_reset(), 0);
+
+	tracefs_write(TRACEFS_ROOT "/buffer_size_kb", "28");
+
+	ASSERT_EQ(tracefs_cpu_map(&self->map_desc, cpu), 0);
+
+	/*
+	 * Ensure generated events will be found on this very same ring-buffer.
+	 */
+	CPU_ZERO(&cpu_mask);
+	CPU_SET(cpu, &cpu_mask);
+	ASSERT_EQ(sched_setaffinity(0, sizeof(cpu_mask), &cpu_mask), 0);
+}
+
+FIXTURE_TEARDOWN(map)
+{
+	tracefs_reset();
+
+	if (self->umount)
+		umount(TRACEFS_ROOT);
+
+	tracefs_cpu_unmap(&self->map_desc);
+}
+
+TEST_F(map, meta_page_check)
+{
+	struct tracefs_cpu_map_desc *desc = &self->map_desc;
+	int cnt = 0;
+
+	ASSERT_EQ(desc->meta->meta_page_size, getpagesize());
+	ASSERT_EQ(desc->meta->meta_struct_len, sizeof(*desc->meta));
+	ASSERT_EQ(desc->meta->subbuf_size, getpagesize());
+	ASSERT_GT(desc->meta->nr_subbufs, 1);
+	ASSERT_LT(desc->meta->reader.id, desc->meta->nr_subbufs);
+	ASSERT_EQ(desc->meta->entries, 0);
+
+	ASSERT_EQ(tracefs_write(TRACEFS_ROOT "/tracing_on", "1"), 0);
+	ASSERT_EQ(tracefs_write(TRACEFS_ROOT "/trace_marker", "hello"), 0);
+	ASSERT_EQ(tracefs_write(TRACEFS_ROOT "/tracing_on", "0"), 0);
+
+	/* The meta-page only refreshes on a reader swap */
+	ASSERT_EQ(ioctl(desc->cpu_fd, TRACE_MMAP_IOCTL_GET_READER), 0);
+	ASSERT_EQ(desc->meta->entries, 1);
+	ASSERT_LT(desc->meta->reader.id, desc->meta->nr_subbufs);
+
+	/* Nothing left to read: a non-blocking swap must not fail */
+	while (cnt++ < desc->meta->nr_subbufs)
+		ASSERT_EQ(ioctl(desc->cpu_fd, TRACE_MMAP_IOCTL_GET_READER), 0);
+}
+
+TEST_F(map, data_mmap)
+{
+	struct tracefs_cpu_map_desc *desc = &self->map_desc;
+	unsigned long meta_len, data_len;
+	void *data;
+
+	meta_len = desc->meta->meta_page_size;
+	data_len = desc->meta->subbuf_size * desc->meta->nr_subbufs;
+
+	/* Map all the available subbufs */
+	data = mmap(NULL, data_len, PROT_READ, MAP_SHARED,
+		    desc->cpu_fd, meta_len);
+	ASSERT_NE(data, MAP_FAILED);
+	munmap(data, data_len);
+
+	/* Map all the available subbufs - 1 */
+	data_len -= desc->meta->subbuf_size;
+	data = mmap(NULL, data_len, PROT_READ, MAP_SHARED,
+		    desc->cpu_fd, meta_len);
+	ASSERT_NE(data, MAP_FAILED);
+	munmap(data, data_len);
+
+	/* Overflow the available subbufs by 1 */
+	meta_len += desc->meta->subbuf_size * 2;
+	data = mmap(NULL, data_len, PROT_READ, MAP_SHARED,
+		    desc->cpu_fd, meta_len);
+	ASSERT_EQ(data, MAP_FAILED);
+
+	/* The mapping is read-only */
+	data = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED,
+		    desc->cpu_fd, 0);
+	ASSERT_EQ(data, MAP_FAILED);
+
+	/* And must not be private */
+	data = mmap(NULL, getpagesize(), PROT_READ, MAP_PRIVATE,
+		    desc->cpu_fd, 0);
+	ASSERT_EQ(data, MAP_FAILED);
+}
+
+TEST_F(map, busy)
+{
+	/* A mapped buffer can neither be resized nor snapshotted */
+	ASSERT_NE(tracefs_write(TRACEFS_ROOT "/buffer_size_kb", "64"), 0);
+
+	if (!access(TRACEFS_ROOT "/snapshot", F_OK))
+		ASSERT_NE(tracefs_write(TRACEFS_ROOT "/snapshot", "1"), 0);
+}
+
+TEST_HARNESS_MAIN
@@ -29,7 +29,7 @@ char *osnoise_get_cpus(struct osnoise_context *context)
 	if (context->orig_cpus)
 		return context->orig_cpus;
 
-	context->orig_cpus = tracefs_instance_file_read(NULL, "osnoise/cpus", NULL);
+	context->orig_cpus = tracefs_instance_file_read(context->inst, "osnoise/cpus", NULL);
 
 	/*
 	 * The error value (NULL) is the same for tracefs_instance_file_read()
@@ -62,7 +62,7 @@ int osnoise_set_cpus(struct osnoise_context *context, char *cpus)
 
 	debug_msg("setting cpus to %s from %s", cpus, context->orig_cpus);
 
-	retval = tracefs_instance_file_write(NULL, "osnoise/cpus", buffer);
+	retval = tracefs_instance_file_write(context->inst, "osnoise/cpus", buffer);
 	if (retval < 0) {
 		free(context->curr_cpus);
 		context->curr_cpus = NULL;
@@ -95,7 +95,7 @@ void osnoise_restore_cpus(struct osnoise_context *context)
 
 	debug_msg("restoring cpus to %s", context->orig_cpus);
 
-	retval = tracefs_instance_file_write(NULL, "osnoise/cpus", context->orig_cpus);
+	retval = tracefs_instance_file_write(context->inst, "osnoise/cpus", context->orig_cpus);
 	if (retval < 0)
 		err_msg("could not restore original osnoise cpus\n");
 
@@ -123,12 +123,12 @@ void osnoise_put_cpus(struct osnoise_context *context)
  *
  * returns -1 on error.
  */
-static long long osnoise_read_ll_config(char *rel_path)
+static long long osnoise_read_ll_config(struct tracefs_instance *inst, char *rel_path)
 {
 	long long retval;
 	char *buffer;
 
-	buffer = tracefs_instance_file_read(NULL, rel_path, NULL);
+	buffer = tracefs_instance_file_read(inst, rel_path, NULL);
 	if (!buffer)
 		return -1;
 
@@ -147,7 +147,8 @@ static long long osnoise_read_ll_config(char *rel_path)
  *
  * returns -1 on error.
  */
-static long long osnoise_write_ll_config(char *rel_path, long long value)
+static long long osnoise_write_ll_config(struct tracefs_instance *inst, char *rel_path,
+					 long long value)
 {
 	char buffer[BUFF_U64_STR_SIZE];
 	long long retval;
@@ -156,10 +157,26 @@ static long long osnoise_write_ll_config(char *rel_path, long long value)
 
 	debug_msg("setting %s to %lld\n", rel_path, value);
 
-	retval = tracefs_instance_file_write(NULL, rel_path, buffer);
+	retval = tracefs_instance_file_write(inst, rel_path, buffer);
 	return retval;
 }
 
+/*
+ * osnoise_read_time_config - read a period/runtime like config
+ *
+ * In an instance, zero means that the top level value is in use, so
+ * return that one instead.
+ */
+static long long osnoise_read_time_config(struct osnoise_context *context, char *rel_path)
+{
+	long long value = osnoise_read_ll_config(context->inst, rel_path);
+
+	if (!value && context->inst)
+		value = osnoise_read_ll_config(NULL, rel_path);
+
+	return value;
+}
+
 /*
  * osnoise_get_runtime - return the original "osnoise/runtime_us" value
  *
@@ -175,7 +192,7 @@ unsigned long long osnoise_get_runtime(struct osnoise_context *context)
 	if (context->orig_runtime_us != OSNOISE_TIME_INIT_VAL)
 		return context->orig_runtime_us;
 
-	runtime_us = osnoise_read_ll_config("osnoise/runtime_us");
+	runtime_us = osnoise_read_time_config(context, "osnoise/runtime_us");
 	if (runtime_us < 0)
 		goto out_err;
 
@@ -201,7 +218,7 @@ unsigned long long osnoise_get_period(struct osnoise_context *context)
 	if (context->orig_period_us != OSNOISE_TIME_INIT_VAL)
 		return context->orig_period_us;
 
-	period_us = osnoise_read_ll_config("osnoise/period_us");
+	period_us = osnoise_read_time_config(context, "osnoise/period_us");
 	if (period_us < 0)
 		goto out_err;
 
@@ -220,7 +237,7 @@ static int __osnoise_write_runtime(struct osnoise_context *context,
 	if (context->orig_runtime_us == OSNOISE_TIME_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("osnoise/runtime_us", runtime);
+	retval = osnoise_write_ll_config(context->inst, "osnoise/runtime_us", runtime);
 	if (retval < 0)
 		return -1;
 
@@ -236,7 +253,7 @@ static int __osnoise_write_period(struct osnoise_context *context,
 	if (context->orig_period_us == OSNOISE_TIME_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("osnoise/period_us", period);
+	retval = osnoise_write_ll_config(context->inst, "osnoise/period_us", period);
 	if (retval < 0)
 		return -1;
 
@@ -352,7 +369,7 @@ osnoise_get_timerlat_period_us(struct osnoise_context *context)
 	if (context->orig_timerlat_period_us != OSNOISE_TIME_INIT_VAL)
 		return context->orig_timerlat_period_us;
 
-	timerlat_period_us = osnoise_read_ll_config("osnoise/timerlat_period_us");
+	timerlat_period_us = osnoise_read_time_config(context, "osnoise/timerlat_period_us");
 	if (timerlat_period_us < 0)
 		goto out_err;
 
@@ -374,7 +391,8 @@ int osnoise_set_timerlat_period_us(struct osnoise_context *context, long long ti
 	if (curr_timerlat_period_us == OSNOISE_TIME_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("osnoise/timerlat_period_us", timerlat_period_us);
+	retval = osnoise_write_ll_config(context->inst, "osnoise/timerlat_period_us",
+					 timerlat_period_us);
 	if (retval < 0)
 		return -1;
 
@@ -396,7 +414,8 @@ void osnoise_restore_timerlat_period_us(struct osnoise_context *context)
 	if (context->orig_timerlat_period_us == context->timerlat_period_us)
 		goto out_done;
 
-	retval = osnoise_write_ll_config("osnoise/timerlat_period_us", context->orig_timerlat_period_us);
+	retval = osnoise_write_ll_config(context->inst, "osnoise/timerlat_period_us",
+					 context->orig_timerlat_period_us);
 	if (retval < 0)
 		err_msg("Could not restore original osnoise timerlat_period_us\n");
 
@@ -431,7 +450,7 @@ osnoise_get_stop_us(struct osnoise_context *context)
 	if (context->orig_stop_us != OSNOISE_OPTION_INIT_VAL)
 		return context->orig_stop_us;
 
-	stop_us = osnoise_read_ll_config("osnoise/stop_tracing_us");
+	stop_us = osnoise_read_ll_config(NULL, "osnoise/stop_tracing_us");
 	if (stop_us < 0)
 		goto out_err;
 
@@ -453,7 +472,7 @@ int osnoise_set_stop_us(struct osnoise_context *context, long long stop_us)
 	if (curr_stop_us == OSNOISE_OPTION_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("osnoise/stop_tracing_us", stop_us);
+	retval = osnoise_write_ll_config(NULL, "osnoise/stop_tracing_us", stop_us);
 	if (retval < 0)
 		return -1;
 
@@ -475,7 +494,7 @@ void osnoise_restore_stop_us(struct osnoise_context *context)
 	if (context->orig_stop_us == context->stop_us)
 		goto out_done;
 
-	retval = osnoise_write_ll_config("osnoise/stop_tracing_us", context->orig_stop_us);
+	retval = osnoise_write_ll_config(NULL, "osnoise/stop_tracing_us", context->orig_stop_us);
 	if (retval < 0)
 		err_msg("Could not restore original osnoise stop_us\n");
 
@@ -510,7 +529,7 @@ osnoise_get_stop_total_us(struct osnoise_context *context)
 	if (context->orig_stop_total_us != OSNOISE_OPTION_INIT_VAL)
 		return context->orig_stop_total_us;
 
-	stop_total_us = osnoise_read_ll_config("osnoise/stop_tracing_total_us");
+	stop_total_us = osnoise_read_ll_config(NULL, "osnoise/stop_tracing_total_us");
 	if (stop_total_us < 0)
 		goto out_err;
 
@@ -532,7 +551,7 @@ int osnoise_set_stop_total_us(struct osnoise_context *context, long long stop_to
 	if (curr_stop_total_us == OSNOISE_OPTION_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("osnoise/stop_tracing_total_us", stop_total_us);
+	retval = osnoise_write_ll_config(NULL, "osnoise/stop_tracing_total_us", stop_total_us);
 	if (retval < 0)
 		return -1;
 
@@ -554,7 +573,7 @@ void osnoise_restore_stop_total_us(struct osnoise_context *context)
 	if (context->orig_stop_total_us == context->stop_total_us)
 		goto out_done;
 
-	retval = osnoise_write_ll_config("osnoise/stop_tracing_total_us",
+	retval = osnoise_write_ll_config(NULL, "osnoise/stop_tracing_total_us",
 			context->orig_stop_total_us);
 	if (retval < 0)
 		err_msg("Could not restore original osnoise stop_total_us\n");
@@ -590,7 +609,7 @@ osnoise_get_print_stack(struct osnoise_context *context)
 	if (context->orig_print_stack != OSNOISE_OPTION_INIT_VAL)
 		return context->orig_print_stack;
 
-	print_stack = osnoise_read_ll_config("osnoise/print_stack");
+	print_stack = osnoise_read_ll_config(NULL, "osnoise/print_stack");
 	if (print_stack < 0)
 		goto out_err;
 
@@ -612,7 +631,7 @@ int osnoise_set_print_stack(struct osnoise_context *context, long long print_sta
 	if (curr_print_stack == OSNOISE_OPTION_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("osnoise/print_stack", print_stack);
+	retval = osnoise_write_ll_config(NULL, "osnoise/print_stack", print_stack);
 	if (retval < 0)
 		return -1;
 
@@ -634,7 +653,7 @@ void osnoise_restore_print_stack(struct osnoise_context *context)
 	if (context->orig_print_stack == context->print_stack)
 		goto out_done;
 
-	retval = osnoise_write_ll_config("osnoise/print_stack", context->orig_print_stack);
+	retval = osnoise_write_ll_config(NULL, "osnoise/print_stack", context->orig_print_stack);
 	if (retval < 0)
 		err_msg("Could not restore original osnoise print_stack\n");
 
@@ -669,7 +688,7 @@ osnoise_get_tracing_thresh(struct osnoise_context *context)
 	if (context->orig_tracing_thresh != OSNOISE_OPTION_INIT_VAL)
 		return context->orig_tracing_thresh;
 
-	tracing_thresh = osnoise_read_ll_config("tracing_thresh");
+	tracing_thresh = osnoise_read_ll_config(NULL, "tracing_thresh");
 	if (tracing_thresh < 0)
 		goto out_err;
 
@@ -691,7 +710,7 @@ int osnoise_set_tracing_thresh(struct osnoise_context *context, long long tracin
 	if (curr_tracing_thresh == OSNOISE_OPTION_INIT_VAL)
 		return -1;
 
-	retval = osnoise_write_ll_config("tracing_thresh", tracing_thresh);
+	retval = osnoise_write_ll_config(NULL, "tracing_thresh", tracing_thresh);
 	if (retval < 0)
 		return -1;
 
@@ -713,7 +732,7 @@ void osnoise_restore_tracing_thresh(struct osnoise_context *context)
 	if (context->orig_tracing_thresh == context->tracing_thresh)
 		goto out_done;
 
-	retval = osnoise_write_ll_config("tracing_thresh", context->orig_tracing_thresh);
+	retval = osnoise_write_ll_config(NULL, "tracing_thresh", context->orig_tracing_thresh);
 	if (retval < 0)
 		err_msg("Could not restore original tracing_thresh\n");
 
@@ -927,6 +946,18 @@ void osnoise_put_context(struct osnoise_context *context)
 	if (!(context->flags & FLAG_CONTEXT_DELETED))
 		return;
 
+	if (context->inst) {
+		/*
+		 * These configs lived in the tool instance, which is
+		 * gone already: there is nothing to restore.
+		 */
+		free(context->curr_cpus);
+		context->curr_cpus = NULL;
+		context->runtime_us = context->orig_runtime_us;
+		context->period_us = context->orig_period_us;
+		context->timerlat_period_us = context->orig_timerlat_period_us;
+	}
+
 	osnoise_put_cpus(context);
 	osnoise_put_runtime_period(context);
 	osnoise_put_stop_us(context);
@@ -985,17 +1016,95 @@ struct osnoise_tool *osnoise_init_tool(char *tool_name)
 }
 
 /*
- * osnoise_init_trace_tool - init a tracer instance to trace osnoise events
+ * osnoise_init_partition_tool - init an osnoise tool with its own configs
+ *
+ * Like osnoise_init_tool(), but the cpus, runtime, period and timerlat
+ * period are set in the "osnoise/" directory of the tool instance rather
+ * than system wide. The pid is appended to the instance name, so that
+ * several sessions can run at once on different sets of CPUs.
  */
-struct osnoise_tool *osnoise_init_trace_tool(char *tracer)
+struct osnoise_tool *osnoise_init_partition_tool(char *tool_name)
+{
+	struct osnoise_tool *top;
+	char name[64];
+
+	snprintf(name, sizeof(name), "%s_%d", tool_name, getpid());
+
+	top = osnoise_init_tool(name);
+	if (!top)
+		return NULL;
+
+	if (!tracefs_file_exists(top->trace.inst, "osnoise/cpus")) {
+		err_msg("Kernel does not support per-instance osnoise configs\n");
+		osnoise_destroy_tool(top);
+		return NULL;
+	}
+
+	top->context->inst = top->trace.inst;
+
+	return top;
+}
+
+/*
+ * osnoise_copy_partition - copy the per-instance configs of tool to trace
+ */
+static int osnoise_copy_partition(struct osnoise_tool *trace, struct osnoise_tool *tool)
+{
+	static char * const configs[] = {
+		"osnoise/cpus",
+		"osnoise/period_us",
+		"osnoise/runtime_us",
+		"osnoise/timerlat_period_us",
+		NULL,
+	};
+	char *buffer;
+	int retval;
+	int i;
+
+	for (i = 0; configs[i]; i++) {
+		if (!tracefs_file_exists(tool->trace.inst, configs[i]))
+			continue;
+
+		buffer = tracefs_instance_file_read(tool->trace.inst, configs[i], NULL);
+		if (!buffer)
+			return -1;
+
+		retval = tracefs_instance_file_write(trace->trace.inst, configs[i], buffer);
+		free(buffer);
+		if (retval < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * __osnoise_init_trace_tool - init a tracer instance to trace osnoise events
+ *
+ * If partition is not NULL, the instance measures the same CPUs, with the
+ * same configs, as the partition tool.
+ */
+static struct osnoise_tool *
+__osnoise_init_trace_tool(char *tracer, struct osnoise_tool *partition)
 {
 	struct osnoise_tool *trace;
 	int retval;
 
-	trace = osnoise_init_tool("osnoise_trace");
+	if (partition)
+		trace = osnoise_init_partition_tool("osnoise_trace");
+	else
+		trace = osnoise_init_tool("osnoise_trace");
 	if (!trace)
 		return NULL;
 
+	if (partition) {
+		retval = osnoise_copy_partition(trace, partition);
+		if (retval) {
+			err_msg("Could not copy the osnoise configs to the trace instance\n");
+			goto out_err;
+		}
+	}
+
 	retval = tracefs_event_enable(trace->trace.inst, "osnoise", NULL);
 	if (retval < 0 && !errno) {
 		err_msg("Could not find osnoise events\n");
@@ -1014,6 +1123,23 @@ struct osnoise_tool *osnoise_init_trace_tool(char *tracer)
 	return NULL;
 }
 
+/*
+ * osnoise_init_trace_tool - init a tracer instance to trace osnoise events
+ */
+struct osnoise_tool *osnoise_init_trace_tool(char *tracer)
+{
+	return __osnoise_init_trace_tool(tracer, NULL);
+}
+
+/*
+ * osnoise_init_partition_trace_tool - init a trace instance for a partition tool
+ */
+struct osnoise_tool *osnoise_init_partition_trace_tool(char *tracer,
+						       struct osnoise_tool *tool)
+{
+	return __osnoise_init_trace_tool(tracer, tool);
+}
+
 static void osnoise_usage(int err)
 {
 	int i;
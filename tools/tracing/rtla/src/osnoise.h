@@ -8,6 +8,9 @@ struct osnoise_context {
 	int			flags;
 	int			ref;
 
+	/* NULL for the top level configs */
+	struct tracefs_instance	*inst;
+
 	char			*curr_cpus;
 	char			*orig_cpus;
 
@@ -99,6 +102,9 @@ struct osnoise_tool {
 void osnoise_destroy_tool(struct osnoise_tool *top);
 struct osnoise_tool *osnoise_init_tool(char *tool_name);
 struct osnoise_tool *osnoise_init_trace_tool(char *tracer);
+struct osnoise_tool *osnoise_init_partition_tool(char *tool_name);
+struct osnoise_tool *osnoise_init_partition_trace_tool(char *tracer,
+						       struct osnoise_tool *tool);
 
 int osnoise_hist_main(int argc, char *argv[]);
 int osnoise_top_main(int argc, char **argv);
@@ -35,6 +35,7 @@ struct osnoise_top_params {
 	int			duration;
 	int			quiet;
 	int			set_sched;
+	int			partition;
 	struct sched_attr	sched_param;
 	struct trace_events	*events;
 	enum osnoise_mode	mode;
@@ -276,7 +277,7 @@ static void osnoise_top_usage(struct osnoise_top_params *params, char *usage)
 	static const char * const msg[] = {
 		" [-h] [-q] [-D] [-d s] [-a us] [-p us] [-r us] [-s us] [-S us] \\",
 		"	  [-T us] [-t[=file]] [-e sys[:event]] [--filter <filter>] [--trigger <trigger>] \\",
-		"	  [-c cpu-list] [-P priority]",
+		"	  [-c cpu-list] [-P priority] [--partition]",
 		"",
 		"	  -h/--help: print this menu",
 		"	  -a/--auto: set automatic trace mode, stopping the session if argument in us sample is hit",
@@ -293,6 +294,7 @@ static void osnoise_top_usage(struct osnoise_top_params *params, char *usage)
 		"	     --filter <filter>: enable a trace event filter to the previous -e event",
 		"	     --trigger <trigger>: enable a trace event trigger to the previous -e event",
 		"	  -q/--quiet print only a summary at the end",
+		"	     --partition: keep -c, -p and -r in the session trace instance, so other sessions can run on other cpus",
 		"	  -P/--priority o:prio|r:prio|f:prio|d:runtime:period : set scheduling parameters",
 		"		o:prio - use SCHED_OTHER with prio",
 		"		r:prio - use SCHED_RR with prio",
@@ -361,13 +363,14 @@ struct osnoise_top_params *osnoise_top_parse_args(int argc, char **argv)
 			{"trace",		optional_argument,	0, 't'},
 			{"trigger",		required_argument,	0, '0'},
 			{"filter",		required_argument,	0, '1'},
+			{"partition",		no_argument,		0, '2'},
 			{0, 0, 0, 0}
 		};
 
 		/* getopt_long stores the option index here. */
 		int option_index = 0;
 
-		c = getopt_long(argc, argv, "a:c:d:De:hp:P:qr:s:S:t::T:0:1:",
+		c = getopt_long(argc, argv, "a:c:d:De:hp:P:qr:s:S:t::T:0:1:2",
 				 long_options, &option_index);
 
 		/* Detect the end of the options. */
@@ -473,6 +476,9 @@ struct osnoise_top_params *osnoise_top_parse_args(int argc, char **argv)
 				osnoise_top_usage(params, "--filter requires a previous -e\n");
 			}
 			break;
+		case '2':
+			params->partition = 1;
+			break;
 		default:
 			osnoise_top_usage(params, "Invalid option");
 		}
@@ -563,7 +569,10 @@ struct osnoise_tool *osnoise_init_top(struct osnoise_top_params *params)
 
 	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
 
-	tool = osnoise_init_tool("osnoise_top");
+	if (params->partition)
+		tool = osnoise_init_partition_tool("osnoise_top");
+	else
+		tool = osnoise_init_tool("osnoise_top");
 	if (!tool)
 		return NULL;
 
@@ -646,7 +655,10 @@ int osnoise_top_main(int argc, char **argv)
 	trace_instance_start(trace);
 
 	if (params->trace_output) {
-		record = osnoise_init_trace_tool("osnoise");
+		if (params->partition)
+			record = osnoise_init_partition_trace_tool("osnoise", tool);
+		else
+			record = osnoise_init_trace_tool("osnoise");
 		if (!record) {
 			err_msg("Failed to enable the trace instance\n");
 			goto out_free;
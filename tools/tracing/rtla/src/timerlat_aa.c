@@ -408,6 +408,7 @@ static int timerlat_aa_thread_handler(struct trace_seq *s, struct tep_record *re
 {
 	struct timerlat_aa_context *taa_ctx = timerlat_aa_get_ctx();
 	struct timerlat_aa_data *taa_data = timerlat_aa_get_data(taa_ctx, record->cpu);
+	unsigned long long cgroup = 0;
 	unsigned long long duration;
 	unsigned long long start;
 	unsigned long long pid;
@@ -420,6 +421,9 @@ static int timerlat_aa_thread_handler(struct trace_seq *s, struct tep_record *re
 	tep_get_field_val(s, event, "duration", record, &duration, 1);
 	tep_get_field_val(s, event, "start", record, &start, 1);
 
+	/* Older kernels do not report the cgroup of the noisy thread */
+	tep_get_field_val(s, event, "cgroup", record, &cgroup, 0);
+
 	tep_get_common_field_val(s, event, "common_pid", record, &pid, 1);
 	comm = tep_get_field_raw(s, event, "comm", record, &val, 1);
 
@@ -434,8 +438,13 @@ static int timerlat_aa_thread_handler(struct trace_seq *s, struct tep_record *re
 	} else {
 		taa_data->thread_thread_sum += duration;
 
-		trace_seq_printf(taa_data->threads_seq, "\t%24s:%-3llu	\t\t%9.2f us\n",
-			 comm, pid, ns_to_usf(duration));
+		if (cgroup)
+			trace_seq_printf(taa_data->threads_seq,
+					 "\t%24s:%-3llu	\t\t%9.2f us	cgroup %llu\n",
+					 comm, pid, ns_to_usf(duration), cgroup);
+		else
+			trace_seq_printf(taa_data->threads_seq, "\t%24s:%-3llu	\t\t%9.2f us\n",
+					 comm, pid, ns_to_usf(duration));
 	}
 
 	return 0;
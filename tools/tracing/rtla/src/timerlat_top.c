@@ -35,6 +35,7 @@ struct timerlat_top_params {
 	int			no_aa;
 	int			aa_only;
 	int			dump_tasks;
+	int			partition;
 	struct sched_attr	sched_param;
 	struct trace_events	*events;
 };
@@ -285,7 +286,7 @@ static void timerlat_top_usage(char *usage)
 		"",
 		"  usage: rtla timerlat [top] [-h] [-q] [-a us] [-d s] [-D] [-n] [-p us] [-i us] [-T us] [-s us] \\",
 		"	  [[-t[=file]] [-e sys[:event]] [--filter <filter>] [--trigger <trigger>] [-c cpu-list] \\",
-		"	  [-P priority] [--dma-latency us] [--aa-only us]",
+		"	  [-P priority] [--dma-latency us] [--aa-only us] [--partition]",
 		"",
 		"	  -h/--help: print this menu",
 		"	  -a/--auto: set automatic trace mode, stopping the session if argument in us latency is hit",
@@ -306,6 +307,7 @@ static void timerlat_top_usage(char *usage)
 		"	     --no-aa: disable auto-analysis, reducing rtla timerlat cpu usage",
 		"	  -q/--quiet print only a summary at the end",
 		"	     --dma-latency us: set /dev/cpu_dma_latency latency <us> to reduce exit from idle latency",
+		"	     --partition: keep -c and -p in the session trace instance, so other sessions can run on other cpus",
 		"	  -P/--priority o:prio|r:prio|f:prio|d:runtime:period : set scheduling parameters",
 		"		o:prio - use SCHED_OTHER with prio",
 		"		r:prio - use SCHED_RR with prio",
@@ -370,13 +372,14 @@ static struct timerlat_top_params
 			{"no-aa",		no_argument,		0, '3'},
 			{"dump-tasks",		no_argument,		0, '4'},
 			{"aa-only",		required_argument,	0, '5'},
+			{"partition",		no_argument,		0, '6'},
 			{0, 0, 0, 0}
 		};
 
 		/* getopt_long stores the option index here. */
 		int option_index = 0;
 
-		c = getopt_long(argc, argv, "a:c:d:De:hi:np:P:qs:t::T:0:1:2:345:",
+		c = getopt_long(argc, argv, "a:c:d:De:hi:np:P:qs:t::T:0:1:2:345:6",
 				 long_options, &option_index);
 
 		/* detect the end of the options. */
@@ -397,6 +400,9 @@ static struct timerlat_top_params
 			/* set trace */
 			params->trace_output = "timerlat_trace.txt";
 			break;
+		case '6':
+			params->partition = 1;
+			break;
 		case '5':
 			/* it is here because it is similar to -a */
 			auto_thresh = get_llong_from_str(optarg);
@@ -602,7 +608,10 @@ static struct osnoise_tool
 
 	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
 
-	top = osnoise_init_tool("timerlat_top");
+	if (params->partition)
+		top = osnoise_init_partition_tool("timerlat_top");
+	else
+		top = osnoise_init_tool("timerlat_top");
 	if (!top)
 		return NULL;
 
@@ -705,7 +714,10 @@ int timerlat_top_main(int argc, char *argv[])
 	trace_instance_start(trace);
 
 	if (params->trace_output) {
-		record = osnoise_init_trace_tool("timerlat");
+		if (params->partition)
+			record = osnoise_init_partition_trace_tool("timerlat", top);
+		else
+			record = osnoise_init_trace_tool("timerlat");
 		if (!record) {
 			err_msg("Failed to enable the trace instance\n");
 			goto out_free;
@@ -30,10 +30,19 @@ struct vring ring;
  * (which skips ring updates and reads and writes len in descriptor).
  */
 /* #ifdef INORDER */
+/* enabling the below activates in-order code as specified by
+ * VIRTIO_F_IN_ORDER: descriptors are used in ring order and the host
+ * writes a single used ring entry for each batch of --param buffers
+ * (default: everything available), at the slot of the first one.
+ */
+/* #ifdef INORDER_BATCH */
 
 #if defined(RING_POLL) && defined(INORDER)
 #error "RING_POLL and INORDER are mutually exclusive"
 #endif
+#if defined(INORDER_BATCH) && (defined(RING_POLL) || defined(INORDER))
+#error "INORDER_BATCH excludes RING_POLL and INORDER"
+#endif
 
 /* how much padding is needed to avoid false cache sharing */
 #define HOST_GUEST_PADDING 0x80
@@ -48,7 +57,15 @@ struct guest {
 #else
 	unsigned short reserved_free_head;
 #endif
+#ifdef INORDER_BATCH
+	/* head of the last buffer of the batch being consumed */
+	unsigned short batch_last;
+	unsigned short batch_pending;
+	unsigned batch_len;
+	unsigned char reserved[HOST_GUEST_PADDING - 18];
+#else
 	unsigned char reserved[HOST_GUEST_PADDING - 10];
+#endif
 } guest;
 
 struct host {
@@ -57,7 +74,13 @@ struct host {
 	 */
 	unsigned short used_idx;
 	unsigned short called_used_idx;
+#ifdef INORDER_BATCH
+	/* first buffer of the batch being used, i.e. the published used idx */
+	unsigned short batch_start;
+	unsigned char reserved[HOST_GUEST_PADDING - 6];
+#else
 	unsigned char reserved[HOST_GUEST_PADDING - 4];
+#endif
 } host;
 
 /* implemented by ring */
@@ -86,6 +109,10 @@ void alloc_ring(void)
 		ring.desc[i].next = i + 1;
 	host.used_idx = 0;
 	host.called_used_idx = -1;
+#ifdef INORDER_BATCH
+	host.batch_start = 0;
+	guest.batch_pending = 0;
+#endif
 	guest.num_free = ring_size;
 	data = malloc(ring_size * sizeof *data);
 	if (!data) {
@@ -107,8 +134,10 @@ int add_inbuf(unsigned len, void *buf, void *datap)
 	if (!guest.num_free)
 		return -1;
 
-#ifdef INORDER
+#if defined(INORDER)
 	head = (ring_size - 1) & (guest.avail_idx++);
+#elif defined(INORDER_BATCH)
+	head = (ring_size - 1) & guest.avail_idx;
 #else
 	head = guest.free_head;
 #endif
@@ -123,7 +152,7 @@ int add_inbuf(unsigned len, void *buf, void *datap)
 	 * descriptors.
 	 */
 	desc[head].flags &= ~VRING_DESC_F_NEXT;
-#ifndef INORDER
+#if !defined(INORDER) && !defined(INORDER_BATCH)
 	guest.free_head = desc[head].next;
 #endif
 
@@ -163,6 +192,18 @@ void *get_buf(unsigned *lenp, void **bufp)
 	/* Barrier B (for pairing) */
 	smp_acquire();
 	index &= ring_size - 1;
+#elif defined(INORDER_BATCH)
+	head = (ring_size - 1) & guest.last_used_idx;
+	if (!guest.batch_pending) {
+		if (ring.used->idx == guest.last_used_idx)
+			return NULL;
+		/* Barrier B (for pairing) */
+		smp_acquire();
+		guest.batch_last = ring.used->ring[head].id;
+		guest.batch_len = ring.used->ring[head].len;
+		guest.batch_pending = 1;
+	}
+	index = head;
 #else
 	if (ring.used->idx == guest.last_used_idx)
 		return NULL;
@@ -177,15 +218,23 @@ void *get_buf(unsigned *lenp, void **bufp)
 #endif
 
 #endif
-#ifdef INORDER
+#if defined(INORDER)
 	*lenp = ring.desc[index].len;
+#elif defined(INORDER_BATCH)
+	if (index == guest.batch_last) {
+		*lenp = guest.batch_len;
+		guest.batch_pending = 0;
+	} else {
+		/* Skipped buffers were used completely */
+		*lenp = ring.desc[index].len;
+	}
 #else
 	*lenp = ring.used->ring[head].len;
 #endif
 	datap = data[index].data;
 	*bufp = (void*)(unsigned long)ring.desc[index].addr;
 	data[index].data = NULL;
-#ifndef INORDER
+#if !defined(INORDER) && !defined(INORDER_BATCH)
 	ring.desc[index].next = guest.free_head;
 	guest.free_head = index;
 #endif
@@ -202,6 +251,8 @@ bool used_empty()
 	unsigned index = ring.used->ring[head].id;
 
 	return (index ^ last_used_idx ^ 0x8000) & ~(ring_size - 1);
+#elif defined(INORDER_BATCH)
+	return !guest.batch_pending && ring.used->idx == last_used_idx;
 #else
 	return ring.used->idx == last_used_idx;
 #endif
@@ -301,8 +352,22 @@ bool use_buf(unsigned *lenp, void **bufp)
 	*lenp = desc->len;
 	*bufp = (void *)(unsigned long)desc->addr;
 
-#ifdef INORDER
+#if defined(INORDER)
 	desc->len = desc->len - 1;
+#elif defined(INORDER_BATCH)
+	/* Only publish once the batch is full or nothing else is available. */
+	host.used_idx++;
+	if ((unsigned short)(host.used_idx - host.batch_start) <
+	    (param ? param : ring_size) && host.used_idx != ring.avail->idx)
+		return true;
+	used_idx = host.batch_start & (ring_size - 1);
+	ring.used->ring[used_idx].id = head;
+	ring.used->ring[used_idx].len = desc->len - 1;
+	host.batch_start = host.used_idx;
+	/* Barrier B (for pairing) */
+	smp_release();
+	ring.used->idx = host.used_idx;
+	return true;
 #else
 	/* now update used ring */
 	ring.used->ring[used_idx].id = head;
@@ -323,11 +388,20 @@ void call_used(void)
 	/* Flush in previous flags write */
 	/* Barrier D (for pairing) */
 	smp_mb();
+#ifdef INORDER_BATCH
+	/* Only the published part of a batch can be signalled */
+	need = vring_need_event(vring_used_event(&ring),
+				host.batch_start,
+				host.called_used_idx);
+
+	host.called_used_idx = host.batch_start;
+#else
 	need = vring_need_event(vring_used_event(&ring),
 				host.used_idx,
 				host.called_used_idx);
 
 	host.called_used_idx = host.used_idx;
+#endif
 	if (need)
 		call();
 }
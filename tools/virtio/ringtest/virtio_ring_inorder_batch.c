@@ -0,0 +1,2 @@
+#define INORDER_BATCH 1
+#include "virtio_ring_0_9.c"
@@ -0,0 +1,293 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * AF_XDP style rings, as in net/xdp/xsk_queue.h: one single-producer,
+ * single-consumer array per direction (descriptors one way, completions
+ * the other), global producer and consumer indices on cache lines of
+ * their own, and a locally cached copy of the peer's index that is only
+ * refreshed once the cached entries run out. Notifications are
+ * suppressed with a need_wakeup flag, set by the side about to sleep.
+ *
+ * With --param 1 the rings are laid out like the io_uring SQ and CQ
+ * instead: 64 byte submission entries reached through an index array,
+ * and 16 byte completion entries.
+ */
+#define _GNU_SOURCE
+#include "main.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* how much padding is needed to avoid false cache sharing */
+#define HOST_GUEST_PADDING 0x80
+
+#define RING_NEED_WAKEUP 0x1
+
+struct ring {
+	unsigned producer __attribute__((aligned(HOST_GUEST_PADDING)));
+	unsigned consumer __attribute__((aligned(HOST_GUEST_PADDING)));
+	unsigned flags __attribute__((aligned(HOST_GUEST_PADDING)));
+};
+
+/* struct xdp_desc */
+struct xdp_desc {
+	unsigned long long addr;
+	unsigned len;
+	unsigned options;
+};
+
+/* struct io_uring_sqe, of which only addr and len are used */
+struct sqe {
+	unsigned long long addr;
+	unsigned len;
+	unsigned char reserved[52];
+};
+
+/* struct io_uring_cqe */
+struct cqe {
+	unsigned long long user_data;
+	int res;
+	unsigned flags;
+};
+
+struct data {
+	void *buf;
+	void *data;
+} *data;
+
+/* submission (tx) and completion rings */
+struct ring *sq, *cq;
+
+/* AF_XDP layout */
+struct xdp_desc *descs;
+unsigned long long *addrs;
+
+/* io_uring layout */
+struct sqe *sqes;
+unsigned *sq_array;
+struct cqe *cqes;
+
+struct guest {
+	unsigned sq_prod;
+	unsigned cached_sq_cons;
+	unsigned cq_cons;
+	unsigned cached_cq_prod;
+	unsigned num_free;
+	unsigned char reserved[HOST_GUEST_PADDING - 20];
+} guest;
+
+struct host {
+	unsigned sq_cons;
+	unsigned cached_sq_prod;
+	unsigned cq_prod;
+	unsigned char reserved[HOST_GUEST_PADDING - 12];
+} host;
+
+static void *alloc_aligned(size_t size)
+{
+	void *p;
+
+	if (posix_memalign(&p, 0x1000, size)) {
+		perror("Unable to allocate ring buffer.\n");
+		exit(3);
+	}
+	memset(p, 0, size);
+	return p;
+}
+
+/* implemented by ring */
+void alloc_ring(void)
+{
+	sq = alloc_aligned(sizeof(*sq));
+	cq = alloc_aligned(sizeof(*cq));
+
+	if (param) {
+		sqes = alloc_aligned(ring_size * sizeof(*sqes));
+		sq_array = alloc_aligned(ring_size * sizeof(*sq_array));
+		cqes = alloc_aligned(ring_size * sizeof(*cqes));
+	} else {
+		descs = alloc_aligned(ring_size * sizeof(*descs));
+		addrs = alloc_aligned(ring_size * sizeof(*addrs));
+	}
+
+	guest.num_free = ring_size;
+	data = calloc(ring_size, sizeof(*data));
+	if (!data) {
+		perror("Unable to allocate data buffer.\n");
+		exit(3);
+	}
+}
+
+/* guest side */
+int add_inbuf(unsigned len, void *buf, void *datap)
+{
+	unsigned idx;
+
+	/* Completions are in order, so this also keeps cq from overflowing. */
+	if (!guest.num_free)
+		return -1;
+
+	/* Like xskq_prod_is_full(): only look at the consumer when needed. */
+	if (guest.sq_prod - guest.cached_sq_cons == ring_size) {
+		guest.cached_sq_cons = READ_ONCE(sq->consumer);
+		if (guest.sq_prod - guest.cached_sq_cons == ring_size)
+			return -1;
+	}
+
+	idx = (ring_size - 1) & guest.sq_prod;
+	data[idx].buf = buf;
+	data[idx].data = datap;
+
+	if (param) {
+		sqes[idx].addr = idx;
+		sqes[idx].len = len;
+		sq_array[idx] = idx;
+	} else {
+		descs[idx].addr = idx;
+		descs[idx].len = len;
+	}
+
+	guest.num_free--;
+	guest.sq_prod++;
+	/* Barrier A (for pairing) */
+	smp_release();
+	WRITE_ONCE(sq->producer, guest.sq_prod);
+
+	return 0;
+}
+
+bool used_empty()
+{
+	if (guest.cq_cons != guest.cached_cq_prod)
+		return false;
+
+	guest.cached_cq_prod = READ_ONCE(cq->producer);
+	return guest.cq_cons == guest.cached_cq_prod;
+}
+
+void *get_buf(unsigned *lenp, void **bufp)
+{
+	unsigned idx, index;
+	void *datap;
+
+	if (used_empty())
+		return NULL;
+	/* Barrier B (for pairing) */
+	smp_acquire();
+
+	idx = (ring_size - 1) & guest.cq_cons;
+	if (param) {
+		index = cqes[idx].user_data;
+		*lenp = cqes[idx].res;
+	} else {
+		index = addrs[idx];
+		*lenp = 0;
+	}
+
+	datap = data[index].data;
+	*bufp = data[index].buf;
+	data[index].buf = NULL;
+	data[index].data = NULL;
+
+	guest.num_free++;
+	guest.cq_cons++;
+	smp_release();
+	WRITE_ONCE(cq->consumer, guest.cq_cons);
+
+	return datap;
+}
+
+void disable_call()
+{
+	WRITE_ONCE(cq->flags, 0);
+}
+
+bool enable_call()
+{
+	WRITE_ONCE(cq->flags, RING_NEED_WAKEUP);
+	/* Flush need_wakeup write */
+	/* Barrier D (for pairing) */
+	smp_mb();
+	return used_empty();
+}
+
+void kick_available(void)
+{
+	/* Flush in previous producer write */
+	/* Barrier C (for pairing) */
+	smp_mb();
+	if (READ_ONCE(sq->flags) & RING_NEED_WAKEUP)
+		kick();
+}
+
+/* host side */
+void disable_kick()
+{
+	WRITE_ONCE(sq->flags, 0);
+}
+
+bool avail_empty()
+{
+	if (host.sq_cons != host.cached_sq_prod)
+		return false;
+
+	host.cached_sq_prod = READ_ONCE(sq->producer);
+	return host.sq_cons == host.cached_sq_prod;
+}
+
+bool enable_kick()
+{
+	WRITE_ONCE(sq->flags, RING_NEED_WAKEUP);
+	/* Barrier C (for pairing) */
+	smp_mb();
+	return avail_empty();
+}
+
+bool use_buf(unsigned *lenp, void **bufp)
+{
+	unsigned long long addr;
+	unsigned idx, len;
+
+	if (avail_empty())
+		return false;
+	/* Barrier A (for pairing) */
+	smp_acquire();
+
+	idx = (ring_size - 1) & host.sq_cons;
+	if (param) {
+		idx = sq_array[idx];
+		addr = sqes[idx].addr;
+		len = sqes[idx].len;
+	} else {
+		addr = descs[idx].addr;
+		len = descs[idx].len;
+	}
+
+	host.sq_cons++;
+	smp_release();
+	WRITE_ONCE(sq->consumer, host.sq_cons);
+
+	idx = (ring_size - 1) & host.cq_prod;
+	if (param) {
+		cqes[idx].user_data = addr;
+		cqes[idx].res = len - 1;
+	} else {
+		addrs[idx] = addr;
+	}
+
+	host.cq_prod++;
+	/* Barrier B (for pairing) */
+	smp_release();
+	WRITE_ONCE(cq->producer, host.cq_prod);
+
+	*lenp = len - 1;
+	return true;
+}
+
+void call_used(void)
+{
+	/* Flush in previous producer write */
+	/* Barrier D (for pairing) */
+	smp_mb();
+	if (READ_ONCE(cq->flags) & RING_NEED_WAKEUP)
+		call();
+}
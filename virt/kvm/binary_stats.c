@@ -7,6 +7,7 @@
 
 #include <linux/kvm_host.h>
 #include <linux/kvm.h>
+#include <linux/kvm_stats.h>
 #include <linux/errno.h>
 #include <linux/uaccess.h>
 
@@ -142,3 +143,104 @@ ssize_t kvm_stats_read(char *id, const struct kvm_stats_header *header,
 	*offset = pos;
 	return len;
 }
+
+void kvm_stats_delta_init(struct kvm_stats_delta_state *state)
+{
+	mutex_init(&state->lock);
+	state->generation = 0;
+	state->last = NULL;
+	state->cur = NULL;
+}
+
+void kvm_stats_delta_destroy(struct kvm_stats_delta_state *state)
+{
+	kvfree(state->last);
+	kvfree(state->cur);
+}
+
+/**
+ * kvm_stats_read_delta() - Handle KVM_STATS_READ_DELTA on a binary
+ * statistics file descriptor.
+ *
+ * @state: the delta state of the file descriptor
+ * @stats: start address of stats data block for a vm or a vcpu
+ * @size_stats: the size of stats data block pointed by @stats
+ * @argp: userspace address of the struct kvm_stats_delta argument
+ *
+ * The values returned by the last successful call are kept in @state, and
+ * only the values that differ from them are copied out, which is usually a
+ * small fraction of the data block for periodic readers.  The generation
+ * lets userspace and KVM agree on which values the delta is against; on
+ * a mismatch all values are returned.
+ *
+ * Return: 0 on success or a negative error code
+ */
+int kvm_stats_read_delta(struct kvm_stats_delta_state *state,
+			 const void *stats, size_t size_stats,
+			 void __user *argp)
+{
+	struct kvm_stats_delta_entry __user *uentries;
+	struct kvm_stats_delta_entry entry = {};
+	size_t i, n = size_stats / sizeof(u64);
+	struct kvm_stats_delta delta;
+	const u64 *src = stats;
+	u32 nr = 0;
+	bool full;
+	int r = 0;
+
+	if (copy_from_user(&delta, argp, sizeof(delta)))
+		return -EFAULT;
+	if (delta.flags)
+		return -EINVAL;
+
+	uentries = u64_to_user_ptr(delta.entries);
+
+	mutex_lock(&state->lock);
+
+	if (!state->last) {
+		state->last = kvcalloc(n, sizeof(u64), GFP_KERNEL_ACCOUNT);
+		state->cur = kvcalloc(n, sizeof(u64), GFP_KERNEL_ACCOUNT);
+		if (!state->last || !state->cur) {
+			kvfree(state->last);
+			kvfree(state->cur);
+			state->last = state->cur = NULL;
+			r = -ENOMEM;
+			goto out;
+		}
+	}
+
+	full = !delta.generation || delta.generation != state->generation;
+
+	for (i = 0; i < n; i++) {
+		state->cur[i] = READ_ONCE(src[i]);
+		if (!full && state->cur[i] == state->last[i])
+			continue;
+
+		if (nr < delta.nr_entries) {
+			entry.index = i;
+			entry.value = state->cur[i];
+			if (copy_to_user(&uentries[nr], &entry, sizeof(entry))) {
+				r = -EFAULT;
+				goto out;
+			}
+		}
+		nr++;
+	}
+
+	if (nr > delta.nr_entries) {
+		/* Keep the old snapshot, the caller retries with more room. */
+		r = -E2BIG;
+	} else {
+		swap(state->last, state->cur);
+		if (!++state->generation)
+			state->generation = 1;
+		delta.generation = state->generation;
+	}
+
+	delta.nr_entries = nr;
+	if (copy_to_user(argp, &delta, sizeof(delta)))
+		r = -EFAULT;
+out:
+	mutex_unlock(&state->lock);
+	return r;
+}
@@ -50,25 +50,87 @@ static bool kvm_dirty_ring_full(struct kvm_dirty_ring *ring)
 	return kvm_dirty_ring_used(ring) >= ring->size;
 }
 
-static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset, u64 mask)
+/*
+ * Coalesced resets are collected and then applied under a single
+ * acquisition of mmu_lock, instead of taking the lock for each of them.
+ */
+#define KVM_DIRTY_RING_RESET_BATCH	16
+
+struct kvm_dirty_ring_reset_batch {
+	int nr;
+	struct {
+		u32 slot;
+		u64 offset;
+		unsigned long mask;
+	} ents[KVM_DIRTY_RING_RESET_BATCH];
+};
+
+static struct kvm_memory_slot *kvm_dirty_ring_memslot(struct kvm *kvm, u32 slot)
 {
-	struct kvm_memory_slot *memslot;
 	int as_id, id;
 
 	as_id = slot >> 16;
 	id = (u16)slot;
 
 	if (as_id >= KVM_ADDRESS_SPACE_NUM || id >= KVM_USER_MEM_SLOTS)
-		return;
+		return NULL;
 
-	memslot = id_to_memslot(__kvm_memslots(kvm, as_id), id);
+	return id_to_memslot(__kvm_memslots(kvm, as_id), id);
+}
+
+static void kvm_reset_dirty_gfns(struct kvm *kvm,
+				 struct kvm_dirty_ring_reset_batch *batch)
+{
+	struct kvm_memory_slot *memslot = NULL;
+	u32 cur_slot = 0;
+	int i;
 
-	if (!memslot || (offset + __fls(mask)) >= memslot->npages)
+	if (!batch->nr)
 		return;
 
 	KVM_MMU_LOCK(kvm);
-	kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
+	for (i = 0; i < batch->nr; i++) {
+		u64 offset = batch->ents[i].offset;
+		unsigned long mask = batch->ents[i].mask;
+
+		/* The memslots can't change, slots_lock is held. */
+		if (!i || batch->ents[i].slot != cur_slot) {
+			cur_slot = batch->ents[i].slot;
+			memslot = kvm_dirty_ring_memslot(kvm, cur_slot);
+		}
+
+		if (!memslot || (offset + __fls(mask)) >= memslot->npages)
+			continue;
+
+		kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
+	}
 	KVM_MMU_UNLOCK(kvm);
+
+	batch->nr = 0;
+	cond_resched();
+}
+
+static void kvm_reset_dirty_gfn(struct kvm *kvm,
+				struct kvm_dirty_ring_reset_batch *batch,
+				u32 slot, u64 offset, unsigned long mask)
+{
+	int last = batch->nr - 1;
+
+	if (!mask)
+		return;
+
+	/* Guests tend to dirty the same pages over and over again. */
+	if (last >= 0 && batch->ents[last].slot == slot &&
+	    batch->ents[last].offset == offset) {
+		batch->ents[last].mask |= mask;
+		return;
+	}
+
+	batch->ents[batch->nr].slot = slot;
+	batch->ents[batch->nr].offset = offset;
+	batch->ents[batch->nr].mask = mask;
+	if (++batch->nr == KVM_DIRTY_RING_RESET_BATCH)
+		kvm_reset_dirty_gfns(kvm, batch);
 }
 
 int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, int index, u32 size)
@@ -103,6 +165,7 @@ static inline bool kvm_dirty_gfn_harvested(struct kvm_dirty_gfn *gfn)
 
 int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 {
+	struct kvm_dirty_ring_reset_batch batch;
 	u32 cur_slot, next_slot;
 	u64 cur_offset, next_offset;
 	unsigned long mask;
@@ -110,6 +173,8 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 	struct kvm_dirty_gfn *entry;
 	bool first_round = true;
 
+	batch.nr = 0;
+
 	/* This is only needed to make compilers happy */
 	cur_slot = cur_offset = mask = 0;
 
@@ -147,14 +212,15 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 				continue;
 			}
 		}
-		kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+		kvm_reset_dirty_gfn(kvm, &batch, cur_slot, cur_offset, mask);
 		cur_slot = next_slot;
 		cur_offset = next_offset;
 		mask = 1;
 		first_round = false;
 	}
 
-	kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+	kvm_reset_dirty_gfn(kvm, &batch, cur_slot, cur_offset, mask);
+	kvm_reset_dirty_gfns(kvm, &batch);
 
 	/*
 	 * The request KVM_REQ_DIRTY_RING_SOFT_FULL will be cleared
@@ -17,6 +17,7 @@
 
 #include <linux/kvm_host.h>
 #include <linux/kvm.h>
+#include <linux/kvm_stats.h>
 #include <linux/module.h>
 #include <linux/errno.h>
 #include <linux/percpu.h>
@@ -1146,7 +1147,7 @@ static struct kvm *kvm_create_vm(unsigned long type, const char *fdname)
 	rcuwait_init(&kvm->mn_memslots_update_rcuwait);
 	xa_init(&kvm->vcpu_array);
 
-	INIT_LIST_HEAD(&kvm->gpc_list);
+	kvm->gpc_tree = RB_ROOT_CACHED;
 	spin_lock_init(&kvm->gpc_lock);
 
 	INIT_LIST_HEAD(&kvm->devices);
@@ -4019,42 +4020,104 @@ static int kvm_vcpu_ioctl_set_sigmask(struct kvm_vcpu *vcpu, sigset_t *sigset)
 	return 0;
 }
 
+/*
+ * private_data of a VM or vCPU binary stats fd.  The fd holds a reference
+ * to the VM, so that the VM and its vCPUs outlive it.
+ */
+struct kvm_stats_file {
+	struct kvm *kvm;
+	void *owner;
+	struct kvm_stats_delta_state delta;
+};
+
+static int kvm_stats_fd_create(struct kvm *kvm, const char *name,
+			       const struct file_operations *fops, void *owner)
+{
+	struct kvm_stats_file *sf;
+	struct file *file;
+	int fd;
+
+	sf = kzalloc(sizeof(*sf), GFP_KERNEL_ACCOUNT);
+	if (!sf)
+		return -ENOMEM;
+	sf->kvm = kvm;
+	sf->owner = owner;
+	kvm_stats_delta_init(&sf->delta);
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0)
+		goto out_free;
+
+	file = anon_inode_getfile(name, fops, sf, O_RDONLY);
+	if (IS_ERR(file)) {
+		put_unused_fd(fd);
+		fd = PTR_ERR(file);
+		goto out_free;
+	}
+	file->f_mode |= FMODE_PREAD;
+	kvm_get_kvm(kvm);
+	fd_install(fd, file);
+
+	return fd;
+
+out_free:
+	kfree(sf);
+	return fd;
+}
+
+static int kvm_stats_release(struct inode *inode, struct file *file)
+{
+	struct kvm_stats_file *sf = file->private_data;
+
+	kvm_stats_delta_destroy(&sf->delta);
+	kvm_put_kvm(sf->kvm);
+	kfree(sf);
+	return 0;
+}
+
 static ssize_t kvm_vcpu_stats_read(struct file *file, char __user *user_buffer,
 			      size_t size, loff_t *offset)
 {
-	struct kvm_vcpu *vcpu = file->private_data;
+	struct kvm_stats_file *sf = file->private_data;
+	struct kvm_vcpu *vcpu = sf->owner;
 
 	return kvm_stats_read(vcpu->stats_id, &kvm_vcpu_stats_header,
 			&kvm_vcpu_stats_desc[0], &vcpu->stat,
 			sizeof(vcpu->stat), user_buffer, size, offset);
 }
 
+static long kvm_vcpu_stats_ioctl(struct file *file, unsigned int ioctl,
+				 unsigned long arg)
+{
+	struct kvm_stats_file *sf = file->private_data;
+	struct kvm_vcpu *vcpu = sf->owner;
+
+	switch (ioctl) {
+	case KVM_STATS_READ_DELTA:
+		return kvm_stats_read_delta(&sf->delta, &vcpu->stat,
+					    sizeof(vcpu->stat),
+					    (void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static const struct file_operations kvm_vcpu_stats_fops = {
 	.read = kvm_vcpu_stats_read,
+	.unlocked_ioctl = kvm_vcpu_stats_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.release = kvm_stats_release,
 	.llseek = noop_llseek,
 };
 
 static int kvm_vcpu_ioctl_get_stats_fd(struct kvm_vcpu *vcpu)
 {
-	int fd;
-	struct file *file;
 	char name[15 + ITOA_MAX_LEN + 1];
 
 	snprintf(name, sizeof(name), "kvm-vcpu-stats:%d", vcpu->vcpu_id);
 
-	fd = get_unused_fd_flags(O_CLOEXEC);
-	if (fd < 0)
-		return fd;
-
-	file = anon_inode_getfile(name, &kvm_vcpu_stats_fops, vcpu, O_RDONLY);
-	if (IS_ERR(file)) {
-		put_unused_fd(fd);
-		return PTR_ERR(file);
-	}
-	file->f_mode |= FMODE_PREAD;
-	fd_install(fd, file);
-
-	return fd;
+	return kvm_stats_fd_create(vcpu->kvm, name, &kvm_vcpu_stats_fops,
+				   vcpu);
 }
 
 static long kvm_vcpu_ioctl(struct file *filp,
@@ -4687,37 +4750,83 @@ static int kvm_vm_ioctl_enable_cap_generic(struct kvm *kvm,
 static ssize_t kvm_vm_stats_read(struct file *file, char __user *user_buffer,
 			      size_t size, loff_t *offset)
 {
-	struct kvm *kvm = file->private_data;
+	struct kvm_stats_file *sf = file->private_data;
+	struct kvm *kvm = sf->owner;
 
 	return kvm_stats_read(kvm->stats_id, &kvm_vm_stats_header,
 				&kvm_vm_stats_desc[0], &kvm->stat,
 				sizeof(kvm->stat), user_buffer, size, offset);
 }
 
+/*
+ * Copy the stats of all vCPUs with one call, so that userspace doesn't have
+ * to keep a stats fd open and issue a read for every vCPU.
+ */
+static int kvm_vm_stats_read_vcpus(struct kvm *kvm, void __user *argp)
+{
+	struct kvm_stats_vcpus req;
+	struct kvm_vcpu *vcpu;
+	u8 __user *dest;
+	unsigned long i;
+	u32 nr_vcpus;
+	int r = 0;
+
+	if (copy_from_user(&req, argp, sizeof(req)))
+		return -EFAULT;
+	if (req.flags)
+		return -EINVAL;
+
+	nr_vcpus = atomic_read(&kvm->online_vcpus);
+	if (req.nr_vcpus < nr_vcpus) {
+		r = -E2BIG;
+		goto out;
+	}
+
+	dest = u64_to_user_ptr(req.data);
+	kvm_for_each_vcpu(i, vcpu, kvm) {
+		if (i >= nr_vcpus)
+			break;
+		if (copy_to_user(dest, &vcpu->stat, sizeof(vcpu->stat)))
+			return -EFAULT;
+		dest += sizeof(vcpu->stat);
+	}
+
+out:
+	req.nr_vcpus = nr_vcpus;
+	if (copy_to_user(argp, &req, sizeof(req)))
+		return -EFAULT;
+	return r;
+}
+
+static long kvm_vm_stats_ioctl(struct file *file, unsigned int ioctl,
+			       unsigned long arg)
+{
+	struct kvm_stats_file *sf = file->private_data;
+	struct kvm *kvm = sf->owner;
+
+	switch (ioctl) {
+	case KVM_STATS_READ_DELTA:
+		return kvm_stats_read_delta(&sf->delta, &kvm->stat,
+					    sizeof(kvm->stat),
+					    (void __user *)arg);
+	case KVM_STATS_READ_VCPUS:
+		return kvm_vm_stats_read_vcpus(kvm, (void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static const struct file_operations kvm_vm_stats_fops = {
 	.read = kvm_vm_stats_read,
+	.unlocked_ioctl = kvm_vm_stats_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.release = kvm_stats_release,
 	.llseek = noop_llseek,
 };
 
 static int kvm_vm_ioctl_get_stats_fd(struct kvm *kvm)
 {
-	int fd;
-	struct file *file;
-
-	fd = get_unused_fd_flags(O_CLOEXEC);
-	if (fd < 0)
-		return fd;
-
-	file = anon_inode_getfile("kvm-vm-stats",
-			&kvm_vm_stats_fops, kvm, O_RDONLY);
-	if (IS_ERR(file)) {
-		put_unused_fd(fd);
-		return PTR_ERR(file);
-	}
-	file->f_mode |= FMODE_PREAD;
-	fd_install(fd, file);
-
-	return fd;
+	return kvm_stats_fd_create(kvm, "kvm-vm-stats", &kvm_vm_stats_fops, kvm);
 }
 
 static long kvm_vm_ioctl(struct file *filp,
@@ -19,6 +19,29 @@
 
 #include "kvm_mm.h"
 
+/*
+ * Active caches are indexed by uhva in kvm->gpc_tree so that mmu_notifier
+ * events only visit the caches they actually hit, instead of taking the
+ * lock of every cache in the VM.  The key is only ever changed with
+ * kvm->gpc_lock held, which the invalidation holds for its whole walk.
+ */
+static void gpc_tree_insert(struct gfn_to_pfn_cache *gpc)
+{
+	lockdep_assert_held(&gpc->kvm->gpc_lock);
+
+	/* Only a single page so no need to care about length */
+	gpc->node.start = gpc->uhva;
+	gpc->node.last = gpc->uhva;
+	interval_tree_insert(&gpc->node, &gpc->kvm->gpc_tree);
+}
+
+static void gpc_tree_remove(struct gfn_to_pfn_cache *gpc)
+{
+	lockdep_assert_held(&gpc->kvm->gpc_lock);
+
+	interval_tree_remove(&gpc->node, &gpc->kvm->gpc_tree);
+}
+
 /*
  * MMU notifier 'invalidate_range_start' hook.
  */
@@ -26,14 +49,17 @@ void gfn_to_pfn_cache_invalidate_start(struct kvm *kvm, unsigned long start,
 				       unsigned long end, bool may_block)
 {
 	DECLARE_BITMAP(vcpu_bitmap, KVM_MAX_VCPUS);
+	struct interval_tree_node *node;
 	struct gfn_to_pfn_cache *gpc;
 	bool evict_vcpus = false;
 
 	spin_lock(&kvm->gpc_lock);
-	list_for_each_entry(gpc, &kvm->gpc_list, list) {
+	for (node = interval_tree_iter_first(&kvm->gpc_tree, start, end - 1);
+	     node; node = interval_tree_iter_next(node, start, end - 1)) {
+		gpc = container_of(node, struct gfn_to_pfn_cache, node);
+
 		write_lock_irq(&gpc->lock);
 
-		/* Only a single page so no need to care about length */
 		if (gpc->valid && !is_error_noslot_pfn(gpc->pfn) &&
 		    gpc->uhva >= start && gpc->uhva < end) {
 			gpc->valid = false;
@@ -261,9 +287,16 @@ static int __kvm_gpc_refresh(struct gfn_to_pfn_cache *gpc, gpa_t gpa,
 	 */
 	mutex_lock(&gpc->refresh_lock);
 
+	/*
+	 * gpc_lock must be taken outside gpc->lock, like the mmu_notifier
+	 * does, and is only needed while the uhva, i.e. the key of the cache
+	 * in gpc_tree, may change.
+	 */
+	spin_lock(&gpc->kvm->gpc_lock);
 	write_lock_irq(&gpc->lock);
 
 	if (!gpc->active) {
+		spin_unlock(&gpc->kvm->gpc_lock);
 		ret = -EINVAL;
 		goto out_unlock;
 	}
@@ -282,11 +315,18 @@ static int __kvm_gpc_refresh(struct gfn_to_pfn_cache *gpc, gpa_t gpa,
 		gpc->memslot = __gfn_to_memslot(slots, gfn);
 		gpc->uhva = gfn_to_hva_memslot(gpc->memslot, gfn);
 
+		if (gpc->uhva != old_uhva) {
+			gpc_tree_remove(gpc);
+			gpc_tree_insert(gpc);
+		}
+
 		if (kvm_is_error_hva(gpc->uhva)) {
+			spin_unlock(&gpc->kvm->gpc_lock);
 			ret = -EFAULT;
 			goto out;
 		}
 	}
+	spin_unlock(&gpc->kvm->gpc_lock);
 
 	/*
 	 * If the userspace HVA changed or the PFN was already invalid,
@@ -363,11 +403,11 @@ int kvm_gpc_activate(struct gfn_to_pfn_cache *gpc, gpa_t gpa, unsigned long len)
 			return -EIO;
 
 		spin_lock(&kvm->gpc_lock);
-		list_add(&gpc->list, &kvm->gpc_list);
+		gpc_tree_insert(gpc);
 		spin_unlock(&kvm->gpc_lock);
 
 		/*
-		 * Activate the cache after adding it to the list, a concurrent
+		 * Activate the cache after adding it to the tree, a concurrent
 		 * refresh must not establish a mapping until the cache is
 		 * reachable by mmu_notifier events.
 		 */
@@ -387,7 +427,7 @@ void kvm_gpc_deactivate(struct gfn_to_pfn_cache *gpc)
 
 	if (gpc->active) {
 		/*
-		 * Deactivate the cache before removing it from the list, KVM
+		 * Deactivate the cache before removing it from the tree, KVM
 		 * must stall mmu_notifier events until all users go away, i.e.
 		 * until gpc->lock is dropped and refresh is guaranteed to fail.
 		 */
@@ -399,7 +439,7 @@ void kvm_gpc_deactivate(struct gfn_to_pfn_cache *gpc)
 		 * Leave the GPA => uHVA cache intact, it's protected by the
 		 * memslot generation.  The PFN lookup needs to be redone every
 		 * time as mmu_notifier protection is lost when the cache is
-		 * removed from the VM's gpc_list.
+		 * removed from the VM's gpc_tree.
 		 */
 		old_khva = gpc->khva - offset_in_page(gpc->khva);
 		gpc->khva = NULL;
@@ -409,7 +449,7 @@ void kvm_gpc_deactivate(struct gfn_to_pfn_cache *gpc)
 		write_unlock_irq(&gpc->lock);
 
 		spin_lock(&kvm->gpc_lock);
-		list_del(&gpc->list);
+		gpc_tree_remove(gpc);
 		spin_unlock(&kvm->gpc_lock);
 
 		gpc_unmap_khva(old_pfn, old_khva);